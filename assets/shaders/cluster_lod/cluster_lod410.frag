@@ -0,0 +1,23 @@
+#version 410 core
+
+out vec4 FragColor;
+
+in vec3 FragPos;
+in vec3 Normal;
+
+uniform vec3 albedo;
+
+uniform vec3 viewPos;
+uniform vec3 lightDirection;  // towards the light
+uniform vec3 lightColor;
+uniform vec3 ambientColor;
+uniform vec3 fogColor;
+uniform float fogDensity;
+
+void main() {
+    vec3 normal = normalize(Normal);
+    vec3 lit = albedo * (ambientColor + lightColor * max(dot(normal, normalize(lightDirection)), 0.0));
+
+    float fog = 1.0 - exp(-fogDensity * distance(viewPos, FragPos));
+    FragColor = vec4(mix(lit, fogColor, fog), 1.0);
+}
@@ -0,0 +1,18 @@
+#version 410 core
+
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec4 aNormal;  // signed 10:10:10:2, w unused
+
+out vec3 FragPos;
+out vec3 Normal;
+
+uniform mat4 view;
+uniform mat4 projection;
+uniform vec3 meshOrigin;  // cluster DAGs are stored in their own space, translated only
+
+void main() {
+    FragPos = aPos + meshOrigin;
+    Normal = aNormal.xyz;
+
+    gl_Position = projection * view * vec4(FragPos, 1.0);
+}
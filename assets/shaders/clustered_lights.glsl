@@ -0,0 +1,42 @@
+// The point lights of every cluster of the view frustum, see clustered_lighting.h. Included by the
+// 4.6 shaders that add them to their own lighting when useClusteredLights is set.
+
+struct PointLight {
+    vec3 position;
+    float radius;
+    vec3 colour;
+    float intensity;
+};
+
+layout (std430, binding = 7) readonly buffer PointLights { PointLight pointLights[]; };
+layout (std430, binding = 8) readonly buffer LightClusters { uvec2 lightClusters[]; };  // first index, count
+layout (std430, binding = 9) readonly buffer LightIndices { uint lightIndices[]; };
+
+uniform bool useClusteredLights;
+uniform ivec3 clusterCounts;     // tiles across, tiles up, depth slices
+uniform vec2 clusterTileSize;    // in pixels
+uniform float clusterSliceScale;
+uniform float clusterSliceBias;
+uniform vec2 clusterDepthRange;  // near and far planes
+
+// The first index and count of the lights of the cluster holding a pixel centre at a view depth:
+// its tile from the pixel and its depth slice from the log of the depth.
+uvec2 clusterLightsAtDepth(vec2 fragCoord, float depth) {
+    ivec3 cluster = ivec3(ivec2(fragCoord / clusterTileSize),
+                          int(floor(log(depth) * clusterSliceScale - clusterSliceBias)));
+    cluster = clamp(cluster, ivec3(0), clusterCounts - 1);
+    return lightClusters[cluster.x + clusterCounts.x * (cluster.y + clusterCounts.y * cluster.z)];
+}
+
+// The same for a depth buffer value, such as gl_FragCoord.z.
+uvec2 clusterLights(vec2 fragCoord, float depthValue) {
+    float near = clusterDepthRange.x, far = clusterDepthRange.y;
+    return clusterLightsAtDepth(fragCoord, near * far / (far - depthValue * (far - near)));
+}
+
+// Inverse-square falloff, windowed to reach nothing at the light's radius.
+float pointLightFalloff(PointLight light, float distance) {
+    float ratio = distance / light.radius;
+    float window = clamp(1.0 - ratio * ratio * ratio * ratio, 0.0, 1.0);
+    return light.intensity * window * window / (distance * distance + 1.0);
+}
@@ -0,0 +1,49 @@
+// The G-buffer layout of deferred_shading.h, packed by the G-buffer shaders and unpacked by
+// lighting.comp, so both sides agree on it:
+//
+//   albedo  albedo, specular intensity
+//   normal  octahedral normal, shininess / 256, lighting model / 3
+
+// Lighting models; 0 marks pixels nothing deferred covered.
+const int lightingModelNone = 0;
+const int lightingModelMaterial = 1;  // the Light struct with specular, as shader460.frag
+const int lightingModelHlod = 2;      // the directional light and fog, as the HLOD shaders
+
+struct GBufferTexel {
+    vec3 albedo;
+    float specular;
+    vec3 normal;
+    float shininess;
+    int model;
+};
+
+// Octahedral encoding: the unit sphere folded onto the square [0, 1]^2.
+vec2 encodeOctahedral(vec3 n) {
+    n /= abs(n.x) + abs(n.y) + abs(n.z);
+    vec2 folded = n.z >= 0.0 ? n.xy : (1.0 - abs(n.yx)) * vec2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);
+    return folded * 0.5 + 0.5;
+}
+
+vec3 decodeOctahedral(vec2 encoded) {
+    encoded = encoded * 2.0 - 1.0;
+    vec3 n = vec3(encoded, 1.0 - abs(encoded.x) - abs(encoded.y));
+    float fold = max(-n.z, 0.0);
+    n.xy += vec2(n.x >= 0.0 ? -fold : fold, n.y >= 0.0 ? -fold : fold);
+    return normalize(n);
+}
+
+// `normal` must be unit length.
+void packGBuffer(GBufferTexel texel, out vec4 albedo, out vec4 normal) {
+    albedo = vec4(texel.albedo, texel.specular);
+    normal = vec4(encodeOctahedral(texel.normal), texel.shininess / 256.0, float(texel.model) / 3.0);
+}
+
+GBufferTexel unpackGBuffer(vec4 albedo, vec4 normal) {
+    GBufferTexel texel;
+    texel.albedo = albedo.rgb;
+    texel.specular = albedo.a;
+    texel.normal = decodeOctahedral(normal.rg);
+    texel.shininess = normal.b * 256.0;
+    texel.model = int(normal.a * 3.0 + 0.5);
+    return texel;
+}
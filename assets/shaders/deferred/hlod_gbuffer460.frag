@@ -0,0 +1,27 @@
+#version 460 core
+
+// The G-buffer, see gbuffer.glsl.
+layout (location = 0) out vec4 gAlbedo;
+layout (location = 1) out vec4 gNormal;
+
+#include "gbuffer.glsl"
+
+in vec3 FragPos;
+in vec3 Normal;
+in vec2 TexCoord;
+
+uniform sampler2DArray materials;
+uniform sampler2DArray atlases;  // one layer per HLOD cluster
+uniform bool useAtlas;
+uniform int layer;  // material for objects, cluster for proxies
+
+void main() {
+    vec3 albedo = useAtlas ? texture(atlases, vec3(TexCoord, float(layer))).rgb
+                           : texture(materials, vec3(TexCoord, float(layer))).rgb;
+
+    // Proxy triangles can face either way after simplification; light them from the side the camera sees.
+    vec3 normal = normalize(Normal);
+    if (!gl_FrontFacing) normal = -normal;
+
+    packGBuffer(GBufferTexel(albedo, 0.0, normal, 0.0, lightingModelHlod), gAlbedo, gNormal);
+}
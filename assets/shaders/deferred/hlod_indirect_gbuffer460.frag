@@ -0,0 +1,22 @@
+#version 460 core
+
+// The G-buffer, see gbuffer.glsl.
+layout (location = 0) out vec4 gAlbedo;
+layout (location = 1) out vec4 gNormal;
+
+#include "gbuffer.glsl"
+
+in vec3 FragPos;
+in vec3 Normal;
+in vec2 TexCoord;
+flat in int Layer;
+
+uniform sampler2DArray materials;
+
+void main() {
+    vec3 albedo = texture(materials, vec3(TexCoord, float(Layer))).rgb;
+
+    vec3 normal = normalize(Normal);
+
+    packGBuffer(GBufferTexel(albedo, 0.0, normal, 0.0, lightingModelHlod), gAlbedo, gNormal);
+}
@@ -0,0 +1,36 @@
+#version 460 core
+
+// The G-buffer, see gbuffer.glsl.
+layout (location = 0) out vec4 gAlbedo;
+layout (location = 1) out vec4 gNormal;
+
+#include "gbuffer.glsl"
+
+struct Material {
+    uint diffuseLayer;
+    uint specularLayer;
+    float shininess;
+    float padding;
+};
+
+layout (std430, binding = 0) readonly buffer Materials {
+    Material materials[];
+};
+
+in vec3 Normal;
+in vec3 FragPos;
+in vec2 TexCoord;
+flat in uint MaterialIndex;
+
+uniform sampler2DArray diffuseMaps;
+uniform sampler2DArray specularMaps;
+
+void main() {
+    Material material = materials[MaterialIndex];
+    vec3 albedo = texture(diffuseMaps, vec3(TexCoord, float(material.diffuseLayer))).rgb;
+    vec3 specularMap = texture(specularMaps, vec3(TexCoord, float(material.specularLayer))).rgb;
+
+    float specular = dot(specularMap, vec3(1.0 / 3.0));
+    packGBuffer(GBufferTexel(albedo, specular, normalize(Normal), material.shininess, lightingModelMaterial),
+                gAlbedo, gNormal);
+}
@@ -0,0 +1,29 @@
+#version 460 core
+
+// The G-buffer, see gbuffer.glsl.
+layout (location = 0) out vec4 gAlbedo;
+layout (location = 1) out vec4 gNormal;
+
+#include "gbuffer.glsl"
+
+struct Material {
+    sampler2D diffuse;
+    sampler2D specular;
+    float shininess;
+};
+
+#include "../virtual_texture.glsl"
+
+in vec3 Normal;
+in vec3 FragPos;
+in vec2 TexCoord;
+
+uniform Material material;
+
+void main() {
+    vec3 albedo = useVirtualDiffuse ? sampleVirtualDiffuse(TexCoord) : texture(material.diffuse, TexCoord).rgb;
+    float specular = dot(texture(material.specular, TexCoord).rgb, vec3(1.0 / 3.0));
+
+    packGBuffer(GBufferTexel(albedo, specular, normalize(Normal), material.shininess, lightingModelMaterial),
+                gAlbedo, gNormal);
+}
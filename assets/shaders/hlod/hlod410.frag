@@ -0,0 +1,32 @@
+#version 410 core
+
+out vec4 FragColor;
+
+in vec3 FragPos;
+in vec3 Normal;
+in vec2 TexCoord;
+
+uniform sampler2DArray materials;
+uniform sampler2DArray atlases;  // one layer per HLOD cluster
+uniform bool useAtlas;
+uniform int layer;  // material for objects, cluster for proxies
+
+uniform vec3 viewPos;
+uniform vec3 lightDirection;  // towards the light
+uniform vec3 lightColor;
+uniform vec3 ambientColor;
+uniform vec3 fogColor;
+uniform float fogDensity;
+
+void main() {
+    vec3 albedo = useAtlas ? texture(atlases, vec3(TexCoord, float(layer))).rgb
+                           : texture(materials, vec3(TexCoord, float(layer))).rgb;
+
+    // Proxy triangles can face either way after simplification; light them from the side the camera sees.
+    vec3 normal = normalize(Normal);
+    if (!gl_FrontFacing) normal = -normal;
+    vec3 lit = albedo * (ambientColor + lightColor * max(dot(normal, normalize(lightDirection)), 0.0));
+
+    float fog = 1.0 - exp(-fogDensity * distance(viewPos, FragPos));
+    FragColor = vec4(mix(lit, fogColor, fog), 1.0);
+}
@@ -0,0 +1,36 @@
+#version 460 core
+
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec3 aNormal;
+layout (location = 2) in vec2 aTexCoord;
+
+// Drawn by gpu_culler: one instance per draw, found through gl_BaseInstance.
+struct Instance {
+    mat4 model;
+    vec4 boundsMin;
+    vec4 boundsMax;
+    uint mesh;
+    uint user;  // material layer
+    uint pad0;
+    uint pad1;
+};
+
+layout (std430, binding = 1) readonly buffer Instances { Instance instances[]; };
+
+out vec3 FragPos;
+out vec3 Normal;
+out vec2 TexCoord;
+flat out int Layer;
+
+uniform mat4 view;
+uniform mat4 projection;
+
+void main() {
+    Instance instance = instances[gl_BaseInstance];
+    FragPos = vec3(instance.model * vec4(aPos, 1.0));
+    Normal = mat3(transpose(inverse(instance.model))) * aNormal;
+    TexCoord = aTexCoord;
+    Layer = int(instance.user);
+
+    gl_Position = projection * view * vec4(FragPos, 1.0);
+}
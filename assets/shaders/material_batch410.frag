@@ -0,0 +1,57 @@
+#version 410 core
+
+out vec4 FragColor;
+
+struct Material {
+    uint diffuseLayer;
+    uint specularLayer;
+    float shininess;
+    float padding;
+};
+
+struct Light {
+    vec3 position;
+
+    vec3 ambient;
+    vec3 diffuse;
+    vec3 specular;
+};
+
+// No storage buffers before 4.3; must match material_library::max_uniform_materials.
+layout (std140) uniform Materials {
+    Material materials[256];
+};
+
+in vec3 Normal;
+in vec3 FragPos;
+in vec2 TexCoord;
+flat in uint MaterialIndex;
+
+uniform vec3 viewPos;
+
+uniform sampler2DArray diffuseMaps;
+uniform sampler2DArray specularMaps;
+uniform Light light;
+
+void main() {
+    Material material = materials[MaterialIndex];
+    vec3 albedo = texture(diffuseMaps, vec3(TexCoord, float(material.diffuseLayer))).rgb;
+
+    // ambient
+    vec3 ambient = light.ambient * albedo;
+
+    // diffuse
+    vec3 norm = normalize(Normal);
+    vec3 lightDir = normalize(light.position - FragPos);
+    float diff = max(dot(norm, lightDir), 0.0);
+    vec3 diffuse = light.diffuse * diff * albedo;
+
+    // specular
+    vec3 viewDir = normalize(viewPos - FragPos);
+    vec3 reflectDir = reflect(-lightDir, norm);
+    float spec = pow(max(dot(viewDir, reflectDir), 0.0), material.shininess);
+    vec3 specular = light.specular * spec * texture(specularMaps, vec3(TexCoord, float(material.specularLayer))).rgb;
+
+    vec3 result = ambient + diffuse + specular;
+    FragColor = vec4(result, 1.0);
+}
\ No newline at end of file
@@ -0,0 +1,83 @@
+#version 460 core
+
+out vec4 FragColor;
+
+struct Material {
+    uint diffuseLayer;
+    uint specularLayer;
+    float shininess;
+    float padding;
+};
+
+struct Light {
+    vec3 position;
+
+    vec3 ambient;
+    vec3 diffuse;
+    vec3 specular;
+};
+
+#include "clustered_lights.glsl"
+
+layout (std430, binding = 0) readonly buffer Materials {
+    Material materials[];
+};
+
+in vec3 Normal;
+in vec3 FragPos;
+in vec2 TexCoord;
+flat in uint MaterialIndex;
+
+uniform vec3 viewPos;
+uniform vec3 lightDirection;  // the sun, towards it
+uniform vec3 lightColor;
+
+#include "sun_shadow.glsl"
+
+uniform sampler2DArray diffuseMaps;
+uniform sampler2DArray specularMaps;
+uniform Light light;
+
+void main() {
+    Material material = materials[MaterialIndex];
+    vec3 albedo = texture(diffuseMaps, vec3(TexCoord, float(material.diffuseLayer))).rgb;
+
+    // ambient
+    vec3 ambient = light.ambient * albedo;
+
+    // diffuse
+    vec3 norm = normalize(Normal);
+    vec3 lightDir = normalize(light.position - FragPos);
+    float diff = max(dot(norm, lightDir), 0.0);
+    vec3 diffuse = light.diffuse * diff * albedo;
+
+    // specular
+    vec3 viewDir = normalize(viewPos - FragPos);
+    vec3 reflectDir = reflect(-lightDir, norm);
+    float spec = pow(max(dot(viewDir, reflectDir), 0.0), material.shininess);
+    vec3 specularMap = texture(specularMaps, vec3(TexCoord, float(material.specularLayer))).rgb;
+    vec3 specular = light.specular * spec * specularMap;
+
+    vec3 result = ambient + diffuse + specular;
+
+    // the sun, shadowed by its cascades
+    vec3 sunDir = normalize(lightDirection);
+    float sunDiff = max(dot(norm, sunDir), 0.0);
+    float sunSpec = pow(max(dot(viewDir, reflect(-sunDir, norm)), 0.0), material.shininess);
+    result += lightColor * sunShadow(FragPos, norm) * (sunDiff * albedo + sunSpec * specularMap);
+
+    if (useClusteredLights) {
+        uvec2 lights = clusterLights(gl_FragCoord.xy, gl_FragCoord.z);
+        for (uint i = 0u; i < lights.y; ++i) {
+            PointLight point = pointLights[lightIndices[lights.x + i]];
+            vec3 toLight = point.position - FragPos;
+            float lightDistance = length(toLight);
+            vec3 pointDir = toLight / max(lightDistance, 1e-4);
+            float pointDiff = max(dot(norm, pointDir), 0.0);
+            float pointSpec = pow(max(dot(viewDir, reflect(-pointDir, norm)), 0.0), material.shininess);
+            float falloff = pointLightFalloff(point, lightDistance);
+            result += point.colour * falloff * (pointDiff * albedo + pointSpec * specularMap);
+        }
+    }
+    FragColor = vec4(result, 1.0);
+}
\ No newline at end of file
@@ -0,0 +1,25 @@
+#version 460 core
+
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec3 aNormal;
+layout (location = 2) in vec2 aTexCoord;
+// Per instance.
+layout (location = 3) in mat4 aModel;
+layout (location = 7) in uint aMaterial;
+
+out vec3 FragPos;
+out vec3 Normal;
+out vec2 TexCoord;
+flat out uint MaterialIndex;
+
+uniform mat4 view;
+uniform mat4 projection;
+
+void main() {
+    FragPos = vec3(aModel * vec4(aPos, 1.0));
+    Normal = mat3(transpose(inverse(aModel))) * aNormal;
+    TexCoord = aTexCoord;
+    MaterialIndex = aMaterial;
+
+    gl_Position = projection * view * vec4(FragPos, 1.0);
+}
\ No newline at end of file
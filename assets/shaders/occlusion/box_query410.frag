@@ -0,0 +1,5 @@
+#version 410 core
+
+// Drawn with colour and depth writes off: all that counts is whether any sample passes the depth test.
+void main() {
+}
@@ -0,0 +1,11 @@
+#version 410 core
+
+layout (location = 0) in vec3 aPos;  // a corner of the unit cube
+
+uniform mat4 viewProjection;
+uniform vec3 boundsMin;
+uniform vec3 boundsMax;
+
+void main() {
+    gl_Position = viewProjection * vec4(mix(boundsMin, boundsMax, aPos), 1.0);
+}
@@ -0,0 +1,19 @@
+#version 410 core
+
+out vec4 FragColor;
+
+in vec3 FragPos;
+in vec3 Color;
+
+uniform vec3 viewPos;
+uniform vec3 fogColor;
+uniform float fogDensity;
+
+void main() {
+    // Round points rather than squares.
+    vec2 offset = gl_PointCoord * 2.0 - 1.0;
+    if (dot(offset, offset) > 1.0) discard;
+
+    float fog = 1.0 - exp(-fogDensity * distance(viewPos, FragPos));
+    FragColor = vec4(mix(Color, fogColor, fog), 1.0);
+}
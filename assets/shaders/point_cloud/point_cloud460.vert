@@ -0,0 +1,27 @@
+#version 460 core
+
+layout (location = 0) in vec3 aPosition;  // within the node's cube, 0 to 1
+layout (location = 1) in float aIntensity;
+layout (location = 2) in vec4 aColor;
+
+out vec3 FragPos;
+out vec3 Color;
+
+uniform mat4 view;
+uniform mat4 projection;
+uniform vec3 nodeMin;
+uniform float nodeSize;
+uniform float nodeSpacing;  // metres between the node's points
+uniform float pointScale;   // pixels per unit of size over distance
+uniform float maxPointSize;
+uniform bool useIntensity;
+
+void main() {
+    FragPos = nodeMin + aPosition * nodeSize;
+    vec4 viewPosition = view * vec4(FragPos, 1.0);
+    gl_Position = projection * viewPosition;
+
+    // Wide enough to close the gaps to the node's neighbouring points at this distance.
+    gl_PointSize = clamp(nodeSpacing * pointScale / max(-viewPosition.z, 0.001), 1.0, maxPointSize);
+    Color = useIntensity ? vec3(aIntensity) : aColor.rgb;
+}
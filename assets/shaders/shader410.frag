@@ -8,6 +8,8 @@ struct Material {
     float shininess;
 };
 
+#include "virtual_texture.glsl"
+
 struct Light {
     vec3 position;
 
@@ -26,14 +28,16 @@ uniform Material material;
 uniform Light light;
 
 void main() {
+    vec3 albedo = useVirtualDiffuse ? sampleVirtualDiffuse(TexCoord) : texture(material.diffuse, TexCoord).rgb;
+
     // ambient
-    vec3 ambient = light.ambient * texture(material.diffuse, TexCoord).rgb;
+    vec3 ambient = light.ambient * albedo;
 
     // diffuse
     vec3 norm = normalize(Normal);
     vec3 lightDir = normalize(light.position - FragPos);
     float diff = max(dot(norm, lightDir), 0.0);
-    vec3 diffuse = light.diffuse * diff * texture(material.diffuse, TexCoord).rgb;
+    vec3 diffuse = light.diffuse * diff * albedo;
 
     // specular
     vec3 viewDir = normalize(viewPos - FragPos);
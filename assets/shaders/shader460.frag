@@ -8,6 +8,8 @@ struct Material {
     float shininess;
 };
 
+#include "virtual_texture.glsl"
+
 struct Light {
     vec3 position;
 
@@ -16,31 +18,60 @@ struct Light {
     vec3 specular;
 };
 
+#include "clustered_lights.glsl"
+
 in vec3 Normal;
 in vec3 FragPos;
 in vec2 TexCoord;
 
 uniform vec3 viewPos;
+uniform vec3 lightDirection;  // the sun, towards it
+uniform vec3 lightColor;
+
+#include "sun_shadow.glsl"
 
 uniform Material material;
 uniform Light light;
 
 void main() {
+    vec3 albedo = useVirtualDiffuse ? sampleVirtualDiffuse(TexCoord) : texture(material.diffuse, TexCoord).rgb;
+
     // ambient
-    vec3 ambient = light.ambient * texture(material.diffuse, TexCoord).rgb;
+    vec3 ambient = light.ambient * albedo;
 
     // diffuse
     vec3 norm = normalize(Normal);
     vec3 lightDir = normalize(light.position - FragPos);
     float diff = max(dot(norm, lightDir), 0.0);
-    vec3 diffuse = light.diffuse * diff * texture(material.diffuse, TexCoord).rgb;
+    vec3 diffuse = light.diffuse * diff * albedo;
 
     // specular
     vec3 viewDir = normalize(viewPos - FragPos);
     vec3 reflectDir = reflect(-lightDir, norm);
     float spec = pow(max(dot(viewDir, reflectDir), 0.0), material.shininess);
-    vec3 specular = light.specular * spec * texture(material.specular, TexCoord).rgb;
+    vec3 specularMap = texture(material.specular, TexCoord).rgb;
+    vec3 specular = light.specular * spec * specularMap;
 
     vec3 result = ambient + diffuse + specular;
+
+    // the sun, shadowed by its cascades
+    vec3 sunDir = normalize(lightDirection);
+    float sunDiff = max(dot(norm, sunDir), 0.0);
+    float sunSpec = pow(max(dot(viewDir, reflect(-sunDir, norm)), 0.0), material.shininess);
+    result += lightColor * sunShadow(FragPos, norm) * (sunDiff * albedo + sunSpec * specularMap);
+
+    if (useClusteredLights) {
+        uvec2 lights = clusterLights(gl_FragCoord.xy, gl_FragCoord.z);
+        for (uint i = 0u; i < lights.y; ++i) {
+            PointLight point = pointLights[lightIndices[lights.x + i]];
+            vec3 toLight = point.position - FragPos;
+            float lightDistance = length(toLight);
+            vec3 pointDir = toLight / max(lightDistance, 1e-4);
+            float pointDiff = max(dot(norm, pointDir), 0.0);
+            float pointSpec = pow(max(dot(viewDir, reflect(-pointDir, norm)), 0.0), material.shininess);
+            float falloff = pointLightFalloff(point, lightDistance);
+            result += point.colour * falloff * (pointDiff * albedo + pointSpec * specularMap);
+        }
+    }
     FragColor = vec4(result, 1.0);
 }
\ No newline at end of file
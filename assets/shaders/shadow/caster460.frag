@@ -0,0 +1,5 @@
+#version 460 core
+
+// Depth only.
+void main() {
+}
@@ -0,0 +1,16 @@
+#version 460 core
+
+layout (location = 0) in vec3 aPos;
+
+flat out int Cascade;
+
+uniform mat4 model;
+uniform int cascadeMask;  // the cascades to draw into, an instance each
+
+void main() {
+    // The layer of this instance is the gl_InstanceID-th bit set in the mask.
+    int cascade = findLSB(cascadeMask);
+    for (int i = 0; i < gl_InstanceID; ++i) cascade = findLSB(cascadeMask & ~((2 << cascade) - 1));
+    Cascade = cascade;
+    gl_Position = model * vec4(aPos, 1.0);
+}
@@ -0,0 +1,22 @@
+// The sun's shadow cascades, see cascaded_shadow_map.h. Included by the 4.6 shaders the sun lights,
+// after they declare viewPos.
+
+uniform bool useShadows;
+uniform sampler2DArrayShadow shadowMap;
+uniform mat4 shadowMatrices[4];  // world to the cascade's texture coordinates and depth
+uniform vec4 shadowSplits;       // view depth at which each cascade ends
+uniform vec4 shadowTexelSizes;   // of a texel in the world, by cascade
+uniform int shadowCascades;
+uniform vec3 shadowViewForward;
+
+// How much of the sun reaches a point: 0 in shadow, 1 in the open or past the last cascade. The
+// point is moved off its surface by a texel and a half against acne.
+float sunShadow(vec3 position, vec3 normal) {
+    if (!useShadows) return 1.0;
+    float depth = dot(position - viewPos, shadowViewForward);
+    int cascade = 0;
+    while (cascade < shadowCascades && depth > shadowSplits[cascade]) ++cascade;
+    if (cascade == shadowCascades) return 1.0;
+    vec4 coord = shadowMatrices[cascade] * vec4(position + normal * (1.5 * shadowTexelSizes[cascade]), 1.0);
+    return texture(shadowMap, vec4(coord.xy, float(cascade), coord.z));
+}
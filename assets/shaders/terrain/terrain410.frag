@@ -0,0 +1,43 @@
+#version 410 core
+
+out vec4 FragColor;
+
+in vec3 FragPos;
+in vec3 TileCoord;
+flat in float SampleSpacing;
+
+uniform vec3 viewPos;
+uniform vec3 lightDirection;  // towards the light
+uniform vec3 lightColor;
+uniform vec3 ambientColor;
+uniform vec3 fogColor;
+uniform float fogDensity;
+
+uniform sampler2DArray heightTiles;
+uniform float gridSize;
+uniform float heightScale;
+uniform float heightOffset;
+
+vec3 terrainNormal() {
+    float texel = 1.0 / (gridSize + 3.0);
+    float left = texture(heightTiles, TileCoord - vec3(texel, 0.0, 0.0)).r;
+    float right = texture(heightTiles, TileCoord + vec3(texel, 0.0, 0.0)).r;
+    float back = texture(heightTiles, TileCoord - vec3(0.0, texel, 0.0)).r;
+    float front = texture(heightTiles, TileCoord + vec3(0.0, texel, 0.0)).r;
+    return normalize(vec3((left - right) * heightScale, 2.0 * SampleSpacing, (back - front) * heightScale));
+}
+
+void main() {
+    vec3 normal = terrainNormal();
+
+    // Grass on gentle slopes, rock on steep ones, snow on high flat ground.
+    float slope = 1.0 - normal.y;
+    float altitude = clamp(((FragPos.y - heightOffset) / heightScale - 0.55) / 0.15, 0.0, 1.0);
+    vec3 albedo = mix(vec3(0.28, 0.40, 0.18), vec3(0.42, 0.39, 0.35), smoothstep(0.15, 0.35, slope));
+    albedo = mix(albedo, vec3(0.90, 0.92, 0.95), altitude * (1.0 - smoothstep(0.3, 0.5, slope)));
+
+    vec3 lit = albedo * (ambientColor + lightColor * max(dot(normal, normalize(lightDirection)), 0.0));
+
+    float fog = 1.0 - exp(-fogDensity * distance(viewPos, FragPos));
+    FragColor = vec4(mix(lit, fogColor, fog), 1.0);
+}
@@ -0,0 +1,45 @@
+#version 410 core
+
+layout (location = 0) in vec2 aGridPos;  // [0, 1] across the node
+// Per instance.
+layout (location = 1) in vec4 aNode;   // world x and z of the node's corner, world width, tile layer
+layout (location = 2) in vec2 aMorph;  // distances where morphing to the next coarser grid starts and ends
+
+out vec3 FragPos;
+out vec3 TileCoord;
+flat out float SampleSpacing;
+
+uniform mat4 view;
+uniform mat4 projection;
+uniform vec3 viewPos;
+
+uniform sampler2DArray heightTiles;
+uniform float gridSize;  // quads per node side
+uniform float heightScale;
+uniform float heightOffset;
+
+// Tiles hold gridSize + 1 vertex heights plus a one-sample border on each side.
+vec3 tileCoord(vec2 gridPos) {
+    return vec3((gridPos * gridSize + 1.5) / (gridSize + 3.0), aNode.w);
+}
+
+float sampleHeight(vec2 gridPos) {
+    return textureLod(heightTiles, tileCoord(gridPos), 0.0).r * heightScale + heightOffset;
+}
+
+void main() {
+    vec2 worldXZ = aNode.xy + aGridPos * aNode.z;
+    float distanceToCamera = distance(viewPos, vec3(worldXZ.x, sampleHeight(aGridPos), worldXZ.y));
+    float morph = clamp((distanceToCamera - aMorph.x) / (aMorph.y - aMorph.x), 0.0, 1.0);
+
+    // Odd vertices slide onto their even neighbour; fully morphed, the grid is the next level's.
+    vec2 oddOffset = fract(aGridPos * gridSize * 0.5) * 2.0 / gridSize;
+    vec2 gridPos = aGridPos - oddOffset * morph;
+
+    worldXZ = aNode.xy + gridPos * aNode.z;
+    FragPos = vec3(worldXZ.x, sampleHeight(gridPos), worldXZ.y);
+    TileCoord = tileCoord(gridPos);
+    SampleSpacing = aNode.z / gridSize;
+
+    gl_Position = projection * view * vec4(FragPos, 1.0);
+}
@@ -0,0 +1,44 @@
+// The cube's virtual diffuse map and its page table lookup, see virtual_texture_system.h.
+// Included by the shaders that draw the cube.
+
+struct VirtualTexture {
+    sampler2D pageTable;      // RGBA8: cache slot x, slot y, level of the data, 255
+    sampler2D physicalCache;
+    vec2 size;                // level 0, in texels
+    int levels;
+    int pageTableRows[16];    // first page table row of every level
+    float pageSize;
+    float pageBorder;
+    vec2 physicalSize;
+};
+
+uniform VirtualTexture virtualDiffuse;
+uniform bool useVirtualDiffuse;
+
+// Samples the virtual diffuse map through its page table. Pages that are not resident yet resolve
+// to their nearest resident ancestor, so the result only ever gets blurrier, never wrong.
+vec3 sampleVirtualDiffuse(vec2 uv) {
+    vec2 texel = uv * virtualDiffuse.size;
+    vec2 dx = dFdx(texel);
+    vec2 dy = dFdy(texel);
+    float lod = 0.5 * log2(max(dot(dx, dx), dot(dy, dy)));
+    int level = int(clamp(floor(lod), 0.0, float(virtualDiffuse.levels - 1)));
+
+    vec2 wrapped = fract(uv);
+    vec2 levelSize = max(floor(virtualDiffuse.size / exp2(float(level))), vec2(1.0));
+    ivec2 page = ivec2(wrapped * levelSize / virtualDiffuse.pageSize);
+    vec4 entry = texelFetch(virtualDiffuse.pageTable, ivec2(page.x, virtualDiffuse.pageTableRows[level] + page.y), 0);
+    entry = floor(entry * 255.0 + 0.5);
+
+    int dataLevel = int(entry.b);
+    vec2 dataSize = max(floor(virtualDiffuse.size / exp2(float(dataLevel))), vec2(1.0));
+    // Clamped to the data level's pages like virtual_texture_system::parent_key(): with sizes that
+    // are not powers of two, a level's last page can have no parent of its own.
+    ivec2 dataPage = min(page >> (dataLevel - level), ivec2(ceil(dataSize / virtualDiffuse.pageSize)) - 1);
+    vec2 inPage = wrapped * dataSize - vec2(dataPage) * virtualDiffuse.pageSize;
+    inPage = clamp(inPage, vec2(0.5 - virtualDiffuse.pageBorder),
+                   vec2(virtualDiffuse.pageSize + virtualDiffuse.pageBorder - 0.5));
+
+    vec2 tileOrigin = entry.rg * (virtualDiffuse.pageSize + 2.0 * virtualDiffuse.pageBorder) + virtualDiffuse.pageBorder;
+    return textureLod(virtualDiffuse.physicalCache, (tileOrigin + inPage) / virtualDiffuse.physicalSize, 0.0).rgb;
+}
@@ -0,0 +1,35 @@
+#version 460 core
+
+// Writes the virtual texture page every pixel would sample, packed as
+// x | y << 12 | level << 24 | texture << 28. Cleared to 0xFFFFFFFF (no request).
+layout (location = 0) out uint Request;
+
+struct VirtualTexture {
+    sampler2D pageTable;      // RGBA8: cache slot x, slot y, level of the data, 255
+    sampler2D physicalCache;
+    vec2 size;                // level 0, in texels
+    int levels;
+    int pageTableRows[16];    // first page table row of every level
+    float pageSize;
+    float pageBorder;
+    vec2 physicalSize;
+};
+
+in vec2 TexCoord;
+
+uniform VirtualTexture virtualTexture;
+uniform int virtualTextureId;
+// log2 of the feedback downscale: the pass runs at lower resolution, so its derivatives are larger.
+uniform float feedbackBias;
+
+void main() {
+    vec2 texel = TexCoord * virtualTexture.size;
+    vec2 dx = dFdx(texel);
+    vec2 dy = dFdy(texel);
+    float lod = 0.5 * log2(max(dot(dx, dx), dot(dy, dy))) - feedbackBias;
+    int level = int(clamp(floor(lod), 0.0, float(virtualTexture.levels - 1)));
+
+    vec2 levelSize = max(floor(virtualTexture.size / exp2(float(level))), vec2(1.0));
+    uvec2 page = uvec2(fract(TexCoord) * levelSize / virtualTexture.pageSize);
+    Request = page.x | (page.y << 12) | (uint(level) << 24) | (uint(virtualTextureId) << 28);
+}
\ No newline at end of file
@@ -0,0 +1,10 @@
+#version 460 core
+
+// The triangle's id, see visibility_buffer.h.
+layout (location = 0) out uint visibility;
+
+flat in uint Command;
+
+void main() {
+    visibility = (Command << 6u) | uint(gl_PrimitiveID);
+}
@@ -0,0 +1,27 @@
+#version 460 core
+
+layout (location = 0) in vec3 aPos;
+
+// Drawn by gpu_culler: one instance per draw, found through gl_BaseInstance.
+struct Instance {
+    mat4 model;
+    vec4 boundsMin;
+    vec4 boundsMax;
+    uint mesh;
+    uint user;  // material layer
+    uint pad0;
+    uint pad1;
+};
+
+layout (std430, binding = 1) readonly buffer Instances { Instance instances[]; };
+
+flat out uint Command;
+
+uniform mat4 view;
+uniform mat4 projection;
+uniform int firstDraw;  // of the phase drawn, in the command buffer
+
+void main() {
+    Command = uint(firstDraw + gl_DrawID);
+    gl_Position = projection * view * (instances[gl_BaseInstance].model * vec4(aPos, 1.0));
+}
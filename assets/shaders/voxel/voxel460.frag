@@ -0,0 +1,34 @@
+#version 460 core
+
+out vec4 FragColor;
+
+in vec3 FragPos;
+in vec3 VoxelPos;
+flat in vec3 Normal;
+flat in uint Material;
+
+uniform vec3 viewPos;
+uniform vec3 lightDirection;  // towards the light
+uniform vec3 lightColor;
+uniform vec3 ambientColor;
+uniform vec3 fogColor;
+uniform float fogDensity;
+
+// Indexed by material, in the order of voxel_volume.h.
+const vec3 materialColors[6] = vec3[](vec3(1.0, 0.0, 1.0), vec3(0.30, 0.45, 0.18), vec3(0.40, 0.29, 0.19),
+                                      vec3(0.45, 0.44, 0.42), vec3(0.90, 0.92, 0.95), vec3(0.60, 0.25, 0.20));
+
+float voxelNoise(vec3 voxel) {
+    return fract(sin(dot(voxel, vec3(12.9898, 78.233, 37.719))) * 43758.5453);
+}
+
+void main() {
+    // Merged quads span many voxels; a per-voxel tint keeps them from reading as flat sheets.
+    vec3 voxel = floor(VoxelPos - Normal * 0.5);
+    vec3 albedo = materialColors[min(Material, 5u)] * (0.88 + 0.12 * voxelNoise(voxel));
+
+    vec3 lit = albedo * (ambientColor + lightColor * max(dot(Normal, normalize(lightDirection)), 0.0));
+
+    float fog = 1.0 - exp(-fogDensity * distance(viewPos, FragPos));
+    FragColor = vec4(mix(lit, fogColor, fog), 1.0);
+}
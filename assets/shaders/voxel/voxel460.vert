@@ -0,0 +1,26 @@
+#version 460 core
+
+layout (location = 0) in ivec3 aPosition;  // voxels from the volume origin
+layout (location = 1) in uint aAttributes;  // face | material << 3
+
+out vec3 FragPos;
+out vec3 VoxelPos;
+flat out vec3 Normal;
+flat out uint Material;
+
+uniform mat4 view;
+uniform mat4 projection;
+uniform vec3 volumeOrigin;
+uniform float voxelSize;
+
+const vec3 faceNormals[6] = vec3[](vec3(-1.0, 0.0, 0.0), vec3(1.0, 0.0, 0.0), vec3(0.0, -1.0, 0.0),
+                                   vec3(0.0, 1.0, 0.0), vec3(0.0, 0.0, -1.0), vec3(0.0, 0.0, 1.0));
+
+void main() {
+    VoxelPos = vec3(aPosition);
+    FragPos = volumeOrigin + VoxelPos * voxelSize;
+    Normal = faceNormals[aAttributes & 7u];
+    Material = aAttributes >> 3;
+
+    gl_Position = projection * view * vec4(FragPos, 1.0);
+}
@@ -0,0 +1,200 @@
+// Builds BVHs over 100k and 1M random boxes in a 2 km cube and times the build on one thread and on
+// the pool, refits after moving a tenth of the objects and after moving all of them, and measures
+// the throughput of frustum, box and ray queries. Query results are checked against brute force.
+//
+// usage: Bvh_Benchmark [largest object count]
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include "render/frustum.h"
+#include "scene/bvh.h"
+#include "utility/thread_pool.h"
+
+namespace {
+
+using clock_type = std::chrono::steady_clock;
+
+constexpr float half_size = 1000.0f;
+constexpr int32_t view_count = 32;
+constexpr int32_t box_queries = 100'000;
+constexpr int32_t ray_queries = 100'000;
+constexpr int32_t checked_queries = 200;
+
+double milliseconds_since(const clock_type::time_point start) {
+  return std::chrono::duration<double, std::milli>(clock_type::now() - start).count();
+}
+
+struct object_box {
+  glm::vec3 min;
+  glm::vec3 max;
+};
+
+std::vector<object_box> make_boxes(const size_t count, std::mt19937 &random) {
+  std::uniform_real_distribution<float> coordinate(-half_size, half_size);
+  std::uniform_real_distribution<float> size(0.5f, 5.0f);
+  std::vector<object_box> boxes(count);
+  for (object_box &box : boxes) {
+    const glm::vec3 centre(coordinate(random), coordinate(random), coordinate(random));
+    const glm::vec3 extent(size(random), size(random), size(random));
+    box = {centre - extent, centre + extent};
+  }
+  return boxes;
+}
+
+void print_tree(const char *name, const double milliseconds, const bvh &tree) {
+  const bvh_stats stats = tree.stats();
+  std::cout << "    " << std::left << std::setw(24) << name << std::right << std::fixed << std::setprecision(1)
+            << std::setw(8) << milliseconds << " ms, " << stats.nodes << " nodes, depth " << stats.depth
+            << ", SAH cost " << std::setprecision(2) << stats.sah_cost << std::endl;
+}
+
+void print_rate(const char *name, const int32_t queries, const double milliseconds, const size_t found,
+                const int32_t mismatches) {
+  std::cout << "    " << std::left << std::setw(24) << name << std::right << std::fixed << std::setprecision(2)
+            << std::setw(8) << 1000.0 * milliseconds / queries << " us/query, " << std::setprecision(1)
+            << static_cast<double>(found) / queries << " found per query, " << mismatches
+            << " of " << checked_queries << " checked differ from brute force" << std::endl;
+}
+
+bool box_overlaps(const object_box &box, const glm::vec3 &min, const glm::vec3 &max) {
+  return glm::all(glm::lessThanEqual(box.min, max)) && glm::all(glm::greaterThanEqual(box.max, min));
+}
+
+// The nearest box entered by the ray, by brute force.
+float nearest_entry(const std::vector<object_box> &boxes, const glm::vec3 &origin, const glm::vec3 &direction,
+                    const float max_distance) {
+  float nearest = -1.0f;
+  for (const object_box &box : boxes) {
+    const glm::vec3 to_min = (box.min - origin) / direction;
+    const glm::vec3 to_max = (box.max - origin) / direction;
+    const glm::vec3 near_planes = glm::min(to_min, to_max), far_planes = glm::max(to_min, to_max);
+    const float entry = std::max(std::max(near_planes.x, near_planes.y), std::max(near_planes.z, 0.0f));
+    const float exit = std::min(std::min(far_planes.x, far_planes.y), std::min(far_planes.z, max_distance));
+    if (entry <= exit && (nearest < 0.0f || entry < nearest)) nearest = entry;
+  }
+  return nearest;
+}
+
+void run(const size_t count, thread_pool &pool) {
+  std::mt19937 random(11);
+  std::vector<object_box> boxes = make_boxes(count, random);
+  std::cout << count << " objects:" << std::endl;
+
+  bvh tree;
+  tree.reserve(count);
+  for (const object_box &box : boxes) tree.add(box.min, box.max);
+
+  auto start = clock_type::now();
+  tree.build();
+  print_tree("build, one thread", milliseconds_since(start), tree);
+  start = clock_type::now();
+  tree.build(pool);
+  print_tree("build, pool", milliseconds_since(start), tree);
+
+  // Everything drifts by a few metres; a tenth moves first, then all of it.
+  std::uniform_real_distribution<float> drift(-4.0f, 4.0f);
+  std::uniform_int_distribution<size_t> pick(0, count - 1);
+  const auto move = [&](const size_t i) {
+    const glm::vec3 offset(drift(random), drift(random), drift(random));
+    boxes[i] = {boxes[i].min + offset, boxes[i].max + offset};
+    tree.update(static_cast<uint32_t>(i), boxes[i].min, boxes[i].max);
+  };
+  for (size_t i = 0; i < count / 10; ++i) move(pick(random));
+  start = clock_type::now();
+  tree.refit();
+  print_tree("refit a tenth", milliseconds_since(start), tree);
+  for (int32_t round = 0; round < 4; ++round) {
+    for (size_t i = 0; i < count; ++i) move(i);
+    start = clock_type::now();
+    tree.refit();
+    print_tree("refit all", milliseconds_since(start), tree);
+  }
+
+  // Frustum queries from the centre, turning a full circle.
+  const glm::mat4 projection = glm::perspective(glm::radians(60.0f), 16.0f / 9.0f, 0.1f, 500.0f);
+  std::vector<uint32_t> found;
+  size_t total = 0;
+  int32_t mismatches = 0;
+  double milliseconds = 0.0;
+  for (int32_t v = 0; v < view_count; ++v) {
+    const float heading = glm::two_pi<float>() * static_cast<float>(v) / view_count;
+    const glm::vec3 forward(std::sin(heading), -0.2f, -std::cos(heading));
+    const frustum planes =
+        extract_frustum(projection * glm::lookAt(glm::vec3(0.0f), forward, glm::vec3(0.0f, 1.0f, 0.0f)));
+    start = clock_type::now();
+    tree.query(planes, found);
+    milliseconds += milliseconds_since(start);
+    total += found.size();
+
+    size_t expected = 0;
+    for (const object_box &box : boxes) expected += test_aabb(planes, box.min, box.max) != frustum_test::outside;
+    mismatches += expected != found.size();
+  }
+  std::cout << "    " << std::left << std::setw(24) << "frustum queries" << std::right << std::fixed
+            << std::setprecision(2) << std::setw(8) << milliseconds / view_count << " ms/query, "
+            << total / view_count << " found per query, " << mismatches << " of " << view_count
+            << " differ from brute force" << std::endl;
+
+  // 20 m boxes scattered through the cube.
+  std::uniform_real_distribution<float> coordinate(-half_size, half_size);
+  std::vector<glm::vec3> corners(box_queries);
+  for (glm::vec3 &corner : corners) corner = glm::vec3(coordinate(random), coordinate(random), coordinate(random));
+  total = 0;
+  start = clock_type::now();
+  for (const glm::vec3 &corner : corners) {
+    tree.query(corner, corner + 20.0f, found);
+    total += found.size();
+  }
+  milliseconds = milliseconds_since(start);
+  mismatches = 0;
+  for (int32_t q = 0; q < checked_queries; ++q) {
+    tree.query(corners[q], corners[q] + 20.0f, found);
+    const auto expected = static_cast<size_t>(std::count_if(boxes.begin(), boxes.end(), [&](const object_box &box) {
+      return box_overlaps(box, corners[q], corners[q] + 20.0f);
+    }));
+    mismatches += expected != found.size();
+  }
+  print_rate("box queries", box_queries, milliseconds, total, mismatches);
+
+  // Rays from random points in random directions, as far as the cube is wide.
+  std::normal_distribution<float> normal;
+  std::vector<std::pair<glm::vec3, glm::vec3>> rays(ray_queries);
+  for (auto &ray : rays) {
+    ray.first = glm::vec3(coordinate(random), coordinate(random), coordinate(random));
+    ray.second = glm::normalize(glm::vec3(normal(random), normal(random), normal(random)));
+  }
+  constexpr float ray_length = 2.0f * half_size;
+  total = 0;
+  bvh_hit hit;
+  start = clock_type::now();
+  for (const auto &ray : rays) total += tree.raycast(ray.first, ray.second, ray_length, hit);
+  milliseconds = milliseconds_since(start);
+  mismatches = 0;
+  for (int32_t q = 0; q < checked_queries; ++q) {
+    const float expected = nearest_entry(boxes, rays[q].first, rays[q].second, ray_length);
+    const bool found_hit = tree.raycast(rays[q].first, rays[q].second, ray_length, hit);
+    mismatches += found_hit != (expected >= 0.0f) || (found_hit && std::abs(hit.distance - expected) > 1e-3f);
+  }
+  print_rate("ray queries", ray_queries, milliseconds, total, mismatches);
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  size_t largest = 1'000'000;
+  if (argc > 1) largest = std::max<size_t>(1000, std::strtoull(argv[1], nullptr, 10));
+
+  thread_pool pool;
+  std::cout << "workers: " << pool.size() + 1 << std::endl;
+  for (size_t count = std::min<size_t>(100'000, largest); count <= largest; count *= 10) run(count, pool);
+  return 0;
+}
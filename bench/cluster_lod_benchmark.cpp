@@ -0,0 +1,123 @@
+// Generates boulders of growing density, times building their cluster DAGs on the pool, then
+// places a camera at a series of distances and reports the cut: with every page resident, the
+// triangles drawn should follow the rock's size on screen rather than its source triangle count.
+// A second pass starts from the root alone and loads the requested groups a frame's worth at a
+// time, as the runtime does, to show how many frames and what share of the file a view needs.
+//
+// usage: Cluster_Lod_Benchmark [largest resolution]
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <iomanip>
+#include <iostream>
+#include <vector>
+
+#include "cluster_lod/cluster_dag.h"
+#include "utility/thread_pool.h"
+
+namespace {
+
+using clock_type = std::chrono::steady_clock;
+
+constexpr float viewport_width = 1920.0f;
+constexpr float viewport_height = 1080.0f;
+constexpr float distances[] = {10.0f, 20.0f, 40.0f, 80.0f, 160.0f, 320.0f};
+constexpr size_t loads_per_frame = 32;
+
+double to_mib(const size_t bytes) { return static_cast<double>(bytes) / (1024.0 * 1024.0); }
+
+double milliseconds_since(const clock_type::time_point start) {
+  return std::chrono::duration<double, std::milli>(clock_type::now() - start).count();
+}
+
+cluster_dag_view view_from(const float distance) {
+  const glm::mat4 projection = glm::perspective(glm::radians(60.0f), viewport_width / viewport_height, 0.1f, 5000.0f);
+  const glm::vec3 position(0.0f, 1.0f, distance);
+  const glm::mat4 view = glm::lookAt(position, glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+
+  cluster_dag_view result;
+  result.position = position;
+  result.planes = extract_frustum(projection * view);
+  result.projection_scale = projection[1][1] * 0.5f * viewport_height;
+  return result;
+}
+
+size_t triangles(const cluster_dag_file &file, const std::vector<cluster_dag_draw> &cut) {
+  size_t count = 0;
+  for (const cluster_dag_draw &draw : cut) count += file.clusters(draw.group)[draw.cluster].triangle_count;
+  return count;
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  int32_t largest = 512;
+  if (argc > 1) largest = std::max(16, std::atoi(argv[1]));
+
+  thread_pool pool;
+  std::cout << "workers: " << pool.size() + 1 << std::endl;
+
+  const std::filesystem::path directory = std::filesystem::temp_directory_path() / "cluster_lod_benchmark";
+  std::filesystem::create_directories(directory);
+
+  for (int32_t resolution = std::max(16, largest / 8); resolution <= largest; resolution *= 2) {
+    boulder_settings generator;
+    generator.resolution = resolution;
+    const dense_mesh mesh = generate_boulder(generator, pool);
+
+    const std::filesystem::path path = directory / ("boulder" + std::to_string(resolution) + ".cdag");
+    auto start = clock_type::now();
+    if (!write_cluster_dag(path, mesh, {}, pool)) {
+      std::cout << "Failed to write " << path << std::endl;
+      return 1;
+    }
+    const double build_ms = milliseconds_since(start);
+    const cluster_dag_file file = open_cluster_dag(path);
+    if (file.empty()) return 1;
+
+    std::cout << std::fixed << std::setprecision(1) << "boulder " << resolution << ": " << mesh.triangle_count()
+              << " triangles built in " << build_ms << " ms into " << file.group_count << " groups over "
+              << file.level_count << " levels, " << to_mib(file.file->size()) << " MiB" << std::endl;
+
+    std::vector<cluster_dag_draw> cut;
+    std::vector<cluster_dag_request> requests;
+    for (const float distance : distances) {
+      const cluster_dag_view view = view_from(distance);
+
+      std::vector<uint8_t> resident(file.group_count, 1);
+      start = clock_type::now();
+      select_cluster_cut(file, resident, view, cut, requests);
+      const double select_ms = milliseconds_since(start);
+      const size_t all_resident = triangles(file, cut);
+
+      // From the root alone, a frame's worth of requests at a time until nothing is missing.
+      std::fill(resident.begin(), resident.end(), 0);
+      resident[file.root_group] = 1;
+      int32_t frames = 0;
+      for (select_cluster_cut(file, resident, view, cut, requests); !requests.empty();
+           select_cluster_cut(file, resident, view, cut, requests)) {
+        for (size_t i = 0; i < std::min(requests.size(), loads_per_frame); ++i) resident[requests[i].group] = 1;
+        ++frames;
+      }
+      size_t resident_bytes = 0;
+      for (uint32_t g = 0; g < file.group_count; ++g) {
+        if (resident[g] != 0) resident_bytes += cluster_dag_page_bytes(file.groups[g]);
+      }
+
+      std::cout << "  at " << std::setw(5) << std::setprecision(0) << distance << " m: " << std::setw(8)
+                << all_resident << " triangles in " << std::setw(5) << cut.size() << " clusters, cut in "
+                << std::setprecision(3) << select_ms << " ms; streamed in " << std::setw(3) << frames
+                << " frames with " << std::setprecision(1) << std::setw(5)
+                << 100.0 * static_cast<double>(resident_bytes) / static_cast<double>(file.file->size())
+                << "% of the file resident" << std::endl;
+    }
+  }
+
+  std::error_code error;
+  std::filesystem::remove_all(directory, error);
+  return 0;
+}
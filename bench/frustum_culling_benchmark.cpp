@@ -0,0 +1,150 @@
+// Scatters a million objects through a 2 km cube around the camera and culls them against the view
+// frustum as it turns: one object at a time with frustum.h as the reference, then the SoA sets of
+// frustum_culling.h on one thread and on the pool. Reports nanoseconds per object and checks that
+// every path finds the same visible objects.
+//
+// usage: Frustum_Culling_Benchmark [object count]
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "render/frustum.h"
+#include "render/frustum_culling.h"
+#include "utility/simd.h"
+#include "utility/thread_pool.h"
+
+namespace {
+
+using clock_type = std::chrono::steady_clock;
+
+constexpr int32_t view_count = 32;
+constexpr float half_size = 1000.0f;
+
+double milliseconds_since(const clock_type::time_point start) {
+  return std::chrono::duration<double, std::milli>(clock_type::now() - start).count();
+}
+
+// The camera at the centre of the cube, turning a full circle and looking slightly down.
+std::vector<frustum> make_views() {
+  const glm::mat4 projection = glm::perspective(glm::radians(60.0f), 16.0f / 9.0f, 0.1f, 1500.0f);
+  std::vector<frustum> views;
+  for (int32_t i = 0; i < view_count; ++i) {
+    const float heading = glm::two_pi<float>() * static_cast<float>(i) / view_count;
+    const glm::vec3 forward(std::sin(heading), -0.2f, -std::cos(heading));
+    views.push_back(extract_frustum(projection * glm::lookAt(glm::vec3(0.0f), forward, glm::vec3(0.0f, 1.0f, 0.0f))));
+  }
+  return views;
+}
+
+struct timing {
+  double nanoseconds_per_object = 0.0;
+  size_t visible = 0;
+  size_t mismatched_views = 0;
+};
+
+// Runs `cull` for every view and compares its result with `reference`, one list per view.
+template <typename F>
+timing measure(const size_t count, const std::vector<frustum> &views,
+               const std::vector<std::vector<uint32_t>> &reference, F &&cull) {
+  timing result;
+  std::vector<uint32_t> visible;
+  double milliseconds = 0.0;
+  for (size_t v = 0; v < views.size(); ++v) {
+    const auto start = clock_type::now();
+    cull(views[v], visible);
+    milliseconds += milliseconds_since(start);
+    result.visible += visible.size();
+    if (!reference.empty() && visible != reference[v]) ++result.mismatched_views;
+  }
+  result.nanoseconds_per_object = milliseconds * 1e6 / static_cast<double>(count * views.size());
+  result.visible /= views.size();
+  return result;
+}
+
+void print(const std::string &name, const timing &result, const double baseline) {
+  std::cout << "    " << std::left << std::setw(22) << name << std::right << std::fixed << std::setprecision(2)
+            << std::setw(8) << result.nanoseconds_per_object << " ns/object, " << std::setw(6)
+            << baseline / result.nanoseconds_per_object << "x, " << result.visible << " visible, "
+            << result.mismatched_views << " views differ from the reference" << std::endl;
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  size_t count = 1'000'000;
+  if (argc > 1) count = std::max<size_t>(1, std::strtoull(argv[1], nullptr, 10));
+
+  thread_pool pool;
+  std::cout << "workers: " << pool.size() + 1 << ", instruction set: " << simd_instruction_set_name() << std::endl;
+
+  std::mt19937 random(7);
+  std::uniform_real_distribution<float> coordinate(-half_size, half_size);
+  std::uniform_real_distribution<float> size(0.5f, 5.0f);
+
+  std::vector<glm::vec4> sphere_list(count);
+  std::vector<std::pair<glm::vec3, glm::vec3>> box_list(count);
+  bounding_sphere_set spheres;
+  bounding_box_set boxes;
+  spheres.reserve(count);
+  boxes.reserve(count);
+  for (size_t i = 0; i < count; ++i) {
+    const glm::vec3 centre(coordinate(random), coordinate(random), coordinate(random));
+    const glm::vec3 extent(size(random), size(random), size(random));
+    sphere_list[i] = glm::vec4(centre, glm::length(extent));
+    box_list[i] = {centre - extent, centre + extent};
+    spheres.add(centre, sphere_list[i].w);
+    boxes.add(centre - extent, centre + extent);
+  }
+
+  const std::vector<frustum> views = make_views();
+  std::cout << count << " objects, " << views.size() << " views" << std::endl;
+
+  std::vector<std::vector<uint32_t>> reference(views.size());
+  std::cout << "  spheres:" << std::endl;
+  size_t v = 0;
+  const timing scalar_spheres = measure(count, views, {}, [&](const frustum &planes, std::vector<uint32_t> &out) {
+    out.clear();
+    for (uint32_t i = 0; i < count; ++i) {
+      if (is_sphere_visible(planes, glm::vec3(sphere_list[i]), sphere_list[i].w)) out.push_back(i);
+    }
+    reference[v++] = out;
+  });
+  print("one at a time", scalar_spheres, scalar_spheres.nanoseconds_per_object);
+  print("SoA, one thread",
+        measure(count, views, reference,
+                [&](const frustum &planes, std::vector<uint32_t> &out) { cull_spheres(planes, spheres, out); }),
+        scalar_spheres.nanoseconds_per_object);
+  print("SoA, pool",
+        measure(count, views, reference,
+                [&](const frustum &planes, std::vector<uint32_t> &out) { cull_spheres(planes, spheres, pool, out); }),
+        scalar_spheres.nanoseconds_per_object);
+
+  std::cout << "  boxes:" << std::endl;
+  v = 0;
+  const timing scalar_boxes = measure(count, views, {}, [&](const frustum &planes, std::vector<uint32_t> &out) {
+    out.clear();
+    for (uint32_t i = 0; i < count; ++i) {
+      if (test_aabb(planes, box_list[i].first, box_list[i].second) != frustum_test::outside) out.push_back(i);
+    }
+    reference[v++] = out;
+  });
+  print("one at a time", scalar_boxes, scalar_boxes.nanoseconds_per_object);
+  print("SoA, one thread",
+        measure(count, views, reference,
+                [&](const frustum &planes, std::vector<uint32_t> &out) { cull_boxes(planes, boxes, out); }),
+        scalar_boxes.nanoseconds_per_object);
+  print("SoA, pool",
+        measure(count, views, reference,
+                [&](const frustum &planes, std::vector<uint32_t> &out) { cull_boxes(planes, boxes, pool, out); }),
+        scalar_boxes.nanoseconds_per_object);
+  return 0;
+}
@@ -0,0 +1,168 @@
+// Times the float conversions behind HDR texture uploads on a synthetic 4096x2048 environment map
+// (plus every .hdr file found under the given directory): scalar against SIMD half conversion,
+// R11G11B10F packing, RGBE/RGBM encoding with their round-trip error, and the memory each format
+// needs for a full mip chain.
+//
+// usage: Hdr_Conversion_Benchmark [assets directory]
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <filesystem>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "texture/hdr_image.h"
+#include "utility/simd.h"
+
+namespace {
+
+// A sky-like gradient with a sun several thousand times brighter than the horizon, so every
+// format sees both the low and the high end of the range.
+hdr_image synthetic_environment(const int32_t width, const int32_t height) {
+  hdr_image result;
+  result.width = width;
+  result.height = height;
+  result.channels = 4;
+  result.pixels.resize(static_cast<size_t>(width) * height * 4);
+
+  for (int32_t y = 0; y < height; ++y) {
+    const float elevation = 1.0f - (static_cast<float>(y) + 0.5f) / height * 2.0f;
+    for (int32_t x = 0; x < width; ++x) {
+      const float azimuth = (static_cast<float>(x) + 0.5f) / width;
+      const float sun_distance = std::hypot(azimuth - 0.3f, (elevation - 0.4f) * 0.5f);
+      const float sun = 4096.0f * std::exp(-sun_distance * sun_distance * 20000.0f);
+      const float sky = elevation > 0.0f ? 0.2f + 0.8f * elevation : 0.05f * (1.0f + elevation);
+
+      float *pixel = &result.pixels[(static_cast<size_t>(y) * width + x) * 4];
+      pixel[0] = sky * 0.6f + sun;
+      pixel[1] = sky * 0.8f + sun * 0.9f;
+      pixel[2] = sky * 1.2f + sun * 0.7f;
+      pixel[3] = 1.0f;
+    }
+  }
+
+  return result;
+}
+
+template <typename Function>
+double time_ms(const Function &function, const int32_t repeats = 5) {
+  double best = 1.0e30;
+  for (int32_t i = 0; i < repeats; ++i) {
+    const auto start = std::chrono::steady_clock::now();
+    function();
+    const std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+    best = std::min(best, elapsed.count());
+  }
+  return best;
+}
+
+// Largest relative error of the RGB channels after a round trip, ignoring texels too dark to
+// matter on screen. RGBM clamps everything above hdr_rgbm_range, so bright sources show up here.
+float max_relative_error(const hdr_image &reference, const hdr_image &decoded) {
+  float worst = 0.0f;
+  const auto pixels = static_cast<size_t>(reference.width) * reference.height;
+  for (size_t i = 0; i < pixels; ++i) {
+    for (int32_t c = 0; c < 3; ++c) {
+      const float expected = reference.pixels[i * reference.channels + c];
+      if (expected < 1.0e-3f) continue;
+      const float error = std::abs(decoded.pixels[i * 4 + c] - expected) / expected;
+      worst = std::max(worst, error);
+    }
+  }
+  return worst;
+}
+
+size_t mip_chain_bytes(const int32_t width, const int32_t height, const hdr_format format) {
+  size_t bytes = 0;
+  for (int32_t w = width, h = height;; w = std::max(1, w / 2), h = std::max(1, h / 2)) {
+    bytes += static_cast<size_t>(w) * h * hdr_format_texel_bytes(format);
+    if (w == 1 && h == 1) break;
+  }
+  return bytes;
+}
+
+void run(const std::string &name, const hdr_image &source) {
+  const double megapixels = static_cast<double>(source.width) * source.height / 1.0e6;
+  const std::vector<float> &values = source.pixels;
+  std::vector<uint16_t> scalar(values.size()), simd(values.size());
+
+  std::cout << name << " (" << source.width << "x" << source.height << ", " << source.channels << " channels)"
+            << std::endl;
+
+  const double scalar_ms = time_ms([&]() {
+    for (size_t i = 0; i < values.size(); ++i) scalar[i] = float_to_half(values[i]);
+  });
+  const double simd_ms = time_ms([&]() { convert_float_to_half(values.data(), simd.data(), values.size()); });
+  size_t mismatches = 0;
+  for (size_t i = 0; i < values.size(); ++i) mismatches += scalar[i] != simd[i];
+
+  std::cout << std::fixed << std::setprecision(2) << "  float->half scalar " << std::setw(8) << scalar_ms << " ms, "
+            << std::setw(8) << megapixels / scalar_ms * 1000.0 << " MPixel/s" << std::endl;
+  std::cout << "  float->half simd   " << std::setw(8) << simd_ms << " ms, " << std::setw(8)
+            << megapixels / simd_ms * 1000.0 << " MPixel/s (" << scalar_ms / simd_ms << "x, " << mismatches
+            << " mismatches)" << std::endl;
+
+  std::vector<float> back(values.size());
+  const double back_ms = time_ms([&]() { convert_half_to_float(simd.data(), back.data(), back.size()); });
+  std::cout << "  half->float simd   " << std::setw(8) << back_ms << " ms, " << std::setw(8)
+            << megapixels / back_ms * 1000.0 << " MPixel/s" << std::endl;
+
+  const auto pixels = static_cast<size_t>(source.width) * source.height;
+  std::vector<uint32_t> packed_scalar(pixels), packed(pixels);
+  const double pack_scalar_ms = time_ms([&]() {
+    for (size_t i = 0; i < pixels; ++i) {
+      const float *pixel = &values[i * source.channels];
+      packed_scalar[i] = pack_r11g11b10f(pixel[0], pixel[1], pixel[2]);
+    }
+  });
+  const double pack_ms =
+      time_ms([&]() { convert_to_r11g11b10f(values.data(), source.channels, packed.data(), pixels); });
+  size_t pack_mismatches = 0;
+  for (size_t i = 0; i < pixels; ++i) pack_mismatches += packed_scalar[i] != packed[i];
+  std::cout << "  r11g11b10f scalar  " << std::setw(8) << pack_scalar_ms << " ms, " << std::setw(8)
+            << megapixels / pack_scalar_ms * 1000.0 << " MPixel/s" << std::endl;
+  std::cout << "  r11g11b10f simd    " << std::setw(8) << pack_ms << " ms, " << std::setw(8)
+            << megapixels / pack_ms * 1000.0 << " MPixel/s (" << pack_scalar_ms / pack_ms << "x, "
+            << pack_mismatches << " mismatches)" << std::endl;
+
+  std::cout << std::left << std::setw(14) << "  format" << std::right << std::setw(12) << "encode ms" << std::setw(12)
+            << "max rel err" << std::setw(14) << "chain MiB" << std::setw(12) << "vs 32F" << std::endl;
+
+  const size_t reference_bytes = mip_chain_bytes(source.width, source.height, hdr_format::rgba32f);
+  for (const hdr_format format :
+       {hdr_format::rgba32f, hdr_format::rgba16f, hdr_format::r11g11b10f, hdr_format::rgbe, hdr_format::rgbm}) {
+    std::vector<uint8_t> texels;
+    const double encode_ms = time_ms([&]() { texels = encode_hdr_image(source, format); }, 3);
+    const hdr_image decoded = decode_hdr_texels(texels.data(), source.width, source.height, format);
+    const size_t bytes = mip_chain_bytes(source.width, source.height, format);
+
+    std::cout << "  " << std::left << std::setw(12) << hdr_format_name(format) << std::right << std::setprecision(2)
+              << std::setw(12) << encode_ms << std::setprecision(4) << std::setw(12)
+              << max_relative_error(source, decoded) << std::setprecision(1) << std::setw(14)
+              << static_cast<double>(bytes) / (1024.0 * 1024.0) << std::setw(11)
+              << 100.0 * static_cast<double>(bytes) / static_cast<double>(reference_bytes) << "%" << std::endl;
+  }
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  const std::filesystem::path directory = argc > 1 ? argv[1] : "assets";
+
+  std::cout << "SIMD: " << simd_instruction_set_name() << std::endl;
+  run("synthetic environment", synthetic_environment(4096, 2048));
+
+  if (std::filesystem::is_directory(directory)) {
+    for (const auto &entry : std::filesystem::recursive_directory_iterator(directory)) {
+      if (entry.path().extension() != ".hdr") continue;
+
+      const hdr_image source = load_hdr_image(entry.path().string());
+      if (!source.empty()) run(entry.path().filename().string(), source);
+    }
+  }
+
+  return 0;
+}
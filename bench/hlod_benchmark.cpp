@@ -0,0 +1,129 @@
+// Generates a city of a thousand blocks, times building its HLOD proxies on the pool, then flies a
+// camera across it and compares, frame by frame, drawing every visible object against swapping
+// distant clusters for their proxies: draw calls, triangles submitted and the CPU time of choosing
+// what to draw. GPU time needs a window: in the engine, L toggles the proxies and prints the GPU time
+// of drawing the town with and without them.
+//
+// usage: Hlod_Benchmark [blocks per side]
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "hlod/hlod.h"
+#include "hlod/hlod_builder.h"
+#include "hlod/static_scene.h"
+#include "utility/thread_pool.h"
+
+namespace {
+
+using clock_type = std::chrono::steady_clock;
+
+constexpr float viewport_width = 1920.0f;
+constexpr float viewport_height = 1080.0f;
+constexpr float switch_pixels = 200.0f;
+constexpr int32_t frame_count = 600;
+
+double to_mib(const size_t bytes) { return static_cast<double>(bytes) / (1024.0 * 1024.0); }
+
+double milliseconds_since(const clock_type::time_point start) {
+  return std::chrono::duration<double, std::milli>(clock_type::now() - start).count();
+}
+
+struct fly_result {
+  std::vector<double> draw_calls;
+  std::vector<double> triangles;
+  std::vector<double> milliseconds;
+};
+
+void print_series(const std::string &name, std::vector<double> values, const int32_t precision) {
+  std::sort(values.begin(), values.end());
+  double total = 0.0;
+  for (const double value : values) total += value;
+  const auto percentile = [&](const double fraction) {
+    return values[std::min(values.size() - 1, static_cast<size_t>(fraction * values.size()))];
+  };
+  std::cout << "    " << std::left << std::setw(16) << name << std::right << std::fixed << std::setprecision(precision)
+            << "mean " << std::setw(12) << total / values.size() << ", p50 " << std::setw(12) << percentile(0.5)
+            << ", p99 " << std::setw(12) << percentile(0.99) << ", max " << std::setw(12) << values.back() << std::endl;
+}
+
+// A low pass over the rooftops from one corner of the city to the other, looking ahead and slightly
+// down, so the near blocks are drawn in full and the far ones fill the rest of the view.
+fly_result fly(const hlod_selector &selector, const glm::vec3 &min, const glm::vec3 &max, const bool use_proxies) {
+  const glm::mat4 projection = glm::perspective(glm::radians(60.0f), viewport_width / viewport_height, 0.1f, 5000.0f);
+  const float projection_scale = projection[1][1] * 0.5f * viewport_height;
+
+  fly_result result;
+  hlod_selection selection;
+  for (int32_t frame = 0; frame < frame_count; ++frame) {
+    const float t = static_cast<float>(frame) / static_cast<float>(frame_count - 1);
+    const glm::vec3 position(glm::mix(min.x, max.x, t), 40.0f, glm::mix(max.z, min.z, t));
+    const float heading = glm::radians(-45.0f + 90.0f * t);
+    const glm::vec3 forward = glm::normalize(glm::vec3(std::sin(heading), -0.15f, -std::cos(heading)));
+    const glm::mat4 view = glm::lookAt(position, position + forward, glm::vec3(0.0f, 1.0f, 0.0f));
+
+    const auto start = clock_type::now();
+    selector.select(position, projection * view, projection_scale, switch_pixels, use_proxies, selection);
+    result.milliseconds.push_back(milliseconds_since(start));
+    result.draw_calls.push_back(static_cast<double>(selection.objects.size() + selection.clusters.size()));
+    result.triangles.push_back(static_cast<double>(selection.triangles));
+  }
+  return result;
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  city_settings city;
+  if (argc > 1) city.blocks = std::max(1, std::atoi(argv[1]));
+
+  thread_pool pool;
+  std::cout << "workers: " << pool.size() + 1 << std::endl;
+
+  auto start = clock_type::now();
+  const static_scene scene = generate_city(city);
+  std::cout << std::fixed << std::setprecision(1) << city.blocks << "x" << city.blocks << " blocks generated in "
+            << milliseconds_since(start) << " ms: " << scene.objects.size() << " objects, " << scene.triangle_count()
+            << " triangles, " << scene.meshes.size() << " meshes, " << scene.materials.size() << " materials"
+            << std::endl;
+
+  const hlod_build_settings settings;
+  start = clock_type::now();
+  const hlod_set set = build_hlod(scene, settings, pool);
+  const double build_ms = milliseconds_since(start);
+
+  const size_t proxy_triangles = std::max<size_t>(1, set.indices.size() / 3);
+  std::cout << "  built " << set.clusters.size() << " clusters of " << settings.cluster_size << " m in " << build_ms
+            << " ms: " << set.indices.size() / 3 << " proxy triangles (" << std::setprecision(2)
+            << static_cast<double>(scene.triangle_count()) / static_cast<double>(proxy_triangles) << "x fewer), "
+            << to_mib(set.atlas.size()) << " MiB of atlas" << std::endl;
+
+  glm::vec3 min(0.0f), max(0.0f);
+  if (!set.empty()) {
+    min = set.clusters.front().min;
+    max = set.clusters.front().max;
+    for (const hlod_cluster &cluster : set.clusters) {
+      min = glm::min(min, cluster.min);
+      max = glm::max(max, cluster.max);
+    }
+  }
+
+  const hlod_selector selector(scene, set);
+  for (const bool use_proxies : {false, true}) {
+    const fly_result result = fly(selector, min, max, use_proxies);
+    std::cout << "  " << frame_count << " frames " << (use_proxies ? "with" : "without") << " HLOD, switching at "
+              << std::setprecision(0) << switch_pixels << " pixels:" << std::endl;
+    print_series("draw calls", result.draw_calls, 0);
+    print_series("triangles", result.triangles, 0);
+    print_series("selection ms", result.milliseconds, 3);
+  }
+  return 0;
+}
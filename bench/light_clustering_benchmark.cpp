@@ -0,0 +1,136 @@
+// Scatters point lights over a 400 m square of streets around a camera at eye height and assigns
+// them to a light_grid's clusters as the camera turns, on one thread and on the pool, for 1 to 10k
+// lights. Reports the assignment time, how many lights a fragment loops over with and without the
+// clusters, and checks at random points in the frustum that every light reaching the point is in its
+// cluster's list and that both paths build the same lists.
+//
+// usage: Light_Clustering_Benchmark [tiles x] [tiles y] [slices]
+
+#include <glm/gtc/constants.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include "render/light_grid.h"
+#include "utility/simd.h"
+#include "utility/thread_pool.h"
+
+namespace {
+
+using clock_type = std::chrono::steady_clock;
+
+constexpr int32_t view_count = 32;
+constexpr int32_t samples_per_view = 4096;
+constexpr float half_size = 200.0f;
+constexpr float field_of_view = glm::radians(45.0f);
+constexpr float aspect = 16.0f / 9.0f;
+constexpr float z_near = 0.1f;
+constexpr float z_far = 1000.0f;
+constexpr float sample_depth = 150.0f;  // most fragments of a street view are closer than this
+
+double milliseconds_since(const clock_type::time_point start) {
+  return std::chrono::duration<double, std::milli>(clock_type::now() - start).count();
+}
+
+std::vector<point_light> make_lights(const size_t count, std::mt19937 &random) {
+  std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+  std::vector<point_light> lights(count);
+  for (point_light &light : lights) {
+    light.position = glm::vec3(-half_size + 2.0f * half_size * unit(random), 0.5f + 5.5f * unit(random),
+                               -half_size + 2.0f * half_size * unit(random));
+    light.radius = 3.0f + 7.0f * unit(random);
+    light.colour = glm::vec3(unit(random), unit(random), unit(random));
+  }
+  return lights;
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  light_grid_settings settings;
+  if (argc > 1) settings.tiles_x = std::max(1, std::atoi(argv[1]));
+  if (argc > 2) settings.tiles_y = std::max(1, std::atoi(argv[2]));
+  if (argc > 3) settings.slices = std::max(1, std::atoi(argv[3]));
+
+  thread_pool pool;
+  std::cout << "workers: " << pool.size() + 1 << ", " << simd_instruction_set_name() << ", " << settings.tiles_x
+            << "x" << settings.tiles_y << "x" << settings.slices << " clusters" << std::endl;
+
+  const float tan_half_y = std::tan(field_of_view / 2.0f), tan_half_x = tan_half_y * aspect;
+  std::vector<glm::mat4> views;
+  for (int32_t i = 0; i < view_count; ++i) {
+    const float heading = glm::two_pi<float>() * static_cast<float>(i) / view_count;
+    const glm::vec3 eye(0.0f, 1.8f, 0.0f), forward(std::sin(heading), -0.1f, -std::cos(heading));
+    views.push_back(glm::lookAt(eye, eye + forward, glm::vec3(0.0f, 1.0f, 0.0f)));
+  }
+
+  std::mt19937 random(3);
+  std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+  light_grid serial(settings), parallel(settings);
+  serial.set_projection(field_of_view, aspect, z_near, z_far);
+  parallel.set_projection(field_of_view, aspect, z_near, z_far);
+
+  for (const size_t count : {1, 10, 100, 1000, 10000}) {
+    const std::vector<point_light> lights = make_lights(count, random);
+    double serial_ms = 0.0, parallel_ms = 0.0;
+    size_t in_view = 0, references = 0, mismatched_views = 0;
+    uint32_t max_per_cluster = 0;
+    size_t looped = 0, reaching = 0, missed = 0;
+
+    for (const glm::mat4 &view : views) {
+      auto start = clock_type::now();
+      serial.assign(lights, view);
+      serial_ms += milliseconds_since(start);
+      start = clock_type::now();
+      parallel.assign(lights, view, pool);
+      parallel_ms += milliseconds_since(start);
+      mismatched_views += serial.light_ranges() != parallel.light_ranges() ||
+                          serial.light_indices() != parallel.light_indices();
+      in_view += serial.stats().lights_in_view;
+      references += serial.stats().references;
+      max_per_cluster = std::max(max_per_cluster, serial.stats().max_per_cluster);
+
+      // Points through random pixels at depths spread like a street view's: every light whose
+      // sphere holds the point must be in the list the point's fragment reads.
+      const glm::mat4 to_world = glm::inverse(view);
+      for (int32_t s = 0; s < samples_per_view; ++s) {
+        const float ndc_x = 2.0f * unit(random) - 1.0f, ndc_y = 2.0f * unit(random) - 1.0f;
+        const float depth = z_near * std::pow(sample_depth / z_near, unit(random));
+        const glm::vec3 point = glm::vec3(to_world * glm::vec4(ndc_x * depth * tan_half_x,
+                                                               ndc_y * depth * tan_half_y, -depth, 1.0f));
+        const int32_t x =
+            std::min(static_cast<int32_t>((ndc_x + 1.0f) * 0.5f * settings.tiles_x), settings.tiles_x - 1);
+        const int32_t y =
+            std::min(static_cast<int32_t>((ndc_y + 1.0f) * 0.5f * settings.tiles_y), settings.tiles_y - 1);
+        const glm::uvec2 range = serial.light_ranges()[serial.cluster_index(x, y, serial.slice_of(depth))];
+        looped += range.y;
+        const uint32_t *first = serial.light_indices().data() + range.x, *last = first + range.y;
+        for (uint32_t light = 0; light < lights.size(); ++light) {
+          const glm::vec3 offset = lights[light].position - point;
+          if (glm::dot(offset, offset) > lights[light].radius * lights[light].radius) continue;
+          ++reaching;
+          missed += !std::binary_search(first, last, light);
+        }
+      }
+    }
+
+    const double samples = static_cast<double>(view_count) * samples_per_view;
+    std::cout << std::fixed << std::setprecision(3) << std::setw(6) << count << " lights: assign "
+              << serial_ms / view_count << " ms, " << parallel_ms / view_count << " ms on the pool; "
+              << std::setprecision(1) << static_cast<double>(in_view) / view_count << " in view, "
+              << static_cast<double>(references) / view_count << " references, at most " << max_per_cluster
+              << " in a cluster" << std::endl;
+    std::cout << "              per fragment " << std::setprecision(2) << static_cast<double>(looped) / samples
+              << " lights looped over instead of " << count << ", " << static_cast<double>(reaching) / samples
+              << " reaching it; " << missed << " missed, " << mismatched_views << " views differ on the pool"
+              << std::endl;
+  }
+  return 0;
+}
@@ -0,0 +1,127 @@
+// Upscales every PNG under assets/textures to 4K and 8K and times full mip chain generation with
+// each filter, then builds the chains of all 4K textures in one batch.
+//
+// usage: Mip_Generation_Benchmark [textures directory]
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <filesystem>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "texture/mip_generator.h"
+#include "utility/simd.h"
+#include "utility/thread_pool.h"
+
+namespace {
+
+// Bilinear resize of an RGBA image to size x size.
+image upscale(const image &rgba, const int32_t size, thread_pool &pool) {
+  image result;
+  result.width = size;
+  result.height = size;
+  result.channels = 4;
+  result.pixels.resize(static_cast<size_t>(size) * size * 4);
+
+  const auto texel = [&](const int32_t x, const int32_t y, const int32_t c) -> float {
+    return rgba.pixels[(static_cast<size_t>(std::clamp(y, 0, rgba.height - 1)) * rgba.width +
+                        std::clamp(x, 0, rgba.width - 1)) *
+                           4 +
+                       c];
+  };
+
+  pool.parallel_for(0, static_cast<size_t>(size), [&](const size_t y) {
+    const float source_y = (static_cast<float>(y) + 0.5f) * rgba.height / size - 0.5f;
+    const auto y0 = static_cast<int32_t>(std::floor(source_y));
+    const float fy = source_y - y0;
+
+    for (int32_t x = 0; x < size; ++x) {
+      const float source_x = (static_cast<float>(x) + 0.5f) * rgba.width / size - 0.5f;
+      const auto x0 = static_cast<int32_t>(std::floor(source_x));
+      const float fx = source_x - x0;
+
+      for (int32_t c = 0; c < 4; ++c) {
+        const float top = texel(x0, y0, c) + (texel(x0 + 1, y0, c) - texel(x0, y0, c)) * fx;
+        const float bottom = texel(x0, y0 + 1, c) + (texel(x0 + 1, y0 + 1, c) - texel(x0, y0 + 1, c)) * fx;
+        result.pixels[(y * size + x) * 4 + c] = static_cast<uint8_t>(top + (bottom - top) * fy + 0.5f);
+      }
+    }
+  });
+
+  return result;
+}
+
+double megapixels(const image &source) { return static_cast<double>(source.width) * source.height / 1.0e6; }
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  const std::filesystem::path directory = argc > 1 ? argv[1] : "assets/textures";
+
+  std::vector<image> sources;
+  std::vector<std::string> names;
+  for (const auto &entry : std::filesystem::directory_iterator(directory)) {
+    if (entry.path().extension() != ".png") continue;
+
+    const image source = load_image(entry.path().string(), 4);
+    if (source.empty()) continue;
+
+    sources.push_back(source);
+    names.push_back(entry.path().filename().string());
+  }
+
+  if (sources.empty()) {
+    std::cout << "No PNG images found in " << directory << std::endl;
+    return 1;
+  }
+
+  thread_pool pool;
+  std::cout << "SIMD: " << simd_instruction_set_name() << ", workers: " << pool.size() + 1 << std::endl;
+  std::cout << std::left << std::setw(28) << "texture" << std::setw(8) << "size" << std::setw(10) << "filter"
+            << std::right << std::setw(12) << "ms" << std::setw(12) << "MPixel/s" << std::endl;
+
+  constexpr mip_filter filters[] = {mip_filter::box, mip_filter::kaiser, mip_filter::lanczos};
+  constexpr int32_t sizes[] = {4096, 8192};
+
+  mip_settings settings;
+  settings.srgb = true;
+
+  for (size_t i = 0; i < sources.size(); ++i) {
+    for (const int32_t size : sizes) {
+      const image source = upscale(sources[i], size, pool);
+
+      for (const mip_filter filter : filters) {
+        settings.filter = filter;
+
+        const auto start = std::chrono::steady_clock::now();
+        const std::vector<image> chain = generate_mip_chain(source, settings, pool);
+        const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+        std::cout << std::left << std::setw(28) << names[i] << std::setw(8) << (size == 4096 ? "4K" : "8K")
+                  << std::setw(10) << mip_filter_name(filter) << std::right << std::fixed << std::setprecision(1)
+                  << std::setw(12) << elapsed.count() * 1000.0 << std::setw(12) << megapixels(source) / elapsed.count()
+                  << std::endl;
+      }
+    }
+  }
+
+  std::vector<image> batch;
+  double batch_megapixels = 0.0;
+  for (const image &source : sources) {
+    batch.push_back(upscale(source, 4096, pool));
+    batch_megapixels += megapixels(batch.back());
+  }
+
+  settings.filter = mip_filter::kaiser;
+  const auto start = std::chrono::steady_clock::now();
+  const std::vector<std::vector<image>> chains = generate_mip_chains(batch, settings, pool);
+  const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+  std::cout << "batch of " << chains.size() << " 4K textures, kaiser: " << std::setprecision(1)
+            << elapsed.count() * 1000.0 << " ms, " << batch_megapixels / elapsed.count() << " MPixel/s" << std::endl;
+
+  return 0;
+}
@@ -0,0 +1,271 @@
+// Builds a dense town of box buildings with 200k small objects among and inside them, draws the
+// buildings into an occlusion_buffer from street level and tests every object against it. Reports
+// rasterization time on one thread and on the pool and test time per object, then checks accuracy
+// against an exact per-pixel depth buffer of the same size: an object the buffer hides must be
+// hidden in the reference too (a false cull is a bug), and the share of hidden objects it misses
+// shows how much the masked layers give away.
+//
+// usage: Occlusion_Culling_Benchmark [object count]
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include "render/occlusion_buffer.h"
+#include "utility/simd.h"
+#include "utility/thread_pool.h"
+
+namespace {
+
+using clock_type = std::chrono::steady_clock;
+
+constexpr int32_t blocks = 24;  // per side
+constexpr float block_size = 24.0f;
+constexpr float street_width = 8.0f;
+constexpr int32_t repeats = 20;
+
+double milliseconds_since(const clock_type::time_point start) {
+  return std::chrono::duration<double, std::milli>(clock_type::now() - start).count();
+}
+
+struct box {
+  glm::vec3 min;
+  glm::vec3 max;
+};
+
+// The twelve counter-clockwise triangles of a unit cube from 0 to 1, facing out.
+const glm::vec3 cube_positions[] = {{0, 0, 0}, {1, 0, 0}, {1, 1, 0}, {0, 1, 0},
+                                    {0, 0, 1}, {1, 0, 1}, {1, 1, 1}, {0, 1, 1}};
+const uint32_t cube_indices[] = {0, 2, 1, 0, 3, 2, 4, 5, 6, 4, 6, 7, 0, 1, 5, 0, 5, 4,
+                                 3, 6, 2, 3, 7, 6, 0, 4, 7, 0, 7, 3, 1, 2, 6, 1, 6, 5};
+
+glm::mat4 box_model(const box &b) {
+  return glm::scale(glm::translate(glm::mat4(1.0f), b.min), b.max - b.min);
+}
+
+// An exact depth buffer for reference: every pixel whose centre is inside or on a triangle's edges
+// takes the nearest depth.
+class reference_buffer {
+ public:
+  reference_buffer(const int32_t width, const int32_t height, const glm::mat4 &view_projection)
+      : width_(width), height_(height), view_projection_(view_projection),
+        depths_(static_cast<size_t>(width) * height, 0.0f) {}
+
+  void draw_box(const box &b) {
+    const glm::mat4 transform = view_projection_ * box_model(b);
+    for (size_t i = 0; i < std::size(cube_indices); i += 3) {
+      glm::vec4 polygon[4];
+      int32_t count = 0;
+      glm::vec4 clip[3];
+      for (int32_t v = 0; v < 3; ++v) clip[v] = transform * glm::vec4(cube_positions[cube_indices[i + v]], 1.0f);
+      // Near plane only.
+      for (int32_t v = 0; v < 3; ++v) {
+        const glm::vec4 &from = clip[v], &to = clip[(v + 1) % 3];
+        const float from_distance = from.z + from.w, to_distance = to.z + to.w;
+        if (from_distance >= 0.0f) polygon[count++] = from;
+        if ((from_distance >= 0.0f) != (to_distance >= 0.0f)) {
+          polygon[count++] = from + (to - from) * (from_distance / (from_distance - to_distance));
+        }
+      }
+      for (int32_t v = 1; v + 1 < count; ++v) draw_triangle(polygon[0], polygon[v], polygon[v + 1]);
+    }
+  }
+
+  [[nodiscard]] bool is_visible(const box &b) const {
+    glm::vec2 screen_min(1e30f), screen_max(-1e30f);
+    float nearest = 0.0f;
+    glm::vec4 corners[8];
+    bool beyond[5] = {true, true, true, true, true};
+    bool behind = false;
+    for (int32_t corner = 0; corner < 8; ++corner) {
+      const glm::vec3 point((corner & 1) != 0 ? b.max.x : b.min.x, (corner & 2) != 0 ? b.max.y : b.min.y,
+                            (corner & 4) != 0 ? b.max.z : b.min.z);
+      const glm::vec4 &clip = corners[corner] = view_projection_ * glm::vec4(point, 1.0f);
+      beyond[0] = beyond[0] && clip.x < -clip.w;
+      beyond[1] = beyond[1] && clip.x > clip.w;
+      beyond[2] = beyond[2] && clip.y < -clip.w;
+      beyond[3] = beyond[3] && clip.y > clip.w;
+      beyond[4] = beyond[4] && clip.z < -clip.w;
+      behind = behind || clip.z < -clip.w;
+    }
+    if (std::find(std::begin(beyond), std::end(beyond), true) != std::end(beyond)) return false;
+    if (behind) return true;
+    for (const glm::vec4 &clip : corners) {
+      const glm::vec2 screen = (glm::vec2(clip) / clip.w * 0.5f + 0.5f) * glm::vec2(width_, height_);
+      screen_min = glm::min(screen_min, screen);
+      screen_max = glm::max(screen_max, screen);
+      nearest = std::max(nearest, 1.0f / clip.w);
+    }
+    if (screen_max.x < 0.0f || screen_max.y < 0.0f || screen_min.x >= static_cast<float>(width_) ||
+        screen_min.y >= static_cast<float>(height_)) {
+      return false;
+    }
+    for (int32_t y = std::max(0, static_cast<int32_t>(screen_min.y));
+         y <= std::min(height_ - 1, static_cast<int32_t>(screen_max.y)); ++y) {
+      for (int32_t x = std::max(0, static_cast<int32_t>(screen_min.x));
+           x <= std::min(width_ - 1, static_cast<int32_t>(screen_max.x)); ++x) {
+        if (nearest >= depths_[static_cast<size_t>(y) * width_ + x]) return true;
+      }
+    }
+    return false;
+  }
+
+ private:
+  void draw_triangle(const glm::vec4 &a, const glm::vec4 &b, const glm::vec4 &c) {
+    const glm::vec4 clip[3] = {a, b, c};
+    glm::vec2 screen[3];
+    float depth[3];
+    for (int32_t v = 0; v < 3; ++v) {
+      depth[v] = 1.0f / clip[v].w;
+      screen[v] = (glm::vec2(clip[v]) * depth[v] * 0.5f + 0.5f) * glm::vec2(width_, height_);
+    }
+    const float area = (screen[1].x - screen[0].x) * (screen[2].y - screen[0].y) -
+                       (screen[1].y - screen[0].y) * (screen[2].x - screen[0].x);
+    if (!(area > 0.0f)) return;
+
+    const int32_t x0 = std::max(0, static_cast<int32_t>(std::floor(std::min({screen[0].x, screen[1].x, screen[2].x}))));
+    const int32_t y0 = std::max(0, static_cast<int32_t>(std::floor(std::min({screen[0].y, screen[1].y, screen[2].y}))));
+    const int32_t x1 = std::min(width_ - 1, static_cast<int32_t>(std::max({screen[0].x, screen[1].x, screen[2].x})));
+    const int32_t y1 = std::min(height_ - 1, static_cast<int32_t>(std::max({screen[0].y, screen[1].y, screen[2].y})));
+    for (int32_t y = y0; y <= y1; ++y) {
+      for (int32_t x = x0; x <= x1; ++x) {
+        const glm::vec2 p(static_cast<float>(x) + 0.5f, static_cast<float>(y) + 0.5f);
+        // Barycentric weights, all non-negative inside or on the edges.
+        float weights[3];
+        bool inside = true;
+        for (int32_t e = 0; e < 3; ++e) {
+          const glm::vec2 &from = screen[(e + 1) % 3], &to = screen[(e + 2) % 3];
+          weights[e] = (to.x - from.x) * (p.y - from.y) - (to.y - from.y) * (p.x - from.x);
+          inside = inside && weights[e] >= 0.0f;
+        }
+        if (!inside) continue;
+        const float value = (weights[0] * depth[0] + weights[1] * depth[1] + weights[2] * depth[2]) / area;
+        float &stored = depths_[static_cast<size_t>(y) * width_ + x];
+        stored = std::max(stored, value);
+      }
+    }
+  }
+
+  int32_t width_, height_;
+  glm::mat4 view_projection_;
+  std::vector<float> depths_;
+};
+
+struct view {
+  glm::vec3 eye;
+  glm::vec3 target;
+};
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  size_t object_count = 200'000;
+  if (argc > 1) object_count = std::max<size_t>(1, std::strtoull(argv[1], nullptr, 10));
+
+  thread_pool pool;
+  std::cout << "workers: " << pool.size() + 1 << ", instruction set: " << simd_instruction_set_name() << std::endl;
+
+  // A building of random height filling most of every block, then small objects anywhere in the town.
+  std::mt19937 random(5);
+  std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+  std::vector<box> buildings;
+  const float pitch = block_size + street_width;
+  for (int32_t z = 0; z < blocks; ++z) {
+    for (int32_t x = 0; x < blocks; ++x) {
+      const glm::vec3 corner(x * pitch + street_width * 0.5f, 0.0f, z * pitch + street_width * 0.5f);
+      const float inset = 1.0f + 3.0f * unit(random);
+      buildings.push_back({corner + glm::vec3(inset, 0.0f, inset),
+                           corner + glm::vec3(block_size - inset, 8.0f + 40.0f * unit(random), block_size - inset)});
+    }
+  }
+  const float town_size = blocks * pitch;
+  std::vector<box> objects(object_count);
+  for (box &object : objects) {
+    const glm::vec3 position(town_size * unit(random), 0.0f, town_size * unit(random));
+    const glm::vec3 size = glm::vec3(0.3f, 0.5f, 0.3f) + glm::vec3(1.5f, 3.0f, 1.5f) * unit(random);
+    object = {position, position + size};
+  }
+  std::vector<glm::vec3> positions;
+  std::vector<uint32_t> indices;
+  for (const glm::vec3 &p : cube_positions) positions.push_back(p);
+  indices.assign(std::begin(cube_indices), std::end(cube_indices));
+
+  // Street level along an avenue, across a junction and diagonally over the blocks.
+  const float street = street_width * 0.5f;
+  const view views[] = {
+    {{street, 1.7f, street}, {street, 1.7f, town_size}},
+    {{pitch * 12.0f, 1.7f, pitch * 12.0f}, {town_size, 1.5f, town_size * 0.6f}},
+    {{street, 1.7f, street}, {town_size, 0.0f, town_size}},
+    {{pitch * 3.0f + street, 30.0f, -20.0f}, {town_size * 0.5f, 0.0f, town_size * 0.5f}},
+  };
+
+  occlusion_buffer buffer;
+  const glm::mat4 projection = glm::perspective(glm::radians(60.0f), static_cast<float>(buffer.width()) /
+                                                static_cast<float>(buffer.height()), 0.1f, 2000.0f);
+  std::cout << buildings.size() << " occluders, " << objects.size() << " objects, buffer " << buffer.width() << "x"
+            << buffer.height() << std::endl;
+
+  for (size_t v = 0; v < std::size(views); ++v) {
+    const glm::mat4 view_projection =
+        projection * glm::lookAt(views[v].eye, views[v].target, glm::vec3(0.0f, 1.0f, 0.0f));
+    const auto draw = [&](const bool on_pool) {
+      buffer.begin_frame(view_projection);
+      for (const box &building : buildings) {
+        buffer.add_occluder(positions.data(), sizeof(glm::vec3), indices.data(), indices.size(), box_model(building));
+      }
+      if (on_pool) {
+        buffer.rasterize(pool);
+      } else {
+        buffer.rasterize();
+      }
+    };
+
+    double serial_ms = 0.0, pool_ms = 0.0;
+    for (int32_t r = 0; r < repeats; ++r) {
+      draw(false);
+      serial_ms += buffer.stats().rasterize_ms;
+      draw(true);
+      pool_ms += buffer.stats().rasterize_ms;
+    }
+
+    std::vector<uint8_t> visible(objects.size());
+    auto start = clock_type::now();
+    for (size_t i = 0; i < objects.size(); ++i) visible[i] = buffer.is_visible(objects[i].min, objects[i].max);
+    const double test_ms = milliseconds_since(start);
+    start = clock_type::now();
+    pool.parallel_for(0, objects.size(), [&](const size_t i) {
+      visible[i] = buffer.is_visible(objects[i].min, objects[i].max);
+    }, 1024);
+    const double pool_test_ms = milliseconds_since(start);
+
+    reference_buffer reference(buffer.width(), buffer.height(), view_projection);
+    for (const box &building : buildings) reference.draw_box(building);
+    size_t shown = 0, expected = 0, false_culls = 0, missed = 0;
+    for (size_t i = 0; i < objects.size(); ++i) {
+      const bool truth = reference.is_visible(objects[i]);
+      shown += visible[i];
+      expected += truth;
+      false_culls += truth && !visible[i];
+      missed += !truth && visible[i];
+    }
+
+    std::cout << "  view " << v << ": " << buffer.stats().triangles << " triangles" << std::fixed
+              << std::setprecision(3) << ", rasterized in " << serial_ms / repeats << " ms on one thread and "
+              << pool_ms / repeats << " ms on the pool" << std::endl;
+    std::cout << "    tests: " << std::setprecision(1) << test_ms * 1e6 / objects.size() << " ns/object on one thread, "
+              << pool_test_ms * 1e6 / objects.size() << " ns/object on the pool" << std::endl;
+    std::cout << "    " << shown << " objects drawn of " << objects.size() << ", " << expected
+              << " visible in the exact depth buffer: " << false_culls << " false culls, " << missed << " hidden ("
+              << std::setprecision(2) << 100.0 * missed / std::max<size_t>(1, objects.size() - expected)
+              << "% of hidden) drawn anyway" << std::endl;
+  }
+  return 0;
+}
@@ -0,0 +1,212 @@
+// Bakes the potentially visible sets of a generated town at street level, then checks them against
+// views rendered by ray casting: from random free points in the baked space, every object seen
+// through a grid of pixel rays should be in the set of the camera's cell. Reports the bake time,
+// how well the sets compress, the cost of a lookup, the objects views saw that their cell's set
+// dropped, and how many of the objects in the frustum the set removes.
+//
+// usage: Pvs_Benchmark [blocks per side] [rays per cell]
+
+#include <glm/gtc/constants.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <filesystem>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include "hlod/static_scene.h"
+#include "render/frustum.h"
+#include "scene/bvh.h"
+#include "scene/potentially_visible_set.h"
+#include "utility/thread_pool.h"
+
+namespace {
+
+using clock_type = std::chrono::steady_clock;
+
+constexpr int32_t view_count = 200;
+constexpr int32_t view_width = 96;
+constexpr int32_t view_height = 54;
+constexpr float field_of_view = glm::radians(60.0f);
+constexpr int32_t lookups = 100'000;
+
+double milliseconds_since(const clock_type::time_point start) {
+  return std::chrono::duration<double, std::milli>(clock_type::now() - start).count();
+}
+
+float intersect_triangle(const glm::vec3 &origin, const glm::vec3 &direction, const glm::vec3 &a,
+                         const glm::vec3 &b, const glm::vec3 &c) {
+  const glm::vec3 edge_1 = b - a, edge_2 = c - a;
+  const glm::vec3 p = glm::cross(direction, edge_2);
+  const float determinant = glm::dot(edge_1, p);
+  if (std::abs(determinant) < 1e-12f) return -1.0f;
+  const glm::vec3 to_origin = origin - a;
+  const float u = glm::dot(to_origin, p) / determinant;
+  const glm::vec3 q = glm::cross(to_origin, edge_1);
+  const float v = glm::dot(direction, q) / determinant;
+  if (u < 0.0f || v < 0.0f || u + v > 1.0f) return -1.0f;
+  return glm::dot(edge_2, q) / determinant;
+}
+
+// The object a ray sees first, by its triangles.
+bool trace(const static_scene &scene, const bvh &index, const std::vector<glm::mat4> &to_object,
+           const glm::vec3 &origin, const glm::vec3 &direction, uint32_t &object) {
+  bvh_hit hit;
+  const bool found = index.raycast(origin, direction, 1e4f, hit, [&](const uint32_t candidate, float) {
+    const glm::vec3 local_origin = glm::vec3(to_object[candidate] * glm::vec4(origin, 1.0f));
+    const glm::vec3 local_direction = glm::mat3(to_object[candidate]) * direction;
+    const static_mesh &mesh = scene.meshes[scene.objects[candidate].mesh];
+    float nearest = -1.0f;
+    for (size_t i = 0; i + 2 < mesh.indices.size(); i += 3) {
+      const float distance =
+          intersect_triangle(local_origin, local_direction, mesh.vertices[mesh.indices[i]].position,
+                             mesh.vertices[mesh.indices[i + 1]].position, mesh.vertices[mesh.indices[i + 2]].position);
+      if (distance >= 0.0f && (nearest < 0.0f || distance < nearest)) nearest = distance;
+    }
+    return nearest;
+  });
+  object = hit.object;
+  return found;
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  city_settings city;
+  city.blocks = 4;
+  city.block_size = 30.0f;
+  city.street_width = 10.0f;
+  if (argc > 1) city.blocks = std::max(1, std::atoi(argv[1]));
+
+  thread_pool pool;
+  std::cout << "workers: " << pool.size() + 1 << std::endl;
+
+  const static_scene scene = generate_city(city);
+  glm::vec3 scene_min = scene.objects.front().min, scene_max = scene.objects.front().max;
+  for (const static_object &object : scene.objects) {
+    scene_min = glm::min(scene_min, object.min);
+    scene_max = glm::max(scene_max, object.max);
+  }
+  std::cout << city.blocks << "x" << city.blocks << " blocks: " << scene.objects.size() << " objects, "
+            << scene.triangle_count() << " triangles" << std::endl;
+
+  // Eye heights over the whole town.
+  pvs_settings settings;
+  settings.min = glm::vec3(scene_min.x, city.centre.y + 0.5f, scene_min.z);
+  settings.max = glm::vec3(scene_max.x, city.centre.y + 4.5f, scene_max.z);
+  settings.cell_size = glm::vec3(6.0f, 4.0f, 6.0f);
+  settings.rays_per_cell = 2048;
+  if (argc > 2) settings.rays_per_cell = std::max(1, std::atoi(argv[2]));
+
+  potentially_visible_set set;
+  set.build(scene, settings, pool);
+  std::cout << "  " << settings.rays_per_cell << " rays per cell of " << settings.cell_size.x << " x "
+            << settings.cell_size.y << " x " << settings.cell_size.z << " m" << std::endl << "  ";
+  set.print_stats(std::cout);
+
+  // The file must give back exactly the sets that were baked.
+  const std::filesystem::path path = std::filesystem::temp_directory_path() / "pvs_benchmark.pvs";
+  potentially_visible_set read;
+  size_t differing = 0;
+  const bool round_trip = set.write(path) && read.read(path);
+  std::vector<uint64_t> baked, loaded;
+  for (uint32_t cell = 0; round_trip && cell < set.stats().cells; ++cell) {
+    set.decode(cell, baked);
+    read.decode(cell, loaded);
+    differing += baked != loaded;
+  }
+  std::error_code error;
+  std::filesystem::remove(path, error);
+  std::cout << "  file round trip " << (round_trip ? "read back" : "FAILED") << ", " << differing
+            << " cells differ" << std::endl;
+
+  bvh index;
+  index.reserve(scene.objects.size());
+  std::vector<glm::mat4> to_object;
+  for (const static_object &object : scene.objects) {
+    index.add(object.min, object.max);
+    to_object.push_back(glm::inverse(object.model));
+  }
+  index.build(pool);
+
+  std::mt19937 random(5);
+  std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+  const auto free_point = [&]() {
+    std::vector<uint32_t> inside;
+    for (;;) {
+      const glm::vec3 point = settings.min + glm::vec3(unit(random), unit(random), unit(random)) *
+                                                 (settings.max - settings.min);
+      index.query(point, point, inside);
+      if (inside.empty()) return point;
+    }
+  };
+
+  // Finding the cell and decoding its set, as the engine does when the camera changes cell.
+  std::vector<glm::vec3> positions(lookups);
+  for (glm::vec3 &position : positions) {
+    position = settings.min + glm::vec3(unit(random), unit(random), unit(random)) * (settings.max - settings.min);
+  }
+  std::vector<uint64_t> bits;
+  size_t found_cells = 0;
+  auto start = clock_type::now();
+  for (const glm::vec3 &position : positions) {
+    const uint32_t cell = set.find_cell(position);
+    if (cell == potentially_visible_set::no_cell) continue;
+    ++found_cells;
+    set.decode(cell, bits);
+  }
+  std::cout << std::fixed << std::setprecision(3) << "  lookup and decode " << 1000.0 * milliseconds_since(start) /
+            lookups << " us, " << found_cells << " of " << lookups << " positions in a cell" << std::endl;
+
+  // Views at eye height looking around, a little up or down.
+  const float aspect = static_cast<float>(view_width) / static_cast<float>(view_height);
+  const glm::mat4 projection = glm::perspective(field_of_view, aspect, 0.1f, 2000.0f);
+  const float half_height = std::tan(field_of_view / 2.0f);
+  size_t seen = 0, missed = 0, in_frustum = 0, in_frustum_and_set = 0;
+  std::vector<uint32_t> found;
+  std::vector<uint8_t> visible(scene.objects.size());
+  for (int32_t v = 0; v < view_count; ++v) {
+    const glm::vec3 eye = free_point();
+    const float heading = glm::two_pi<float>() * unit(random);
+    const float pitch = glm::radians(-20.0f + 40.0f * unit(random));
+    const glm::vec3 forward(std::cos(pitch) * std::sin(heading), std::sin(pitch), -std::cos(pitch) * std::cos(heading));
+    const glm::vec3 right = glm::normalize(glm::cross(forward, glm::vec3(0.0f, 1.0f, 0.0f)));
+    const glm::vec3 up = glm::cross(right, forward);
+    set.decode(set.find_cell(eye), bits);
+
+    std::fill(visible.begin(), visible.end(), 0);
+    for (int32_t y = 0; y < view_height; ++y) {
+      for (int32_t x = 0; x < view_width; ++x) {
+        const float u = (2.0f * (static_cast<float>(x) + 0.5f) / view_width - 1.0f) * half_height * aspect;
+        const float w = (2.0f * (static_cast<float>(y) + 0.5f) / view_height - 1.0f) * half_height;
+        uint32_t object = 0;
+        if (trace(scene, index, to_object, eye, glm::normalize(forward + u * right + w * up), object)) {
+          visible[object] = 1;
+        }
+      }
+    }
+    for (uint32_t object = 0; object < visible.size(); ++object) {
+      if (visible[object] == 0) continue;
+      ++seen;
+      missed += !potentially_visible_set::contains(bits, object);
+    }
+
+    index.query(extract_frustum(projection * glm::lookAt(eye, eye + forward, up)), found);
+    in_frustum += found.size();
+    for (const uint32_t object : found) in_frustum_and_set += potentially_visible_set::contains(bits, object);
+  }
+  std::cout << std::setprecision(1) << "  " << view_count << " views of " << view_width << "x" << view_height
+            << " rays: " << static_cast<double>(seen) / view_count << " objects seen per view, " << missed
+            << " sightings missing from the set (" << std::setprecision(3)
+            << 100.0 * static_cast<double>(missed) / static_cast<double>(std::max<size_t>(1, seen)) << "%)"
+            << std::endl;
+  std::cout << std::setprecision(1) << "  objects drawn per view: " << static_cast<double>(in_frustum) / view_count
+            << " frustum only, " << static_cast<double>(in_frustum_and_set) / view_count << " frustum and set"
+            << std::endl;
+  return 0;
+}
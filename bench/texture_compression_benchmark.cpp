@@ -0,0 +1,52 @@
+// Encodes every image under assets/textures in each block-compressed format and quality preset
+// and reports encode throughput and PSNR per texture.
+//
+// usage: Texture_Compression_Benchmark [textures directory]
+
+#include <chrono>
+#include <filesystem>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "texture/bc_encoder.h"
+#include "utility/simd.h"
+#include "utility/thread_pool.h"
+
+int main(int argc, char **argv) {
+  const std::filesystem::path directory = argc > 1 ? argv[1] : "assets/textures";
+
+  thread_pool pool;
+  std::cout << "SIMD: " << simd_instruction_set_name() << ", workers: " << pool.size() + 1 << std::endl;
+  std::cout << std::left << std::setw(28) << "texture" << std::setw(8) << "format" << std::setw(8) << "preset"
+            << std::right << std::setw(12) << "MPixel/s" << std::setw(12) << "PSNR dB" << std::endl;
+
+  constexpr bc_format formats[] = {bc_format::bc1, bc_format::bc3, bc_format::bc4, bc_format::bc5, bc_format::bc7};
+  constexpr bc_quality presets[] = {bc_quality::fast, bc_quality::high};
+
+  for (const auto &entry : std::filesystem::directory_iterator(directory)) {
+    const image source = load_image(entry.path().string());
+    if (source.empty()) continue;
+
+    const image rgba = convert_channels(source, 4);
+    const double megapixels = static_cast<double>(rgba.width) * rgba.height / 1.0e6;
+
+    for (const bc_format format : formats) {
+      for (const bc_quality preset : presets) {
+        const auto start = std::chrono::steady_clock::now();
+        const std::vector<uint8_t> blocks = compress_level(rgba, format, preset, pool);
+        const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+        const double psnr = compute_psnr(rgba, decompress_level(format, blocks.data(), rgba.width, rgba.height), format);
+
+        std::cout << std::left << std::setw(28) << entry.path().filename().string() << std::setw(8)
+                  << bc_format_name(format) << std::setw(8) << (preset == bc_quality::fast ? "fast" : "high")
+                  << std::right << std::fixed << std::setprecision(1) << std::setw(12)
+                  << megapixels / elapsed.count() << std::setw(12) << std::setprecision(2) << psnr << std::endl;
+      }
+    }
+  }
+
+  return 0;
+}
@@ -0,0 +1,71 @@
+// Decodes every image under assets/textures, replicated N times, on thread pools of increasing
+// size and reports decode throughput for each worker count.
+//
+// usage: Texture_Decode_Benchmark [textures directory] [replicas]
+
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "texture/image.h"
+#include "utility/thread_pool.h"
+
+int main(int argc, char **argv) {
+  const std::filesystem::path directory = argc > 1 ? argv[1] : "assets/textures";
+  const int32_t replicas = argc > 2 ? std::max(1, std::stoi(argv[2])) : 100;
+
+  std::vector<std::string> sources;
+  for (const auto &entry : std::filesystem::directory_iterator(directory)) {
+    const std::string extension = entry.path().extension().string();
+    if (extension == ".png" || extension == ".jpg" || extension == ".jpeg") sources.push_back(entry.path().string());
+  }
+
+  if (sources.empty()) {
+    std::cout << "No images found in " << directory << std::endl;
+    return 1;
+  }
+
+  std::vector<std::string> paths;
+  paths.reserve(sources.size() * replicas);
+  for (int32_t i = 0; i < replicas; ++i) paths.insert(paths.end(), sources.begin(), sources.end());
+
+  uint64_t encoded_bytes = 0;
+  for (const auto &path : sources) encoded_bytes += std::filesystem::file_size(path);
+  encoded_bytes *= replicas;
+
+  std::vector<uint32_t> thread_counts;
+  const uint32_t hardware = std::max(1u, std::thread::hardware_concurrency());
+  for (uint32_t count = 1; count < hardware; count *= 2) thread_counts.push_back(count);
+  thread_counts.push_back(hardware);
+
+  std::cout << sources.size() << " images x " << replicas << " replicas, "
+            << static_cast<double>(encoded_bytes) / (1024.0 * 1024.0) << " MiB encoded" << std::endl;
+  std::cout << std::setw(8) << "threads" << std::setw(12) << "seconds" << std::setw(12) << "images/s"
+            << std::setw(14) << "MPixel/s" << std::setw(12) << "speedup" << std::endl;
+
+  double single_thread_seconds = 0.0;
+  for (const uint32_t count : thread_counts) {
+    thread_pool pool(count);
+
+    const auto start = std::chrono::steady_clock::now();
+    const std::vector<image> images = load_images(paths, pool);
+    const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+    uint64_t pixels = 0;
+    for (const auto &decoded : images) pixels += static_cast<uint64_t>(decoded.width) * decoded.height;
+
+    const double seconds = elapsed.count();
+    if (count == 1) single_thread_seconds = seconds;
+
+    std::cout << std::setw(8) << count << std::setw(12) << std::fixed << std::setprecision(3) << seconds
+              << std::setw(12) << std::setprecision(1) << static_cast<double>(images.size()) / seconds
+              << std::setw(14) << static_cast<double>(pixels) / seconds / 1.0e6
+              << std::setw(11) << std::setprecision(2) << single_thread_seconds / seconds << "x" << std::endl;
+  }
+
+  return 0;
+}
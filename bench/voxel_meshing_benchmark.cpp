@@ -0,0 +1,154 @@
+// Generates voxel landscapes of 256^3 and 1024^3 voxels and times greedy meshing: a full rebuild of
+// every chunk on one thread and on the pool, then the latency of single-voxel edits and of brush
+// edits, each measured from the edit to the new meshes of every chunk it dirtied.
+//
+// usage: Voxel_Meshing_Benchmark [largest size]
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "voxel/voxel_mesher.h"
+#include "voxel/voxel_volume.h"
+#include "utility/thread_pool.h"
+
+namespace {
+
+using clock_type = std::chrono::steady_clock;
+
+double to_mib(const size_t bytes) { return static_cast<double>(bytes) / (1024.0 * 1024.0); }
+
+double milliseconds_since(const clock_type::time_point start) {
+  return std::chrono::duration<double, std::milli>(clock_type::now() - start).count();
+}
+
+struct rebuild_result {
+  double milliseconds = 0.0;
+  size_t quads = 0;
+  size_t vertex_bytes = 0;
+};
+
+rebuild_result rebuild(const voxel_volume &volume, const std::vector<glm::ivec3> &chunks, thread_pool *pool) {
+  std::vector<std::vector<voxel_vertex>> meshes(chunks.size());
+  std::vector<size_t> quads(chunks.size(), 0);
+  const auto mesh = [&](const size_t i) { quads[i] = mesh_voxel_chunk(volume.neighbourhood(chunks[i]), meshes[i]); };
+
+  const auto start = clock_type::now();
+  if (pool != nullptr) {
+    pool->parallel_for(0, chunks.size(), mesh);
+  } else {
+    for (size_t i = 0; i < chunks.size(); ++i) mesh(i);
+  }
+
+  rebuild_result result;
+  result.milliseconds = milliseconds_since(start);
+  for (size_t i = 0; i < chunks.size(); ++i) {
+    result.quads += quads[i];
+    result.vertex_bytes += meshes[i].size() * sizeof(voxel_vertex);
+  }
+  return result;
+}
+
+// Applies `edit`, then remeshes the chunks it dirtied on the pool. Returns microseconds per edit
+// and adds the dirtied chunk count to `chunks`.
+template <typename F>
+double timed_edit(voxel_volume &volume, thread_pool &pool, size_t &chunks, F &&edit) {
+  const auto start = clock_type::now();
+  edit();
+  const std::vector<glm::ivec3> dirty = volume.take_dirty_chunks();
+  std::vector<std::vector<voxel_vertex>> meshes(dirty.size());
+  pool.parallel_for(0, dirty.size(),
+                    [&](const size_t i) { (void) mesh_voxel_chunk(volume.neighbourhood(dirty[i]), meshes[i]); });
+  chunks += dirty.size();
+  return milliseconds_since(start) * 1000.0;
+}
+
+void print_latencies(const std::string &name, std::vector<double> &microseconds, const size_t chunks) {
+  std::sort(microseconds.begin(), microseconds.end());
+  double total = 0.0;
+  for (const double value : microseconds) total += value;
+
+  const auto percentile = [&](const double fraction) {
+    return microseconds[std::min(microseconds.size() - 1, static_cast<size_t>(fraction * microseconds.size()))];
+  };
+  std::cout << "  " << std::left << std::setw(22) << name << std::right << std::fixed << std::setprecision(1)
+            << "mean " << std::setw(8) << total / microseconds.size() << " us, p50 " << std::setw(8) << percentile(0.5)
+            << " us, p99 " << std::setw(8) << percentile(0.99) << " us, max " << std::setw(8) << microseconds.back()
+            << " us, " << std::setprecision(2) << static_cast<double>(chunks) / microseconds.size()
+            << " chunks per edit" << std::endl;
+}
+
+void run(const int32_t size, thread_pool &pool) {
+  std::cout << size << "^3 voxels" << std::endl;
+
+  voxel_volume volume;
+  voxel_terrain_settings settings;
+  settings.size = glm::ivec3(size);
+  auto start = clock_type::now();
+  generate_voxel_terrain(volume, settings, pool);
+  const std::vector<glm::ivec3> chunks = volume.take_dirty_chunks();
+  std::cout << std::fixed << std::setprecision(1) << "  generated in " << milliseconds_since(start) << " ms: "
+            << volume.chunk_count() << " chunks stored, " << to_mib(volume.size_in_bytes()) << " MiB vs "
+            << to_mib(static_cast<size_t>(size) * size * size * sizeof(voxel)) << " MiB dense" << std::endl;
+
+  const rebuild_result single = rebuild(volume, chunks, nullptr);
+  const rebuild_result parallel = rebuild(volume, chunks, &pool);
+  std::cout << "  full rebuild: " << single.quads << " quads, " << to_mib(single.vertex_bytes) << " MiB of vertices"
+            << std::endl;
+  std::cout << "    1 thread:   " << std::setw(10) << single.milliseconds << " ms, " << std::setw(8)
+            << static_cast<double>(chunks.size()) / single.milliseconds * 1000.0 << " chunks/s" << std::endl;
+  std::cout << "    " << std::left << std::setw(12) << (std::to_string(pool.size() + 1) + " threads:") << std::right
+            << std::setw(10) << parallel.milliseconds << " ms, " << std::setw(8)
+            << static_cast<double>(chunks.size()) / parallel.milliseconds * 1000.0 << " chunks/s, "
+            << std::setprecision(2) << single.milliseconds / parallel.milliseconds << "x" << std::endl;
+
+  // Edits land on the surface: the first solid voxel straight down from the top of a random column.
+  std::mt19937 random(size);
+  std::uniform_int_distribution<int32_t> column(0, size - 1);
+  const auto surface = [&](glm::ivec3 &position) {
+    voxel_hit hit;
+    const glm::vec3 top(static_cast<float>(column(random)) + 0.5f, static_cast<float>(size) - 0.5f,
+                        static_cast<float>(column(random)) + 0.5f);
+    if (!volume.raycast(top, glm::vec3(0.0f, -1.0f, 0.0f), static_cast<float>(size), hit)) return false;
+    position = hit.position;
+    return true;
+  };
+
+  constexpr int32_t edit_count = 1000;
+  std::vector<double> digs, builds, brushes;
+  size_t dig_chunks = 0, build_chunks = 0, brush_chunks = 0;
+  for (int32_t i = 0; i < edit_count; ++i) {
+    glm::ivec3 position;
+    if (!surface(position)) continue;
+    digs.push_back(timed_edit(volume, pool, dig_chunks, [&]() { volume.set(position, empty_voxel); }));
+    builds.push_back(timed_edit(volume, pool, build_chunks, [&]() { volume.set(position, voxel_brick); }));
+  }
+  for (int32_t i = 0; i < edit_count / 10; ++i) {
+    glm::ivec3 position;
+    if (!surface(position)) continue;
+    brushes.push_back(timed_edit(volume, pool, brush_chunks,
+                                 [&]() { volume.fill_sphere(glm::vec3(position) + 0.5f, 8.0f, empty_voxel); }));
+  }
+
+  print_latencies("dig one voxel", digs, dig_chunks);
+  print_latencies("place one voxel", builds, build_chunks);
+  print_latencies("dig radius 8 sphere", brushes, brush_chunks);
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  const int32_t largest = argc > 1 ? std::atoi(argv[1]) : 1024;
+
+  thread_pool pool;
+  std::cout << "workers: " << pool.size() + 1 << std::endl;
+  for (const int32_t size : {256, 1024}) {
+    if (size <= largest) run(size, pool);
+  }
+  return 0;
+}
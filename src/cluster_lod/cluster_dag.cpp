@@ -0,0 +1,972 @@
+#include "cluster_dag.h"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <limits>
+#include <queue>
+#include <tuple>
+#include <unordered_map>
+
+#include "../filesystem/atomic_file.h"
+#include "../utility/hash.h"
+#include "../utility/thread_pool.h"
+
+namespace {
+
+constexpr char cluster_dag_magic[8] = {'E', 'N', 'G', 'C', 'D', 'A', 'G', '\0'};
+constexpr uint32_t cluster_dag_version = 1;
+
+// Bump whenever clustering, simplification or the file layout changes so stale cache entries are
+// rebuilt.
+constexpr uint32_t cache_version = 1;
+
+constexpr uint32_t max_cluster_vertices = 255;
+
+// A level that keeps more than this share of its triangles has run into borders it may not
+// simplify; its clusters become the root instead.
+constexpr double max_level_ratio = 0.85;
+
+struct cluster_dag_header {
+  char magic[8];
+  uint32_t version;
+  uint32_t group_count;
+  uint32_t dependency_count;
+  uint32_t root_group;
+  uint32_t level_count;
+  uint32_t reserved;
+  uint64_t triangle_count;
+  float min[3];
+  float max[3];
+};
+static_assert(sizeof(cluster_dag_header) == 64, "cluster DAG header must be packed");
+
+struct build_cluster {
+  std::vector<uint32_t> indices;  // into the mesh's vertices
+  glm::vec4 bounds = glm::vec4(0.0f);      // of its own triangles
+  glm::vec4 lod_bounds = glm::vec4(0.0f);  // of the group that made it; its own bounds at full detail
+  float error = 0.0f;                      // of the group that made it
+  int32_t creator = -1;
+  int32_t group = -1;
+};
+
+struct build_group {
+  std::vector<uint32_t> members;
+  glm::vec4 lod_bounds = glm::vec4(0.0f);
+  float error = 0.0f;
+  std::vector<uint32_t> outputs;
+};
+
+uint64_t spread_bits(uint64_t value) {
+  value &= 0x1FFFFF;
+  value = (value | value << 32) & 0x1F00000000FFFFull;
+  value = (value | value << 16) & 0x1F0000FF0000FFull;
+  value = (value | value << 8) & 0x100F00F00F00F00Full;
+  value = (value | value << 4) & 0x10C30C30C30C30C3ull;
+  value = (value | value << 2) & 0x1249249249249249ull;
+  return value;
+}
+
+// Sorts `points` along a Z-order curve through their bounding box, returning the order.
+std::vector<uint32_t> morton_order(const std::vector<glm::vec3> &points) {
+  glm::vec3 min(std::numeric_limits<float>::max()), max(std::numeric_limits<float>::lowest());
+  for (const glm::vec3 &point : points) {
+    min = glm::min(min, point);
+    max = glm::max(max, point);
+  }
+  const glm::vec3 scale = 2097151.0f / glm::max(max - min, glm::vec3(1e-6f));
+
+  std::vector<std::pair<uint64_t, uint32_t>> keys(points.size());
+  for (size_t i = 0; i < points.size(); ++i) {
+    const glm::vec3 cell = (points[i] - min) * scale;
+    keys[i] = {spread_bits(static_cast<uint64_t>(cell.x)) | spread_bits(static_cast<uint64_t>(cell.y)) << 1 |
+                   spread_bits(static_cast<uint64_t>(cell.z)) << 2,
+               static_cast<uint32_t>(i)};
+  }
+  std::sort(keys.begin(), keys.end());
+
+  std::vector<uint32_t> order(points.size());
+  for (size_t i = 0; i < keys.size(); ++i) order[i] = keys[i].second;
+  return order;
+}
+
+glm::vec4 bounding_sphere(const std::vector<glm::vec3> &positions, const std::vector<uint32_t> &indices) {
+  glm::vec3 min(std::numeric_limits<float>::max()), max(std::numeric_limits<float>::lowest());
+  for (const uint32_t index : indices) {
+    min = glm::min(min, positions[index]);
+    max = glm::max(max, positions[index]);
+  }
+  const glm::vec3 centre = 0.5f * (min + max);
+  float radius = 0.0f;
+  for (const uint32_t index : indices) radius = std::max(radius, glm::length(positions[index] - centre));
+  return {centre, radius};
+}
+
+glm::vec4 enclosing_sphere(const std::vector<glm::vec4> &spheres) {
+  glm::vec3 min(std::numeric_limits<float>::max()), max(std::numeric_limits<float>::lowest());
+  for (const glm::vec4 &sphere : spheres) {
+    min = glm::min(min, glm::vec3(sphere) - sphere.w);
+    max = glm::max(max, glm::vec3(sphere) + sphere.w);
+  }
+  const glm::vec3 centre = 0.5f * (min + max);
+  float radius = 0.0f;
+  for (const glm::vec4 &sphere : spheres) radius = std::max(radius, glm::length(glm::vec3(sphere) - centre) + sphere.w);
+  return {centre, radius};
+}
+
+// Corners of triangles grouped by vertex: `corners[starts[v]..starts[v + 1])` are the corners, as
+// triangle * 3 + corner, using local vertex v, and `vertices[corner]` is the corner's local vertex.
+struct vertex_corners {
+  std::vector<uint32_t> starts;
+  std::vector<uint32_t> corners;
+  std::vector<uint32_t> vertices;
+
+  explicit vertex_corners(const std::vector<uint32_t> &indices) {
+    std::vector<std::pair<uint32_t, uint32_t>> sorted(indices.size());
+    for (size_t i = 0; i < indices.size(); ++i) sorted[i] = {indices[i], static_cast<uint32_t>(i)};
+    std::sort(sorted.begin(), sorted.end());
+
+    corners.resize(sorted.size());
+    vertices.resize(sorted.size());
+    for (size_t i = 0; i < sorted.size(); ++i) {
+      if (i == 0 || sorted[i].first != sorted[i - 1].first) starts.push_back(static_cast<uint32_t>(i));
+      corners[i] = sorted[i].second;
+      vertices[sorted[i].second] = static_cast<uint32_t>(starts.size() - 1);
+    }
+    starts.push_back(static_cast<uint32_t>(sorted.size()));
+  }
+
+  [[nodiscard]] size_t vertex_count() const { return starts.size() - 1; }
+};
+
+// Cuts triangles into clusters of at most `cluster_triangles` triangles and max_cluster_vertices
+// vertices. Each grows from the next free triangle along a Z-order curve over its neighbours,
+// taking those adding the fewest vertices first and the nearest to its centre among them, so
+// clusters come out round, leave no slivers behind and share as few vertices as possible.
+std::vector<std::vector<uint32_t>> split_into_clusters(const std::vector<glm::vec3> &positions,
+                                                       const std::vector<uint32_t> &indices,
+                                                       const uint32_t cluster_triangles) {
+  const size_t triangle_count = indices.size() / 3;
+  std::vector<glm::vec3> centroids(triangle_count);
+  for (size_t t = 0; t < triangle_count; ++t) {
+    centroids[t] =
+        (positions[indices[t * 3]] + positions[indices[t * 3 + 1]] + positions[indices[t * 3 + 2]]) / 3.0f;
+  }
+  const vertex_corners adjacency(indices);
+
+  // Vertices in the current cluster carry its number.
+  std::vector<uint32_t> marks(adjacency.vertex_count(), ~0u);
+  std::vector<uint8_t> assigned(triangle_count, 0);
+  using candidate = std::tuple<uint32_t, float, uint32_t>;  // (vertices it adds, distance squared, triangle)
+  std::priority_queue<candidate, std::vector<candidate>, std::greater<>> frontier;
+
+  std::vector<std::vector<uint32_t>> clusters;
+  for (const uint32_t seed : morton_order(centroids)) {
+    if (assigned[seed] != 0) continue;
+    const auto mark = static_cast<uint32_t>(clusters.size());
+    std::vector<uint32_t> &cluster = clusters.emplace_back();
+    cluster.reserve(cluster_triangles * 3);
+    glm::vec3 sum(0.0f);
+    uint32_t vertex_count = 0;
+
+    const auto added_vertices = [&](const uint32_t triangle) {
+      uint32_t added = 0;
+      for (uint32_t corner = triangle * 3; corner < triangle * 3 + 3; ++corner) {
+        added += marks[adjacency.vertices[corner]] != mark ? 1 : 0;
+      }
+      return added;
+    };
+
+    // A triangle is queued again whenever a neighbour joins, with its improved score; stale
+    // copies are skipped once it is taken.
+    frontier = {};
+    frontier.push({3, 0.0f, seed});
+    while (!frontier.empty() && cluster.size() < cluster_triangles * 3) {
+      const uint32_t triangle = std::get<2>(frontier.top());
+      frontier.pop();
+      if (assigned[triangle] != 0) continue;
+      const uint32_t added = added_vertices(triangle);
+      if (vertex_count + added > max_cluster_vertices) continue;
+
+      assigned[triangle] = 1;
+      vertex_count += added;
+      sum += centroids[triangle];
+      const glm::vec3 centre = sum / static_cast<float>(cluster.size() / 3 + 1);
+      for (uint32_t corner = triangle * 3; corner < triangle * 3 + 3; ++corner) {
+        marks[adjacency.vertices[corner]] = mark;
+        cluster.push_back(indices[corner]);
+      }
+      for (uint32_t corner = triangle * 3; corner < triangle * 3 + 3; ++corner) {
+        const uint32_t vertex = adjacency.vertices[corner];
+        for (uint32_t i = adjacency.starts[vertex]; i < adjacency.starts[vertex + 1]; ++i) {
+          const uint32_t neighbour = adjacency.corners[i] / 3;
+          if (assigned[neighbour] != 0) continue;
+          const glm::vec3 offset = centroids[neighbour] - centre;
+          frontier.push({added_vertices(neighbour), glm::dot(offset, offset), neighbour});
+        }
+      }
+    }
+  }
+  return clusters;
+}
+
+// Gathers the clusters of a level into groups of about `group_clusters`. Like the triangles of a
+// cluster, each group grows from the next free cluster along a Z-order curve, taking the neighbour
+// sharing the most vertices with it next, which keeps the borders a group must leave untouched
+// short. Returns indices into `level`.
+std::vector<std::vector<uint32_t>> group_clusters(const std::vector<build_cluster> &clusters,
+                                                  const std::vector<uint32_t> &level,
+                                                  const uint32_t group_clusters) {
+  // Vertices each cluster uses, as (vertex, cluster) pairs sorted by vertex.
+  std::vector<std::pair<uint32_t, uint32_t>> uses;
+  std::vector<uint32_t> unique;
+  for (uint32_t i = 0; i < level.size(); ++i) {
+    unique = clusters[level[i]].indices;
+    std::sort(unique.begin(), unique.end());
+    unique.erase(std::unique(unique.begin(), unique.end()), unique.end());
+    for (const uint32_t vertex : unique) uses.emplace_back(vertex, i);
+  }
+  std::sort(uses.begin(), uses.end());
+
+  // Every pair of clusters using a vertex, counted once per shared vertex.
+  std::vector<std::pair<uint32_t, uint32_t>> pairs;
+  for (size_t begin = 0, end = 0; begin < uses.size(); begin = end) {
+    while (end < uses.size() && uses[end].first == uses[begin].first) ++end;
+    for (size_t a = begin; a < end; ++a) {
+      for (size_t b = begin; b < end; ++b) {
+        if (a != b) pairs.emplace_back(uses[a].second, uses[b].second);
+      }
+    }
+  }
+  std::sort(pairs.begin(), pairs.end());
+  std::vector<std::vector<std::pair<uint32_t, uint32_t>>> neighbours(level.size());
+  for (size_t begin = 0, end = 0; begin < pairs.size(); begin = end) {
+    while (end < pairs.size() && pairs[end] == pairs[begin]) ++end;
+    neighbours[pairs[begin].first].emplace_back(pairs[begin].second, static_cast<uint32_t>(end - begin));
+  }
+
+  std::vector<glm::vec3> centres(level.size());
+  for (size_t i = 0; i < level.size(); ++i) centres[i] = glm::vec3(clusters[level[i]].bounds);
+
+  std::vector<uint8_t> assigned(level.size(), 0);
+  std::vector<std::vector<uint32_t>> groups;
+  std::vector<std::pair<uint32_t, uint32_t>> candidates;  // (cluster, vertices shared with the group)
+  for (const uint32_t seed : morton_order(centres)) {
+    if (assigned[seed] != 0) continue;
+    std::vector<uint32_t> &group = groups.emplace_back();
+    candidates.clear();
+    uint32_t next = seed;
+    while (true) {
+      assigned[next] = 1;
+      group.push_back(next);
+      for (const auto &[neighbour, shared] : neighbours[next]) {
+        if (assigned[neighbour] != 0) continue;
+        const auto found = std::find_if(candidates.begin(), candidates.end(),
+                                        [&](const auto &candidate) { return candidate.first == neighbour; });
+        if (found == candidates.end()) {
+          candidates.emplace_back(neighbour, shared);
+        } else {
+          found->second += shared;
+        }
+      }
+      candidates.erase(std::remove_if(candidates.begin(), candidates.end(),
+                                      [&](const auto &candidate) { return assigned[candidate.first] != 0; }),
+                       candidates.end());
+      if (group.size() >= group_clusters || candidates.empty()) break;
+
+      const auto best = std::max_element(candidates.begin(), candidates.end(), [&](const auto &a, const auto &b) {
+        if (a.second != b.second) return a.second < b.second;
+        return glm::length(centres[a.first] - centres[seed]) > glm::length(centres[b.first] - centres[seed]);
+      });
+      next = best->first;
+    }
+  }
+
+  // Clusters left with no free neighbour would be simplified alone, their whole border locked;
+  // small groups join the neighbouring group they share the most vertices with instead.
+  std::vector<uint32_t> group_of(level.size());
+  for (uint32_t g = 0; g < groups.size(); ++g) {
+    for (const uint32_t member : groups[g]) group_of[member] = g;
+  }
+  for (uint32_t g = 0; g < groups.size(); ++g) {
+    if (groups[g].empty() || groups[g].size() * 2 >= group_clusters) continue;
+    candidates.clear();
+    for (const uint32_t member : groups[g]) {
+      for (const auto &[neighbour, shared] : neighbours[member]) {
+        const uint32_t other = group_of[neighbour];
+        if (other == g || groups[other].size() + groups[g].size() > group_clusters * 2) continue;
+        const auto found = std::find_if(candidates.begin(), candidates.end(),
+                                        [&](const auto &candidate) { return candidate.first == other; });
+        if (found == candidates.end()) {
+          candidates.emplace_back(other, shared);
+        } else {
+          found->second += shared;
+        }
+      }
+    }
+    if (candidates.empty()) continue;
+
+    const uint32_t target = std::max_element(candidates.begin(), candidates.end(), [](const auto &a, const auto &b) {
+                              return a.second < b.second;
+                            })->first;
+    for (const uint32_t member : groups[g]) group_of[member] = target;
+    groups[target].insert(groups[target].end(), groups[g].begin(), groups[g].end());
+    groups[g].clear();
+  }
+  groups.erase(std::remove_if(groups.begin(), groups.end(), [](const auto &group) { return group.empty(); }),
+               groups.end());
+  return groups;
+}
+
+// Sum of squared distances to a set of planes, each weighted by its triangle's area.
+struct quadric {
+  double a00 = 0.0, a01 = 0.0, a02 = 0.0, a11 = 0.0, a12 = 0.0, a22 = 0.0;
+  double b0 = 0.0, b1 = 0.0, b2 = 0.0, c = 0.0;
+  double weight = 0.0;
+
+  void add_plane(const glm::dvec3 &normal, const double distance, const double area) {
+    a00 += area * normal.x * normal.x;
+    a01 += area * normal.x * normal.y;
+    a02 += area * normal.x * normal.z;
+    a11 += area * normal.y * normal.y;
+    a12 += area * normal.y * normal.z;
+    a22 += area * normal.z * normal.z;
+    b0 += area * distance * normal.x;
+    b1 += area * distance * normal.y;
+    b2 += area * distance * normal.z;
+    c += area * distance * distance;
+    weight += area;
+  }
+
+  quadric &operator+=(const quadric &other) {
+    a00 += other.a00, a01 += other.a01, a02 += other.a02, a11 += other.a11, a12 += other.a12, a22 += other.a22;
+    b0 += other.b0, b1 += other.b1, b2 += other.b2, c += other.c, weight += other.weight;
+    return *this;
+  }
+
+  [[nodiscard]] double evaluate(const glm::dvec3 &p) const {
+    const double value = a00 * p.x * p.x + a11 * p.y * p.y + a22 * p.z * p.z +
+                         2.0 * (a01 * p.x * p.y + a02 * p.x * p.z + a12 * p.y * p.z) +
+                         2.0 * (b0 * p.x + b1 * p.y + b2 * p.z) + c;
+    return std::max(0.0, value);
+  }
+};
+
+// Edge collapse simplification of one group: vertices only ever move onto a neighbour, so the
+// result indexes the same vertices as the input.
+class group_simplifier {
+ public:
+  group_simplifier(const std::vector<glm::vec3> &positions, const std::vector<int32_t> &owners,
+                   const std::vector<uint32_t> &indices) {
+    std::unordered_map<uint32_t, uint32_t> local;
+    local.reserve(indices.size());
+    triangles_.resize(indices.size() / 3);
+    for (size_t i = 0; i < indices.size(); ++i) {
+      const auto [found, inserted] = local.emplace(indices[i], static_cast<uint32_t>(global_.size()));
+      if (inserted) global_.push_back(indices[i]);
+      triangles_[i / 3][i % 3] = found->second;
+    }
+
+    const size_t vertex_count = global_.size();
+    positions_.resize(vertex_count);
+    for (size_t i = 0; i < vertex_count; ++i) positions_[i] = glm::dvec3(positions[global_[i]]);
+    quadrics_.resize(vertex_count);
+    vertex_triangles_.resize(vertex_count);
+    stamps_.assign(vertex_count, 0);
+    removed_.assign(vertex_count, 0);
+    alive_.assign(triangles_.size(), 1);
+    alive_count_ = triangles_.size();
+
+    // Vertices shared with other groups, and on edges with only one triangle here, stay put.
+    locked_.assign(vertex_count, 0);
+    for (size_t i = 0; i < vertex_count; ++i) locked_[i] = owners[global_[i]] == -2 ? 1 : 0;
+    std::unordered_map<uint64_t, uint32_t> edge_uses;
+    edge_uses.reserve(indices.size());
+    for (const auto &triangle : triangles_) {
+      for (int32_t i = 0; i < 3; ++i) ++edge_uses[edge_key(triangle[i], triangle[(i + 1) % 3])];
+    }
+    for (const auto &[key, uses] : edge_uses) {
+      if (uses == 2) continue;
+      locked_[key >> 32] = 1;
+      locked_[key & 0xFFFFFFFF] = 1;
+    }
+
+    for (uint32_t t = 0; t < triangles_.size(); ++t) {
+      const auto &triangle = triangles_[t];
+      const glm::dvec3 cross = glm::cross(positions_[triangle[1]] - positions_[triangle[0]],
+                                          positions_[triangle[2]] - positions_[triangle[0]]);
+      const double length = glm::length(cross);
+      for (int32_t i = 0; i < 3; ++i) vertex_triangles_[triangle[i]].push_back(t);
+      if (length <= 0.0) continue;
+      const glm::dvec3 normal = cross / length;
+      quadric plane;
+      plane.add_plane(normal, -glm::dot(normal, positions_[triangle[0]]), 0.5 * length);
+      for (int32_t i = 0; i < 3; ++i) quadrics_[triangle[i]] += plane;
+    }
+  }
+
+  // Collapses edges, cheapest first, until at most `target` triangles are left or no collapse is
+  // possible. Returns the largest error taken on, as a distance.
+  float simplify(const size_t target) {
+    for (const auto &triangle : triangles_) {
+      for (int32_t i = 0; i < 3; ++i) {
+        push(triangle[i], triangle[(i + 1) % 3]);
+        push(triangle[(i + 1) % 3], triangle[i]);
+      }
+    }
+
+    double largest = 0.0;
+    while (alive_count_ > target && !queue_.empty()) {
+      const candidate next = queue_.top();
+      queue_.pop();
+      if (removed_[next.from] != 0 || removed_[next.to] != 0) continue;
+      if (next.from_stamp != stamps_[next.from] || next.to_stamp != stamps_[next.to]) {
+        if (shared_triangles(next.from, next.to) > 0) push(next.from, next.to);
+        continue;
+      }
+      if (!can_collapse(next.from, next.to)) continue;
+      collapse(next.from, next.to);
+      largest = std::max(largest, next.cost);
+    }
+    return static_cast<float>(std::sqrt(largest));
+  }
+
+  [[nodiscard]] std::vector<uint32_t> indices() const {
+    std::vector<uint32_t> result;
+    result.reserve(alive_count_ * 3);
+    for (size_t t = 0; t < triangles_.size(); ++t) {
+      if (alive_[t] == 0) continue;
+      for (const uint32_t vertex : triangles_[t]) result.push_back(global_[vertex]);
+    }
+    return result;
+  }
+
+ private:
+  struct candidate {
+    double cost;
+    uint32_t from;
+    uint32_t to;
+    uint32_t from_stamp;
+    uint32_t to_stamp;
+
+    bool operator>(const candidate &other) const { return cost > other.cost; }
+  };
+
+  static uint64_t edge_key(const uint32_t a, const uint32_t b) {
+    return static_cast<uint64_t>(std::min(a, b)) << 32 | std::max(a, b);
+  }
+
+  [[nodiscard]] bool contains(const uint32_t triangle, const uint32_t vertex) const {
+    const auto &corners = triangles_[triangle];
+    return corners[0] == vertex || corners[1] == vertex || corners[2] == vertex;
+  }
+
+  [[nodiscard]] size_t shared_triangles(const uint32_t a, const uint32_t b) const {
+    size_t count = 0;
+    for (const uint32_t t : vertex_triangles_[a]) count += alive_[t] != 0 && contains(t, b) ? 1 : 0;
+    return count;
+  }
+
+  void neighbours(const uint32_t vertex, std::vector<uint32_t> &out) const {
+    out.clear();
+    for (const uint32_t t : vertex_triangles_[vertex]) {
+      if (alive_[t] == 0) continue;
+      for (const uint32_t corner : triangles_[t]) {
+        if (corner != vertex) out.push_back(corner);
+      }
+    }
+    std::sort(out.begin(), out.end());
+    out.erase(std::unique(out.begin(), out.end()), out.end());
+  }
+
+  // Mean squared distance, over the planes of both vertices, of `to` where both now meet.
+  void push(const uint32_t from, const uint32_t to) {
+    if (locked_[from] != 0 || removed_[from] != 0 || removed_[to] != 0) return;
+    quadric sum = quadrics_[from];
+    sum += quadrics_[to];
+    const double cost = sum.evaluate(positions_[to]) / std::max(sum.weight, 1e-30);
+    queue_.push({cost, from, to, stamps_[from], stamps_[to]});
+  }
+
+  [[nodiscard]] bool can_collapse(const uint32_t from, const uint32_t to) {
+    const size_t shared = shared_triangles(from, to);
+    if (shared == 0) return false;
+
+    // Neighbours of both other than across the shared triangles would fold the surface.
+    neighbours(from, from_neighbours_);
+    neighbours(to, to_neighbours_);
+    size_t common = 0;
+    for (auto a = from_neighbours_.begin(), b = to_neighbours_.begin();
+         a != from_neighbours_.end() && b != to_neighbours_.end();) {
+      if (*a < *b) {
+        ++a;
+      } else if (*b < *a) {
+        ++b;
+      } else {
+        ++common, ++a, ++b;
+      }
+    }
+    if (common != shared) return false;
+
+    // No remaining triangle may flip or collapse to a sliver.
+    for (const uint32_t t : vertex_triangles_[from]) {
+      if (alive_[t] == 0 || contains(t, to)) continue;
+      std::array<glm::dvec3, 3> corners{};
+      for (int32_t i = 0; i < 3; ++i) corners[i] = positions_[triangles_[t][i]];
+      const glm::dvec3 before = glm::cross(corners[1] - corners[0], corners[2] - corners[0]);
+      for (int32_t i = 0; i < 3; ++i) {
+        if (triangles_[t][i] == from) corners[i] = positions_[to];
+      }
+      const glm::dvec3 after = glm::cross(corners[1] - corners[0], corners[2] - corners[0]);
+      const double before_length = glm::length(before), after_length = glm::length(after);
+      if (after_length <= 1e-12 * before_length) return false;
+      if (glm::dot(before, after) < 0.2 * before_length * after_length) return false;
+    }
+    return true;
+  }
+
+  void collapse(const uint32_t from, const uint32_t to) {
+    for (const uint32_t t : vertex_triangles_[from]) {
+      if (alive_[t] == 0) continue;
+      if (contains(t, to)) {
+        alive_[t] = 0;
+        --alive_count_;
+        continue;
+      }
+      for (uint32_t &corner : triangles_[t]) {
+        if (corner == from) corner = to;
+      }
+      vertex_triangles_[to].push_back(t);
+    }
+    vertex_triangles_[from].clear();
+    removed_[from] = 1;
+    quadrics_[to] += quadrics_[from];
+    ++stamps_[to];
+
+    neighbours(to, to_neighbours_);
+    for (const uint32_t neighbour : to_neighbours_) {
+      push(neighbour, to);
+      push(to, neighbour);
+    }
+  }
+
+  std::vector<uint32_t> global_;
+  std::vector<glm::dvec3> positions_;
+  std::vector<std::array<uint32_t, 3>> triangles_;
+  std::vector<uint8_t> alive_;
+  size_t alive_count_ = 0;
+  std::vector<std::vector<uint32_t>> vertex_triangles_;
+  std::vector<quadric> quadrics_;
+  std::vector<uint32_t> stamps_;  // bumped whenever a vertex's quadric changes
+  std::vector<uint8_t> removed_;
+  std::vector<uint8_t> locked_;
+  std::priority_queue<candidate, std::vector<candidate>, std::greater<>> queue_;
+  std::vector<uint32_t> from_neighbours_;
+  std::vector<uint32_t> to_neighbours_;
+};
+
+build_cluster make_cluster(const std::vector<glm::vec3> &positions, std::vector<uint32_t> indices) {
+  build_cluster cluster;
+  cluster.bounds = bounding_sphere(positions, indices);
+  cluster.lod_bounds = cluster.bounds;
+  cluster.indices = std::move(indices);
+  return cluster;
+}
+
+uint32_t pack_normal(const glm::vec3 &normal) {
+  const glm::ivec3 snorm(glm::round(glm::clamp(normal, -1.0f, 1.0f) * 511.0f));
+  return (static_cast<uint32_t>(snorm.x) & 0x3FF) | (static_cast<uint32_t>(snorm.y) & 0x3FF) << 10 |
+         (static_cast<uint32_t>(snorm.z) & 0x3FF) << 20;
+}
+
+// Fills a group's page: its members' records, then their vertices, then their indices.
+void encode_page(const build_group &group, const std::vector<build_cluster> &clusters,
+                 const std::vector<glm::vec3> &positions, const std::vector<glm::vec3> &normals,
+                 cluster_dag_group &entry, std::vector<uint8_t> &page) {
+  std::vector<cluster_dag_cluster> records;
+  std::vector<cluster_dag_vertex> vertices;
+  std::vector<uint8_t> indices;
+  std::unordered_map<uint32_t, uint8_t> local;
+  for (const uint32_t member : group.members) {
+    const build_cluster &cluster = clusters[member];
+    cluster_dag_cluster record{};
+    record.centre[0] = cluster.bounds.x;
+    record.centre[1] = cluster.bounds.y;
+    record.centre[2] = cluster.bounds.z;
+    record.radius = cluster.bounds.w;
+    record.creator = cluster.creator;
+    record.first_vertex = static_cast<uint32_t>(vertices.size());
+    record.first_index = static_cast<uint32_t>(indices.size());
+    record.triangle_count = static_cast<uint16_t>(cluster.indices.size() / 3);
+
+    local.clear();
+    for (const uint32_t index : cluster.indices) {
+      const auto [found, inserted] = local.emplace(index, static_cast<uint8_t>(local.size()));
+      if (inserted) {
+        cluster_dag_vertex vertex{};
+        std::memcpy(vertex.position, &positions[index], sizeof(vertex.position));
+        vertex.normal = pack_normal(normals[index]);
+        vertices.push_back(vertex);
+      }
+      indices.push_back(found->second);
+    }
+    record.vertex_count = static_cast<uint16_t>(local.size());
+    records.push_back(record);
+  }
+
+  entry.cluster_count = static_cast<uint32_t>(records.size());
+  entry.vertex_count = static_cast<uint32_t>(vertices.size());
+  entry.index_count = static_cast<uint32_t>(indices.size());
+  page.assign(cluster_dag_page_bytes(entry), 0);
+  uint8_t *out = page.data();
+  std::memcpy(out, records.data(), records.size() * sizeof(cluster_dag_cluster));
+  out += records.size() * sizeof(cluster_dag_cluster);
+  std::memcpy(out, vertices.data(), vertices.size() * sizeof(cluster_dag_vertex));
+  out += vertices.size() * sizeof(cluster_dag_vertex);
+  std::memcpy(out, indices.data(), indices.size());
+}
+
+std::filesystem::path cook(const std::filesystem::path &cached, const std::string &name,
+                           const cluster_dag_build_settings &settings, thread_pool &pool,
+                           const std::function<dense_mesh()> &load) {
+  if (std::filesystem::exists(cached)) return cached;
+
+  const dense_mesh mesh = load();
+  if (mesh.empty()) return {};
+
+  const auto start = std::chrono::steady_clock::now();
+  if (!write_cluster_dag(cached, mesh, settings, pool)) {
+    std::cout << "Failed to write cluster DAG: " << cached << std::endl;
+    return {};
+  }
+  const std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+
+  std::cout << "Built a cluster DAG of " << mesh.triangle_count() << " triangles from " << name << " into "
+            << cached.filename() << " in " << elapsed.count() << " ms" << std::endl;
+  return cached;
+}
+
+uint64_t settings_key(const cluster_dag_build_settings &settings, const uint64_t seed) {
+  const uint32_t parameters[3] = {cache_version, settings.cluster_triangles, settings.group_clusters};
+  return fnv1a_64(parameters, sizeof(parameters), seed);
+}
+
+}  // namespace
+
+bool write_cluster_dag(const std::filesystem::path &path, const dense_mesh &mesh,
+                       const cluster_dag_build_settings &settings, thread_pool &pool) {
+  if (mesh.empty() || mesh.positions.size() >= 0x7FFFFFFFu || settings.cluster_triangles < 8 ||
+      settings.cluster_triangles > max_cluster_vertices / 3 * 3 || settings.group_clusters < 2) {
+    return false;
+  }
+  const std::vector<glm::vec3> &positions = mesh.positions;
+  for (const uint32_t index : mesh.indices) {
+    if (index >= positions.size()) return false;
+  }
+
+  std::vector<glm::vec3> normals(positions.size(), glm::vec3(0.0f));
+  for (size_t t = 0; t + 2 < mesh.indices.size(); t += 3) {
+    const uint32_t a = mesh.indices[t], b = mesh.indices[t + 1], c = mesh.indices[t + 2];
+    const glm::vec3 cross = glm::cross(positions[b] - positions[a], positions[c] - positions[a]);
+    normals[a] += cross, normals[b] += cross, normals[c] += cross;
+  }
+  pool.parallel_for(0, normals.size(), [&](const size_t i) {
+    const float length = glm::length(normals[i]);
+    normals[i] = length > 0.0f ? normals[i] / length : glm::vec3(0.0f, 1.0f, 0.0f);
+  }, 1 << 14);
+
+  std::vector<build_cluster> clusters;
+  for (std::vector<uint32_t> &indices : split_into_clusters(positions, mesh.indices, settings.cluster_triangles)) {
+    clusters.push_back(make_cluster(positions, std::move(indices)));
+  }
+
+  std::vector<uint32_t> level(clusters.size());
+  for (uint32_t i = 0; i < level.size(); ++i) level[i] = i;
+
+  std::vector<build_group> groups;
+  std::vector<int32_t> owners(positions.size());
+  uint32_t level_count = 1;
+  while (level.size() > 1) {
+    std::vector<build_group> candidates;
+    for (const std::vector<uint32_t> &members : group_clusters(clusters, level, settings.group_clusters)) {
+      build_group &group = candidates.emplace_back();
+      for (const uint32_t member : members) group.members.push_back(level[member]);
+    }
+
+    // A vertex used by two groups is on the border between them.
+    std::fill(owners.begin(), owners.end(), -1);
+    for (size_t g = 0; g < candidates.size(); ++g) {
+      for (const uint32_t member : candidates[g].members) {
+        for (const uint32_t index : clusters[member].indices) {
+          int32_t &owner = owners[index];
+          if (owner == -1) owner = static_cast<int32_t>(g);
+          if (owner != static_cast<int32_t>(g)) owner = -2;
+        }
+      }
+    }
+
+    std::vector<std::vector<std::vector<uint32_t>>> outputs(candidates.size());
+    pool.parallel_for(0, candidates.size(), [&](const size_t g) {
+      build_group &group = candidates[g];
+      std::vector<uint32_t> merged;
+      std::vector<glm::vec4> lod_spheres;
+      for (const uint32_t member : group.members) {
+        const build_cluster &cluster = clusters[member];
+        merged.insert(merged.end(), cluster.indices.begin(), cluster.indices.end());
+        lod_spheres.push_back(cluster.lod_bounds);
+        group.error = std::max(group.error, cluster.error);
+      }
+
+      group_simplifier simplifier(positions, owners, merged);
+      group.error = std::max(group.error, simplifier.simplify(merged.size() / 6));
+      group.lod_bounds = enclosing_sphere(lod_spheres);
+      outputs[g] = split_into_clusters(positions, simplifier.indices(), settings.cluster_triangles);
+    });
+
+    size_t before = 0, after = 0;
+    for (const uint32_t cluster : level) before += clusters[cluster].indices.size();
+    for (const auto &group_outputs : outputs) {
+      for (const std::vector<uint32_t> &indices : group_outputs) after += indices.size();
+    }
+    if (static_cast<double>(after) > max_level_ratio * static_cast<double>(before)) break;
+
+    level.clear();
+    for (size_t g = 0; g < candidates.size(); ++g) {
+      build_group &group = candidates[g];
+      const auto number = static_cast<int32_t>(groups.size());
+      for (const uint32_t member : group.members) clusters[member].group = number;
+      for (std::vector<uint32_t> &indices : outputs[g]) {
+        build_cluster cluster = make_cluster(positions, std::move(indices));
+        cluster.lod_bounds = group.lod_bounds;
+        cluster.error = group.error;
+        cluster.creator = number;
+        group.outputs.push_back(static_cast<uint32_t>(clusters.size()));
+        level.push_back(static_cast<uint32_t>(clusters.size()));
+        clusters.push_back(std::move(cluster));
+      }
+      groups.push_back(std::move(group));
+    }
+    ++level_count;
+  }
+
+  // Whatever is left is never simplified further and always drawn when nothing finer is.
+  build_group root;
+  root.members = level;
+  root.error = std::numeric_limits<float>::infinity();
+  std::vector<glm::vec4> lod_spheres;
+  for (const uint32_t member : level) {
+    clusters[member].group = static_cast<int32_t>(groups.size());
+    lod_spheres.push_back(clusters[member].lod_bounds);
+  }
+  root.lod_bounds = enclosing_sphere(lod_spheres);
+  groups.push_back(std::move(root));
+
+  std::vector<cluster_dag_group> entries(groups.size());
+  std::vector<uint32_t> dependencies;
+  for (size_t g = 0; g < groups.size(); ++g) {
+    const build_group &group = groups[g];
+    cluster_dag_group &entry = entries[g];
+    std::memcpy(entry.lod_centre, &group.lod_bounds, sizeof(entry.lod_centre));
+    entry.lod_radius = group.lod_bounds.w;
+    entry.error = group.error;
+    entry.first_dependency = static_cast<uint32_t>(dependencies.size());
+    const size_t first = dependencies.size();
+    for (const uint32_t output : group.outputs) dependencies.push_back(static_cast<uint32_t>(clusters[output].group));
+    std::sort(dependencies.begin() + static_cast<std::ptrdiff_t>(first), dependencies.end());
+    dependencies.erase(std::unique(dependencies.begin() + static_cast<std::ptrdiff_t>(first), dependencies.end()),
+                       dependencies.end());
+    entry.dependency_count = static_cast<uint32_t>(dependencies.size() - first);
+  }
+
+  return mfsys::write_file_atomically(path, [&](const std::filesystem::path &temporary) {
+    std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+    if (!file) return false;
+
+    // Pages are sized by encoding them, so the group table is written last over a placeholder.
+    const size_t table_offset = sizeof(cluster_dag_header);
+    const size_t pages_offset = table_offset + entries.size() * sizeof(cluster_dag_group) +
+                                dependencies.size() * sizeof(uint32_t);
+    file.seekp(static_cast<std::streamoff>(pages_offset));
+
+    uint64_t offset = pages_offset;
+    std::vector<uint8_t> page;
+    for (size_t g = 0; g < groups.size(); ++g) {
+      encode_page(groups[g], clusters, positions, normals, entries[g], page);
+      entries[g].page_offset = offset;
+      file.write(reinterpret_cast<const char *>(page.data()), static_cast<std::streamsize>(page.size()));
+      offset += page.size();
+    }
+
+    glm::vec3 min(std::numeric_limits<float>::max()), max(std::numeric_limits<float>::lowest());
+    for (const glm::vec3 &position : positions) {
+      min = glm::min(min, position);
+      max = glm::max(max, position);
+    }
+    cluster_dag_header header{};
+    std::memcpy(header.magic, cluster_dag_magic, sizeof(cluster_dag_magic));
+    header.version = cluster_dag_version;
+    header.group_count = static_cast<uint32_t>(entries.size());
+    header.dependency_count = static_cast<uint32_t>(dependencies.size());
+    header.root_group = static_cast<uint32_t>(entries.size() - 1);
+    header.level_count = level_count;
+    header.triangle_count = mesh.triangle_count();
+    std::memcpy(header.min, &min, sizeof(header.min));
+    std::memcpy(header.max, &max, sizeof(header.max));
+
+    file.seekp(0);
+    file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    file.write(reinterpret_cast<const char *>(entries.data()),
+               static_cast<std::streamsize>(entries.size() * sizeof(cluster_dag_group)));
+    file.write(reinterpret_cast<const char *>(dependencies.data()),
+               static_cast<std::streamsize>(dependencies.size() * sizeof(uint32_t)));
+    return static_cast<bool>(file);
+  });
+}
+
+cluster_dag_file open_cluster_dag(const std::filesystem::path &path) {
+  cluster_dag_file result;
+
+  auto file = std::make_shared<mfsys::mapped_file>(path);
+  if (!file->is_open() || file->size() < sizeof(cluster_dag_header)) return result;
+
+  cluster_dag_header header{};
+  std::memcpy(&header, file->data(), sizeof(header));
+  if (std::memcmp(header.magic, cluster_dag_magic, sizeof(cluster_dag_magic)) != 0 ||
+      header.version != cluster_dag_version || header.group_count == 0 || header.root_group >= header.group_count) {
+    return result;
+  }
+
+  const size_t groups_bytes = static_cast<size_t>(header.group_count) * sizeof(cluster_dag_group);
+  const size_t dependencies_offset = sizeof(cluster_dag_header) + groups_bytes;
+  const size_t pages_offset = dependencies_offset + static_cast<size_t>(header.dependency_count) * sizeof(uint32_t);
+  if (file->size() < pages_offset) return result;
+
+  // Every range must stay inside the file, so the runtime can trust the groups without checks.
+  const auto *groups = reinterpret_cast<const cluster_dag_group *>(file->data() + sizeof(cluster_dag_header));
+  const auto *dependencies = reinterpret_cast<const uint32_t *>(file->data() + dependencies_offset);
+  for (uint32_t i = 0; i < header.dependency_count; ++i) {
+    if (dependencies[i] >= header.group_count) return result;
+  }
+  for (uint32_t g = 0; g < header.group_count; ++g) {
+    const cluster_dag_group &group = groups[g];
+    if (group.first_dependency > header.dependency_count ||
+        group.dependency_count > header.dependency_count - group.first_dependency ||
+        group.page_offset < pages_offset || group.page_offset > file->size() ||
+        cluster_dag_page_bytes(group) > file->size() - group.page_offset || group.page_offset % 4 != 0) {
+      return result;
+    }
+    const auto *clusters = reinterpret_cast<const cluster_dag_cluster *>(file->data() + group.page_offset);
+    for (uint32_t c = 0; c < group.cluster_count; ++c) {
+      const cluster_dag_cluster &cluster = clusters[c];
+      if (cluster.creator >= static_cast<int32_t>(header.group_count) || cluster.first_vertex > group.vertex_count ||
+          cluster.vertex_count > group.vertex_count - cluster.first_vertex || cluster.first_index > group.index_count ||
+          cluster.triangle_count * 3u > group.index_count - cluster.first_index) {
+        return result;
+      }
+    }
+  }
+
+  result.groups = groups;
+  result.dependencies = dependencies;
+  result.group_count = header.group_count;
+  result.root_group = header.root_group;
+  result.level_count = header.level_count;
+  result.triangle_count = header.triangle_count;
+  result.min = glm::vec3(header.min[0], header.min[1], header.min[2]);
+  result.max = glm::vec3(header.max[0], header.max[1], header.max[2]);
+  result.file = std::move(file);
+  return result;
+}
+
+std::filesystem::path cook_cluster_dag(const std::string &path, const std::filesystem::path &cache_directory,
+                                       const cluster_dag_build_settings &settings, thread_pool &pool) {
+  std::error_code error;
+  const uintmax_t size = std::filesystem::file_size(path, error);
+  if (error) {
+    std::cout << "Failed to open mesh: " << path << std::endl;
+    return {};
+  }
+  const auto modified = std::filesystem::last_write_time(path, error).time_since_epoch().count();
+
+  const std::string absolute = std::filesystem::absolute(path, error).string();
+  const uint64_t stamp[2] = {static_cast<uint64_t>(size), static_cast<uint64_t>(modified)};
+  const uint64_t key = settings_key(settings, fnv1a_64(stamp, sizeof(stamp), fnv1a_64(absolute)));
+
+  return cook(cache_directory / (hash_to_hex(key) + ".cdag"), path, settings, pool, [&]() { return load_ply(path); });
+}
+
+std::filesystem::path cook_generated_cluster_dag(const boulder_settings &generator,
+                                                 const std::filesystem::path &cache_directory,
+                                                 const cluster_dag_build_settings &settings, thread_pool &pool) {
+  const uint32_t parameters[2] = {static_cast<uint32_t>(generator.resolution), generator.seed};
+  uint64_t key = fnv1a_64(parameters, sizeof(parameters), fnv1a_64("generated boulder"));
+  key = fnv1a_64(&generator.radius, sizeof(generator.radius), key);
+  key = settings_key(settings, key);
+
+  return cook(cache_directory / (hash_to_hex(key) + ".cdag"), "generated boulder", settings, pool,
+              [&]() { return generate_boulder(generator, pool); });
+}
+
+void select_cluster_cut(const cluster_dag_file &file, const std::vector<uint8_t> &resident,
+                        const cluster_dag_view &view, std::vector<cluster_dag_draw> &draws,
+                        std::vector<cluster_dag_request> &requests) {
+  draws.clear();
+  requests.clear();
+  if (file.empty() || resident.size() < file.group_count || resident[file.root_group] == 0) return;
+
+  const auto projected_error = [&](const cluster_dag_group &group) {
+    if (!std::isfinite(group.error)) return std::numeric_limits<float>::max();
+    const glm::vec3 centre(group.lod_centre[0], group.lod_centre[1], group.lod_centre[2]);
+    const float distance = glm::length(centre - view.position) - group.lod_radius;
+    // Inside the bounds every error is too large.
+    if (distance <= 0.0f) return std::numeric_limits<float>::max();
+    return group.error / distance * view.projection_scale;
+  };
+  const auto can_load = [&](const cluster_dag_group &group) {
+    for (uint32_t i = 0; i < group.dependency_count; ++i) {
+      if (resident[file.dependencies[group.first_dependency + i]] == 0) return false;
+    }
+    return true;
+  };
+
+  for (uint32_t g = 0; g < file.group_count; ++g) {
+    if (resident[g] == 0) continue;
+    // Too fine: the clusters made from this group are drawn instead.
+    if (projected_error(file.groups[g]) <= view.pixel_error) continue;
+
+    const cluster_dag_cluster *clusters = file.clusters(g);
+    for (uint32_t c = 0; c < file.groups[g].cluster_count; ++c) {
+      const cluster_dag_cluster &cluster = clusters[c];
+      const glm::vec3 centre(cluster.centre[0], cluster.centre[1], cluster.centre[2]);
+      if (!is_sphere_visible(view.planes, centre, cluster.radius)) continue;
+
+      if (cluster.creator >= 0) {
+        const cluster_dag_group &creator = file.groups[cluster.creator];
+        const float pixels = projected_error(creator);
+        if (pixels > view.pixel_error) {
+          // Too coarse: the clusters it was made from are drawn, or asked for.
+          if (resident[cluster.creator] != 0) continue;
+          if (can_load(creator)) requests.push_back({pixels, static_cast<uint32_t>(cluster.creator)});
+        }
+      }
+      draws.push_back({g, c});
+    }
+  }
+
+  // Every cluster a missing group made asks for it; keep one request each, most urgent first.
+  std::sort(requests.begin(), requests.end(), [](const cluster_dag_request &a, const cluster_dag_request &b) {
+    return a.group != b.group ? a.group < b.group : a.pixels > b.pixels;
+  });
+  requests.erase(std::unique(requests.begin(), requests.end(),
+                             [](const cluster_dag_request &a, const cluster_dag_request &b) {
+                               return a.group == b.group;
+                             }),
+                 requests.end());
+  std::sort(requests.begin(), requests.end(),
+            [](const cluster_dag_request &a, const cluster_dag_request &b) { return b < a; });
+}
@@ -0,0 +1,142 @@
+#ifndef CLUSTER_DAG_H
+#define CLUSTER_DAG_H
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "dense_mesh.h"
+#include "../filesystem/mapped_file.h"
+#include "../render/frustum.h"
+
+class thread_pool;
+
+// A vertex as stored in a page and on the GPU, 16 bytes: the normal is signed 10:10:10:2.
+struct cluster_dag_vertex {
+  float position[3];
+  uint32_t normal;
+};
+static_assert(sizeof(cluster_dag_vertex) == 16, "cluster vertices must be packed");
+
+// A few dozen triangles with at most 255 vertices, so its indices fit in bytes.
+struct cluster_dag_cluster {
+  float centre[3];  // bounding sphere of the cluster's own triangles, for culling
+  float radius;
+  int32_t creator;        // the group whose simplification made this cluster; -1 at full detail
+  uint32_t first_vertex;  // within the page
+  uint32_t first_index;   // within the page
+  uint16_t vertex_count;
+  uint16_t triangle_count;
+};
+static_assert(sizeof(cluster_dag_cluster) == 32, "clusters must be packed");
+
+// A group of neighbouring clusters of one level, simplified together into the clusters of the
+// next. The group's clusters, its members, are stored together in one page; the clusters made from
+// them live in the pages of the groups they went on to join, its dependencies. Group metadata is
+// small and stays in memory; pages are read on demand.
+struct cluster_dag_group {
+  // Bounds of every member's triangles and of every group they were made from, so a group's
+  // projected error is never smaller than that of a group below it.
+  float lod_centre[3];
+  float lod_radius;
+  // Object-space error of the clusters made from the members, at least that of every group the
+  // members were made from; infinite for the root group, which is never simplified.
+  float error;
+  uint32_t first_dependency;  // into cluster_dag_file::dependencies
+  uint32_t dependency_count;
+  uint32_t cluster_count;
+  uint32_t vertex_count;
+  uint32_t index_count;
+  uint64_t page_offset;  // in the file: the members, then their vertices, then their byte indices
+};
+static_assert(sizeof(cluster_dag_group) == 48, "cluster groups must be packed");
+
+[[nodiscard]] inline size_t cluster_dag_page_bytes(const cluster_dag_group &group) {
+  return group.cluster_count * sizeof(cluster_dag_cluster) + group.vertex_count * sizeof(cluster_dag_vertex) +
+         ((group.index_count + 3u) & ~size_t{3});
+}
+
+struct cluster_dag_build_settings {
+  uint32_t cluster_triangles = 128;
+  uint32_t group_clusters = 8;  // clusters simplified together; each group's triangles are halved
+};
+
+// A mapped cluster DAG: a header, every group, the dependency lists and then one page per group.
+struct cluster_dag_file {
+  std::shared_ptr<mfsys::mapped_file> file;
+  const cluster_dag_group *groups = nullptr;
+  const uint32_t *dependencies = nullptr;
+  uint32_t group_count = 0;
+  uint32_t root_group = 0;
+  uint32_t level_count = 0;
+  uint64_t triangle_count = 0;  // of the source mesh
+  glm::vec3 min = glm::vec3(0.0f);
+  glm::vec3 max = glm::vec3(0.0f);
+
+  [[nodiscard]] bool empty() const { return groups == nullptr; }
+  [[nodiscard]] const uint8_t *page(const uint32_t group) const { return file->data() + groups[group].page_offset; }
+  [[nodiscard]] const cluster_dag_cluster *clusters(const uint32_t group) const {
+    return reinterpret_cast<const cluster_dag_cluster *>(page(group));
+  }
+};
+
+// Splits the mesh into clusters and builds the DAG level by level, each level's groups simplified
+// in parallel on the pool, then writes it. Simplification collapses edges by quadric error and
+// keeps every vertex a group shares with its neighbours, so groups switch detail independently
+// without cracks; since groups are re-formed on every level, last level's locked borders end up
+// inside a group and are simplified in turn. The whole mesh is held in memory while building.
+[[nodiscard]] bool write_cluster_dag(const std::filesystem::path &path, const dense_mesh &mesh,
+                                     const cluster_dag_build_settings &settings, thread_pool &pool);
+
+// Returns an empty file when `path` cannot be mapped or is not a cluster DAG.
+[[nodiscard]] cluster_dag_file open_cluster_dag(const std::filesystem::path &path);
+
+// Like cook_point_cloud(): returns the DAG for the PLY file at `path` in `cache_directory`,
+// building it first when the source or settings changed.
+[[nodiscard]] std::filesystem::path cook_cluster_dag(const std::string &path,
+                                                     const std::filesystem::path &cache_directory,
+                                                     const cluster_dag_build_settings &settings, thread_pool &pool);
+
+// The same for a generated boulder, keyed by the generator settings.
+[[nodiscard]] std::filesystem::path cook_generated_cluster_dag(const boulder_settings &generator,
+                                                               const std::filesystem::path &cache_directory,
+                                                               const cluster_dag_build_settings &settings,
+                                                               thread_pool &pool);
+
+struct cluster_dag_view {
+  glm::vec3 position = glm::vec3(0.0f);  // in the DAG's space
+  frustum planes{};                      // in the DAG's space
+  float projection_scale = 1.0f;  // pixels across the screen per unit of size over distance
+  float pixel_error = 1.0f;       // largest error to draw, in pixels
+};
+
+struct cluster_dag_draw {
+  uint32_t group;
+  uint32_t cluster;  // within the group's page
+};
+
+struct cluster_dag_request {
+  float pixels;  // projected error of the group's clusters' replacement, larger is more urgent
+  uint32_t group;
+
+  bool operator<(const cluster_dag_request &other) const { return pixels < other.pixels; }
+};
+
+// Picks the cut through the DAG for `view` among the groups marked in `resident`, indexed by
+// group, and lists the missing groups that would refine it.
+//
+// A member of group G made by group C is drawn when G's error projects above pixel_error, so the
+// clusters made from it are too coarse, and C's does not, so the clusters it was made from are
+// finer than needed. Errors and bounds only grow up the DAG, so exactly one cluster over any
+// surface passes. When C is not resident the cluster is drawn regardless, standing in for the
+// detail until it arrives; C is then requested, as long as the pages holding everything made from
+// it are resident, so that fallback always exists. The root group must be resident.
+void select_cluster_cut(const cluster_dag_file &file, const std::vector<uint8_t> &resident,
+                        const cluster_dag_view &view, std::vector<cluster_dag_draw> &draws,
+                        std::vector<cluster_dag_request> &requests);
+
+#endif  // CLUSTER_DAG_H
@@ -0,0 +1,309 @@
+#include "cluster_lod_mesh.h"
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+
+#include "../shader/shader.h"
+#include "../utility/thread_pool.h"
+
+namespace {
+
+constexpr GLuint position_location = 0;
+constexpr GLuint normal_location = 1;
+
+template <typename T>
+bool is_finished(const std::future<T> &future) {
+  return future.valid() && future.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+}
+
+double to_mib(const size_t bytes) { return static_cast<double>(bytes) / (1024.0 * 1024.0); }
+
+}  // namespace
+
+cluster_lod_mesh::cluster_lod_mesh(thread_pool &pool, const cluster_lod_settings &config)
+    : pool_(pool),
+      config_(config),
+      vertices_(config.resident_vertices),
+      indices_(config.resident_index_bytes),
+      staging_(config.staging_bytes) {
+  glGenVertexArrays(1, &vao_);
+  glGenBuffers(1, &vertex_buffer_);
+  glGenBuffers(1, &index_buffer_);
+
+  glBindVertexArray(vao_);
+  glBindBuffer(GL_ARRAY_BUFFER, vertex_buffer_);
+  glBufferData(GL_ARRAY_BUFFER, static_cast<GLsizeiptr>(config_.resident_vertices * sizeof(cluster_dag_vertex)),
+               nullptr, GL_DYNAMIC_DRAW);
+  glVertexAttribPointer(position_location, 3, GL_FLOAT, GL_FALSE, sizeof(cluster_dag_vertex),
+                        reinterpret_cast<void *>(offsetof(cluster_dag_vertex, position)));
+  glEnableVertexAttribArray(position_location);
+  glVertexAttribPointer(normal_location, 4, GL_INT_2_10_10_10_REV, GL_TRUE, sizeof(cluster_dag_vertex),
+                        reinterpret_cast<void *>(offsetof(cluster_dag_vertex, normal)));
+  glEnableVertexAttribArray(normal_location);
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, index_buffer_);
+  glBufferData(GL_ELEMENT_ARRAY_BUFFER, static_cast<GLsizeiptr>(config_.resident_index_bytes), nullptr,
+               GL_DYNAMIC_DRAW);
+  glBindVertexArray(0);
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+}
+
+cluster_lod_mesh::~cluster_lod_mesh() {
+  // Workers may still be building the file or reading the mapping.
+  if (pending_.valid()) pending_.wait();
+  if (loads_.valid()) loads_.wait();
+
+  glDeleteVertexArrays(1, &vao_);
+  glDeleteBuffers(1, &vertex_buffer_);
+  glDeleteBuffers(1, &index_buffer_);
+}
+
+void cluster_lod_mesh::load(const std::string &path, const std::filesystem::path &cache_directory) {
+  name_ = std::filesystem::path(path).filename().string();
+  pending_ = pool_.submit([path, cache_directory, &pool = pool_]() {
+    return open_cluster_dag(cook_cluster_dag(path, cache_directory, {}, pool));
+  });
+}
+
+void cluster_lod_mesh::generate(const boulder_settings &settings, const std::filesystem::path &cache_directory) {
+  name_ = "generated boulder";
+  pending_ = pool_.submit([settings, cache_directory, &pool = pool_]() {
+    return open_cluster_dag(cook_generated_cluster_dag(settings, cache_directory, {}, pool));
+  });
+}
+
+void cluster_lod_mesh::open(cluster_dag_file file) {
+  if (file.empty()) {
+    std::cout << "Cluster LOD mesh failed to load: " << name_ << std::endl;
+    return;
+  }
+  file_ = std::move(file);
+  groups_.assign(file_.group_count, {});
+  resident_.assign(file_.group_count, 0);
+}
+
+bool cluster_lod_mesh::allocate(const cluster_dag_group &group, size_t &first_vertex, size_t &first_index) {
+  const auto try_allocate = [&]() {
+    first_vertex = vertices_.allocate(group.vertex_count);
+    if (first_vertex == range_allocator::no_range) return false;
+    first_index = indices_.allocate(group.index_count);
+    if (first_index != range_allocator::no_range) return true;
+    vertices_.free(first_vertex, group.vertex_count);
+    return false;
+  };
+  if (try_allocate()) return true;
+
+  // Evict the least recently drawn groups nothing depends on until the page fits. The root and
+  // this frame's cut stay.
+  std::vector<uint32_t> candidates;
+  for (uint32_t g = 0; g < groups_.size(); ++g) {
+    const group_state &state = groups_[g];
+    if (state.state == residency::resident && state.dependents == 0 && state.last_used < frame_ &&
+        g != file_.root_group) {
+      candidates.push_back(g);
+    }
+  }
+  std::sort(candidates.begin(), candidates.end(),
+            [&](const uint32_t a, const uint32_t b) { return groups_[a].last_used < groups_[b].last_used; });
+
+  for (const uint32_t g : candidates) {
+    // An earlier eviction in this loop may have left a dependency of this group without it.
+    if (groups_[g].dependents != 0) continue;
+    evict(g);
+    if (try_allocate()) return true;
+  }
+  return false;
+}
+
+void cluster_lod_mesh::evict(const uint32_t group) {
+  const cluster_dag_group &entry = file_.groups[group];
+  group_state &state = groups_[group];
+  vertices_.free(state.first_vertex, entry.vertex_count);
+  indices_.free(state.first_index, entry.index_count);
+  for (uint32_t i = 0; i < entry.dependency_count; ++i) {
+    --groups_[file_.dependencies[entry.first_dependency + i]].dependents;
+  }
+  state = {};
+  resident_[group] = 0;
+}
+
+bool cluster_lod_mesh::upload(const loaded_page &page) {
+  const cluster_dag_group &group = file_.groups[page.group];
+  group_state &state = groups_[page.group];
+
+  // A dependency evicted while the page was read would leave the group without its fallback.
+  for (uint32_t i = 0; i < group.dependency_count; ++i) {
+    if (resident_[file_.dependencies[group.first_dependency + i]] == 0) {
+      state.state = residency::absent;
+      return true;
+    }
+  }
+
+  const size_t vertex_bytes = group.vertex_count * sizeof(cluster_dag_vertex);
+  const size_t bytes = vertex_bytes + group.index_count;
+  const uint8_t *vertices = page.bytes.data() + group.cluster_count * sizeof(cluster_dag_cluster);
+  const uint8_t *indices = vertices + vertex_bytes;
+
+  // Pages larger than the staging ring go straight to the buffers.
+  const bool direct = bytes > staging_.capacity();
+  streaming_allocation staging;
+  if (!direct) {
+    staging = staging_.allocate(bytes);
+    if (staging.empty()) return false;
+  }
+
+  size_t first_vertex = 0, first_index = 0;
+  if (!allocate(group, first_vertex, first_index)) {
+    // Everything resident is in use this frame; the group is asked for again when there is room.
+    state.state = residency::absent;
+    return true;
+  }
+
+  const auto vertex_offset = static_cast<GLintptr>(first_vertex * sizeof(cluster_dag_vertex));
+  const auto index_offset = static_cast<GLintptr>(first_index);
+  if (direct) {
+    glBindBuffer(GL_COPY_WRITE_BUFFER, vertex_buffer_);
+    glBufferSubData(GL_COPY_WRITE_BUFFER, vertex_offset, static_cast<GLsizeiptr>(vertex_bytes), vertices);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, index_buffer_);
+    glBufferSubData(GL_COPY_WRITE_BUFFER, index_offset, static_cast<GLsizeiptr>(group.index_count), indices);
+  } else {
+    std::memcpy(staging.data, vertices, bytes);
+    staging_.commit(staging);
+    glBindBuffer(GL_COPY_READ_BUFFER, staging_.buffer());
+    glBindBuffer(GL_COPY_WRITE_BUFFER, vertex_buffer_);
+    glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, static_cast<GLintptr>(staging.offset),
+                        vertex_offset, static_cast<GLsizeiptr>(vertex_bytes));
+    glBindBuffer(GL_COPY_WRITE_BUFFER, index_buffer_);
+    glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER,
+                        static_cast<GLintptr>(staging.offset + vertex_bytes), index_offset,
+                        static_cast<GLsizeiptr>(group.index_count));
+    glBindBuffer(GL_COPY_READ_BUFFER, 0);
+  }
+  glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+  state.state = residency::resident;
+  state.first_vertex = first_vertex;
+  state.first_index = first_index;
+  state.last_used = frame_;
+  resident_[page.group] = 1;
+  for (uint32_t i = 0; i < group.dependency_count; ++i) {
+    ++groups_[file_.dependencies[group.first_dependency + i]].dependents;
+  }
+  ++stats_.groups_uploaded;
+  return true;
+}
+
+void cluster_lod_mesh::request_groups() {
+  if (loads_.valid()) return;
+  // Do not read further ahead than the uploads can keep up with.
+  const auto limit = static_cast<size_t>(std::max(1, config_.loads_per_frame));
+  if (finished_.size() >= limit) return;
+
+  std::vector<uint32_t> indices;
+  // Nothing is drawn until the root is resident.
+  if (groups_[file_.root_group].state == residency::absent) indices.push_back(file_.root_group);
+  for (const cluster_dag_request &request : requests_) {
+    if (indices.size() >= limit) break;
+    if (groups_[request.group].state == residency::absent) indices.push_back(request.group);
+  }
+  if (indices.empty()) return;
+  for (const uint32_t index : indices) groups_[index].state = residency::loading;
+
+  loads_ = pool_.submit([indices = std::move(indices), file = file_]() {
+    std::vector<loaded_page> loaded(indices.size());
+    for (size_t i = 0; i < indices.size(); ++i) {
+      const uint8_t *page = file.page(indices[i]);
+      loaded[i].group = indices[i];
+      loaded[i].bytes.assign(page, page + cluster_dag_page_bytes(file.groups[indices[i]]));
+    }
+    return loaded;
+  });
+}
+
+void cluster_lod_mesh::update(const glm::vec3 &camera_position, const glm::mat4 &projection, const glm::mat4 &view,
+                              const float viewport_height) {
+  ++frame_;
+  stats_.groups_uploaded = 0;
+
+  if (is_finished(pending_)) open(pending_.get());
+  if (!is_ready()) return;
+
+  // The DAG is in its own space, offset by the origin.
+  cluster_dag_view cut_view;
+  cut_view.position = camera_position - config_.origin;
+  cut_view.planes = extract_frustum(projection * view * glm::translate(glm::mat4(1.0f), config_.origin));
+  cut_view.projection_scale = projection[1][1] * viewport_height * 0.5f;
+  cut_view.pixel_error = config_.pixel_error;
+  select_cluster_cut(file_, resident_, cut_view, cut_, requests_);
+  for (const cluster_dag_draw &draw : cut_) groups_[draw.group].last_used = frame_;
+
+  // After the cut, so the groups it uses cannot be evicted by this frame's uploads.
+  if (is_finished(loads_)) {
+    for (loaded_page &page : loads_.get()) finished_.push_back(std::move(page));
+  }
+
+  // Always let one page through so a page larger than the budget still makes progress.
+  size_t budget = config_.upload_bytes_per_frame;
+  for (bool first = true; !finished_.empty(); first = false) {
+    const size_t bytes = finished_.front().bytes.size();
+    if (!first && bytes > budget) break;
+    if (!upload(finished_.front())) break;
+    finished_.pop_front();
+    budget = bytes > budget ? 0 : budget - bytes;
+  }
+  staging_.end_frame();
+  request_groups();
+
+  stats_.clusters = cut_.size();
+  stats_.triangles = 0;
+  for (const cluster_dag_draw &draw : cut_) stats_.triangles += file_.clusters(draw.group)[draw.cluster].triangle_count;
+  stats_.requested_groups = requests_.size();
+  stats_.pending_groups = 0;
+  stats_.resident_groups = 0;
+  for (const group_state &state : groups_) {
+    if (state.state == residency::loading) ++stats_.pending_groups;
+    if (state.state == residency::resident) ++stats_.resident_groups;
+  }
+  stats_.resident_bytes = vertices_.used() * sizeof(cluster_dag_vertex) + indices_.used();
+  stats_.file_bytes = file_.file->size();
+}
+
+void cluster_lod_mesh::draw(const shader &program) {
+  stats_.draw_calls = 0;
+  if (!is_ready() || cut_.empty()) return;
+
+  counts_.clear();
+  offsets_.clear();
+  base_vertices_.clear();
+  for (const cluster_dag_draw &draw : cut_) {
+    const group_state &state = groups_[draw.group];
+    const cluster_dag_cluster &cluster = file_.clusters(draw.group)[draw.cluster];
+    counts_.push_back(static_cast<GLsizei>(cluster.triangle_count) * 3);
+    offsets_.push_back(reinterpret_cast<const void *>(state.first_index + cluster.first_index));
+    base_vertices_.push_back(static_cast<GLint>(state.first_vertex + cluster.first_vertex));
+  }
+
+  program.setVec3("meshOrigin", config_.origin);
+  program.setVec3("albedo", config_.albedo);
+
+  glBindVertexArray(vao_);
+  glMultiDrawElementsBaseVertex(GL_TRIANGLES, counts_.data(), GL_UNSIGNED_BYTE, offsets_.data(),
+                                static_cast<GLsizei>(counts_.size()), base_vertices_.data());
+  glBindVertexArray(0);
+  stats_.draw_calls = 1;
+}
+
+void cluster_lod_mesh::print_stats(std::ostream &out) const {
+  out << std::fixed << std::setprecision(1) << "cluster LOD: " << name_ << ", " << file_.triangle_count
+      << " source triangles in " << file_.group_count << " groups over " << file_.level_count << " levels, "
+      << stats_.clusters << " clusters with " << stats_.triangles << " triangles drawn at " << config_.pixel_error
+      << " pixels of error in " << stats_.draw_calls << " draw calls, " << stats_.resident_groups
+      << " groups resident, " << stats_.requested_groups << " wanted, " << stats_.groups_uploaded
+      << " uploaded this frame, " << stats_.pending_groups << " pending, " << to_mib(stats_.resident_bytes)
+      << " MiB on the GPU vs " << to_mib(stats_.file_bytes) << " MiB on disk" << std::endl;
+}
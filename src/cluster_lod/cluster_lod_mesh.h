@@ -0,0 +1,137 @@
+#ifndef CLUSTER_LOD_MESH_H
+#define CLUSTER_LOD_MESH_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <deque>
+#include <filesystem>
+#include <future>
+#include <iosfwd>
+#include <string>
+#include <vector>
+
+#include "cluster_dag.h"
+#include "../render/streaming_buffer.h"
+#include "../utility/range_allocator.h"
+
+class shader;
+class thread_pool;
+
+struct cluster_lod_settings {
+  glm::vec3 origin = glm::vec3(0.0f);  // world position of the DAG's origin
+  float pixel_error = 1.0f;            // largest simplification error drawn, in pixels
+  size_t resident_vertices = 4'000'000;
+  size_t resident_index_bytes = 12u << 20;  // one byte per index
+  int32_t loads_per_frame = 32;             // groups
+  size_t upload_bytes_per_frame = 8u << 20;
+  size_t staging_bytes = 16u << 20;
+  glm::vec3 albedo = glm::vec3(0.42f, 0.4f, 0.37f);
+};
+
+struct cluster_lod_stats {
+  size_t clusters = 0;  // in the last cut
+  size_t triangles = 0;
+  size_t draw_calls = 0;
+  size_t requested_groups = 0;  // missing groups the last cut wanted
+  size_t groups_uploaded = 0;   // in the last update()
+  size_t pending_groups = 0;    // being read or waiting for upload
+  size_t resident_groups = 0;
+  size_t resident_bytes = 0;
+  size_t file_bytes = 0;
+};
+
+// Meshes too dense for memory, drawn from a cluster DAG file (see cluster_dag.h) with as many
+// triangles as the screen needs.
+//
+// Each frame update() picks the cut through the resident part of the DAG with select_cluster_cut()
+// and asks for the missing groups that would refine it, largest projected error first. Pages are
+// read from the mapped file on a worker and uploaded within a per-frame byte budget into one vertex
+// and one index pool; until a page arrives its coarser ancestors are drawn in its place. A group is
+// only loaded once every group holding the clusters made from it is resident and is only evicted,
+// least recently drawn first, once no resident group depends on it, so there is always a coarser
+// fallback on screen and the cut never shows holes. The root group stays resident. The whole cut is
+// drawn with a single multi-draw.
+//
+// All member functions must be called on the thread that owns the GL context.
+class cluster_lod_mesh {
+ public:
+  explicit cluster_lod_mesh(thread_pool &pool, const cluster_lod_settings &config = {});
+  cluster_lod_mesh(const cluster_lod_mesh &) = delete;
+  cluster_lod_mesh &operator=(const cluster_lod_mesh &) = delete;
+
+  ~cluster_lod_mesh();
+
+  // Builds the DAG for the PLY file at `path` into `cache_directory` on a worker, see
+  // cook_cluster_dag().
+  void load(const std::string &path, const std::filesystem::path &cache_directory);
+  // The same for a generated boulder.
+  void generate(const boulder_settings &settings, const std::filesystem::path &cache_directory);
+
+  [[nodiscard]] bool is_ready() const { return !file_.empty(); }
+
+  // Picks the cut for this camera, uploads finished pages and starts new loads. Call once per frame
+  // before draw().
+  void update(const glm::vec3 &camera_position, const glm::mat4 &projection, const glm::mat4 &view,
+              float viewport_height);
+
+  // Draws the cut picked by the last update() with `program`, which must be in use.
+  void draw(const shader &program);
+
+  [[nodiscard]] const cluster_lod_stats &stats() const { return stats_; }
+  void print_stats(std::ostream &out) const;
+
+ private:
+  enum class residency : uint8_t { absent, loading, resident };
+
+  struct group_state {
+    residency state = residency::absent;
+    size_t first_vertex = range_allocator::no_range;  // in the vertex buffer
+    size_t first_index = range_allocator::no_range;   // in the index buffer, in bytes
+    uint64_t last_used = 0;
+    uint32_t dependents = 0;  // resident groups that list this one as a dependency
+  };
+
+  struct loaded_page {
+    uint32_t group = 0;
+    std::vector<uint8_t> bytes;
+  };
+
+  void open(cluster_dag_file file);
+  void request_groups();
+  bool upload(const loaded_page &page);
+  [[nodiscard]] bool allocate(const cluster_dag_group &group, size_t &first_vertex, size_t &first_index);
+  void evict(uint32_t group);
+
+  thread_pool &pool_;
+  cluster_lod_settings config_;
+  std::string name_;
+
+  std::future<cluster_dag_file> pending_;
+  cluster_dag_file file_;
+  std::vector<group_state> groups_;
+  std::vector<uint8_t> resident_;  // by group, for select_cluster_cut()
+
+  uint32_t vao_ = 0;
+  uint32_t vertex_buffer_ = 0;
+  uint32_t index_buffer_ = 0;
+  range_allocator vertices_;
+  range_allocator indices_;
+  streaming_buffer staging_;
+
+  std::vector<cluster_dag_draw> cut_;
+  std::vector<cluster_dag_request> requests_;  // most urgent first
+  std::future<std::vector<loaded_page>> loads_;
+  std::deque<loaded_page> finished_;
+
+  // Arguments of the multi-draw.
+  std::vector<GLsizei> counts_;
+  std::vector<const void *> offsets_;
+  std::vector<GLint> base_vertices_;
+
+  uint64_t frame_ = 0;
+  cluster_lod_stats stats_;
+};
+
+#endif  // CLUSTER_LOD_MESH_H
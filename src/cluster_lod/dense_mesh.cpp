@@ -0,0 +1,342 @@
+#include "dense_mesh.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+#include <string_view>
+#include <unordered_map>
+
+#include "../filesystem/mapped_file.h"
+#include "../utility/thread_pool.h"
+
+namespace {
+
+enum class ply_type : uint8_t { none, int8, uint8, int16, uint16, int32, uint32, float32, float64 };
+
+struct ply_property {
+  std::string name;
+  ply_type type = ply_type::none;
+  ply_type count_type = ply_type::none;  // set for lists
+};
+
+struct ply_element {
+  std::string name;
+  size_t count = 0;
+  std::vector<ply_property> properties;
+};
+
+ply_type parse_ply_type(const std::string &name) {
+  if (name == "char" || name == "int8") return ply_type::int8;
+  if (name == "uchar" || name == "uint8") return ply_type::uint8;
+  if (name == "short" || name == "int16") return ply_type::int16;
+  if (name == "ushort" || name == "uint16") return ply_type::uint16;
+  if (name == "int" || name == "int32") return ply_type::int32;
+  if (name == "uint" || name == "uint32") return ply_type::uint32;
+  if (name == "float" || name == "float32") return ply_type::float32;
+  if (name == "double" || name == "float64") return ply_type::float64;
+  return ply_type::none;
+}
+
+size_t ply_type_size(const ply_type type) {
+  switch (type) {
+    case ply_type::int8:
+    case ply_type::uint8:
+      return 1;
+    case ply_type::int16:
+    case ply_type::uint16:
+      return 2;
+    case ply_type::int32:
+    case ply_type::uint32:
+    case ply_type::float32:
+      return 4;
+    case ply_type::float64:
+      return 8;
+    default:
+      return 0;
+  }
+}
+
+// Reads values of any PLY type as doubles, from text or little-endian binary.
+class ply_reader {
+ public:
+  ply_reader(const uint8_t *begin, const uint8_t *end, const bool ascii) : cursor_(begin), end_(end), ascii_(ascii) {}
+
+  [[nodiscard]] bool failed() const { return failed_; }
+
+  double read(const ply_type type) {
+    if (failed_) return 0.0;
+    return ascii_ ? read_text() : read_binary(type);
+  }
+
+ private:
+  double read_text() {
+    while (cursor_ < end_ && std::isspace(*cursor_) != 0) ++cursor_;
+    // strtod needs a terminator; numbers are short, so copy one out.
+    char token[64];
+    size_t length = 0;
+    while (cursor_ < end_ && std::isspace(*cursor_) == 0 && length + 1 < sizeof(token)) {
+      token[length++] = static_cast<char>(*cursor_++);
+    }
+    token[length] = '\0';
+    char *parsed = nullptr;
+    const double value = std::strtod(token, &parsed);
+    if (length == 0 || parsed != token + length) failed_ = true;
+    return value;
+  }
+
+  double read_binary(const ply_type type) {
+    const size_t size = ply_type_size(type);
+    if (static_cast<size_t>(end_ - cursor_) < size) {
+      failed_ = true;
+      return 0.0;
+    }
+    const uint8_t *bytes = cursor_;
+    cursor_ += size;
+    switch (type) {
+      case ply_type::int8: return static_cast<double>(static_cast<int8_t>(bytes[0]));
+      case ply_type::uint8: return static_cast<double>(bytes[0]);
+      case ply_type::int16: return static_cast<double>(load<int16_t>(bytes));
+      case ply_type::uint16: return static_cast<double>(load<uint16_t>(bytes));
+      case ply_type::int32: return static_cast<double>(load<int32_t>(bytes));
+      case ply_type::uint32: return static_cast<double>(load<uint32_t>(bytes));
+      case ply_type::float32: return static_cast<double>(load<float>(bytes));
+      case ply_type::float64: return load<double>(bytes);
+      default: failed_ = true; return 0.0;
+    }
+  }
+
+  template <typename T>
+  static T load(const uint8_t *bytes) {
+    T value;
+    std::memcpy(&value, bytes, sizeof(T));
+    return value;
+  }
+
+  const uint8_t *cursor_;
+  const uint8_t *end_;
+  bool ascii_;
+  bool failed_ = false;
+};
+
+// Value noise in [0, 1] on the integer lattice, smoothly interpolated.
+float lattice_value(const glm::ivec3 &cell, const uint32_t seed) {
+  uint32_t hash = seed * 0x9E3779B9u;
+  hash ^= static_cast<uint32_t>(cell.x) * 0x85EBCA6Bu;
+  hash = (hash ^ (hash >> 13)) * 0xC2B2AE35u;
+  hash ^= static_cast<uint32_t>(cell.y) * 0x27D4EB2Fu;
+  hash = (hash ^ (hash >> 15)) * 0x165667B1u;
+  hash ^= static_cast<uint32_t>(cell.z) * 0x9E3779B1u;
+  hash = (hash ^ (hash >> 16)) * 0x85EBCA6Bu;
+  return static_cast<float>(hash >> 8) / static_cast<float>(1u << 24);
+}
+
+float value_noise(const glm::vec3 &position, const uint32_t seed) {
+  const glm::vec3 floor = glm::floor(position);
+  const glm::vec3 t = position - floor;
+  const glm::vec3 s = t * t * t * (t * (t * 6.0f - 15.0f) + 10.0f);
+  const glm::ivec3 cell(floor);
+
+  float corners[8];
+  for (int32_t i = 0; i < 8; ++i) corners[i] = lattice_value(cell + glm::ivec3(i & 1, (i >> 1) & 1, i >> 2), seed);
+  const float x00 = glm::mix(corners[0], corners[1], s.x), x10 = glm::mix(corners[2], corners[3], s.x);
+  const float x01 = glm::mix(corners[4], corners[5], s.x), x11 = glm::mix(corners[6], corners[7], s.x);
+  return glm::mix(glm::mix(x00, x10, s.y), glm::mix(x01, x11, s.y), s.z);
+}
+
+// Broad lumps plus sharp ridges, roughly in [-1, 1].
+float boulder_displacement(const glm::vec3 &direction, const uint32_t seed) {
+  float lumps = 0.0f, amplitude = 0.5f, frequency = 1.3f;
+  for (int32_t octave = 0; octave < 4; ++octave) {
+    lumps += amplitude * (value_noise(direction * frequency, seed + octave) * 2.0f - 1.0f);
+    amplitude *= 0.5f;
+    frequency *= 2.0f;
+  }
+
+  float ridges = 0.0f;
+  amplitude = 0.25f;
+  frequency = 4.0f;
+  for (int32_t octave = 0; octave < 6; ++octave) {
+    const float ridge = 1.0f - std::abs(value_noise(direction * frequency, seed + 16 + octave) * 2.0f - 1.0f);
+    ridges += amplitude * ridge * ridge;
+    amplitude *= 0.5f;
+    frequency *= 2.1f;
+  }
+  return lumps + ridges - 0.15f;
+}
+
+}  // namespace
+
+dense_mesh load_ply(const std::string &path) {
+  dense_mesh mesh;
+  const mfsys::mapped_file file(path);
+  if (!file.is_open()) {
+    std::cout << "Failed to open PLY file: " << path << std::endl;
+    return mesh;
+  }
+
+  // The header is text up to a line "end_header".
+  const auto *begin = reinterpret_cast<const char *>(file.data());
+  const std::string_view text(begin, std::min<size_t>(file.size(), 1 << 16));
+  const size_t header_end = text.find("end_header");
+  if (text.compare(0, 3, "ply") != 0 || header_end == std::string_view::npos) {
+    std::cout << "Not a PLY file: " << path << std::endl;
+    return mesh;
+  }
+  size_t body = text.find('\n', header_end);
+  if (body == std::string_view::npos) return mesh;
+  ++body;
+
+  std::istringstream header(std::string(text.substr(0, header_end)));
+  std::vector<ply_element> elements;
+  bool ascii = false, known_format = false;
+  for (std::string line; std::getline(header, line);) {
+    std::istringstream words(line);
+    std::string keyword;
+    words >> keyword;
+    if (keyword == "format") {
+      std::string format;
+      words >> format;
+      ascii = format == "ascii";
+      known_format = ascii || format == "binary_little_endian";
+    } else if (keyword == "element") {
+      ply_element element;
+      words >> element.name >> element.count;
+      elements.push_back(element);
+    } else if (keyword == "property" && !elements.empty()) {
+      ply_property property;
+      std::string type;
+      words >> type;
+      if (type == "list") {
+        std::string count_type, item_type;
+        words >> count_type >> item_type;
+        property.count_type = parse_ply_type(count_type);
+        property.type = parse_ply_type(item_type);
+      } else {
+        property.type = parse_ply_type(type);
+      }
+      words >> property.name;
+      if (property.type == ply_type::none) {
+        std::cout << "Unsupported PLY property type in " << path << ": " << line << std::endl;
+        return mesh;
+      }
+      elements.back().properties.push_back(property);
+    }
+  }
+  if (!known_format) {
+    std::cout << "Unsupported PLY format, expected ascii or binary_little_endian: " << path << std::endl;
+    return mesh;
+  }
+
+  ply_reader reader(file.data() + body, file.data() + file.size(), ascii);
+  for (const ply_element &element : elements) {
+    const bool vertices = element.name == "vertex", faces = element.name == "face";
+    int32_t axes[3] = {-1, -1, -1};
+    int32_t face_list = -1;
+    for (size_t i = 0; i < element.properties.size(); ++i) {
+      const ply_property &property = element.properties[i];
+      if (vertices && property.name.size() == 1 && property.name[0] >= 'x' && property.name[0] <= 'z') {
+        axes[property.name[0] - 'x'] = static_cast<int32_t>(i);
+      }
+      if (faces && property.count_type != ply_type::none &&
+          (property.name == "vertex_indices" || property.name == "vertex_index")) {
+        face_list = static_cast<int32_t>(i);
+      }
+    }
+    if (vertices && (axes[0] < 0 || axes[1] < 0 || axes[2] < 0)) {
+      std::cout << "PLY vertices without x, y and z: " << path << std::endl;
+      return {};
+    }
+    if (vertices) mesh.positions.reserve(element.count);
+
+    std::vector<uint32_t> polygon;
+    for (size_t item = 0; item < element.count && !reader.failed(); ++item) {
+      glm::vec3 position(0.0f);
+      for (size_t i = 0; i < element.properties.size(); ++i) {
+        const ply_property &property = element.properties[i];
+        if (property.count_type == ply_type::none) {
+          const double value = reader.read(property.type);
+          for (int32_t axis = 0; axis < 3; ++axis) {
+            if (axes[axis] == static_cast<int32_t>(i)) position[axis] = static_cast<float>(value);
+          }
+          continue;
+        }
+
+        const auto count = static_cast<size_t>(reader.read(property.count_type));
+        polygon.clear();
+        for (size_t j = 0; j < count; ++j) polygon.push_back(static_cast<uint32_t>(reader.read(property.type)));
+        if (static_cast<int32_t>(i) != face_list) continue;
+        for (size_t j = 1; j + 1 < polygon.size(); ++j) {
+          mesh.indices.insert(mesh.indices.end(), {polygon[0], polygon[j], polygon[j + 1]});
+        }
+      }
+      if (vertices) mesh.positions.push_back(position);
+    }
+  }
+
+  const auto out_of_range = [&](const uint32_t index) { return index >= mesh.positions.size(); };
+  if (reader.failed() || std::any_of(mesh.indices.begin(), mesh.indices.end(), out_of_range)) {
+    std::cout << "Truncated or invalid PLY file: " << path << std::endl;
+    return {};
+  }
+  return mesh;
+}
+
+dense_mesh generate_boulder(const boulder_settings &settings, thread_pool &pool) {
+  dense_mesh mesh;
+  const int32_t n = std::max(1, settings.resolution);
+  const auto side = static_cast<uint64_t>(n) + 1;
+
+  // Faces as (normal axis, sign); u and v are ordered so u x v points outwards.
+  constexpr int32_t faces[6][4] = {{0, 1, 1, 2}, {0, -1, 2, 1}, {1, 1, 2, 0},
+                                   {1, -1, 0, 2}, {2, 1, 0, 1}, {2, -1, 1, 0}};
+
+  // Grid points on the cube's surface are numbered once, so faces share their edge vertices.
+  std::unordered_map<uint64_t, uint32_t> numbering;
+  numbering.reserve(static_cast<size_t>(6 * side * side));
+  std::vector<glm::ivec3> lattice;
+  std::vector<uint32_t> grid(static_cast<size_t>(side * side));
+  mesh.indices.reserve(static_cast<size_t>(n) * n * 36);
+  for (const auto &face : faces) {
+    for (int32_t j = 0; j <= n; ++j) {
+      for (int32_t i = 0; i <= n; ++i) {
+        glm::ivec3 point(0);
+        point[face[0]] = face[1] > 0 ? n : 0;
+        point[face[2]] = i;
+        point[face[3]] = j;
+        const uint64_t key = (static_cast<uint64_t>(point.x) * side + point.y) * side + point.z;
+        const auto [found, inserted] = numbering.emplace(key, static_cast<uint32_t>(lattice.size()));
+        if (inserted) lattice.push_back(point);
+        grid[static_cast<size_t>(j) * side + i] = found->second;
+      }
+    }
+    for (int32_t j = 0; j < n; ++j) {
+      for (int32_t i = 0; i < n; ++i) {
+        const uint32_t a = grid[j * side + i], b = grid[j * side + i + 1];
+        const uint32_t c = grid[(j + 1) * side + i + 1], d = grid[(j + 1) * side + i];
+        mesh.indices.insert(mesh.indices.end(), {a, b, c, a, c, d});
+      }
+    }
+  }
+
+  mesh.positions.resize(lattice.size());
+  pool.parallel_for(0, lattice.size(), [&](const size_t i) {
+    // The spherified cube mapping spreads the vertices more evenly than normalizing.
+    const glm::vec3 p = glm::vec3(lattice[i]) * (2.0f / static_cast<float>(n)) - 1.0f;
+    const glm::vec3 p2 = p * p;
+    const glm::vec3 direction(p.x * std::sqrt(std::max(0.0f, 1.0f - p2.y / 2.0f - p2.z / 2.0f + p2.y * p2.z / 3.0f)),
+                              p.y * std::sqrt(std::max(0.0f, 1.0f - p2.z / 2.0f - p2.x / 2.0f + p2.z * p2.x / 3.0f)),
+                              p.z * std::sqrt(std::max(0.0f, 1.0f - p2.x / 2.0f - p2.y / 2.0f + p2.x * p2.y / 3.0f)));
+
+    glm::vec3 position = direction * settings.radius * (1.0f + 0.3f * boulder_displacement(direction, settings.seed));
+    // Squashed and flattened underneath so it rests on the ground.
+    position.y *= 0.7f;
+    const float base = -0.45f * settings.radius;
+    if (position.y < base) position.y = base + (position.y - base) * 0.1f;
+    mesh.positions[i] = position;
+  }, 4096);
+  return mesh;
+}
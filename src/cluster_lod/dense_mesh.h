@@ -0,0 +1,37 @@
+#ifndef DENSE_MESH_H
+#define DENSE_MESH_H
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+class thread_pool;
+
+// An indexed triangle mesh as read from a scan or CAD export, before its cluster hierarchy is
+// built (see cluster_dag.h). Vertices shared by neighbouring triangles must be shared in the index
+// buffer too, or simplification treats the seams as borders and keeps them.
+struct dense_mesh {
+  std::vector<glm::vec3> positions;
+  std::vector<uint32_t> indices;  // triangles, counter-clockwise
+
+  [[nodiscard]] bool empty() const { return indices.empty(); }
+  [[nodiscard]] size_t triangle_count() const { return indices.size() / 3; }
+};
+
+// Reads the vertex positions and faces of a PLY file, ASCII or binary little endian. Polygons are
+// split into fans; every other property and element is skipped.
+[[nodiscard]] dense_mesh load_ply(const std::string &path);
+
+struct boulder_settings {
+  int32_t resolution = 512;  // quads across each face of the subdivided cube; 12 * resolution^2 triangles
+  uint32_t seed = 1;
+  float radius = 6.0f;  // metres
+};
+
+// A weathered rock: a cube subdivided and pushed out to a sphere, displaced by ridged noise, for
+// scenes without a scanned asset.
+[[nodiscard]] dense_mesh generate_boulder(const boulder_settings &settings, thread_pool &pool);
+
+#endif  // DENSE_MESH_H
@@ -0,0 +1,89 @@
+#include "asset_manifest.h"
+
+#include <fstream>
+#include <sstream>
+
+#include "atomic_file.h"
+#include "../utility/hash.h"
+
+namespace {
+
+constexpr const char *manifest_header = "engine-asset-manifest 3";
+
+bool parse_kind(const std::string &name, mfsys::asset_kind &kind) {
+  for (const auto candidate : {mfsys::asset_kind::copy, mfsys::asset_kind::shader, mfsys::asset_kind::texture,
+                               mfsys::asset_kind::data_texture, mfsys::asset_kind::normal_map}) {
+    if (name == mfsys::asset_kind_name(candidate)) {
+      kind = candidate;
+      return true;
+    }
+  }
+  return false;
+}
+
+}  // namespace
+
+const char *mfsys::asset_kind_name(const asset_kind kind) {
+  switch (kind) {
+    case asset_kind::copy: return "copy";
+    case asset_kind::shader: return "shader";
+    case asset_kind::texture: return "texture";
+    case asset_kind::data_texture: return "data_texture";
+    case asset_kind::normal_map: return "normal_map";
+  }
+  return "unknown";
+}
+
+mfsys::asset_manifest mfsys::asset_manifest::load(const std::filesystem::path &path) {
+  asset_manifest result;
+
+  std::ifstream file(path);
+  std::string line;
+  if (!file || !std::getline(file, line) || line != manifest_header) return result;
+
+  while (std::getline(file, line)) {
+    std::istringstream fields(line);
+    std::string kind, hash, parameters, size, time;
+    asset_entry entry;
+    if (!std::getline(fields, kind, '\t') || !std::getline(fields, hash, '\t') ||
+        !std::getline(fields, parameters, '\t') || !std::getline(fields, size, '\t') ||
+        !std::getline(fields, time, '\t') || !std::getline(fields, entry.source, '\t') ||
+        !std::getline(fields, entry.output) || !parse_kind(kind, entry.kind)) {
+      return {};
+    }
+
+    try {
+      entry.hash = std::stoull(hash, nullptr, 16);
+      entry.parameters = std::stoull(parameters, nullptr, 16);
+      entry.source_size = std::stoull(size);
+      entry.source_time = std::stoll(time);
+    } catch (const std::exception &) {
+      return {};
+    }
+    result.add(std::move(entry));
+  }
+
+  return result;
+}
+
+bool mfsys::asset_manifest::save(const std::filesystem::path &path) const {
+  return mfsys::write_file_atomically(path, [&](const std::filesystem::path &temporary) {
+    std::ofstream file(temporary, std::ios::trunc);
+    if (!file) return false;
+
+    file << manifest_header << '\n';
+    for (const asset_entry &entry : entries_) {
+      file << asset_kind_name(entry.kind) << '\t' << hash_to_hex(entry.hash) << '\t' << hash_to_hex(entry.parameters)
+           << '\t' << entry.source_size << '\t' << entry.source_time << '\t' << entry.source << '\t' << entry.output
+           << '\n';
+    }
+    return static_cast<bool>(file);
+  });
+}
+
+const mfsys::asset_entry *mfsys::asset_manifest::find(const std::string &source, const asset_kind kind) const {
+  for (const asset_entry &entry : entries_) {
+    if (entry.kind == kind && entry.source == source) return &entry;
+  }
+  return nullptr;
+}
@@ -0,0 +1,56 @@
+#ifndef ASSET_MANIFEST_H
+#define ASSET_MANIFEST_H
+
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace mfsys {
+
+// Textures are cooked once per use, since how the mips are built depends on what the texels mean.
+enum class asset_kind : uint8_t {
+  copy,          // copied verbatim
+  shader,        // includes resolved, comments stripped
+  texture,       // colour map (or HDR image) as a block-compressed mip chain in KTX2, mipped in linear light
+  data_texture,  // the same mipped as stored, for specular, roughness and other data maps
+  normal_map,    // the same with renormalised mips
+};
+
+[[nodiscard]] const char *asset_kind_name(asset_kind kind);
+
+struct asset_entry {
+  asset_kind kind = asset_kind::copy;
+  uint64_t hash = 0;         // input contents together with the processing parameters
+  uint64_t parameters = 0;   // the processing parameters alone
+  uint64_t source_size = 0;  // size and modification time of the source when it was cooked, so the
+  int64_t source_time = 0;   // cooker can skip hashing files that were not touched
+  std::string source;        // relative to the assets directory, '/'-separated
+  std::string output;        // relative to the output directory, '/'-separated
+};
+
+// The list of cooked outputs the asset cooker writes next to them, one tab-separated line per
+// output. The runtime reads it to find the cooked form of a source asset.
+class asset_manifest {
+ public:
+  static constexpr const char *file_name = "manifest.txt";
+
+  // Returns an empty manifest when the file is missing or not a manifest.
+  [[nodiscard]] static asset_manifest load(const std::filesystem::path &path);
+  // Writes next to `path` and renames into place.
+  [[nodiscard]] bool save(const std::filesystem::path &path) const;
+
+  void add(asset_entry entry) { entries_.push_back(std::move(entry)); }
+  [[nodiscard]] const asset_entry *find(const std::string &source, asset_kind kind) const;
+
+  [[nodiscard]] const std::vector<asset_entry> &entries() const { return entries_; }
+  [[nodiscard]] bool empty() const { return entries_.empty(); }
+
+ private:
+  std::vector<asset_entry> entries_;
+};
+
+}  // namespace mfsys
+
+#endif  // ASSET_MANIFEST_H
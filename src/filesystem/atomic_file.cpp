@@ -0,0 +1,34 @@
+#include "atomic_file.h"
+
+#include <atomic>
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <thread>
+
+bool mfsys::write_file_atomically(const std::filesystem::path &path,
+                                  const std::function<bool(const std::filesystem::path &)> &write) {
+  std::error_code error;
+  if (path.has_parent_path()) std::filesystem::create_directories(path.parent_path(), error);
+
+  static std::atomic<uint32_t> writes{0};
+  const std::filesystem::path temporary =
+      path.string() + "." + std::to_string(std::hash<std::thread::id>{}(std::this_thread::get_id())) + "." +
+      std::to_string(writes.fetch_add(1, std::memory_order_relaxed)) + ".tmp";
+
+  if (write(temporary)) {
+    std::filesystem::rename(temporary, path, error);
+    if (!error) return true;
+  }
+  std::filesystem::remove(temporary, error);
+  return false;
+}
+
+bool mfsys::write_file_atomically(const std::filesystem::path &path, const void *data, const size_t size) {
+  return write_file_atomically(path, [data, size](const std::filesystem::path &temporary) {
+    std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+    file.write(static_cast<const char *>(data), static_cast<std::streamsize>(size));
+    file.close();
+    return static_cast<bool>(file);
+  });
+}
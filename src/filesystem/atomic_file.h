@@ -0,0 +1,23 @@
+#ifndef ATOMIC_FILE_H
+#define ATOMIC_FILE_H
+
+#include <cstddef>
+#include <filesystem>
+#include <functional>
+
+namespace mfsys {
+
+// Writes a file next to `path` under a name of its own and renames it over `path`, creating the
+// directories on the way, so a concurrent reader never sees a partial file and an interrupted
+// write never leaves one. Concurrent writers of the same path each get their own temporary file
+// and the last rename wins.
+//
+// `write` fills the temporary file at the path it is given and returns whether it succeeded; on
+// failure the temporary file is removed and `path` is left as it was.
+[[nodiscard]] bool write_file_atomically(const std::filesystem::path &path,
+                                         const std::function<bool(const std::filesystem::path &)> &write);
+[[nodiscard]] bool write_file_atomically(const std::filesystem::path &path, const void *data, size_t size);
+
+}  // namespace mfsys
+
+#endif  // ATOMIC_FILE_H
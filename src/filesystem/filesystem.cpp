@@ -1,10 +1,13 @@
 #include "filesystem.h"
 
-#define STB_IMAGE_IMPLEMENTATION
-#include "stb_image.h"
+#include "mapped_file.h"
+#include "../texture/image.h"
+#include "../texture/ktx2.h"
+#include "../texture/texture.h"
 
 #include <iostream>
 #include <sstream>
+#include <string_view>
 
 mfsys::filesystem::filesystem(const std::filesystem::path &binary_path) {
   if (!std::filesystem::exists(binary_path)) throw std::runtime_error("Binary path does not exist");
@@ -15,8 +18,11 @@ mfsys::filesystem::filesystem(const std::filesystem::path &binary_path) {
     binary_path_ = binary_path.parent_path();
   }
 
+  manifest_ = asset_manifest::load(binary_path_ / "assets" / asset_manifest::file_name);
+
 #ifdef DEBUG
   std::cout << "Binary path: " << binary_path_ << std::endl;
+  if (manifest_.empty()) std::cout << "No asset manifest, using raw assets" << std::endl;
 #endif
 }
 
@@ -24,6 +30,8 @@ mfsys::filesystem::~filesystem() = default;
 
 std::filesystem::path mfsys::filesystem::get_binary_path() const { return binary_path_; }
 
+std::filesystem::path mfsys::filesystem::get_cache_path() const { return binary_path_ / "cache"; }
+
 std::string mfsys::filesystem::get(const std::string &path) const {
   std::string result = binary_path_.string();
 
@@ -43,6 +51,16 @@ std::string mfsys::filesystem::get(const std::string &path) const {
   return result;
 }
 
+std::string mfsys::filesystem::get_cooked_texture(const std::string &path, const asset_kind kind) const {
+  constexpr std::string_view assets_prefix = "assets/";
+  if (path.compare(0, assets_prefix.size(), assets_prefix) == 0) {
+    const asset_entry *entry = manifest_.find(path.substr(assets_prefix.size()), kind);
+    if (entry != nullptr) return get(std::string(assets_prefix) + entry->output);
+  }
+
+  return get(path);
+}
+
 shader mfsys::filesystem::create_shader(const std::string &vertex_path, const std::string &fragment_path) const {
   const std::string vertexShader = get(vertex_path);
   const std::string fragment_shader = get(fragment_path);
@@ -50,37 +68,73 @@ shader mfsys::filesystem::create_shader(const std::string &vertex_path, const st
   return {vertexShader, fragment_shader};
 }
 
+shader mfsys::filesystem::create_shader(const std::string &vertex_path, const std::string &geometry_path,
+                                        const std::string &fragment_path) const {
+  return {get(vertex_path), get(geometry_path), get(fragment_path)};
+}
+
+shader mfsys::filesystem::create_compute_shader(const std::string &compute_path) const {
+  return shader(get(compute_path));
+}
+
 uint32_t mfsys::filesystem::load_texture(const std::string &path) const {
-  uint32_t texture_id;
-  glGenTextures(1, &texture_id);
-
-  const std::string texture = get(path);
-
-  int32_t width, height, nr_components;
-  if (unsigned char *data = stbi_load(texture.c_str(), &width, &height, &nr_components, 0)) {
-    GLint format = 0;
-    if (nr_components == 1)
-      format = GL_RED;
-    else if (nr_components == 3)
-      format = GL_RGB;
-    else if (nr_components == 4)
-      format = GL_RGBA;
-
-    glBindTexture(GL_TEXTURE_2D, texture_id);
-    glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
-    glGenerateMipmap(GL_TEXTURE_2D);
-
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-    stbi_image_free(data);
+  const image source = load_image(get(path));
+  if (source.empty()) std::cout << "Texture failed to load at path: " << path << std::endl;
+
+  return create_texture(source);
+}
+
+std::vector<uint32_t> mfsys::filesystem::load_textures(const std::vector<std::string> &paths, thread_pool &pool) const {
+  std::vector<std::string> resolved;
+  resolved.reserve(paths.size());
+  for (const auto &path : paths) resolved.push_back(get(path));
+
+  // File reads and decodes run on the workers; only the uploads below touch the GL context.
+  const std::vector<image> sources = load_images(resolved, pool);
+
+  std::vector<uint32_t> texture_ids;
+  texture_ids.reserve(sources.size());
+  for (size_t i = 0; i < sources.size(); ++i) {
+    if (sources[i].empty()) std::cout << "Texture failed to load at path: " << paths[i] << std::endl;
+    texture_ids.push_back(create_texture(sources[i]));
+  }
+
+  return texture_ids;
+}
+
+uint32_t mfsys::filesystem::load_ktx2_texture(const std::string &path) const {
+  const mapped_file file(get(path));
+
+  ktx2_texture source;
+  if (!parse_ktx2(file.data(), file.size(), source)) {
+    std::cout << "Texture failed to load at path: " << path << std::endl;
   }
-  else {
+
+  return create_ktx2_texture(source);
+}
+
+uint32_t mfsys::filesystem::load_hdr_texture(const std::string &path, const hdr_format format) const {
+  const std::string resolved = get(path);
+  if (std::filesystem::path(resolved).extension() != ".ktx2") {
+    const hdr_image source = load_hdr_image(resolved);
+    if (source.empty()) std::cout << "Texture failed to load at path: " << path << std::endl;
+    return create_hdr_texture(source, format);
+  }
+
+  const mapped_file file(resolved);
+  ktx2_texture source;
+  if (!parse_ktx2(file.data(), file.size(), source)) {
     std::cout << "Texture failed to load at path: " << path << std::endl;
-    stbi_image_free(data);
+    return create_ktx2_texture(source);
+  }
+  if (is_float_format(source.format)) return create_ktx2_texture(source);
+
+  const std::string encoding = source.find_metadata("engine.hdr_encoding");
+  const hdr_format stored = encoding == hdr_format_name(hdr_format::rgbm) ? hdr_format::rgbm : hdr_format::rgbe;
+  if (encoding.empty() || source.levels.empty()) {
+    std::cout << "Not an HDR texture: " << path << std::endl;
+    return create_ktx2_texture(source);
   }
 
-  return texture_id;
+  return create_hdr_texture(decode_hdr_texels(source.levels[0].data, source.width, source.height, stored), format);
 }
@@ -3,9 +3,14 @@
 
 #include <string>
 #include <filesystem>
+#include <vector>
 
+#include "asset_manifest.h"
+#include "../texture/hdr_image.h"
 #include "../shader/shader.h"
 
+class thread_pool;
+
 namespace mfsys {
 
 class filesystem {
@@ -16,14 +21,32 @@ class filesystem {
 
   [[nodiscard]] std::filesystem::path get_binary_path() const;
 
+  // Directory for cooked and cached assets, next to the binary.
+  [[nodiscard]] std::filesystem::path get_cache_path() const;
+
   [[nodiscard]] std::string get(const std::string &path) const;
 
+  // The asset cooker's compressed KTX2 of a source texture such as "assets/textures/wall.jpg" for
+  // one use: a colour map, a data map or a normal map. The source itself when the manifest has
+  // none, so the runtime cooks it for that use.
+  [[nodiscard]] std::string get_cooked_texture(const std::string &path, asset_kind kind = asset_kind::texture) const;
+
   [[nodiscard]] shader create_shader(const std::string& vertex_path, const std::string& fragment_path) const;
+  [[nodiscard]] shader create_shader(const std::string &vertex_path, const std::string &geometry_path,
+                                     const std::string &fragment_path) const;
+  [[nodiscard]] shader create_compute_shader(const std::string &compute_path) const;
   [[nodiscard]] uint32_t load_texture(const std::string &path) const;
+  [[nodiscard]] std::vector<uint32_t> load_textures(const std::vector<std::string> &paths, thread_pool &pool) const;
+  // Maps a KTX2 file and uploads its stored mip chain level by level.
+  [[nodiscard]] uint32_t load_ktx2_texture(const std::string &path) const;
+  // Loads a .hdr image in `format`, or a cooked HDR KTX2 (see Asset_Cooker --hdr-format) as
+  // stored. RGBE and RGBM files are decoded and uploaded in `format`.
+  [[nodiscard]] uint32_t load_hdr_texture(const std::string &path, hdr_format format = hdr_format::r11g11b10f) const;
   // TODO: Probably other create assets like texture, model, etc.
 
  private:
   std::filesystem::path binary_path_;
+  asset_manifest manifest_;
 };
 
 }  // namespace mfsys
@@ -0,0 +1,98 @@
+#include "mapped_file.h"
+
+#include <utility>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+mfsys::mapped_file::mapped_file(const std::filesystem::path &path) {
+#ifdef _WIN32
+  HANDLE file = CreateFileW(path.wstring().c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                            FILE_ATTRIBUTE_NORMAL, nullptr);
+  if (file == INVALID_HANDLE_VALUE) return;
+
+  LARGE_INTEGER size;
+  if (!GetFileSizeEx(file, &size) || size.QuadPart == 0) {
+    CloseHandle(file);
+    return;
+  }
+
+  HANDLE mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+  if (mapping == nullptr) {
+    CloseHandle(file);
+    return;
+  }
+
+  const void *view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+  if (view == nullptr) {
+    CloseHandle(mapping);
+    CloseHandle(file);
+    return;
+  }
+
+  file_ = file;
+  mapping_ = mapping;
+  data_ = static_cast<const uint8_t *>(view);
+  size_ = static_cast<size_t>(size.QuadPart);
+#else
+  const int descriptor = open(path.c_str(), O_RDONLY);
+  if (descriptor < 0) return;
+
+  struct stat status {};
+  if (fstat(descriptor, &status) != 0 || status.st_size == 0) {
+    ::close(descriptor);
+    return;
+  }
+
+  void *view = mmap(nullptr, static_cast<size_t>(status.st_size), PROT_READ, MAP_PRIVATE, descriptor, 0);
+  // The mapping keeps its own reference to the file.
+  ::close(descriptor);
+  if (view == MAP_FAILED) return;
+
+  data_ = static_cast<const uint8_t *>(view);
+  size_ = static_cast<size_t>(status.st_size);
+#endif
+}
+
+mfsys::mapped_file::mapped_file(mapped_file &&other) noexcept { *this = std::move(other); }
+
+mfsys::mapped_file &mfsys::mapped_file::operator=(mapped_file &&other) noexcept {
+  if (this == &other) return *this;
+
+  close();
+  data_ = std::exchange(other.data_, nullptr);
+  size_ = std::exchange(other.size_, 0);
+#ifdef _WIN32
+  file_ = std::exchange(other.file_, nullptr);
+  mapping_ = std::exchange(other.mapping_, nullptr);
+#endif
+
+  return *this;
+}
+
+mfsys::mapped_file::~mapped_file() { close(); }
+
+void mfsys::mapped_file::close() {
+  if (data_ == nullptr) return;
+
+#ifdef _WIN32
+  UnmapViewOfFile(data_);
+  CloseHandle(mapping_);
+  CloseHandle(file_);
+  mapping_ = nullptr;
+  file_ = nullptr;
+#else
+  munmap(const_cast<uint8_t *>(data_), size_);
+#endif
+
+  data_ = nullptr;
+  size_ = 0;
+}
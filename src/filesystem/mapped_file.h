@@ -0,0 +1,39 @@
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+
+namespace mfsys {
+
+// Read-only memory mapping of a whole file. Pages are faulted in on first access, so handing
+// data() to a worker moves the disk reads off the calling thread.
+class mapped_file {
+ public:
+  explicit mapped_file(const std::filesystem::path &path);
+  mapped_file(const mapped_file &) = delete;
+  mapped_file &operator=(const mapped_file &) = delete;
+  mapped_file(mapped_file &&other) noexcept;
+  mapped_file &operator=(mapped_file &&other) noexcept;
+
+  ~mapped_file();
+
+  [[nodiscard]] bool is_open() const { return data_ != nullptr; }
+  [[nodiscard]] const uint8_t *data() const { return data_; }
+  [[nodiscard]] size_t size() const { return size_; }
+
+ private:
+  void close();
+
+  const uint8_t *data_ = nullptr;
+  size_t size_ = 0;
+#ifdef _WIN32
+  void *file_ = nullptr;
+  void *mapping_ = nullptr;
+#endif
+};
+
+}  // namespace mfsys
+
+#endif  // MAPPED_FILE_H
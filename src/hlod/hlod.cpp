@@ -0,0 +1,66 @@
+#include "hlod.h"
+
+#include <limits>
+
+#include "../render/frustum.h"
+
+namespace {
+
+float projected_pixels(const glm::vec3 &min, const glm::vec3 &max, const glm::vec3 &camera_position,
+                       const float projection_scale) {
+  const float radius = 0.5f * glm::length(max - min);
+  const float distance = glm::length(0.5f * (min + max) - camera_position);
+  if (distance <= radius) return std::numeric_limits<float>::max();
+  return 2.0f * radius / distance * projection_scale;
+}
+
+}  // namespace
+
+hlod_selector::hlod_selector(const static_scene &scene, const hlod_set &set) : scene_(scene), set_(set) {
+  for (const static_mesh &mesh : scene_.meshes) {
+    mesh_triangles_.push_back(static_cast<uint32_t>(mesh.indices.size() / 3));
+  }
+}
+
+void hlod_selector::select(const glm::vec3 &camera_position, const glm::mat4 &view_projection,
+                           const float projection_scale, const float switch_pixels, const bool use_proxies,
+                           hlod_selection &out) const {
+  out.objects.clear();
+  out.clusters.clear();
+  out.triangles = 0;
+
+  const frustum planes = extract_frustum(view_projection);
+  const auto add_object = [&](const uint32_t index) {
+    const static_object &object = scene_.objects[index];
+    if (test_aabb(planes, object.min, object.max) == frustum_test::outside) return;
+    out.objects.push_back(index);
+    out.triangles += mesh_triangles_[object.mesh];
+  };
+
+  if (!use_proxies || set_.empty()) {
+    for (uint32_t i = 0; i < scene_.objects.size(); ++i) add_object(i);
+    return;
+  }
+
+  for (uint32_t i = 0; i < set_.clusters.size(); ++i) {
+    const hlod_cluster &cluster = set_.clusters[i];
+    const frustum_test visibility = test_aabb(planes, cluster.min, cluster.max);
+    if (visibility == frustum_test::outside) continue;
+
+    if (projected_pixels(cluster.min, cluster.max, camera_position, projection_scale) < switch_pixels) {
+      out.clusters.push_back(i);
+      out.triangles += cluster.index_count / 3;
+      continue;
+    }
+
+    const uint32_t *objects = set_.cluster_objects.data() + cluster.first_object;
+    if (visibility == frustum_test::inside) {
+      for (uint32_t j = 0; j < cluster.object_count; ++j) {
+        out.objects.push_back(objects[j]);
+        out.triangles += mesh_triangles_[scene_.objects[objects[j]].mesh];
+      }
+    } else {
+      for (uint32_t j = 0; j < cluster.object_count; ++j) add_object(objects[j]);
+    }
+  }
+}
@@ -0,0 +1,63 @@
+#ifndef HLOD_H
+#define HLOD_H
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <vector>
+
+#include "static_scene.h"
+
+// One spatial cluster of static objects and the single proxy mesh that replaces all of them in
+// the distance.
+struct hlod_cluster {
+  glm::vec3 min = glm::vec3(0.0f);  // bounds of every object in the cluster
+  glm::vec3 max = glm::vec3(0.0f);
+  uint32_t first_object = 0;  // into hlod_set::cluster_objects
+  uint32_t object_count = 0;
+  uint32_t first_vertex = 0;  // into hlod_set::vertices
+  uint32_t first_index = 0;   // into hlod_set::indices, relative to first_vertex
+  uint32_t index_count = 0;
+};
+
+// The output of build_hlod(). Proxy texture coordinates address the cluster's layer of the atlas,
+// which holds the cluster's albedo baked from six axis-aligned views.
+struct hlod_set {
+  std::vector<hlod_cluster> clusters;
+  std::vector<uint32_t> cluster_objects;  // object indices, grouped by cluster
+  std::vector<static_vertex> vertices;
+  std::vector<uint32_t> indices;
+  int32_t atlas_width = 0;
+  int32_t atlas_height = 0;
+  std::vector<uint8_t> atlas;  // RGBA8 in sRGB, one atlas_width x atlas_height layer per cluster
+
+  [[nodiscard]] bool empty() const { return clusters.empty(); }
+  [[nodiscard]] size_t atlas_layer_bytes() const { return static_cast<size_t>(atlas_width) * atlas_height * 4; }
+};
+
+struct hlod_selection {
+  std::vector<uint32_t> objects;   // drawn individually
+  std::vector<uint32_t> clusters;  // drawn as their proxy
+  size_t triangles = 0;
+};
+
+// Picks, per frame, between each cluster's objects and its proxy. Kept apart from the renderer so
+// the choice can be timed without a GL context.
+class hlod_selector {
+ public:
+  hlod_selector(const static_scene &scene, const hlod_set &set);
+
+  // Clusters whose bounding sphere projects smaller than `switch_pixels` across are drawn as their
+  // proxy; the objects of nearer clusters, and every object when `use_proxies` is false, are
+  // culled and drawn one by one. `projection_scale` is projection[1][1] times half the viewport
+  // height.
+  void select(const glm::vec3 &camera_position, const glm::mat4 &view_projection, float projection_scale,
+              float switch_pixels, bool use_proxies, hlod_selection &out) const;
+
+ private:
+  const static_scene &scene_;
+  const hlod_set &set_;
+  std::vector<uint32_t> mesh_triangles_;
+};
+
+#endif  // HLOD_H
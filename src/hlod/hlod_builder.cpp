@@ -0,0 +1,524 @@
+#include "hlod_builder.h"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <map>
+#include <unordered_map>
+#include <utility>
+
+#include "../filesystem/atomic_file.h"
+#include "../filesystem/mapped_file.h"
+#include "../utility/hash.h"
+#include "../utility/thread_pool.h"
+
+namespace {
+
+constexpr char hlod_magic[8] = {'E', 'N', 'G', 'H', 'L', 'O', 'D', '\0'};
+constexpr uint32_t hlod_version = 1;
+
+// Bump whenever clustering, simplification or baking changes so stale cache entries are rebuilt.
+constexpr uint32_t cache_version = 1;
+
+// Views are baked at this many samples per atlas texel and side, then averaged down.
+constexpr int32_t supersample = 4;
+
+// Texels an empty atlas texel may be from covered ones and still be filled in, so filtering and
+// mip levels do not pull in the background.
+constexpr int32_t dilation_passes = 4;
+
+struct hlod_header {
+  char magic[8];
+  uint32_t version;
+  uint32_t cluster_count;
+  uint32_t cluster_object_count;
+  uint32_t vertex_count;
+  uint32_t index_count;
+  int32_t atlas_width;
+  int32_t atlas_height;
+  uint32_t reserved;
+};
+static_assert(sizeof(hlod_header) == 40, "HLOD header must be packed");
+static_assert(sizeof(hlod_cluster) == 44, "HLOD clusters must be packed");
+
+struct world_triangle {
+  glm::vec3 position[3];
+  glm::vec2 uv[3];
+  uint32_t material;
+};
+
+struct cluster_proxy {
+  std::vector<static_vertex> vertices;
+  std::vector<uint32_t> indices;
+  std::vector<uint8_t> atlas;
+};
+
+// Quadric of the planes around a simplification cell, plus the plain average as a fallback.
+struct simplify_cell {
+  glm::mat3 a = glm::mat3(0.0f);
+  glm::vec3 b = glm::vec3(0.0f);
+  glm::vec3 sum = glm::vec3(0.0f);
+  uint32_t count = 0;
+};
+
+// View v looks at the cluster from direction (axis v / 2, positive when v is even); its image is
+// spanned by the two other axes.
+int32_t view_axis(const int32_t view) { return view / 2; }
+float view_sign(const int32_t view) { return view % 2 == 0 ? 1.0f : -1.0f; }
+glm::ivec2 view_plane(const int32_t view) {
+  constexpr int32_t planes[3][2] = {{2, 1}, {0, 2}, {0, 1}};
+  return {planes[view_axis(view)][0], planes[view_axis(view)][1]};
+}
+
+int32_t facing_view(const glm::vec3 &normal) {
+  const glm::vec3 magnitude = glm::abs(normal);
+  if (magnitude.x >= magnitude.y && magnitude.x >= magnitude.z) return normal.x >= 0.0f ? 0 : 1;
+  if (magnitude.y >= magnitude.z) return normal.y >= 0.0f ? 2 : 3;
+  return normal.z >= 0.0f ? 4 : 5;
+}
+
+// Position across the view, 0 to 1 over the cluster's box, and height towards the viewer.
+glm::vec3 project(const glm::vec3 &position, const int32_t view, const glm::vec3 &min, const glm::vec3 &extent) {
+  const glm::ivec2 plane = view_plane(view);
+  return {(position[plane.x] - min[plane.x]) / extent[plane.x], (position[plane.y] - min[plane.y]) / extent[plane.y],
+          view_sign(view) * position[view_axis(view)]};
+}
+
+const std::array<float, 256> &srgb_to_linear() {
+  static const std::array<float, 256> table = []() {
+    std::array<float, 256> values{};
+    for (size_t i = 0; i < values.size(); ++i) values[i] = std::pow(static_cast<float>(i) / 255.0f, 2.2f);
+    return values;
+  }();
+  return table;
+}
+
+uint8_t linear_to_srgb(const float value) {
+  return static_cast<uint8_t>(std::pow(std::clamp(value, 0.0f, 1.0f), 1.0f / 2.2f) * 255.0f + 0.5f);
+}
+
+// Bilinear, wrapping, in linear light.
+glm::vec3 sample_material(const image &material, const glm::vec2 &uv) {
+  const std::array<float, 256> &linear = srgb_to_linear();
+  const float x = uv.x * static_cast<float>(material.width) - 0.5f;
+  const float y = uv.y * static_cast<float>(material.height) - 0.5f;
+  const float fx = std::floor(x), fy = std::floor(y);
+  const float tx = x - fx, ty = y - fy;
+
+  const auto texel = [&](const int32_t i, const int32_t j) {
+    const int32_t wx = ((i % material.width) + material.width) % material.width;
+    const int32_t wy = ((j % material.height) + material.height) % material.height;
+    const uint8_t *pixel = &material.pixels[(static_cast<size_t>(wy) * material.width + wx) * material.channels];
+    return glm::vec3(linear[pixel[0]], linear[pixel[1]], linear[pixel[2]]);
+  };
+  const auto ix = static_cast<int32_t>(fx), iy = static_cast<int32_t>(fy);
+  const glm::vec3 top = glm::mix(texel(ix, iy), texel(ix + 1, iy), tx);
+  const glm::vec3 bottom = glm::mix(texel(ix, iy + 1), texel(ix + 1, iy + 1), tx);
+  return glm::mix(top, bottom, ty);
+}
+
+float edge(const glm::vec2 &a, const glm::vec2 &b, const glm::vec2 &p) {
+  return (b.x - a.x) * (p.y - a.y) - (b.y - a.y) * (p.x - a.x);
+}
+
+// Rasterizes the triangles facing `view` with a depth test, nearest to the viewer wins. Samples
+// no triangle covers keep a negative coverage.
+void bake_view(const std::vector<world_triangle> &triangles, const static_scene &scene, const int32_t view,
+               const glm::vec3 &min, const glm::vec3 &extent, const int32_t view_size, std::vector<glm::vec3> &colour,
+               std::vector<float> &depth) {
+  const int32_t size = view_size * supersample;
+  colour.assign(static_cast<size_t>(size) * size, glm::vec3(0.0f));
+  depth.assign(static_cast<size_t>(size) * size, -std::numeric_limits<float>::max());
+
+  // Texel centres span the view edge to edge, so the proxy never samples past its tile.
+  const float scale = static_cast<float>((view_size - 1) * supersample);
+  const float offset = 0.5f * static_cast<float>(supersample);
+  glm::vec3 direction(0.0f);
+  direction[view_axis(view)] = view_sign(view);
+
+  for (const world_triangle &triangle : triangles) {
+    const glm::vec3 normal = glm::cross(triangle.position[1] - triangle.position[0],
+                                        triangle.position[2] - triangle.position[0]);
+    if (glm::dot(normal, direction) <= 0.0f) continue;
+
+    glm::vec3 corners[3];
+    for (int32_t i = 0; i < 3; ++i) {
+      corners[i] = project(triangle.position[i], view, min, extent);
+      corners[i].x = corners[i].x * scale + offset;
+      corners[i].y = corners[i].y * scale + offset;
+    }
+    const glm::vec2 a(corners[0]), b(corners[1]), c(corners[2]);
+    const float area = edge(a, b, c);
+    if (std::abs(area) < 1e-8f) continue;
+
+    const glm::vec2 low = glm::min(glm::min(a, b), c), high = glm::max(glm::max(a, b), c);
+    const int32_t x0 = std::max(0, static_cast<int32_t>(std::floor(low.x)));
+    const int32_t y0 = std::max(0, static_cast<int32_t>(std::floor(low.y)));
+    const int32_t x1 = std::min(size - 1, static_cast<int32_t>(std::ceil(high.x)));
+    const int32_t y1 = std::min(size - 1, static_cast<int32_t>(std::ceil(high.y)));
+
+    const image &material = scene.materials[triangle.material];
+    for (int32_t y = y0; y <= y1; ++y) {
+      for (int32_t x = x0; x <= x1; ++x) {
+        const glm::vec2 p(static_cast<float>(x) + 0.5f, static_cast<float>(y) + 0.5f);
+        const float w0 = edge(b, c, p) / area, w1 = edge(c, a, p) / area;
+        const float w2 = 1.0f - w0 - w1;
+        if (w0 < 0.0f || w1 < 0.0f || w2 < 0.0f) continue;
+
+        const size_t index = static_cast<size_t>(y) * size + x;
+        const float height = w0 * corners[0].z + w1 * corners[1].z + w2 * corners[2].z;
+        if (height <= depth[index]) continue;
+        depth[index] = height;
+        colour[index] = sample_material(material, w0 * triangle.uv[0] + w1 * triangle.uv[1] + w2 * triangle.uv[2]);
+      }
+    }
+  }
+}
+
+// Averages the supersampled views into the atlas layer, then grows covered texels into empty ones.
+void bake_atlas(const std::vector<world_triangle> &triangles, const static_scene &scene, const glm::vec3 &min,
+                const glm::vec3 &extent, const int32_t view_size, std::vector<uint8_t> &atlas) {
+  const int32_t width = view_size * 3, height = view_size * 2;
+  std::vector<glm::vec3> texels(static_cast<size_t>(width) * height, glm::vec3(0.0f));
+  std::vector<uint8_t> covered(texels.size(), 0);
+
+  std::vector<glm::vec3> colour;
+  std::vector<float> depth;
+  const int32_t size = view_size * supersample;
+  for (int32_t view = 0; view < 6; ++view) {
+    bake_view(triangles, scene, view, min, extent, view_size, colour, depth);
+
+    const int32_t tile_x = (view % 3) * view_size, tile_y = (view / 3) * view_size;
+    for (int32_t y = 0; y < view_size; ++y) {
+      for (int32_t x = 0; x < view_size; ++x) {
+        glm::vec3 sum(0.0f);
+        int32_t samples = 0;
+        for (int32_t j = 0; j < supersample; ++j) {
+          for (int32_t i = 0; i < supersample; ++i) {
+            const size_t index = static_cast<size_t>(y * supersample + j) * size + x * supersample + i;
+            if (depth[index] == -std::numeric_limits<float>::max()) continue;
+            sum += colour[index];
+            ++samples;
+          }
+        }
+        if (samples == 0) continue;
+        const size_t texel = static_cast<size_t>(tile_y + y) * width + tile_x + x;
+        texels[texel] = sum / static_cast<float>(samples);
+        covered[texel] = 1;
+      }
+    }
+  }
+
+  std::vector<uint8_t> next;
+  for (int32_t pass = 0; pass < dilation_passes; ++pass) {
+    next = covered;
+    for (int32_t y = 0; y < height; ++y) {
+      for (int32_t x = 0; x < width; ++x) {
+        const size_t texel = static_cast<size_t>(y) * width + x;
+        if (covered[texel] != 0) continue;
+
+        // Neighbours from the same view only.
+        glm::vec3 sum(0.0f);
+        int32_t count = 0;
+        for (const glm::ivec2 step : {glm::ivec2(-1, 0), glm::ivec2(1, 0), glm::ivec2(0, -1), glm::ivec2(0, 1)}) {
+          const int32_t nx = x + step.x, ny = y + step.y;
+          if (nx < 0 || ny < 0 || nx >= width || ny >= height) continue;
+          if (nx / view_size != x / view_size || ny / view_size != y / view_size) continue;
+          const size_t neighbour = static_cast<size_t>(ny) * width + nx;
+          if (covered[neighbour] == 0) continue;
+          sum += texels[neighbour];
+          ++count;
+        }
+        if (count == 0) continue;
+        texels[texel] = sum / static_cast<float>(count);
+        next[texel] = 1;
+      }
+    }
+    covered.swap(next);
+  }
+
+  atlas.resize(texels.size() * 4);
+  for (size_t i = 0; i < texels.size(); ++i) {
+    for (int32_t c = 0; c < 3; ++c) atlas[i * 4 + c] = linear_to_srgb(texels[i][c]);
+    atlas[i * 4 + 3] = 255;
+  }
+}
+
+cluster_proxy build_proxy(const static_scene &scene, const uint32_t *objects, const uint32_t object_count,
+                          const glm::vec3 &min, const glm::vec3 &max, const hlod_build_settings &settings) {
+  std::vector<world_triangle> triangles;
+  for (uint32_t i = 0; i < object_count; ++i) {
+    const static_object &object = scene.objects[objects[i]];
+    const static_mesh &mesh = scene.meshes[object.mesh];
+    for (size_t t = 0; t + 2 < mesh.indices.size(); t += 3) {
+      world_triangle triangle{};
+      for (int32_t corner = 0; corner < 3; ++corner) {
+        const static_vertex &vertex = mesh.vertices[mesh.indices[t + corner]];
+        triangle.position[corner] = glm::vec3(object.model * glm::vec4(vertex.position, 1.0f));
+        triangle.uv[corner] = vertex.uv;
+      }
+      triangle.material = object.material;
+      triangles.push_back(triangle);
+    }
+  }
+
+  const glm::vec3 extent = glm::max(max - min, glm::vec3(1e-3f));
+  const float cell_size = std::max({extent.x, extent.y, extent.z}) / static_cast<float>(settings.simplify_cells);
+  const glm::ivec3 cells = glm::max(glm::ivec3(glm::ceil(extent / cell_size)), glm::ivec3(1));
+  const auto cell_of = [&](const glm::vec3 &position) {
+    const glm::ivec3 cell = glm::clamp(glm::ivec3((position - min) / cell_size), glm::ivec3(0), cells - 1);
+    return static_cast<uint32_t>((cell.z * cells.y + cell.y) * cells.x + cell.x);
+  };
+
+  // Every triangle adds its area-weighted plane to the cells of its corners.
+  std::unordered_map<uint32_t, simplify_cell> quadrics;
+  std::vector<std::array<uint32_t, 3>> collapsed;
+  for (const world_triangle &triangle : triangles) {
+    const glm::vec3 cross = glm::cross(triangle.position[1] - triangle.position[0],
+                                       triangle.position[2] - triangle.position[0]);
+    const float length = glm::length(cross);
+    if (length <= 0.0f) continue;
+    const glm::vec3 normal = cross / length;
+    const float area = 0.5f * length;
+    const float distance = -glm::dot(normal, triangle.position[0]);
+
+    std::array<uint32_t, 3> corners{};
+    for (int32_t corner = 0; corner < 3; ++corner) {
+      corners[corner] = cell_of(triangle.position[corner]);
+      simplify_cell &cell = quadrics[corners[corner]];
+      cell.a += area * glm::outerProduct(normal, normal);
+      cell.b += area * distance * normal;
+      cell.sum += triangle.position[corner];
+      ++cell.count;
+    }
+
+    // Triangles inside one or two cells vanish; the rest keep their winding, smallest cell first.
+    if (corners[0] == corners[1] || corners[1] == corners[2] || corners[0] == corners[2]) continue;
+    const auto first = static_cast<size_t>(std::min_element(corners.begin(), corners.end()) - corners.begin());
+    collapsed.push_back({corners[first], corners[(first + 1) % 3], corners[(first + 2) % 3]});
+  }
+  std::sort(collapsed.begin(), collapsed.end());
+  collapsed.erase(std::unique(collapsed.begin(), collapsed.end()), collapsed.end());
+
+  // The point nearest every plane of the cell, pulled slightly towards the average so flat and
+  // single-edge cells, whose quadric is singular, land on the average instead.
+  std::unordered_map<uint32_t, glm::vec3> representatives;
+  for (const auto &[index, cell] : quadrics) {
+    const glm::vec3 average = cell.sum / static_cast<float>(cell.count);
+    const float regularisation = 1e-3f * (cell.a[0][0] + cell.a[1][1] + cell.a[2][2]) + 1e-9f;
+    const glm::mat3 a = cell.a + glm::mat3(regularisation);
+    glm::vec3 position = glm::inverse(a) * (regularisation * average - cell.b);
+
+    const glm::ivec3 coordinate(static_cast<int32_t>(index % cells.x), static_cast<int32_t>(index / cells.x % cells.y),
+                                static_cast<int32_t>(index / cells.x / cells.y));
+    const glm::vec3 low = min + glm::vec3(coordinate) * cell_size;
+    if (!std::isfinite(position.x) || !std::isfinite(position.y) || !std::isfinite(position.z)) position = average;
+    representatives[index] = glm::clamp(position, low, low + cell_size);
+  }
+
+  cluster_proxy proxy;
+  std::unordered_map<uint64_t, uint32_t> vertex_of;  // cell << 3 | view
+  std::vector<glm::vec3> normals;
+  const int32_t view_size = settings.atlas_view_size;
+  const glm::vec2 atlas_size(static_cast<float>(view_size * 3), static_cast<float>(view_size * 2));
+  for (const std::array<uint32_t, 3> &triangle : collapsed) {
+    const glm::vec3 a = representatives[triangle[0]];
+    const glm::vec3 b = representatives[triangle[1]];
+    const glm::vec3 c = representatives[triangle[2]];
+    const glm::vec3 cross = glm::cross(b - a, c - a);
+    if (glm::length(cross) < 1e-4f * cell_size * cell_size) continue;
+
+    const int32_t view = facing_view(cross);
+    const glm::vec2 tile(static_cast<float>((view % 3) * view_size), static_cast<float>((view / 3) * view_size));
+    for (const uint32_t cell : triangle) {
+      const uint64_t key = static_cast<uint64_t>(cell) << 3 | static_cast<uint64_t>(view);
+      auto found = vertex_of.find(key);
+      if (found == vertex_of.end()) {
+        const glm::vec3 position = representatives[cell];
+        const glm::vec3 projected = project(position, view, min, extent);
+        const glm::vec2 texel = tile + 0.5f + glm::vec2(projected) * static_cast<float>(view_size - 1);
+        found = vertex_of.emplace(key, static_cast<uint32_t>(proxy.vertices.size())).first;
+        proxy.vertices.push_back({position, glm::vec3(0.0f), texel / atlas_size});
+        normals.emplace_back(0.0f);
+      }
+      normals[found->second] += cross;
+      proxy.indices.push_back(found->second);
+    }
+  }
+  for (size_t i = 0; i < normals.size(); ++i) proxy.vertices[i].normal = glm::normalize(normals[i]);
+
+  bake_atlas(triangles, scene, min, extent, view_size, proxy.atlas);
+  return proxy;
+}
+
+template <typename T>
+void write_vector(std::ofstream &file, const std::vector<T> &values) {
+  file.write(reinterpret_cast<const char *>(values.data()), static_cast<std::streamsize>(values.size() * sizeof(T)));
+}
+
+template <typename T>
+bool read_vector(const uint8_t *&cursor, const uint8_t *end, const size_t count, std::vector<T> &values) {
+  if (static_cast<size_t>(end - cursor) / sizeof(T) < count) return false;
+  values.resize(count);
+  std::memcpy(values.data(), cursor, count * sizeof(T));
+  cursor += count * sizeof(T);
+  return true;
+}
+
+}  // namespace
+
+hlod_set build_hlod(const static_scene &scene, const hlod_build_settings &settings, thread_pool &pool) {
+  hlod_set set;
+  if (scene.empty() || settings.cluster_size <= 0.0f || settings.simplify_cells < 1 || settings.atlas_view_size < 2) {
+    return set;
+  }
+
+  glm::vec2 origin(std::numeric_limits<float>::max());
+  for (const static_object &object : scene.objects) origin = glm::min(origin, glm::vec2(object.min.x, object.min.z));
+
+  // Grid cells in row order, so the cluster order does not depend on the order of the objects.
+  std::map<std::pair<int32_t, int32_t>, std::vector<uint32_t>> cells;
+  for (uint32_t i = 0; i < scene.objects.size(); ++i) {
+    const static_object &object = scene.objects[i];
+    const glm::vec2 centre = 0.5f * (glm::vec2(object.min.x, object.min.z) + glm::vec2(object.max.x, object.max.z));
+    const glm::ivec2 cell = glm::ivec2(glm::floor((centre - origin) / settings.cluster_size));
+    cells[{cell.y, cell.x}].push_back(i);
+  }
+
+  for (const auto &[cell, objects] : cells) {
+    hlod_cluster cluster;
+    cluster.first_object = static_cast<uint32_t>(set.cluster_objects.size());
+    cluster.object_count = static_cast<uint32_t>(objects.size());
+    cluster.min = glm::vec3(std::numeric_limits<float>::max());
+    cluster.max = glm::vec3(std::numeric_limits<float>::lowest());
+    for (const uint32_t index : objects) {
+      cluster.min = glm::min(cluster.min, scene.objects[index].min);
+      cluster.max = glm::max(cluster.max, scene.objects[index].max);
+    }
+    set.clusters.push_back(cluster);
+    set.cluster_objects.insert(set.cluster_objects.end(), objects.begin(), objects.end());
+  }
+
+  std::vector<cluster_proxy> proxies(set.clusters.size());
+  pool.parallel_for(0, set.clusters.size(), [&](const size_t i) {
+    const hlod_cluster &cluster = set.clusters[i];
+    proxies[i] = build_proxy(scene, set.cluster_objects.data() + cluster.first_object, cluster.object_count,
+                             cluster.min, cluster.max, settings);
+  });
+
+  set.atlas_width = settings.atlas_view_size * 3;
+  set.atlas_height = settings.atlas_view_size * 2;
+  set.atlas.reserve(set.atlas_layer_bytes() * proxies.size());
+  for (size_t i = 0; i < proxies.size(); ++i) {
+    hlod_cluster &cluster = set.clusters[i];
+    cluster.first_vertex = static_cast<uint32_t>(set.vertices.size());
+    cluster.first_index = static_cast<uint32_t>(set.indices.size());
+    cluster.index_count = static_cast<uint32_t>(proxies[i].indices.size());
+    set.vertices.insert(set.vertices.end(), proxies[i].vertices.begin(), proxies[i].vertices.end());
+    set.indices.insert(set.indices.end(), proxies[i].indices.begin(), proxies[i].indices.end());
+    set.atlas.insert(set.atlas.end(), proxies[i].atlas.begin(), proxies[i].atlas.end());
+  }
+  return set;
+}
+
+bool write_hlod(const std::filesystem::path &path, const hlod_set &set) {
+  return mfsys::write_file_atomically(path, [&](const std::filesystem::path &temporary) {
+    std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+    if (!file) return false;
+
+    hlod_header header{};
+    std::memcpy(header.magic, hlod_magic, sizeof(hlod_magic));
+    header.version = hlod_version;
+    header.cluster_count = static_cast<uint32_t>(set.clusters.size());
+    header.cluster_object_count = static_cast<uint32_t>(set.cluster_objects.size());
+    header.vertex_count = static_cast<uint32_t>(set.vertices.size());
+    header.index_count = static_cast<uint32_t>(set.indices.size());
+    header.atlas_width = set.atlas_width;
+    header.atlas_height = set.atlas_height;
+    file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    write_vector(file, set.clusters);
+    write_vector(file, set.cluster_objects);
+    write_vector(file, set.vertices);
+    write_vector(file, set.indices);
+    write_vector(file, set.atlas);
+    return static_cast<bool>(file);
+  });
+}
+
+bool read_hlod(const std::filesystem::path &path, hlod_set &out) {
+  out = {};
+
+  const mfsys::mapped_file file(path);
+  if (!file.is_open() || file.size() < sizeof(hlod_header)) return false;
+
+  hlod_header header{};
+  std::memcpy(&header, file.data(), sizeof(header));
+  if (std::memcmp(header.magic, hlod_magic, sizeof(hlod_magic)) != 0 || header.version != hlod_version ||
+      header.atlas_width <= 0 || header.atlas_height <= 0 || header.atlas_width > 16384 ||
+      header.atlas_height > 16384) {
+    return false;
+  }
+
+  hlod_set set;
+  set.atlas_width = header.atlas_width;
+  set.atlas_height = header.atlas_height;
+  const uint8_t *cursor = file.data() + sizeof(header);
+  const uint8_t *end = file.data() + file.size();
+  if (!read_vector(cursor, end, header.cluster_count, set.clusters) ||
+      !read_vector(cursor, end, header.cluster_object_count, set.cluster_objects) ||
+      !read_vector(cursor, end, header.vertex_count, set.vertices) ||
+      !read_vector(cursor, end, header.index_count, set.indices) ||
+      !read_vector(cursor, end, set.atlas_layer_bytes() * header.cluster_count, set.atlas)) {
+    return false;
+  }
+
+  for (const hlod_cluster &cluster : set.clusters) {
+    if (cluster.first_object > set.cluster_objects.size() ||
+        cluster.object_count > set.cluster_objects.size() - cluster.first_object ||
+        cluster.first_index > set.indices.size() || cluster.index_count > set.indices.size() - cluster.first_index ||
+        cluster.first_vertex > set.vertices.size()) {
+      return false;
+    }
+    const size_t vertex_count = set.vertices.size() - cluster.first_vertex;
+    const auto first = set.indices.begin() + cluster.first_index;
+    if (std::any_of(first, first + cluster.index_count, [&](const uint32_t index) { return index >= vertex_count; })) {
+      return false;
+    }
+  }
+
+  out = std::move(set);
+  return true;
+}
+
+hlod_set cook_hlod(const static_scene &scene, const std::filesystem::path &cache_directory,
+                   const hlod_build_settings &settings, thread_pool &pool) {
+  const uint32_t parameters[3] = {cache_version, static_cast<uint32_t>(settings.simplify_cells),
+                                  static_cast<uint32_t>(settings.atlas_view_size)};
+  uint64_t key = fnv1a_64(parameters, sizeof(parameters), hash_static_scene(scene));
+  key = fnv1a_64(&settings.cluster_size, sizeof(settings.cluster_size), key);
+  const std::filesystem::path cached = cache_directory / (hash_to_hex(key) + ".hlod");
+
+  // The file only knows how many objects it was built for through the key, so a corrupt one could name
+  // objects the scene does not have.
+  hlod_set set;
+  if (read_hlod(cached, set) &&
+      std::all_of(set.cluster_objects.begin(), set.cluster_objects.end(),
+                  [&](const uint32_t object) { return object < scene.objects.size(); })) {
+    return set;
+  }
+
+  const auto start = std::chrono::steady_clock::now();
+  set = build_hlod(scene, settings, pool);
+  if (set.empty()) return set;
+  const std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+
+  if (!write_hlod(cached, set)) std::cout << "Failed to write HLOD proxies: " << cached << std::endl;
+  std::cout << "Built " << set.clusters.size() << " HLOD proxies for " << scene.objects.size() << " objects into "
+            << cached.filename() << " in " << elapsed.count() << " ms" << std::endl;
+  return set;
+}
@@ -0,0 +1,39 @@
+#ifndef HLOD_BUILDER_H
+#define HLOD_BUILDER_H
+
+#include <cstdint>
+#include <filesystem>
+
+#include "hlod.h"
+
+class thread_pool;
+
+struct hlod_build_settings {
+  float cluster_size = 128.0f;  // metres; objects are grouped by the xz cell their centre falls in
+  // Vertex clustering grid cells across the longest side of a cluster; every cell collapses to one
+  // vertex, so this bounds the proxy's detail.
+  int32_t simplify_cells = 32;
+  int32_t atlas_view_size = 64;  // texels across each of the six baked views
+};
+
+// Groups the scene's objects into clusters on a grid and builds each cluster's proxy on the pool:
+// the objects' triangles are merged in world space and simplified by vertex clustering, each cell
+// moving to the point closest to the planes of its triangles so edges and corners survive. The
+// atlas holds six orthographic views of the cluster's box, one per axis direction, rasterized
+// from the source triangles and materials with four times supersampling; every proxy triangle
+// takes its texture coordinates from the view it faces most. Surfaces hidden from all six views,
+// such as facades facing each other inside a cluster, take the colour of whatever hides them, which
+// does not show at the distances proxies are drawn from.
+[[nodiscard]] hlod_set build_hlod(const static_scene &scene, const hlod_build_settings &settings, thread_pool &pool);
+
+[[nodiscard]] bool write_hlod(const std::filesystem::path &path, const hlod_set &set);
+// Leaves `out` empty and returns false when `path` cannot be read or is not an HLOD file, or when a
+// cluster reaches past its objects, indices or vertices.
+[[nodiscard]] bool read_hlod(const std::filesystem::path &path, hlod_set &out);
+
+// Like cook_terrain(): reads the proxies for `scene` from `cache_directory`, building and writing
+// them first when the scene or settings changed.
+[[nodiscard]] hlod_set cook_hlod(const static_scene &scene, const std::filesystem::path &cache_directory,
+                                 const hlod_build_settings &settings, thread_pool &pool);
+
+#endif  // HLOD_BUILDER_H
@@ -0,0 +1,522 @@
+#include "hlod_renderer.h"
+
+#include <glad/glad.h>
+
+#include <algorithm>
+#include <bitset>
+#include <chrono>
+#include <cstddef>
+#include <iomanip>
+#include <iostream>
+
+#include "../render/cascaded_shadow_map.h"
+#include "../render/occlusion_buffer.h"
+#include "../render/occlusion_queries.h"
+#include "../scene/potentially_visible_set.h"
+#include "../shader/shader.h"
+#include "../utility/thread_pool.h"
+
+namespace {
+
+constexpr GLuint position_location = 0;
+constexpr GLuint normal_location = 1;
+constexpr GLuint uv_location = 2;
+
+constexpr GLint material_unit = 0;
+constexpr GLint atlas_unit = 1;
+
+template <typename T>
+bool is_finished(const std::future<T> &future) {
+  return future.valid() && future.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+}
+
+uint32_t create_texture_array(const int32_t width, const int32_t height, const int32_t layers,
+                              const uint8_t *pixels, const GLint wrap) {
+  uint32_t texture_id;
+  glGenTextures(1, &texture_id);
+  glBindTexture(GL_TEXTURE_2D_ARRAY, texture_id);
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+  glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_RGBA8, width, height, layers, 0, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+  glGenerateMipmap(GL_TEXTURE_2D_ARRAY);
+  glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, wrap);
+  glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, wrap);
+  glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+  return texture_id;
+}
+
+}  // namespace
+
+hlod_renderer::hlod_renderer(thread_pool &pool, const hlod_render_settings &config) : pool_(pool), config_(config) {
+  glGenVertexArrays(1, &vao_);
+  glGenBuffers(1, &vertex_buffer_);
+  glGenBuffers(1, &index_buffer_);
+
+  glBindVertexArray(vao_);
+  glBindBuffer(GL_ARRAY_BUFFER, vertex_buffer_);
+  glVertexAttribPointer(position_location, 3, GL_FLOAT, GL_FALSE, sizeof(static_vertex),
+                        reinterpret_cast<void *>(offsetof(static_vertex, position)));
+  glEnableVertexAttribArray(position_location);
+  glVertexAttribPointer(normal_location, 3, GL_FLOAT, GL_FALSE, sizeof(static_vertex),
+                        reinterpret_cast<void *>(offsetof(static_vertex, normal)));
+  glEnableVertexAttribArray(normal_location);
+  glVertexAttribPointer(uv_location, 2, GL_FLOAT, GL_FALSE, sizeof(static_vertex),
+                        reinterpret_cast<void *>(offsetof(static_vertex, uv)));
+  glEnableVertexAttribArray(uv_location);
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, index_buffer_);
+  glBindVertexArray(0);
+}
+
+hlod_renderer::~hlod_renderer() {
+  // The build reads scene_.
+  if (pending_.valid()) pending_.wait();
+
+  glDeleteVertexArrays(1, &vao_);
+  glDeleteBuffers(1, &vertex_buffer_);
+  glDeleteBuffers(1, &index_buffer_);
+  if (material_texture_ != 0) glDeleteTextures(1, &material_texture_);
+  if (atlas_texture_ != 0) glDeleteTextures(1, &atlas_texture_);
+}
+
+void hlod_renderer::load(static_scene scene, const std::filesystem::path &cache_directory) {
+  if (pending_.valid()) pending_.wait();
+  selector_.reset();
+  set_ = {};
+  object_cluster_.clear();
+
+  scene_ = std::move(scene);
+  stats_.scene_objects = scene_.objects.size();
+  stats_.clusters = 0;
+  selector_ = std::make_unique<hlod_selector>(scene_, set_);
+  upload_geometry();
+  upload_materials();
+
+  pending_ = pool_.submit([this, cache_directory]() {
+    return cook_hlod(scene_, cache_directory, config_.build, pool_);
+  });
+}
+
+void hlod_renderer::update() {
+  if (!is_finished(pending_)) return;
+
+  set_ = pending_.get();
+  if (set_.empty()) {
+    std::cout << "HLOD proxies failed to build, drawing every object" << std::endl;
+    return;
+  }
+  stats_.clusters = set_.clusters.size();
+  object_cluster_.assign(scene_.objects.size(), 0);
+  for (uint32_t i = 0; i < set_.clusters.size(); ++i) {
+    const hlod_cluster &cluster = set_.clusters[i];
+    const uint32_t *objects = set_.cluster_objects.data() + cluster.first_object;
+    for (uint32_t j = 0; j < cluster.object_count; ++j) object_cluster_[objects[j]] = i;
+  }
+  upload_geometry();
+  upload_atlas();
+}
+
+void hlod_renderer::upload_geometry() {
+  std::vector<static_vertex> vertices;
+  std::vector<uint32_t> indices;
+  mesh_first_vertex_.clear();
+  mesh_first_index_.clear();
+  for (const static_mesh &mesh : scene_.meshes) {
+    mesh_first_vertex_.push_back(static_cast<uint32_t>(vertices.size()));
+    mesh_first_index_.push_back(static_cast<uint32_t>(indices.size()));
+    vertices.insert(vertices.end(), mesh.vertices.begin(), mesh.vertices.end());
+    indices.insert(indices.end(), mesh.indices.begin(), mesh.indices.end());
+  }
+  proxy_first_vertex_ = static_cast<uint32_t>(vertices.size());
+  proxy_first_index_ = static_cast<uint32_t>(indices.size());
+  vertices.insert(vertices.end(), set_.vertices.begin(), set_.vertices.end());
+  indices.insert(indices.end(), set_.indices.begin(), set_.indices.end());
+
+  glBindVertexArray(vao_);
+  glBindBuffer(GL_ARRAY_BUFFER, vertex_buffer_);
+  glBufferData(GL_ARRAY_BUFFER, static_cast<GLsizeiptr>(vertices.size() * sizeof(static_vertex)), vertices.data(),
+               GL_STATIC_DRAW);
+  glBufferData(GL_ELEMENT_ARRAY_BUFFER, static_cast<GLsizeiptr>(indices.size() * sizeof(uint32_t)), indices.data(),
+               GL_STATIC_DRAW);
+  glBindVertexArray(0);
+}
+
+void hlod_renderer::upload_materials() {
+  if (material_texture_ != 0) glDeleteTextures(1, &material_texture_);
+  material_texture_ = 0;
+  if (scene_.materials.empty()) return;
+
+  const image &like = scene_.materials.front();
+  std::vector<uint8_t> pixels;
+  pixels.reserve(like.pixels.size() * scene_.materials.size());
+  for (const image &material : scene_.materials) {
+    if (material.width != like.width || material.height != like.height || material.channels != 4) {
+      std::cout << "HLOD scene materials must all be RGBA and " << like.width << "x" << like.height << std::endl;
+      return;
+    }
+    pixels.insert(pixels.end(), material.pixels.begin(), material.pixels.end());
+  }
+  material_texture_ = create_texture_array(like.width, like.height, static_cast<int32_t>(scene_.materials.size()),
+                                           pixels.data(), GL_REPEAT);
+}
+
+void hlod_renderer::upload_atlas() {
+  if (atlas_texture_ != 0) glDeleteTextures(1, &atlas_texture_);
+  // Views sit side by side in the atlas; clamping keeps the outer ones from wrapping.
+  atlas_texture_ = create_texture_array(set_.atlas_width, set_.atlas_height, static_cast<int32_t>(set_.clusters.size()),
+                                        set_.atlas.data(), GL_CLAMP_TO_EDGE);
+  // The GPU copy is all draw() needs.
+  set_.atlas = {};
+}
+
+void hlod_renderer::add_occluders(occlusion_buffer &buffer, const float min_size) const {
+  for (const static_object &object : scene_.objects) {
+    if (glm::any(glm::lessThan(object.max - object.min, glm::vec3(min_size)))) continue;
+    const static_mesh &mesh = scene_.meshes[object.mesh];
+    buffer.add_occluder(&mesh.vertices[0].position, sizeof(static_vertex), mesh.indices.data(), mesh.indices.size(),
+                        object.model);
+  }
+}
+
+void hlod_renderer::select(const glm::vec3 &camera_position, const glm::mat4 &projection, const glm::mat4 &view,
+                           const float viewport_height, const std::vector<uint64_t> *potentially_visible) {
+  const float projection_scale = projection[1][1] * 0.5f * viewport_height;
+  selector_->select(camera_position, projection * view, projection_scale, config_.switch_pixels,
+                    config_.use_proxies && atlas_texture_ != 0, selection_);
+  if (potentially_visible == nullptr) return;
+
+  const auto unseen = [&](const uint32_t object) {
+    return !potentially_visible_set::contains(*potentially_visible, object);
+  };
+  selection_.objects.erase(std::remove_if(selection_.objects.begin(), selection_.objects.end(),
+                                          [&](const uint32_t index) {
+                                            if (!unseen(index)) return false;
+                                            ++stats_.unseen;
+                                            selection_.triangles -=
+                                                scene_.meshes[scene_.objects[index].mesh].indices.size() / 3;
+                                            return true;
+                                          }),
+                           selection_.objects.end());
+  selection_.clusters.erase(std::remove_if(selection_.clusters.begin(), selection_.clusters.end(),
+                                           [&](const uint32_t index) {
+                                             const hlod_cluster &cluster = set_.clusters[index];
+                                             const auto first = set_.cluster_objects.begin() + cluster.first_object;
+                                             if (!std::all_of(first, first + cluster.object_count, unseen)) {
+                                               return false;
+                                             }
+                                             ++stats_.unseen;
+                                             selection_.triangles -= cluster.index_count / 3;
+                                             return true;
+                                           }),
+                            selection_.clusters.end());
+}
+
+void hlod_renderer::draw_object(const shader &program, const uint32_t index) const {
+  const static_object &object = scene_.objects[index];
+  const static_mesh &mesh = scene_.meshes[object.mesh];
+  program.setMat4("model", object.model);
+  program.setInt("layer", static_cast<int32_t>(object.material));
+  glDrawElementsBaseVertex(GL_TRIANGLES, static_cast<GLsizei>(mesh.indices.size()), GL_UNSIGNED_INT,
+                           reinterpret_cast<void *>(mesh_first_index_[object.mesh] * sizeof(uint32_t)),
+                           static_cast<GLint>(mesh_first_vertex_[object.mesh]));
+}
+
+void hlod_renderer::draw_proxy(const shader &program, const uint32_t index) const {
+  const hlod_cluster &cluster = set_.clusters[index];
+  program.setInt("layer", static_cast<int32_t>(index));
+  glDrawElementsBaseVertex(
+      GL_TRIANGLES, static_cast<GLsizei>(cluster.index_count), GL_UNSIGNED_INT,
+      reinterpret_cast<void *>((proxy_first_index_ + static_cast<size_t>(cluster.first_index)) * sizeof(uint32_t)),
+      static_cast<GLint>(proxy_first_vertex_ + cluster.first_vertex));
+}
+
+void hlod_renderer::draw(const shader &program, const glm::vec3 &camera_position, const glm::mat4 &projection,
+                         const glm::mat4 &view, const float viewport_height, const occlusion_buffer *occlusion,
+                         const std::vector<uint64_t> *potentially_visible) {
+  stats_.objects = stats_.proxies = stats_.occluded = stats_.unseen = stats_.draw_calls = stats_.triangles = 0;
+  if (selector_ == nullptr || material_texture_ == 0) return;
+
+  const auto start = std::chrono::steady_clock::now();
+  // The set is the cheaper test, so it goes first and leaves less for the occlusion buffer.
+  select(camera_position, projection, view, viewport_height, potentially_visible);
+  if (occlusion != nullptr) {
+    const auto hidden = [&](const glm::vec3 &min, const glm::vec3 &max, const size_t triangles) {
+      if (occlusion->is_visible(min, max)) return false;
+      ++stats_.occluded;
+      selection_.triangles -= triangles;
+      return true;
+    };
+    selection_.objects.erase(std::remove_if(selection_.objects.begin(), selection_.objects.end(),
+                                            [&](const uint32_t index) {
+                                              const static_object &object = scene_.objects[index];
+                                              return hidden(object.min, object.max,
+                                                            scene_.meshes[object.mesh].indices.size() / 3);
+                                            }),
+                             selection_.objects.end());
+    selection_.clusters.erase(std::remove_if(selection_.clusters.begin(), selection_.clusters.end(),
+                                             [&](const uint32_t index) {
+                                               const hlod_cluster &cluster = set_.clusters[index];
+                                               return hidden(cluster.min, cluster.max, cluster.index_count / 3);
+                                             }),
+                              selection_.clusters.end());
+  }
+  stats_.selection_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+  glBindVertexArray(vao_);
+  glActiveTexture(GL_TEXTURE0 + material_unit);
+  glBindTexture(GL_TEXTURE_2D_ARRAY, material_texture_);
+  program.setInt("materials", material_unit);
+  program.setInt("atlases", atlas_unit);
+
+  program.setBool("useAtlas", false);
+  for (const uint32_t index : selection_.objects) draw_object(program, index);
+
+  if (!selection_.clusters.empty()) {
+    glActiveTexture(GL_TEXTURE0 + atlas_unit);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, atlas_texture_);
+    program.setBool("useAtlas", true);
+    program.setMat4("model", glm::mat4(1.0f));
+    for (const uint32_t index : selection_.clusters) draw_proxy(program, index);
+  }
+  glActiveTexture(GL_TEXTURE0);
+  glBindVertexArray(0);
+
+  stats_.objects = selection_.objects.size();
+  stats_.proxies = selection_.clusters.size();
+  stats_.draw_calls = stats_.objects + stats_.proxies;
+  stats_.triangles = selection_.triangles;
+}
+
+void hlod_renderer::draw_queried(const shader &program, const shader &box_program, occlusion_queries &queries,
+                                 const glm::vec3 &camera_position, const glm::mat4 &projection,
+                                 const glm::mat4 &view, const float viewport_height,
+                                 const std::vector<uint64_t> *potentially_visible) {
+  stats_.objects = stats_.proxies = stats_.occluded = stats_.unseen = stats_.draw_calls = stats_.triangles = 0;
+  if (selector_ == nullptr || material_texture_ == 0) return;
+
+  const auto start = std::chrono::steady_clock::now();
+  select(camera_position, projection, view, viewport_height, potentially_visible);
+
+  // Objects are nodes 0 to n - 1 and clusters the nodes after them.
+  const auto object_nodes = static_cast<uint32_t>(scene_.objects.size());
+  if (queries.size() != object_nodes + set_.clusters.size()) queries.resize(object_nodes + set_.clusters.size());
+  queries.begin_frame();
+  const bool grouped = !object_cluster_.empty();
+  const auto object_near = [&](const uint32_t index) {
+    return queries.is_near(camera_position, scene_.objects[index].min, scene_.objects[index].max);
+  };
+  const auto cluster_near = [&](const uint32_t index) {
+    return queries.is_near(camera_position, set_.clusters[index].min, set_.clusters[index].max);
+  };
+
+  // Push visibility down from clusters just found visible, and pull it up from clusters whose objects
+  // in view were all found hidden, so those are tested as one box.
+  std::vector<uint32_t> in_view(grouped ? set_.clusters.size() : 0, 0);
+  std::vector<uint32_t> known_hidden(in_view.size(), 0);
+  for (const uint32_t index : selection_.objects) {
+    if (!grouped) break;
+    const uint32_t cluster = object_cluster_[index];
+    if (queries.revealed(object_nodes + cluster)) queries.set_visible(index, true, true);
+    ++in_view[cluster];
+    known_hidden[cluster] += !queries.visible(index) && !queries.pending(index) && !object_near(index);
+  }
+  for (uint32_t cluster = 0; cluster < in_view.size(); ++cluster) {
+    const uint32_t node = object_nodes + cluster;
+    if (in_view[cluster] == 0) continue;
+    if (cluster_near(cluster)) {
+      queries.set_visible(node, true);
+    } else if (known_hidden[cluster] == in_view[cluster]) {
+      queries.set_visible(node, false);
+    }
+  }
+
+  // What to draw now, with whether to test it with its draw, and what to test with a box first.
+  std::vector<std::pair<uint32_t, bool>> drawn_objects, drawn_proxies;
+  std::vector<uint32_t> tested_objects, tested_proxies;
+  std::vector<std::pair<uint32_t, uint32_t>> tested_groups;  // cluster, object
+  const auto classify = [&](const uint32_t node, const bool near, std::vector<std::pair<uint32_t, bool>> &drawn,
+                            std::vector<uint32_t> &tested, const uint32_t index) {
+    if (near) {
+      queries.set_visible(node, true);
+      drawn.emplace_back(index, false);
+    } else if (queries.visible(node)) {
+      drawn.emplace_back(index, queries.due(node));
+    } else {
+      tested.push_back(index);
+    }
+  };
+  for (const uint32_t index : selection_.objects) {
+    if (grouped && !queries.visible(object_nodes + object_cluster_[index])) {
+      tested_groups.emplace_back(object_cluster_[index], index);
+    } else {
+      classify(index, object_near(index), drawn_objects, tested_objects, index);
+    }
+  }
+  for (const uint32_t index : selection_.clusters) {
+    classify(object_nodes + index, cluster_near(index), drawn_proxies, tested_proxies, index);
+  }
+  std::stable_sort(tested_groups.begin(), tested_groups.end(),
+                   [](const auto &a, const auto &b) { return a.first < b.first; });
+  stats_.selection_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+  const auto bind = [&]() {
+    program.use();
+    glBindVertexArray(vao_);
+    glActiveTexture(GL_TEXTURE0 + material_unit);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, material_texture_);
+    glActiveTexture(GL_TEXTURE0 + atlas_unit);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, atlas_texture_);
+    program.setInt("materials", material_unit);
+    program.setInt("atlases", atlas_unit);
+  };
+  const auto draw_run = [&](const std::vector<std::pair<uint32_t, bool>> &run, const bool proxies) {
+    program.setBool("useAtlas", proxies);
+    if (proxies) program.setMat4("model", glm::mat4(1.0f));
+    for (const auto &[index, test] : run) {
+      const uint32_t node = proxies ? object_nodes + index : index;
+      if (test) queries.begin_query(node);
+      if (proxies) {
+        draw_proxy(program, index);
+      } else {
+        draw_object(program, index);
+      }
+      if (test) queries.end_query();
+    }
+  };
+
+  // What was visible goes first, so the boxes are tested against its depth.
+  bind();
+  draw_run(drawn_objects, false);
+  draw_run(drawn_proxies, true);
+
+  if (!tested_objects.empty() || !tested_proxies.empty() || !tested_groups.empty()) {
+    queries.begin_boxes(box_program, projection * view);
+    for (const uint32_t index : tested_objects) {
+      if (!queries.pending(index)) queries.query_box(index, scene_.objects[index].min, scene_.objects[index].max);
+    }
+    for (const uint32_t index : tested_proxies) {
+      if (!queries.pending(object_nodes + index)) {
+        queries.query_box(object_nodes + index, set_.clusters[index].min, set_.clusters[index].max);
+      }
+    }
+    for (size_t i = 0; i < tested_groups.size(); ++i) {
+      const uint32_t cluster = tested_groups[i].first;
+      if ((i == 0 || tested_groups[i - 1].first != cluster) && !queries.pending(object_nodes + cluster)) {
+        queries.query_box(object_nodes + cluster, set_.clusters[cluster].min, set_.clusters[cluster].max);
+      }
+    }
+    queries.end_boxes();
+  }
+
+  size_t skipped_triangles = 0;
+  if (queries.mode() == occlusion_query_mode::conditional) {
+    // A node whose box was not queried, because a query from an earlier frame is still in flight, is
+    // drawn without the condition: that query may have found it hidden before it came into view.
+    const auto begin_conditional = [&](const uint32_t node) {
+      if (queries.issued_now(node)) queries.begin_conditional(node);
+    };
+    const auto end_conditional = [&](const uint32_t node) {
+      if (queries.issued_now(node)) queries.end_conditional();
+    };
+    bind();
+    program.setBool("useAtlas", false);
+    for (const uint32_t index : tested_objects) {
+      begin_conditional(index);
+      draw_object(program, index);
+      end_conditional(index);
+    }
+    for (size_t i = 0; i < tested_groups.size(); ++i) {
+      const uint32_t cluster = tested_groups[i].first;
+      if (i == 0 || tested_groups[i - 1].first != cluster) begin_conditional(object_nodes + cluster);
+      draw_object(program, tested_groups[i].second);
+      if (i + 1 == tested_groups.size() || tested_groups[i + 1].first != cluster) {
+        end_conditional(object_nodes + cluster);
+      }
+    }
+    program.setBool("useAtlas", true);
+    program.setMat4("model", glm::mat4(1.0f));
+    for (const uint32_t index : tested_proxies) {
+      begin_conditional(object_nodes + index);
+      draw_proxy(program, index);
+      end_conditional(object_nodes + index);
+    }
+  } else {
+    // Left out until a result says otherwise.
+    stats_.occluded = tested_objects.size() + tested_groups.size() + tested_proxies.size();
+    for (const uint32_t index : tested_objects) {
+      skipped_triangles += scene_.meshes[scene_.objects[index].mesh].indices.size() / 3;
+    }
+    for (const auto &[cluster, index] : tested_groups) {
+      skipped_triangles += scene_.meshes[scene_.objects[index].mesh].indices.size() / 3;
+    }
+    for (const uint32_t index : tested_proxies) skipped_triangles += set_.clusters[index].index_count / 3;
+  }
+  glActiveTexture(GL_TEXTURE0);
+  glBindVertexArray(0);
+  queries.end_frame();
+
+  const bool conditional = queries.mode() == occlusion_query_mode::conditional;
+  stats_.objects = drawn_objects.size() + (conditional ? tested_objects.size() + tested_groups.size() : 0);
+  stats_.proxies = drawn_proxies.size() + (conditional ? tested_proxies.size() : 0);
+  stats_.draw_calls = stats_.objects + stats_.proxies;
+  stats_.triangles = selection_.triangles - skipped_triangles;
+}
+
+void hlod_renderer::add_to(gpu_culler &culler) const {
+  std::vector<uint32_t> meshes;
+  meshes.reserve(scene_.meshes.size());
+  for (size_t i = 0; i < scene_.meshes.size(); ++i) {
+    const static_mesh &mesh = scene_.meshes[i];
+    meshes.push_back(culler.add_mesh(&mesh.vertices[0].position, sizeof(static_vertex), mesh.indices.data(),
+                                     mesh.indices.size(), mesh_first_index_[i],
+                                     static_cast<int32_t>(mesh_first_vertex_[i])));
+  }
+  for (const static_object &object : scene_.objects) {
+    culler.add_instance(meshes[object.mesh], object.model, object.min, object.max, object.material);
+  }
+}
+
+void hlod_renderer::draw_culled(const shader &program, const gpu_culler &culler, const gpu_cull_phase phase) const {
+  if (material_texture_ == 0) return;
+
+  glBindVertexArray(vao_);
+  glActiveTexture(GL_TEXTURE0 + material_unit);
+  glBindTexture(GL_TEXTURE_2D_ARRAY, material_texture_);
+  program.setInt("materials", material_unit);
+  program.setInt("firstDraw", static_cast<int32_t>(culler.first_command(phase)));
+  culler.draw(phase);
+  glBindVertexArray(0);
+}
+
+void hlod_renderer::draw_casters(const shader &program, cascaded_shadow_map &shadows) const {
+  if (mesh_first_index_.empty()) return;
+
+  glBindVertexArray(vao_);
+  for (const static_object &object : scene_.objects) {
+    const uint32_t cascades = shadows.cull_caster(object.min, object.max);
+    if (cascades == 0) continue;
+    const static_mesh &mesh = scene_.meshes[object.mesh];
+    program.setMat4("model", object.model);
+    program.setInt("cascadeMask", static_cast<int32_t>(cascades));
+    glDrawElementsInstancedBaseVertex(GL_TRIANGLES, static_cast<GLsizei>(mesh.indices.size()), GL_UNSIGNED_INT,
+                                      reinterpret_cast<void *>(mesh_first_index_[object.mesh] * sizeof(uint32_t)),
+                                      static_cast<GLsizei>(std::bitset<32>(cascades).count()),
+                                      static_cast<GLint>(mesh_first_vertex_[object.mesh]));
+  }
+  glBindVertexArray(0);
+}
+
+void hlod_renderer::bind_geometry(const shader &program) const {
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER, vertex_binding, vertex_buffer_);
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER, index_binding, index_buffer_);
+  glActiveTexture(GL_TEXTURE0 + material_unit);
+  glBindTexture(GL_TEXTURE_2D_ARRAY, material_texture_);
+  program.setInt("materials", material_unit);
+}
+
+void hlod_renderer::print_stats(std::ostream &out) const {
+  out << std::fixed << std::setprecision(2) << "hlod: " << (config_.use_proxies ? "on" : "off") << ", "
+      << stats_.objects << " objects and " << stats_.proxies << " proxies in " << stats_.draw_calls << " draw calls ("
+      << stats_.occluded << " occluded, " << stats_.unseen << " outside the PVS), "
+      << stats_.triangles << " triangles, selected in " << stats_.selection_ms << " ms; " << stats_.clusters
+      << " clusters over " << stats_.scene_objects << " objects" << std::endl;
+}
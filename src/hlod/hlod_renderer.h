@@ -0,0 +1,153 @@
+#ifndef HLOD_RENDERER_H
+#define HLOD_RENDERER_H
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <filesystem>
+#include <future>
+#include <iosfwd>
+#include <memory>
+#include <vector>
+
+#include "hlod.h"
+#include "hlod_builder.h"
+#include "static_scene.h"
+#include "../render/gpu_culler.h"
+
+class cascaded_shadow_map;
+class occlusion_buffer;
+class occlusion_queries;
+class shader;
+class thread_pool;
+
+struct hlod_render_settings {
+  // Clusters whose bounding sphere projects smaller than this many pixels across are drawn as
+  // their proxy.
+  float switch_pixels = 200.0f;
+  bool use_proxies = true;
+  hlod_build_settings build;
+};
+
+struct hlod_render_stats {
+  size_t objects = 0;  // drawn individually in the last draw()
+  size_t proxies = 0;  // drawn in place of their cluster
+  size_t occluded = 0;  // objects and proxies skipped as hidden
+  size_t unseen = 0;  // objects and proxies outside the potentially visible set
+  size_t draw_calls = 0;
+  size_t triangles = 0;
+  double selection_ms = 0.0;
+  size_t scene_objects = 0;
+  size_t clusters = 0;  // with a proxy on the GPU
+};
+
+// Draws a static_scene object by object up close and cluster by cluster in the distance.
+//
+// load() uploads the scene's meshes and materials and cooks the scene's HLOD proxies on a worker,
+// see cook_hlod(); until they land every object is drawn on its own. Each draw() asks an
+// hlod_selector which clusters are small enough on screen to swap for their proxy, which stands
+// in for all of the cluster's objects with a single draw call textured from the cluster's baked
+// atlas. Meshes and proxies share one vertex and one index buffer.
+//
+// All member functions must be called on the thread that owns the GL context.
+class hlod_renderer {
+ public:
+  static constexpr uint32_t vertex_binding = 10;
+  static constexpr uint32_t index_binding = 11;
+
+  explicit hlod_renderer(thread_pool &pool, const hlod_render_settings &config = {});
+  hlod_renderer(const hlod_renderer &) = delete;
+  hlod_renderer &operator=(const hlod_renderer &) = delete;
+
+  ~hlod_renderer();
+
+  // Every material of `scene` must have the size and channels of the first one.
+  void load(static_scene scene, const std::filesystem::path &cache_directory);
+
+  // Uploads the proxies once their build has finished.
+  void update();
+
+  // Queues every object at least `min_size` across on all three axes as an occluder: the buildings
+  // rather than the props around them.
+  void add_occluders(occlusion_buffer &buffer, float min_size) const;
+
+  // Draws with `program`, which must be in use and have its view and projection set. Objects and
+  // proxies `occlusion` reports hidden are skipped, as are objects missing from
+  // `potentially_visible`, the camera cell's set decoded from a potentially_visible_set baked from
+  // this scene, and proxies none of whose objects are in it.
+  void draw(const shader &program, const glm::vec3 &camera_position, const glm::mat4 &projection,
+            const glm::mat4 &view, float viewport_height, const occlusion_buffer *occlusion = nullptr,
+            const std::vector<uint64_t> *potentially_visible = nullptr);
+
+  // Like draw(), with hardware occlusion queries in place of the occlusion buffer. Objects are leaves
+  // of a two-level hierarchy under their clusters, and proxies leaves of their own; the objects and
+  // proxies last found visible are drawn first, and the rest are tested with `box_program` and then
+  // drawn under conditional rendering or left out, as `queries`' mode says. A cluster whose objects
+  // were all found hidden is tested as one box until it is found visible again, when all of its
+  // objects are drawn and tested with their draws. `queries` is sized to the hierarchy as needed.
+  void draw_queried(const shader &program, const shader &box_program, occlusion_queries &queries,
+                    const glm::vec3 &camera_position, const glm::mat4 &projection, const glm::mat4 &view,
+                    float viewport_height, const std::vector<uint64_t> *potentially_visible = nullptr);
+
+  // Hands every mesh and object to `culler`, whose instance user values are the objects' material
+  // layers, so the objects can be culled on the GPU and drawn at full detail with draw_culled().
+  // Call after load().
+  void add_to(gpu_culler &culler) const;
+
+  // Issues `culler`'s draws for `phase` with `program`, the indirect HLOD program, which must be
+  // in use and have its view and projection set. Its `firstDraw` is set to the index of the phase's
+  // first command, see gpu_culler::first_command().
+  void draw_culled(const shader &program, const gpu_culler &culler, gpu_cull_phase phase) const;
+
+  // Draws every object, at full detail, as a shadow caster into the cascades of `shadows` it reaches
+  // with `program`, the caster program, which must be in use between shadows' begin() and end().
+  void draw_casters(const shader &program, cascaded_shadow_map &shadows) const;
+
+  // For programs that fetch the meshes themselves rather than through the vertex array: binds the
+  // shared vertex buffer, as eight floats per static_vertex, and index buffer to the storage blocks
+  // at vertex_binding and index_binding, and the materials as `materials`.
+  void bind_geometry(const shader &program) const;
+
+  void set_use_proxies(const bool use_proxies) { config_.use_proxies = use_proxies; }
+  [[nodiscard]] bool use_proxies() const { return config_.use_proxies; }
+
+  [[nodiscard]] const hlod_render_stats &stats() const { return stats_; }
+  void print_stats(std::ostream &out) const;
+
+ private:
+  void upload_geometry();
+  void upload_materials();
+  void upload_atlas();
+
+  // Fills selection_ with what draw() and draw_queried() consider drawing.
+  void select(const glm::vec3 &camera_position, const glm::mat4 &projection, const glm::mat4 &view,
+              float viewport_height, const std::vector<uint64_t> *potentially_visible);
+  // Issue one draw each; vao_ and the textures must be bound and useAtlas set to match.
+  void draw_object(const shader &program, uint32_t index) const;
+  void draw_proxy(const shader &program, uint32_t index) const;
+
+  thread_pool &pool_;
+  hlod_render_settings config_;
+
+  static_scene scene_;
+  hlod_set set_;
+  std::future<hlod_set> pending_;
+  std::unique_ptr<hlod_selector> selector_;
+  hlod_selection selection_;
+  std::vector<uint32_t> object_cluster_;  // by object, once the proxies have landed
+
+  uint32_t vao_ = 0;
+  uint32_t vertex_buffer_ = 0;
+  uint32_t index_buffer_ = 0;
+  uint32_t material_texture_ = 0;
+  uint32_t atlas_texture_ = 0;
+  // Where each mesh, and the proxies after all of them, start in the shared buffers.
+  std::vector<uint32_t> mesh_first_vertex_;
+  std::vector<uint32_t> mesh_first_index_;
+  uint32_t proxy_first_vertex_ = 0;
+  uint32_t proxy_first_index_ = 0;
+
+  hlod_render_stats stats_;
+};
+
+#endif  // HLOD_RENDERER_H
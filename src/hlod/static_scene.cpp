@@ -0,0 +1,287 @@
+#include "static_scene.h"
+
+#include <glm/gtc/constants.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <random>
+
+#include "../utility/hash.h"
+
+namespace {
+
+constexpr int32_t material_size = 128;
+
+enum city_mesh : uint32_t { cube_mesh, cylinder_mesh, roof_mesh };
+enum city_material : uint32_t {
+  plaster_material,
+  concrete_material,
+  brick_material,
+  roof_tile_material,
+  flat_roof_material,
+  wood_material,
+  metal_material,
+  foliage_material,
+  bark_material,
+  material_count
+};
+
+void add_quad(static_mesh &mesh, const glm::vec3 &a, const glm::vec3 &b, const glm::vec3 &c, const glm::vec3 &d,
+              const glm::vec3 &normal) {
+  const auto first = static_cast<uint32_t>(mesh.vertices.size());
+  mesh.vertices.push_back({a, normal, glm::vec2(0.0f, 0.0f)});
+  mesh.vertices.push_back({b, normal, glm::vec2(1.0f, 0.0f)});
+  mesh.vertices.push_back({c, normal, glm::vec2(1.0f, 1.0f)});
+  mesh.vertices.push_back({d, normal, glm::vec2(0.0f, 1.0f)});
+  mesh.indices.insert(mesh.indices.end(), {first, first + 1, first + 2, first, first + 2, first + 3});
+}
+
+// Unit footprint centred on the origin, standing on y = 0.
+static_mesh make_cube() {
+  static_mesh mesh;
+  const float l = -0.5f, h = 0.5f;
+  add_quad(mesh, {l, 0, h}, {h, 0, h}, {h, 1, h}, {l, 1, h}, {0, 0, 1});
+  add_quad(mesh, {h, 0, l}, {l, 0, l}, {l, 1, l}, {h, 1, l}, {0, 0, -1});
+  add_quad(mesh, {h, 0, h}, {h, 0, l}, {h, 1, l}, {h, 1, h}, {1, 0, 0});
+  add_quad(mesh, {l, 0, l}, {l, 0, h}, {l, 1, h}, {l, 1, l}, {-1, 0, 0});
+  add_quad(mesh, {l, 1, h}, {h, 1, h}, {h, 1, l}, {l, 1, l}, {0, 1, 0});
+  add_quad(mesh, {l, 0, l}, {h, 0, l}, {h, 0, h}, {l, 0, h}, {0, -1, 0});
+  return mesh;
+}
+
+static_mesh make_cylinder(const int32_t sides) {
+  static_mesh mesh;
+  for (int32_t i = 0; i <= sides; ++i) {
+    const float u = static_cast<float>(i) / static_cast<float>(sides);
+    const float angle = u * glm::two_pi<float>();
+    const glm::vec3 normal(std::cos(angle), 0.0f, -std::sin(angle));
+    mesh.vertices.push_back({normal * 0.5f, normal, glm::vec2(u, 0.0f)});
+    mesh.vertices.push_back({normal * 0.5f + glm::vec3(0, 1, 0), normal, glm::vec2(u, 1.0f)});
+  }
+  for (uint32_t i = 0; i < static_cast<uint32_t>(sides); ++i) {
+    const uint32_t a = i * 2;
+    mesh.indices.insert(mesh.indices.end(), {a, a + 2, a + 3, a, a + 3, a + 1});
+  }
+
+  // Top cap as a fan.
+  const auto centre = static_cast<uint32_t>(mesh.vertices.size());
+  mesh.vertices.push_back({glm::vec3(0, 1, 0), glm::vec3(0, 1, 0), glm::vec2(0.5f)});
+  for (int32_t i = 0; i <= sides; ++i) {
+    const float angle = static_cast<float>(i) / static_cast<float>(sides) * glm::two_pi<float>();
+    const glm::vec2 rim(std::cos(angle) * 0.5f, -std::sin(angle) * 0.5f);
+    mesh.vertices.push_back({glm::vec3(rim.x, 1.0f, rim.y), glm::vec3(0, 1, 0), rim + 0.5f});
+  }
+  for (uint32_t i = 0; i < static_cast<uint32_t>(sides); ++i) {
+    mesh.indices.insert(mesh.indices.end(), {centre, centre + 1 + i, centre + 2 + i});
+  }
+  return mesh;
+}
+
+// A gable roof over the unit footprint, ridge along x.
+static_mesh make_roof() {
+  static_mesh mesh;
+  const float l = -0.5f, h = 0.5f;
+  const glm::vec3 front = glm::normalize(glm::vec3(0, 0.5f, 1)), back = glm::normalize(glm::vec3(0, 0.5f, -1));
+  add_quad(mesh, {l, 0, h}, {h, 0, h}, {h, 1, 0}, {l, 1, 0}, front);
+  add_quad(mesh, {h, 0, l}, {l, 0, l}, {l, 1, 0}, {h, 1, 0}, back);
+
+  const auto first = static_cast<uint32_t>(mesh.vertices.size());
+  mesh.vertices.push_back({{h, 0, h}, {1, 0, 0}, {0.0f, 0.0f}});
+  mesh.vertices.push_back({{h, 0, l}, {1, 0, 0}, {1.0f, 0.0f}});
+  mesh.vertices.push_back({{h, 1, 0}, {1, 0, 0}, {0.5f, 1.0f}});
+  mesh.vertices.push_back({{l, 0, l}, {-1, 0, 0}, {0.0f, 0.0f}});
+  mesh.vertices.push_back({{l, 0, h}, {-1, 0, 0}, {1.0f, 0.0f}});
+  mesh.vertices.push_back({{l, 1, 0}, {-1, 0, 0}, {0.5f, 1.0f}});
+  mesh.indices.insert(mesh.indices.end(), {first, first + 1, first + 2, first + 3, first + 4, first + 5});
+  return mesh;
+}
+
+float hash_noise(const int32_t x, const int32_t y, const uint32_t seed) {
+  uint32_t h = static_cast<uint32_t>(x) * 374761393u + static_cast<uint32_t>(y) * 668265263u + seed * 2246822519u;
+  h = (h ^ (h >> 13)) * 1274126177u;
+  return static_cast<float>((h ^ (h >> 16)) & 0xFFFF) / 65535.0f;
+}
+
+// Procedural albedo, tileable over the texture.
+image make_material(const uint32_t material) {
+  image result;
+  result.width = result.height = material_size;
+  result.channels = 4;
+  result.pixels.resize(static_cast<size_t>(material_size) * material_size * 4);
+
+  for (int32_t y = 0; y < material_size; ++y) {
+    for (int32_t x = 0; x < material_size; ++x) {
+      const float noise = hash_noise(x, y, material) * 0.08f - 0.04f;
+      glm::vec3 colour;
+      switch (material) {
+        case plaster_material:
+        case concrete_material:
+        case brick_material: {
+          // Facades: a 4 x 4 grid of windows over the wall.
+          const glm::vec3 walls[3] = {{0.78f, 0.70f, 0.56f}, {0.55f, 0.55f, 0.53f}, {0.55f, 0.27f, 0.20f}};
+          const bool window = x % 32 >= 9 && x % 32 < 23 && y % 32 >= 8 && y % 32 < 26;
+          colour = window ? glm::vec3(0.16f, 0.20f, 0.26f) : walls[material];
+          if (material == brick_material && !window && (y % 4 == 0 || (x + (y / 4 % 2) * 4) % 8 == 0)) {
+            colour = glm::vec3(0.70f, 0.66f, 0.60f);
+          }
+          break;
+        }
+        case roof_tile_material:
+          colour = y % 8 < 2 ? glm::vec3(0.30f, 0.12f, 0.10f) : glm::vec3(0.52f, 0.22f, 0.16f);
+          break;
+        case flat_roof_material: colour = glm::vec3(0.38f, 0.38f, 0.40f); break;
+        case wood_material:
+          colour = x % 16 == 0 ? glm::vec3(0.30f, 0.20f, 0.10f) : glm::vec3(0.58f, 0.42f, 0.24f);
+          break;
+        case metal_material: colour = glm::vec3(0.22f, 0.23f, 0.25f); break;
+        case foliage_material:
+          colour = glm::vec3(0.20f, 0.38f, 0.14f) * (0.7f + 0.6f * hash_noise(x / 4, y / 4, 99));
+          break;
+        default: colour = glm::vec3(0.32f, 0.22f, 0.14f); break;
+      }
+
+      uint8_t *pixel = &result.pixels[(static_cast<size_t>(y) * material_size + x) * 4];
+      for (int32_t c = 0; c < 3; ++c) {
+        // Stored in sRGB.
+        const float linear = std::clamp(colour[c] + noise, 0.0f, 1.0f);
+        pixel[c] = static_cast<uint8_t>(std::pow(linear, 1.0f / 2.2f) * 255.0f + 0.5f);
+      }
+      pixel[3] = 255;
+    }
+  }
+  return result;
+}
+
+}  // namespace
+
+void static_mesh::compute_bounds() {
+  min = glm::vec3(std::numeric_limits<float>::max());
+  max = glm::vec3(std::numeric_limits<float>::lowest());
+  for (const static_vertex &vertex : vertices) {
+    min = glm::min(min, vertex.position);
+    max = glm::max(max, vertex.position);
+  }
+}
+
+void static_scene::add(const uint32_t mesh, const uint32_t material, const glm::mat4 &model) {
+  static_object object;
+  object.mesh = mesh;
+  object.material = material;
+  object.model = model;
+
+  // The transformed corners of the mesh's box.
+  const static_mesh &source = meshes[mesh];
+  object.min = glm::vec3(std::numeric_limits<float>::max());
+  object.max = glm::vec3(std::numeric_limits<float>::lowest());
+  for (int32_t corner = 0; corner < 8; ++corner) {
+    const glm::vec3 local((corner & 1) ? source.max.x : source.min.x, (corner & 2) ? source.max.y : source.min.y,
+                          (corner & 4) ? source.max.z : source.min.z);
+    const glm::vec3 world = glm::vec3(model * glm::vec4(local, 1.0f));
+    object.min = glm::min(object.min, world);
+    object.max = glm::max(object.max, world);
+  }
+  objects.push_back(object);
+}
+
+size_t static_scene::triangle_count() const {
+  size_t count = 0;
+  for (const static_object &object : objects) count += meshes[object.mesh].indices.size() / 3;
+  return count;
+}
+
+uint64_t hash_static_scene(const static_scene &scene) {
+  uint64_t hash = fnv1a_64("static scene");
+  for (const static_mesh &mesh : scene.meshes) {
+    hash = fnv1a_64(mesh.vertices.data(), mesh.vertices.size() * sizeof(static_vertex), hash);
+    hash = fnv1a_64(mesh.indices.data(), mesh.indices.size() * sizeof(uint32_t), hash);
+  }
+  for (const image &material : scene.materials) {
+    const int32_t shape[3] = {material.width, material.height, material.channels};
+    hash = fnv1a_64(shape, sizeof(shape), hash);
+    hash = fnv1a_64(material.pixels.data(), material.pixels.size(), hash);
+  }
+  return fnv1a_64(scene.objects.data(), scene.objects.size() * sizeof(static_object), hash);
+}
+
+static_scene generate_city(const city_settings &settings) {
+  static_scene scene;
+  scene.meshes = {make_cube(), make_cylinder(12), make_roof()};
+  for (static_mesh &mesh : scene.meshes) mesh.compute_bounds();
+  for (uint32_t material = 0; material < material_count; ++material) scene.materials.push_back(make_material(material));
+
+  std::mt19937 random(settings.seed);
+  std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+  const auto place = [&](const uint32_t mesh, const uint32_t material, const glm::vec3 &position,
+                         const glm::vec3 &scale, const float angle) {
+    glm::mat4 model = glm::translate(glm::mat4(1.0f), position);
+    model = glm::rotate(model, angle, glm::vec3(0.0f, 1.0f, 0.0f));
+    scene.add(mesh, material, glm::scale(model, scale));
+  };
+
+  const float pitch = settings.block_size + settings.street_width;
+  const float half_city = 0.5f * pitch * static_cast<float>(settings.blocks);
+  const float pavement = 3.0f;
+
+  for (int32_t block_z = 0; block_z < settings.blocks; ++block_z) {
+    for (int32_t block_x = 0; block_x < settings.blocks; ++block_x) {
+      const glm::vec3 corner = settings.centre + glm::vec3(static_cast<float>(block_x) * pitch - half_city, 0.0f,
+                                                           static_cast<float>(block_z) * pitch - half_city);
+      const glm::vec2 from_centre = glm::vec2(corner.x - settings.centre.x, corner.z - settings.centre.z);
+      const float downtown = 1.0f - std::min(1.0f, glm::length(from_centre) / half_city);
+
+      // Two to three lots a side inside the pavement; taller towards the middle of the city.
+      const int32_t lots = 2 + static_cast<int32_t>(unit(random) * 2.0f);
+      const float lot = (settings.block_size - 2.0f * pavement) / static_cast<float>(lots);
+      for (int32_t j = 0; j < lots; ++j) {
+        for (int32_t i = 0; i < lots; ++i) {
+          const glm::vec3 centre = corner + glm::vec3(pavement + (static_cast<float>(i) + 0.5f) * lot, 0.0f,
+                                                      pavement + (static_cast<float>(j) + 0.5f) * lot);
+          const float width = lot * (0.7f + 0.2f * unit(random)), depth = lot * (0.7f + 0.2f * unit(random));
+          const float height = 6.0f + unit(random) * (10.0f + 50.0f * downtown * downtown);
+          const auto facade = static_cast<uint32_t>(unit(random) * 3.0f) % 3;
+          place(cube_mesh, facade, centre, glm::vec3(width, height, depth), 0.0f);
+
+          if (height < 20.0f && unit(random) < 0.6f) {
+            place(roof_mesh, roof_tile_material, centre + glm::vec3(0.0f, height, 0.0f),
+                  glm::vec3(width, 2.0f + unit(random) * 3.0f, depth), 0.0f);
+          } else {
+            place(cube_mesh, flat_roof_material, centre + glm::vec3(0.0f, height, 0.0f),
+                  glm::vec3(width * 0.9f, 0.4f, depth * 0.9f), 0.0f);
+          }
+        }
+      }
+
+      // Props on the pavement ring around the lots.
+      for (int32_t prop = 0; prop < settings.props_per_block; ++prop) {
+        const float along = unit(random) * settings.block_size;
+        const float across = 0.5f + unit(random) * (pavement - 1.0f);
+        const int32_t side = static_cast<int32_t>(unit(random) * 4.0f) % 4;
+        const glm::vec3 offsets[4] = {{along, 0.0f, across},
+                                      {along, 0.0f, settings.block_size - across},
+                                      {across, 0.0f, along},
+                                      {settings.block_size - across, 0.0f, along}};
+        const glm::vec3 position = corner + offsets[side];
+        const float angle = unit(random) * glm::two_pi<float>();
+
+        const float kind = unit(random);
+        if (kind < 0.35f) {
+          const float size = 0.6f + unit(random) * 0.6f;
+          place(cube_mesh, wood_material, position, glm::vec3(size), angle);
+        } else if (kind < 0.6f) {
+          place(cylinder_mesh, metal_material, position, glm::vec3(0.25f, 5.0f, 0.25f), 0.0f);
+        } else if (kind < 0.8f) {
+          const float facing = side < 2 ? 0.0f : glm::half_pi<float>();
+          place(cube_mesh, wood_material, position, glm::vec3(1.8f, 0.5f, 0.6f), facing);
+        } else {
+          place(cylinder_mesh, bark_material, position, glm::vec3(0.4f, 2.5f, 0.4f), 0.0f);
+          place(cylinder_mesh, foliage_material, position + glm::vec3(0.0f, 2.0f, 0.0f), glm::vec3(3.0f, 3.0f, 3.0f),
+                angle);
+        }
+      }
+    }
+  }
+
+  return scene;
+}
@@ -0,0 +1,65 @@
+#ifndef STATIC_SCENE_H
+#define STATIC_SCENE_H
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <vector>
+
+#include "../texture/image.h"
+
+// Interleaved like the rest of the engine's meshes: position, normal, texture coordinates.
+struct static_vertex {
+  glm::vec3 position;
+  glm::vec3 normal;
+  glm::vec2 uv;
+};
+static_assert(sizeof(static_vertex) == 32, "static vertices must be 8 floats");
+
+struct static_mesh {
+  std::vector<static_vertex> vertices;
+  std::vector<uint32_t> indices;  // triangles, counter-clockwise
+  glm::vec3 min = glm::vec3(0.0f);
+  glm::vec3 max = glm::vec3(0.0f);
+
+  void compute_bounds();
+};
+
+struct static_object {
+  uint32_t mesh = 0;
+  uint32_t material = 0;
+  glm::mat4 model = glm::mat4(1.0f);
+  glm::vec3 min = glm::vec3(0.0f);  // world bounds, see static_scene::add()
+  glm::vec3 max = glm::vec3(0.0f);
+};
+
+// Meshes placed in the world that never move, the input to HLOD generation (see hlod_builder.h).
+// Materials are RGBA8 albedo images in sRGB, all the same size, sampled with wrapping.
+struct static_scene {
+  std::vector<static_mesh> meshes;
+  std::vector<image> materials;
+  std::vector<static_object> objects;
+
+  [[nodiscard]] bool empty() const { return objects.empty(); }
+  // Places `mesh` and computes its world bounds from the mesh's.
+  void add(uint32_t mesh, uint32_t material, const glm::mat4 &model);
+  [[nodiscard]] size_t triangle_count() const;
+};
+
+// Hashes everything HLOD generation reads, for cache keys.
+[[nodiscard]] uint64_t hash_static_scene(const static_scene &scene);
+
+struct city_settings {
+  int32_t blocks = 32;        // per side
+  float block_size = 60.0f;   // metres, kerb to kerb
+  float street_width = 12.0f;
+  int32_t props_per_block = 40;  // crates, lamp posts, benches and trees along the pavements
+  uint32_t seed = 3;
+  glm::vec3 centre = glm::vec3(0.0f);
+};
+
+// A grid of city blocks, each a few buildings with pitched or flat roofs surrounded by small
+// props: many thousands of objects of a few dozen triangles each.
+[[nodiscard]] static_scene generate_city(const city_settings &settings);
+
+#endif  // STATIC_SCENE_H
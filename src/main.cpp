@@ -1,20 +1,77 @@
 #include <glad/glad.h>
 #include <GLFW/glfw3.h>
 #include <glm/glm.hpp>
+#include <glm/gtc/constants.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 
+#include <bitset>
+#include <chrono>
+#include <future>
 #include <iostream>
+#include <iterator>
+#include <random>
+#include <vector>
 #include <filesystem>
 
 #include "filesystem/filesystem.h"
 #include "camera/camera.h"
 #include "utility/frames_per_second_counter.h"
+#include "utility/thread_pool.h"
+#include "texture/texture_streamer.h"
+#include "texture/texture_uploader.h"
+#include "texture/virtual_texture_system.h"
+#include "material/material_library.h"
+#include "render/cascaded_shadow_map.h"
+#include "render/clustered_lighting.h"
+#include "render/deferred_shading.h"
+#include "render/draw_batcher.h"
+#include "render/frustum_culling.h"
+#include "render/gpu_culler.h"
+#include "render/gpu_timers.h"
+#include "render/hiz_pyramid.h"
+#include "render/light_grid.h"
+#include "render/occlusion_buffer.h"
+#include "render/occlusion_queries.h"
+#include "render/render_target.h"
+#include "render/scene_lights.h"
+#include "render/visibility_buffer.h"
+#include "scene/bvh.h"
+#include "scene/potentially_visible_set.h"
+#include "terrain/terrain.h"
+#include "voxel/voxel_renderer.h"
+#include "point_cloud/point_cloud.h"
+#include "hlod/hlod_renderer.h"
+#include "cluster_lod/cluster_lod_mesh.h"
 
 struct mouse_state {
   glm::vec2 pos = glm::vec2(0);
+  bool pressed_left = false;
   bool pressed_right = false;
+  bool pressed_middle = false;
+  bool clicked_left = false;  // since the last frame
 } mouse_state;
 
+// Keys pressed since the frame last acted on them.
+struct key_presses {
+  bool print_texture_residency = false;
+  bool print_virtual_texture_stats = false;
+  bool print_material_batches = false;
+  bool print_terrain_stats = false;
+  bool print_voxel_stats = false;
+  bool print_point_cloud_stats = false;
+  bool toggle_hlod = false;
+  bool print_hlod_stats = false;
+  bool toggle_occlusion_culling = false;
+  bool toggle_gpu_culling = false;
+  bool toggle_pvs = false;
+  bool cycle_occlusion_queries = false;
+  bool print_cluster_lod_stats = false;
+  bool cycle_point_lights = false;
+  bool print_light_stats = false;
+  bool cycle_shading_mode = false;
+  bool toggle_shadow_caching = false;
+} key_presses;
+
 camera_positioner_first_person positioner(glm::vec3(-5.0f, 5.0f, -5.0f), glm::vec3(0), glm::vec3(0.0f, 1.0f, 0.0f));
 camera camera(positioner);
 
@@ -31,6 +88,77 @@ glm::vec3 light_pos(0.0f, 2.0f, 0.0f);
 
 glm::mat4 projection = glm::perspective(glm::radians(camera.get_fov()), ratio, camera.get_z_near(), camera.get_z_far());
 
+namespace {
+
+// How the cube, the crates and the town are lit (press F to cycle).
+enum class shading_mode { forward, deferred, visibility_buffer };
+
+// The programs that draw the cube, the crates and the town in one shading mode. The town's indirect
+// program draws it after it is culled on the GPU, which macOS cannot do.
+struct lit_programs {
+  const shader *cube = nullptr;
+  const shader *crates = nullptr;
+  const shader *town = nullptr;
+  const shader *town_indirect = nullptr;
+};
+
+// The mode after `mode`, back to forward after the visibility buffer; says which it is.
+shading_mode next_shading_mode(const shading_mode mode) {
+  switch (mode) {
+    case shading_mode::forward:
+      std::cout << "deferred shading" << std::endl;
+      return shading_mode::deferred;
+    case shading_mode::deferred:
+      std::cout << "visibility buffer for the town, forward shading for the rest" << std::endl;
+      return shading_mode::visibility_buffer;
+    case shading_mode::visibility_buffer:
+      break;
+  }
+  std::cout << "forward shading" << std::endl;
+  return shading_mode::forward;
+}
+
+#ifndef __APPLE__
+// Draws the town culled on the GPU with `program`, whose uniforms the caller has set: what was visible
+// last frame first, then everything else tested against a depth pyramid of the frame so far.
+void draw_town_culled_on_gpu(const hlod_renderer &town, gpu_culler &culler, hiz_pyramid &depth,
+                             const render_target &target, const shader &program, const shader &cull_program,
+                             const shader &reduce_program, const glm::mat4 &view_projection) {
+  culler.cull(cull_program, gpu_cull_phase::early, view_projection);
+  program.use();
+  town.draw_culled(program, culler, gpu_cull_phase::early);
+
+  depth.build(reduce_program, target.depth_texture(), target.width(), target.height());
+  culler.cull(cull_program, gpu_cull_phase::late, view_projection, &depth);
+  program.use();
+  town.draw_culled(program, culler, gpu_cull_phase::late);
+}
+
+// Lights the G-buffer of the cube, the crates and the town into the target.
+void light_deferred(const deferred_shading &deferred, const shader &program, const render_target &target,
+                    const scene_lights &lights, const glm::mat4 &view_projection) {
+  program.use();
+  program.setMat4("inverseViewProjection", glm::inverse(view_projection));
+  lights.set_point_light(program);
+  lights.bind(program);
+  deferred.light(program, target);
+}
+
+// Shades the town's visibility buffer into the target from the culler's draws of this frame.
+void resolve_visibility(const visibility_buffer &visibility, const shader &program, const render_target &target,
+                        const scene_lights &lights, const glm::mat4 &view_projection, const gpu_culler &culler,
+                        const hlod_renderer &town) {
+  program.use();
+  program.setMat4("viewProjection", view_projection);
+  lights.bind(program);
+  culler.bind_draws();
+  town.bind_geometry(program);
+  visibility.resolve(program, target);
+}
+#endif
+
+}  // namespace
+
 int main(int, char **argv) {
 #pragma region Setup
 
@@ -76,13 +204,16 @@ int main(int, char **argv) {
   glfwSetFramebufferSizeCallback(window, [](auto* window, int x, int y) {
     glViewport(0, 0, x, y);
 
+    scr_width = x;
+    scr_height = y;
     ratio = static_cast<float>(x) / static_cast<float>(y);
     projection = glm::perspective(glm::radians(camera.get_fov()), ratio, camera.get_z_near(), camera.get_z_far());
   });
 
+  // Cursor positions are in screen coordinates, which differ from pixels on high-DPI displays.
   glfwSetCursorPosCallback(window, [](auto* window, double x, double y) {
     int width, height;
-    glfwGetFramebufferSize(window, &width, &height);
+    glfwGetWindowSize(window, &width, &height);
     mouse_state.pos.x = static_cast<float>(x / width);
     mouse_state.pos.y = static_cast<float>(y / height);
   });
@@ -95,6 +226,9 @@ int main(int, char **argv) {
       mouse_state.pressed_right = false;
       glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_NORMAL);
     }
+    if (button == GLFW_MOUSE_BUTTON_LEFT) mouse_state.pressed_left = action == GLFW_PRESS;
+    if (button == GLFW_MOUSE_BUTTON_LEFT && action == GLFW_PRESS) mouse_state.clicked_left = true;
+    if (button == GLFW_MOUSE_BUTTON_MIDDLE) mouse_state.pressed_middle = action == GLFW_PRESS;
   });
 
   glfwSetKeyCallback(window, [](auto* window, int key, int scancode, int action, int mods) {
@@ -106,19 +240,64 @@ int main(int, char **argv) {
     if (key == GLFW_KEY_D) positioner.movement.right = pressed;
     if (key == GLFW_KEY_SPACE) positioner.movement.up = pressed;
     if (key == GLFW_KEY_LEFT_CONTROL) positioner.movement.down = pressed;
+    if (key == GLFW_KEY_T && action == GLFW_PRESS) key_presses.print_texture_residency = true;
+    if (key == GLFW_KEY_V && action == GLFW_PRESS) key_presses.print_virtual_texture_stats = true;
+    if (key == GLFW_KEY_B && action == GLFW_PRESS) key_presses.print_material_batches = true;
+    if (key == GLFW_KEY_H && action == GLFW_PRESS) key_presses.print_terrain_stats = true;
+    if (key == GLFW_KEY_X && action == GLFW_PRESS) key_presses.print_voxel_stats = true;
+    if (key == GLFW_KEY_P && action == GLFW_PRESS) key_presses.print_point_cloud_stats = true;
+    if (key == GLFW_KEY_L && action == GLFW_PRESS) key_presses.toggle_hlod = true;
+    if (key == GLFW_KEY_O && action == GLFW_PRESS) key_presses.print_hlod_stats = true;
+    if (key == GLFW_KEY_C && action == GLFW_PRESS) key_presses.toggle_occlusion_culling = true;
+    if (key == GLFW_KEY_U && action == GLFW_PRESS) key_presses.toggle_gpu_culling = true;
+    if (key == GLFW_KEY_K && action == GLFW_PRESS) key_presses.toggle_pvs = true;
+    if (key == GLFW_KEY_Q && action == GLFW_PRESS) key_presses.cycle_occlusion_queries = true;
+    if (key == GLFW_KEY_G && action == GLFW_PRESS) key_presses.print_cluster_lod_stats = true;
+    if (key == GLFW_KEY_N && action == GLFW_PRESS) key_presses.cycle_point_lights = true;
+    if (key == GLFW_KEY_I && action == GLFW_PRESS) key_presses.print_light_stats = true;
+    if (key == GLFW_KEY_F && action == GLFW_PRESS) key_presses.cycle_shading_mode = true;
+    if (key == GLFW_KEY_J && action == GLFW_PRESS) key_presses.toggle_shadow_caching = true;
   });
 
 #pragma endregion  // Setup
 
   const mfsys::filesystem filesystem((std::filesystem::path) argv[0]);
+  thread_pool workers;
 #ifdef __APPLE__
   const shader my_shader = filesystem.create_shader("assets/shaders/shader410.vert", "assets/shaders/shader410.frag");
   const shader light_shader = filesystem.create_shader("assets/shaders/lightCube410.vert", "assets/shaders/lightCube410.frag");
   const shader grid_shader = filesystem.create_shader("assets/shaders/grid/grid410.vert", "assets/shaders/grid/grid410.frag");
+  const shader feedback_shader = filesystem.create_shader("assets/shaders/shader410.vert", "assets/shaders/virtual_texture_feedback410.frag");
+  const shader batch_shader = filesystem.create_shader("assets/shaders/material_batch410.vert", "assets/shaders/material_batch410.frag");
+  const shader terrain_shader = filesystem.create_shader("assets/shaders/terrain/terrain410.vert", "assets/shaders/terrain/terrain410.frag");
+  const shader voxel_shader = filesystem.create_shader("assets/shaders/voxel/voxel410.vert", "assets/shaders/voxel/voxel410.frag");
+  const shader point_cloud_shader = filesystem.create_shader("assets/shaders/point_cloud/point_cloud410.vert", "assets/shaders/point_cloud/point_cloud410.frag");
+  const shader hlod_shader = filesystem.create_shader("assets/shaders/hlod/hlod410.vert", "assets/shaders/hlod/hlod410.frag");
+  const shader cluster_lod_shader = filesystem.create_shader("assets/shaders/cluster_lod/cluster_lod410.vert", "assets/shaders/cluster_lod/cluster_lod410.frag");
+  const shader box_query_shader = filesystem.create_shader("assets/shaders/occlusion/box_query410.vert", "assets/shaders/occlusion/box_query410.frag");
 #else
   const shader my_shader = filesystem.create_shader("assets/shaders/shader460.vert", "assets/shaders/shader460.frag");
   const shader light_shader = filesystem.create_shader("assets/shaders/lightCube460.vert", "assets/shaders/lightCube460.frag");
   const shader grid_shader = filesystem.create_shader("assets/shaders/grid/grid460.vert", "assets/shaders/grid/grid460.frag");
+  const shader feedback_shader = filesystem.create_shader("assets/shaders/shader460.vert", "assets/shaders/virtual_texture_feedback460.frag");
+  const shader batch_shader = filesystem.create_shader("assets/shaders/material_batch460.vert", "assets/shaders/material_batch460.frag");
+  const shader terrain_shader = filesystem.create_shader("assets/shaders/terrain/terrain460.vert", "assets/shaders/terrain/terrain460.frag");
+  const shader voxel_shader = filesystem.create_shader("assets/shaders/voxel/voxel460.vert", "assets/shaders/voxel/voxel460.frag");
+  const shader point_cloud_shader = filesystem.create_shader("assets/shaders/point_cloud/point_cloud460.vert", "assets/shaders/point_cloud/point_cloud460.frag");
+  const shader hlod_shader = filesystem.create_shader("assets/shaders/hlod/hlod460.vert", "assets/shaders/hlod/hlod460.frag");
+  const shader cluster_lod_shader = filesystem.create_shader("assets/shaders/cluster_lod/cluster_lod460.vert", "assets/shaders/cluster_lod/cluster_lod460.frag");
+  const shader box_query_shader = filesystem.create_shader("assets/shaders/occlusion/box_query460.vert", "assets/shaders/occlusion/box_query460.frag");
+  const shader hlod_indirect_shader = filesystem.create_shader("assets/shaders/hlod/hlod_indirect460.vert", "assets/shaders/hlod/hlod_indirect460.frag");
+  const shader hiz_reduce_shader = filesystem.create_compute_shader("assets/shaders/gpu_culling/hiz_reduce.comp");
+  const shader gpu_cull_shader = filesystem.create_compute_shader("assets/shaders/gpu_culling/cull.comp");
+  const shader cube_gbuffer_shader = filesystem.create_shader("assets/shaders/shader460.vert", "assets/shaders/deferred/shader_gbuffer460.frag");
+  const shader batch_gbuffer_shader = filesystem.create_shader("assets/shaders/material_batch460.vert", "assets/shaders/deferred/material_batch_gbuffer460.frag");
+  const shader hlod_gbuffer_shader = filesystem.create_shader("assets/shaders/hlod/hlod460.vert", "assets/shaders/deferred/hlod_gbuffer460.frag");
+  const shader hlod_indirect_gbuffer_shader = filesystem.create_shader("assets/shaders/hlod/hlod_indirect460.vert", "assets/shaders/deferred/hlod_indirect_gbuffer460.frag");
+  const shader deferred_lighting_shader = filesystem.create_compute_shader("assets/shaders/deferred/lighting.comp");
+  const shader visibility_shader = filesystem.create_shader("assets/shaders/visibility/visibility460.vert", "assets/shaders/visibility/visibility460.frag");
+  const shader visibility_resolve_shader = filesystem.create_compute_shader("assets/shaders/visibility/resolve.comp");
+  const shader shadow_caster_shader = filesystem.create_shader("assets/shaders/shadow/caster460.vert", "assets/shaders/shadow/caster460.geom", "assets/shaders/shadow/caster460.frag");
 #endif
 
   glEnable(GL_DEPTH_TEST);
@@ -199,15 +378,250 @@ int main(int, char **argv) {
 
   // load textures (we now use a utility function to keep the code more organized)
   // -----------------------------------------------------------------------------
-  const unsigned int diffuse_map = filesystem.load_texture("assets/textures/container2.png");
-  const unsigned int specular_map = filesystem.load_texture("assets/textures/container2_specular.png");
+  // Textures come block-compressed from the asset cooker; without its manifest they are compressed on first
+  // run and read back from the on-disk cache afterwards. The streamer keeps only the mip levels the camera
+  // needs resident (press T for per-texture residency), uploading them through a ring of staging buffers.
+  texture_uploader uploader(workers);
+  texture_streamer streamer(workers, uploader);
+  texture_compression compression;
+  compression.cache_directory = filesystem.get_cache_path() / "textures";
+#ifdef __APPLE__
+  compression.format = bc_format::bc3;  // No BPTC on the 4.1 core profile.
+#else
+  compression.format = bc_format::bc7;
+#endif
+  texture_compression colour_compression = compression;
+  colour_compression.mips.srgb = true;  // the diffuse map is sRGB-encoded, so mip it in linear light
+  constexpr auto data_map = mfsys::asset_kind::data_texture;  // specular maps are cooked mipped as stored
+  const uint32_t diffuse_map =
+      streamer.request_compressed(filesystem.get_cooked_texture("assets/textures/container2.png"), colour_compression);
+  const uint32_t specular_map = streamer.request_compressed(
+      filesystem.get_cooked_texture("assets/textures/container2_specular.png", data_map), compression);
+
+  // The diffuse map is also cut into 128x128 tiles and paged in on demand from what the feedback pass
+  // sees (press V for cache statistics). The streamed copy above is the fallback until the tiles are ready.
+  virtual_texture_system virtual_textures(workers);
+  const uint32_t virtual_diffuse = virtual_textures.request(filesystem.get("assets/textures/container2.png"),
+                                                           filesystem.get_cache_path() / "virtual_textures",
+                                                           colour_compression.mips);
+
+  // A ring of crates around the cube, with maps packed into texture arrays by size and format and
+  // parameters in one material buffer: all of them go out in one draw call per bind set (press B).
+  material_library materials(workers, uploader, colour_compression, compression);
+  const uint32_t crate_materials[] = {
+    materials.add({"crate", filesystem.get_cooked_texture("assets/textures/container2.png"),
+                   filesystem.get_cooked_texture("assets/textures/container2_specular.png", data_map), 32.0f}),
+    materials.add({"polished crate", filesystem.get_cooked_texture("assets/textures/container2.png"),
+                   filesystem.get_cooked_texture("assets/textures/container2_specular.png", data_map), 128.0f}),
+    materials.add({"wooden box", filesystem.get_cooked_texture("assets/textures/container.jpg"),
+                   filesystem.get_cooked_texture("assets/textures/container.jpg", data_map), 8.0f}),
+    materials.add({"brick", filesystem.get_cooked_texture("assets/textures/wall.jpg"),
+                   filesystem.get_cooked_texture("assets/textures/wall.jpg", data_map), 4.0f}),
+    materials.add({"face", filesystem.get_cooked_texture("assets/textures/awesomeface.png"),
+                   filesystem.get_cooked_texture("assets/textures/wall.jpg", data_map), 16.0f}),
+  };
+  materials.load();
+  draw_batcher batcher(vbo);
+  constexpr mesh_range cube_mesh{0, 36};
+
+  // Only the crates inside the view frustum are batched; each is bounded by the sphere around its unit cube.
+  constexpr int32_t crate_count = 10;
+  std::vector<glm::mat4> crates;
+  bounding_sphere_set crate_bounds;
+  std::vector<uint32_t> visible_crates;
+  for (int32_t i = 0; i < crate_count; ++i) {
+    const float angle = glm::two_pi<float>() * static_cast<float>(i) / crate_count;
+    const glm::vec3 centre(4.0f * sin(angle), 0.5f, 4.0f * cos(angle));
+    crates.push_back(glm::rotate(glm::translate(glm::mat4(1.0f), centre), angle, glm::vec3(0.0f, 1.0f, 0.0f)));
+    crate_bounds.add(centre, 0.5f * glm::sqrt(3.0f));
+  }
+
+  // Kilometre-scale ground: a generated heightmap tiled into a CDLOD quadtree whose height tiles stream in
+  // around the camera (press H for statistics). Its flat middle, wide enough for the town, sits just below the grid.
+  heightmap_generator_settings ground_shape;
+  ground_shape.flat_radius = 320.0f;
+  terrain_settings ground_settings;
+  ground_settings.height_offset = -ground_shape.flat_height * ground_settings.height_scale - 0.05f;
+  terrain ground(workers, ground_settings);
+  ground.generate(ground_shape, filesystem.get_cache_path() / "terrain");
+
+  // An editable voxel hill beside the crates: left click digs, middle click builds (press X for statistics).
+  // Edited chunks are re-meshed on the workers and streamed back in.
+  voxel_volume voxels;
+  generate_voxel_terrain(voxels, {}, workers);
+  voxel_render_settings voxel_settings;
+  voxel_settings.origin = glm::vec3(20.0f, -6.0f, -32.0f);
+  voxel_renderer voxel_meshes(workers, voxel_settings);
+  double last_voxel_edit = 0.0;
+
+  // A scanned ruin on the other side of the crates, built into a point octree on first run and streamed
+  // within a fixed point budget (press P for statistics).
+  point_cloud_settings scan_settings;
+  scan_settings.origin = glm::vec3(-60.0f, -0.05f, -5.0f);
+  point_cloud scan(workers, scan_settings);
+  scan.generate({}, filesystem.get_cache_path() / "point_clouds");
+
+  // A generated town behind the crates, thousands of static objects drawn one by one up close and as one
+  // baked proxy per cluster in the distance (press L to toggle the proxies and print the GPU time of the
+  // town with and without them, O for statistics).
+  city_settings town;
+  town.blocks = 6;
+  town.block_size = 30.0f;
+  town.street_width = 10.0f;
+  town.centre = glm::vec3(0.0f, -0.05f, -175.0f);
+  hlod_render_settings town_settings;
+  town_settings.build.cluster_size = 64.0f;
+  hlod_renderer town_renderer(workers, town_settings);
+  static_scene town_scene = generate_city(town);
+
+  // Bounds of the town's objects and then the crates, for picking with a left click.
+  bvh scene_index;
+  for (const static_object &object : town_scene.objects) scene_index.add(object.min, object.max);
+  const auto first_crate = static_cast<uint32_t>(scene_index.size());
+  for (const glm::mat4 &crate : crates) {
+    const glm::vec3 extent = 0.5f * (glm::abs(glm::vec3(crate[0])) + glm::abs(glm::vec3(crate[1])) +
+                                     glm::abs(glm::vec3(crate[2])));
+    scene_index.add(glm::vec3(crate[3]) - extent, glm::vec3(crate[3]) + extent);
+  }
+  scene_index.build(workers);
+
+  // What can be seen from each 6 m cell of the town's streets at walking height, baked on a worker on
+  // first run; inside the town only the objects in the camera's cell's set are drawn (press K to toggle).
+  static_scene town_geometry;
+  town_geometry.meshes = town_scene.meshes;
+  town_geometry.objects = town_scene.objects;
+  glm::vec3 town_min = town_geometry.objects.front().min, town_max = town_geometry.objects.front().max;
+  for (const static_object &object : town_geometry.objects) {
+    town_min = glm::min(town_min, object.min);
+    town_max = glm::max(town_max, object.max);
+  }
+  pvs_settings town_pvs_settings;
+  town_pvs_settings.min = glm::vec3(town_min.x, town.centre.y + 0.5f, town_min.z);
+  town_pvs_settings.max = glm::vec3(town_max.x, town.centre.y + 6.5f, town_max.z);
+  town_pvs_settings.cell_size = glm::vec3(6.0f);
+  town_pvs_settings.rays_per_cell = 2048;
+  std::future<potentially_visible_set> town_pvs_bake =
+      workers.submit([&workers, geometry = std::move(town_geometry), settings = town_pvs_settings,
+                      cache = filesystem.get_cache_path() / "pvs"]() {
+        return cook_pvs(geometry, settings, cache, workers);
+      });
+  potentially_visible_set town_pvs;
+  std::vector<uint64_t> town_visible;
+  uint32_t town_pvs_cell = potentially_visible_set::no_cell;
+  bool use_pvs = true;
+
+  town_renderer.load(std::move(town_scene), filesystem.get_cache_path() / "hlod");
+
+  // The town's buildings drawn into a small CPU depth buffer each frame, so the objects and proxies
+  // behind them are never submitted (press C to toggle).
+  occlusion_buffer occlusion;
+  bool use_occlusion_culling = true;
+
+  // Or tested with hardware occlusion queries against the frame's own depth, drawing what is in doubt
+  // under conditional rendering or leaving it out until last frame's results say so (press Q to go
+  // from off to one and then the other).
+  occlusion_queries town_queries;
+  bool use_occlusion_queries = false;
+
+  // Or all of them culled on the GPU instead, at full detail: what was visible last frame is drawn first,
+  // then everything else is tested against a depth pyramid of the frame so far (press U to switch).
+  // Compute shaders need GL 4.3, so not on macOS.
+  bool use_gpu_culling = false;
+#ifndef __APPLE__
+  hiz_pyramid scene_depth;
+  gpu_culler town_culler;
+  town_renderer.add_to(town_culler);
+  town_culler.upload();
+#endif
+
+  // Point lights bobbing through the town's streets, shaded with clustered forward lighting: each frame
+  // they are assigned on the CPU to the froxels of the view frustum, and the material shaders only loop
+  // over the lights of their fragment's cluster (press N to go from none through 1, 10, 100 and 1000 to
+  // 10000 lights, I for statistics). Storage blocks need GL 4.3, so not on macOS.
+#ifndef __APPLE__
+  constexpr size_t point_light_counts[] = {0, 1, 10, 100, 1000, 10000};
+  size_t point_light_count = 0;
+  std::vector<point_light> street_lights(point_light_counts[std::size(point_light_counts) - 1]);
+  std::mt19937 light_random(11);
+  std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+  for (point_light &light : street_lights) {
+    light.position = glm::vec3(town_min.x + (town_max.x - town_min.x) * unit(light_random),
+                               town.centre.y + 0.5f + 5.0f * unit(light_random),
+                               town_min.z + (town_max.z - town_min.z) * unit(light_random));
+    light.radius = 4.0f + 6.0f * unit(light_random);
+    light.colour = glm::mix(glm::vec3(1.0f, 0.6f, 0.3f), glm::vec3(0.5f, 0.7f, 1.0f), unit(light_random));
+    light.intensity = 6.0f;
+  }
+  std::vector<point_light> town_lights;
+  light_grid town_light_grid;
+  clustered_lighting cluster_lights;
+#endif
+
+  // The scene is drawn offscreen so its depth can be read back mid-frame, then copied to the window.
+  render_target scene_target;
+
+  // The cube, the crates and the town either shaded forward as they are drawn, or written to a compact
+  // G-buffer and lit afterwards in one compute pass, before the rest of the scene is drawn forward on
+  // top. Or the town alone, culled on the GPU, written to a visibility buffer of triangle ids and
+  // shaded from those (press F to go from forward to deferred to visibility buffer, I for the GPU
+  // time of each pass). Compute shaders need GL 4.3, so macOS stays forward.
+  shading_mode mode = shading_mode::forward;
+#ifndef __APPLE__
+  deferred_shading deferred;
+  visibility_buffer town_visibility;
+  const lit_programs forward_programs{&my_shader, &batch_shader, &hlod_shader, &hlod_indirect_shader};
+  const lit_programs deferred_programs{&cube_gbuffer_shader, &batch_gbuffer_shader, &hlod_gbuffer_shader,
+                                       &hlod_indirect_gbuffer_shader};
+  const lit_programs visibility_programs{&my_shader, &batch_shader, &hlod_shader, &visibility_shader};
+#else
+  const lit_programs forward_programs{&my_shader, &batch_shader, &hlod_shader};
+#endif
+  // The sun's shadows over the town, the ground, the cube and the crates, in four cascades out to 250 m;
+  // the two distant ones are cached and redrawn only when the camera leaves their margin, the sun turns
+  // or a caster passed to add_dynamic_caster() touches them (press J to turn that caching off and on, I
+  // for each cascade's draws and the GPU time caching saves).
+#ifndef __APPLE__
+  cascaded_shadow_map sun_shadows;
+#endif
+  gpu_timers frame_timers;
+  const uint32_t shadow_pass = frame_timers.add("sun shadow maps");
+  const uint32_t near_shadow_pass = frame_timers.add("sun shadow maps, cached cascades reused");
+  const uint32_t forward_lit_pass = frame_timers.add("cube and crates (forward)");
+  const uint32_t town_proxies_pass = frame_timers.add("town, distant clusters as proxies");
+  const uint32_t town_full_pass = frame_timers.add("town, every object");
+  const uint32_t gbuffer_pass = frame_timers.add("cube and crates (g-buffer)");
+  const uint32_t deferred_lighting_pass = frame_timers.add("deferred lighting");
+  const uint32_t visibility_pass = frame_timers.add("visibility buffer");
+  const uint32_t visibility_resolve_pass = frame_timers.add("visibility resolve");
+  const uint32_t rest_pass = frame_timers.add("rest of the scene");
+
+  // A boulder of three million triangles past the voxel hill, built into a cluster DAG on first run and
+  // streamed page by page with about one triangle per pixel of error (press G for statistics).
+  cluster_lod_settings boulder_lod_settings;
+  boulder_lod_settings.origin = glm::vec3(40.0f, 2.5f, 55.0f);
+  cluster_lod_mesh boulder(workers, boulder_lod_settings);
+  boulder.generate({}, filesystem.get_cache_path() / "cluster_lod");
 
   my_shader.use();
   my_shader.setInt("material.diffuse", 0);
   my_shader.setInt("material.specular", 1);
+#ifndef __APPLE__
+  cube_gbuffer_shader.use();
+  cube_gbuffer_shader.setInt("material.diffuse", 0);
+  cube_gbuffer_shader.setInt("material.specular", 1);
+#endif
 
-  positioner.set_z_near(0.01f);
-  positioner.set_z_far(100.0f);
+  positioner.set_z_near(0.1f);
+  positioner.set_z_far(ground_settings.view_distance);
+  projection = glm::perspective(glm::radians(camera.get_fov()), ratio, camera.get_z_near(), camera.get_z_far());
+
+  // The sun, which also casts the shadows, and the lights every lit pass binds.
+  scene_lights lights;
+  lights.sun_direction = glm::normalize(glm::vec3(0.4f, 0.8f, 0.3f));
+#ifndef __APPLE__
+  lights.clusters = &cluster_lights;
+  lights.sun_shadows = &sun_shadows;
+#endif
 
   // uncomment this call to draw in wire frame polygons.
   // glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
@@ -219,9 +633,13 @@ int main(int, char **argv) {
     delta_time = current_frame - last_frame;
     last_frame = current_frame;
 
+    streamer.begin_frame(static_cast<float>(scr_height), glm::radians(camera.get_fov()));
+
     positioner.movement.fast_speed = (glfwGetKey(window, GLFW_KEY_LEFT_SHIFT) != GLFW_RELEASE);
     positioner.update(delta_time, mouse_state.pos, mouse_state.pressed_right);
 
+    scene_target.resize(scr_width, scr_height);
+    scene_target.bind();
     glClearColor(0.15f, 0.15f, 0.15f, 1.0f);
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
@@ -229,30 +647,235 @@ int main(int, char **argv) {
     light_pos.x = sin(glfwGetTime()) * 2.0;
     light_pos.z = cos(glfwGetTime()) * 2.0;
 
-    my_shader.use();
-    my_shader.setFloat("material.shininess", 32.0f);
-    my_shader.setVec3("light.position", light_pos);
-    my_shader.setVec3("light.ambient", 0.1f, 0.1f, 0.1f);
-    my_shader.setVec3("light.diffuse", 0.5f, 0.5f, 0.5f);
-    my_shader.setVec3("light.specular", 1.0f, 1.0f, 1.0f);
-    my_shader.setVec3("viewPos", camera.get_position());
+#ifndef __APPLE__
+    if (key_presses.cycle_shading_mode) {
+      mode = next_shading_mode(mode);
+      key_presses.cycle_shading_mode = false;
+    }
+    const lit_programs &programs = mode == shading_mode::deferred            ? deferred_programs
+                                   : mode == shading_mode::visibility_buffer ? visibility_programs
+                                                                             : forward_programs;
+#else
+    const lit_programs &programs = forward_programs;
+#endif
+    const bool use_deferred_shading = mode == shading_mode::deferred;
+    const bool use_visibility_buffer = mode == shading_mode::visibility_buffer;
+    lights.view_position = camera.get_position();
+    lights.point_light_position = light_pos;
+#ifndef __APPLE__
+    lights.viewport = glm::vec2(static_cast<float>(scr_width), static_cast<float>(scr_height));
+#endif
 
     glm::mat4 view = camera.get_view_matrix();
-    my_shader.setMat4("projection", projection);
-    my_shader.setMat4("view", view);
+
+#ifndef __APPLE__
+    if (key_presses.cycle_point_lights) {
+      point_light_count = (point_light_count + 1) % std::size(point_light_counts);
+      std::cout << point_light_counts[point_light_count] << " point lights" << std::endl;
+      key_presses.cycle_point_lights = false;
+    }
+    town_lights.resize(point_light_counts[point_light_count]);
+    for (size_t i = 0; i < town_lights.size(); ++i) {
+      town_lights[i] = street_lights[i];
+      town_lights[i].position.y += 0.5f * static_cast<float>(sin(current_frame + static_cast<double>(i)));
+    }
+    town_light_grid.set_projection(glm::radians(camera.get_fov()), ratio, camera.get_z_near(), camera.get_z_far());
+    town_light_grid.assign(town_lights, view, workers);
+    cluster_lights.upload(town_lights, town_light_grid);
+#endif
+    const glm::vec3 cube_position(0.0f, 0.5f, 0.0f);
     glm::mat4 model = glm::mat4(1.0f);
-    model = glm::translate(model, glm::vec3(0.0f, 0.5f, 0.0f));
-    my_shader.setMat4("model", model);
+    model = glm::translate(model, cube_position);
+
+    // Virtual texture feedback: which pages the visible surfaces would sample this frame.
+    if (virtual_textures.is_ready(virtual_diffuse)) {
+      virtual_textures.begin_feedback(scr_width, scr_height);
+      feedback_shader.use();
+      feedback_shader.setMat4("projection", projection);
+      feedback_shader.setMat4("view", view);
+      feedback_shader.setMat4("model", model);
+      virtual_textures.bind_feedback(feedback_shader, virtual_diffuse);
+      glBindVertexArray(cube_vao);
+      glDrawArrays(GL_TRIANGLES, 0, 36);
+      virtual_textures.end_feedback();
+    }
+
+#ifndef __APPLE__
+    if (key_presses.toggle_shadow_caching) {
+      sun_shadows.set_caching(!sun_shadows.caching());
+      std::cout << "shadow cascade caching " << (sun_shadows.caching() ? "on" : "off") << std::endl;
+      key_presses.toggle_shadow_caching = false;
+    }
+    // Nothing in the scene moves, so every caster is static; one that did would be passed to
+    // add_dynamic_caster() here.
+    sun_shadows.update(view, glm::radians(camera.get_fov()), ratio, camera.get_z_near(), lights.sun_direction);
+    frame_timers.begin(sun_shadows.renders_cached() ? shadow_pass : near_shadow_pass);
+    shadow_caster_shader.use();
+    if (sun_shadows.begin(shadow_caster_shader)) {
+      town_renderer.draw_casters(shadow_caster_shader, sun_shadows);
+      glBindVertexArray(cube_vao);
+      const auto draw_cube_caster = [&](const glm::mat4 &cube_model, const glm::vec3 &centre, const float extent) {
+        const uint32_t cascades = sun_shadows.cull_caster(centre - extent, centre + extent);
+        if (cascades == 0) return;
+        shadow_caster_shader.setMat4("model", cube_model);
+        shadow_caster_shader.setInt("cascadeMask", static_cast<int32_t>(cascades));
+        glDrawArraysInstanced(GL_TRIANGLES, 0, 36, static_cast<GLsizei>(std::bitset<32>(cascades).count()));
+      };
+      draw_cube_caster(model, cube_position, 0.5f);
+      for (const glm::mat4 &crate : crates) draw_cube_caster(crate, glm::vec3(crate[3]), 0.87f);
+      sun_shadows.end();
+    }
+    frame_timers.end();
+    scene_target.bind();
+
+    if (use_deferred_shading) deferred.begin(scene_target);
+#endif
+    frame_timers.begin(use_deferred_shading ? gbuffer_pass : forward_lit_pass);
+
+    const shader &cube_shader = *programs.cube;
+    cube_shader.use();
+    cube_shader.setMat4("projection", projection);
+    cube_shader.setMat4("view", view);
+    cube_shader.setMat4("model", model);
+    cube_shader.setFloat("material.shininess", 32.0f);
+    lights.set_point_light(cube_shader);
+    lights.bind(cube_shader);
+
+    // The cube's UVs span one unit per face; measure from its bounding sphere's near side.
+    const float cube_distance =
+        glm::max(glm::length(camera.get_position() - cube_position) - 0.87f, camera.get_z_near());
+    streamer.note_usage(diffuse_map, cube_distance, 1.0f);
+    streamer.note_usage(specular_map, cube_distance, 1.0f);
 
     // bind textures on corresponding texture units
     glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, diffuse_map);
+    glBindTexture(GL_TEXTURE_2D, streamer.texture(diffuse_map));
     glActiveTexture(GL_TEXTURE1);
-    glBindTexture(GL_TEXTURE_2D, specular_map);
+    glBindTexture(GL_TEXTURE_2D, streamer.texture(specular_map));
+    virtual_textures.bind(cube_shader, virtual_diffuse, "virtualDiffuse", "useVirtualDiffuse", 2, 3);
 
     glBindVertexArray(cube_vao);
     glDrawArrays(GL_TRIANGLES, 0, 36);
 
+    if (materials.is_ready()) {
+      const shader &crate_shader = *programs.crates;
+      crate_shader.use();
+      crate_shader.setMat4("projection", projection);
+      crate_shader.setMat4("view", view);
+      lights.set_point_light(crate_shader);
+      lights.bind(crate_shader);
+
+      cull_spheres(extract_frustum(projection * view), crate_bounds, visible_crates);
+      for (const uint32_t i : visible_crates) {
+        batcher.add(cube_mesh, crates[i], crate_materials[i % std::size(crate_materials)]);
+      }
+      batcher.flush(materials, crate_shader);
+    }
+
+    town_renderer.update();
+    if (key_presses.toggle_hlod) {
+      town_renderer.set_use_proxies(!town_renderer.use_proxies());
+      std::cout << "town proxies " << (town_renderer.use_proxies() ? "on" : "off") << "; gpu time with them "
+                << frame_timers.milliseconds(town_proxies_pass) << " ms, without "
+                << frame_timers.milliseconds(town_full_pass) << " ms" << std::endl;
+      key_presses.toggle_hlod = false;
+    }
+    // The town gets a pass of its own, one per mode, so both averages survive toggling; the visibility
+    // buffer times it below.
+    if (!use_visibility_buffer) {
+      frame_timers.end();
+      frame_timers.begin(town_renderer.use_proxies() ? town_proxies_pass : town_full_pass);
+    }
+    const shader &town_shader = *programs.town;
+    town_shader.use();
+    town_shader.setMat4("projection", projection);
+    town_shader.setMat4("view", view);
+    lights.bind(town_shader);
+    if (key_presses.toggle_occlusion_culling) {
+      use_occlusion_culling = !use_occlusion_culling;
+      key_presses.toggle_occlusion_culling = false;
+    }
+#ifndef __APPLE__
+    if (key_presses.toggle_gpu_culling) {
+      use_gpu_culling = !use_gpu_culling;
+      key_presses.toggle_gpu_culling = false;
+    }
+#endif
+    // The visibility buffer's ids name the culler's draws.
+    const bool cull_town_on_gpu = use_gpu_culling || use_visibility_buffer;
+    if (cull_town_on_gpu) {
+#ifndef __APPLE__
+      if (use_visibility_buffer) {
+        frame_timers.end();
+        frame_timers.begin(visibility_pass);
+        town_visibility.begin(scene_target);
+      }
+      const shader &town_indirect_shader = *programs.town_indirect;
+      town_indirect_shader.use();
+      town_indirect_shader.setMat4("projection", projection);
+      town_indirect_shader.setMat4("view", view);
+      lights.bind(town_indirect_shader);
+      draw_town_culled_on_gpu(town_renderer, town_culler, scene_depth, scene_target, town_indirect_shader,
+                              gpu_cull_shader, hiz_reduce_shader, projection * view);
+#endif
+    } else {
+      if (town_pvs_bake.valid() &&
+          town_pvs_bake.wait_for(std::chrono::seconds(0)) == std::future_status::ready) {
+        town_pvs = town_pvs_bake.get();
+      }
+      if (key_presses.toggle_pvs) {
+        use_pvs = !use_pvs;
+        key_presses.toggle_pvs = false;
+      }
+      // The set only changes when the camera crosses into another cell.
+      const uint32_t cell = town_pvs.find_cell(camera.get_position());
+      if (cell != town_pvs_cell && cell != potentially_visible_set::no_cell) town_pvs.decode(cell, town_visible);
+      town_pvs_cell = cell;
+
+      if (key_presses.cycle_occlusion_queries) {
+        if (!use_occlusion_queries) {
+          use_occlusion_queries = true;
+          town_queries.set_mode(occlusion_query_mode::conditional);
+        } else if (town_queries.mode() == occlusion_query_mode::conditional) {
+          town_queries.set_mode(occlusion_query_mode::previous_frame);
+        } else {
+          use_occlusion_queries = false;
+        }
+        key_presses.cycle_occlusion_queries = false;
+      }
+
+      const std::vector<uint64_t> *town_potentially_visible =
+          use_pvs && cell != potentially_visible_set::no_cell ? &town_visible : nullptr;
+      if (use_occlusion_queries) {
+        town_renderer.draw_queried(town_shader, box_query_shader, town_queries, camera.get_position(), projection,
+                                   view, static_cast<float>(scr_height), town_potentially_visible);
+      } else {
+        if (use_occlusion_culling) {
+          occlusion.begin_frame(projection * view);
+          town_renderer.add_occluders(occlusion, 4.0f);
+          occlusion.rasterize(workers);
+        }
+        town_renderer.draw(town_shader, camera.get_position(), projection, view, static_cast<float>(scr_height),
+                           use_occlusion_culling ? &occlusion : nullptr, town_potentially_visible);
+      }
+    }
+
+#ifndef __APPLE__
+    if (use_deferred_shading) {
+      frame_timers.end();
+      frame_timers.begin(deferred_lighting_pass);
+      light_deferred(deferred, deferred_lighting_shader, scene_target, lights, projection * view);
+    }
+    if (use_visibility_buffer) {
+      frame_timers.end();
+      frame_timers.begin(visibility_resolve_pass);
+      resolve_visibility(town_visibility, visibility_resolve_shader, scene_target, lights, projection * view,
+                         town_culler, town_renderer);
+    }
+#endif
+    frame_timers.end();
+    frame_timers.begin(rest_pass);
+
     light_shader.use();
     light_shader.setMat4("projection", projection);
     light_shader.setMat4("view", view);
@@ -264,15 +887,166 @@ int main(int, char **argv) {
     glBindVertexArray(light_cube_vao);
     glDrawArrays(GL_TRIANGLES, 0, 36);
 
+    ground.update(camera.get_position(), projection * view);
+    if (ground.is_ready()) {
+      terrain_shader.use();
+      terrain_shader.setMat4("projection", projection);
+      terrain_shader.setMat4("view", view);
+      terrain_shader.setVec3("viewPos", camera.get_position());
+      lights.set_sun_and_fog(terrain_shader);
+#ifndef __APPLE__
+      sun_shadows.bind(terrain_shader);
+#endif
+      ground.draw(terrain_shader, 0);
+    }
+
+    // Through the cursor: unproject it onto the near and far planes.
+    const glm::vec2 cursor_ndc(mouse_state.pos.x * 2.0f - 1.0f, 1.0f - mouse_state.pos.y * 2.0f);
+    const glm::mat4 unproject = glm::inverse(projection * view);
+    const glm::vec4 cursor_near = unproject * glm::vec4(cursor_ndc, -1.0f, 1.0f);
+    const glm::vec4 cursor_far = unproject * glm::vec4(cursor_ndc, 1.0f, 1.0f);
+    const glm::vec3 direction =
+        glm::normalize(glm::vec3(cursor_far) / cursor_far.w - glm::vec3(cursor_near) / cursor_near.w);
+
+    // A left click picks the nearest town object or crate, and digs the voxel hill only where the
+    // hill is in front of it.
+    const bool edit_voxels =
+        (mouse_state.pressed_left || mouse_state.pressed_middle) && current_frame - last_voxel_edit > 0.05;
+    bvh_hit picked;
+    const bool picked_object = (mouse_state.clicked_left || edit_voxels) &&
+                               scene_index.raycast(camera.get_position(), direction, 1000.0f, picked);
+
+    if (mouse_state.clicked_left) {
+      if (picked_object) {
+        if (picked.object < first_crate) {
+          std::cout << "Picked town object " << picked.object << " at " << picked.distance << " m" << std::endl;
+        } else {
+          std::cout << "Picked crate " << picked.object - first_crate << " at " << picked.distance << " m" << std::endl;
+        }
+      }
+      mouse_state.clicked_left = false;
+    }
+
+    if (edit_voxels) {
+      voxel_hit hit;
+      if (voxels.raycast(voxel_meshes.to_volume(camera.get_position()), direction, 400.0f, hit) &&
+          (!picked_object || hit.distance * voxel_settings.voxel_size < picked.distance)) {
+        if (mouse_state.pressed_left) {
+          voxels.fill_sphere(glm::vec3(hit.position) + 0.5f, 3.0f, empty_voxel);
+        } else {
+          voxels.fill_sphere(glm::vec3(hit.position + hit.normal) + 0.5f, 2.0f, voxel_brick);
+        }
+      }
+      last_voxel_edit = current_frame;
+    }
+
+    voxel_meshes.update(voxels);
+    voxel_shader.use();
+    voxel_shader.setMat4("projection", projection);
+    voxel_shader.setMat4("view", view);
+    voxel_shader.setVec3("viewPos", camera.get_position());
+    lights.set_sun_and_fog(voxel_shader);
+    voxel_meshes.draw(voxel_shader, projection * view);
+
+    scan.update(camera.get_position(), projection, view, static_cast<float>(scr_height));
+    if (scan.is_ready()) {
+      point_cloud_shader.use();
+      point_cloud_shader.setMat4("projection", projection);
+      point_cloud_shader.setMat4("view", view);
+      point_cloud_shader.setVec3("viewPos", camera.get_position());
+      lights.set_sun_and_fog(point_cloud_shader);  // only fogged; GL ignores the light uniforms it lacks
+      scan.draw(point_cloud_shader);
+    }
+
+    boulder.update(camera.get_position(), projection, view, static_cast<float>(scr_height));
+    if (boulder.is_ready()) {
+      cluster_lod_shader.use();
+      cluster_lod_shader.setMat4("projection", projection);
+      cluster_lod_shader.setMat4("view", view);
+      cluster_lod_shader.setVec3("viewPos", camera.get_position());
+      lights.set_sun_and_fog(cluster_lod_shader);
+      boulder.draw(cluster_lod_shader);
+    }
+
     // Drawing grid
     grid_shader.use();
     grid_shader.setMat4("proj", projection);
     grid_shader.setMat4("view", view);
     grid_shader.setVec3("cameraPos", camera.get_position());
-    grid_shader.setFloat("gridSize", camera.get_z_far());
+    grid_shader.setFloat("gridSize", 100.0f);  // around the camera only, not out to the far plane
     grid_shader.setFloat("gridCellSize", 1 / 2.0f);
     glDrawArrays(GL_TRIANGLES, 0, 6);
 
+    streamer.update();
+    uploader.update();
+    if (key_presses.print_texture_residency) {
+      streamer.print_residency(std::cout);
+      key_presses.print_texture_residency = false;
+    }
+
+    materials.update();
+    if (key_presses.print_material_batches) {
+      materials.print_layout(std::cout);
+      const draw_batch_stats &batches = batcher.stats();
+      std::cout << "batched " << batches.instances << " draws into " << batches.draw_calls << " draw calls over "
+                << batches.bind_sets << " bind sets" << std::endl;
+      key_presses.print_material_batches = false;
+    }
+
+    if (key_presses.print_terrain_stats) {
+      ground.print_stats(std::cout);
+      key_presses.print_terrain_stats = false;
+    }
+
+    if (key_presses.print_voxel_stats) {
+      voxel_meshes.print_stats(std::cout);
+      std::cout << "voxel volume: " << voxels.chunk_count() << " chunks, "
+                << static_cast<double>(voxels.size_in_bytes()) / (1024.0 * 1024.0) << " MiB" << std::endl;
+      key_presses.print_voxel_stats = false;
+    }
+
+    if (key_presses.print_point_cloud_stats) {
+      scan.print_stats(std::cout);
+      key_presses.print_point_cloud_stats = false;
+    }
+
+    if (key_presses.print_hlod_stats) {
+#ifndef __APPLE__
+      if (cull_town_on_gpu) town_culler.print_stats(std::cout);
+#endif
+      if (!cull_town_on_gpu) town_renderer.print_stats(std::cout);
+      if (!cull_town_on_gpu && use_occlusion_queries) town_queries.print_stats(std::cout);
+      if (!cull_town_on_gpu && !use_occlusion_queries && use_occlusion_culling) occlusion.print_stats(std::cout);
+      if (!cull_town_on_gpu && !town_pvs.empty()) town_pvs.print_stats(std::cout);
+      key_presses.print_hlod_stats = false;
+    }
+
+#ifndef __APPLE__
+    if (key_presses.print_light_stats) {
+      town_light_grid.print_stats(std::cout);
+      frame_timers.print_stats(std::cout);
+      sun_shadows.print_stats(std::cout, frame_timers.milliseconds(shadow_pass),
+                              frame_timers.milliseconds(near_shadow_pass));
+      std::cout << "frame time " << (fps_counter.get_fps() > 0.0 ? 1000.0 / fps_counter.get_fps() : 0.0) << " ms"
+                << std::endl;
+      key_presses.print_light_stats = false;
+    }
+#endif
+
+    if (key_presses.print_cluster_lod_stats) {
+      boulder.print_stats(std::cout);
+      key_presses.print_cluster_lod_stats = false;
+    }
+
+    virtual_textures.update();
+    if (key_presses.print_virtual_texture_stats) {
+      virtual_textures.print_stats(std::cout);
+      key_presses.print_virtual_texture_stats = false;
+    }
+
+    frame_timers.end();
+    frame_timers.end_frame();
+    scene_target.present();
     glfwSwapBuffers(window);
     glfwPollEvents();
   }
@@ -0,0 +1,157 @@
+#include "material_library.h"
+
+#include <glad/glad.h>
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+
+#include "../shader/shader.h"
+#include "../texture/texture_uploader.h"
+#include "../utility/thread_pool.h"
+
+namespace {
+
+constexpr uint32_t material_binding = 0;
+
+}  // namespace
+
+material_library::material_library(thread_pool &pool, texture_uploader &uploader, const texture_compression &colour,
+                                   const texture_compression &data)
+    : pool_(pool), uploader_(uploader), colour_(colour), data_(data) {}
+
+material_library::~material_library() {
+  if (pending_.valid()) pending_.wait();
+  if (buffer_ != 0) glDeleteBuffers(1, &buffer_);
+}
+
+uint32_t material_library::texture_index(const std::string &path, const bool colour) {
+  for (size_t i = 0; i < textures_.size(); ++i) {
+    if (textures_[i].path == path && textures_[i].colour == colour) return static_cast<uint32_t>(i);
+  }
+  textures_.push_back({path, colour});
+  return static_cast<uint32_t>(textures_.size() - 1);
+}
+
+uint32_t material_library::add(const material_desc &desc) {
+  descs_.push_back(desc);
+  diffuse_textures_.push_back(texture_index(desc.diffuse, true));
+  specular_textures_.push_back(texture_index(desc.specular, false));
+  return static_cast<uint32_t>(descs_.size() - 1);
+}
+
+void material_library::load() {
+  pending_ = pool_.submit([textures = textures_, colour = colour_, data = data_, &pool = pool_]() {
+    std::vector<cooked_texture> cooked(textures.size());
+    pool.parallel_for(0, textures.size(), [&](const size_t i) {
+      const std::filesystem::path path =
+          cook_compressed_texture(textures[i].path, textures[i].colour ? colour : data, pool);
+      if (path.empty()) return;
+
+      cooked[i].file = std::make_shared<mfsys::mapped_file>(path);
+      if (!parse_ktx2(cooked[i].file->data(), cooked[i].file->size(), cooked[i].container)) {
+        cooked[i].container = {};
+      }
+    });
+    return cooked;
+  });
+}
+
+void material_library::update() {
+  if (!uploads_.empty()) {
+    const bool done = std::all_of(uploads_.begin(), uploads_.end(), [this](const uint32_t upload) {
+      return uploader_.is_ready(upload) || uploader_.has_failed(upload);
+    });
+    if (!done) return;
+    for (const uint32_t upload : uploads_) uploader_.release(upload);
+    uploads_.clear();
+  }
+
+  if (!pending_.valid() || pending_.wait_for(std::chrono::seconds(0)) != std::future_status::ready) return;
+
+  const std::vector<cooked_texture> cooked = pending_.get();
+  std::vector<const ktx2_texture *> sources;
+  for (size_t i = 0; i < cooked.size(); ++i) {
+    if (cooked[i].container.empty()) std::cout << "Texture failed to load at path: " << textures_[i].path << std::endl;
+    sources.push_back(&cooked[i].container);
+  }
+  const std::vector<texture_array_slot> slots = arrays_.allocate(sources);
+  for (size_t i = 0; i < cooked.size(); ++i) {
+    if (!slots[i].valid()) continue;
+    uploads_.push_back(uploader_.request_levels(textures_[i].path, cooked[i].file, cooked[i].container,
+                                                arrays_.texture(slots[i].array), 0,
+                                                static_cast<int32_t>(cooked[i].container.levels.size()),
+                                                slots[i].layer));
+  }
+
+  storage_buffer_ = GLAD_GL_VERSION_4_3 != 0;
+  const size_t material_count = storage_buffer_ ? descs_.size() : max_uniform_materials;
+  if (!storage_buffer_ && descs_.size() > max_uniform_materials) {
+    std::cout << "Too many materials for a uniform block, dropping " << descs_.size() - max_uniform_materials
+              << std::endl;
+  }
+
+  std::vector<gpu_material> materials(material_count);
+  material_bind_sets_.assign(descs_.size(), no_bind_set);
+  for (size_t i = 0; i < std::min(descs_.size(), material_count); ++i) {
+    const texture_array_slot diffuse = slots[diffuse_textures_[i]];
+    const texture_array_slot specular = slots[specular_textures_[i]];
+    if (!diffuse.valid() || !specular.valid()) continue;
+
+    materials[i].diffuse_layer = static_cast<uint32_t>(diffuse.layer);
+    materials[i].specular_layer = static_cast<uint32_t>(specular.layer);
+    materials[i].shininess = descs_[i].shininess;
+
+    uint32_t set = 0;
+    while (set < bind_sets_.size() &&
+           (bind_sets_[set].diffuse_array != diffuse.array || bind_sets_[set].specular_array != specular.array)) {
+      ++set;
+    }
+    if (set == bind_sets_.size()) bind_sets_.push_back({diffuse.array, specular.array});
+    material_bind_sets_[i] = set;
+  }
+
+  // The uploader holds on to the mapped files until their layers are in.
+  const GLenum target = storage_buffer_ ? GL_SHADER_STORAGE_BUFFER : GL_UNIFORM_BUFFER;
+  glGenBuffers(1, &buffer_);
+  glBindBuffer(target, buffer_);
+  glBufferData(target, static_cast<GLsizeiptr>(materials.size() * sizeof(gpu_material)), materials.data(),
+               GL_STATIC_DRAW);
+  glBindBuffer(target, 0);
+}
+
+uint32_t material_library::bind_set(const uint32_t material) const {
+  return material < material_bind_sets_.size() ? material_bind_sets_[material] : no_bind_set;
+}
+
+void material_library::bind(const shader &program, const uint32_t bind_set, const int32_t diffuse_unit,
+                            const int32_t specular_unit) const {
+  const bind_set_arrays &arrays = bind_sets_[bind_set];
+  glActiveTexture(GL_TEXTURE0 + diffuse_unit);
+  glBindTexture(GL_TEXTURE_2D_ARRAY, arrays_.texture(arrays.diffuse_array));
+  glActiveTexture(GL_TEXTURE0 + specular_unit);
+  glBindTexture(GL_TEXTURE_2D_ARRAY, arrays_.texture(arrays.specular_array));
+  program.setInt("diffuseMaps", diffuse_unit);
+  program.setInt("specularMaps", specular_unit);
+
+  if (storage_buffer_) {
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, material_binding, buffer_);
+  } else {
+    const GLuint block = glGetUniformBlockIndex(program.getID(), "Materials");
+    if (block != GL_INVALID_INDEX) glUniformBlockBinding(program.getID(), block, material_binding);
+    glBindBufferBase(GL_UNIFORM_BUFFER, material_binding, buffer_);
+  }
+}
+
+void material_library::print_layout(std::ostream &out) const {
+  arrays_.print_layout(out);
+  for (size_t i = 0; i < descs_.size(); ++i) {
+    out << "material " << i << " (" << descs_[i].name << "): bind set ";
+    if (material_bind_sets_.size() > i && material_bind_sets_[i] != no_bind_set) {
+      out << material_bind_sets_[i];
+    } else {
+      out << "none";
+    }
+    out << std::endl;
+  }
+}
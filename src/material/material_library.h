@@ -0,0 +1,109 @@
+#ifndef MATERIAL_LIBRARY_H
+#define MATERIAL_LIBRARY_H
+
+#include <cstdint>
+#include <future>
+#include <iosfwd>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "../filesystem/mapped_file.h"
+#include "../texture/ktx2.h"
+#include "../texture/texture_array.h"
+#include "../texture/texture_cache.h"
+
+class shader;
+class texture_uploader;
+class thread_pool;
+
+struct material_desc {
+  std::string name;
+  std::string diffuse;   // colour map, mipped in linear light
+  std::string specular;  // data map
+  float shininess = 32.0f;
+};
+
+// One entry of the material buffer; std140 and std430 lay it out identically.
+struct gpu_material {
+  uint32_t diffuse_layer = 0;
+  uint32_t specular_layer = 0;
+  float shininess = 32.0f;
+  float padding = 0.0f;
+};
+
+// Materials whose maps live in texture arrays and whose parameters live in one buffer indexed by
+// material, so draws with different materials only need to switch bindings when their maps sit in
+// different arrays. Materials sharing a (diffuse array, specular array) pair form one bind set.
+//
+// The buffer is a shader storage buffer at binding 0 with GL 4.3, and a uniform block named
+// "Materials" of max_uniform_materials entries otherwise (the 4.1 core profile on macOS).
+class material_library {
+ public:
+  static constexpr uint32_t no_bind_set = 0xFFFFFFFFu;
+  static constexpr uint32_t max_uniform_materials = 256;
+
+  material_library(thread_pool &pool, texture_uploader &uploader, const texture_compression &colour,
+                   const texture_compression &data);
+  material_library(const material_library &) = delete;
+  material_library &operator=(const material_library &) = delete;
+
+  ~material_library();
+
+  // Materials must be added before load().
+  [[nodiscard]] uint32_t add(const material_desc &desc);
+
+  // Cooks and maps every referenced texture on the pool; update() lays out the arrays and streams
+  // the layers in through the uploader.
+  void load();
+  void update();
+  [[nodiscard]] bool is_ready() const { return buffer_ != 0 && uploads_.empty(); }
+
+  // no_bind_set when one of the material's maps failed to load.
+  [[nodiscard]] uint32_t bind_set(uint32_t material) const;
+  [[nodiscard]] size_t bind_set_count() const { return bind_sets_.size(); }
+
+  // Binds the arrays of `bind_set` to the given units, sets the "diffuseMaps" and "specularMaps"
+  // samplers of `program` and binds the material buffer.
+  void bind(const shader &program, uint32_t bind_set, int32_t diffuse_unit, int32_t specular_unit) const;
+
+  void print_layout(std::ostream &out) const;
+
+ private:
+  struct texture_source {
+    std::string path;
+    bool colour = false;
+  };
+
+  struct cooked_texture {
+    std::shared_ptr<mfsys::mapped_file> file;
+    ktx2_texture container;
+  };
+
+  struct bind_set_arrays {
+    int32_t diffuse_array = -1;
+    int32_t specular_array = -1;
+  };
+
+  [[nodiscard]] uint32_t texture_index(const std::string &path, bool colour);
+
+  thread_pool &pool_;
+  texture_uploader &uploader_;
+  texture_compression colour_;
+  texture_compression data_;
+
+  std::vector<material_desc> descs_;
+  std::vector<uint32_t> diffuse_textures_;
+  std::vector<uint32_t> specular_textures_;
+  std::vector<texture_source> textures_;
+  std::future<std::vector<cooked_texture>> pending_;
+  std::vector<uint32_t> uploads_;  // one per layer still streaming in
+
+  texture_array_set arrays_;
+  std::vector<bind_set_arrays> bind_sets_;
+  std::vector<uint32_t> material_bind_sets_;
+  uint32_t buffer_ = 0;
+  bool storage_buffer_ = false;
+};
+
+#endif  // MATERIAL_LIBRARY_H
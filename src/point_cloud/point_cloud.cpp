@@ -0,0 +1,296 @@
+#include "point_cloud.h"
+
+#include <glad/glad.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <queue>
+
+#include "../shader/shader.h"
+#include "../utility/thread_pool.h"
+
+namespace {
+
+constexpr GLuint position_location = 0;
+constexpr GLuint intensity_location = 1;
+constexpr GLuint color_location = 2;
+
+template <typename T>
+bool is_finished(const std::future<T> &future) {
+  return future.valid() && future.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+}
+
+double to_mib(const size_t bytes) { return static_cast<double>(bytes) / (1024.0 * 1024.0); }
+
+uint32_t child_index(const point_cloud_node &node, const int32_t octant) {
+  const uint32_t before = node.child_mask & ((1u << octant) - 1u);
+  uint32_t rank = 0;
+  for (uint32_t bits = before; bits != 0; bits &= bits - 1) ++rank;
+  return node.first_child + rank;
+}
+
+}  // namespace
+
+point_cloud::point_cloud(thread_pool &pool, const point_cloud_settings &config)
+    : pool_(pool), config_(config), points_(config.resident_points), staging_(config.staging_bytes) {
+  glGenVertexArrays(1, &vao_);
+  glGenBuffers(1, &point_buffer_);
+
+  glBindVertexArray(vao_);
+  glBindBuffer(GL_ARRAY_BUFFER, point_buffer_);
+  glBufferData(GL_ARRAY_BUFFER, static_cast<GLsizeiptr>(config_.resident_points * sizeof(point_cloud_point)), nullptr,
+               GL_DYNAMIC_DRAW);
+  glVertexAttribPointer(position_location, 3, GL_UNSIGNED_SHORT, GL_TRUE, sizeof(point_cloud_point),
+                        reinterpret_cast<void *>(offsetof(point_cloud_point, position)));
+  glEnableVertexAttribArray(position_location);
+  glVertexAttribPointer(intensity_location, 1, GL_UNSIGNED_SHORT, GL_TRUE, sizeof(point_cloud_point),
+                        reinterpret_cast<void *>(offsetof(point_cloud_point, intensity)));
+  glEnableVertexAttribArray(intensity_location);
+  glVertexAttribPointer(color_location, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(point_cloud_point),
+                        reinterpret_cast<void *>(offsetof(point_cloud_point, color)));
+  glEnableVertexAttribArray(color_location);
+  glBindVertexArray(0);
+}
+
+point_cloud::~point_cloud() {
+  // Workers may still be reading the mapping.
+  if (pending_.valid()) pending_.wait();
+  if (loads_.valid()) loads_.wait();
+
+  glDeleteVertexArrays(1, &vao_);
+  glDeleteBuffers(1, &point_buffer_);
+}
+
+void point_cloud::load(const std::string &path, const std::filesystem::path &cache_directory) {
+  name_ = std::filesystem::path(path).filename().string();
+  pending_ = pool_.submit([path, cache_directory, &pool = pool_]() {
+    return open_point_cloud_octree(cook_point_cloud(path, cache_directory, {}, pool));
+  });
+}
+
+void point_cloud::generate(const point_cloud_generator_settings &settings,
+                           const std::filesystem::path &cache_directory) {
+  name_ = "generated point cloud";
+  pending_ = pool_.submit([settings, cache_directory, &pool = pool_]() {
+    return open_point_cloud_octree(cook_generated_point_cloud(settings, cache_directory, {}, pool));
+  });
+}
+
+void point_cloud::open(point_cloud_file file) {
+  if (file.empty()) {
+    std::cout << "Point cloud failed to load: " << name_ << std::endl;
+    return;
+  }
+  file_ = std::move(file);
+  nodes_.assign(file_.node_count, {});
+}
+
+float point_cloud::projected_pixels(const point_cloud_node &node) const {
+  const float radius = node.size * 0.866f;
+  const glm::vec3 centre = config_.origin + glm::vec3(node.min[0], node.min[1], node.min[2]) + node.size * 0.5f;
+  const float distance = glm::length(centre - camera_position_);
+  // Inside the bounding sphere the node covers the screen.
+  if (distance <= radius) return std::numeric_limits<float>::max();
+  return 2.0f * radius / distance * projection_scale_;
+}
+
+void point_cloud::select() {
+  selection_.clear();
+  missing_.clear();
+  stats_.points = 0;
+
+  std::priority_queue<ranked_node> queue;
+  const auto consider = [&](const uint32_t index) {
+    const point_cloud_node &node = file_.nodes[index];
+    const glm::vec3 min = config_.origin + glm::vec3(node.min[0], node.min[1], node.min[2]);
+    if (test_aabb(frustum_, min, min + node.size) == frustum_test::outside) return;
+    const float pixels = projected_pixels(node);
+    if (pixels >= config_.min_node_pixels) queue.push({pixels, index});
+  };
+  consider(0);
+
+  // Largest first, so when the budget runs out it is the finest detail that is left out.
+  while (!queue.empty()) {
+    const ranked_node ranked = queue.top();
+    queue.pop();
+
+    node_state &state = nodes_[ranked.index];
+    if (state.state != residency::resident) {
+      if (state.state == residency::absent) missing_.push_back(ranked);
+      continue;
+    }
+
+    const point_cloud_node &node = file_.nodes[ranked.index];
+    if (stats_.points + node.point_count > config_.point_budget) break;
+    stats_.points += node.point_count;
+    selection_.push_back(ranked.index);
+    state.last_used = frame_;
+
+    for (int32_t octant = 0; octant < 8; ++octant) {
+      if ((node.child_mask & (1u << octant)) != 0) consider(child_index(node, octant));
+    }
+  }
+}
+
+size_t point_cloud::allocate_points(const size_t count) {
+  size_t first = points_.allocate(count);
+  if (first != range_allocator::no_range) return first;
+
+  // Evict the least recently selected nodes until the range fits; the current selection stays.
+  std::vector<uint32_t> candidates;
+  for (uint32_t i = 0; i < nodes_.size(); ++i) {
+    if (nodes_[i].state == residency::resident && nodes_[i].last_used < frame_) candidates.push_back(i);
+  }
+  std::sort(candidates.begin(), candidates.end(),
+            [&](const uint32_t a, const uint32_t b) { return nodes_[a].last_used < nodes_[b].last_used; });
+
+  for (const uint32_t index : candidates) {
+    node_state &state = nodes_[index];
+    points_.free(state.first_point, file_.nodes[index].point_count);
+    state = {};
+    first = points_.allocate(count);
+    if (first != range_allocator::no_range) return first;
+  }
+  return range_allocator::no_range;
+}
+
+bool point_cloud::upload(const loaded_node &node) {
+  const size_t bytes = node.points.size() * sizeof(point_cloud_point);
+  node_state &state = nodes_[node.index];
+
+  // Nodes larger than the staging ring go straight to the buffer.
+  const bool direct = bytes > staging_.capacity();
+  streaming_allocation staging;
+  if (!direct) {
+    staging = staging_.allocate(bytes);
+    if (staging.empty()) return false;
+  }
+
+  const size_t first = allocate_points(node.points.size());
+  if (first == range_allocator::no_range) {
+    // Everything resident is in use this frame; the node is asked for again when there is room.
+    state = {};
+    return true;
+  }
+
+  glBindBuffer(GL_COPY_WRITE_BUFFER, point_buffer_);
+  if (direct) {
+    glBufferSubData(GL_COPY_WRITE_BUFFER, static_cast<GLintptr>(first * sizeof(point_cloud_point)),
+                    static_cast<GLsizeiptr>(bytes), node.points.data());
+  } else {
+    std::memcpy(staging.data, node.points.data(), bytes);
+    staging_.commit(staging);
+    glBindBuffer(GL_COPY_READ_BUFFER, staging_.buffer());
+    glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, static_cast<GLintptr>(staging.offset),
+                        static_cast<GLintptr>(first * sizeof(point_cloud_point)), static_cast<GLsizeiptr>(bytes));
+    glBindBuffer(GL_COPY_READ_BUFFER, 0);
+  }
+  glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+  state.state = residency::resident;
+  state.first_point = first;
+  state.last_used = frame_;
+  ++stats_.nodes_uploaded;
+  return true;
+}
+
+void point_cloud::request_nodes() {
+  if (missing_.empty() || loads_.valid()) return;
+  // Do not read further ahead than the uploads can keep up with.
+  if (finished_.size() >= static_cast<size_t>(std::max(1, config_.loads_per_frame))) return;
+
+  missing_.resize(std::min(missing_.size(), static_cast<size_t>(std::max(1, config_.loads_per_frame))));
+  std::vector<uint32_t> indices;
+  for (const ranked_node &ranked : missing_) {
+    indices.push_back(ranked.index);
+    nodes_[ranked.index].state = residency::loading;
+  }
+
+  loads_ = pool_.submit([indices = std::move(indices), file = file_]() {
+    std::vector<loaded_node> loaded(indices.size());
+    for (size_t i = 0; i < indices.size(); ++i) {
+      const point_cloud_node &node = file.nodes[indices[i]];
+      const point_cloud_point *points = file.points + node.first_point;
+      loaded[i].index = indices[i];
+      loaded[i].points.assign(points, points + node.point_count);
+    }
+    return loaded;
+  });
+}
+
+void point_cloud::update(const glm::vec3 &camera_position, const glm::mat4 &projection, const glm::mat4 &view,
+                         const float viewport_height) {
+  ++frame_;
+  stats_.nodes_uploaded = 0;
+
+  if (is_finished(pending_)) open(pending_.get());
+  if (!is_ready()) return;
+
+  camera_position_ = camera_position;
+  projection_scale_ = projection[1][1] * viewport_height * 0.5f;
+  frustum_ = extract_frustum(projection * view);
+  select();
+
+  // After the selection, so the nodes it uses cannot be evicted by this frame's uploads.
+  if (is_finished(loads_)) {
+    for (loaded_node &node : loads_.get()) finished_.push_back(std::move(node));
+  }
+
+  // Always let one node through so a node larger than the budget still makes progress.
+  size_t budget = config_.upload_bytes_per_frame;
+  for (bool first = true; !finished_.empty(); first = false) {
+    const size_t bytes = finished_.front().points.size() * sizeof(point_cloud_point);
+    if (!first && bytes > budget) break;
+    if (!upload(finished_.front())) break;
+    finished_.pop_front();
+    budget = bytes > budget ? 0 : budget - bytes;
+  }
+  staging_.end_frame();
+  request_nodes();
+
+  stats_.nodes = selection_.size();
+  stats_.pending_nodes = 0;
+  stats_.resident_nodes = 0;
+  for (const node_state &state : nodes_) {
+    if (state.state == residency::loading) ++stats_.pending_nodes;
+    if (state.state == residency::resident) ++stats_.resident_nodes;
+  }
+  stats_.resident_bytes = points_.used() * sizeof(point_cloud_point);
+  stats_.file_bytes = file_.file->size();
+}
+
+void point_cloud::draw(const shader &program) {
+  stats_.draw_calls = 0;
+  if (!is_ready() || selection_.empty()) return;
+
+  program.setFloat("pointScale", projection_scale_);
+  program.setFloat("maxPointSize", config_.max_point_pixels);
+  program.setBool("useIntensity", !file_.has_color);
+
+  glEnable(GL_PROGRAM_POINT_SIZE);
+  glBindVertexArray(vao_);
+  for (const uint32_t index : selection_) {
+    const point_cloud_node &node = file_.nodes[index];
+    program.setVec3("nodeMin", config_.origin + glm::vec3(node.min[0], node.min[1], node.min[2]));
+    program.setFloat("nodeSize", node.size);
+    program.setFloat("nodeSpacing", file_.spacing(node));
+    glDrawArrays(GL_POINTS, static_cast<GLint>(nodes_[index].first_point), static_cast<GLsizei>(node.point_count));
+    ++stats_.draw_calls;
+  }
+  glBindVertexArray(0);
+  glDisable(GL_PROGRAM_POINT_SIZE);
+}
+
+void point_cloud::print_stats(std::ostream &out) const {
+  out << std::fixed << std::setprecision(1) << "point cloud: " << name_ << ", " << file_.point_count << " points in "
+      << file_.node_count << " nodes, " << stats_.nodes << " nodes selected with " << stats_.points << "/"
+      << config_.point_budget << " points in " << stats_.draw_calls << " draw calls, " << stats_.resident_nodes
+      << " nodes resident, " << stats_.nodes_uploaded << " uploaded this frame, " << stats_.pending_nodes
+      << " pending, " << to_mib(stats_.resident_bytes) << " MiB on the GPU vs " << to_mib(stats_.file_bytes)
+      << " MiB on disk" << std::endl;
+}
@@ -0,0 +1,139 @@
+#ifndef POINT_CLOUD_H
+#define POINT_CLOUD_H
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <deque>
+#include <filesystem>
+#include <future>
+#include <iosfwd>
+#include <string>
+#include <vector>
+
+#include "point_cloud_octree.h"
+#include "../render/frustum.h"
+#include "../render/streaming_buffer.h"
+#include "../utility/range_allocator.h"
+
+class shader;
+class thread_pool;
+
+struct point_cloud_settings {
+  glm::vec3 origin = glm::vec3(0.0f);  // world position of the octree's origin
+  size_t point_budget = 3'000'000;     // drawn per frame at most
+  size_t resident_points = 6'000'000;  // GPU memory for points, in points
+  // Nodes whose bounding sphere projects smaller than this many pixels across are not drawn.
+  float min_node_pixels = 80.0f;
+  int32_t loads_per_frame = 32;
+  size_t upload_bytes_per_frame = 8u << 20;
+  size_t staging_bytes = 16u << 20;
+  float max_point_pixels = 12.0f;
+};
+
+struct point_cloud_stats {
+  size_t nodes = 0;   // selected in the last update()
+  size_t points = 0;  // in the selected nodes
+  size_t draw_calls = 0;
+  size_t nodes_uploaded = 0;  // in the last update()
+  size_t pending_nodes = 0;   // being read or waiting for upload
+  size_t resident_nodes = 0;
+  size_t resident_bytes = 0;
+  size_t file_bytes = 0;
+};
+
+// Point clouds too large for memory, drawn from an octree file (see point_cloud_octree.h) with a
+// fixed point budget.
+//
+// Each frame update() walks the octree from the root in order of projected node size, largest
+// first, skipping nodes outside the frustum or smaller than min_node_pixels, and selects resident
+// nodes until the point budget is spent. A node's points are a subsample of its subtree, so the
+// selected nodes together always cover the visible cloud at a density that falls off with screen
+// size. Children are only considered under a resident parent; the largest missing nodes are read
+// from the mapped file on a worker and uploaded within a per-frame byte budget, replacing the
+// least recently selected nodes once the resident point pool is full. Work per frame is bounded
+// by the budgets, whatever the size of the file.
+//
+// All member functions must be called on the thread that owns the GL context.
+class point_cloud {
+ public:
+  explicit point_cloud(thread_pool &pool, const point_cloud_settings &config = {});
+  point_cloud(const point_cloud &) = delete;
+  point_cloud &operator=(const point_cloud &) = delete;
+
+  ~point_cloud();
+
+  // Builds the octree for the LAS file at `path` into `cache_directory` on a worker, see
+  // cook_point_cloud().
+  void load(const std::string &path, const std::filesystem::path &cache_directory);
+  // The same for a generated point cloud.
+  void generate(const point_cloud_generator_settings &settings, const std::filesystem::path &cache_directory);
+
+  [[nodiscard]] bool is_ready() const { return !file_.empty(); }
+
+  // Selects the nodes to draw for this camera, uploads finished nodes and starts new loads. Call once
+  // per frame before draw().
+  void update(const glm::vec3 &camera_position, const glm::mat4 &projection, const glm::mat4 &view,
+              float viewport_height);
+
+  // Draws the nodes selected by the last update() as points with `program`, which must be in use.
+  void draw(const shader &program);
+
+  [[nodiscard]] const point_cloud_stats &stats() const { return stats_; }
+  void print_stats(std::ostream &out) const;
+
+ private:
+  enum class residency : uint8_t { absent, loading, resident };
+
+  struct node_state {
+    residency state = residency::absent;
+    size_t first_point = range_allocator::no_range;  // in the point buffer
+    uint64_t last_used = 0;
+  };
+
+  struct loaded_node {
+    uint32_t index = 0;
+    std::vector<point_cloud_point> points;
+  };
+
+  struct ranked_node {
+    float pixels;
+    uint32_t index;
+
+    bool operator<(const ranked_node &other) const { return pixels < other.pixels; }
+  };
+
+  void open(point_cloud_file file);
+  [[nodiscard]] float projected_pixels(const point_cloud_node &node) const;
+  void select();
+  void request_nodes();
+  bool upload(const loaded_node &node);
+  [[nodiscard]] size_t allocate_points(size_t count);
+
+  thread_pool &pool_;
+  point_cloud_settings config_;
+  std::string name_;
+
+  std::future<point_cloud_file> pending_;
+  point_cloud_file file_;
+  std::vector<node_state> nodes_;
+
+  uint32_t vao_ = 0;
+  uint32_t point_buffer_ = 0;
+  range_allocator points_;
+  streaming_buffer staging_;
+
+  std::vector<ranked_node> missing_;  // largest first
+  std::future<std::vector<loaded_node>> loads_;
+  std::deque<loaded_node> finished_;
+
+  glm::vec3 camera_position_ = glm::vec3(0.0f);
+  float projection_scale_ = 1.0f;  // pixels across the screen per unit of size over distance
+  frustum frustum_{};
+  std::vector<uint32_t> selection_;
+
+  uint64_t frame_ = 0;
+  point_cloud_stats stats_;
+};
+
+#endif  // POINT_CLOUD_H
@@ -0,0 +1,340 @@
+#include "point_cloud_octree.h"
+
+#include <algorithm>
+#include <bitset>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <limits>
+#include <vector>
+
+#include "../filesystem/atomic_file.h"
+#include "../utility/hash.h"
+#include "../utility/thread_pool.h"
+
+namespace {
+
+constexpr char point_cloud_magic[8] = {'E', 'N', 'G', 'P', 'C', 'L', 'D', '\0'};
+constexpr uint32_t point_cloud_version = 1;
+constexpr uint32_t has_color_flag = 1;
+
+// Bump whenever the octree layout or subsampling changes so stale cache entries are rebuilt.
+constexpr uint32_t cache_version = 1;
+
+// Below this many points a node's children are built on the calling thread.
+constexpr size_t parallel_points = 1 << 16;
+
+struct point_cloud_header {
+  char magic[8];
+  uint32_t version;
+  uint32_t node_count;
+  uint64_t point_count;
+  double offset[3];
+  uint32_t grid_size;
+  uint32_t flags;
+};
+static_assert(sizeof(point_cloud_header) == 56, "point cloud header must be packed");
+
+struct build_node {
+  glm::vec3 min;
+  float size;
+  uint32_t level;
+  std::vector<uint32_t> points;  // indices into the point set, once subsampled
+  std::unique_ptr<build_node> children[8];
+};
+
+int32_t octant(const glm::vec3 &position, const glm::vec3 &centre) {
+  return (position.x >= centre.x ? 1 : 0) | (position.y >= centre.y ? 2 : 0) | (position.z >= centre.z ? 4 : 0);
+}
+
+class octree_builder {
+ public:
+  octree_builder(point_set &source, const point_cloud_build_settings &settings, thread_pool &pool)
+      : source_(source), settings_(settings), pool_(pool), scratch_(source.points.size()) {}
+
+  std::unique_ptr<build_node> build(const glm::vec3 &min, const float size) {
+    auto root = std::make_unique<build_node>();
+    root->min = min;
+    root->size = size;
+    root->level = 0;
+    build(*root, 0, source_.points.size());
+    return root;
+  }
+
+ private:
+  // Splits [begin, end) of the point set among the node's octants, recursing until nodes are small
+  // enough, then subsamples on the way back up.
+  void build(build_node &node, const size_t begin, const size_t end) {
+    const size_t count = end - begin;
+    if (count <= settings_.leaf_points || node.level >= settings_.max_depth) {
+      node.points.resize(count);
+      for (size_t i = 0; i < count; ++i) node.points[i] = static_cast<uint32_t>(begin + i);
+      return;
+    }
+
+    // Counting sort by octant through the scratch buffer; disjoint ranges never share scratch space.
+    const glm::vec3 centre = node.min + node.size * 0.5f;
+    size_t counts[8] = {};
+    std::vector<source_point> &points = source_.points;
+    for (size_t i = begin; i < end; ++i) ++counts[octant(points[i].position, centre)];
+
+    size_t starts[9] = {begin};
+    for (int32_t i = 0; i < 8; ++i) starts[i + 1] = starts[i] + counts[i];
+    size_t cursor[8];
+    std::copy(starts, starts + 8, cursor);
+    for (size_t i = begin; i < end; ++i) scratch_[cursor[octant(points[i].position, centre)]++] = points[i];
+    std::copy(scratch_.data() + begin, scratch_.data() + end, points.data() + begin);
+
+    for (int32_t i = 0; i < 8; ++i) {
+      if (counts[i] == 0) continue;
+      auto child = std::make_unique<build_node>();
+      child->size = node.size * 0.5f;
+      child->min = node.min + glm::vec3(i & 1, (i >> 1) & 1, (i >> 2) & 1) * child->size;
+      child->level = node.level + 1;
+      node.children[i] = std::move(child);
+    }
+
+    const auto build_child = [&](const size_t i) {
+      if (node.children[i]) build(*node.children[i], starts[i], starts[i + 1]);
+    };
+    if (count >= parallel_points) {
+      pool_.parallel_for(0, 8, build_child);
+    } else {
+      for (size_t i = 0; i < 8; ++i) build_child(i);
+    }
+
+    subsample(node);
+  }
+
+  // Moves the first of the children's points to fall into each cell of the node's grid up into the
+  // node. Children left with no points and no children of their own are dropped.
+  void subsample(build_node &node) const {
+    const uint32_t grid = settings_.grid_size;
+    thread_local std::vector<uint64_t> taken;
+    taken.assign((static_cast<size_t>(grid) * grid * grid + 63) / 64, 0);
+
+    const float scale = static_cast<float>(grid) / node.size;
+    for (std::unique_ptr<build_node> &child : node.children) {
+      if (!child) continue;
+
+      size_t kept = 0;
+      for (const uint32_t index : child->points) {
+        const glm::ivec3 cell = glm::clamp(glm::ivec3((source_.points[index].position - node.min) * scale),
+                                           glm::ivec3(0), glm::ivec3(static_cast<int32_t>(grid) - 1));
+        const size_t bit = (static_cast<size_t>(cell.z) * grid + cell.y) * grid + cell.x;
+        uint64_t &word = taken[bit / 64];
+        const uint64_t mask = uint64_t{1} << (bit % 64);
+        if ((word & mask) == 0) {
+          word |= mask;
+          node.points.push_back(index);
+        } else {
+          child->points[kept++] = index;
+        }
+      }
+      child->points.resize(kept);
+
+      const bool has_children = std::any_of(std::begin(child->children), std::end(child->children),
+                                            [](const std::unique_ptr<build_node> &c) { return c != nullptr; });
+      if (kept == 0 && !has_children) child.reset();
+    }
+  }
+
+  point_set &source_;
+  const point_cloud_build_settings &settings_;
+  thread_pool &pool_;
+  std::vector<source_point> scratch_;
+};
+
+bool write_octree(const std::filesystem::path &path, const point_set &source, const build_node &root,
+                  const point_cloud_build_settings &settings, thread_pool &pool) {
+  // Breadth first, so every node's children are contiguous and coarse levels come first in the file.
+  std::vector<const build_node *> order = {&root};
+  std::vector<point_cloud_node> nodes;
+  uint64_t point_count = 0;
+  for (size_t i = 0; i < order.size(); ++i) {
+    const build_node &node = *order[i];
+    point_cloud_node entry{};
+    std::memcpy(entry.min, &node.min, sizeof(entry.min));
+    entry.size = node.size;
+    entry.first_point = point_count;
+    entry.point_count = static_cast<uint32_t>(node.points.size());
+    entry.first_child = static_cast<uint32_t>(order.size());
+    entry.level = static_cast<uint8_t>(node.level);
+    for (int32_t child = 0; child < 8; ++child) {
+      if (!node.children[child]) continue;
+      entry.child_mask |= static_cast<uint8_t>(1 << child);
+      order.push_back(node.children[child].get());
+    }
+    nodes.push_back(entry);
+    point_count += node.points.size();
+  }
+
+  std::ofstream file(path, std::ios::binary | std::ios::trunc);
+  if (!file) return false;
+
+  point_cloud_header header{};
+  std::memcpy(header.magic, point_cloud_magic, sizeof(point_cloud_magic));
+  header.version = point_cloud_version;
+  header.node_count = static_cast<uint32_t>(nodes.size());
+  header.point_count = point_count;
+  header.offset[0] = source.offset.x;
+  header.offset[1] = source.offset.y;
+  header.offset[2] = source.offset.z;
+  header.grid_size = settings.grid_size;
+  header.flags = source.has_color ? has_color_flag : 0;
+  file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+  file.write(reinterpret_cast<const char *>(nodes.data()),
+             static_cast<std::streamsize>(nodes.size() * sizeof(point_cloud_node)));
+
+  // A few thousand nodes at a time keeps the encoded copy small next to the source points.
+  constexpr size_t batch = 4096;
+  std::vector<point_cloud_point> encoded;
+  for (size_t first = 0; first < order.size(); first += batch) {
+    const size_t last = std::min(order.size(), first + batch);
+    encoded.resize(nodes[last - 1].first_point + nodes[last - 1].point_count - nodes[first].first_point);
+
+    pool.parallel_for(first, last, [&](const size_t i) {
+      const build_node &node = *order[i];
+      point_cloud_point *out = encoded.data() + (nodes[i].first_point - nodes[first].first_point);
+      const float scale = 65535.0f / node.size;
+      for (const uint32_t index : node.points) {
+        const source_point &point = source.points[index];
+        const glm::vec3 position = glm::clamp((point.position - node.min) * scale + 0.5f, 0.0f, 65535.0f);
+        point_cloud_point &encoded_point = *out++;
+        for (int32_t c = 0; c < 3; ++c) encoded_point.position[c] = static_cast<uint16_t>(position[c]);
+        encoded_point.intensity = point.intensity;
+        std::copy(point.color, point.color + 3, encoded_point.color);
+        encoded_point.color[3] = 255;
+      }
+    });
+
+    file.write(reinterpret_cast<const char *>(encoded.data()),
+               static_cast<std::streamsize>(encoded.size() * sizeof(point_cloud_point)));
+  }
+
+  return static_cast<bool>(file);
+}
+
+std::filesystem::path cook(const std::filesystem::path &cached, const std::string &name,
+                           const point_cloud_build_settings &settings, thread_pool &pool,
+                           const std::function<point_set()> &load) {
+  if (std::filesystem::exists(cached)) return cached;
+
+  point_set source = load();
+  if (source.empty()) return {};
+
+  const auto start = std::chrono::steady_clock::now();
+  if (!write_point_cloud_octree(cached, source, settings, pool)) {
+    std::cout << "Failed to write point cloud octree: " << cached << std::endl;
+    return {};
+  }
+  const std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+
+  std::cout << "Built an octree of " << source.points.size() << " points from " << name << " into "
+            << cached.filename() << " in " << elapsed.count() << " ms" << std::endl;
+  return cached;
+}
+
+uint64_t settings_key(const point_cloud_build_settings &settings, const uint64_t seed) {
+  const uint32_t parameters[4] = {cache_version, settings.leaf_points, settings.grid_size, settings.max_depth};
+  return fnv1a_64(parameters, sizeof(parameters), seed);
+}
+
+}  // namespace
+
+bool write_point_cloud_octree(const std::filesystem::path &path, point_set &points,
+                              const point_cloud_build_settings &settings, thread_pool &pool) {
+  if (points.empty() || points.points.size() > 0xFFFFFFFFu || settings.grid_size == 0 ||
+      settings.grid_size > 1024 || settings.max_depth > 255) {
+    return false;
+  }
+
+  glm::vec3 min(std::numeric_limits<float>::max()), max(std::numeric_limits<float>::lowest());
+  for (const source_point &point : points.points) {
+    min = glm::min(min, point.position);
+    max = glm::max(max, point.position);
+  }
+  // Padded a little so the points on the far faces still fall inside the root's last octant.
+  const glm::vec3 extent = max - min;
+  const float size = std::max({extent.x, extent.y, extent.z, 1e-3f}) * 1.001f;
+
+  const std::unique_ptr<build_node> root = octree_builder(points, settings, pool).build(min, size);
+
+  return mfsys::write_file_atomically(path, [&](const std::filesystem::path &temporary) {
+    return write_octree(temporary, points, *root, settings, pool);
+  });
+}
+
+point_cloud_file open_point_cloud_octree(const std::filesystem::path &path) {
+  point_cloud_file result;
+
+  auto file = std::make_shared<mfsys::mapped_file>(path);
+  if (!file->is_open() || file->size() < sizeof(point_cloud_header)) return result;
+
+  point_cloud_header header{};
+  std::memcpy(&header, file->data(), sizeof(header));
+  if (std::memcmp(header.magic, point_cloud_magic, sizeof(point_cloud_magic)) != 0 ||
+      header.version != point_cloud_version || header.node_count == 0 || header.grid_size == 0) {
+    return result;
+  }
+
+  const size_t nodes_bytes = static_cast<size_t>(header.node_count) * sizeof(point_cloud_node);
+  const size_t points_offset = sizeof(point_cloud_header) + nodes_bytes;
+  if (file->size() < points_offset || (file->size() - points_offset) / sizeof(point_cloud_point) < header.point_count) {
+    return result;
+  }
+
+  // Every range must stay inside the file, so the runtime can trust the nodes without checks.
+  const auto *nodes = reinterpret_cast<const point_cloud_node *>(file->data() + sizeof(point_cloud_header));
+  for (uint32_t i = 0; i < header.node_count; ++i) {
+    const point_cloud_node &node = nodes[i];
+    const auto children = static_cast<uint32_t>(std::bitset<8>(node.child_mask).count());
+    if (node.first_point > header.point_count || node.point_count > header.point_count - node.first_point) {
+      return result;
+    }
+    if (children != 0 && (node.first_child <= i || node.first_child > header.node_count - children)) return result;
+  }
+
+  result.nodes = nodes;
+  result.points = reinterpret_cast<const point_cloud_point *>(file->data() + points_offset);
+  result.node_count = header.node_count;
+  result.point_count = header.point_count;
+  result.grid_size = header.grid_size;
+  result.offset = glm::dvec3(header.offset[0], header.offset[1], header.offset[2]);
+  result.has_color = (header.flags & has_color_flag) != 0;
+  result.file = std::move(file);
+  return result;
+}
+
+std::filesystem::path cook_point_cloud(const std::string &path, const std::filesystem::path &cache_directory,
+                                       const point_cloud_build_settings &settings, thread_pool &pool) {
+  std::error_code error;
+  const uintmax_t size = std::filesystem::file_size(path, error);
+  if (error) {
+    std::cout << "Failed to open point cloud: " << path << std::endl;
+    return {};
+  }
+  const auto modified = std::filesystem::last_write_time(path, error).time_since_epoch().count();
+
+  const std::string absolute = std::filesystem::absolute(path, error).string();
+  const uint64_t stamp[2] = {static_cast<uint64_t>(size), static_cast<uint64_t>(modified)};
+  const uint64_t key = settings_key(settings, fnv1a_64(stamp, sizeof(stamp), fnv1a_64(absolute)));
+
+  return cook(cache_directory / (hash_to_hex(key) + ".pcloud"), path, settings, pool,
+              [&]() { return load_las(path, pool); });
+}
+
+std::filesystem::path cook_generated_point_cloud(const point_cloud_generator_settings &generator,
+                                                 const std::filesystem::path &cache_directory,
+                                                 const point_cloud_build_settings &settings, thread_pool &pool) {
+  const uint64_t parameters[2] = {static_cast<uint64_t>(generator.point_count), generator.seed};
+  uint64_t key = fnv1a_64(parameters, sizeof(parameters), fnv1a_64("generated point cloud"));
+  key = fnv1a_64(&generator.radius, sizeof(generator.radius), key);
+  key = settings_key(settings, key);
+
+  return cook(cache_directory / (hash_to_hex(key) + ".pcloud"), "generated point cloud", settings, pool,
+              [&]() { return generate_point_cloud(generator, pool); });
+}
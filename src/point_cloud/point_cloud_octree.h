@@ -0,0 +1,82 @@
+#ifndef POINT_CLOUD_OCTREE_H
+#define POINT_CLOUD_OCTREE_H
+
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <string>
+
+#include "point_cloud_source.h"
+#include "../filesystem/mapped_file.h"
+
+class thread_pool;
+
+// A point as stored in the octree file and on the GPU, 12 bytes: its position inside its node's
+// cube in 16-bit fixed point, so precision follows the node size.
+struct point_cloud_point {
+  uint16_t position[3];
+  uint16_t intensity;
+  uint8_t color[4];
+};
+static_assert(sizeof(point_cloud_point) == 12, "point cloud points must be packed");
+
+struct point_cloud_node {
+  float min[3];  // relative to the cloud's origin
+  float size;    // edge length of the node's cube
+  uint64_t first_point;
+  uint32_t point_count;
+  uint32_t first_child;  // children are stored contiguously, in octant order
+  uint8_t child_mask;    // bit i set when octant i (x | y << 1 | z << 2) has a child
+  uint8_t level;
+  uint16_t reserved;
+  uint32_t reserved2;
+};
+static_assert(sizeof(point_cloud_node) == 40, "point cloud nodes must be packed");
+
+struct point_cloud_build_settings {
+  uint32_t leaf_points = 20'000;  // nodes holding more are split
+  // Interior nodes keep one point per cell of a grid this many cells across their cube; the
+  // points they take are removed from their children, so no point is stored twice.
+  uint32_t grid_size = 128;
+  uint32_t max_depth = 20;
+};
+
+// A mapped octree file: a header, every node breadth first and then every node's points, so a
+// node's points are one contiguous range that can be read straight into a vertex buffer.
+struct point_cloud_file {
+  std::shared_ptr<mfsys::mapped_file> file;
+  const point_cloud_node *nodes = nullptr;
+  const point_cloud_point *points = nullptr;
+  uint32_t node_count = 0;
+  uint64_t point_count = 0;
+  uint32_t grid_size = 0;
+  glm::dvec3 offset = glm::dvec3(0.0);  // source coordinates of the origin
+  bool has_color = false;
+
+  [[nodiscard]] bool empty() const { return nodes == nullptr; }
+  // Distance between neighbouring points of a node, roughly.
+  [[nodiscard]] float spacing(const point_cloud_node &node) const { return node.size / static_cast<float>(grid_size); }
+};
+
+// Sorts the points into an octree and writes it. Subtrees are built in parallel on the pool. The
+// points are reordered in place.
+[[nodiscard]] bool write_point_cloud_octree(const std::filesystem::path &path, point_set &points,
+                                            const point_cloud_build_settings &settings, thread_pool &pool);
+
+// Returns an empty file when `path` cannot be mapped or is not a point cloud octree.
+[[nodiscard]] point_cloud_file open_point_cloud_octree(const std::filesystem::path &path);
+
+// Like cook_terrain(): returns the octree for the LAS file at `path` in `cache_directory`,
+// building it first when the source or settings changed. Scans are too large to hash, so the key
+// is the source's path, size and modification time.
+[[nodiscard]] std::filesystem::path cook_point_cloud(const std::string &path,
+                                                     const std::filesystem::path &cache_directory,
+                                                     const point_cloud_build_settings &settings, thread_pool &pool);
+
+// The same for a generated point cloud, keyed by the generator settings.
+[[nodiscard]] std::filesystem::path cook_generated_point_cloud(const point_cloud_generator_settings &generator,
+                                                               const std::filesystem::path &cache_directory,
+                                                               const point_cloud_build_settings &settings,
+                                                               thread_pool &pool);
+
+#endif  // POINT_CLOUD_OCTREE_H
@@ -0,0 +1,199 @@
+#include "point_cloud_source.h"
+
+#include <glm/gtc/constants.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <iterator>
+#include <random>
+
+#include "../filesystem/mapped_file.h"
+#include "../utility/thread_pool.h"
+
+namespace {
+
+template <typename T>
+T read_le(const uint8_t *bytes) {
+  T value;
+  std::memcpy(&value, bytes, sizeof(T));
+  return value;
+}
+
+// Byte offset of the RGB triple in a point record, or 0 without colour.
+size_t color_offset(const uint8_t format) {
+  switch (format) {
+    case 2: return 20;
+    case 3: return 28;
+    case 7:
+    case 8: return 30;
+    default: return 0;
+  }
+}
+
+size_t minimum_record_length(const uint8_t format) {
+  constexpr size_t lengths[] = {20, 28, 26, 34, 0, 0, 30, 36, 38};
+  return format < std::size(lengths) ? lengths[format] : 0;
+}
+
+// Cheap value noise for the generator's surfaces.
+float wave(const float x, const float z) {
+  return 0.35f * std::sin(x * 0.31f) * std::cos(z * 0.27f) + 0.12f * std::sin(x * 1.7f + z * 1.3f) +
+         0.05f * std::sin(x * 5.1f - z * 4.3f);
+}
+
+uint8_t to_channel(const float value) { return static_cast<uint8_t>(std::clamp(value, 0.0f, 1.0f) * 255.0f + 0.5f); }
+
+}  // namespace
+
+point_set load_las(const std::string &path, thread_pool &pool) {
+  point_set result;
+
+  const mfsys::mapped_file file(path);
+  const uint8_t *bytes = file.data();
+  if (!file.is_open() || file.size() < 227 || std::memcmp(bytes, "LASF", 4) != 0) {
+    std::cout << "Not a LAS file: " << path << std::endl;
+    return result;
+  }
+
+  const uint8_t minor_version = bytes[25];
+  const auto data_offset = read_le<uint32_t>(bytes + 96);
+  const uint8_t format = bytes[104];
+  const auto record_length = read_le<uint16_t>(bytes + 105);
+  uint64_t count = read_le<uint32_t>(bytes + 107);
+  if (minor_version >= 4 && file.size() >= 255 && count == 0) count = read_le<uint64_t>(bytes + 247);
+
+  // Bit 7 marks LAZ compression, which is not supported.
+  if (minimum_record_length(format) == 0 || record_length < minimum_record_length(format)) {
+    std::cout << "Unsupported LAS point format " << static_cast<int32_t>(format) << ": " << path << std::endl;
+    return result;
+  }
+  if (data_offset > file.size() || count > (file.size() - data_offset) / record_length) {
+    std::cout << "Truncated LAS file: " << path << std::endl;
+    return result;
+  }
+
+  const glm::dvec3 scale(read_le<double>(bytes + 131), read_le<double>(bytes + 139), read_le<double>(bytes + 147));
+  const glm::dvec3 offset(read_le<double>(bytes + 155), read_le<double>(bytes + 163), read_le<double>(bytes + 171));
+  const glm::dvec3 minimum(read_le<double>(bytes + 187), read_le<double>(bytes + 203), read_le<double>(bytes + 219));
+  const double maximum_y = read_le<double>(bytes + 195);
+
+  const size_t colors = color_offset(format);
+  const uint8_t *records = bytes + data_offset;
+
+  // Colours are meant to be scaled to 16 bits, but plenty of writers store 8.
+  std::atomic<uint16_t> brightest{0};
+  if (colors != 0) {
+    pool.parallel_for(0, static_cast<size_t>(count), [&](const size_t i) {
+      const uint8_t *rgb = records + i * record_length + colors;
+      const uint16_t value = std::max({read_le<uint16_t>(rgb), read_le<uint16_t>(rgb + 2), read_le<uint16_t>(rgb + 4)});
+      uint16_t current = brightest.load(std::memory_order_relaxed);
+      while (value > current && !brightest.compare_exchange_weak(current, value, std::memory_order_relaxed)) {
+      }
+    }, 65536);
+  }
+  const uint32_t color_shift = brightest.load() > 255 ? 8 : 0;
+
+  result.points.resize(static_cast<size_t>(count));
+  result.offset = glm::dvec3(minimum.x, maximum_y, minimum.z);
+  result.has_color = colors != 0;
+
+  pool.parallel_for(0, result.points.size(), [&](const size_t i) {
+    const uint8_t *record = records + i * record_length;
+    const glm::dvec3 source = glm::dvec3(read_le<int32_t>(record), read_le<int32_t>(record + 4),
+                                         read_le<int32_t>(record + 8)) * scale + offset;
+
+    source_point &point = result.points[i];
+    point.position = glm::vec3(static_cast<float>(source.x - minimum.x), static_cast<float>(source.z - minimum.z),
+                               static_cast<float>(maximum_y - source.y));
+    point.intensity = read_le<uint16_t>(record + 12);
+    for (int32_t c = 0; c < 3; ++c) {
+      point.color[c] =
+          colors == 0 ? 255 : static_cast<uint8_t>(read_le<uint16_t>(record + colors + c * 2) >> color_shift);
+    }
+  }, 65536);
+
+  return result;
+}
+
+point_set generate_point_cloud(const point_cloud_generator_settings &settings, thread_pool &pool) {
+  point_set result;
+  result.points.resize(settings.point_count);
+  result.has_color = true;
+
+  const float radius = settings.radius;
+  constexpr int32_t column_count = 16;
+  const float ring = radius * 0.55f;
+  const float column_radius = radius * 0.04f;
+  const float column_height = radius * 0.35f;
+
+  // Some columns stand whole, the others are broken off part way up.
+  std::mt19937 layout(settings.seed);
+  std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+  float heights[column_count];
+  for (float &height : heights) {
+    height = unit(layout) < 0.6f ? column_height : column_height * (0.2f + 0.6f * unit(layout));
+  }
+
+  // Surfaces are picked in proportion to their area, so the density is even across the scan.
+  const float ground_area = glm::pi<float>() * radius * radius;
+  float column_areas[column_count];
+  float total_area = ground_area;
+  for (int32_t i = 0; i < column_count; ++i) {
+    column_areas[i] = glm::two_pi<float>() * column_radius * heights[i];
+    total_area += column_areas[i];
+  }
+
+  const auto ground_height = [&](const float x, const float z) { return (wave(x, z) + 0.6f) * radius * 0.02f; };
+
+  constexpr size_t batch = 1 << 18;
+  pool.parallel_for(0, (settings.point_count + batch - 1) / batch, [&](const size_t block) {
+    std::mt19937 random(settings.seed * 7919u + static_cast<uint32_t>(block));
+    std::uniform_real_distribution<float> uniform(0.0f, 1.0f);
+    std::normal_distribution<float> noise(0.0f, 1.0f);
+
+    const size_t end = std::min(settings.point_count, (block + 1) * batch);
+    for (size_t i = block * batch; i < end; ++i) {
+      source_point &point = result.points[i];
+      float pick = uniform(random) * total_area;
+
+      if (pick < ground_area) {
+        const float angle = uniform(random) * glm::two_pi<float>();
+        const float distance = radius * std::sqrt(uniform(random));
+        const float x = radius + std::cos(angle) * distance, z = radius + std::sin(angle) * distance;
+        point.position = glm::vec3(x, ground_height(x, z), z);
+
+        const float grass = std::clamp(0.6f + wave(x * 0.5f, z * 0.5f) + noise(random) * 0.1f, 0.0f, 1.0f);
+        const glm::vec3 colour = glm::mix(glm::vec3(0.45f, 0.36f, 0.25f), glm::vec3(0.32f, 0.45f, 0.20f), grass);
+        point.color[0] = to_channel(colour.r + noise(random) * 0.03f);
+        point.color[1] = to_channel(colour.g + noise(random) * 0.03f);
+        point.color[2] = to_channel(colour.b + noise(random) * 0.03f);
+        point.intensity = static_cast<uint16_t>(std::clamp(18000.0f + noise(random) * 3000.0f, 0.0f, 65535.0f));
+        continue;
+      }
+
+      pick -= ground_area;
+      int32_t column = 0;
+      while (column < column_count - 1 && pick >= column_areas[column]) pick -= column_areas[column++];
+
+      const float place = glm::two_pi<float>() * static_cast<float>(column) / column_count;
+      const float centre_x = radius + std::cos(place) * ring, centre_z = radius + std::sin(place) * ring;
+      const float angle = uniform(random) * glm::two_pi<float>();
+      const float height = uniform(random) * heights[column];
+      // Flutes: shallow grooves around the shaft.
+      const float surface = column_radius * (1.0f - 0.04f * std::abs(std::sin(angle * 10.0f)));
+      point.position = glm::vec3(centre_x + std::cos(angle) * surface, ground_height(centre_x, centre_z) + height,
+                                 centre_z + std::sin(angle) * surface);
+
+      const float weathering = 0.85f + 0.1f * std::sin(height * 3.1f + angle) + noise(random) * 0.03f;
+      point.color[0] = to_channel(0.78f * weathering);
+      point.color[1] = to_channel(0.72f * weathering);
+      point.color[2] = to_channel(0.62f * weathering);
+      point.intensity = static_cast<uint16_t>(std::clamp(42000.0f + noise(random) * 4000.0f, 0.0f, 65535.0f));
+    }
+  });
+
+  return result;
+}
@@ -0,0 +1,41 @@
+#ifndef POINT_CLOUD_SOURCE_H
+#define POINT_CLOUD_SOURCE_H
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+class thread_pool;
+
+struct source_point {
+  glm::vec3 position;  // relative to point_set::offset, y up
+  uint16_t intensity;
+  uint8_t color[3];
+};
+
+// Points as read from a scan, before the octree is built.
+struct point_set {
+  std::vector<source_point> points;
+  glm::dvec3 offset = glm::dvec3(0.0);  // source coordinates of position (0, 0, 0)
+  bool has_color = false;
+
+  [[nodiscard]] bool empty() const { return points.empty(); }
+};
+
+// Reads a LAS 1.0-1.4 file with point data record formats 0-3 or 6-8. Source Z is up; points are
+// turned to the engine's y-up axes as (X, Z, -Y), relative to the header's minimum. 16-bit colours
+// are narrowed to 8 bits.
+[[nodiscard]] point_set load_las(const std::string &path, thread_pool &pool);
+
+struct point_cloud_generator_settings {
+  size_t point_count = 8'000'000;
+  uint32_t seed = 1;
+  float radius = 25.0f;  // metres; the ground disc, the ruin inside it is scaled to match
+};
+
+// A scan-like sample of a ruined colonnade on rough ground, for scenes without a LiDAR asset.
+[[nodiscard]] point_set generate_point_cloud(const point_cloud_generator_settings &settings, thread_pool &pool);
+
+#endif  // POINT_CLOUD_SOURCE_H
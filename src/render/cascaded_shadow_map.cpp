@@ -0,0 +1,300 @@
+#include "cascaded_shadow_map.h"
+
+#include <glad/glad.h>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <string>
+
+#include "../shader/shader.h"
+
+namespace {
+
+// Slope-scaled and constant depth bias while rendering casters, against shadow acne.
+constexpr float bias_slope = 2.0f;
+constexpr float bias_constant = 4.0f;
+
+// Weight of the newest frame in the running averages.
+constexpr double smoothing = 0.1;
+// Cached cascades are rendered only now and then, so how often is averaged over longer.
+constexpr double share_smoothing = 0.02;
+
+}  // namespace
+
+cascaded_shadow_map::cascaded_shadow_map(const shadow_cascade_settings &config) : config_(config) {
+  config_.cascades = std::clamp(config_.cascades, 1u, max_shadow_cascades);
+  config_.first_cached = std::min(config_.first_cached, config_.cascades);
+  stats_.cascades = config_.cascades;
+}
+
+cascaded_shadow_map::~cascaded_shadow_map() {
+  if (framebuffer_ == 0) return;
+  glDeleteFramebuffers(1, &framebuffer_);
+  glDeleteTextures(1, &texture_);
+}
+
+void cascaded_shadow_map::update(const glm::mat4 &view, const float fov_y, const float aspect, const float z_near,
+                                 const glm::vec3 &light_direction) {
+  if (light_direction != light_direction_) {
+    light_direction_ = light_direction;
+    const glm::vec3 up =
+        std::abs(light_direction.y) > 0.99f ? glm::vec3(0.0f, 0.0f, 1.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+    light_view_ = glm::lookAt(glm::vec3(0.0f), -light_direction, up);
+    invalidate();
+  }
+
+  const glm::mat4 camera = glm::inverse(view);
+  view_forward_ = -glm::vec3(camera[2]);
+
+  // A slice's corners at view depth d are d * k off the view axis.
+  const float tan_half_fov = std::tan(0.5f * fov_y);
+  const float k2 = tan_half_fov * tan_half_fov * (1.0f + aspect * aspect);
+  const float z_far = std::max(config_.distance, 2.0f * z_near);
+
+  float slice_near = z_near;
+  for (uint32_t i = 0; i < config_.cascades; ++i) {
+    cascade &current = cascades_[i];
+    const float part = static_cast<float>(i + 1) / static_cast<float>(config_.cascades);
+    const float logarithmic = z_near * std::pow(z_far / z_near, part);
+    const float uniform = z_near + (z_far - z_near) * part;
+    const float slice_far = uniform + config_.split_blend * (logarithmic - uniform);
+    current.split_far = slice_far;
+    stats_.split_far[i] = slice_far;
+
+    // The smallest sphere around the slice is centred on the view axis, where the near and the far
+    // corners are equally far, unless that lies past the far plane.
+    float centre_depth = 0.5f * (1.0f + k2) * (slice_far + slice_near);
+    float radius;
+    if (centre_depth >= slice_far) {
+      centre_depth = slice_far;
+      radius = slice_far * std::sqrt(k2);
+    } else {
+      radius = std::sqrt((slice_far - centre_depth) * (slice_far - centre_depth) + slice_far * slice_far * k2);
+    }
+    slice_near = slice_far;
+    const glm::vec3 centre = glm::vec3(light_view_ * (camera * glm::vec4(0.0f, 0.0f, -centre_depth, 1.0f)));
+
+    const bool cached = caching_ && i >= config_.first_cached;
+    if (cached && current.valid) {
+      const glm::vec3 offset = glm::abs(centre - current.centre) + radius;
+      const bool fits = offset.x <= current.radius && offset.y <= current.radius && offset.z <= current.radius;
+      if (fits) {
+        current.render = current.held_dynamic;
+        continue;
+      }
+    }
+
+    current.radius = cached ? radius * (1.0f + config_.cache_margin) : radius;
+    const float texel = 2.0f * current.radius / static_cast<float>(config_.resolution);
+    current.centre = glm::vec3(std::floor(centre.x / texel) * texel, std::floor(centre.y / texel) * texel, centre.z);
+    const glm::vec3 &c = current.centre;
+    const float r = current.radius;
+    current.view_projection = glm::ortho(c.x - r, c.x + r, c.y - r, c.y + r, -(c.z + r), -(c.z - r)) * light_view_;
+    current.valid = false;
+    current.render = true;
+  }
+}
+
+void cascaded_shadow_map::add_dynamic_caster(const glm::vec3 &min, const glm::vec3 &max) {
+  glm::vec3 light_min, light_max;
+  light_bounds(min, max, light_min, light_max);
+  for (uint32_t i = 0; i < config_.cascades; ++i) {
+    if (!reaches(cascades_[i], light_min, light_max)) continue;
+    cascades_[i].dynamic = true;
+    cascades_[i].render = true;
+  }
+}
+
+void cascaded_shadow_map::invalidate() {
+  for (cascade &current : cascades_) current.valid = false;
+}
+
+void cascaded_shadow_map::set_caching(const bool caching) {
+  caching_ = caching;
+  invalidate();
+}
+
+bool cascaded_shadow_map::renders_cached() const {
+  for (uint32_t i = config_.first_cached; i < config_.cascades; ++i) {
+    if (cascades_[i].render || !cascades_[i].valid) return true;
+  }
+  return false;
+}
+
+bool cascaded_shadow_map::begin(const shader &program) {
+  render_mask_ = 0;
+  for (uint32_t i = 0; i < config_.cascades; ++i) {
+    if (cascades_[i].render || !cascades_[i].valid) render_mask_ |= 1u << i;
+  }
+  if (render_mask_ == 0) {
+    record_frame();
+    return false;
+  }
+
+  if (framebuffer_ == 0) {
+    glGenTextures(1, &texture_);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, texture_);
+    glTexStorage3D(GL_TEXTURE_2D_ARRAY, 1, GL_DEPTH_COMPONENT32F, config_.resolution, config_.resolution,
+                   static_cast<GLsizei>(config_.cascades));
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
+    constexpr GLfloat border[] = {1.0f, 1.0f, 1.0f, 1.0f};  // unshadowed
+    glTexParameterfv(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_BORDER_COLOR, border);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+
+    glGenFramebuffers(1, &framebuffer_);
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer_);
+    glFramebufferTexture(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, texture_, 0);
+    glDrawBuffer(GL_NONE);
+    glReadBuffer(GL_NONE);
+#ifdef DEBUG
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+      std::cout << "shadow cascades are incomplete" << std::endl;
+    }
+#endif
+  }
+  glBindFramebuffer(GL_FRAMEBUFFER, framebuffer_);
+  glViewport(0, 0, config_.resolution, config_.resolution);
+
+  constexpr GLfloat far_depth = 1.0f;
+  for (uint32_t i = 0; i < config_.cascades; ++i) {
+    program.setMat4("cascadeViewProjections[" + std::to_string(i) + "]", cascades_[i].view_projection);
+    if ((render_mask_ & (1u << i)) == 0) continue;
+    glClearTexSubImage(texture_, 0, 0, 0, static_cast<GLint>(i), config_.resolution, config_.resolution, 1,
+                       GL_DEPTH_COMPONENT, GL_FLOAT, &far_depth);
+    stats_.draws[i] = 0;
+  }
+
+  glEnable(GL_DEPTH_CLAMP);
+  glEnable(GL_POLYGON_OFFSET_FILL);
+  glPolygonOffset(bias_slope, bias_constant);
+  return true;
+}
+
+uint32_t cascaded_shadow_map::cull_caster(const glm::vec3 &min, const glm::vec3 &max) {
+  glm::vec3 light_min, light_max;
+  light_bounds(min, max, light_min, light_max);
+  uint32_t mask = 0;
+  for (uint32_t i = 0; i < config_.cascades; ++i) {
+    if ((render_mask_ & (1u << i)) == 0 || !reaches(cascades_[i], light_min, light_max)) continue;
+    mask |= 1u << i;
+    ++stats_.draws[i];
+  }
+  return mask;
+}
+
+void cascaded_shadow_map::end() {
+  glDisable(GL_POLYGON_OFFSET_FILL);
+  glDisable(GL_DEPTH_CLAMP);
+  glBindFramebuffer(GL_FRAMEBUFFER, 0);
+  record_frame();
+}
+
+void cascaded_shadow_map::bind(const shader &program) const {
+  program.setBool("useShadows", texture_ != 0);
+  if (texture_ == 0) return;
+
+  glActiveTexture(GL_TEXTURE0 + texture_unit);
+  glBindTexture(GL_TEXTURE_2D_ARRAY, texture_);
+  glActiveTexture(GL_TEXTURE0);
+  program.setInt("shadowMap", texture_unit);
+
+  // Clip space to texture coordinates and depth in [0, 1].
+  const glm::mat4 bias = glm::scale(glm::translate(glm::mat4(1.0f), glm::vec3(0.5f)), glm::vec3(0.5f));
+  glm::vec4 splits(0.0f), texel_sizes(0.0f);
+  for (uint32_t i = 0; i < config_.cascades; ++i) {
+    program.setMat4("shadowMatrices[" + std::to_string(i) + "]", bias * cascades_[i].view_projection);
+    splits[static_cast<glm::length_t>(i)] = cascades_[i].split_far;
+    texel_sizes[static_cast<glm::length_t>(i)] = 2.0f * cascades_[i].radius / static_cast<float>(config_.resolution);
+  }
+  program.setVec4("shadowSplits", splits);
+  program.setVec4("shadowTexelSizes", texel_sizes);
+  program.setInt("shadowCascades", static_cast<int32_t>(config_.cascades));
+  program.setVec3("shadowViewForward", view_forward_);
+}
+
+void cascaded_shadow_map::print_stats(std::ostream &out, const double full_ms, const double near_ms) const {
+  out << std::fixed << std::setprecision(1) << "shadows: " << stats_.cascades << " cascades to " << config_.distance
+      << " m, ";
+  if (caching_) {
+    out << "cached from cascade " << config_.first_cached;
+  } else {
+    out << "not cached";
+  }
+  out << "; " << stats_.rendered << " rendered last frame" << std::endl;
+  for (uint32_t i = 0; i < stats_.cascades; ++i) {
+    out << "  cascade " << i << " to " << stats_.split_far[i] << " m: " << stats_.draws[i] << " casters, ";
+    if (stats_.cached_frames[i] == 0) {
+      out << "rendered";
+    } else {
+      out << "reused for " << stats_.cached_frames[i] << " frames";
+    }
+    out << std::endl;
+  }
+  out << std::setprecision(0) << "  " << stats_.average_drawn << " caster draws a frame, "
+      << stats_.average_skipped << " skipped by caching" << std::endl;
+  out << std::setprecision(3) << "  caster pass " << full_ms << " ms with the cached cascades";
+  if (caching_ && near_ms > 0.0) {
+    const double saved_ms = (1.0 - stats_.cached_rendered) * std::max(full_ms - near_ms, 0.0);
+    out << ", " << near_ms << " ms without; rendered them " << std::setprecision(1)
+        << 100.0 * stats_.cached_rendered << "% of frames, saving " << std::setprecision(3) << saved_ms
+        << " ms a frame";
+  }
+  out << std::endl;
+}
+
+void cascaded_shadow_map::light_bounds(const glm::vec3 &min, const glm::vec3 &max, glm::vec3 &light_min,
+                                       glm::vec3 &light_max) const {
+  const glm::mat3 rotation(light_view_);
+  const glm::vec3 centre = rotation * (0.5f * (min + max));
+  const glm::mat3 absolute(glm::abs(rotation[0]), glm::abs(rotation[1]), glm::abs(rotation[2]));
+  const glm::vec3 extent = absolute * (0.5f * (max - min));
+  light_min = centre - extent;
+  light_max = centre + extent;
+}
+
+bool cascaded_shadow_map::reaches(const cascade &target, const glm::vec3 &light_min, const glm::vec3 &light_max) const {
+  // Anything toward the light is flattened onto the box, so only its far side bounds the depth.
+  const glm::vec3 &c = target.centre;
+  const float r = target.radius;
+  return light_max.x >= c.x - r && light_min.x <= c.x + r && light_max.y >= c.y - r && light_min.y <= c.y + r &&
+         light_max.z >= c.z - r;
+}
+
+void cascaded_shadow_map::record_frame() {
+  stats_.rendered = 0;
+  stats_.drawn = 0;
+  stats_.skipped = 0;
+  for (uint32_t i = 0; i < config_.cascades; ++i) {
+    cascade &current = cascades_[i];
+    if ((render_mask_ & (1u << i)) != 0) {
+      current.valid = true;
+      current.held_dynamic = current.dynamic;
+      ++stats_.rendered;
+      stats_.drawn += stats_.draws[i];
+      stats_.cached_frames[i] = 0;
+    } else {
+      stats_.skipped += stats_.draws[i];
+      ++stats_.cached_frames[i];
+    }
+    current.render = false;
+    current.dynamic = false;
+  }
+  const bool cached = (render_mask_ >> config_.first_cached) != 0;
+  render_mask_ = 0;
+
+  const bool first = stats_.average_drawn == 0.0 && stats_.average_skipped == 0.0;
+  const double drawn = stats_.drawn, skipped = stats_.skipped;
+  stats_.average_drawn = first ? drawn : stats_.average_drawn + smoothing * (drawn - stats_.average_drawn);
+  stats_.average_skipped = first ? skipped : stats_.average_skipped + smoothing * (skipped - stats_.average_skipped);
+  const double share = cached ? 1.0 : 0.0;
+  stats_.cached_rendered = first ? share : stats_.cached_rendered + share_smoothing * (share - stats_.cached_rendered);
+}
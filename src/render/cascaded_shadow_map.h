@@ -0,0 +1,155 @@
+#ifndef CASCADED_SHADOW_MAP_H
+#define CASCADED_SHADOW_MAP_H
+
+#include <glm/glm.hpp>
+
+#include <array>
+#include <cstdint>
+#include <iosfwd>
+
+class shader;
+
+constexpr uint32_t max_shadow_cascades = 4;
+
+struct shadow_cascade_settings {
+  uint32_t cascades = 4;  // at most max_shadow_cascades
+  int32_t resolution = 2048;  // texels across each cascade
+  float distance = 250.0f;  // from the camera, beyond which nothing is shadowed
+  // The practical split scheme: how far the split distances lean from uniform (0) to logarithmic (1).
+  float split_blend = 0.75f;
+  // Cascades from this one on are cached while they hold only static casters.
+  uint32_t first_cached = 2;
+  // Cached cascades cover this much more than their slice of the view frustum, so they stay put
+  // while the camera moves about within it.
+  float cache_margin = 0.25f;
+};
+
+struct shadow_cascade_stats {
+  uint32_t cascades = 0;
+  std::array<float, max_shadow_cascades> split_far{};  // view depth at which each cascade ends
+  std::array<uint32_t, max_shadow_cascades> draws{};  // casters drawn into each when it was last rendered
+  std::array<uint32_t, max_shadow_cascades> cached_frames{};  // reused since, 0 when rendered last frame
+  // Of the last frame.
+  uint32_t rendered = 0;  // cascades
+  uint32_t drawn = 0;  // caster draws into the cascades rendered
+  uint32_t skipped = 0;  // caster draws the cascades reused took when they were rendered
+  // Per frame, over recent frames.
+  double average_drawn = 0.0;
+  double average_skipped = 0.0;
+  double cached_rendered = 0.0;  // share of frames that rendered a cached cascade
+};
+
+// Cascaded shadow maps for a directional light. The view frustum up to `distance` is cut into
+// slices by the practical split scheme, and each slice gets a layer of a depth texture array,
+// rendered with an orthographic projection around the slice's bounding sphere. The sphere's radius
+// depends only on the slice, so a cascade's texels keep their size as the camera turns, and its
+// centre is snapped to whole texels of the light's view, so they do not crawl as it moves.
+//
+// Casters are drawn once for all the cascades being rendered: cull_caster() gives the cascades a
+// caster's bounds reach, and the caster program draws one instance per cascade, its geometry
+// shader sending each to its layer:
+//
+//   uniform int cascadeMask;                 // from cull_caster()
+//   uniform mat4 cascadeViewProjections[4];  // world to the cascade's clip space
+//
+// Depth is clamped rather than clipped toward the light, so casters between the light and a
+// cascade's box are flattened onto its near side rather than lost.
+//
+// Distant cascades are cached. They are fit to a sphere `cache_margin` larger than their slice's
+// and rendered again only when the slice leaves it, the light turns, invalidate() is called for a
+// change in the static casters or a dynamic caster was in them this frame or the last.
+//
+// Receivers pick a cascade by view depth and sample it with depth comparison, see bind(). Layered
+// clears need GL 4.4, so not on macOS. All member functions must be called on the thread that owns
+// the GL context.
+class cascaded_shadow_map {
+ public:
+  static constexpr int32_t texture_unit = 6;
+
+  explicit cascaded_shadow_map(const shadow_cascade_settings &config = {});
+  cascaded_shadow_map(const cascaded_shadow_map &) = delete;
+  cascaded_shadow_map &operator=(const cascaded_shadow_map &) = delete;
+
+  ~cascaded_shadow_map();
+
+  // Fits the cascades to the view frustum of a camera at `view`, with a perspective projection of
+  // `fov_y` and `aspect` from `z_near`, for a light shining from `light_direction` (towards the
+  // light, as the shaders take it), and marks the ones whose map is out of date for rendering.
+  void update(const glm::mat4 &view, float fov_y, float aspect, float z_near, const glm::vec3 &light_direction);
+
+  // Marks the cascades a caster that may have moved, within world bounds `min` to `max`, can
+  // shadow for rendering. Call for every such caster between update() and begin().
+  void add_dynamic_caster(const glm::vec3 &min, const glm::vec3 &max);
+
+  // The static casters changed: every cascade is rendered again.
+  void invalidate();
+
+  // Without caching every cascade is rendered every frame.
+  void set_caching(bool caching);
+  [[nodiscard]] bool caching() const { return caching_; }
+
+  // Whether begin() renders any cascade that could have been cached this frame; with caching on,
+  // time the frames that do apart from the rest to measure what caching saves, see print_stats().
+  [[nodiscard]] bool renders_cached() const;
+
+  // Binds the cascades marked for rendering and clears them, with `program`, the caster program,
+  // in use. Returns false, binding nothing, when they are all cached; otherwise draw every caster
+  // into the cascades of cull_caster() and end().
+  bool begin(const shader &program);
+
+  // The cascades being rendered that a caster within world bounds `min` to `max` can shadow, as
+  // `cascadeMask`; draw it with an instance per bit set.
+  uint32_t cull_caster(const glm::vec3 &min, const glm::vec3 &max);
+
+  // Finishes rendering; the caller binds its framebuffer again.
+  void end();
+
+  // Sets the receiver uniforms of `program`, which must be in use, and binds the cascades to
+  // texture_unit:
+  //
+  //   uniform bool useShadows;
+  //   uniform sampler2DArrayShadow shadowMap;
+  //   uniform mat4 shadowMatrices[4];  // world to the cascade's texture coordinates and depth
+  //   uniform vec4 shadowSplits;       // view depth at which each cascade ends
+  //   uniform vec4 shadowTexelSizes;   // of a texel in the world, by cascade
+  //   uniform int shadowCascades;
+  //   uniform vec3 shadowViewForward;  // the camera's, to measure view depth from viewPos
+  void bind(const shader &program) const;
+
+  [[nodiscard]] const shadow_cascade_stats &stats() const { return stats_; }
+  // `full_ms` and `near_ms` are the GPU times of caster passes that did and did not render the
+  // cached cascades: caching saves their difference on every frame that reuses them.
+  void print_stats(std::ostream &out, double full_ms, double near_ms) const;
+
+ private:
+  struct cascade {
+    glm::mat4 view_projection = glm::mat4(1.0f);
+    glm::vec3 centre = glm::vec3(0.0f);  // of its box, in the light's view
+    float radius = 0.0f;  // half the box's size
+    float split_far = 0.0f;
+    bool valid = false;  // holds the casters around its box
+    bool render = false;  // this frame
+    bool dynamic = false;  // a dynamic caster is in it this frame
+    bool held_dynamic = false;  // when it was last rendered
+  };
+
+  // The light-view bounds of world bounds `min` to `max`.
+  void light_bounds(const glm::vec3 &min, const glm::vec3 &max, glm::vec3 &light_min, glm::vec3 &light_max) const;
+  [[nodiscard]] bool reaches(const cascade &target, const glm::vec3 &light_min, const glm::vec3 &light_max) const;
+  void record_frame();
+
+  shadow_cascade_settings config_;
+  std::array<cascade, max_shadow_cascades> cascades_;
+  glm::vec3 light_direction_ = glm::vec3(0.0f);
+  glm::mat4 light_view_ = glm::mat4(1.0f);
+  glm::vec3 view_forward_ = glm::vec3(0.0f, 0.0f, -1.0f);
+  bool caching_ = true;
+  uint32_t render_mask_ = 0;
+
+  uint32_t framebuffer_ = 0;
+  uint32_t texture_ = 0;
+
+  shadow_cascade_stats stats_;
+};
+
+#endif  // CASCADED_SHADOW_MAP_H
@@ -0,0 +1,60 @@
+#include "clustered_lighting.h"
+
+#include <glad/glad.h>
+
+#include <algorithm>
+
+#include "../shader/shader.h"
+
+namespace {
+
+void upload_storage(const uint32_t buffer, const size_t bytes, const void *data) {
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffer);
+  // Empty buffers cannot be bound, so everything gets at least a word.
+  glBufferData(GL_SHADER_STORAGE_BUFFER, static_cast<GLsizeiptr>(std::max<size_t>(bytes, sizeof(uint32_t))), data,
+               GL_STREAM_DRAW);
+}
+
+}  // namespace
+
+clustered_lighting::clustered_lighting() {
+  glGenBuffers(1, &light_buffer_);
+  glGenBuffers(1, &cluster_buffer_);
+  glGenBuffers(1, &index_buffer_);
+}
+
+clustered_lighting::~clustered_lighting() {
+  glDeleteBuffers(1, &light_buffer_);
+  glDeleteBuffers(1, &cluster_buffer_);
+  glDeleteBuffers(1, &index_buffer_);
+}
+
+void clustered_lighting::upload(const std::vector<point_light> &lights, const light_grid &grid) {
+  upload_storage(light_buffer_, lights.size() * sizeof(point_light), lights.data());
+  upload_storage(cluster_buffer_, grid.light_ranges().size() * sizeof(glm::uvec2), grid.light_ranges().data());
+  upload_storage(index_buffer_, grid.light_indices().size() * sizeof(uint32_t), grid.light_indices().data());
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+  light_count_ = lights.size();
+  grid_ = grid.settings();
+  slice_scale_ = grid.slice_scale();
+  slice_bias_ = grid.slice_bias();
+  z_near_ = grid.z_near();
+  z_far_ = grid.z_far();
+}
+
+void clustered_lighting::bind(const shader &program, const float width, const float height) const {
+  program.setBool("useClusteredLights", light_count_ > 0);
+  if (light_count_ == 0) return;
+
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER, light_binding, light_buffer_);
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER, cluster_binding, cluster_buffer_);
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER, index_binding, index_buffer_);
+
+  glUniform3i(glGetUniformLocation(program.getID(), "clusterCounts"), grid_.tiles_x, grid_.tiles_y, grid_.slices);
+  program.setVec2("clusterTileSize", width / static_cast<float>(grid_.tiles_x),
+                  height / static_cast<float>(grid_.tiles_y));
+  program.setFloat("clusterSliceScale", slice_scale_);
+  program.setFloat("clusterSliceBias", slice_bias_);
+  program.setVec2("clusterDepthRange", z_near_, z_far_);
+}
@@ -0,0 +1,56 @@
+#ifndef CLUSTERED_LIGHTING_H
+#define CLUSTERED_LIGHTING_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "light_grid.h"
+
+class shader;
+
+// The GPU side of clustered forward shading: the point lights and a light_grid's per-cluster lists
+// in three storage blocks, which the clustered material shaders read as
+//
+//   layout (std430, binding = 7) readonly buffer PointLights { PointLight pointLights[]; };
+//   layout (std430, binding = 8) readonly buffer LightClusters { uvec2 lightClusters[]; };  // first, count
+//   layout (std430, binding = 9) readonly buffer LightIndices { uint lightIndices[]; };
+//
+// A fragment finds its cluster from gl_FragCoord and its view depth, recovered from gl_FragCoord.z,
+// and loops over that cluster's lights only. Everything is uploaded again each frame the lights or
+// the camera move, orphaning the old storage like draw_batcher does.
+//
+// Storage blocks need GL 4.3, so not on macOS. All member functions must be called on the thread
+// that owns the GL context.
+class clustered_lighting {
+ public:
+  static constexpr uint32_t light_binding = 7;
+  static constexpr uint32_t cluster_binding = 8;
+  static constexpr uint32_t index_binding = 9;
+
+  clustered_lighting();
+  clustered_lighting(const clustered_lighting &) = delete;
+  clustered_lighting &operator=(const clustered_lighting &) = delete;
+
+  ~clustered_lighting();
+
+  // Uploads `lights` and the lists `grid` last assigned them to.
+  void upload(const std::vector<point_light> &lights, const light_grid &grid);
+
+  // Binds the buffers and sets the uniforms the clustered shaders read on `program`, which must be
+  // in use, for a viewport of `width` by `height` pixels. With no lights uploaded it turns the
+  // clustered lights off instead.
+  void bind(const shader &program, float width, float height) const;
+
+ private:
+  uint32_t light_buffer_ = 0;
+  uint32_t cluster_buffer_ = 0;
+  uint32_t index_buffer_ = 0;
+  size_t light_count_ = 0;
+
+  // Of the grid last uploaded.
+  light_grid_settings grid_;
+  float slice_scale_ = 0.0f, slice_bias_ = 0.0f, z_near_ = 0.0f, z_far_ = 0.0f;
+};
+
+#endif  // CLUSTERED_LIGHTING_H
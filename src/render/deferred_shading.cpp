@@ -0,0 +1,103 @@
+#include "deferred_shading.h"
+
+#include <glad/glad.h>
+
+#ifdef DEBUG
+#include <iostream>
+#endif
+
+#include "render_target.h"
+#include "../shader/shader.h"
+
+namespace {
+
+constexpr GLint albedo_unit = 0;
+constexpr GLint normal_unit = 1;
+constexpr GLint depth_unit = 2;
+constexpr GLuint output_image = 0;
+constexpr uint32_t tile_size = 8;  // local_size_x and local_size_y of lighting.comp
+
+void allocate(const GLuint texture, const GLenum format, const int32_t width, const int32_t height) {
+  glBindTexture(GL_TEXTURE_2D, texture);
+  glTexStorage2D(GL_TEXTURE_2D, 1, format, width, height);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+}
+
+}  // namespace
+
+deferred_shading::~deferred_shading() {
+  if (framebuffer_ == 0) return;
+  glDeleteFramebuffers(1, &framebuffer_);
+  glDeleteTextures(1, &albedo_);
+  glDeleteTextures(1, &normal_);
+}
+
+void deferred_shading::begin(const render_target &target) {
+  if (framebuffer_ == 0) glGenFramebuffers(1, &framebuffer_);
+  glBindFramebuffer(GL_FRAMEBUFFER, framebuffer_);
+
+  if (target.width() != width_ || target.height() != height_) {
+    width_ = target.width();
+    height_ = target.height();
+    // Immutable storage cannot be resized, so the textures are made anew.
+    if (albedo_ != 0) {
+      glDeleteTextures(1, &albedo_);
+      glDeleteTextures(1, &normal_);
+    }
+    glGenTextures(1, &albedo_);
+    glGenTextures(1, &normal_);
+    allocate(albedo_, GL_RGBA8, width_, height_);
+    allocate(normal_, GL_RGB10_A2, width_, height_);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, albedo_, 0);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, normal_, 0);
+    constexpr GLenum draw_buffers[] = {GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1};
+    glDrawBuffers(2, draw_buffers);
+    depth_ = 0;
+  }
+  if (target.depth_texture() != depth_) {
+    depth_ = target.depth_texture();
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, depth_, 0);
+#ifdef DEBUG
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+      std::cout << "G-buffer is incomplete" << std::endl;
+    }
+#endif
+  }
+
+  glViewport(0, 0, width_, height_);
+  // The alpha channels hold data, not coverage.
+  blend_ = glIsEnabled(GL_BLEND) == GL_TRUE;
+  glDisable(GL_BLEND);
+  // A lighting model of 0 marks the pixels nothing deferred covers.
+  constexpr GLfloat clear[] = {0.0f, 0.0f, 0.0f, 0.0f};
+  glClearBufferfv(GL_COLOR, 0, clear);
+  glClearBufferfv(GL_COLOR, 1, clear);
+}
+
+void deferred_shading::light(const shader &program, const render_target &target) const {
+  program.use();
+  glActiveTexture(GL_TEXTURE0 + albedo_unit);
+  glBindTexture(GL_TEXTURE_2D, albedo_);
+  glActiveTexture(GL_TEXTURE0 + normal_unit);
+  glBindTexture(GL_TEXTURE_2D, normal_);
+  glActiveTexture(GL_TEXTURE0 + depth_unit);
+  glBindTexture(GL_TEXTURE_2D, target.depth_texture());
+  glActiveTexture(GL_TEXTURE0);
+  program.setInt("gAlbedo", albedo_unit);
+  program.setInt("gNormal", normal_unit);
+  program.setInt("gDepth", depth_unit);
+  glBindImageTexture(output_image, target.colour_texture(), 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA8);
+
+  glDispatchCompute((width_ + tile_size - 1) / tile_size, (height_ + tile_size - 1) / tile_size, 1);
+  // The lit colour must have landed before the draws and the blit after it.
+  glMemoryBarrier(GL_FRAMEBUFFER_BARRIER_BIT | GL_TEXTURE_FETCH_BARRIER_BIT);
+
+  glActiveTexture(GL_TEXTURE0 + depth_unit);
+  glBindTexture(GL_TEXTURE_2D, 0);
+  glActiveTexture(GL_TEXTURE0);
+  if (blend_) glEnable(GL_BLEND);
+  target.bind();
+}
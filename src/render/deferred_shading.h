@@ -0,0 +1,59 @@
+#ifndef DEFERRED_SHADING_H
+#define DEFERRED_SHADING_H
+
+#include <cstdint>
+
+class render_target;
+class shader;
+
+// Deferred shading into a render_target: the lit materials are first drawn into a compact G-buffer
+// that shares the target's depth, then one compute pass lights every pixel from it and writes the
+// result into the target's colour, and whatever is drawn forward afterwards depth-tests against
+// the same depth. Per pixel the G-buffer holds eight bytes besides the depth:
+//
+//   albedo    RGBA8     albedo, specular intensity
+//   normal    RGB10_A2  octahedral normal in rg, shininess / 256 in b, lighting model in a
+//
+// The position is rebuilt from the depth and the inverse view-projection rather than stored. The
+// lighting models are 0 for pixels nothing deferred covered, which keep the target's colour, 1 for
+// the Light struct with specular of shader460.frag and 2 for the directional light and fog of the
+// HLOD shaders; both take the clustered point lights too (see clustered_lighting.h).
+//
+// The G-buffer programs write location 0 to the albedo and 1 to the normal. The lighting program
+// samples `gAlbedo`, `gNormal` and `gDepth` on texture units 0 to 2, writes the target's colour
+// through image unit 0 and works on 8x8 pixel tiles. Both pack and unpack the layout with
+// shaders/deferred/gbuffer.glsl.
+//
+// Compute shaders need GL 4.3, so not on macOS. All member functions must be called on the thread
+// that owns the GL context.
+class deferred_shading {
+ public:
+  deferred_shading() = default;
+  deferred_shading(const deferred_shading &) = delete;
+  deferred_shading &operator=(const deferred_shading &) = delete;
+
+  ~deferred_shading();
+
+  // Binds the G-buffer for drawing with the target's depth, (re)creating it when the target's size
+  // changed, and clears its colour; the caller clears the depth with the target's. Blending is off
+  // until light().
+  void begin(const render_target &target);
+
+  // Lights the G-buffer into the target's colour with the compute program `program`, whose
+  // uniforms the caller has set, and binds the target again with blending as it was.
+  void light(const shader &program, const render_target &target) const;
+
+  [[nodiscard]] uint32_t albedo_texture() const { return albedo_; }
+  [[nodiscard]] uint32_t normal_texture() const { return normal_; }
+
+ private:
+  uint32_t framebuffer_ = 0;
+  uint32_t albedo_ = 0;
+  uint32_t normal_ = 0;
+  uint32_t depth_ = 0;  // the target's, as last attached
+  int32_t width_ = 0;
+  int32_t height_ = 0;
+  bool blend_ = false;  // enabled before begin()
+};
+
+#endif  // DEFERRED_SHADING_H
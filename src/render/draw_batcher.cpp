@@ -0,0 +1,137 @@
+#include "draw_batcher.h"
+
+#include <glad/glad.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <tuple>
+
+#include "../material/material_library.h"
+
+namespace {
+
+constexpr GLuint model_location = 3;
+constexpr GLuint material_location = 7;
+
+}  // namespace
+
+draw_batcher::draw_batcher(const uint32_t vertex_buffer) : multi_draw_indirect_(GLAD_GL_VERSION_4_3 != 0) {
+  glGenVertexArrays(1, &vao_);
+  glGenBuffers(1, &instance_buffer_);
+  glGenBuffers(1, &indirect_buffer_);
+
+  glBindVertexArray(vao_);
+  glBindBuffer(GL_ARRAY_BUFFER, vertex_buffer);
+  glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), nullptr);
+  glEnableVertexAttribArray(0);
+  glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), reinterpret_cast<void *>(3 * sizeof(float)));
+  glEnableVertexAttribArray(1);
+  glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(float), reinterpret_cast<void *>(6 * sizeof(float)));
+  glEnableVertexAttribArray(2);
+
+  glBindBuffer(GL_ARRAY_BUFFER, instance_buffer_);
+  for (GLuint column = 0; column < 4; ++column) {
+    glEnableVertexAttribArray(model_location + column);
+    glVertexAttribDivisor(model_location + column, 1);
+  }
+  glEnableVertexAttribArray(material_location);
+  glVertexAttribDivisor(material_location, 1);
+  point_instance_attributes(0);
+
+  glBindVertexArray(0);
+}
+
+draw_batcher::~draw_batcher() {
+  glDeleteVertexArrays(1, &vao_);
+  glDeleteBuffers(1, &instance_buffer_);
+  glDeleteBuffers(1, &indirect_buffer_);
+}
+
+void draw_batcher::point_instance_attributes(const size_t first_instance) const {
+  // Without base instances the attributes themselves are offset to the first instance of a draw.
+  const size_t base = first_instance * sizeof(instance);
+  for (GLuint column = 0; column < 4; ++column) {
+    glVertexAttribPointer(model_location + column, 4, GL_FLOAT, GL_FALSE, sizeof(instance),
+                          reinterpret_cast<void *>(base + offsetof(instance, model) + column * sizeof(glm::vec4)));
+  }
+  glVertexAttribIPointer(material_location, 1, GL_UNSIGNED_INT, sizeof(instance),
+                         reinterpret_cast<void *>(base + offsetof(instance, material)));
+}
+
+void draw_batcher::add(const mesh_range &mesh, const glm::mat4 &model, const uint32_t material) {
+  items_.push_back({material, mesh, {model, material}});
+}
+
+void draw_batcher::flush(const material_library &materials, const shader &program) {
+  stats_ = {};
+  stats_.instances = items_.size();
+
+  for (auto &item : items_) item.bind_set = materials.bind_set(item.data.material);
+  items_.erase(std::remove_if(items_.begin(), items_.end(),
+                              [](const draw_item &item) { return item.bind_set == material_library::no_bind_set; }),
+               items_.end());
+  if (items_.empty()) return;
+
+  std::sort(items_.begin(), items_.end(), [](const draw_item &a, const draw_item &b) {
+    return std::tie(a.bind_set, a.mesh.first, a.mesh.count) < std::tie(b.bind_set, b.mesh.first, b.mesh.count);
+  });
+
+  // One command per run of the same mesh; runs never cross a bind set.
+  instances_.clear();
+  commands_.clear();
+  std::vector<size_t> set_starts;
+  for (size_t i = 0; i < items_.size(); ++i) {
+    const draw_item &item = items_[i];
+    const bool new_set = i == 0 || item.bind_set != items_[i - 1].bind_set;
+    if (new_set) set_starts.push_back(commands_.size());
+
+    if (new_set || item.mesh.first != items_[i - 1].mesh.first || item.mesh.count != items_[i - 1].mesh.count) {
+      commands_.push_back({static_cast<uint32_t>(item.mesh.count), 0, static_cast<uint32_t>(item.mesh.first),
+                           static_cast<uint32_t>(instances_.size())});
+    }
+    ++commands_.back().instance_count;
+    instances_.push_back(item.data);
+  }
+  set_starts.push_back(commands_.size());
+
+  glBindVertexArray(vao_);
+  glBindBuffer(GL_ARRAY_BUFFER, instance_buffer_);
+  glBufferData(GL_ARRAY_BUFFER, static_cast<GLsizeiptr>(instances_.size() * sizeof(instance)), instances_.data(),
+               GL_STREAM_DRAW);
+  if (multi_draw_indirect_) {
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, indirect_buffer_);
+    glBufferData(GL_DRAW_INDIRECT_BUFFER, static_cast<GLsizeiptr>(commands_.size() * sizeof(indirect_command)),
+                 commands_.data(), GL_STREAM_DRAW);
+  }
+
+  size_t item = 0;
+  for (size_t set = 0; set + 1 < set_starts.size(); ++set) {
+    materials.bind(program, items_[item].bind_set, 0, 1);
+    ++stats_.bind_sets;
+
+    const size_t first = set_starts[set], last = set_starts[set + 1];
+    if (multi_draw_indirect_) {
+      glMultiDrawArraysIndirect(GL_TRIANGLES, reinterpret_cast<void *>(first * sizeof(indirect_command)),
+                                static_cast<GLsizei>(last - first), 0);
+      ++stats_.draw_calls;
+    } else {
+      for (size_t command = first; command < last; ++command) {
+        point_instance_attributes(commands_[command].base_instance);
+        glDrawArraysInstanced(GL_TRIANGLES, static_cast<GLint>(commands_[command].first),
+                              static_cast<GLsizei>(commands_[command].count),
+                              static_cast<GLsizei>(commands_[command].instance_count));
+        ++stats_.draw_calls;
+      }
+    }
+
+    for (size_t command = first; command < last; ++command) item += commands_[command].instance_count;
+  }
+
+  if (multi_draw_indirect_) {
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+  } else {
+    point_instance_attributes(0);
+  }
+  glBindVertexArray(0);
+  items_.clear();
+}
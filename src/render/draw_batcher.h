@@ -0,0 +1,78 @@
+#ifndef DRAW_BATCHER_H
+#define DRAW_BATCHER_H
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <vector>
+
+class material_library;
+class shader;
+
+// A range of vertices in the batcher's vertex buffer.
+struct mesh_range {
+  int32_t first = 0;
+  int32_t count = 0;
+};
+
+struct draw_batch_stats {
+  size_t instances = 0;   // add() calls in the last flush
+  size_t draw_calls = 0;  // GL draw calls they turned into
+  size_t bind_sets = 0;   // texture binding changes
+};
+
+// Collects draws of meshes from one vertex buffer and submits them grouped by material bind set.
+// The model matrix and material index of every instance are vertex attributes (locations 3-6 and
+// 7), so nothing is set per draw. With GL 4.3 each bind set is one glMultiDrawArraysIndirect;
+// otherwise each distinct mesh in it is one glDrawArraysInstanced.
+class draw_batcher {
+ public:
+  // `vertex_buffer` holds interleaved position, normal and texture coordinates, 8 floats a vertex.
+  explicit draw_batcher(uint32_t vertex_buffer);
+  draw_batcher(const draw_batcher &) = delete;
+  draw_batcher &operator=(const draw_batcher &) = delete;
+
+  ~draw_batcher();
+
+  void add(const mesh_range &mesh, const glm::mat4 &model, uint32_t material);
+
+  // Draws and forgets everything added since the last flush. `program` must be in use. Draws whose
+  // material has no bind set are dropped.
+  void flush(const material_library &materials, const shader &program);
+
+  [[nodiscard]] const draw_batch_stats &stats() const { return stats_; }
+
+ private:
+  struct instance {
+    glm::mat4 model;
+    uint32_t material;
+  };
+
+  struct draw_item {
+    uint32_t bind_set;
+    mesh_range mesh;
+    instance data;
+  };
+
+  // Matches DrawArraysIndirectCommand.
+  struct indirect_command {
+    uint32_t count;
+    uint32_t instance_count;
+    uint32_t first;
+    uint32_t base_instance;
+  };
+
+  void point_instance_attributes(size_t first_instance) const;
+
+  uint32_t vao_ = 0;
+  uint32_t instance_buffer_ = 0;
+  uint32_t indirect_buffer_ = 0;
+  bool multi_draw_indirect_ = false;
+
+  std::vector<draw_item> items_;
+  std::vector<instance> instances_;
+  std::vector<indirect_command> commands_;
+  draw_batch_stats stats_;
+};
+
+#endif  // DRAW_BATCHER_H
@@ -0,0 +1,44 @@
+#include "frustum.h"
+
+frustum extract_frustum(const glm::mat4 &view_projection) {
+  // GLM is column-major: row i of the matrix is (m[0][i], m[1][i], m[2][i], m[3][i]).
+  const auto row = [&](const int32_t i) {
+    return glm::vec4(view_projection[0][i], view_projection[1][i], view_projection[2][i], view_projection[3][i]);
+  };
+
+  frustum result{};
+  result.planes[frustum::left] = row(3) + row(0);
+  result.planes[frustum::right] = row(3) - row(0);
+  result.planes[frustum::bottom] = row(3) + row(1);
+  result.planes[frustum::top] = row(3) - row(1);
+  result.planes[frustum::near_clip] = row(3) + row(2);
+  result.planes[frustum::far_clip] = row(3) - row(2);
+
+  for (glm::vec4 &plane : result.planes) plane /= glm::length(glm::vec3(plane));
+  return result;
+}
+
+frustum_test test_aabb(const frustum &planes, const glm::vec3 &min, const glm::vec3 &max) {
+  frustum_test result = frustum_test::inside;
+
+  for (const glm::vec4 &plane : planes.planes) {
+    const glm::vec3 normal(plane);
+    // The corners furthest along and against the plane normal.
+    const glm::vec3 positive(normal.x >= 0.0f ? max.x : min.x, normal.y >= 0.0f ? max.y : min.y,
+                             normal.z >= 0.0f ? max.z : min.z);
+    const glm::vec3 negative(normal.x >= 0.0f ? min.x : max.x, normal.y >= 0.0f ? min.y : max.y,
+                             normal.z >= 0.0f ? min.z : max.z);
+
+    if (glm::dot(normal, positive) + plane.w < 0.0f) return frustum_test::outside;
+    if (glm::dot(normal, negative) + plane.w < 0.0f) result = frustum_test::intersects;
+  }
+
+  return result;
+}
+
+bool is_sphere_visible(const frustum &planes, const glm::vec3 &center, const float radius) {
+  for (const glm::vec4 &plane : planes.planes) {
+    if (glm::dot(glm::vec3(plane), center) + plane.w < -radius) return false;
+  }
+  return true;
+}
@@ -0,0 +1,24 @@
+#ifndef FRUSTUM_H
+#define FRUSTUM_H
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+
+// The six planes of a view frustum as (normal, distance) with normals pointing inwards, so a point
+// p is inside a plane when dot(normal, p) + distance >= 0. Normals are unit length.
+struct frustum {
+  enum plane : uint8_t { left, right, bottom, top, near_clip, far_clip };
+
+  glm::vec4 planes[6];
+};
+
+enum class frustum_test : uint8_t { outside, intersects, inside };
+
+// Gribb-Hartmann extraction from a combined projection * view matrix, in world space.
+[[nodiscard]] frustum extract_frustum(const glm::mat4 &view_projection);
+
+[[nodiscard]] frustum_test test_aabb(const frustum &planes, const glm::vec3 &min, const glm::vec3 &max);
+[[nodiscard]] bool is_sphere_visible(const frustum &planes, const glm::vec3 &center, float radius);
+
+#endif  // FRUSTUM_H
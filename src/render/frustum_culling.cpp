@@ -0,0 +1,301 @@
+#include "frustum_culling.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+#include "../utility/simd.h"
+#include "../utility/thread_pool.h"
+
+namespace {
+
+// Objects culled together by one parallel task.
+constexpr size_t culling_run = 4096;
+static_assert(culling_run % culling_batch == 0, "runs must hold whole batches");
+
+// Padding lanes: a sphere of negative radius and a box of negative extent are outside every plane.
+constexpr float never_visible = -std::numeric_limits<float>::max();
+
+// For every 8-bit visibility mask, the visible lanes in order and how many there are, so a batch's
+// indices are appended with one unconditional store instead of a branch per object.
+struct compaction_table {
+  uint8_t lanes[256][8];
+  uint8_t counts[256];
+};
+
+constexpr compaction_table make_compaction_table() {
+  compaction_table table{};
+  for (int32_t mask = 0; mask < 256; ++mask) {
+    uint8_t count = 0;
+    for (uint8_t lane = 0; lane < 8; ++lane) {
+      if ((mask & (1 << lane)) != 0) table.lanes[mask][count++] = lane;
+    }
+    table.counts[mask] = count;
+  }
+  return table;
+}
+
+constexpr compaction_table compaction = make_compaction_table();
+
+// Writes all eight lanes; only the first counts[mask] are kept. `out` must have room for eight
+// past `count`, which a range never exceeds since count <= first - range start.
+size_t append_visible(uint32_t *out, const size_t count, const uint32_t first, const int32_t mask) {
+#if defined(ENGINE_SIMD_AVX2)
+  const __m256i lanes =
+      _mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(compaction.lanes[mask])));
+  _mm256_storeu_si256(reinterpret_cast<__m256i *>(out + count),
+                      _mm256_add_epi32(lanes, _mm256_set1_epi32(static_cast<int32_t>(first))));
+#else
+  for (int32_t lane = 0; lane < 8; ++lane) out[count + lane] = first + compaction.lanes[mask][lane];
+#endif
+  return count + compaction.counts[mask];
+}
+
+// Culls [begin, end), both multiples of culling_batch, into `out`; returns the number visible.
+size_t cull_sphere_range(const frustum &planes, const bounding_sphere_set &spheres, const size_t begin,
+                         const size_t end, uint32_t *out) {
+  const float *xs = spheres.x(), *ys = spheres.y(), *zs = spheres.z(), *radii = spheres.radius();
+  size_t count = 0;
+
+#if defined(ENGINE_SIMD_AVX2)
+  __m256 nx[6], ny[6], nz[6], w[6];
+  for (int32_t p = 0; p < 6; ++p) {
+    nx[p] = _mm256_set1_ps(planes.planes[p].x);
+    ny[p] = _mm256_set1_ps(planes.planes[p].y);
+    nz[p] = _mm256_set1_ps(planes.planes[p].z);
+    w[p] = _mm256_set1_ps(planes.planes[p].w);
+  }
+  for (size_t i = begin; i < end; i += 8) {
+    const __m256 x = _mm256_loadu_ps(xs + i), y = _mm256_loadu_ps(ys + i), z = _mm256_loadu_ps(zs + i);
+    const __m256 limit = _mm256_sub_ps(_mm256_setzero_ps(), _mm256_loadu_ps(radii + i));
+    __m256 visible = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+    for (int32_t p = 0; p < 6; ++p) {
+      const __m256 distance = _mm256_add_ps(
+          _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(nx[p], x), _mm256_mul_ps(ny[p], y)), _mm256_mul_ps(nz[p], z)),
+          w[p]);
+      visible = _mm256_and_ps(visible, _mm256_cmp_ps(distance, limit, _CMP_GE_OQ));
+    }
+    count = append_visible(out, count, static_cast<uint32_t>(i), _mm256_movemask_ps(visible));
+  }
+#elif defined(ENGINE_SIMD_SSE2)
+  __m128 nx[6], ny[6], nz[6], w[6];
+  for (int32_t p = 0; p < 6; ++p) {
+    nx[p] = _mm_set1_ps(planes.planes[p].x);
+    ny[p] = _mm_set1_ps(planes.planes[p].y);
+    nz[p] = _mm_set1_ps(planes.planes[p].z);
+    w[p] = _mm_set1_ps(planes.planes[p].w);
+  }
+  const auto half_mask = [&](const size_t i) {
+    const __m128 x = _mm_loadu_ps(xs + i), y = _mm_loadu_ps(ys + i), z = _mm_loadu_ps(zs + i);
+    const __m128 limit = _mm_sub_ps(_mm_setzero_ps(), _mm_loadu_ps(radii + i));
+    __m128 visible = _mm_castsi128_ps(_mm_set1_epi32(-1));
+    for (int32_t p = 0; p < 6; ++p) {
+      const __m128 distance =
+          _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(nx[p], x), _mm_mul_ps(ny[p], y)), _mm_mul_ps(nz[p], z)), w[p]);
+      visible = _mm_and_ps(visible, _mm_cmpge_ps(distance, limit));
+    }
+    return _mm_movemask_ps(visible);
+  };
+  for (size_t i = begin; i < end; i += 8) {
+    count = append_visible(out, count, static_cast<uint32_t>(i), half_mask(i) | half_mask(i + 4) << 4);
+  }
+#else
+  for (size_t i = begin; i < end; i += 8) {
+    int32_t mask = 0;
+    for (int32_t lane = 0; lane < 8; ++lane) {
+      const size_t j = i + lane;
+      bool visible = true;
+      for (const glm::vec4 &plane : planes.planes) {
+        visible = visible && plane.x * xs[j] + plane.y * ys[j] + plane.z * zs[j] + plane.w >= -radii[j];
+      }
+      mask |= visible ? 1 << lane : 0;
+    }
+    count = append_visible(out, count, static_cast<uint32_t>(i), mask);
+  }
+#endif
+  return count;
+}
+
+// A box is outside a plane when its corner furthest along the normal is: the centre's distance plus
+// the extent projected onto the normal's absolute value is negative.
+size_t cull_box_range(const frustum &planes, const bounding_box_set &boxes, const size_t begin, const size_t end,
+                      uint32_t *out) {
+  const float *cxs = boxes.centre_x(), *cys = boxes.centre_y(), *czs = boxes.centre_z();
+  const float *exs = boxes.extent_x(), *eys = boxes.extent_y(), *ezs = boxes.extent_z();
+  size_t count = 0;
+
+#if defined(ENGINE_SIMD_AVX2)
+  __m256 nx[6], ny[6], nz[6], ax[6], ay[6], az[6], w[6];
+  for (int32_t p = 0; p < 6; ++p) {
+    const glm::vec4 &plane = planes.planes[p];
+    nx[p] = _mm256_set1_ps(plane.x), ny[p] = _mm256_set1_ps(plane.y), nz[p] = _mm256_set1_ps(plane.z);
+    ax[p] = _mm256_set1_ps(std::abs(plane.x)), ay[p] = _mm256_set1_ps(std::abs(plane.y));
+    az[p] = _mm256_set1_ps(std::abs(plane.z)), w[p] = _mm256_set1_ps(plane.w);
+  }
+  for (size_t i = begin; i < end; i += 8) {
+    const __m256 cx = _mm256_loadu_ps(cxs + i), cy = _mm256_loadu_ps(cys + i), cz = _mm256_loadu_ps(czs + i);
+    const __m256 ex = _mm256_loadu_ps(exs + i), ey = _mm256_loadu_ps(eys + i), ez = _mm256_loadu_ps(ezs + i);
+    __m256 visible = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+    for (int32_t p = 0; p < 6; ++p) {
+      const __m256 distance = _mm256_add_ps(
+          _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(nx[p], cx), _mm256_mul_ps(ny[p], cy)), _mm256_mul_ps(nz[p], cz)),
+          w[p]);
+      const __m256 reach =
+          _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(ax[p], ex), _mm256_mul_ps(ay[p], ey)), _mm256_mul_ps(az[p], ez));
+      visible = _mm256_and_ps(visible, _mm256_cmp_ps(_mm256_add_ps(distance, reach), _mm256_setzero_ps(), _CMP_GE_OQ));
+    }
+    count = append_visible(out, count, static_cast<uint32_t>(i), _mm256_movemask_ps(visible));
+  }
+#elif defined(ENGINE_SIMD_SSE2)
+  __m128 nx[6], ny[6], nz[6], ax[6], ay[6], az[6], w[6];
+  for (int32_t p = 0; p < 6; ++p) {
+    const glm::vec4 &plane = planes.planes[p];
+    nx[p] = _mm_set1_ps(plane.x), ny[p] = _mm_set1_ps(plane.y), nz[p] = _mm_set1_ps(plane.z);
+    ax[p] = _mm_set1_ps(std::abs(plane.x)), ay[p] = _mm_set1_ps(std::abs(plane.y));
+    az[p] = _mm_set1_ps(std::abs(plane.z)), w[p] = _mm_set1_ps(plane.w);
+  }
+  const auto half_mask = [&](const size_t i) {
+    const __m128 cx = _mm_loadu_ps(cxs + i), cy = _mm_loadu_ps(cys + i), cz = _mm_loadu_ps(czs + i);
+    const __m128 ex = _mm_loadu_ps(exs + i), ey = _mm_loadu_ps(eys + i), ez = _mm_loadu_ps(ezs + i);
+    __m128 visible = _mm_castsi128_ps(_mm_set1_epi32(-1));
+    for (int32_t p = 0; p < 6; ++p) {
+      const __m128 distance = _mm_add_ps(
+          _mm_add_ps(_mm_add_ps(_mm_mul_ps(nx[p], cx), _mm_mul_ps(ny[p], cy)), _mm_mul_ps(nz[p], cz)), w[p]);
+      const __m128 reach = _mm_add_ps(_mm_add_ps(_mm_mul_ps(ax[p], ex), _mm_mul_ps(ay[p], ey)), _mm_mul_ps(az[p], ez));
+      visible = _mm_and_ps(visible, _mm_cmpge_ps(_mm_add_ps(distance, reach), _mm_setzero_ps()));
+    }
+    return _mm_movemask_ps(visible);
+  };
+  for (size_t i = begin; i < end; i += 8) {
+    count = append_visible(out, count, static_cast<uint32_t>(i), half_mask(i) | half_mask(i + 4) << 4);
+  }
+#else
+  for (size_t i = begin; i < end; i += 8) {
+    int32_t mask = 0;
+    for (int32_t lane = 0; lane < 8; ++lane) {
+      const size_t j = i + lane;
+      bool visible = true;
+      for (const glm::vec4 &plane : planes.planes) {
+        const float distance = plane.x * cxs[j] + plane.y * cys[j] + plane.z * czs[j] + plane.w;
+        const float reach = std::abs(plane.x) * exs[j] + std::abs(plane.y) * eys[j] + std::abs(plane.z) * ezs[j];
+        visible = visible && distance + reach >= 0.0f;
+      }
+      mask |= visible ? 1 << lane : 0;
+    }
+    count = append_visible(out, count, static_cast<uint32_t>(i), mask);
+  }
+#endif
+  return count;
+}
+
+template <typename F>
+void cull_in_runs(const size_t padded_size, thread_pool &pool, std::vector<uint32_t> &visible, F &&cull_range) {
+  visible.resize(padded_size);
+  const size_t runs = (padded_size + culling_run - 1) / culling_run;
+  std::vector<size_t> counts(runs);
+  // Each run writes into its own slice of `visible`, then the slices are moved down in order.
+  pool.parallel_for(0, runs, [&](const size_t run) {
+    const size_t begin = run * culling_run;
+    counts[run] = cull_range(begin, std::min(begin + culling_run, padded_size), visible.data() + begin);
+  });
+
+  size_t total = 0;
+  for (size_t run = 0; run < runs; ++run) {
+    std::memmove(visible.data() + total, visible.data() + run * culling_run, counts[run] * sizeof(uint32_t));
+    total += counts[run];
+  }
+  visible.resize(total);
+}
+
+template <typename T>
+void append_padded(std::vector<T> &values, const size_t count, const T padding) {
+  if (count % culling_batch == 0) values.resize(count + culling_batch, padding);
+}
+
+}  // namespace
+
+uint32_t bounding_sphere_set::add(const glm::vec3 &centre, const float radius) {
+  append_padded(x_, count_, 0.0f);
+  append_padded(y_, count_, 0.0f);
+  append_padded(z_, count_, 0.0f);
+  append_padded(radius_, count_, never_visible);
+  const auto index = static_cast<uint32_t>(count_++);
+  set(index, centre, radius);
+  return index;
+}
+
+void bounding_sphere_set::set(const uint32_t index, const glm::vec3 &centre, const float radius) {
+  x_[index] = centre.x;
+  y_[index] = centre.y;
+  z_[index] = centre.z;
+  radius_[index] = radius;
+}
+
+void bounding_sphere_set::clear() {
+  x_.clear(), y_.clear(), z_.clear(), radius_.clear();
+  count_ = 0;
+}
+
+void bounding_sphere_set::reserve(const size_t count) {
+  const size_t padded = (count + culling_batch - 1) / culling_batch * culling_batch;
+  x_.reserve(padded), y_.reserve(padded), z_.reserve(padded), radius_.reserve(padded);
+}
+
+uint32_t bounding_box_set::add(const glm::vec3 &min, const glm::vec3 &max) {
+  append_padded(centre_x_, count_, 0.0f);
+  append_padded(centre_y_, count_, 0.0f);
+  append_padded(centre_z_, count_, 0.0f);
+  append_padded(extent_x_, count_, never_visible);
+  append_padded(extent_y_, count_, never_visible);
+  append_padded(extent_z_, count_, never_visible);
+  const auto index = static_cast<uint32_t>(count_++);
+  set(index, min, max);
+  return index;
+}
+
+void bounding_box_set::set(const uint32_t index, const glm::vec3 &min, const glm::vec3 &max) {
+  const glm::vec3 centre = 0.5f * (min + max), extent = 0.5f * (max - min);
+  centre_x_[index] = centre.x;
+  centre_y_[index] = centre.y;
+  centre_z_[index] = centre.z;
+  extent_x_[index] = extent.x;
+  extent_y_[index] = extent.y;
+  extent_z_[index] = extent.z;
+}
+
+void bounding_box_set::clear() {
+  centre_x_.clear(), centre_y_.clear(), centre_z_.clear();
+  extent_x_.clear(), extent_y_.clear(), extent_z_.clear();
+  count_ = 0;
+}
+
+void bounding_box_set::reserve(const size_t count) {
+  const size_t padded = (count + culling_batch - 1) / culling_batch * culling_batch;
+  centre_x_.reserve(padded), centre_y_.reserve(padded), centre_z_.reserve(padded);
+  extent_x_.reserve(padded), extent_y_.reserve(padded), extent_z_.reserve(padded);
+}
+
+void cull_spheres(const frustum &planes, const bounding_sphere_set &spheres, std::vector<uint32_t> &visible) {
+  visible.resize(spheres.padded_size());
+  visible.resize(cull_sphere_range(planes, spheres, 0, spheres.padded_size(), visible.data()));
+}
+
+void cull_spheres(const frustum &planes, const bounding_sphere_set &spheres, thread_pool &pool,
+                  std::vector<uint32_t> &visible) {
+  cull_in_runs(spheres.padded_size(), pool, visible, [&](const size_t begin, const size_t end, uint32_t *out) {
+    return cull_sphere_range(planes, spheres, begin, end, out);
+  });
+}
+
+void cull_boxes(const frustum &planes, const bounding_box_set &boxes, std::vector<uint32_t> &visible) {
+  visible.resize(boxes.padded_size());
+  visible.resize(cull_box_range(planes, boxes, 0, boxes.padded_size(), visible.data()));
+}
+
+void cull_boxes(const frustum &planes, const bounding_box_set &boxes, thread_pool &pool,
+                std::vector<uint32_t> &visible) {
+  cull_in_runs(boxes.padded_size(), pool, visible, [&](const size_t begin, const size_t end, uint32_t *out) {
+    return cull_box_range(planes, boxes, begin, end, out);
+  });
+}
@@ -0,0 +1,82 @@
+#ifndef FRUSTUM_CULLING_H
+#define FRUSTUM_CULLING_H
+
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "frustum.h"
+
+class thread_pool;
+
+// Objects are culled this many at a time; the sets below are padded to a multiple of it with
+// entries that are never visible, so the SIMD loops need no scalar tail.
+constexpr size_t culling_batch = 8;
+
+// Bounding spheres of many objects as structure-of-arrays, one lane per object.
+class bounding_sphere_set {
+ public:
+  // Returns the new sphere's index, which culling reports when it is visible.
+  uint32_t add(const glm::vec3 &centre, float radius);
+  void set(uint32_t index, const glm::vec3 &centre, float radius);
+  void clear();
+  void reserve(size_t count);
+
+  [[nodiscard]] size_t size() const { return count_; }
+  [[nodiscard]] bool empty() const { return count_ == 0; }
+  // size() rounded up to culling_batch; the lanes past size() are never visible.
+  [[nodiscard]] size_t padded_size() const { return x_.size(); }
+
+  [[nodiscard]] const float *x() const { return x_.data(); }
+  [[nodiscard]] const float *y() const { return y_.data(); }
+  [[nodiscard]] const float *z() const { return z_.data(); }
+  [[nodiscard]] const float *radius() const { return radius_.data(); }
+
+ private:
+  std::vector<float> x_, y_, z_, radius_;
+  size_t count_ = 0;
+};
+
+// Axis-aligned bounding boxes of many objects as structure-of-arrays, stored as centre and half
+// extent.
+class bounding_box_set {
+ public:
+  uint32_t add(const glm::vec3 &min, const glm::vec3 &max);
+  void set(uint32_t index, const glm::vec3 &min, const glm::vec3 &max);
+  void clear();
+  void reserve(size_t count);
+
+  [[nodiscard]] size_t size() const { return count_; }
+  [[nodiscard]] bool empty() const { return count_ == 0; }
+  [[nodiscard]] size_t padded_size() const { return centre_x_.size(); }
+
+  [[nodiscard]] const float *centre_x() const { return centre_x_.data(); }
+  [[nodiscard]] const float *centre_y() const { return centre_y_.data(); }
+  [[nodiscard]] const float *centre_z() const { return centre_z_.data(); }
+  [[nodiscard]] const float *extent_x() const { return extent_x_.data(); }
+  [[nodiscard]] const float *extent_y() const { return extent_y_.data(); }
+  [[nodiscard]] const float *extent_z() const { return extent_z_.data(); }
+
+ private:
+  std::vector<float> centre_x_, centre_y_, centre_z_, extent_x_, extent_y_, extent_z_;
+  size_t count_ = 0;
+};
+
+// Replaces `visible` with the indices, in increasing order, of the objects that are not entirely
+// outside one of the frustum's planes. Like is_sphere_visible() and test_aabb(), objects crossing
+// the corner of two planes outside the frustum are reported visible.
+//
+// With AVX2 every iteration tests eight objects against all six planes in registers and appends the
+// visible indices with one permuted store; SSE2 does the same as two halves of four. The pool
+// versions split the set into runs of a few thousand objects, cull them in parallel and join the
+// results in order.
+void cull_spheres(const frustum &planes, const bounding_sphere_set &spheres, std::vector<uint32_t> &visible);
+void cull_spheres(const frustum &planes, const bounding_sphere_set &spheres, thread_pool &pool,
+                  std::vector<uint32_t> &visible);
+void cull_boxes(const frustum &planes, const bounding_box_set &boxes, std::vector<uint32_t> &visible);
+void cull_boxes(const frustum &planes, const bounding_box_set &boxes, thread_pool &pool,
+                std::vector<uint32_t> &visible);
+
+#endif  // FRUSTUM_CULLING_H
@@ -0,0 +1,203 @@
+#include "gpu_culler.h"
+
+#include <glad/glad.h>
+
+#include <algorithm>
+#include <iostream>
+#include <limits>
+
+#include "frustum.h"
+#include "hiz_pyramid.h"
+#include "../shader/shader.h"
+
+namespace {
+
+constexpr GLuint mesh_binding = 2;
+constexpr GLuint meshlet_binding = 3;
+constexpr GLuint visibility_binding = 4;
+constexpr GLuint counter_binding = 6;
+
+constexpr GLint hiz_unit = 0;
+constexpr uint32_t group_size = 64;  // local_size_x of cull.comp
+
+// The layout glMultiDrawElementsIndirectCount reads.
+struct draw_command {
+  uint32_t count;
+  uint32_t instance_count;
+  uint32_t first_index;
+  int32_t base_vertex;
+  uint32_t base_instance;
+};
+static_assert(sizeof(draw_command) == 20, "indirect commands are five words");
+
+// The counter block: the draw count of each phase, then what the late phase culled.
+enum counter : uint32_t { early_draws, late_draws, outside, occluded_instances, occluded_meshlets, counter_count };
+
+void upload_storage(const uint32_t buffer, const size_t bytes, const void *data) {
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffer);
+  // Empty buffers cannot be bound, so everything gets at least a word.
+  glBufferData(GL_SHADER_STORAGE_BUFFER, static_cast<GLsizeiptr>(std::max<size_t>(bytes, sizeof(uint32_t))), data,
+               GL_STATIC_DRAW);
+}
+
+}  // namespace
+
+gpu_culler::gpu_culler() {
+  glGenBuffers(1, &instance_buffer_);
+  glGenBuffers(1, &mesh_buffer_);
+  glGenBuffers(1, &meshlet_buffer_);
+  glGenBuffers(1, &visibility_buffer_);
+  glGenBuffers(1, &command_buffer_);
+  glGenBuffers(1, &counter_buffer_);
+}
+
+gpu_culler::~gpu_culler() {
+  glDeleteBuffers(1, &instance_buffer_);
+  glDeleteBuffers(1, &mesh_buffer_);
+  glDeleteBuffers(1, &meshlet_buffer_);
+  glDeleteBuffers(1, &visibility_buffer_);
+  glDeleteBuffers(1, &command_buffer_);
+  glDeleteBuffers(1, &counter_buffer_);
+}
+
+uint32_t gpu_culler::add_mesh(const glm::vec3 *positions, const size_t stride, const uint32_t *indices,
+                              const size_t index_count, const uint32_t first_index, const int32_t base_vertex) {
+  const auto *bytes = reinterpret_cast<const uint8_t *>(positions);
+  const auto position = [&](const uint32_t index) {
+    return *reinterpret_cast<const glm::vec3 *>(bytes + index * stride);
+  };
+
+  gpu_mesh mesh{static_cast<uint32_t>(meshlets_.size()), 0};
+  const size_t triangles = index_count / 3;
+  for (size_t first = 0; first < triangles; first += meshlet_triangles) {
+    const size_t last = std::min<size_t>(first + meshlet_triangles, triangles);
+    glm::vec3 min(std::numeric_limits<float>::max());
+    glm::vec3 max(std::numeric_limits<float>::lowest());
+    for (size_t i = first * 3; i < last * 3; ++i) {
+      min = glm::min(min, position(indices[i]));
+      max = glm::max(max, position(indices[i]));
+    }
+    meshlets_.push_back({glm::vec4(min, 0.0f), glm::vec4(max, 0.0f), static_cast<uint32_t>((last - first) * 3),
+                         first_index + static_cast<uint32_t>(first * 3), base_vertex, 0});
+    ++mesh.meshlet_count;
+  }
+
+  meshes_.push_back(mesh);
+  return static_cast<uint32_t>(meshes_.size() - 1);
+}
+
+uint32_t gpu_culler::add_instance(const uint32_t mesh, const glm::mat4 &model, const glm::vec3 &min,
+                                  const glm::vec3 &max, const uint32_t user) {
+  instances_.push_back({model, glm::vec4(min, 0.0f), glm::vec4(max, 0.0f), mesh, user, {0, 0}});
+  return static_cast<uint32_t>(instances_.size() - 1);
+}
+
+void gpu_culler::clear() {
+  instances_.clear();
+  meshes_.clear();
+  meshlets_.clear();
+  command_capacity_ = 0;
+}
+
+void gpu_culler::upload() {
+  command_capacity_ = 0;
+  for (const gpu_instance &instance : instances_) command_capacity_ += meshes_[instance.mesh].meshlet_count;
+
+  upload_storage(instance_buffer_, instances_.size() * sizeof(gpu_instance), instances_.data());
+  upload_storage(mesh_buffer_, meshes_.size() * sizeof(gpu_mesh), meshes_.data());
+  upload_storage(meshlet_buffer_, meshlets_.size() * sizeof(gpu_meshlet), meshlets_.data());
+
+  const std::vector<uint32_t> hidden(instances_.size(), 0);
+  upload_storage(visibility_buffer_, hidden.size() * sizeof(uint32_t), hidden.data());
+  upload_storage(command_buffer_, 2 * static_cast<size_t>(command_capacity_) * sizeof(draw_command), nullptr);
+  const uint32_t counters[counter_count] = {};
+  upload_storage(counter_buffer_, sizeof(counters), counters);
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+}
+
+void gpu_culler::cull(const shader &program, const gpu_cull_phase phase, const glm::mat4 &view_projection,
+                      const hiz_pyramid *pyramid) {
+  if (instances_.empty()) return;
+
+  if (phase == gpu_cull_phase::early) {
+    const uint32_t counters[counter_count] = {};
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, counter_buffer_);
+    glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(counters), counters);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+  }
+
+  program.use();
+  const frustum planes = extract_frustum(view_projection);
+  glUniform4fv(glGetUniformLocation(program.getID(), "planes"), 6, &planes.planes[0][0]);
+  program.setMat4("viewProjection", view_projection);
+  program.setBool("late", phase == gpu_cull_phase::late);
+  program.setInt("instanceCount", static_cast<int32_t>(instances_.size()));
+  program.setInt("commandCapacity", static_cast<int32_t>(command_capacity_));
+
+  const bool use_pyramid = phase == gpu_cull_phase::late && pyramid != nullptr && pyramid->texture() != 0;
+  program.setBool("useHiz", use_pyramid);
+  program.setInt("hiz", hiz_unit);
+  if (use_pyramid) {
+    glActiveTexture(GL_TEXTURE0 + hiz_unit);
+    glBindTexture(GL_TEXTURE_2D, pyramid->texture());
+    program.setVec2("hizSize", static_cast<float>(pyramid->width()), static_cast<float>(pyramid->height()));
+    program.setInt("hizLevels", pyramid->levels());
+  }
+
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER, instance_binding, instance_buffer_);
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER, mesh_binding, mesh_buffer_);
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER, meshlet_binding, meshlet_buffer_);
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER, visibility_binding, visibility_buffer_);
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER, command_binding, command_buffer_);
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER, counter_binding, counter_buffer_);
+  glDispatchCompute((static_cast<GLuint>(instances_.size()) + group_size - 1) / group_size, 1, 1);
+  // The commands and counts are read by draw(), the visibility by the next cull().
+  glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_SHADER_STORAGE_BARRIER_BIT);
+
+  if (use_pyramid) glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+void gpu_culler::draw(const gpu_cull_phase phase) const {
+  if (instances_.empty()) return;
+
+  const size_t offset = phase == gpu_cull_phase::late ? 1 : 0;
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER, instance_binding, instance_buffer_);
+  glBindBuffer(GL_DRAW_INDIRECT_BUFFER, command_buffer_);
+  glBindBuffer(GL_PARAMETER_BUFFER, counter_buffer_);
+  glMultiDrawElementsIndirectCount(
+      GL_TRIANGLES, GL_UNSIGNED_INT, reinterpret_cast<void *>(offset * command_capacity_ * sizeof(draw_command)),
+      static_cast<GLintptr>(offset * sizeof(uint32_t)), static_cast<GLsizei>(command_capacity_), 0);
+  glBindBuffer(GL_PARAMETER_BUFFER, 0);
+  glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+}
+
+void gpu_culler::bind_draws() const {
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER, instance_binding, instance_buffer_);
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER, command_binding, command_buffer_);
+}
+
+gpu_cull_stats gpu_culler::stats() const {
+  gpu_cull_stats result;
+  result.instances = instances_.size();
+  result.meshlets = command_capacity_;
+  if (instances_.empty()) return result;
+
+  uint32_t counters[counter_count] = {};
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, counter_buffer_);
+  glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(counters), counters);
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+  result.early_draws = counters[early_draws];
+  result.late_draws = counters[late_draws];
+  result.outside = counters[outside];
+  result.occluded_instances = counters[occluded_instances];
+  result.occluded_meshlets = counters[occluded_meshlets];
+  return result;
+}
+
+void gpu_culler::print_stats(std::ostream &out) const {
+  const gpu_cull_stats current = stats();
+  out << "gpu culling: " << current.early_draws << " early and "
+      << current.late_draws << " late meshlet draws of " << current.meshlets << "; " << current.outside
+      << " instances outside the frustum and " << current.occluded_instances << " occluded of " << current.instances
+      << ", " << current.occluded_meshlets << " meshlets occluded" << std::endl;
+}
@@ -0,0 +1,145 @@
+#ifndef GPU_CULLER_H
+#define GPU_CULLER_H
+
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <iosfwd>
+#include <vector>
+
+class hiz_pyramid;
+class shader;
+
+enum class gpu_cull_phase : uint8_t { early, late };
+
+struct gpu_cull_stats {
+  size_t instances = 0;
+  size_t meshlets = 0;  // over all instances
+  // Of the last frame culled.
+  uint32_t early_draws = 0;  // meshlets of the instances visible the frame before
+  uint32_t late_draws = 0;  // meshlets of the instances found visible since
+  uint32_t outside = 0;  // instances outside the frustum
+  uint32_t occluded_instances = 0;
+  uint32_t occluded_meshlets = 0;  // of the instances that were not
+};
+
+// Frustum and occlusion culling of many static instances on the GPU, in two phases so nothing pops:
+//
+//  - The early phase draws the instances that were visible last frame and are still in the
+//    frustum, untested for occlusion.
+//  - The caller then builds a hiz_pyramid from the depth so far, which holds those instances and
+//    whatever else it has drawn.
+//  - The late phase tests every instance in the frustum against the pyramid, remembers the result
+//    for the next frame's early phase, and draws the ones that were not drawn early.
+//
+// An instance hidden last frame that comes into view is therefore drawn in the same frame, and one
+// that was visible is never held back by a stale pyramid. Meshes are split into meshlets of up to
+// meshlet_triangles triangles with their own bounds; an instance that passes is drawn meshlet by
+// meshlet, skipping the ones outside the frustum and, in the late phase, the hidden ones.
+//
+// Each cull() is one compute dispatch with a thread per instance. It writes a DrawElementsIndirect
+// command per meshlet it keeps, compacted with an atomic counter, and draw() issues them all with
+// one glMultiDrawElementsIndirectCount. Every command draws one instance whose gl_BaseInstance is
+// the instance's index; the vertex shader looks the instance up in the storage block at binding
+// `instance_binding`:
+//
+//   struct Instance { mat4 model; vec4 boundsMin; vec4 boundsMax; uint mesh; uint user; uint pad0; uint pad1; };
+//
+// All member functions must be called on the thread that owns the GL context; culling needs GL 4.6.
+class gpu_culler {
+ public:
+  static constexpr uint32_t meshlet_triangles = 64;
+  static constexpr uint32_t instance_binding = 1;
+  static constexpr uint32_t command_binding = 5;
+
+  gpu_culler();
+  gpu_culler(const gpu_culler &) = delete;
+  gpu_culler &operator=(const gpu_culler &) = delete;
+
+  ~gpu_culler();
+
+  // Splits a mesh into runs of up to meshlet_triangles consecutive triangles and returns its id.
+  // Its positions are `stride` bytes apart; in the index buffer the draws use, its indices start at
+  // `first_index` and are offset by `base_vertex`.
+  uint32_t add_mesh(const glm::vec3 *positions, size_t stride, const uint32_t *indices, size_t index_count,
+                    uint32_t first_index, int32_t base_vertex);
+
+  // Places mesh `mesh`, whose world bounds are `min` to `max`, and returns the instance's index.
+  // `user` is passed through to the vertex shader.
+  uint32_t add_instance(uint32_t mesh, const glm::mat4 &model, const glm::vec3 &min, const glm::vec3 &max,
+                        uint32_t user);
+
+  void clear();
+
+  // Uploads what has been added; every instance starts out hidden, so the first frame draws
+  // everything in its late phase.
+  void upload();
+
+  // Writes the draws of `phase` with `program`, the cull compute program. The late phase tests
+  // against `pyramid`, which must have been built from the depth after the early phase's draw().
+  void cull(const shader &program, gpu_cull_phase phase, const glm::mat4 &view_projection,
+            const hiz_pyramid *pyramid = nullptr);
+
+  // Issues the draws the last cull() of `phase` wrote. The caller binds the vertex array holding
+  // the meshes and the program to draw with.
+  void draw(gpu_cull_phase phase) const;
+
+  // The commands of both phases share one buffer, the early phase's first; this is where `phase`'s
+  // start, so a draw's gl_DrawID plus it indexes the buffer.
+  [[nodiscard]] uint32_t first_command(gpu_cull_phase phase) const {
+    return phase == gpu_cull_phase::late ? command_capacity_ : 0;
+  }
+
+  // Binds the instances and the commands of both phases, as five-word DrawElementsIndirect
+  // structs, to the storage blocks at instance_binding and command_binding, for programs that look
+  // up what a draw drew after the fact.
+  void bind_draws() const;
+
+  [[nodiscard]] bool empty() const { return instances_.empty(); }
+
+  // Reads the counters of the last frame back, which waits for the GPU to finish it.
+  [[nodiscard]] gpu_cull_stats stats() const;
+  void print_stats(std::ostream &out) const;
+
+ private:
+  // std430 layouts of the cull shader's storage blocks.
+  struct gpu_instance {
+    glm::mat4 model;
+    glm::vec4 min;  // world bounds, w unused
+    glm::vec4 max;
+    uint32_t mesh;
+    uint32_t user;
+    uint32_t padding[2];
+  };
+  static_assert(sizeof(gpu_instance) == 112, "instances must match the cull shader");
+
+  struct gpu_mesh {
+    uint32_t first_meshlet;
+    uint32_t meshlet_count;
+  };
+
+  struct gpu_meshlet {
+    glm::vec4 min;  // bounds in the mesh's space, w unused
+    glm::vec4 max;
+    uint32_t index_count;
+    uint32_t first_index;
+    int32_t base_vertex;
+    uint32_t padding;
+  };
+  static_assert(sizeof(gpu_meshlet) == 48, "meshlets must match the cull shader");
+
+  std::vector<gpu_instance> instances_;
+  std::vector<gpu_mesh> meshes_;
+  std::vector<gpu_meshlet> meshlets_;
+  uint32_t command_capacity_ = 0;  // per phase, the meshlets over all instances
+
+  uint32_t instance_buffer_ = 0;
+  uint32_t mesh_buffer_ = 0;
+  uint32_t meshlet_buffer_ = 0;
+  uint32_t visibility_buffer_ = 0;  // by instance, whether the last late phase found it visible
+  uint32_t command_buffer_ = 0;  // the early phase's commands, then the late phase's
+  uint32_t counter_buffer_ = 0;  // the draw counts of both phases, then the culling counts
+};
+
+#endif  // GPU_CULLER_H
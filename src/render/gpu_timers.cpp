@@ -0,0 +1,71 @@
+#include "gpu_timers.h"
+
+#include <glad/glad.h>
+
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+
+namespace {
+
+// Weight of the newest frame in the running average.
+constexpr double smoothing = 0.1;
+
+}  // namespace
+
+gpu_timers::gpu_timers(const uint32_t frames_in_flight) : frames_in_flight_(std::max(frames_in_flight, 2u)) {}
+
+gpu_timers::~gpu_timers() {
+  for (pass &timed : passes_) glDeleteQueries(static_cast<GLsizei>(timed.queries.size()), timed.queries.data());
+}
+
+uint32_t gpu_timers::add(const std::string &name) {
+  pass &timed = passes_.emplace_back();
+  timed.name = name;
+  timed.queries.resize(frames_in_flight_);
+  timed.issued.assign(frames_in_flight_, 0);
+  glGenQueries(static_cast<GLsizei>(frames_in_flight_), timed.queries.data());
+  return static_cast<uint32_t>(passes_.size() - 1);
+}
+
+void gpu_timers::begin(const uint32_t pass) {
+  running_ = pass;
+  passes_[pass].issued[slot_] = 1;
+  glBeginQuery(GL_TIME_ELAPSED, passes_[pass].queries[slot_]);
+}
+
+void gpu_timers::end() {
+  if (running_ == no_pass) return;
+  glEndQuery(GL_TIME_ELAPSED);
+  running_ = no_pass;
+}
+
+void gpu_timers::end_frame() {
+  slot_ = (slot_ + 1) % frames_in_flight_;
+  for (pass &timed : passes_) {
+    timed.recent = timed.issued[slot_] != 0;
+    if (!timed.recent) continue;
+    timed.issued[slot_] = 0;
+
+    // Only a GPU more than frames_in_flight frames behind leaves it unfinished; skip it then.
+    GLuint available = GL_FALSE;
+    glGetQueryObjectuiv(timed.queries[slot_], GL_QUERY_RESULT_AVAILABLE, &available);
+    if (available == GL_FALSE) continue;
+    GLuint64 nanoseconds = 0;
+    glGetQueryObjectui64v(timed.queries[slot_], GL_QUERY_RESULT, &nanoseconds);
+
+    timed.last_ms = static_cast<double>(nanoseconds) / 1e6;
+    timed.average_ms = timed.samples == 0 ? timed.last_ms
+                                          : timed.average_ms + smoothing * (timed.last_ms - timed.average_ms);
+    ++timed.samples;
+  }
+}
+
+void gpu_timers::print_stats(std::ostream &out) const {
+  out << std::fixed << std::setprecision(3) << "gpu time:";
+  for (const pass &timed : passes_) {
+    if (!timed.recent || timed.samples == 0) continue;
+    out << " " << timed.name << " " << timed.average_ms << " ms;";
+  }
+  out << std::endl;
+}
@@ -0,0 +1,57 @@
+#ifndef GPU_TIMERS_H
+#define GPU_TIMERS_H
+
+#include <cstddef>
+#include <cstdint>
+#include <iosfwd>
+#include <string>
+#include <vector>
+
+// GPU time spent in named passes of the frame, measured with GL_TIME_ELAPSED queries. Each frame
+// has its own set of queries and a result is only read once the frame `frames_in_flight` later
+// reuses them, by which time the GPU has long finished, so timing never stalls the CPU.
+//
+// Elapsed-time queries cannot nest: end() the pass being timed before begin()ning the next. A pass
+// that stops being timed keeps its last average but is left out of print_stats(). All member
+// functions must be called on the thread that owns the GL context.
+class gpu_timers {
+ public:
+  explicit gpu_timers(uint32_t frames_in_flight = 4);
+  gpu_timers(const gpu_timers &) = delete;
+  gpu_timers &operator=(const gpu_timers &) = delete;
+
+  ~gpu_timers();
+
+  // Returns the pass's id for begin().
+  uint32_t add(const std::string &name);
+
+  void begin(uint32_t pass);
+  void end();
+
+  // Moves on to the next frame's queries, reading back the results they held.
+  void end_frame();
+
+  // Averaged over recent frames; 0 before the first result.
+  [[nodiscard]] double milliseconds(const uint32_t pass) const { return passes_[pass].average_ms; }
+  void print_stats(std::ostream &out) const;
+
+ private:
+  static constexpr uint32_t no_pass = ~0u;
+
+  struct pass {
+    std::string name;
+    std::vector<uint32_t> queries;  // by frame slot
+    std::vector<uint8_t> issued;
+    double last_ms = 0.0;
+    double average_ms = 0.0;
+    uint32_t samples = 0;
+    bool recent = false;  // timed on the frame read back last
+  };
+
+  uint32_t frames_in_flight_;
+  uint32_t slot_ = 0;
+  uint32_t running_ = no_pass;
+  std::vector<pass> passes_;
+};
+
+#endif  // GPU_TIMERS_H
@@ -0,0 +1,84 @@
+#include "hiz_pyramid.h"
+
+#include <glad/glad.h>
+
+#include <algorithm>
+
+#include "../shader/shader.h"
+
+namespace {
+
+constexpr GLuint depth_unit = 0;
+constexpr GLuint source_image = 0;
+constexpr GLuint destination_image = 1;
+constexpr int32_t group_size = 8;  // local_size_x and _y of hiz_reduce.comp
+
+int32_t previous_power_of_two(const int32_t value) {
+  int32_t result = 1;
+  while (result * 2 <= value) result *= 2;
+  return result;
+}
+
+}  // namespace
+
+hiz_pyramid::~hiz_pyramid() {
+  if (texture_ != 0) glDeleteTextures(1, &texture_);
+}
+
+void hiz_pyramid::resize(const int32_t width, const int32_t height) {
+  if (width == width_ && height == height_) return;
+
+  width_ = width;
+  height_ = height;
+  levels_ = 1;
+  while ((std::max(width, height) >> levels_) > 0) ++levels_;
+
+  // Immutable storage, so a new size needs a new texture.
+  if (texture_ != 0) glDeleteTextures(1, &texture_);
+  glGenTextures(1, &texture_);
+  glBindTexture(GL_TEXTURE_2D, texture_);
+  glTexStorage2D(GL_TEXTURE_2D, levels_, GL_R32F, width, height);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+  glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+void hiz_pyramid::build(const shader &reduce, const uint32_t depth_texture, const int32_t width,
+                        const int32_t height) {
+  resize(previous_power_of_two(std::max(width, 1)), previous_power_of_two(std::max(height, 1)));
+
+  reduce.use();
+  reduce.setInt("depthBuffer", depth_unit);
+  glActiveTexture(GL_TEXTURE0 + depth_unit);
+  glBindTexture(GL_TEXTURE_2D, depth_texture);
+
+  const GLint from_depth = glGetUniformLocation(reduce.getID(), "fromDepth");
+  const GLint source_size = glGetUniformLocation(reduce.getID(), "sourceSize");
+  const GLint destination_size = glGetUniformLocation(reduce.getID(), "destinationSize");
+
+  int32_t source_width = width, source_height = height;
+  for (int32_t level = 0; level < levels_; ++level) {
+    const int32_t level_width = std::max(1, width_ >> level);
+    const int32_t level_height = std::max(1, height_ >> level);
+
+    // Level 0 reads the depth texture instead; the image is bound only so every unit has one.
+    glBindImageTexture(source_image, texture_, std::max(level - 1, 0), GL_FALSE, 0, GL_READ_ONLY, GL_R32F);
+    glBindImageTexture(destination_image, texture_, level, GL_FALSE, 0, GL_WRITE_ONLY, GL_R32F);
+    glUniform1i(from_depth, level == 0);
+    glUniform2i(source_size, source_width, source_height);
+    glUniform2i(destination_size, level_width, level_height);
+    glDispatchCompute(static_cast<GLuint>((level_width + group_size - 1) / group_size),
+                      static_cast<GLuint>((level_height + group_size - 1) / group_size), 1);
+    glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+
+    source_width = level_width;
+    source_height = level_height;
+  }
+
+  glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+  glBindImageTexture(source_image, 0, 0, GL_FALSE, 0, GL_READ_ONLY, GL_R32F);
+  glBindImageTexture(destination_image, 0, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_R32F);
+  glBindTexture(GL_TEXTURE_2D, 0);
+}
@@ -0,0 +1,44 @@
+#ifndef HIZ_PYRAMID_H
+#define HIZ_PYRAMID_H
+
+#include <cstdint>
+
+class shader;
+
+// A hierarchical depth pyramid for occlusion tests on the GPU. Level 0 is the largest power of two
+// no bigger than the depth buffer on each side, and each of its texels keeps the farthest depth of
+// the depth buffer's texels it overlaps; every further level keeps the farthest of the 2x2 texels
+// under it. A box whose nearest depth is beyond the farthest over its screen rectangle is hidden,
+// and at the level where that rectangle is at most a texel or two across it takes four fetches.
+//
+// The pyramid is an R32F texture with its full mip chain, built by the hiz_reduce compute program
+// one level per dispatch.
+//
+// All member functions must be called on the thread that owns the GL context; building needs GL 4.3.
+class hiz_pyramid {
+ public:
+  hiz_pyramid() = default;
+  hiz_pyramid(const hiz_pyramid &) = delete;
+  hiz_pyramid &operator=(const hiz_pyramid &) = delete;
+
+  ~hiz_pyramid();
+
+  // Reduces `depth_texture`, `width` by `height` texels of depth in [0, 1], with `reduce`. The result
+  // is ready for texelFetch in later dispatches and draws.
+  void build(const shader &reduce, uint32_t depth_texture, int32_t width, int32_t height);
+
+  [[nodiscard]] uint32_t texture() const { return texture_; }
+  [[nodiscard]] int32_t width() const { return width_; }  // of level 0
+  [[nodiscard]] int32_t height() const { return height_; }
+  [[nodiscard]] int32_t levels() const { return levels_; }
+
+ private:
+  void resize(int32_t width, int32_t height);
+
+  uint32_t texture_ = 0;
+  int32_t width_ = 0;
+  int32_t height_ = 0;
+  int32_t levels_ = 0;
+};
+
+#endif  // HIZ_PYRAMID_H
@@ -0,0 +1,247 @@
+#include "light_grid.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+
+#include "../utility/simd.h"
+#include "../utility/thread_pool.h"
+
+namespace {
+
+using clock_type = std::chrono::steady_clock;
+
+// Columns tested together; rows of column bounds are padded to a multiple of it.
+constexpr int32_t column_batch = 8;
+
+// Lights assigned together by one parallel task.
+constexpr size_t lights_per_run = 256;
+
+// Padding columns: a box this far away never reaches a light.
+constexpr float never_touched = std::numeric_limits<float>::max();
+
+// The distance from `value` to [min, max], 0 inside it.
+float outside(const float value, const float min, const float max) {
+  return std::max(std::max(min - value, value - max), 0.0f);
+}
+
+}  // namespace
+
+light_grid::light_grid(const light_grid_settings &config) : config_(config) {
+  config_.tiles_x = std::max(config_.tiles_x, 1);
+  config_.tiles_y = std::max(config_.tiles_y, 1);
+  config_.slices = std::max(config_.slices, 1);
+  ranges_.assign(static_cast<size_t>(config_.tiles_x) * config_.tiles_y * config_.slices, glm::uvec2(0));
+}
+
+void light_grid::set_projection(const float fov_y, const float aspect, const float z_near, const float z_far) {
+  if (fov_y == fov_y_ && aspect == aspect_ && z_near == z_near_ && z_far == z_far_) return;
+  fov_y_ = fov_y, aspect_ = aspect, z_near_ = z_near, z_far_ = z_far;
+  tan_half_y_ = std::tan(fov_y / 2.0f);
+  tan_half_x_ = tan_half_y_ * aspect;
+
+  const float depth_ratio = std::log(z_far / z_near);
+  slice_scale_ = static_cast<float>(config_.slices) / depth_ratio;
+  slice_bias_ = static_cast<float>(config_.slices) * std::log(z_near) / depth_ratio;
+  slice_near_.resize(config_.slices + 1);
+  for (int32_t slice = 0; slice <= config_.slices; ++slice) {
+    slice_near_[slice] = z_near * std::pow(z_far / z_near, static_cast<float>(slice) / config_.slices);
+  }
+  slice_near_.back() = z_far;
+
+  // Across a tile the frustum's x grows with depth, so its box takes the widest of both ends.
+  const auto tile_bounds = [](const int32_t tile, const int32_t tiles, const float tan_half, const float near_depth,
+                              const float far_depth, float &min, float &max) {
+    const float ndc_min = -1.0f + 2.0f * static_cast<float>(tile) / tiles;
+    const float ndc_max = -1.0f + 2.0f * static_cast<float>(tile + 1) / tiles;
+    min = std::min(ndc_min * near_depth, ndc_min * far_depth) * tan_half;
+    max = std::max(ndc_max * near_depth, ndc_max * far_depth) * tan_half;
+  };
+  row_stride_ = (config_.tiles_x + column_batch - 1) / column_batch * column_batch;
+  column_min_.assign(row_stride_ * config_.slices, never_touched);
+  column_max_.assign(row_stride_ * config_.slices, never_touched);
+  row_min_.resize(static_cast<size_t>(config_.tiles_y) * config_.slices);
+  row_max_.resize(row_min_.size());
+  for (int32_t slice = 0; slice < config_.slices; ++slice) {
+    const float near_depth = slice_near_[slice], far_depth = slice_near_[slice + 1];
+    for (int32_t x = 0; x < config_.tiles_x; ++x) {
+      const size_t column = slice * row_stride_ + x;
+      tile_bounds(x, config_.tiles_x, tan_half_x_, near_depth, far_depth, column_min_[column], column_max_[column]);
+    }
+    for (int32_t y = 0; y < config_.tiles_y; ++y) {
+      const size_t row = static_cast<size_t>(slice) * config_.tiles_y + y;
+      tile_bounds(y, config_.tiles_y, tan_half_y_, near_depth, far_depth, row_min_[row], row_max_[row]);
+    }
+  }
+}
+
+int32_t light_grid::slice_of(const float depth) const {
+  if (depth < z_near_ || depth > z_far_) return -1;
+  const float slice = std::floor(std::log(depth) * slice_scale_ - slice_bias_);
+  return std::clamp(static_cast<int32_t>(slice), 0, config_.slices - 1);
+}
+
+void light_grid::cluster_bounds(const int32_t x, const int32_t y, const int32_t slice, glm::vec3 &min,
+                                glm::vec3 &max) const {
+  const size_t column = slice * row_stride_ + x, row = static_cast<size_t>(slice) * config_.tiles_y + y;
+  min = glm::vec3(column_min_[column], row_min_[row], -slice_near_[slice + 1]);
+  max = glm::vec3(column_max_[column], row_max_[row], -slice_near_[slice]);
+}
+
+void light_grid::gather(const std::vector<point_light> &lights, const glm::mat4 &view, const size_t begin,
+                        const size_t end, std::vector<uint64_t> &pairs) const {
+  for (size_t i = begin; i < end; ++i) {
+    const glm::vec3 centre = glm::vec3(view * glm::vec4(lights[i].position, 1.0f));
+    const float radius = lights[i].radius, depth = -centre.z;
+    if (radius <= 0.0f || depth + radius < z_near_ || depth - radius > z_far_) continue;
+
+    // The sphere lies within its depth range and, over it, within the columns and rows its extent
+    // projects to at either end.
+    const float near_depth = std::max(depth - radius, z_near_), far_depth = std::min(depth + radius, z_far_);
+    const auto tile_range = [&](const float offset, const float tan_half, const int32_t tiles, int32_t &first,
+                                int32_t &last) {
+      float min = std::numeric_limits<float>::max(), max = -min;
+      for (const float d : {near_depth, far_depth}) {
+        for (const float v : {offset - radius, offset + radius}) {
+          min = std::min(min, v / (d * tan_half));
+          max = std::max(max, v / (d * tan_half));
+        }
+      }
+      if (max < -1.0f || min > 1.0f) return false;
+      first = std::clamp(static_cast<int32_t>(std::floor((min + 1.0f) * 0.5f * tiles)), 0, tiles - 1);
+      last = std::clamp(static_cast<int32_t>(std::floor((max + 1.0f) * 0.5f * tiles)), 0, tiles - 1);
+      return true;
+    };
+    int32_t first_x = 0, last_x = 0, first_y = 0, last_y = 0;
+    if (!tile_range(centre.x, tan_half_x_, config_.tiles_x, first_x, last_x) ||
+        !tile_range(centre.y, tan_half_y_, config_.tiles_y, first_y, last_y)) {
+      continue;
+    }
+    const int32_t first_slice = slice_of(near_depth), last_slice = slice_of(far_depth);
+    const uint64_t light = i;
+
+    for (int32_t slice = first_slice; slice <= last_slice; ++slice) {
+      const float dz = outside(depth, slice_near_[slice], slice_near_[slice + 1]);
+      const float slice_left = radius * radius - dz * dz;
+      if (slice_left < 0.0f) continue;
+      const float *column_min = column_min_.data() + slice * row_stride_;
+      const float *column_max = column_max_.data() + slice * row_stride_;
+
+      for (int32_t y = first_y; y <= last_y; ++y) {
+        const size_t row = static_cast<size_t>(slice) * config_.tiles_y + y;
+        const float dy = outside(centre.y, row_min_[row], row_max_[row]);
+        const float left = slice_left - dy * dy;
+        if (left < 0.0f) continue;
+
+        // Batches start on a multiple of column_batch, so they never read past the padded row;
+        // the lanes outside [first_x, last_x] are masked off.
+        const uint64_t row_start = cluster_index(0, y, slice);
+        const auto append = [&](const int32_t x, int32_t mask) {
+          if (x < first_x) mask &= ~((1 << (first_x - x)) - 1);
+          if (last_x - x < column_batch - 1) mask &= (1 << (last_x - x + 1)) - 1;
+          for (int32_t lane = 0; mask != 0; ++lane, mask >>= 1) {
+            if ((mask & 1) != 0) pairs.push_back((row_start + x + lane) << 32 | light);
+          }
+        };
+#if defined(ENGINE_SIMD_AVX2)
+        const __m256 cx = _mm256_set1_ps(centre.x), limit = _mm256_set1_ps(left);
+        for (int32_t x = first_x & ~(column_batch - 1); x <= last_x; x += column_batch) {
+          const __m256 min = _mm256_loadu_ps(column_min + x), max = _mm256_loadu_ps(column_max + x);
+          const __m256 dx = _mm256_max_ps(_mm256_max_ps(_mm256_sub_ps(min, cx), _mm256_sub_ps(cx, max)),
+                                          _mm256_setzero_ps());
+          append(x, _mm256_movemask_ps(_mm256_cmp_ps(_mm256_mul_ps(dx, dx), limit, _CMP_LE_OQ)));
+        }
+#elif defined(ENGINE_SIMD_SSE2)
+        const __m128 cx = _mm_set1_ps(centre.x), limit = _mm_set1_ps(left);
+        const auto half_mask = [&](const int32_t x) {
+          const __m128 min = _mm_loadu_ps(column_min + x), max = _mm_loadu_ps(column_max + x);
+          const __m128 dx = _mm_max_ps(_mm_max_ps(_mm_sub_ps(min, cx), _mm_sub_ps(cx, max)), _mm_setzero_ps());
+          return _mm_movemask_ps(_mm_cmple_ps(_mm_mul_ps(dx, dx), limit));
+        };
+        for (int32_t x = first_x & ~(column_batch - 1); x <= last_x; x += column_batch) {
+          append(x, half_mask(x) | half_mask(x + 4) << 4);
+        }
+#else
+        for (int32_t x = first_x & ~(column_batch - 1); x <= last_x; x += column_batch) {
+          int32_t mask = 0;
+          for (int32_t lane = 0; lane < column_batch; ++lane) {
+            const float dx = outside(centre.x, column_min[x + lane], column_max[x + lane]);
+            mask |= dx * dx <= left ? 1 << lane : 0;
+          }
+          append(x, mask);
+        }
+#endif
+      }
+    }
+  }
+}
+
+void light_grid::assign(const std::vector<point_light> &lights, const glm::mat4 &view) {
+  const auto start = clock_type::now();
+  runs_.resize(1);
+  runs_[0].clear();
+  gather(lights, view, 0, lights.size(), runs_[0]);
+  build(runs_, lights.size());
+  stats_.assign_ms = std::chrono::duration<double, std::milli>(clock_type::now() - start).count();
+}
+
+void light_grid::assign(const std::vector<point_light> &lights, const glm::mat4 &view, thread_pool &pool) {
+  const auto start = clock_type::now();
+  const size_t run_count = (lights.size() + lights_per_run - 1) / lights_per_run;
+  runs_.resize(std::max<size_t>(run_count, 1));
+  for (std::vector<uint64_t> &run : runs_) run.clear();
+  pool.parallel_for(0, run_count, [&](const size_t run) {
+    const size_t begin = run * lights_per_run;
+    gather(lights, view, begin, std::min(begin + lights_per_run, lights.size()), runs_[run]);
+  });
+  build(runs_, lights.size());
+  stats_.assign_ms = std::chrono::duration<double, std::milli>(clock_type::now() - start).count();
+}
+
+void light_grid::build(const std::vector<std::vector<uint64_t>> &runs, const size_t light_count) {
+  // Runs hold increasing lights, so placing their pairs in order keeps every cluster's lights sorted.
+  counts_.assign(ranges_.size(), 0);
+  size_t references = 0;
+  size_t lights_in_view = 0;
+  uint64_t last_light = std::numeric_limits<uint64_t>::max();
+  for (const std::vector<uint64_t> &run : runs) {
+    references += run.size();
+    for (const uint64_t pair : run) {
+      ++counts_[pair >> 32];
+      const uint64_t light = pair & 0xffffffffu;
+      lights_in_view += light != last_light;
+      last_light = light;
+    }
+  }
+
+  stats_ = {};
+  uint32_t offset = 0;
+  for (size_t cluster = 0; cluster < ranges_.size(); ++cluster) {
+    ranges_[cluster] = glm::uvec2(offset, 0);
+    offset += counts_[cluster];
+    stats_.lit_clusters += counts_[cluster] != 0;
+    stats_.max_per_cluster = std::max(stats_.max_per_cluster, counts_[cluster]);
+  }
+  indices_.resize(references);
+  for (const std::vector<uint64_t> &run : runs) {
+    for (const uint64_t pair : run) {
+      glm::uvec2 &range = ranges_[pair >> 32];
+      indices_[range.x + range.y++] = static_cast<uint32_t>(pair & 0xffffffffu);
+    }
+  }
+
+  stats_.lights = light_count;
+  stats_.lights_in_view = lights_in_view;
+  stats_.references = references;
+}
+
+void light_grid::print_stats(std::ostream &out) const {
+  out << std::fixed << std::setprecision(2) << "light grid " << config_.tiles_x << "x" << config_.tiles_y << "x"
+      << config_.slices << " (" << simd_instruction_set_name() << "): " << stats_.lights << " lights, "
+      << stats_.lights_in_view << " in view, " << stats_.references << " references over " << stats_.lit_clusters
+      << " of " << ranges_.size() << " clusters, at most " << stats_.max_per_cluster << " in one, assigned in "
+      << stats_.assign_ms << " ms" << std::endl;
+}
@@ -0,0 +1,113 @@
+#ifndef LIGHT_GRID_H
+#define LIGHT_GRID_H
+
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <iosfwd>
+#include <vector>
+
+class thread_pool;
+
+// Laid out as the clustered shaders' PointLight storage block reads it (std430).
+struct point_light {
+  glm::vec3 position = glm::vec3(0.0f);  // world space
+  float radius = 1.0f;  // the light falls off to nothing here
+  glm::vec3 colour = glm::vec3(1.0f);
+  float intensity = 1.0f;
+};
+static_assert(sizeof(point_light) == 32, "point lights must match the clustered shaders");
+
+struct light_grid_settings {
+  int32_t tiles_x = 16;
+  int32_t tiles_y = 9;
+  int32_t slices = 24;  // spaced exponentially in depth, so clusters are roughly cubic
+};
+
+struct light_grid_stats {
+  // Of the last assign().
+  size_t lights = 0;
+  size_t lights_in_view = 0;  // touching at least one cluster
+  size_t references = 0;  // light indices over all clusters
+  size_t lit_clusters = 0;  // with at least one light
+  uint32_t max_per_cluster = 0;
+  double assign_ms = 0.0;
+};
+
+// Clustered forward shading's light assignment (Olsson et al.): the view frustum is cut into a grid
+// of tiles_x by tiles_y screen tiles and `slices` depth slices, and every cluster gets the list of
+// point lights whose sphere of influence touches it, so a fragment only loops over the lights of
+// its own cluster rather than all of them.
+//
+// assign() runs on the CPU. Each light is transformed into view space, its sphere's depth and
+// projected extent give the range of clusters it may touch, and the sphere is then tested against
+// the view-space bounding box of each of them. The box's squared distance splits into a part from
+// the slice, one from the tile row and one from the column, so a whole row of columns is tested at
+// once: eight clusters per instruction with AVX2 and four with SSE2. The pool version assigns runs
+// of lights in parallel. The (cluster, light) pairs are then counting-sorted into per-cluster
+// ranges of one index list, each cluster's lights in increasing order.
+//
+// Clusters are numbered x + tiles_x * (y + tiles_y * slice), with tile (0, 0) at the bottom left
+// of the viewport like gl_FragCoord.
+class light_grid {
+ public:
+  explicit light_grid(const light_grid_settings &config = {});
+
+  // Sets the frustum the clusters cut up, as glm::perspective() takes it; the cluster bounds are
+  // only rebuilt when it changes.
+  void set_projection(float fov_y, float aspect, float z_near, float z_far);
+
+  void assign(const std::vector<point_light> &lights, const glm::mat4 &view);
+  void assign(const std::vector<point_light> &lights, const glm::mat4 &view, thread_pool &pool);
+
+  [[nodiscard]] const light_grid_settings &settings() const { return config_; }
+  [[nodiscard]] size_t cluster_count() const { return ranges_.size(); }
+  [[nodiscard]] uint32_t cluster_index(const int32_t x, const int32_t y, const int32_t slice) const {
+    return static_cast<uint32_t>(x + config_.tiles_x * (y + config_.tiles_y * slice));
+  }
+  // The slice of a point `depth` in front of the camera, or -1 outside the depth range.
+  [[nodiscard]] int32_t slice_of(float depth) const;
+
+  // By cluster, the first entry of its lights in light_indices() and how many there are.
+  [[nodiscard]] const std::vector<glm::uvec2> &light_ranges() const { return ranges_; }
+  [[nodiscard]] const std::vector<uint32_t> &light_indices() const { return indices_; }
+
+  // The shaders find the slice of a fragment at view depth z as floor(log(z) * slice_scale() - slice_bias()).
+  [[nodiscard]] float slice_scale() const { return slice_scale_; }
+  [[nodiscard]] float slice_bias() const { return slice_bias_; }
+  [[nodiscard]] float z_near() const { return z_near_; }
+  [[nodiscard]] float z_far() const { return z_far_; }
+
+  // The view-space bounding box of a cluster.
+  void cluster_bounds(int32_t x, int32_t y, int32_t slice, glm::vec3 &min, glm::vec3 &max) const;
+
+  [[nodiscard]] const light_grid_stats &stats() const { return stats_; }
+  void print_stats(std::ostream &out) const;
+
+ private:
+  // Appends the (cluster, light) pairs of lights [begin, end) to `pairs`, cluster in the high word.
+  void gather(const std::vector<point_light> &lights, const glm::mat4 &view, size_t begin, size_t end,
+              std::vector<uint64_t> &pairs) const;
+  void build(const std::vector<std::vector<uint64_t>> &runs, size_t light_count);
+
+  light_grid_settings config_;
+  float fov_y_ = 0.0f, aspect_ = 0.0f, z_near_ = 0.0f, z_far_ = 0.0f;
+  float tan_half_x_ = 0.0f, tan_half_y_ = 0.0f;  // view-space x and y over depth at the frustum's edges
+  float slice_scale_ = 0.0f, slice_bias_ = 0.0f;
+
+  // Cluster bounds: x and y depend only on the column or row and the slice, depth only on the slice.
+  size_t row_stride_ = 0;  // tiles_x rounded up to a SIMD batch; the padding columns are never touched
+  std::vector<float> column_min_, column_max_;  // by slice * row_stride_ + x
+  std::vector<float> row_min_, row_max_;  // by slice * tiles_y + y
+  std::vector<float> slice_near_;  // depth of each slice boundary, slices + 1 of them
+
+  std::vector<glm::uvec2> ranges_;
+  std::vector<uint32_t> indices_;
+  std::vector<uint32_t> counts_;  // scratch for build()
+  std::vector<std::vector<uint64_t>> runs_;
+
+  light_grid_stats stats_;
+};
+
+#endif  // LIGHT_GRID_H
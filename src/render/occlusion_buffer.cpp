@@ -0,0 +1,394 @@
+#include "occlusion_buffer.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+
+#include "../utility/simd.h"
+#include "../utility/thread_pool.h"
+
+namespace {
+
+using clock_type = std::chrono::steady_clock;
+
+constexpr uint32_t full_mask = 0xffffffffu;
+// Triangles are clipped to this many screens either side, which keeps their edge functions precise.
+constexpr float guard_band = 4.0f;
+// Bins per side when rasterizing on a pool.
+constexpr int32_t bins_per_side = 4;
+
+// Clip-space vertices clipped against the near plane and the guard band: at most one more vertex per
+// plane.
+struct clip_polygon {
+  glm::vec4 vertices[8];
+  int32_t count = 0;
+};
+
+// Distance inside each clipping plane: near (z >= -w), then x and y within the guard band.
+float plane_distance(const glm::vec4 &v, const int32_t plane) {
+  switch (plane) {
+    case 0: return v.z + v.w;
+    case 1: return guard_band * v.w - v.x;
+    case 2: return guard_band * v.w + v.x;
+    case 3: return guard_band * v.w - v.y;
+    default: return guard_band * v.w + v.y;
+  }
+}
+
+// Sutherland-Hodgman against one plane.
+clip_polygon clip_against(const clip_polygon &polygon, const int32_t plane) {
+  clip_polygon clipped;
+  for (int32_t i = 0; i < polygon.count; ++i) {
+    const glm::vec4 &from = polygon.vertices[i];
+    const glm::vec4 &to = polygon.vertices[(i + 1) % polygon.count];
+    const float from_distance = plane_distance(from, plane), to_distance = plane_distance(to, plane);
+    if (from_distance >= 0.0f) clipped.vertices[clipped.count++] = from;
+    if ((from_distance >= 0.0f) != (to_distance >= 0.0f)) {
+      clipped.vertices[clipped.count++] = from + (to - from) * (from_distance / (from_distance - to_distance));
+    }
+  }
+  return clipped;
+}
+
+// The coverage of the subtile whose top-left pixel is (x, y): bit 8 * row + column is set for
+// every pixel centre strictly inside all three edges.
+template <typename triangle_t>
+uint32_t subtile_coverage(const triangle_t &triangle, const int32_t x, const int32_t y) {
+  uint32_t coverage = 0;
+#if defined(ENGINE_SIMD_AVX2)
+  const __m256 xs = _mm256_add_ps(_mm256_set1_ps(static_cast<float>(x)),
+                                  _mm256_setr_ps(0.5f, 1.5f, 2.5f, 3.5f, 4.5f, 5.5f, 6.5f, 7.5f));
+  __m256 a[3];
+  for (int32_t e = 0; e < 3; ++e) a[e] = _mm256_mul_ps(_mm256_set1_ps(triangle.edge_a[e]), xs);
+  for (int32_t row = 0; row < occlusion_buffer::subtile_height; ++row) {
+    const float pixel_y = static_cast<float>(y + row) + 0.5f;
+    __m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+    for (int32_t e = 0; e < 3; ++e) {
+      const __m256 edge = _mm256_add_ps(a[e], _mm256_set1_ps(triangle.edge_b[e] * pixel_y + triangle.edge_c[e]));
+      inside = _mm256_and_ps(inside, _mm256_cmp_ps(edge, _mm256_setzero_ps(), _CMP_GT_OQ));
+    }
+    coverage |= static_cast<uint32_t>(_mm256_movemask_ps(inside)) << (8 * row);
+  }
+#elif defined(ENGINE_SIMD_SSE2)
+  const __m128 base = _mm_set1_ps(static_cast<float>(x));
+  const __m128 xs[2] = {_mm_add_ps(base, _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f)),
+                        _mm_add_ps(base, _mm_setr_ps(4.5f, 5.5f, 6.5f, 7.5f))};
+  for (int32_t row = 0; row < occlusion_buffer::subtile_height; ++row) {
+    const float pixel_y = static_cast<float>(y + row) + 0.5f;
+    for (int32_t half = 0; half < 2; ++half) {
+      __m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+      for (int32_t e = 0; e < 3; ++e) {
+        const __m128 edge = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(triangle.edge_a[e]), xs[half]),
+                                       _mm_set1_ps(triangle.edge_b[e] * pixel_y + triangle.edge_c[e]));
+        inside = _mm_and_ps(inside, _mm_cmpgt_ps(edge, _mm_setzero_ps()));
+      }
+      coverage |= static_cast<uint32_t>(_mm_movemask_ps(inside)) << (8 * row + 4 * half);
+    }
+  }
+#else
+  for (int32_t row = 0; row < occlusion_buffer::subtile_height; ++row) {
+    const float pixel_y = static_cast<float>(y + row) + 0.5f;
+    for (int32_t column = 0; column < occlusion_buffer::subtile_width; ++column) {
+      const float pixel_x = static_cast<float>(x + column) + 0.5f;
+      bool inside = true;
+      for (int32_t e = 0; e < 3; ++e) {
+        inside = inside && triangle.edge_a[e] * pixel_x + (triangle.edge_b[e] * pixel_y + triangle.edge_c[e]) > 0.0f;
+      }
+      coverage |= inside ? 1u << (8 * row + column) : 0u;
+    }
+  }
+#endif
+  return coverage;
+}
+
+// The pixels of a subtile at or past `columns` across and `rows` down.
+uint32_t padding_mask(const int32_t columns, const int32_t rows) {
+  uint32_t mask = 0;
+  for (int32_t row = 0; row < occlusion_buffer::subtile_height; ++row) {
+    for (int32_t column = 0; column < occlusion_buffer::subtile_width; ++column) {
+      if (column >= columns || row >= rows) mask |= 1u << (8 * row + column);
+    }
+  }
+  return mask;
+}
+
+}  // namespace
+
+occlusion_buffer::occlusion_buffer(const int32_t width, const int32_t height) : width_(width), height_(height) {
+  constexpr int32_t tile_width = subtile_width * tile_subtiles;
+  constexpr int32_t tile_height = subtile_height * tile_subtiles;
+  tiles_x_ = (width + tile_width - 1) / tile_width;
+  tiles_y_ = (height + tile_height - 1) / tile_height;
+  subtiles_x_ = tiles_x_ * tile_subtiles;
+  subtiles_y_ = tiles_y_ * tile_subtiles;
+  bins_x_ = std::min(bins_per_side, tiles_x_);
+  bins_y_ = std::min(bins_per_side, tiles_y_);
+
+  const size_t subtiles = static_cast<size_t>(subtiles_x_) * subtiles_y_;
+  depths_.assign(subtiles, 0.0f);
+  layer_depths_.assign(subtiles, 0.0f);
+  layer_masks_.assign(subtiles, 0);
+  tile_depths_.assign(static_cast<size_t>(tiles_x_) * tiles_y_, 0.0f);
+}
+
+void occlusion_buffer::begin_frame(const glm::mat4 &view_projection) {
+  view_projection_ = view_projection;
+  occluders_.clear();
+}
+
+void occlusion_buffer::add_occluder(const glm::vec3 *positions, const size_t stride, const uint32_t *indices,
+                                    const size_t index_count, const glm::mat4 &model) {
+  occluders_.push_back({positions, stride, indices, index_count, view_projection_ * model});
+}
+
+void occlusion_buffer::rasterize() {
+  const auto start = clock_type::now();
+  triangles_.resize(occluders_.size());
+  for (size_t i = 0; i < occluders_.size(); ++i) set_up(occluders_[i], triangles_[i]);
+  for (int32_t bin = 0; bin < bins_x_ * bins_y_; ++bin) rasterize_bin(bin);
+
+  stats_.occluders = occluders_.size();
+  stats_.triangles = 0;
+  for (const auto &triangles : triangles_) stats_.triangles += triangles.size();
+  stats_.rasterize_ms = std::chrono::duration<double, std::milli>(clock_type::now() - start).count();
+}
+
+void occlusion_buffer::rasterize(thread_pool &pool) {
+  const auto start = clock_type::now();
+  triangles_.resize(occluders_.size());
+  pool.parallel_for(0, occluders_.size(), [&](const size_t i) { set_up(occluders_[i], triangles_[i]); }, 4);
+  pool.parallel_for(0, static_cast<size_t>(bins_x_ * bins_y_),
+                    [&](const size_t bin) { rasterize_bin(static_cast<int32_t>(bin)); });
+
+  stats_.occluders = occluders_.size();
+  stats_.triangles = 0;
+  for (const auto &triangles : triangles_) stats_.triangles += triangles.size();
+  stats_.rasterize_ms = std::chrono::duration<double, std::milli>(clock_type::now() - start).count();
+}
+
+void occlusion_buffer::set_up(const occluder &mesh, std::vector<screen_triangle> &triangles) const {
+  triangles.clear();
+  const auto *bytes = reinterpret_cast<const uint8_t *>(mesh.positions);
+  const auto position = [&](const uint32_t index) {
+    return *reinterpret_cast<const glm::vec3 *>(bytes + index * mesh.stride);
+  };
+
+  for (size_t i = 0; i + 2 < mesh.index_count; i += 3) {
+    const glm::vec4 clip[3] = {mesh.transform * glm::vec4(position(mesh.indices[i]), 1.0f),
+                               mesh.transform * glm::vec4(position(mesh.indices[i + 1]), 1.0f),
+                               mesh.transform * glm::vec4(position(mesh.indices[i + 2]), 1.0f)};
+    // Off screen entirely when all three are beyond the same side of the frustum.
+    const auto beyond = [&](const auto &outside) { return outside(clip[0]) && outside(clip[1]) && outside(clip[2]); };
+    if (beyond([](const glm::vec4 &v) { return v.x > v.w; }) || beyond([](const glm::vec4 &v) { return v.x < -v.w; }) ||
+        beyond([](const glm::vec4 &v) { return v.y > v.w; }) || beyond([](const glm::vec4 &v) { return v.y < -v.w; }) ||
+        beyond([](const glm::vec4 &v) { return v.z < -v.w; })) {
+      continue;
+    }
+
+    bool needs_clipping = false;
+    for (const glm::vec4 &v : clip) {
+      for (int32_t plane = 0; plane < 5; ++plane) needs_clipping = needs_clipping || plane_distance(v, plane) < 0.0f;
+    }
+    if (!needs_clipping) {
+      add_triangle(clip, triangles);
+      continue;
+    }
+
+    clip_polygon polygon;
+    polygon.count = 3;
+    std::copy(std::begin(clip), std::end(clip), polygon.vertices);
+    for (int32_t plane = 0; plane < 5 && polygon.count >= 3; ++plane) polygon = clip_against(polygon, plane);
+    for (int32_t v = 1; v + 1 < polygon.count; ++v) {
+      const glm::vec4 fan[3] = {polygon.vertices[0], polygon.vertices[v], polygon.vertices[v + 1]};
+      add_triangle(fan, triangles);
+    }
+  }
+}
+
+void occlusion_buffer::add_triangle(const glm::vec4 (&clip)[3], std::vector<screen_triangle> &triangles) const {
+  glm::vec2 screen[3];
+  float depth[3];
+  for (int32_t v = 0; v < 3; ++v) {
+    depth[v] = 1.0f / clip[v].w;
+    screen[v] = (glm::vec2(clip[v]) * depth[v] * 0.5f + 0.5f) * glm::vec2(width_, height_);
+  }
+
+  // Counter-clockwise with y up is front facing; back faces and slivers are dropped.
+  const glm::vec2 ab = screen[1] - screen[0], ac = screen[2] - screen[0];
+  const float area = ab.x * ac.y - ab.y * ac.x;
+  if (!(area > 0.0f)) return;
+
+  screen_triangle triangle;
+  triangle.min_x = std::max(0, static_cast<int32_t>(std::floor(std::min({screen[0].x, screen[1].x, screen[2].x}))));
+  triangle.min_y = std::max(0, static_cast<int32_t>(std::floor(std::min({screen[0].y, screen[1].y, screen[2].y}))));
+  triangle.max_x =
+      std::min(width_ - 1, static_cast<int32_t>(std::floor(std::max({screen[0].x, screen[1].x, screen[2].x}))));
+  triangle.max_y =
+      std::min(height_ - 1, static_cast<int32_t>(std::floor(std::max({screen[0].y, screen[1].y, screen[2].y}))));
+  if (triangle.min_x > triangle.max_x || triangle.min_y > triangle.max_y) return;
+
+  for (int32_t e = 0; e < 3; ++e) {
+    const glm::vec2 &from = screen[e], &to = screen[(e + 1) % 3];
+    triangle.edge_a[e] = from.y - to.y;
+    triangle.edge_b[e] = to.x - from.x;
+    triangle.edge_c[e] = -(triangle.edge_a[e] * from.x + triangle.edge_b[e] * from.y);
+  }
+
+  // The plane through the three (x, y, depth) points.
+  const float ab_depth = depth[1] - depth[0], ac_depth = depth[2] - depth[0];
+  triangle.depth_x = (ab_depth * ac.y - ac_depth * ab.y) / area;
+  triangle.depth_y = (ac_depth * ab.x - ab_depth * ac.x) / area;
+  triangle.depth_origin = depth[0] - triangle.depth_x * screen[0].x - triangle.depth_y * screen[0].y;
+  triangle.farthest = std::min({depth[0], depth[1], depth[2]});
+  triangles.push_back(triangle);
+}
+
+void occlusion_buffer::rasterize_bin(const int32_t bin) {
+  // Bins are whole tiles, so no two threads touch the same subtile.
+  const int32_t bin_x = bin % bins_x_, bin_y = bin / bins_x_;
+  const int32_t first_tile_x = tiles_x_ * bin_x / bins_x_, last_tile_x = tiles_x_ * (bin_x + 1) / bins_x_ - 1;
+  const int32_t first_tile_y = tiles_y_ * bin_y / bins_y_, last_tile_y = tiles_y_ * (bin_y + 1) / bins_y_ - 1;
+  const int32_t first_x = first_tile_x * tile_subtiles, last_x = (last_tile_x + 1) * tile_subtiles - 1;
+  const int32_t first_y = first_tile_y * tile_subtiles, last_y = (last_tile_y + 1) * tile_subtiles - 1;
+
+  for (int32_t y = first_y; y <= last_y; ++y) {
+    const size_t row = static_cast<size_t>(y) * subtiles_x_;
+    std::fill(depths_.begin() + row + first_x, depths_.begin() + row + last_x + 1, 0.0f);
+    std::fill(layer_depths_.begin() + row + first_x, layer_depths_.begin() + row + last_x + 1, 0.0f);
+    std::fill(layer_masks_.begin() + row + first_x, layer_masks_.begin() + row + last_x + 1, 0u);
+  }
+
+  for (const auto &triangles : triangles_) {
+    for (const screen_triangle &triangle : triangles) {
+      const int32_t x0 = std::max(first_x, triangle.min_x / subtile_width);
+      const int32_t x1 = std::min(last_x, triangle.max_x / subtile_width);
+      const int32_t y0 = std::max(first_y, triangle.min_y / subtile_height);
+      const int32_t y1 = std::min(last_y, triangle.max_y / subtile_height);
+      if (x0 <= x1 && y0 <= y1) draw(triangle, x0, y0, x1, y1);
+    }
+  }
+
+  for (int32_t tile_y = first_tile_y; tile_y <= last_tile_y; ++tile_y) {
+    for (int32_t tile_x = first_tile_x; tile_x <= last_tile_x; ++tile_x) {
+      float farthest = depths_[static_cast<size_t>(tile_y * tile_subtiles) * subtiles_x_ + tile_x * tile_subtiles];
+      for (int32_t y = 0; y < tile_subtiles; ++y) {
+        const size_t row = static_cast<size_t>(tile_y * tile_subtiles + y) * subtiles_x_ + tile_x * tile_subtiles;
+        for (int32_t x = 0; x < tile_subtiles; ++x) farthest = std::min(farthest, depths_[row + x]);
+      }
+      tile_depths_[static_cast<size_t>(tile_y) * tiles_x_ + tile_x] = farthest;
+    }
+  }
+}
+
+void occlusion_buffer::draw(const screen_triangle &triangle, const int32_t first_x, const int32_t first_y,
+                            const int32_t last_x, const int32_t last_y) {
+  // Whichever corner of a subtile's pixel centres lies farthest along the depth plane.
+  const float far_x = triangle.depth_x < 0.0f ? subtile_width - 0.5f : 0.5f;
+  const float far_y = triangle.depth_y < 0.0f ? subtile_height - 0.5f : 0.5f;
+
+  for (int32_t y = first_y; y <= last_y; ++y) {
+    for (int32_t x = first_x; x <= last_x; ++x) {
+      const size_t index = static_cast<size_t>(y) * subtiles_x_ + x;
+      const int32_t pixel_x = x * subtile_width, pixel_y = y * subtile_height;
+      const float depth = std::max(triangle.farthest, triangle.depth_origin +
+                                                          triangle.depth_x * (static_cast<float>(pixel_x) + far_x) +
+                                                          triangle.depth_y * (static_cast<float>(pixel_y) + far_y));
+      // Nothing to add where the triangle is no nearer than what already covers the whole subtile.
+      if (depth <= depths_[index]) continue;
+      uint32_t coverage = subtile_coverage(triangle, pixel_x, pixel_y);
+      if (coverage == 0) continue;
+      // Pixels past the edge of the screen are never tested, so they count as covered.
+      if (pixel_x + subtile_width > width_ || pixel_y + subtile_height > height_) {
+        coverage |= padding_mask(width_ - pixel_x, height_ - pixel_y);
+      }
+
+      float &layer_depth = layer_depths_[index];
+      uint32_t &mask = layer_masks_[index];
+      if (coverage == full_mask) {
+        depths_[index] = depth;
+        if (layer_depth <= depth) mask = 0;
+        continue;
+      }
+      if (mask == 0 || depth - layer_depth > layer_depth - depths_[index]) {
+        // Much nearer than the working layer, which is replaced rather than pulled back.
+        layer_depth = depth;
+        mask = coverage;
+      } else {
+        layer_depth = std::min(layer_depth, depth);
+        mask |= coverage;
+      }
+      if (mask == full_mask) {
+        depths_[index] = layer_depth;
+        mask = 0;
+      }
+    }
+  }
+}
+
+bool occlusion_buffer::is_visible(const glm::vec3 &min, const glm::vec3 &max) const {
+  glm::vec2 screen_min(std::numeric_limits<float>::max()), screen_max(-std::numeric_limits<float>::max());
+  float nearest = 0.0f;
+  // The corners are the minimum's clip position plus any of the three edges'.
+  const glm::vec4 origin = view_projection_ * glm::vec4(min, 1.0f);
+  const glm::vec4 edges[3] = {view_projection_[0] * (max.x - min.x), view_projection_[1] * (max.y - min.y),
+                              view_projection_[2] * (max.z - min.z)};
+  glm::vec4 corners[8];
+  // Bits for the sides of the frustum each corner is beyond: left, right, bottom, top and near.
+  uint32_t outside_all = 0x1f, outside_any = 0;
+  for (int32_t corner = 0; corner < 8; ++corner) {
+    glm::vec4 &clip = corners[corner];
+    clip = origin;
+    for (int32_t axis = 0; axis < 3; ++axis) {
+      if ((corner & (1 << axis)) != 0) clip += edges[axis];
+    }
+    const uint32_t outside = (clip.x < -clip.w ? 1u : 0u) | (clip.x > clip.w ? 2u : 0u) |
+                             (clip.y < -clip.w ? 4u : 0u) | (clip.y > clip.w ? 8u : 0u) |
+                             (clip.z < -clip.w ? 16u : 0u);
+    outside_all &= outside;
+    outside_any |= outside;
+  }
+  // Off screen when every corner is beyond the same side; reaching through the near plane is too
+  // close to cull.
+  if (outside_all != 0) return false;
+  if ((outside_any & 16u) != 0) return true;
+
+  for (const glm::vec4 &clip : corners) {
+    const float depth = 1.0f / clip.w;
+    const glm::vec2 screen = (glm::vec2(clip) * depth * 0.5f + 0.5f) * glm::vec2(width_, height_);
+    screen_min = glm::min(screen_min, screen);
+    screen_max = glm::max(screen_max, screen);
+    nearest = std::max(nearest, depth);
+  }
+  if (screen_max.x < 0.0f || screen_max.y < 0.0f || screen_min.x >= static_cast<float>(width_) ||
+      screen_min.y >= static_cast<float>(height_)) {
+    return false;
+  }
+
+  const int32_t x0 = std::max(0, static_cast<int32_t>(screen_min.x)) / subtile_width;
+  const int32_t y0 = std::max(0, static_cast<int32_t>(screen_min.y)) / subtile_height;
+  const int32_t x1 = std::min(width_ - 1, static_cast<int32_t>(screen_max.x)) / subtile_width;
+  const int32_t y1 = std::min(height_ - 1, static_cast<int32_t>(screen_max.y)) / subtile_height;
+
+  for (int32_t tile_y = y0 / tile_subtiles; tile_y <= y1 / tile_subtiles; ++tile_y) {
+    for (int32_t tile_x = x0 / tile_subtiles; tile_x <= x1 / tile_subtiles; ++tile_x) {
+      // The whole tile is nearer than the box.
+      if (nearest < tile_depths_[static_cast<size_t>(tile_y) * tiles_x_ + tile_x]) continue;
+      for (int32_t y = std::max(y0, tile_y * tile_subtiles); y <= std::min(y1, tile_y * tile_subtiles + 3); ++y) {
+        const size_t row = static_cast<size_t>(y) * subtiles_x_;
+        for (int32_t x = std::max(x0, tile_x * tile_subtiles); x <= std::min(x1, tile_x * tile_subtiles + 3); ++x) {
+          if (nearest >= depths_[row + x]) return true;
+        }
+      }
+    }
+  }
+  return false;
+}
+
+void occlusion_buffer::print_stats(std::ostream &out) const {
+  out << std::fixed << std::setprecision(2) << "occlusion: " << stats_.occluders << " occluders, "
+      << stats_.triangles << " triangles at " << width_ << "x" << height_ << " in " << stats_.rasterize_ms << " ms"
+      << std::endl;
+}
@@ -0,0 +1,108 @@
+#ifndef OCCLUSION_BUFFER_H
+#define OCCLUSION_BUFFER_H
+
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <iosfwd>
+#include <vector>
+
+class thread_pool;
+
+struct occlusion_stats {
+  size_t occluders = 0;
+  size_t triangles = 0;  // front-facing and on screen after clipping
+  double rasterize_ms = 0.0;
+};
+
+// A low-resolution depth buffer on the CPU that big occluders are drawn into so that objects hidden
+// behind them can be skipped before they are submitted, after Andersson et al.'s masked software
+// occlusion culling.
+//
+// The screen is split into subtiles of 8x4 pixels. Instead of a depth per pixel each subtile keeps
+// the farthest depth of everything drawn over all of it, plus a working layer: a coverage mask of
+// the pixels covered since and the farthest depth over those. When the mask fills up the working
+// layer becomes the subtile's depth; when a triangle lands much nearer than the working layer the
+// layer is dropped for the triangle's. Either way the subtile's depth only ever moves nearer and
+// never past anything drawn over it, so tests are conservative: a box is only reported hidden if it
+// really is. Coverage is found with AVX2 for a row of eight pixels per instruction (SSE2 in two
+// halves). Tiles of 4x4 subtiles keep the farthest depth of their subtiles so most tests are decided
+// by one comparison per tile.
+//
+// With a pool the screen is split into bins of whole tiles: occluders are transformed, clipped and
+// set up in parallel, then each bin rasterizes the triangles overlapping it on its own thread.
+//
+// Depths are 1/w, larger nearer.
+class occlusion_buffer {
+ public:
+  static constexpr int32_t subtile_width = 8;
+  static constexpr int32_t subtile_height = 4;
+  static constexpr int32_t tile_subtiles = 4;  // per side
+
+  // The size is rounded up to whole tiles; tests are still clipped to it.
+  explicit occlusion_buffer(int32_t width = 384, int32_t height = 216);
+
+  // Starts a frame seen through `view_projection` with no occluders.
+  void begin_frame(const glm::mat4 &view_projection);
+
+  // Queues a closed mesh with counter-clockwise triangles to draw into the buffer; its positions are
+  // `stride` bytes apart. The arrays are read by the next rasterize() and must live until then.
+  void add_occluder(const glm::vec3 *positions, size_t stride, const uint32_t *indices, size_t index_count,
+                    const glm::mat4 &model);
+
+  // Clears the buffer and draws the queued occluders into it.
+  void rasterize();
+  void rasterize(thread_pool &pool);
+
+  // Whether any part of the box could be seen: false if it is behind the occluders or off screen.
+  // Safe to call from many threads at once between rasterize() and the next begin_frame().
+  [[nodiscard]] bool is_visible(const glm::vec3 &min, const glm::vec3 &max) const;
+
+  [[nodiscard]] int32_t width() const { return width_; }
+  [[nodiscard]] int32_t height() const { return height_; }
+  [[nodiscard]] const occlusion_stats &stats() const { return stats_; }
+  void print_stats(std::ostream &out) const;
+
+ private:
+  struct occluder {
+    const glm::vec3 *positions;
+    size_t stride;
+    const uint32_t *indices;
+    size_t index_count;
+    glm::mat4 transform;  // view_projection * model
+  };
+
+  // A triangle in pixels with its edge functions, inside when all three are positive, and its plane
+  // of depths.
+  struct screen_triangle {
+    float edge_a[3], edge_b[3], edge_c[3];
+    float depth_x, depth_y, depth_origin;
+    float farthest;  // of its vertices
+    int32_t min_x, min_y, max_x, max_y;  // pixel bounds, clamped to the buffer
+  };
+
+  void set_up(const occluder &mesh, std::vector<screen_triangle> &triangles) const;
+  void add_triangle(const glm::vec4 (&clip)[3], std::vector<screen_triangle> &triangles) const;
+  void rasterize_bin(int32_t bin);
+  void draw(const screen_triangle &triangle, int32_t first_x, int32_t first_y, int32_t last_x, int32_t last_y);
+
+  int32_t width_ = 0, height_ = 0;
+  int32_t subtiles_x_ = 0, subtiles_y_ = 0;
+  int32_t tiles_x_ = 0, tiles_y_ = 0;
+  int32_t bins_x_ = 0, bins_y_ = 0;
+
+  glm::mat4 view_projection_ = glm::mat4(1.0f);
+  std::vector<occluder> occluders_;
+  std::vector<std::vector<screen_triangle>> triangles_;  // by occluder
+
+  // By subtile, row by row.
+  std::vector<float> depths_;  // farthest over the whole subtile
+  std::vector<float> layer_depths_;  // farthest over the working layer's pixels
+  std::vector<uint32_t> layer_masks_;  // pixels in the working layer, a byte per row
+  std::vector<float> tile_depths_;  // by tile, the farthest of its subtiles
+
+  occlusion_stats stats_;
+};
+
+#endif  // OCCLUSION_BUFFER_H
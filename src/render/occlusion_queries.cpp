@@ -0,0 +1,163 @@
+#include "occlusion_queries.h"
+
+#include <glad/glad.h>
+
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+
+#include "../shader/shader.h"
+
+namespace {
+
+constexpr GLuint position_location = 0;
+
+// The twelve triangles of the unit cube.
+constexpr float cube_corners[] = {
+    0, 0, 0, 1, 1, 0, 1, 0, 0, 0, 0, 0, 0, 1, 0, 1, 1, 0,  // z = 0
+    0, 0, 1, 1, 0, 1, 1, 1, 1, 0, 0, 1, 1, 1, 1, 0, 1, 1,  // z = 1
+    0, 0, 0, 0, 0, 1, 0, 1, 1, 0, 0, 0, 0, 1, 1, 0, 1, 0,  // x = 0
+    1, 0, 0, 1, 1, 1, 1, 0, 1, 1, 0, 0, 1, 1, 0, 1, 1, 1,  // x = 1
+    0, 0, 0, 1, 0, 0, 1, 0, 1, 0, 0, 0, 1, 0, 1, 0, 0, 1,  // y = 0
+    0, 1, 0, 1, 1, 1, 1, 1, 0, 0, 1, 0, 0, 1, 1, 1, 1, 1,  // y = 1
+};
+
+}  // namespace
+
+occlusion_queries::occlusion_queries(const occlusion_query_settings &config) : config_(config) {
+  config_.requery_interval = std::max(config_.requery_interval, 1u);
+  target_ = GLAD_GL_VERSION_4_3 != 0 ? GL_ANY_SAMPLES_PASSED_CONSERVATIVE : GL_ANY_SAMPLES_PASSED;
+
+  glGenVertexArrays(1, &box_vao_);
+  glGenBuffers(1, &box_buffer_);
+  glBindVertexArray(box_vao_);
+  glBindBuffer(GL_ARRAY_BUFFER, box_buffer_);
+  glBufferData(GL_ARRAY_BUFFER, sizeof(cube_corners), cube_corners, GL_STATIC_DRAW);
+  glVertexAttribPointer(position_location, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), nullptr);
+  glEnableVertexAttribArray(position_location);
+  glBindVertexArray(0);
+}
+
+occlusion_queries::~occlusion_queries() {
+  if (!queries_.empty()) glDeleteQueries(static_cast<GLsizei>(queries_.size()), queries_.data());
+  glDeleteVertexArrays(1, &box_vao_);
+  glDeleteBuffers(1, &box_buffer_);
+}
+
+void occlusion_queries::resize(const size_t nodes) {
+  if (!queries_.empty()) glDeleteQueries(static_cast<GLsizei>(queries_.size()), queries_.data());
+  queries_.assign(nodes, 0);
+  if (nodes > 0) glGenQueries(static_cast<GLsizei>(nodes), queries_.data());
+
+  visible_.assign(nodes, 1);
+  issued_frame_.assign(nodes, not_issued);
+  next_test_.assign(nodes, frame_);
+  revealed_frame_.assign(nodes, 0);
+  in_flight_.clear();
+}
+
+void occlusion_queries::begin_frame() {
+  ++frame_;
+  stats_ = {};
+  uint64_t latency_sum = 0;
+
+  // Results usually arrive in the order the queries were issued, but checking each one costs little.
+  size_t kept = 0;
+  for (const uint32_t node : in_flight_) {
+    GLuint available = GL_FALSE;
+    glGetQueryObjectuiv(queries_[node], GL_QUERY_RESULT_AVAILABLE, &available);
+    if (available == GL_FALSE) {
+      in_flight_[kept++] = node;
+      continue;
+    }
+
+    GLuint passed = 0;
+    glGetQueryObjectuiv(queries_[node], GL_QUERY_RESULT, &passed);
+    const uint32_t latency = frame_ - issued_frame_[node];
+    latency_sum += latency;
+    stats_.max_latency = std::max(stats_.max_latency, latency);
+    ++stats_.results;
+    issued_frame_[node] = not_issued;
+
+    if (passed != 0) {
+      ++stats_.visible_results;
+      if (visible_[node] == 0) revealed_frame_[node] = frame_;
+      // Staggered so nodes revealed together are not all tested again together.
+      next_test_[node] = frame_ + config_.requery_interval + node % config_.requery_interval;
+    }
+    visible_[node] = passed != 0 ? 1 : 0;
+  }
+  in_flight_.resize(kept);
+  if (stats_.results > 0) stats_.average_latency = static_cast<double>(latency_sum) / stats_.results;
+}
+
+void occlusion_queries::set_visible(const uint32_t node, const bool visible, const bool test_now) {
+  visible_[node] = visible ? 1 : 0;
+  if (visible && test_now) next_test_[node] = frame_;
+}
+
+bool occlusion_queries::is_near(const glm::vec3 &camera_position, const glm::vec3 &min, const glm::vec3 &max) const {
+  return glm::all(glm::greaterThanEqual(camera_position, min - config_.near_margin)) &&
+         glm::all(glm::lessThanEqual(camera_position, max + config_.near_margin));
+}
+
+void occlusion_queries::issue(const uint32_t node) {
+  issued_frame_[node] = frame_;
+  in_flight_.push_back(node);
+}
+
+void occlusion_queries::begin_query(const uint32_t node) {
+  issue(node);
+  ++stats_.draw_queries;
+  glBeginQuery(target_, queries_[node]);
+}
+
+void occlusion_queries::end_query() { glEndQuery(target_); }
+
+void occlusion_queries::begin_boxes(const shader &box_program, const glm::mat4 &view_projection) {
+  box_program_ = &box_program;
+  box_program.use();
+  box_program.setMat4("viewProjection", view_projection);
+  glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+  glDepthMask(GL_FALSE);
+  // From inside a box only its back faces are in front of the far plane.
+  glDisable(GL_CULL_FACE);
+  glBindVertexArray(box_vao_);
+}
+
+void occlusion_queries::query_box(const uint32_t node, const glm::vec3 &min, const glm::vec3 &max) {
+  issue(node);
+  ++stats_.box_queries;
+  box_program_->setVec3("boundsMin", min);
+  box_program_->setVec3("boundsMax", max);
+  glBeginQuery(target_, queries_[node]);
+  glDrawArrays(GL_TRIANGLES, 0, 36);
+  glEndQuery(target_);
+}
+
+void occlusion_queries::end_boxes() {
+  glBindVertexArray(0);
+  glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+  glDepthMask(GL_TRUE);
+  box_program_ = nullptr;
+}
+
+void occlusion_queries::begin_conditional(const uint32_t node) {
+  ++stats_.conditional_draws;
+  // The GPU waits for the query it just issued; the CPU goes on.
+  glBeginConditionalRender(queries_[node], GL_QUERY_WAIT);
+}
+
+void occlusion_queries::end_conditional() { glEndConditionalRender(); }
+
+void occlusion_queries::end_frame() { stats_.pending = static_cast<uint32_t>(in_flight_.size()); }
+
+void occlusion_queries::print_stats(std::ostream &out) const {
+  out << std::fixed << std::setprecision(2) << "occlusion queries ("
+      << (config_.mode == occlusion_query_mode::conditional ? "conditional" : "previous frame") << "): "
+      << stats_.box_queries << " box and " << stats_.draw_queries << " draw queries issued, "
+      << stats_.conditional_draws << " conditional draws; " << stats_.results << " results read ("
+      << stats_.visible_results << " visible), " << stats_.average_latency << " frames latency on average, "
+      << stats_.max_latency << " at most, " << stats_.pending << " in flight over " << queries_.size()
+      << " nodes" << std::endl;
+}
@@ -0,0 +1,139 @@
+#ifndef OCCLUSION_QUERIES_H
+#define OCCLUSION_QUERIES_H
+
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <iosfwd>
+#include <vector>
+
+class shader;
+
+enum class occlusion_query_mode : uint8_t {
+  // Nodes thought hidden are drawn under conditional rendering on this frame's query of their box,
+  // so nothing pops in, at the cost of the GPU waiting on each of those queries.
+  conditional,
+  // Nodes thought hidden are only drawn once a later frame has read back a visible result, so
+  // nothing ever waits, but a node coming into view shows up a frame or two late.
+  previous_frame,
+};
+
+struct occlusion_query_settings {
+  occlusion_query_mode mode = occlusion_query_mode::conditional;
+  // A visible node is tested again with its own draw every this many frames or so, staggered so
+  // the nodes that came into view together are not all tested on the same frame.
+  uint32_t requery_interval = 8;
+  // Boxes the camera is within this distance of could be cut by the near plane; they count as
+  // visible without a test.
+  float near_margin = 0.5f;
+};
+
+struct occlusion_query_stats {
+  // Of the last frame.
+  uint32_t box_queries = 0;  // bounding boxes drawn for nodes thought hidden
+  uint32_t draw_queries = 0;  // visible nodes tested with their own draw
+  uint32_t conditional_draws = 0;
+  uint32_t results = 0;  // read back at the start of the frame
+  uint32_t visible_results = 0;
+  uint32_t pending = 0;  // still in flight at the end of the frame
+  double average_latency = 0.0;  // frames from issuing a query to reading its result back
+  uint32_t max_latency = 0;
+};
+
+// Hardware occlusion queries with the temporal coherence of Bittner et al.'s coherent hierarchical
+// culling: every node of the caller's hierarchy has a query object and remembers whether it was last
+// found visible. Each frame the caller draws the nodes it believes visible, testing one now and then
+// by wrapping its draw in its query, and then tests the ones it believes hidden by drawing their
+// bounding boxes with colour and depth writes off. Results are only read once the GPU reports them
+// available, so the CPU never waits for one; what is done with the hidden nodes' draws until then
+// depends on occlusion_query_mode.
+//
+// The traversal, and pulling visibility up and pushing it down the hierarchy, belong to the caller
+// (see hlod_renderer::draw_queried()); this keeps the queries, the results and the counts.
+//
+// Queries count samples with GL_ANY_SAMPLES_PASSED_CONSERVATIVE where it exists (GL 4.3) and
+// GL_ANY_SAMPLES_PASSED otherwise. All member functions must be called on the thread that owns the
+// GL context.
+class occlusion_queries {
+ public:
+  explicit occlusion_queries(const occlusion_query_settings &config = {});
+  occlusion_queries(const occlusion_queries &) = delete;
+  occlusion_queries &operator=(const occlusion_queries &) = delete;
+
+  ~occlusion_queries();
+
+  // Gives every one of `nodes` nodes a query; what was known of their visibility is forgotten and
+  // all of them start out visible.
+  void resize(size_t nodes);
+  [[nodiscard]] size_t size() const { return queries_.size(); }
+
+  // Reads back every result that is ready, without waiting for the rest, and starts the frame's
+  // counts.
+  void begin_frame();
+
+  [[nodiscard]] bool visible(const uint32_t node) const { return visible_[node] != 0; }
+  // Whether the results read by this frame's begin_frame() found the node visible after it was hidden.
+  [[nodiscard]] bool revealed(const uint32_t node) const { return revealed_frame_[node] == frame_; }
+  [[nodiscard]] bool pending(const uint32_t node) const { return issued_frame_[node] != not_issued; }
+  // Whether the node's query in flight was issued this frame, rather than left over from an earlier one.
+  [[nodiscard]] bool issued_now(const uint32_t node) const { return issued_frame_[node] == frame_; }
+  // Whether a visible node should be tested with its draw this frame.
+  [[nodiscard]] bool due(const uint32_t node) const { return !pending(node) && frame_ >= next_test_[node]; }
+
+  // For the caller's traversal: a node whose children were all found hidden is hidden itself, and
+  // the children of one found visible are visible, tested again with their draws this frame when
+  // `test_now` is set.
+  void set_visible(uint32_t node, bool visible, bool test_now = false);
+
+  // Whether the camera is close enough to the box that the box cannot be tested.
+  [[nodiscard]] bool is_near(const glm::vec3 &camera_position, const glm::vec3 &min, const glm::vec3 &max) const;
+
+  // Brackets a node's own draw in its query. The node must not be pending.
+  void begin_query(uint32_t node);
+  void end_query();
+
+  // Brackets a run of query_box() calls: binds `box_program`, turns colour and depth writes and face
+  // culling off, and restores them in end_boxes().
+  void begin_boxes(const shader &box_program, const glm::mat4 &view_projection);
+  // Draws the box in the node's query. The node must not be pending.
+  void query_box(uint32_t node, const glm::vec3 &min, const glm::vec3 &max);
+  void end_boxes();
+
+  // Brackets draws that the GPU skips when the node's latest query found nothing visible. That query
+  // should be one issued this frame (see issued_now()); an older one may hide what has since come into view.
+  void begin_conditional(uint32_t node);
+  void end_conditional();
+
+  // Ends the frame's counts.
+  void end_frame();
+
+  [[nodiscard]] occlusion_query_mode mode() const { return config_.mode; }
+  void set_mode(const occlusion_query_mode mode) { config_.mode = mode; }
+
+  [[nodiscard]] const occlusion_query_stats &stats() const { return stats_; }
+  void print_stats(std::ostream &out) const;
+
+ private:
+  static constexpr uint32_t not_issued = ~0u;
+
+  void issue(uint32_t node);
+
+  occlusion_query_settings config_;
+  uint32_t target_ = 0;  // the query target
+  uint32_t box_vao_ = 0;
+  uint32_t box_buffer_ = 0;
+  const shader *box_program_ = nullptr;  // between begin_boxes() and end_boxes()
+
+  std::vector<uint32_t> queries_;
+  std::vector<uint8_t> visible_;
+  std::vector<uint32_t> issued_frame_;  // or not_issued when no query is in flight
+  std::vector<uint32_t> next_test_;  // the frame a visible node is next due
+  std::vector<uint32_t> revealed_frame_;
+  std::vector<uint32_t> in_flight_;  // nodes with a query issued and not yet read back
+  uint32_t frame_ = 1;
+
+  occlusion_query_stats stats_;
+};
+
+#endif  // OCCLUSION_QUERIES_H
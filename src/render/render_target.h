@@ -0,0 +1,41 @@
+#ifndef RENDER_TARGET_H
+#define RENDER_TARGET_H
+
+#include <cstdint>
+
+// An offscreen framebuffer with an RGBA8 colour texture and a 32-bit float depth texture, so passes
+// later in the frame can read the depth the scene has drawn so far (see hiz_pyramid). present()
+// copies the colour to the window.
+//
+// All member functions must be called on the thread that owns the GL context.
+class render_target {
+ public:
+  render_target() = default;
+  render_target(const render_target &) = delete;
+  render_target &operator=(const render_target &) = delete;
+
+  ~render_target();
+
+  // (Re)creates the textures when the size changed; their contents are then undefined.
+  void resize(int32_t width, int32_t height);
+
+  // Binds the framebuffer for drawing and sets the viewport to cover it.
+  void bind() const;
+
+  // Copies the colour into the default framebuffer, which must be the same size, and binds that.
+  void present() const;
+
+  [[nodiscard]] uint32_t colour_texture() const { return colour_; }
+  [[nodiscard]] uint32_t depth_texture() const { return depth_; }
+  [[nodiscard]] int32_t width() const { return width_; }
+  [[nodiscard]] int32_t height() const { return height_; }
+
+ private:
+  uint32_t framebuffer_ = 0;
+  uint32_t colour_ = 0;
+  uint32_t depth_ = 0;
+  int32_t width_ = 0;
+  int32_t height_ = 0;
+};
+
+#endif  // RENDER_TARGET_H
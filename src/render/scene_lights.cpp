@@ -0,0 +1,29 @@
+#include "scene_lights.h"
+
+#include "cascaded_shadow_map.h"
+#include "clustered_lighting.h"
+#include "../shader/shader.h"
+
+void scene_lights::set_sun_and_fog(const shader &program) const {
+  program.setVec3("lightDirection", sun_direction);
+  program.setVec3("lightColor", 0.9f, 0.85f, 0.75f);
+  program.setVec3("ambientColor", 0.2f, 0.22f, 0.25f);
+  program.setVec3("fogColor", 0.15f, 0.15f, 0.15f);
+  program.setFloat("fogDensity", 0.0005f);
+}
+
+void scene_lights::set_point_light(const shader &program) const {
+  program.setVec3("light.position", point_light_position);
+  program.setVec3("light.ambient", 0.1f, 0.1f, 0.1f);
+  program.setVec3("light.diffuse", 0.5f, 0.5f, 0.5f);
+  program.setVec3("light.specular", 1.0f, 1.0f, 1.0f);
+}
+
+void scene_lights::bind(const shader &program) const {
+  program.setVec3("viewPos", view_position);
+  set_sun_and_fog(program);
+#ifndef __APPLE__
+  clusters->bind(program, viewport.x, viewport.y);
+  sun_shadows->bind(program);
+#endif
+}
@@ -0,0 +1,34 @@
+#ifndef SCENE_LIGHTS_H
+#define SCENE_LIGHTS_H
+
+#include <glm/glm.hpp>
+
+class cascaded_shadow_map;
+class clustered_lighting;
+class shader;
+
+// What the lit passes of a frame bind, under the uniform names every lit program shares: the camera
+// in `viewPos`, the sun in `lightDirection` and `lightColor` with `ambientColor`, `fogColor` and
+// `fogDensity`, the point light circling the cube in the Light struct `light` and, on GL 4.6, the
+// clustered street lights and the sun's shadows. A program lacking some of them ignores them.
+struct scene_lights {
+  glm::vec3 view_position = glm::vec3(0.0f);
+  glm::vec3 sun_direction = glm::vec3(0.0f, 1.0f, 0.0f);
+  glm::vec3 point_light_position = glm::vec3(0.0f);
+#ifndef __APPLE__
+  const clustered_lighting *clusters = nullptr;
+  const cascaded_shadow_map *sun_shadows = nullptr;
+  glm::vec2 viewport = glm::vec2(0.0f);  // in pixels, for the clusters' tiles
+#endif
+
+  // The sun, with the ambient light and the fog.
+  void set_sun_and_fog(const shader &program) const;
+
+  // The Light struct of the cube's and the crates' programs and of deferred lighting.
+  void set_point_light(const shader &program) const;
+
+  // The camera, the sun and fog, the street lights and the sun's shadows.
+  void bind(const shader &program) const;
+};
+
+#endif  // SCENE_LIGHTS_H
@@ -0,0 +1,79 @@
+#include "streaming_buffer.h"
+
+streaming_buffer::streaming_buffer(const size_t capacity) : capacity_(capacity) {
+  glGenBuffers(1, &buffer_);
+  glBindBuffer(GL_COPY_READ_BUFFER, buffer_);
+
+  if (GLAD_GL_VERSION_4_4) {
+    constexpr GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+    glBufferStorage(GL_COPY_READ_BUFFER, static_cast<GLsizeiptr>(capacity_), nullptr, flags);
+    mapped_ = static_cast<uint8_t *>(
+        glMapBufferRange(GL_COPY_READ_BUFFER, 0, static_cast<GLsizeiptr>(capacity_), flags));
+  } else {
+    glBufferData(GL_COPY_READ_BUFFER, static_cast<GLsizeiptr>(capacity_), nullptr, GL_STREAM_DRAW);
+    shadow_.resize(capacity_);
+  }
+  glBindBuffer(GL_COPY_READ_BUFFER, 0);
+}
+
+streaming_buffer::~streaming_buffer() {
+  for (const frame_region &frame : frames_) glDeleteSync(frame.fence);
+  if (mapped_ != nullptr) {
+    glBindBuffer(GL_COPY_READ_BUFFER, buffer_);
+    glUnmapBuffer(GL_COPY_READ_BUFFER);
+    glBindBuffer(GL_COPY_READ_BUFFER, 0);
+  }
+  glDeleteBuffers(1, &buffer_);
+}
+
+void streaming_buffer::retire_finished_frames() {
+  while (!frames_.empty()) {
+    const GLenum status = glClientWaitSync(frames_.front().fence, 0, 0);
+    if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED) return;
+
+    glDeleteSync(frames_.front().fence);
+    used_ -= frames_.front().bytes;
+    frames_.pop_front();
+  }
+  if (used_ == 0) head_ = 0;
+}
+
+streaming_allocation streaming_buffer::allocate(const size_t size, const size_t alignment) {
+  if (size == 0 || size > capacity_) return {};
+  retire_finished_frames();
+
+  size_t start = (head_ + alignment - 1) / alignment * alignment;
+  size_t taken = start - head_ + size;
+  if (start + size > capacity_) {
+    // Skip the tail of the ring; it comes back with this frame's fence.
+    start = 0;
+    taken = capacity_ - head_ + size;
+  }
+  if (taken > capacity_ - used_) return {};
+
+  head_ = start + size == capacity_ ? 0 : start + size;
+  used_ += taken;
+  frame_bytes_ += taken;
+
+  streaming_allocation allocation;
+  allocation.offset = start;
+  allocation.size = size;
+  allocation.data = (mapped_ != nullptr ? mapped_ : shadow_.data()) + start;
+  return allocation;
+}
+
+void streaming_buffer::commit(const streaming_allocation &allocation) {
+  if (mapped_ != nullptr || allocation.empty()) return;
+
+  glBindBuffer(GL_COPY_READ_BUFFER, buffer_);
+  glBufferSubData(GL_COPY_READ_BUFFER, static_cast<GLintptr>(allocation.offset),
+                  static_cast<GLsizeiptr>(allocation.size), allocation.data);
+  glBindBuffer(GL_COPY_READ_BUFFER, 0);
+}
+
+void streaming_buffer::end_frame() {
+  if (frame_bytes_ == 0) return;
+
+  frames_.push_back({frame_bytes_, glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0)});
+  frame_bytes_ = 0;
+}
@@ -0,0 +1,64 @@
+#ifndef STREAMING_BUFFER_H
+#define STREAMING_BUFFER_H
+
+#include <glad/glad.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <vector>
+
+struct streaming_allocation {
+  size_t offset = 0;  // in buffer()
+  size_t size = 0;
+  uint8_t *data = nullptr;  // write the contents here, then commit()
+
+  [[nodiscard]] bool empty() const { return data == nullptr; }
+};
+
+// A ring of upload memory for data that changes every few frames. Space is handed out front to
+// back; end_frame() fences everything written that frame, and the space comes back once the GPU
+// has passed the fence, so the CPU never writes over bytes a pending copy or draw still reads and
+// never waits for the GPU either: allocate() fails instead and the caller retries next frame.
+//
+// On GL 4.4 the buffer is persistently mapped and commit() is free; otherwise allocations are
+// written to a CPU copy and commit() sends them with glBufferSubData.
+//
+// All member functions must be called on the thread that owns the GL context.
+class streaming_buffer {
+ public:
+  explicit streaming_buffer(size_t capacity);
+  streaming_buffer(const streaming_buffer &) = delete;
+  streaming_buffer &operator=(const streaming_buffer &) = delete;
+
+  ~streaming_buffer();
+
+  [[nodiscard]] streaming_allocation allocate(size_t size, size_t alignment = 16);
+  // Makes the written allocation visible to GL commands issued after this call.
+  void commit(const streaming_allocation &allocation);
+  void end_frame();
+
+  [[nodiscard]] uint32_t buffer() const { return buffer_; }
+  [[nodiscard]] size_t capacity() const { return capacity_; }
+  [[nodiscard]] size_t bytes_in_flight() const { return used_; }
+
+ private:
+  struct frame_region {
+    size_t bytes;
+    GLsync fence;
+  };
+
+  void retire_finished_frames();
+
+  uint32_t buffer_ = 0;
+  size_t capacity_;
+  uint8_t *mapped_ = nullptr;
+  std::vector<uint8_t> shadow_;
+
+  size_t head_ = 0;         // next free byte
+  size_t used_ = 0;         // bytes from the oldest unfinished frame up to head_, wasted tails included
+  size_t frame_bytes_ = 0;  // of used_, taken since the last end_frame()
+  std::deque<frame_region> frames_;
+};
+
+#endif  // STREAMING_BUFFER_H
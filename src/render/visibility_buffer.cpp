@@ -0,0 +1,80 @@
+#include "visibility_buffer.h"
+
+#include <glad/glad.h>
+
+#ifdef DEBUG
+#include <iostream>
+#endif
+
+#include "gpu_culler.h"
+#include "render_target.h"
+#include "../shader/shader.h"
+
+namespace {
+
+constexpr GLint id_unit = 1;
+constexpr GLuint output_image = 0;
+constexpr uint32_t tile_size = 8;  // local_size_x and local_size_y of resolve.comp
+
+static_assert(gpu_culler::meshlet_triangles <= 1u << visibility_buffer::triangle_bits,
+              "a draw's triangles must fit the id's triangle bits");
+
+}  // namespace
+
+visibility_buffer::~visibility_buffer() {
+  if (framebuffer_ == 0) return;
+  glDeleteFramebuffers(1, &framebuffer_);
+  glDeleteTextures(1, &ids_);
+}
+
+void visibility_buffer::begin(const render_target &target) {
+  if (framebuffer_ == 0) glGenFramebuffers(1, &framebuffer_);
+  glBindFramebuffer(GL_FRAMEBUFFER, framebuffer_);
+
+  if (target.width() != width_ || target.height() != height_) {
+    width_ = target.width();
+    height_ = target.height();
+    // Immutable storage cannot be resized, so the texture is made anew.
+    if (ids_ != 0) glDeleteTextures(1, &ids_);
+    glGenTextures(1, &ids_);
+    glBindTexture(GL_TEXTURE_2D, ids_);
+    glTexStorage2D(GL_TEXTURE_2D, 1, GL_R32UI, width_, height_);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, ids_, 0);
+    depth_ = 0;
+  }
+  if (target.depth_texture() != depth_) {
+    depth_ = target.depth_texture();
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, depth_, 0);
+#ifdef DEBUG
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+      std::cout << "visibility buffer is incomplete" << std::endl;
+    }
+#endif
+  }
+
+  glViewport(0, 0, width_, height_);
+  constexpr GLuint clear[] = {no_triangle, 0, 0, 0};
+  glClearBufferuiv(GL_COLOR, 0, clear);
+}
+
+void visibility_buffer::resolve(const shader &program, const render_target &target) const {
+  program.use();
+  glActiveTexture(GL_TEXTURE0 + id_unit);
+  glBindTexture(GL_TEXTURE_2D, ids_);
+  glActiveTexture(GL_TEXTURE0);
+  program.setInt("visibility", id_unit);
+  glBindImageTexture(output_image, target.colour_texture(), 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA8);
+
+  glDispatchCompute((width_ + tile_size - 1) / tile_size, (height_ + tile_size - 1) / tile_size, 1);
+  // The shaded colour must have landed before the draws and the blit after it.
+  glMemoryBarrier(GL_FRAMEBUFFER_BARRIER_BIT | GL_TEXTURE_FETCH_BARRIER_BIT);
+
+  glActiveTexture(GL_TEXTURE0 + id_unit);
+  glBindTexture(GL_TEXTURE_2D, 0);
+  glActiveTexture(GL_TEXTURE0);
+  target.bind();
+}
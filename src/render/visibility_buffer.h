@@ -0,0 +1,60 @@
+#ifndef VISIBILITY_BUFFER_H
+#define VISIBILITY_BUFFER_H
+
+#include <cstdint>
+
+class render_target;
+class shader;
+
+// Visibility buffer rendering into a render_target: the geometry pass writes nothing per pixel but a
+// 32-bit id of the triangle it shows, sharing the target's depth, and one compute pass then
+// shades every pixel from the id alone. It fetches the triangle's three vertices, intersects the
+// pixel's ray with them for perspective-correct barycentrics and their screen-space derivatives,
+// which pick the texture level, and interpolates the attributes from those. Shading runs once per
+// pixel however much was overdrawn, and the pass reads four bytes per pixel where a G-buffer
+// (see deferred_shading.h) has the geometry pass write and the lighting pass read its whole layout.
+//
+// The ids are made for gpu_culler's draws of up to 64 triangles each:
+//
+//   id = (command << triangle_bits) | gl_PrimitiveID
+//
+// where `command` is gl_DrawID plus gpu_culler::first_command() of the phase, so the resolve
+// program finds the draw's first index, base vertex and instance in gpu_culler::bind_draws() and
+// the vertices in the mesh buffers. Pixels nothing wrote hold no_triangle and keep the target's
+// colour.
+//
+// The geometry programs write location 0. The resolve program samples `visibility` on texture unit
+// 1, writes the target's colour through image unit 0 and works on 8x8 pixel tiles.
+//
+// Compute shaders need GL 4.3, so not on macOS. All member functions must be called on the thread
+// that owns the GL context.
+class visibility_buffer {
+ public:
+  static constexpr uint32_t triangle_bits = 6;
+  static constexpr uint32_t no_triangle = ~0u;
+
+  visibility_buffer() = default;
+  visibility_buffer(const visibility_buffer &) = delete;
+  visibility_buffer &operator=(const visibility_buffer &) = delete;
+
+  ~visibility_buffer();
+
+  // Binds the buffer for drawing with the target's depth, (re)creating it when the target's size
+  // changed, and clears it to no_triangle; the caller clears the depth with the target's.
+  void begin(const render_target &target);
+
+  // Shades the buffer into the target's colour with the compute program `program`, whose uniforms
+  // and storage blocks the caller has set, and binds the target again.
+  void resolve(const shader &program, const render_target &target) const;
+
+  [[nodiscard]] uint32_t texture() const { return ids_; }
+
+ private:
+  uint32_t framebuffer_ = 0;
+  uint32_t ids_ = 0;
+  uint32_t depth_ = 0;  // the target's, as last attached
+  int32_t width_ = 0;
+  int32_t height_ = 0;
+};
+
+#endif  // VISIBILITY_BUFFER_H
@@ -0,0 +1,504 @@
+#include "bvh.h"
+
+#include <algorithm>
+#include <atomic>
+#include <limits>
+
+#include "../utility/thread_pool.h"
+
+namespace {
+
+constexpr int32_t bin_count = 16;
+constexpr uint32_t max_leaf_objects = 8;
+// The cost of visiting a node relative to testing an object.
+constexpr float traversal_cost = 1.0f;
+// Below this many objects a node bins on its own thread, and below the second its subtree is built
+// on the thread that split it.
+constexpr uint32_t parallel_binning = 1u << 15;
+constexpr uint32_t binning_chunk = 1u << 13;
+constexpr uint32_t parallel_subtree = 1u << 12;
+// Past this depth nodes are split at the median, which bounds the height for up to 2^24 objects.
+constexpr uint32_t median_depth = 36;
+
+constexpr float infinity = std::numeric_limits<float>::infinity();
+
+aabb empty_box() { return {glm::vec3(infinity), glm::vec3(-infinity)}; }
+
+void grow(aabb &box, const glm::vec3 &point) {
+  box.min = glm::min(box.min, point);
+  box.max = glm::max(box.max, point);
+}
+
+void grow(aabb &box, const aabb &other) {
+  box.min = glm::min(box.min, other.min);
+  box.max = glm::max(box.max, other.max);
+}
+
+aabb merge(const aabb &a, const aabb &b) {
+  aabb box = a;
+  grow(box, b);
+  return box;
+}
+
+// Half the surface area, which is all the heuristic needs.
+float area(const aabb &box) {
+  const glm::vec3 size = glm::max(box.max - box.min, glm::vec3(0.0f));
+  return size.x * size.y + size.y * size.z + size.z * size.x;
+}
+
+bool overlaps(const aabb &box, const glm::vec3 &min, const glm::vec3 &max) {
+  return glm::all(glm::lessThanEqual(box.min, max)) && glm::all(glm::greaterThanEqual(box.max, min));
+}
+
+// An object's bounds with its index, moved around by the build so binning reads memory in order.
+struct build_item {
+  glm::vec3 min;
+  uint32_t object;
+  glm::vec3 max;
+  uint32_t padding;
+
+  [[nodiscard]] aabb box() const { return {min, max}; }
+  [[nodiscard]] glm::vec3 centre() const { return (min + max) * 0.5f; }
+};
+
+struct bin {
+  aabb box = empty_box();
+  aabb centres = empty_box();
+  uint32_t count = 0;
+};
+
+struct bin_set {
+  bin bins[3][bin_count];
+
+  void merge_from(const bin_set &other) {
+    for (int32_t axis = 0; axis < 3; ++axis) {
+      for (int32_t i = 0; i < bin_count; ++i) {
+        bin &to = bins[axis][i];
+        const bin &from = other.bins[axis][i];
+        grow(to.box, from.box);
+        grow(to.centres, from.centres);
+        to.count += from.count;
+      }
+    }
+  }
+};
+
+// Maps centres along each axis to bins, spreading the node's centre bounds over all of them.
+struct binning {
+  glm::vec3 origin;
+  glm::vec3 scale;
+
+  explicit binning(const aabb &centres) : origin(centres.min) {
+    const glm::vec3 extent = centres.max - centres.min;
+    for (int32_t axis = 0; axis < 3; ++axis) {
+      scale[axis] = extent[axis] > 0.0f ? static_cast<float>(bin_count) * 0.9999f / extent[axis] : 0.0f;
+    }
+  }
+
+  [[nodiscard]] int32_t bin_of(const glm::vec3 &point, const int32_t axis) const {
+    const auto index = static_cast<int32_t>((point[axis] - origin[axis]) * scale[axis]);
+    return std::clamp(index, 0, bin_count - 1);
+  }
+};
+
+}  // namespace
+
+// Builds into `nodes` in whatever order the threads allocate pairs of children, see build_tree().
+struct bvh::builder {
+  std::vector<build_item> &items;
+  std::vector<node> &nodes;
+  thread_pool *pool;
+  std::atomic<uint32_t> next_node{1};
+
+  void fill(bin_set &bins, const binning &mapping, const uint32_t first, const uint32_t end) const {
+    for (uint32_t i = first; i < end; ++i) {
+      const aabb box = items[i].box();
+      const glm::vec3 point = items[i].centre();
+      for (int32_t axis = 0; axis < 3; ++axis) {
+        bin &target = bins.bins[axis][mapping.bin_of(point, axis)];
+        grow(target.box, box);
+        grow(target.centres, point);
+        ++target.count;
+      }
+    }
+  }
+
+  void bounds_of(const uint32_t first, const uint32_t end, aabb &box, aabb &centres) const {
+    box = empty_box();
+    centres = empty_box();
+    for (uint32_t i = first; i < end; ++i) {
+      grow(box, items[i].box());
+      grow(centres, items[i].centre());
+    }
+  }
+
+  void make_leaf(const uint32_t index, const uint32_t first, const uint32_t count, const aabb &box) {
+    nodes[index] = {box.min, first, box.max, count};
+  }
+
+  void split(const uint32_t index, const uint32_t first, const uint32_t count, const aabb &box,
+             const uint32_t left_count, const aabb (&children)[2][2], const uint32_t depth) {
+    const uint32_t child = next_node.fetch_add(2);
+    nodes[index] = {box.min, child, box.max, 0};
+
+    const uint32_t firsts[2] = {first, first + left_count};
+    const uint32_t counts[2] = {left_count, count - left_count};
+    const auto build_child = [&](const size_t side) {
+      build(child + static_cast<uint32_t>(side), firsts[side], counts[side], children[side][0], children[side][1],
+            depth + 1);
+    };
+    if (pool != nullptr && count >= parallel_subtree) {
+      pool->parallel_for(0, 2, build_child);
+    } else {
+      build_child(0);
+      build_child(1);
+    }
+  }
+
+  // Splits in half along the longest axis of the centres, for nodes too deep or too uniform to bin.
+  void split_at_median(const uint32_t index, const uint32_t first, const uint32_t count, const aabb &box,
+                       const aabb &centres, const uint32_t depth) {
+    const glm::vec3 extent = centres.max - centres.min;
+    const int32_t axis = extent.x >= extent.y && extent.x >= extent.z ? 0 : (extent.y >= extent.z ? 1 : 2);
+    const uint32_t half = count / 2;
+    std::nth_element(items.begin() + first, items.begin() + first + half, items.begin() + first + count,
+                     [&](const build_item &a, const build_item &b) { return a.centre()[axis] < b.centre()[axis]; });
+    aabb children[2][2];
+    bounds_of(first, first + half, children[0][0], children[0][1]);
+    bounds_of(first + half, first + count, children[1][0], children[1][1]);
+    split(index, first, count, box, half, children, depth);
+  }
+
+  void build(const uint32_t index, const uint32_t first, const uint32_t count, const aabb &box, const aabb &centres,
+             const uint32_t depth) {
+    if (count == 1) return make_leaf(index, first, count, box);
+    if (depth >= median_depth) return split_at_median(index, first, count, box, centres, depth);
+    if (glm::all(glm::equal(centres.min, centres.max))) {
+      if (count <= max_leaf_objects) return make_leaf(index, first, count, box);
+      return split_at_median(index, first, count, box, centres, depth);
+    }
+
+    const binning mapping(centres);
+    bin_set bins;
+    if (pool != nullptr && count >= parallel_binning) {
+      const uint32_t chunks = (count + binning_chunk - 1) / binning_chunk;
+      std::vector<bin_set> partial(chunks);
+      pool->parallel_for(0, chunks, [&](const size_t chunk) {
+        const uint32_t begin = first + static_cast<uint32_t>(chunk) * binning_chunk;
+        fill(partial[chunk], mapping, begin, std::min(begin + binning_chunk, first + count));
+      });
+      for (const bin_set &part : partial) bins.merge_from(part);
+    } else {
+      fill(bins, mapping, first, first + count);
+    }
+
+    // Sweep each axis from both ends for the split with the least area-weighted object count.
+    float best_cost = infinity;
+    int32_t best_axis = -1, best_split = 0;
+    for (int32_t axis = 0; axis < 3; ++axis) {
+      if (mapping.scale[axis] == 0.0f) continue;
+      float right_costs[bin_count];
+      aabb right = empty_box();
+      uint32_t right_count = 0;
+      for (int32_t i = bin_count - 1; i > 0; --i) {
+        grow(right, bins.bins[axis][i].box);
+        right_count += bins.bins[axis][i].count;
+        right_costs[i] = right_count > 0 ? area(right) * static_cast<float>(right_count) : 0.0f;
+      }
+      aabb left = empty_box();
+      uint32_t left_count = 0;
+      for (int32_t i = 0; i < bin_count - 1; ++i) {
+        grow(left, bins.bins[axis][i].box);
+        left_count += bins.bins[axis][i].count;
+        if (left_count == 0 || left_count == count) continue;
+        const float cost = area(left) * static_cast<float>(left_count) + right_costs[i + 1];
+        if (cost < best_cost) {
+          best_cost = cost;
+          best_axis = axis;
+          best_split = i;
+        }
+      }
+    }
+
+    const float split_cost = traversal_cost + best_cost / std::max(area(box), std::numeric_limits<float>::min());
+    if (count <= max_leaf_objects && static_cast<float>(count) <= split_cost) {
+      return make_leaf(index, first, count, box);
+    }
+    if (best_axis < 0) return split_at_median(index, first, count, box, centres, depth);
+
+    const auto middle = std::partition(items.begin() + first, items.begin() + first + count,
+                                       [&](const build_item &item) {
+                                         return mapping.bin_of(item.centre(), best_axis) <= best_split;
+                                       });
+    aabb children[2][2] = {{empty_box(), empty_box()}, {empty_box(), empty_box()}};
+    for (int32_t i = 0; i < bin_count; ++i) {
+      const bin &source = bins.bins[best_axis][i];
+      grow(children[i <= best_split ? 0 : 1][0], source.box);
+      grow(children[i <= best_split ? 0 : 1][1], source.centres);
+    }
+    split(index, first, count, box, static_cast<uint32_t>(middle - (items.begin() + first)), children, depth);
+  }
+};
+
+uint32_t bvh::add(const glm::vec3 &min, const glm::vec3 &max) {
+  bounds_.push_back({min, max});
+  return static_cast<uint32_t>(bounds_.size() - 1);
+}
+
+void bvh::clear() {
+  bounds_.clear();
+  nodes_.clear();
+  parents_.clear();
+  heights_.clear();
+  leaf_objects_.clear();
+  leaf_bounds_.clear();
+  slots_.clear();
+  leaves_.clear();
+  moved_.clear();
+  stale_.clear();
+}
+
+void bvh::reserve(const size_t count) { bounds_.reserve(count); }
+
+void bvh::build() { build_tree(nullptr); }
+
+void bvh::build(thread_pool &pool) { build_tree(&pool); }
+
+void bvh::build_tree(thread_pool *pool) {
+  nodes_.clear();
+  moved_.clear();
+  if (bounds_.empty()) return;
+  const auto count = static_cast<uint32_t>(bounds_.size());
+
+  std::vector<build_item> items(count);
+  for (uint32_t i = 0; i < count; ++i) items[i] = {bounds_[i].min, i, bounds_[i].max, 0};
+  std::vector<node> built(2 * static_cast<size_t>(count) - 1);
+  builder tree{items, built, pool};
+
+  aabb box, centres;
+  tree.bounds_of(0, count, box, centres);
+  tree.build(0, 0, count, box, centres, 0);
+
+  // Depth first with siblings side by side, so a subtree's nodes are close together.
+  nodes_.reserve(tree.next_node);
+  parents_.assign(tree.next_node, 0);
+  heights_.assign(tree.next_node, 0);
+  nodes_.push_back(built[0]);
+  lay_out(built, 0, 0);
+
+  leaf_objects_.resize(count);
+  leaf_bounds_.resize(count);
+  slots_.resize(count);
+  leaves_.resize(count);
+  for (uint32_t i = 0; i < count; ++i) {
+    leaf_objects_[i] = items[i].object;
+    leaf_bounds_[i] = items[i].box();
+    slots_[items[i].object] = i;
+  }
+  for (uint32_t n = 0; n < nodes_.size(); ++n) {
+    const node &current = nodes_[n];
+    for (uint32_t i = current.first; current.count > 0 && i < current.first + current.count; ++i) {
+      leaves_[leaf_objects_[i]] = n;
+    }
+  }
+  stale_.assign(nodes_.size(), 0);
+}
+
+uint32_t bvh::lay_out(const std::vector<node> &built, const uint32_t from, const uint32_t to) {
+  if (built[from].count > 0) return 0;
+  const uint32_t children = static_cast<uint32_t>(nodes_.size());
+  nodes_.push_back(built[built[from].first]);
+  nodes_.push_back(built[built[from].first + 1]);
+  nodes_[to].first = children;
+  parents_[children] = parents_[children + 1] = to;
+  const uint32_t left = lay_out(built, built[from].first, children);
+  const uint32_t right = lay_out(built, built[from].first + 1, children + 1);
+  heights_[to] = static_cast<uint8_t>(1 + std::max(left, right));
+  return heights_[to];
+}
+
+void bvh::update(const uint32_t index, const glm::vec3 &min, const glm::vec3 &max) {
+  bounds_[index] = {min, max};
+  if (index < slots_.size()) moved_.push_back(index);
+}
+
+void bvh::refit() {
+  if (moved_.empty() || nodes_.empty()) return;
+  for (const uint32_t object : moved_) {
+    leaf_bounds_[slots_[object]] = bounds_[object];
+    for (uint32_t n = leaves_[object]; !stale_[n]; n = parents_[n]) {
+      stale_[n] = 1;
+      if (n == 0) break;
+    }
+  }
+  moved_.clear();
+  refit_node(0, 0);
+}
+
+void bvh::refit_node(const uint32_t index, const uint32_t depth) {
+  if (!stale_[index]) return;
+  stale_[index] = 0;
+
+  node &current = nodes_[index];
+  if (current.count > 0) {
+    aabb box = empty_box();
+    for (uint32_t i = current.first; i < current.first + current.count; ++i) grow(box, leaf_bounds_[i]);
+    current.min = box.min;
+    current.max = box.max;
+    return;
+  }
+
+  refit_node(current.first, depth + 1);
+  refit_node(current.first + 1, depth + 1);
+  rotate(index, depth);
+  const node &left = nodes_[current.first];
+  const node &right = nodes_[current.first + 1];
+  current.min = glm::min(left.min, right.min);
+  current.max = glm::max(left.max, right.max);
+  heights_[index] = static_cast<uint8_t>(1 + std::max(heights_[current.first], heights_[current.first + 1]));
+}
+
+// Tries swapping each child with each of its sibling's children and keeps the swap that shrinks the
+// sibling the most, as long as the tree stays within max_height.
+void bvh::rotate(const uint32_t index, const uint32_t depth) {
+  const uint32_t children = nodes_[index].first;
+  const auto box_of = [&](const uint32_t n) { return aabb{nodes_[n].min, nodes_[n].max}; };
+
+  float best_gain = 0.0f;
+  uint32_t best_child = 0, best_grandchild = 0;
+  for (uint32_t side = 0; side < 2; ++side) {
+    const uint32_t child = children + side;
+    const uint32_t sibling = children + 1 - side;
+    if (nodes_[sibling].count > 0) continue;
+
+    const float sibling_area = area(box_of(sibling));
+    for (uint32_t grand_side = 0; grand_side < 2; ++grand_side) {
+      const uint32_t grandchild = nodes_[sibling].first + grand_side;
+      const uint32_t kept = nodes_[sibling].first + 1 - grand_side;
+      const uint32_t sibling_height = 1u + std::max(heights_[child], heights_[kept]);
+      if (depth + 1 + std::max<uint32_t>(heights_[grandchild], sibling_height) > max_height) continue;
+
+      const float gain = sibling_area - area(merge(box_of(child), box_of(kept)));
+      if (gain > best_gain) {
+        best_gain = gain;
+        best_child = child;
+        best_grandchild = grandchild;
+      }
+    }
+  }
+  if (best_gain <= 0.0f) return;
+
+  swap_nodes(best_child, best_grandchild);
+  const uint32_t sibling = children + (best_child == children ? 1 : 0);
+  node &changed = nodes_[sibling];
+  const node &left = nodes_[changed.first];
+  const node &right = nodes_[changed.first + 1];
+  changed.min = glm::min(left.min, right.min);
+  changed.max = glm::max(left.max, right.max);
+  heights_[sibling] = static_cast<uint8_t>(1 + std::max(heights_[changed.first], heights_[changed.first + 1]));
+}
+
+// Exchanges two subtrees; their positions keep their parents.
+void bvh::swap_nodes(const uint32_t a, const uint32_t b) {
+  std::swap(nodes_[a], nodes_[b]);
+  std::swap(heights_[a], heights_[b]);
+  for (const uint32_t n : {a, b}) {
+    const node &moved = nodes_[n];
+    if (moved.count > 0) {
+      for (uint32_t i = moved.first; i < moved.first + moved.count; ++i) leaves_[leaf_objects_[i]] = n;
+    } else {
+      parents_[moved.first] = parents_[moved.first + 1] = n;
+    }
+  }
+}
+
+void bvh::query(const frustum &planes, std::vector<uint32_t> &found) const {
+  found.clear();
+  if (nodes_.empty()) return;
+
+  // Entries with the top bit set are subtrees already known to be inside every plane.
+  constexpr uint32_t inside = 1u << 31;
+  uint32_t stack[max_height + 2];
+  uint32_t depth = 0;
+  stack[depth++] = 0;
+  while (depth > 0) {
+    const uint32_t entry = stack[--depth];
+    const node &current = nodes_[entry & ~inside];
+    frustum_test test = frustum_test::inside;
+    if ((entry & inside) == 0) {
+      test = test_aabb(planes, current.min, current.max);
+      if (test == frustum_test::outside) continue;
+    }
+
+    if (current.count > 0) {
+      for (uint32_t i = current.first; i < current.first + current.count; ++i) {
+        if (test == frustum_test::inside ||
+            test_aabb(planes, leaf_bounds_[i].min, leaf_bounds_[i].max) != frustum_test::outside) {
+          found.push_back(leaf_objects_[i]);
+        }
+      }
+      continue;
+    }
+    const uint32_t flag = test == frustum_test::inside ? inside : 0;
+    stack[depth++] = current.first | flag;
+    stack[depth++] = (current.first + 1) | flag;
+  }
+}
+
+void bvh::query(const glm::vec3 &min, const glm::vec3 &max, std::vector<uint32_t> &found) const {
+  found.clear();
+  if (nodes_.empty()) return;
+
+  uint32_t stack[max_height + 2];
+  uint32_t depth = 0;
+  stack[depth++] = 0;
+  while (depth > 0) {
+    const node &current = nodes_[stack[--depth]];
+    if (!overlaps({current.min, current.max}, min, max)) continue;
+    if (current.count > 0) {
+      for (uint32_t i = current.first; i < current.first + current.count; ++i) {
+        if (overlaps(leaf_bounds_[i], min, max)) found.push_back(leaf_objects_[i]);
+      }
+      continue;
+    }
+    stack[depth++] = current.first;
+    stack[depth++] = current.first + 1;
+  }
+}
+
+bool bvh::raycast(const glm::vec3 &origin, const glm::vec3 &direction, const float max_distance,
+                  bvh_hit &hit) const {
+  return raycast(origin, direction, max_distance, hit, [](uint32_t, const float distance) { return distance; });
+}
+
+bool bvh::enter(const glm::vec3 &min, const glm::vec3 &max, const glm::vec3 &origin,
+                const glm::vec3 &inverse_direction, const float max_distance, float &distance) {
+  const glm::vec3 to_min = (min - origin) * inverse_direction;
+  const glm::vec3 to_max = (max - origin) * inverse_direction;
+  const glm::vec3 near_planes = glm::min(to_min, to_max);
+  const glm::vec3 far_planes = glm::max(to_min, to_max);
+  const float entry = std::max(std::max(near_planes.x, near_planes.y), std::max(near_planes.z, 0.0f));
+  const float exit = std::min(std::min(far_planes.x, far_planes.y), std::min(far_planes.z, max_distance));
+  distance = entry;
+  return entry <= exit;
+}
+
+bvh_stats bvh::stats() const {
+  bvh_stats result;
+  result.objects = bounds_.size();
+  result.nodes = nodes_.size();
+  if (nodes_.empty()) return result;
+  result.depth = heights_[0];
+
+  const float root_area = std::max(area({nodes_[0].min, nodes_[0].max}), std::numeric_limits<float>::min());
+  for (const node &current : nodes_) {
+    const float share = area({current.min, current.max}) / root_area;
+    if (current.count > 0) {
+      ++result.leaves;
+      result.sah_cost += share * static_cast<float>(current.count);
+    } else {
+      result.sah_cost += share * traversal_cost;
+    }
+  }
+  return result;
+}
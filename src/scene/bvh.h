@@ -0,0 +1,182 @@
+#ifndef BVH_H
+#define BVH_H
+
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include "../render/frustum.h"
+
+class thread_pool;
+
+struct aabb {
+  glm::vec3 min = glm::vec3(0.0f);
+  glm::vec3 max = glm::vec3(0.0f);
+};
+
+struct bvh_hit {
+  uint32_t object = 0;
+  float distance = 0.0f;  // along the ray, in units of its direction's length
+};
+
+struct bvh_stats {
+  size_t objects = 0;
+  size_t nodes = 0;
+  size_t leaves = 0;
+  uint32_t depth = 0;
+  // Expected cost of a random ray against the tree by the surface area heuristic, in node visits
+  // plus object tests; it grows as refits loosen the tree.
+  float sah_cost = 0.0f;
+};
+
+// A bounding volume hierarchy over object bounds for frustum, box and ray queries.
+//
+// build() splits the objects by the surface area heuristic, binning object centres into sixteen
+// bins per axis; with a pool the bins of large nodes are filled in parallel and the two halves of
+// every large node are built in parallel. The nodes are then laid out depth first in 32-byte records
+// with siblings side by side, so a node only needs the index of its first child, and leaves point at
+// a run of object bounds copied out in leaf order.
+//
+// Objects that move are update()d and refit() grows or shrinks their leaves and ancestors. On the
+// way back up it tries swapping a node with one of its grandchildren where that makes the sibling's
+// box smaller (Kensler's tree rotations), which keeps the tree from degrading under steady motion.
+// Objects added after build() are not found until the next build().
+class bvh {
+ public:
+  // Returns the new object's index, which queries report.
+  uint32_t add(const glm::vec3 &min, const glm::vec3 &max);
+  void clear();
+  void reserve(size_t count);
+
+  void build();
+  void build(thread_pool &pool);
+
+  // Moves object `index` to new bounds; queries see it once refit() has run.
+  void update(uint32_t index, const glm::vec3 &min, const glm::vec3 &max);
+  void refit();
+
+  [[nodiscard]] size_t size() const { return bounds_.size(); }
+  [[nodiscard]] bool empty() const { return bounds_.empty(); }
+  [[nodiscard]] const aabb &bounds(const uint32_t index) const { return bounds_[index]; }
+
+  // Replace `found` with the objects not entirely outside the frustum and those overlapping the box,
+  // in no particular order.
+  void query(const frustum &planes, std::vector<uint32_t> &found) const;
+  void query(const glm::vec3 &min, const glm::vec3 &max, std::vector<uint32_t> &found) const;
+
+  // The nearest object whose bounds the ray from `origin` along `direction` enters within
+  // `max_distance` (in units of the direction's length; a ray starting inside a box hits it at 0).
+  [[nodiscard]] bool raycast(const glm::vec3 &origin, const glm::vec3 &direction, float max_distance,
+                             bvh_hit &hit) const;
+  // The same, with `intersect(object, distance)` deciding where the ray really hits an object whose
+  // bounds it enters at `distance`: it returns the distance of the hit, or a negative value for a miss.
+  // Nodes are visited nearest first and skipped once they start beyond the nearest hit so far.
+  template <typename F>
+  bool raycast(const glm::vec3 &origin, const glm::vec3 &direction, float max_distance, bvh_hit &hit,
+               F &&intersect) const;
+
+  [[nodiscard]] bvh_stats stats() const;
+
+ private:
+  // A leaf when count > 0: its objects are leaf_objects_[first, first + count). Otherwise its
+  // children are nodes first and first + 1.
+  struct node {
+    glm::vec3 min;
+    uint32_t first;
+    glm::vec3 max;
+    uint32_t count;
+  };
+  static_assert(sizeof(node) == 32, "two nodes to a cache line");
+
+  // Queries keep a stack of at most one node per level; build() and refit() keep the tree within it.
+  static constexpr uint32_t max_height = 60;
+
+  struct builder;
+
+  void build_tree(thread_pool *pool);
+  uint32_t lay_out(const std::vector<node> &built, uint32_t from, uint32_t to);
+  void refit_node(uint32_t index, uint32_t depth);
+  void rotate(uint32_t index, uint32_t depth);
+  void swap_nodes(uint32_t a, uint32_t b);
+
+  // Whether the ray enters the box within `max_distance`, and where.
+  [[nodiscard]] static bool enter(const glm::vec3 &min, const glm::vec3 &max, const glm::vec3 &origin,
+                                  const glm::vec3 &inverse_direction, float max_distance, float &distance);
+
+  std::vector<aabb> bounds_;  // by object
+
+  std::vector<node> nodes_;  // the root first
+  std::vector<uint32_t> parents_;  // by node
+  std::vector<uint8_t> heights_;  // by node, 0 for leaves
+  std::vector<uint32_t> leaf_objects_;
+  std::vector<aabb> leaf_bounds_;  // bounds_ in leaf_objects_ order
+  std::vector<uint32_t> slots_;  // by object, where it is in leaf_objects_
+  std::vector<uint32_t> leaves_;  // by object, the leaf holding it
+
+  std::vector<uint32_t> moved_;  // objects updated since the last refit()
+  std::vector<uint8_t> stale_;  // by node, whether refit() must visit it
+};
+
+template <typename F>
+bool bvh::raycast(const glm::vec3 &origin, const glm::vec3 &direction, const float max_distance, bvh_hit &hit,
+                  F &&intersect) const {
+  const glm::vec3 inverse_direction = 1.0f / direction;
+  float nearest = max_distance;
+  float entry = 0.0f;
+  if (nodes_.empty() || !enter(nodes_[0].min, nodes_[0].max, origin, inverse_direction, nearest, entry)) return false;
+
+  bool found = false;
+  uint32_t stack[max_height + 2];
+  float entries[max_height + 2];
+  uint32_t depth = 0;
+  stack[depth] = 0;
+  entries[depth++] = entry;
+
+  while (depth > 0) {
+    --depth;
+    if (entries[depth] > nearest) continue;
+    const node &current = nodes_[stack[depth]];
+
+    if (current.count > 0) {
+      for (uint32_t i = current.first; i < current.first + current.count; ++i) {
+        const aabb &box = leaf_bounds_[i];
+        if (!enter(box.min, box.max, origin, inverse_direction, nearest, entry)) continue;
+        const float distance = intersect(leaf_objects_[i], entry);
+        if (distance >= 0.0f && distance <= nearest) {
+          nearest = distance;
+          hit.object = leaf_objects_[i];
+          hit.distance = distance;
+          found = true;
+        }
+      }
+      continue;
+    }
+
+    uint32_t near_child = current.first, far_child = current.first + 1;
+    float near_entry = 0.0f, far_entry = 0.0f;
+    const bool near_hit = enter(nodes_[near_child].min, nodes_[near_child].max, origin, inverse_direction, nearest,
+                                near_entry);
+    const bool far_hit = enter(nodes_[far_child].min, nodes_[far_child].max, origin, inverse_direction, nearest,
+                               far_entry);
+    if (near_hit && far_hit) {
+      if (far_entry < near_entry) {
+        std::swap(near_child, far_child);
+        std::swap(near_entry, far_entry);
+      }
+      // The far child goes on the stack first so the near one is popped next.
+      stack[depth] = far_child;
+      entries[depth++] = far_entry;
+      stack[depth] = near_child;
+      entries[depth++] = near_entry;
+    } else if (near_hit || far_hit) {
+      stack[depth] = near_hit ? near_child : far_child;
+      entries[depth++] = near_hit ? near_entry : far_entry;
+    }
+  }
+  return found;
+}
+
+#endif  // BVH_H
@@ -0,0 +1,438 @@
+#include "potentially_visible_set.h"
+
+#include <glm/gtc/constants.hpp>
+
+#include <algorithm>
+#include <bitset>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <unordered_map>
+
+#include "bvh.h"
+#include "../filesystem/atomic_file.h"
+#include "../filesystem/mapped_file.h"
+#include "../utility/hash.h"
+#include "../utility/thread_pool.h"
+
+namespace {
+
+constexpr char pvs_magic[8] = {'E', 'N', 'G', 'P', 'V', 'S', '\0', '\0'};
+constexpr uint32_t pvs_version = 1;
+
+// Bump whenever sampling changes so stale cache entries are rebuilt.
+constexpr uint32_t cache_version = 1;
+
+// Ray origins drawn per cell; its rays are shared out between the ones in free space.
+constexpr int32_t origins_per_cell = 64;
+
+struct pvs_header {
+  char magic[8];
+  uint32_t version;
+  uint32_t object_count;
+  int32_t cells[3];
+  float min[3];
+  float cell_size[3];
+  uint32_t set_count;
+  uint32_t byte_count;
+  uint32_t solid_cells;
+};
+
+void put_varint(size_t value, std::vector<uint8_t> &out) {
+  while (value >= 0x80) {
+    out.push_back(static_cast<uint8_t>(value | 0x80));
+    value >>= 7;
+  }
+  out.push_back(static_cast<uint8_t>(value));
+}
+
+bool get_varint(const uint8_t *&cursor, const uint8_t *end, size_t &value) {
+  value = 0;
+  for (int32_t shift = 0; cursor < end && shift < 64; shift += 7) {
+    const uint8_t byte = *cursor++;
+    value |= static_cast<size_t>(byte & 0x7f) << shift;
+    if ((byte & 0x80) == 0) return true;
+  }
+  return false;
+}
+
+// Alternating runs: a count of zero words, then a count of literal words and the words themselves.
+void encode(const std::vector<uint64_t> &bits, std::vector<uint8_t> &out) {
+  out.clear();
+  size_t word = 0;
+  while (word < bits.size()) {
+    size_t zeros = 0;
+    while (word + zeros < bits.size() && bits[word + zeros] == 0) ++zeros;
+    size_t literals = 0;
+    while (word + zeros + literals < bits.size() && bits[word + zeros + literals] != 0) ++literals;
+
+    put_varint(zeros, out);
+    put_varint(literals, out);
+    const size_t at = out.size();
+    out.resize(at + literals * sizeof(uint64_t));
+    std::memcpy(out.data() + at, bits.data() + word + zeros, literals * sizeof(uint64_t));
+    word += zeros + literals;
+  }
+}
+
+// False when the runs overflow `bits` or the data ends early.
+bool decode_runs(const uint8_t *cursor, const uint8_t *end, std::vector<uint64_t> &bits) {
+  size_t word = 0;
+  while (cursor < end) {
+    size_t zeros = 0, literals = 0;
+    if (!get_varint(cursor, end, zeros) || !get_varint(cursor, end, literals)) return false;
+    if (zeros > bits.size() - word || literals > bits.size() - word - zeros ||
+        literals > static_cast<size_t>(end - cursor) / sizeof(uint64_t)) {
+      return false;
+    }
+    word += zeros;
+    std::memcpy(bits.data() + word, cursor, literals * sizeof(uint64_t));
+    cursor += literals * sizeof(uint64_t);
+    word += literals;
+  }
+  return true;
+}
+
+// Möller-Trumbore, both faces; the distance along the ray or a negative value for a miss.
+float intersect_triangle(const glm::vec3 &origin, const glm::vec3 &direction, const glm::vec3 &a,
+                         const glm::vec3 &b, const glm::vec3 &c) {
+  const glm::vec3 edge_1 = b - a;
+  const glm::vec3 edge_2 = c - a;
+  const glm::vec3 p = glm::cross(direction, edge_2);
+  const float determinant = glm::dot(edge_1, p);
+  if (std::abs(determinant) < 1e-12f) return -1.0f;
+
+  const float inverse = 1.0f / determinant;
+  const glm::vec3 to_origin = origin - a;
+  const float u = glm::dot(to_origin, p) * inverse;
+  if (u < 0.0f || u > 1.0f) return -1.0f;
+  const glm::vec3 q = glm::cross(to_origin, edge_1);
+  const float v = glm::dot(direction, q) * inverse;
+  if (v < 0.0f || u + v > 1.0f) return -1.0f;
+  return glm::dot(edge_2, q) * inverse;
+}
+
+template <typename T>
+void write_vector(std::ofstream &file, const std::vector<T> &values) {
+  file.write(reinterpret_cast<const char *>(values.data()), static_cast<std::streamsize>(values.size() * sizeof(T)));
+}
+
+template <typename T>
+bool read_vector(const uint8_t *&cursor, const uint8_t *end, const size_t count, std::vector<T> &values) {
+  if (static_cast<size_t>(end - cursor) / sizeof(T) < count) return false;
+  values.resize(count);
+  std::memcpy(values.data(), cursor, count * sizeof(T));
+  cursor += count * sizeof(T);
+  return true;
+}
+
+}  // namespace
+
+void potentially_visible_set::build(const static_scene &scene, const pvs_settings &settings, thread_pool &pool) {
+  *this = {};
+  if (scene.empty() || glm::any(glm::lessThanEqual(settings.cell_size, glm::vec3(0.0f))) ||
+      glm::any(glm::lessThanEqual(settings.max, settings.min)) || settings.rays_per_cell < 1) {
+    return;
+  }
+
+  const auto start = std::chrono::steady_clock::now();
+  min_ = settings.min;
+  cell_size_ = settings.cell_size;
+  cells_ = glm::max(glm::ivec3(1), glm::ivec3(glm::ceil((settings.max - settings.min) / settings.cell_size)));
+  object_count_ = static_cast<uint32_t>(scene.objects.size());
+
+  bvh index;
+  index.reserve(scene.objects.size());
+  glm::vec3 scene_min = settings.min, scene_max = settings.max;
+  std::vector<glm::mat4> to_object;
+  to_object.reserve(scene.objects.size());
+  for (const static_object &object : scene.objects) {
+    index.add(object.min, object.max);
+    scene_min = glm::min(scene_min, object.min);
+    scene_max = glm::max(scene_max, object.max);
+    to_object.push_back(glm::inverse(object.model));
+  }
+  index.build(pool);
+  const float max_distance = glm::length(scene_max - scene_min);
+
+  // Rays are traced in each object's own space; distances along them carry over unchanged.
+  const auto intersect = [&](const uint32_t object, const glm::vec3 &origin, const glm::vec3 &direction) {
+    const glm::mat4 &inverse = to_object[object];
+    const glm::vec3 local_origin = glm::vec3(inverse * glm::vec4(origin, 1.0f));
+    const glm::vec3 local_direction = glm::mat3(inverse) * direction;
+    const static_mesh &mesh = scene.meshes[scene.objects[object].mesh];
+
+    float nearest = -1.0f;
+    for (size_t i = 0; i + 2 < mesh.indices.size(); i += 3) {
+      const float distance = intersect_triangle(local_origin, local_direction, mesh.vertices[mesh.indices[i]].position,
+                                                mesh.vertices[mesh.indices[i + 1]].position,
+                                                mesh.vertices[mesh.indices[i + 2]].position);
+      if (distance >= 0.0f && (nearest < 0.0f || distance < nearest)) nearest = distance;
+    }
+    return nearest;
+  };
+
+  const size_t words = (scene.objects.size() + 63) / 64;
+  const size_t cell_count = static_cast<size_t>(cells_.x) * cells_.y * cells_.z;
+  std::vector<std::vector<uint64_t>> sets(cell_count);
+  std::vector<uint8_t> solid(cell_count, 0);
+
+  pool.parallel_for(0, cell_count, [&](const size_t cell) {
+    std::vector<uint64_t> &bits = sets[cell];
+    bits.assign(words, 0);
+    const auto mark = [&](const uint32_t object) { bits[object / 64] |= uint64_t(1) << (object % 64); };
+
+    const glm::ivec3 coordinates(static_cast<int32_t>(cell % cells_.x),
+                                 static_cast<int32_t>(cell / (static_cast<size_t>(cells_.x) * cells_.z)),
+                                 static_cast<int32_t>(cell / cells_.x % cells_.z));
+    const glm::vec3 cell_min = min_ + glm::vec3(coordinates) * cell_size_;
+
+    std::vector<uint32_t> found;
+    index.query(cell_min, cell_min + cell_size_, found);
+    for (const uint32_t object : found) mark(object);
+
+    std::mt19937 random(settings.seed ^ static_cast<uint32_t>(cell * 0x9e3779b9u));
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+
+    std::vector<glm::vec3> origins;
+    for (int32_t i = 0; i < std::min(origins_per_cell, settings.rays_per_cell); ++i) {
+      const glm::vec3 origin = cell_min + glm::vec3(unit(random), unit(random), unit(random)) * cell_size_;
+      index.query(origin, origin, found);
+      if (found.empty()) origins.push_back(origin);
+    }
+    if (origins.empty()) {
+      solid[cell] = 1;
+      return;
+    }
+
+    const auto trace = [&](const glm::vec3 &origin, const glm::vec3 &direction, const float distance, bvh_hit &hit) {
+      return index.raycast(origin, direction, distance, hit, [&](const uint32_t object, float) {
+        return intersect(object, origin, direction);
+      });
+    };
+
+    bvh_hit hit;
+    for (int32_t ray = 0; ray < settings.rays_per_cell; ++ray) {
+      const glm::vec3 &origin = origins[static_cast<size_t>(ray) % origins.size()];
+      const float z = 1.0f - 2.0f * unit(random);
+      const float angle = glm::two_pi<float>() * unit(random);
+      const float radius = std::sqrt(std::max(0.0f, 1.0f - z * z));
+      if (trace(origin, glm::vec3(radius * std::cos(angle), radius * std::sin(angle), z), max_distance, hit)) {
+        mark(hit.object);
+      }
+    }
+
+    // Small and distant objects fall between the random rays, so the ones still missing are aimed
+    // at: rays from the free points to random points in their bounds, until one reaches them first.
+    for (uint32_t object = 0; object < object_count_; ++object) {
+      if (contains(bits, object)) continue;
+      const aabb &bounds = index.bounds(object);
+      for (int32_t ray = 0; ray < settings.rays_per_object; ++ray) {
+        const glm::vec3 &origin = origins[(static_cast<size_t>(object) + ray) % origins.size()];
+        const glm::vec3 target = bounds.min + glm::vec3(unit(random), unit(random), unit(random)) *
+                                                  (bounds.max - bounds.min);
+        // Past the target, so a ray that reaches the object is not cut short before its far side.
+        if (trace(origin, target - origin, 2.0f, hit) && hit.object == object) {
+          mark(object);
+          break;
+        }
+      }
+    }
+  });
+
+  // A camera anywhere in a cell sees about what its neighbours' samples saw, so the sets are widened
+  // by those of the cells around them; that covers most of what the cell's own rays slipped past.
+  std::vector<std::vector<uint64_t>> widened(cell_count);
+  pool.parallel_for(0, cell_count, [&](const size_t cell) {
+    const glm::ivec3 coordinates(static_cast<int32_t>(cell % cells_.x),
+                                 static_cast<int32_t>(cell / (static_cast<size_t>(cells_.x) * cells_.z)),
+                                 static_cast<int32_t>(cell / cells_.x % cells_.z));
+    widened[cell] = sets[cell];
+    for (int32_t y = std::max(0, coordinates.y - 1); y <= std::min(cells_.y - 1, coordinates.y + 1); ++y) {
+      for (int32_t z = std::max(0, coordinates.z - 1); z <= std::min(cells_.z - 1, coordinates.z + 1); ++z) {
+        for (int32_t x = std::max(0, coordinates.x - 1); x <= std::min(cells_.x - 1, coordinates.x + 1); ++x) {
+          const std::vector<uint64_t> &neighbour = sets[x + static_cast<size_t>(cells_.x) * (z + cells_.z * y)];
+          for (size_t word = 0; word < words; ++word) widened[cell][word] |= neighbour[word];
+        }
+      }
+    }
+  });
+
+  store(widened);
+  solid_cells_ = static_cast<size_t>(std::count(solid.begin(), solid.end(), uint8_t(1)));
+  build_ms_ = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+void potentially_visible_set::store(const std::vector<std::vector<uint64_t>> &sets) {
+  cell_sets_.clear();
+  set_offsets_.assign(1, 0);
+  data_.clear();
+
+  std::unordered_map<uint64_t, std::vector<uint32_t>> by_hash;
+  std::vector<uint8_t> encoded;
+  for (const std::vector<uint64_t> &bits : sets) {
+    encode(bits, encoded);
+    std::vector<uint32_t> &candidates = by_hash[fnv1a_64(encoded.data(), encoded.size())];
+    const auto same = std::find_if(candidates.begin(), candidates.end(), [&](const uint32_t set) {
+      return set_offsets_[set + 1] - set_offsets_[set] == encoded.size() &&
+             std::equal(encoded.begin(), encoded.end(), data_.begin() + set_offsets_[set]);
+    });
+    if (same != candidates.end()) {
+      cell_sets_.push_back(*same);
+      continue;
+    }
+
+    const auto set = static_cast<uint32_t>(set_offsets_.size() - 1);
+    candidates.push_back(set);
+    cell_sets_.push_back(set);
+    data_.insert(data_.end(), encoded.begin(), encoded.end());
+    set_offsets_.push_back(static_cast<uint32_t>(data_.size()));
+  }
+}
+
+uint32_t potentially_visible_set::find_cell(const glm::vec3 &position) const {
+  if (empty()) return no_cell;
+  const glm::ivec3 coordinates(glm::floor((position - min_) / cell_size_));
+  if (glm::any(glm::lessThan(coordinates, glm::ivec3(0))) || glm::any(glm::greaterThanEqual(coordinates, cells_))) {
+    return no_cell;
+  }
+  return static_cast<uint32_t>(coordinates.x + cells_.x * (coordinates.z + cells_.z * coordinates.y));
+}
+
+void potentially_visible_set::decode(const uint32_t cell, std::vector<uint64_t> &bits) const {
+  bits.assign((object_count_ + 63) / 64, 0);
+  const uint32_t set = cell_sets_[cell];
+  decode_runs(data_.data() + set_offsets_[set], data_.data() + set_offsets_[set + 1], bits);
+}
+
+bool potentially_visible_set::write(const std::filesystem::path &path) const {
+  return mfsys::write_file_atomically(path, [&](const std::filesystem::path &temporary) {
+    std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+    if (!file) return false;
+
+    pvs_header header{};
+    std::memcpy(header.magic, pvs_magic, sizeof(pvs_magic));
+    header.version = pvs_version;
+    header.object_count = object_count_;
+    for (int32_t axis = 0; axis < 3; ++axis) {
+      header.cells[axis] = cells_[axis];
+      header.min[axis] = min_[axis];
+      header.cell_size[axis] = cell_size_[axis];
+    }
+    header.set_count = static_cast<uint32_t>(set_offsets_.size() - 1);
+    header.byte_count = static_cast<uint32_t>(data_.size());
+    header.solid_cells = static_cast<uint32_t>(solid_cells_);
+    file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    write_vector(file, cell_sets_);
+    write_vector(file, set_offsets_);
+    write_vector(file, data_);
+    return static_cast<bool>(file);
+  });
+}
+
+bool potentially_visible_set::read(const std::filesystem::path &path) {
+  *this = {};
+
+  const mfsys::mapped_file file(path);
+  if (!file.is_open() || file.size() < sizeof(pvs_header)) return false;
+
+  pvs_header header{};
+  std::memcpy(&header, file.data(), sizeof(header));
+  if (std::memcmp(header.magic, pvs_magic, sizeof(pvs_magic)) != 0 || header.version != pvs_version) return false;
+  const glm::ivec3 cells(header.cells[0], header.cells[1], header.cells[2]);
+  const glm::vec3 cell_size(header.cell_size[0], header.cell_size[1], header.cell_size[2]);
+  if (glm::any(glm::lessThan(cells, glm::ivec3(1))) || glm::any(glm::greaterThan(cells, glm::ivec3(1 << 16))) ||
+      !glm::all(glm::greaterThan(cell_size, glm::vec3(0.0f)))) {
+    return false;
+  }
+
+  potentially_visible_set set;
+  set.min_ = glm::vec3(header.min[0], header.min[1], header.min[2]);
+  set.cell_size_ = cell_size;
+  set.cells_ = cells;
+  set.object_count_ = header.object_count;
+  set.solid_cells_ = header.solid_cells;
+  const uint8_t *cursor = file.data() + sizeof(header);
+  const uint8_t *end = file.data() + file.size();
+  if (!read_vector(cursor, end, static_cast<size_t>(cells.x) * cells.y * cells.z, set.cell_sets_) ||
+      !read_vector(cursor, end, static_cast<size_t>(header.set_count) + 1, set.set_offsets_) ||
+      !read_vector(cursor, end, header.byte_count, set.data_)) {
+    return false;
+  }
+
+  if (set.set_offsets_.front() != 0 || set.set_offsets_.back() != set.data_.size()) return false;
+  std::vector<uint64_t> bits((set.object_count_ + 63) / 64);
+  for (uint32_t i = 0; i < header.set_count; ++i) {
+    const uint32_t first = set.set_offsets_[i], last = set.set_offsets_[i + 1];
+    if (first > last || !decode_runs(set.data_.data() + first, set.data_.data() + last, bits)) return false;
+  }
+  for (const uint32_t index : set.cell_sets_) {
+    if (index >= header.set_count) return false;
+  }
+
+  *this = std::move(set);
+  return true;
+}
+
+pvs_stats potentially_visible_set::stats() const {
+  pvs_stats result;
+  result.cells = cell_sets_.size();
+  result.solid_cells = solid_cells_;
+  result.objects = object_count_;
+  result.unique_sets = set_offsets_.empty() ? 0 : set_offsets_.size() - 1;
+  result.raw_bytes = result.cells * ((object_count_ + 63) / 64) * sizeof(uint64_t);
+  result.stored_bytes = cell_sets_.size() * sizeof(uint32_t) + set_offsets_.size() * sizeof(uint32_t) + data_.size();
+  result.build_ms = build_ms_;
+  if (result.cells == 0) return result;
+
+  // Counted per unique set, weighted by the cells sharing it.
+  std::vector<size_t> users(result.unique_sets, 0);
+  for (const uint32_t set : cell_sets_) ++users[set];
+  std::vector<uint64_t> bits((object_count_ + 63) / 64);
+  size_t visible = 0;
+  for (size_t set = 0; set < result.unique_sets; ++set) {
+    std::fill(bits.begin(), bits.end(), 0);
+    decode_runs(data_.data() + set_offsets_[set], data_.data() + set_offsets_[set + 1], bits);
+    size_t count = 0;
+    for (const uint64_t word : bits) count += std::bitset<64>(word).count();
+    visible += count * users[set];
+  }
+  result.average_visible = static_cast<double>(visible) / static_cast<double>(result.cells);
+  return result;
+}
+
+void potentially_visible_set::print_stats(std::ostream &out) const {
+  const pvs_stats current = stats();
+  out << std::fixed << std::setprecision(2) << "pvs: " << current.cells << " cells (" << current.solid_cells
+      << " solid) over " << current.objects << " objects, " << current.average_visible
+      << " potentially visible per cell, " << current.unique_sets << " unique sets in "
+      << static_cast<double>(current.stored_bytes) / 1024.0 << " KiB (raw bitsets "
+      << static_cast<double>(current.raw_bytes) / 1024.0 << " KiB)";
+  if (current.build_ms > 0.0) out << ", baked in " << current.build_ms << " ms";
+  out << std::endl;
+}
+
+potentially_visible_set cook_pvs(const static_scene &scene, const pvs_settings &settings,
+                                 const std::filesystem::path &cache_directory, thread_pool &pool) {
+  const uint32_t parameters[4] = {cache_version, static_cast<uint32_t>(settings.rays_per_cell),
+                                  static_cast<uint32_t>(settings.rays_per_object), settings.seed};
+  uint64_t key = fnv1a_64(parameters, sizeof(parameters), hash_static_scene(scene));
+  const glm::vec3 space[3] = {settings.min, settings.max, settings.cell_size};
+  key = fnv1a_64(space, sizeof(space), key);
+  const std::filesystem::path cached = cache_directory / (hash_to_hex(key) + ".pvs");
+
+  potentially_visible_set set;
+  if (set.read(cached)) return set;
+
+  set.build(scene, settings, pool);
+  if (set.empty()) return set;
+
+  if (!set.write(cached)) std::cout << "Failed to write the PVS: " << cached << std::endl;
+  std::cout << "Baked the PVS of " << set.stats().cells << " cells over " << scene.objects.size()
+            << " objects into " << cached.filename() << " in " << set.stats().build_ms << " ms" << std::endl;
+  return set;
+}
@@ -0,0 +1,102 @@
+#ifndef POTENTIALLY_VISIBLE_SET_H
+#define POTENTIALLY_VISIBLE_SET_H
+
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <iosfwd>
+#include <limits>
+#include <vector>
+
+#include "../hlod/static_scene.h"
+
+class thread_pool;
+
+struct pvs_settings {
+  // The space the camera moves through, split into cells of `cell_size`; sets are only baked for
+  // cells inside it.
+  glm::vec3 min = glm::vec3(0.0f);
+  glm::vec3 max = glm::vec3(0.0f);
+  glm::vec3 cell_size = glm::vec3(4.0f);
+  int32_t rays_per_cell = 4096;
+  int32_t rays_per_object = 16;  // aimed at each object the random rays missed
+  uint32_t seed = 1;
+};
+
+struct pvs_stats {
+  size_t cells = 0;
+  size_t solid_cells = 0;  // with no free space to sample, holding only the objects overlapping them
+  size_t objects = 0;
+  size_t unique_sets = 0;
+  size_t raw_bytes = 0;  // a full bitset per cell
+  size_t stored_bytes = 0;
+  double average_visible = 0.0;  // objects per cell
+  double build_ms = 0.0;  // 0 when read from a file
+};
+
+// The objects of a static_scene that may be seen from each cell of a grid over the navigable
+// space, baked offline so walking through the scene needs no occlusion work per frame: the camera's
+// cell is found in constant time and its set decoded once when the camera enters it, and only the
+// frustum test is left for the frame.
+//
+// build() casts rays_per_cell rays from each cell in uniformly random directions, each from a random
+// point of the cell's free space (outside every object's bounds), and traces them against the
+// objects' triangles through a bvh over their bounds. Every object a ray hits first goes in the
+// cell's set, as does every object whose bounds overlap the cell. Each object still missing then
+// gets up to rays_per_object rays aimed at random points in its bounds, and finally every set is
+// widened by its neighbours'. Cells are baked in parallel on the pool. The sets are sampled rather
+// than exact: an object seen only through a gap narrower than the spacing of the rays that reach it
+// can be missed, so more rays suit scenes with small openings.
+//
+// Each set is a bitset over the objects, stored as alternating runs of zero and of literal 64-bit
+// words with varint lengths. Neighbouring cells often see exactly the same objects, so identical
+// sets are stored once and cells index them.
+class potentially_visible_set {
+ public:
+  static constexpr uint32_t no_cell = std::numeric_limits<uint32_t>::max();
+
+  void build(const static_scene &scene, const pvs_settings &settings, thread_pool &pool);
+
+  [[nodiscard]] bool empty() const { return cell_sets_.empty(); }
+  [[nodiscard]] size_t object_count() const { return object_count_; }
+
+  // The cell holding `position`, or no_cell outside the baked space.
+  [[nodiscard]] uint32_t find_cell(const glm::vec3 &position) const;
+
+  // Replaces `bits` with the set of `cell`: bit i of word i / 64 for object i.
+  void decode(uint32_t cell, std::vector<uint64_t> &bits) const;
+  [[nodiscard]] static bool contains(const std::vector<uint64_t> &bits, const uint32_t object) {
+    return (bits[object / 64] >> (object % 64) & 1u) != 0;
+  }
+
+  [[nodiscard]] bool write(const std::filesystem::path &path) const;
+  // Leaves the set empty and returns false when `path` cannot be read or is not a PVS file.
+  [[nodiscard]] bool read(const std::filesystem::path &path);
+
+  [[nodiscard]] pvs_stats stats() const;
+  void print_stats(std::ostream &out) const;
+
+ private:
+  void store(const std::vector<std::vector<uint64_t>> &sets);
+
+  glm::vec3 min_ = glm::vec3(0.0f);
+  glm::vec3 cell_size_ = glm::vec3(1.0f);
+  glm::ivec3 cells_ = glm::ivec3(0);
+  uint32_t object_count_ = 0;
+
+  std::vector<uint32_t> cell_sets_;  // by cell, x fastest then z then y
+  std::vector<uint32_t> set_offsets_;  // into data_, one past the last set too
+  std::vector<uint8_t> data_;
+
+  size_t solid_cells_ = 0;
+  double build_ms_ = 0.0;
+};
+
+// Like cook_hlod(): reads the sets for `scene` from `cache_directory`, baking and writing them
+// first when the scene or settings changed.
+[[nodiscard]] potentially_visible_set cook_pvs(const static_scene &scene, const pvs_settings &settings,
+                                               const std::filesystem::path &cache_directory, thread_pool &pool);
+
+#endif  // POTENTIALLY_VISIBLE_SET_H
@@ -1,83 +1,74 @@
 #include "shader.h"
 
-#include <sstream>
+#include <initializer_list>
 #include <iostream>
+#include <sstream>
 
-shader::shader(const std::string &vertexPath, const std::string &fragmentPath) {
-  std::string vertexCode;
-  std::string fragmentCode;
-
-  std::ifstream vShaderFile;
-  std::ifstream fShaderFile;
-
-  // * This ensures that ifstream objects can throw exceptions
-  vShaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
-  fShaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
+namespace {
 
+std::string read_source(const std::string &path) {
+  std::ifstream file;
+  file.exceptions(std::ifstream::failbit | std::ifstream::badbit);
   try {
-    vShaderFile.open(vertexPath);
-    fShaderFile.open(fragmentPath);
-
-    std::stringstream vShaderStream, fShaderStream;
-
-    vShaderStream << vShaderFile.rdbuf();
-    fShaderStream << fShaderFile.rdbuf();
-
-    vShaderFile.close();
-    fShaderFile.close();
-
-    vertexCode = vShaderStream.str();
-    fragmentCode = fShaderStream.str();
+    file.open(path);
+    std::stringstream stream;
+    stream << file.rdbuf();
+    return stream.str();
   } catch (std::ifstream::failure const &) {
-    // ! Here we throw an exception
     std::cout << "ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ" << std::endl;
   }
+  return {};
+}
 
-  const char *vShaderCode = vertexCode.c_str();
-  const char *fShaderCode = fragmentCode.c_str();
+uint32_t compile_stage(const GLenum stage, const std::string &code, const char *stage_name) {
+  const char *source = code.c_str();
+  const uint32_t id = glCreateShader(stage);
+  glShaderSource(id, 1, &source, nullptr);
+  glCompileShader(id);
 
-  uint32_t vertex, fragment;
   int32_t success;
-  char infoLog[512];
-
-  // Vertex shader --------------------------------------------------------------------
-  vertex = glCreateShader(GL_VERTEX_SHADER);
-  glShaderSource(vertex, 1, &vShaderCode, nullptr);
-  glCompileShader(vertex);
-
-  // Print compile errors
-  glGetShaderiv(vertex, GL_COMPILE_STATUS, &success);
+  glGetShaderiv(id, GL_COMPILE_STATUS, &success);
   if (!success) {
-    glGetShaderInfoLog(vertex, 512, nullptr, infoLog);
-    std::cout << "ERROR::SHADER::VERTEX::COMPILATION_FAILED\n" << infoLog << std::endl;
+    char infoLog[512];
+    glGetShaderInfoLog(id, 512, nullptr, infoLog);
+    std::cout << "ERROR::SHADER::" << stage_name << "::COMPILATION_FAILED\n" << infoLog << std::endl;
   }
+  return id;
+}
 
-  // Fragment shader ------------------------------------------------------------------
-  fragment = glCreateShader(GL_FRAGMENT_SHADER);
-  glShaderSource(fragment, 1, &fShaderCode, nullptr);
-  glCompileShader(fragment);
+// Links the compiled `stages` into a program, then deletes them.
+uint32_t link_program(const std::initializer_list<uint32_t> stages) {
+  const uint32_t id = glCreateProgram();
+  for (const uint32_t stage : stages) glAttachShader(id, stage);
+  glLinkProgram(id);
 
-  // Print compile errors
-  glGetShaderiv(fragment, GL_COMPILE_STATUS, &success);
+  int32_t success;
+  glGetProgramiv(id, GL_LINK_STATUS, &success);
   if (!success) {
-    glGetShaderInfoLog(fragment, 512, nullptr, infoLog);
-    std::cout << "ERROR::SHADER::FRAGMENT::COMPILATION_FAILED\n" << infoLog << std::endl;
+    char infoLog[512];
+    glGetProgramInfoLog(id, 512, nullptr, infoLog);
+    std::cout << "ERROR::PROGRAM::LINKING_FAILED\n" << infoLog << std::endl;
   }
 
-  // shader program -------------------------------------------------------------------
-  ID = glCreateProgram();
-  glAttachShader(ID, vertex);
-  glAttachShader(ID, fragment);
-  glLinkProgram(ID);
+  for (const uint32_t stage : stages) glDeleteShader(stage);
+  return id;
+}
 
-  glGetProgramiv(ID, GL_LINK_STATUS, &success);
-  if (!success) {
-    glGetProgramInfoLog(ID, 512, nullptr, infoLog);
-    std::cout << "ERROR::PROGRAM::LINKING_FAILED\n" << infoLog << std::endl;
-  }
+}  // namespace
+
+shader::shader(const std::string &vertexPath, const std::string &fragmentPath) {
+  ID = link_program({compile_stage(GL_VERTEX_SHADER, read_source(vertexPath), "VERTEX"),
+                     compile_stage(GL_FRAGMENT_SHADER, read_source(fragmentPath), "FRAGMENT")});
+}
+
+shader::shader(const std::string &vertexPath, const std::string &geometryPath, const std::string &fragmentPath) {
+  ID = link_program({compile_stage(GL_VERTEX_SHADER, read_source(vertexPath), "VERTEX"),
+                     compile_stage(GL_GEOMETRY_SHADER, read_source(geometryPath), "GEOMETRY"),
+                     compile_stage(GL_FRAGMENT_SHADER, read_source(fragmentPath), "FRAGMENT")});
+}
 
-  glDeleteShader(vertex);
-  glDeleteShader(fragment);
+shader::shader(const std::string &computePath) {
+  ID = link_program({compile_stage(GL_COMPUTE_SHADER, read_source(computePath), "COMPUTE")});
 }
 
 shader::shader(const shader &shader) { ID = shader.ID; }
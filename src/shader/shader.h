@@ -12,6 +12,12 @@ class shader {
  public:
   shader(const std::string &vertexPath, const std::string &fragmentPath);
 
+  // A program with a geometry shader between the vertex and the fragment shader.
+  shader(const std::string &vertexPath, const std::string &geometryPath, const std::string &fragmentPath);
+
+  // A compute program. Compute shaders need GL 4.3, so not on the macOS 4.1 core profile.
+  explicit shader(const std::string &computePath);
+
   shader(const shader &shader);
 
   ~shader();
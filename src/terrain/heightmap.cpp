@@ -0,0 +1,139 @@
+#include "heightmap.h"
+
+#include "stb_image.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "../texture/image.h"
+#include "../utility/thread_pool.h"
+
+namespace {
+
+uint32_t hash(uint32_t x, uint32_t y, const uint32_t seed) {
+  uint32_t h = x * 0x8da6b343u ^ y * 0xd8163841u ^ seed * 0xcb1ab31fu;
+  h ^= h >> 16;
+  h *= 0x7feb352du;
+  h ^= h >> 15;
+  h *= 0x846ca68bu;
+  h ^= h >> 16;
+  return h;
+}
+
+float fade(const float t) { return t * t * t * (t * (t * 6.0f - 15.0f) + 10.0f); }
+
+// One of eight unit gradients, dotted with the offset to the lattice point.
+float gradient(const int32_t x, const int32_t y, const uint32_t seed, const float dx, const float dy) {
+  constexpr float diagonal = 0.70710678f;
+  constexpr float directions[8][2] = {{1.0f, 0.0f},           {-1.0f, 0.0f},          {0.0f, 1.0f},
+                                      {0.0f, -1.0f},          {diagonal, diagonal},   {-diagonal, diagonal},
+                                      {diagonal, -diagonal},  {-diagonal, -diagonal}};
+  const float *direction = directions[hash(static_cast<uint32_t>(x), static_cast<uint32_t>(y), seed) & 7u];
+  return direction[0] * dx + direction[1] * dy;
+}
+
+// Perlin gradient noise, roughly in [-1, 1].
+float noise(const float x, const float y, const uint32_t seed) {
+  const float fx = std::floor(x), fy = std::floor(y);
+  const auto ix = static_cast<int32_t>(fx), iy = static_cast<int32_t>(fy);
+  const float dx = x - fx, dy = y - fy;
+  const float u = fade(dx), v = fade(dy);
+
+  const float a = gradient(ix, iy, seed, dx, dy);
+  const float b = gradient(ix + 1, iy, seed, dx - 1.0f, dy);
+  const float c = gradient(ix, iy + 1, seed, dx, dy - 1.0f);
+  const float d = gradient(ix + 1, iy + 1, seed, dx - 1.0f, dy - 1.0f);
+  return 1.41421356f * (a + (b - a) * u + (c - a) * v + (a - b - c + d) * u * v);
+}
+
+// Ridged multifractal: sharp crests where the noise crosses zero, smoother valleys, and finer
+// octaves damped on low ground.
+float ridged(const float x, const float y, const int32_t octaves, const uint32_t seed) {
+  float sum = 0.0f, amplitude = 0.5f, frequency = 1.0f, weight = 1.0f, total = 0.0f;
+  for (int32_t octave = 0; octave < octaves; ++octave) {
+    float ridge = 1.0f - std::abs(noise(x * frequency, y * frequency, seed + static_cast<uint32_t>(octave)));
+    ridge *= ridge;
+    ridge *= weight;
+    weight = std::clamp(ridge * 2.0f, 0.0f, 1.0f);
+
+    sum += ridge * amplitude;
+    total += amplitude;
+    amplitude *= 0.5f;
+    frequency *= 2.0f;
+  }
+  return sum / total;
+}
+
+float smoothstep(const float edge0, const float edge1, const float x) {
+  const float t = std::clamp((x - edge0) / (edge1 - edge0), 0.0f, 1.0f);
+  return t * t * (3.0f - 2.0f * t);
+}
+
+}  // namespace
+
+uint16_t heightmap::at(const int32_t x, const int32_t y) const {
+  return samples[static_cast<size_t>(std::clamp(y, 0, height - 1)) * width + std::clamp(x, 0, width - 1)];
+}
+
+bool decode_heightmap(const uint8_t *bytes, const size_t size, heightmap &out) {
+  out = heightmap();
+
+  int32_t width, height, components;
+  if (stbi_is_16_bit_from_memory(bytes, static_cast<int>(size))) {
+    stbi_us *data = stbi_load_16_from_memory(bytes, static_cast<int>(size), &width, &height, &components, 1);
+    if (data == nullptr) return false;
+    out.samples.assign(data, data + static_cast<size_t>(width) * height);
+    stbi_image_free(data);
+  } else {
+    stbi_uc *data = stbi_load_from_memory(bytes, static_cast<int>(size), &width, &height, &components, 1);
+    if (data == nullptr) return false;
+    out.samples.resize(static_cast<size_t>(width) * height);
+    std::transform(data, data + out.samples.size(), out.samples.begin(),
+                   [](const stbi_uc value) { return static_cast<uint16_t>(value * 257); });
+    stbi_image_free(data);
+  }
+
+  out.width = width;
+  out.height = height;
+  return true;
+}
+
+heightmap load_heightmap(const std::string &path) {
+  heightmap result;
+
+  const std::vector<uint8_t> bytes = read_file_bytes(path);
+  if (!bytes.empty()) (void) decode_heightmap(bytes.data(), bytes.size(), result);
+
+  return result;
+}
+
+heightmap generate_heightmap(const heightmap_generator_settings &settings, thread_pool &pool) {
+  heightmap result;
+  result.width = settings.size;
+  result.height = settings.size;
+  result.samples.resize(static_cast<size_t>(settings.size) * settings.size);
+
+  const float scale = 1.0f / settings.feature_size;
+  const float centre = static_cast<float>(settings.size) * 0.5f;
+
+  pool.parallel_for(0, static_cast<size_t>(settings.size), [&](const size_t row) {
+    const auto y = static_cast<float>(row);
+    for (int32_t column = 0; column < settings.size; ++column) {
+      const auto x = static_cast<float>(column);
+
+      // Warping the domain with low-frequency noise bends the ridges into less regular shapes.
+      const float warp_x = noise(x * scale * 0.5f, y * scale * 0.5f, settings.seed ^ 0x51ed27u);
+      const float warp_y = noise(x * scale * 0.5f + 5.2f, y * scale * 0.5f + 1.3f, settings.seed ^ 0x2545f4u);
+      float value = ridged(x * scale + warp_x * 0.6f, y * scale + warp_y * 0.6f, settings.octaves, settings.seed);
+
+      const float distance = std::hypot(x - centre, y - centre);
+      value = settings.flat_height +
+              (value - settings.flat_height) * smoothstep(settings.flat_radius, settings.flat_radius * 4.0f, distance);
+
+      result.samples[row * settings.size + column] =
+          static_cast<uint16_t>(std::clamp(value, 0.0f, 1.0f) * 65535.0f + 0.5f);
+    }
+  }, 16);
+
+  return result;
+}
@@ -0,0 +1,38 @@
+#ifndef HEIGHTMAP_H
+#define HEIGHTMAP_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+class thread_pool;
+
+// A grid of 16-bit heights, 0 to 65535 for the lowest to highest point the terrain can have.
+struct heightmap {
+  int32_t width = 0;
+  int32_t height = 0;
+  std::vector<uint16_t> samples;
+
+  [[nodiscard]] bool empty() const { return samples.empty(); }
+  // Clamped to the edges.
+  [[nodiscard]] uint16_t at(int32_t x, int32_t y) const;
+};
+
+struct heightmap_generator_settings {
+  int32_t size = 4096;
+  uint32_t seed = 1;
+  int32_t octaves = 9;
+  float feature_size = 1024.0f;  // samples across the largest features
+  // A flat disc of this radius (in samples) at flat_height stays around the centre.
+  float flat_radius = 64.0f;
+  float flat_height = 0.15f;
+};
+
+// Decodes a greyscale heightmap. 16-bit PNGs keep their precision; 8-bit images are widened.
+[[nodiscard]] bool decode_heightmap(const uint8_t *bytes, size_t size, heightmap &out);
+[[nodiscard]] heightmap load_heightmap(const std::string &path);
+
+// Ridged fractal noise with domain warping, for scenes without a heightmap asset.
+[[nodiscard]] heightmap generate_heightmap(const heightmap_generator_settings &settings, thread_pool &pool);
+
+#endif  // HEIGHTMAP_H
@@ -0,0 +1,394 @@
+#include "terrain.h"
+
+#include <glad/glad.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+
+#include "../shader/shader.h"
+#include "../utility/thread_pool.h"
+
+namespace {
+
+constexpr GLuint node_location = 1;
+constexpr GLuint morph_location = 2;
+
+template <typename T>
+bool is_finished(const std::future<T> &future) {
+  return future.valid() && future.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+}
+
+int32_t key_level(const uint32_t key) { return static_cast<int32_t>(key >> 24); }
+int32_t key_x(const uint32_t key) { return static_cast<int32_t>(key & 0xFFF); }
+int32_t key_y(const uint32_t key) { return static_cast<int32_t>((key >> 12) & 0xFFF); }
+
+double to_mib(const size_t bytes) { return static_cast<double>(bytes) / (1024.0 * 1024.0); }
+
+float distance_to_box(const glm::vec3 &point, const glm::vec3 &min, const glm::vec3 &max) {
+  return glm::length(glm::max(glm::max(min - point, point - max), glm::vec3(0.0f)));
+}
+
+}  // namespace
+
+uint32_t terrain::tile_key(const int32_t level, const int32_t x, const int32_t y) {
+  return static_cast<uint32_t>(x) | static_cast<uint32_t>(y) << 12 | static_cast<uint32_t>(level) << 24;
+}
+
+terrain::terrain(thread_pool &pool, const terrain_settings &config) : pool_(pool), config_(config) { create_grid(); }
+
+terrain::~terrain() {
+  // Workers may still be reading the mapping.
+  if (pending_.valid()) pending_.wait();
+  if (loads_.valid()) loads_.wait();
+
+  glDeleteVertexArrays(1, &grid_vao_);
+  glDeleteBuffers(1, &grid_vertices_);
+  glDeleteBuffers(1, &grid_indices_);
+  glDeleteBuffers(1, &instance_buffer_);
+  if (height_tiles_ != 0) glDeleteTextures(1, &height_tiles_);
+}
+
+void terrain::create_grid() {
+  const int32_t quads = config_.tile_quads;
+  const int32_t half = quads / 2;
+
+  std::vector<glm::vec2> vertices;
+  vertices.reserve(static_cast<size_t>(quads + 1) * (quads + 1));
+  for (int32_t y = 0; y <= quads; ++y) {
+    for (int32_t x = 0; x <= quads; ++x) {
+      vertices.emplace_back(static_cast<float>(x) / static_cast<float>(quads),
+                            static_cast<float>(y) / static_cast<float>(quads));
+    }
+  }
+
+  // Quadrant by quadrant, so one quarter of the node is a contiguous index range and the whole
+  // node is all four.
+  std::vector<uint32_t> indices;
+  indices.reserve(static_cast<size_t>(quads) * quads * 6);
+  for (int32_t quadrant = 0; quadrant < 4; ++quadrant) {
+    const int32_t first_x = (quadrant & 1) * half;
+    const int32_t first_y = (quadrant >> 1) * half;
+    for (int32_t y = first_y; y < first_y + half; ++y) {
+      for (int32_t x = first_x; x < first_x + half; ++x) {
+        const auto corner = static_cast<uint32_t>(y * (quads + 1) + x);
+        const auto below = corner + static_cast<uint32_t>(quads + 1);
+        indices.insert(indices.end(), {corner, below, corner + 1, corner + 1, below, below + 1});
+      }
+    }
+  }
+  quadrant_index_count_ = static_cast<int32_t>(indices.size() / 4);
+
+  glGenVertexArrays(1, &grid_vao_);
+  glGenBuffers(1, &grid_vertices_);
+  glGenBuffers(1, &grid_indices_);
+  glGenBuffers(1, &instance_buffer_);
+
+  glBindVertexArray(grid_vao_);
+  glBindBuffer(GL_ARRAY_BUFFER, grid_vertices_);
+  glBufferData(GL_ARRAY_BUFFER, static_cast<GLsizeiptr>(vertices.size() * sizeof(glm::vec2)), vertices.data(),
+               GL_STATIC_DRAW);
+  glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(glm::vec2), nullptr);
+  glEnableVertexAttribArray(0);
+
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, grid_indices_);
+  glBufferData(GL_ELEMENT_ARRAY_BUFFER, static_cast<GLsizeiptr>(indices.size() * sizeof(uint32_t)), indices.data(),
+               GL_STATIC_DRAW);
+
+  glBindBuffer(GL_ARRAY_BUFFER, instance_buffer_);
+  glEnableVertexAttribArray(node_location);
+  glVertexAttribDivisor(node_location, 1);
+  glEnableVertexAttribArray(morph_location);
+  glVertexAttribDivisor(morph_location, 1);
+  point_instance_attributes(0);
+
+  glBindVertexArray(0);
+}
+
+void terrain::point_instance_attributes(const size_t first_instance) const {
+  // Without base instances the attributes themselves are offset to the first instance of a draw.
+  const size_t base = first_instance * sizeof(node_instance);
+  glVertexAttribPointer(node_location, 4, GL_FLOAT, GL_FALSE, sizeof(node_instance),
+                        reinterpret_cast<void *>(base + offsetof(node_instance, node)));
+  glVertexAttribPointer(morph_location, 2, GL_FLOAT, GL_FALSE, sizeof(node_instance),
+                        reinterpret_cast<void *>(base + offsetof(node_instance, morph)));
+}
+
+void terrain::load(const std::string &path, const std::filesystem::path &cache_directory) {
+  name_ = std::filesystem::path(path).filename().string();
+  pending_ = pool_.submit([path, cache_directory, tile_quads = config_.tile_quads, &pool = pool_]() {
+    return open_terrain_tiles(cook_terrain(path, cache_directory, tile_quads, pool));
+  });
+}
+
+void terrain::generate(const heightmap_generator_settings &settings, const std::filesystem::path &cache_directory) {
+  name_ = "generated heightmap";
+  pending_ = pool_.submit([settings, cache_directory, tile_quads = config_.tile_quads, &pool = pool_]() {
+    return open_terrain_tiles(cook_generated_terrain(settings, cache_directory, tile_quads, pool));
+  });
+}
+
+void terrain::open(terrain_file file) {
+  if (file.empty() || file.layout.tile_quads != config_.tile_quads) {
+    std::cout << "Terrain failed to load: " << name_ << std::endl;
+    return;
+  }
+  file_ = std::move(file);
+  const terrain_layout &layout = file_.layout;
+
+  const float leaf_range = config_.lod_distance * static_cast<float>(layout.tile_quads) * config_.sample_spacing;
+  ranges_.clear();
+  for (int32_t level = 0; level < layout.level_count; ++level) {
+    ranges_.push_back(leaf_range * static_cast<float>(1 << level));
+  }
+  ranges_.back() = std::max(ranges_.back(), config_.view_distance);
+
+  slots_.assign(static_cast<size_t>(std::max(config_.tile_slots, 1)), {});
+  const int32_t samples = layout.tile_samples();
+  glGenTextures(1, &height_tiles_);
+  glBindTexture(GL_TEXTURE_2D_ARRAY, height_tiles_);
+  glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_R16, samples, samples, static_cast<GLsizei>(slots_.size()), 0, GL_RED,
+               GL_UNSIGNED_SHORT, nullptr);
+  glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_LEVEL, 0);
+  glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+  glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+  glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+  // The root covers everything the selection can fall back to, so it is loaded now and never evicted.
+  loaded_tile root;
+  root.key = tile_key(layout.level_count - 1, 0, 0);
+  const uint16_t *heights = file_.tile(layout.level_count - 1, 0, 0);
+  root.heights.assign(heights, heights + static_cast<size_t>(samples) * samples);
+  store_tile(root);
+
+  const auto found = resident_.find(root.key);
+  if (found != resident_.end()) slots_[found->second].pinned = true;
+}
+
+float terrain::world_size() const { return static_cast<float>(file_.layout.size) * config_.sample_spacing; }
+
+glm::vec3 terrain::node_min(const int32_t level, const int32_t x, const int32_t y) const {
+  const float width = static_cast<float>(file_.layout.tile_quads << level) * config_.sample_spacing;
+  const float origin = -0.5f * world_size();
+  return {origin + static_cast<float>(x) * width,
+          static_cast<float>(file_.min_height(level, x, y)) / 65535.0f * config_.height_scale + config_.height_offset,
+          origin + static_cast<float>(y) * width};
+}
+
+glm::vec3 terrain::node_max(const int32_t level, const int32_t x, const int32_t y) const {
+  const float width = static_cast<float>(file_.layout.tile_quads << level) * config_.sample_spacing;
+  const float origin = -0.5f * world_size();
+  return {origin + static_cast<float>(x + 1) * width,
+          static_cast<float>(file_.max_height(level, x, y)) / 65535.0f * config_.height_scale + config_.height_offset,
+          origin + static_cast<float>(y + 1) * width};
+}
+
+bool terrain::in_range(const int32_t level, const int32_t x, const int32_t y, const float range) const {
+  return distance_to_box(camera_position_, node_min(level, x, y), node_max(level, x, y)) <= range;
+}
+
+bool terrain::has_tile(const uint32_t key) {
+  const auto found = resident_.find(key);
+  if (found != resident_.end()) {
+    slots_[found->second].last_used = frame_;
+    return true;
+  }
+
+  if (loading_.count(key) == 0) missing_.push_back(key);
+  return false;
+}
+
+bool terrain::select(const int32_t level, const int32_t x, const int32_t y, bool inside_frustum) {
+  if (!in_range(level, x, y, ranges_[level])) return false;
+
+  if (!inside_frustum) {
+    const frustum_test visibility = test_aabb(frustum_, node_min(level, x, y), node_max(level, x, y));
+    if (visibility == frustum_test::outside) return true;
+    inside_frustum = visibility == frustum_test::inside;
+  }
+
+  if (level == 0 || !in_range(level, x, y, ranges_[level - 1])) {
+    add_node(level, x, y, 0);
+    return true;
+  }
+
+  // Split only once every visible child that will be drawn at the finer level has its heights;
+  // until then the node is drawn whole at its own level.
+  bool children_ready = true;
+  for (int32_t child = 0; child < 4; ++child) {
+    const int32_t child_x = x * 2 + (child & 1), child_y = y * 2 + (child >> 1);
+    if (!in_range(level - 1, child_x, child_y, ranges_[level - 1])) continue;
+    if (!inside_frustum && test_aabb(frustum_, node_min(level - 1, child_x, child_y),
+                                     node_max(level - 1, child_x, child_y)) == frustum_test::outside) {
+      continue;
+    }
+    children_ready = has_tile(tile_key(level - 1, child_x, child_y)) && children_ready;
+  }
+
+  if (!children_ready) {
+    add_node(level, x, y, 0);
+    return true;
+  }
+
+  for (int32_t child = 0; child < 4; ++child) {
+    if (!select(level - 1, x * 2 + (child & 1), y * 2 + (child >> 1), inside_frustum)) {
+      add_node(level, x, y, child + 1);
+    }
+  }
+  return true;
+}
+
+void terrain::add_node(const int32_t level, const int32_t x, const int32_t y, const int32_t quadrant) {
+  const auto found = resident_.find(tile_key(level, x, y));
+  if (found == resident_.end()) return;
+
+  const glm::vec3 min = node_min(level, x, y);
+  const float width = static_cast<float>(file_.layout.tile_quads << level) * config_.sample_spacing;
+  const float morph_end = ranges_[level];
+  const float previous = level == 0 ? 0.0f : ranges_[level - 1];
+  const float morph_start = previous + (morph_end - previous) * config_.morph_start;
+
+  selection_.push_back({quadrant, {glm::vec4(min.x, min.z, width, static_cast<float>(found->second)),
+                                   glm::vec2(morph_start, morph_end)}});
+}
+
+int32_t terrain::acquire_slot() {
+  int32_t oldest = -1;
+  for (size_t i = 0; i < slots_.size(); ++i) {
+    const tile_slot &slot = slots_[i];
+    if (slot.key == no_tile) return static_cast<int32_t>(i);
+    // Tiles the current selection touched stay, even if that means dropping the new one.
+    if (slot.pinned || slot.last_used >= frame_) continue;
+    if (oldest < 0 || slot.last_used < slots_[oldest].last_used) oldest = static_cast<int32_t>(i);
+  }
+  return oldest;
+}
+
+void terrain::store_tile(const loaded_tile &tile) {
+  loading_.erase(tile.key);
+
+  const int32_t index = acquire_slot();
+  if (index < 0) return;
+
+  tile_slot &slot = slots_[index];
+  if (slot.key != no_tile) resident_.erase(slot.key);
+
+  const int32_t samples = file_.layout.tile_samples();
+  glBindTexture(GL_TEXTURE_2D_ARRAY, height_tiles_);
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 2);
+  glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, index, samples, samples, 1, GL_RED, GL_UNSIGNED_SHORT,
+                  tile.heights.data());
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+  slot.key = tile.key;
+  slot.last_used = frame_;
+  resident_[tile.key] = index;
+  ++stats_.tiles_uploaded;
+}
+
+void terrain::request_tiles() {
+  if (missing_.empty() || loads_.valid()) return;
+
+  // Coarse levels first: a missing coarse tile blocks every split below it.
+  std::sort(missing_.begin(), missing_.end());
+  missing_.erase(std::unique(missing_.begin(), missing_.end()), missing_.end());
+  std::stable_sort(missing_.begin(), missing_.end(),
+                   [](const uint32_t a, const uint32_t b) { return key_level(a) > key_level(b); });
+  missing_.resize(std::min(missing_.size(), static_cast<size_t>(std::max(1, config_.uploads_per_frame))));
+
+  std::vector<std::pair<uint32_t, const uint16_t *>> sources;
+  for (const uint32_t key : missing_) {
+    sources.emplace_back(key, file_.tile(key_level(key), key_x(key), key_y(key)));
+    loading_.insert(key);
+  }
+
+  const size_t tile_size = static_cast<size_t>(file_.layout.tile_samples()) * file_.layout.tile_samples();
+  loads_ = pool_.submit([sources = std::move(sources), tile_size, file = file_.file]() {
+    std::vector<loaded_tile> tiles(sources.size());
+    for (size_t i = 0; i < sources.size(); ++i) {
+      tiles[i].key = sources[i].first;
+      tiles[i].heights.assign(sources[i].second, sources[i].second + tile_size);
+    }
+    return tiles;
+  });
+}
+
+void terrain::update(const glm::vec3 &camera_position, const glm::mat4 &view_projection) {
+  ++frame_;
+  stats_.tiles_uploaded = 0;
+
+  if (is_finished(pending_)) open(pending_.get());
+  if (!is_ready()) return;
+
+  camera_position_ = camera_position;
+  frustum_ = extract_frustum(view_projection);
+  selection_.clear();
+  missing_.clear();
+  select(file_.layout.level_count - 1, 0, 0, false);
+
+  // After the selection, so the tiles it touched cannot be evicted by this frame's uploads.
+  if (is_finished(loads_)) {
+    for (const loaded_tile &tile : loads_.get()) store_tile(tile);
+  }
+  request_tiles();
+
+  // Whole nodes first, then each quadrant, so every group is one contiguous instanced draw.
+  std::stable_sort(selection_.begin(), selection_.end(),
+                   [](const selected_node &a, const selected_node &b) { return a.quadrant < b.quadrant; });
+
+  stats_.nodes = selection_.size();
+  stats_.resident_tiles = resident_.size();
+  stats_.resident_bytes = slots_.size() * file_.layout.tile_bytes();
+  stats_.fully_resident_bytes = file_.layout.tile_count() * file_.layout.tile_bytes();
+}
+
+void terrain::draw(const shader &program, const int32_t height_unit) {
+  stats_.draw_calls = 0;
+  stats_.triangles = 0;
+  if (!is_ready() || selection_.empty()) return;
+
+  instances_.clear();
+  for (const selected_node &node : selection_) instances_.push_back(node.instance);
+  glBindBuffer(GL_ARRAY_BUFFER, instance_buffer_);
+  glBufferData(GL_ARRAY_BUFFER, static_cast<GLsizeiptr>(instances_.size() * sizeof(node_instance)), instances_.data(),
+               GL_STREAM_DRAW);
+
+  glActiveTexture(GL_TEXTURE0 + height_unit);
+  glBindTexture(GL_TEXTURE_2D_ARRAY, height_tiles_);
+  program.setInt("heightTiles", height_unit);
+  program.setFloat("gridSize", static_cast<float>(config_.tile_quads));
+  program.setFloat("heightScale", config_.height_scale);
+  program.setFloat("heightOffset", config_.height_offset);
+
+  glBindVertexArray(grid_vao_);
+  for (size_t first = 0; first < selection_.size();) {
+    const int32_t quadrant = selection_[first].quadrant;
+    size_t last = first;
+    while (last < selection_.size() && selection_[last].quadrant == quadrant) ++last;
+
+    const int32_t count = quadrant == 0 ? quadrant_index_count_ * 4 : quadrant_index_count_;
+    const size_t offset = quadrant == 0 ? 0 : static_cast<size_t>(quadrant - 1) * quadrant_index_count_;
+    const auto instance_count = static_cast<GLsizei>(last - first);
+
+    point_instance_attributes(first);
+    glDrawElementsInstanced(GL_TRIANGLES, count, GL_UNSIGNED_INT,
+                            reinterpret_cast<void *>(offset * sizeof(uint32_t)), instance_count);
+
+    ++stats_.draw_calls;
+    stats_.triangles += static_cast<size_t>(count / 3) * instance_count;
+    first = last;
+  }
+  glBindVertexArray(0);
+}
+
+void terrain::print_stats(std::ostream &out) const {
+  out << std::fixed << std::setprecision(1) << "terrain: " << world_size() << " m across, "
+      << file_.layout.level_count << " levels, " << stats_.nodes << " nodes in " << stats_.draw_calls
+      << " draw calls, " << stats_.triangles << " triangles, " << stats_.resident_tiles << "/" << slots_.size()
+      << " tiles resident, " << stats_.tiles_uploaded << " uploaded this frame, " << to_mib(stats_.resident_bytes)
+      << " MiB vs " << to_mib(stats_.fully_resident_bytes) << " MiB fully resident" << std::endl;
+}
@@ -0,0 +1,161 @@
+#ifndef TERRAIN_H
+#define TERRAIN_H
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <filesystem>
+#include <future>
+#include <iosfwd>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "terrain_tiles.h"
+#include "../render/frustum.h"
+
+class shader;
+class thread_pool;
+
+struct terrain_settings {
+  float sample_spacing = 1.0f;  // metres between height samples
+  float height_scale = 600.0f;  // metres from the lowest to the highest sample value
+  float height_offset = 0.0f;   // world height of sample value 0
+  // Level 0 nodes are drawn up to lod_distance times their width away; every level doubles that.
+  float lod_distance = 2.0f;
+  // Fraction of a level's distance band after which its vertices start morphing to the next level.
+  float morph_start = 0.7f;
+  float view_distance = 4000.0f;
+  int32_t tile_quads = 64;
+  int32_t tile_slots = 512;  // height tiles resident on the GPU
+  int32_t uploads_per_frame = 16;
+};
+
+struct terrain_stats {
+  size_t nodes = 0;        // selected in the last update(), whole or by quadrant
+  size_t draw_calls = 0;   // in the last draw()
+  size_t triangles = 0;
+  size_t tiles_uploaded = 0;  // in the last update()
+  size_t resident_tiles = 0;
+  size_t resident_bytes = 0;        // height tiles on the GPU
+  size_t fully_resident_bytes = 0;  // every tile of every level
+};
+
+// Heightmap terrain rendered with continuous distance-dependent LOD (CDLOD).
+//
+// The heightmap is tiled into a quadtree (see terrain_tiles.h). Each frame update() walks it from
+// the root: a node within its level's distance from the camera is split into its children once
+// their height tiles are resident, and children out of range are drawn as quadrants of the parent.
+// Every selected node draws the same shared grid mesh, instanced; the vertex shader reads heights
+// from the node's tile and slides odd vertices onto the next coarser grid as the camera moves away,
+// so levels meet without cracks or popping. Node boxes come from the tile file's bounds, so
+// frustum culling and selection need no tile data.
+//
+// Height tiles live in one R16 texture array of tile_slots layers. Tiles the selection wants but
+// does not have are read from the mapped file on a worker, coarse levels first, and replace the
+// least recently selected ones; the root tile stays pinned. Memory therefore stays bounded by the
+// slot count and draw work grows with the log of the terrain size.
+//
+// All member functions must be called on the thread that owns the GL context.
+class terrain {
+ public:
+  explicit terrain(thread_pool &pool, const terrain_settings &config = {});
+  terrain(const terrain &) = delete;
+  terrain &operator=(const terrain &) = delete;
+
+  ~terrain();
+
+  // Tiles the heightmap image at `path` into `cache_directory` on a worker, see cook_terrain().
+  void load(const std::string &path, const std::filesystem::path &cache_directory);
+  // The same for a generated heightmap.
+  void generate(const heightmap_generator_settings &settings, const std::filesystem::path &cache_directory);
+
+  [[nodiscard]] bool is_ready() const { return height_tiles_ != 0; }
+
+  // Selects the nodes to draw for this camera, uploads finished tiles and starts new loads. Call
+  // once per frame before draw().
+  void update(const glm::vec3 &camera_position, const glm::mat4 &view_projection);
+
+  // Draws the nodes selected by the last update() with `program`, which must be in use. The height
+  // tiles are bound to `height_unit`.
+  void draw(const shader &program, int32_t height_unit);
+
+  // World-space extent of the terrain in x and z, centred on the origin.
+  [[nodiscard]] float world_size() const;
+
+  [[nodiscard]] const terrain_stats &stats() const { return stats_; }
+  void print_stats(std::ostream &out) const;
+
+ private:
+  // Tile keys: x | y << 12 | level << 24.
+  static constexpr uint32_t no_tile = 0xFFFFFFFFu;
+
+  struct tile_slot {
+    uint32_t key = no_tile;
+    uint64_t last_used = 0;
+    bool pinned = false;
+  };
+
+  struct loaded_tile {
+    uint32_t key = no_tile;
+    std::vector<uint16_t> heights;
+  };
+
+  // Per-instance vertex attributes (locations 1 and 2).
+  struct node_instance {
+    glm::vec4 node;   // world x and z of the node's corner, world width, tile layer
+    glm::vec2 morph;  // distances at which morphing to the next level starts and ends
+  };
+
+  struct selected_node {
+    int32_t quadrant;  // 0 for the whole node, 1-4 for one quarter of its grid
+    node_instance instance;
+  };
+
+  [[nodiscard]] static uint32_t tile_key(int32_t level, int32_t x, int32_t y);
+
+  void create_grid();
+  void open(terrain_file file);
+  [[nodiscard]] glm::vec3 node_min(int32_t level, int32_t x, int32_t y) const;
+  [[nodiscard]] glm::vec3 node_max(int32_t level, int32_t x, int32_t y) const;
+  [[nodiscard]] bool in_range(int32_t level, int32_t x, int32_t y, float range) const;
+  [[nodiscard]] bool has_tile(uint32_t key);
+  bool select(int32_t level, int32_t x, int32_t y, bool inside_frustum);
+  void add_node(int32_t level, int32_t x, int32_t y, int32_t quadrant);
+  void request_tiles();
+  void store_tile(const loaded_tile &tile);
+  [[nodiscard]] int32_t acquire_slot();
+  void point_instance_attributes(size_t first_instance) const;
+
+  thread_pool &pool_;
+  terrain_settings config_;
+  std::string name_;
+
+  std::future<terrain_file> pending_;
+  terrain_file file_;
+  std::vector<float> ranges_;  // per level, clamped to the view distance
+
+  uint32_t grid_vao_ = 0;
+  uint32_t grid_vertices_ = 0;
+  uint32_t grid_indices_ = 0;
+  uint32_t instance_buffer_ = 0;
+  int32_t quadrant_index_count_ = 0;
+
+  uint32_t height_tiles_ = 0;
+  std::vector<tile_slot> slots_;
+  std::unordered_map<uint32_t, int32_t> resident_;
+  std::unordered_set<uint32_t> loading_;
+  std::vector<uint32_t> missing_;
+  std::future<std::vector<loaded_tile>> loads_;
+
+  glm::vec3 camera_position_ = glm::vec3(0.0f);
+  frustum frustum_{};
+  std::vector<selected_node> selection_;
+  std::vector<node_instance> instances_;
+
+  uint64_t frame_ = 0;
+  terrain_stats stats_;
+};
+
+#endif  // TERRAIN_H
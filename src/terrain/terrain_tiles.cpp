@@ -0,0 +1,251 @@
+#include "terrain_tiles.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <vector>
+
+#include "../filesystem/atomic_file.h"
+#include "../texture/image.h"
+#include "../utility/hash.h"
+#include "../utility/thread_pool.h"
+
+namespace {
+
+constexpr char terrain_magic[8] = {'E', 'N', 'G', 'T', 'E', 'R', 'R', '\0'};
+constexpr uint32_t terrain_version = 1;
+
+// Bump whenever the tile layout or sampling changes so stale cache entries are rebuilt.
+constexpr uint32_t cache_version = 1;
+
+// Quadtrees deeper than this would overflow the 12-bit node coordinates of the runtime's tile keys.
+constexpr int32_t max_level_count = 13;
+
+struct terrain_header {
+  char magic[8];
+  uint32_t version;
+  uint32_t size;
+  uint32_t tile_quads;
+  uint32_t level_count;
+  uint32_t source_width;
+  uint32_t source_height;
+};
+static_assert(sizeof(terrain_header) == 32, "terrain header must be packed");
+
+bool write_tiles(const std::filesystem::path &path, const heightmap &source, const int32_t tile_quads,
+                 thread_pool &pool) {
+  const terrain_layout layout = make_terrain_layout(source.width, source.height, tile_quads);
+  if (layout.level_count > max_level_count) return false;
+
+  // Leaf bounds come from every sample under the node, edges included; coarser nodes merge their
+  // children, so a node's box always contains whatever finer geometry is drawn in its place.
+  std::vector<uint16_t> bounds(layout.tile_count() * 2);
+  const int32_t leaves = layout.nodes_per_side(0);
+  pool.parallel_for(0, static_cast<size_t>(leaves), [&](const size_t row) {
+    const auto y = static_cast<int32_t>(row);
+    for (int32_t x = 0; x < leaves; ++x) {
+      uint16_t low = 0xFFFF, high = 0;
+      for (int32_t j = 0; j <= tile_quads; ++j) {
+        for (int32_t i = 0; i <= tile_quads; ++i) {
+          const uint16_t sample = source.at(x * tile_quads + i, y * tile_quads + j);
+          low = std::min(low, sample);
+          high = std::max(high, sample);
+        }
+      }
+      const size_t index = layout.tile_index(0, x, y) * 2;
+      bounds[index] = low;
+      bounds[index + 1] = high;
+    }
+  });
+
+  for (int32_t level = 1; level < layout.level_count; ++level) {
+    for (int32_t y = 0; y < layout.nodes_per_side(level); ++y) {
+      for (int32_t x = 0; x < layout.nodes_per_side(level); ++x) {
+        uint16_t low = 0xFFFF, high = 0;
+        for (int32_t child = 0; child < 4; ++child) {
+          const size_t index = layout.tile_index(level - 1, x * 2 + (child & 1), y * 2 + (child >> 1)) * 2;
+          low = std::min(low, bounds[index]);
+          high = std::max(high, bounds[index + 1]);
+        }
+        const size_t index = layout.tile_index(level, x, y) * 2;
+        bounds[index] = low;
+        bounds[index + 1] = high;
+      }
+    }
+  }
+
+  std::ofstream file(path, std::ios::binary | std::ios::trunc);
+  if (!file) return false;
+
+  terrain_header header{};
+  std::memcpy(header.magic, terrain_magic, sizeof(terrain_magic));
+  header.version = terrain_version;
+  header.size = static_cast<uint32_t>(layout.size);
+  header.tile_quads = static_cast<uint32_t>(layout.tile_quads);
+  header.level_count = static_cast<uint32_t>(layout.level_count);
+  header.source_width = static_cast<uint32_t>(source.width);
+  header.source_height = static_cast<uint32_t>(source.height);
+  file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+  file.write(reinterpret_cast<const char *>(bounds.data()), static_cast<std::streamsize>(bounds.size() * 2));
+
+  // One row of tiles at a time keeps memory bounded for very large sources.
+  const int32_t samples = layout.tile_samples();
+  std::vector<uint16_t> row;
+  for (int32_t level = 0; level < layout.level_count; ++level) {
+    const int32_t nodes = layout.nodes_per_side(level);
+    row.resize(static_cast<size_t>(samples) * samples * nodes);
+
+    for (int32_t y = 0; y < nodes; ++y) {
+      pool.parallel_for(0, static_cast<size_t>(nodes), [&](const size_t x) {
+        uint16_t *tile = &row[x * samples * samples];
+        for (int32_t j = 0; j < samples; ++j) {
+          const int32_t source_y = (y * tile_quads + j - 1) * (1 << level);
+          for (int32_t i = 0; i < samples; ++i) {
+            const int32_t source_x = (static_cast<int32_t>(x) * tile_quads + i - 1) * (1 << level);
+            tile[j * samples + i] = source.at(source_x, source_y);
+          }
+        }
+      });
+
+      file.write(reinterpret_cast<const char *>(row.data()), static_cast<std::streamsize>(row.size() * 2));
+    }
+  }
+
+  return static_cast<bool>(file);
+}
+
+std::filesystem::path cook(const std::filesystem::path &cached, const std::string &name, const int32_t tile_quads,
+                           thread_pool &pool, const std::function<heightmap()> &load) {
+  if (std::filesystem::exists(cached)) return cached;
+
+  const heightmap source = load();
+  if (source.empty()) return {};
+
+  const auto start = std::chrono::steady_clock::now();
+  if (!write_terrain_tiles(cached, source, tile_quads, pool)) {
+    std::cout << "Failed to write terrain tiles: " << cached << std::endl;
+    return {};
+  }
+  const std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+
+  std::cout << "Tiled " << name << " into " << cached.filename() << " in " << elapsed.count() << " ms" << std::endl;
+  return cached;
+}
+
+}  // namespace
+
+size_t terrain_layout::tile_bytes() const { return static_cast<size_t>(tile_samples()) * tile_samples() * 2; }
+
+size_t terrain_layout::tile_count() const {
+  size_t count = 0;
+  for (int32_t level = 0; level < level_count; ++level) {
+    count += static_cast<size_t>(nodes_per_side(level)) * nodes_per_side(level);
+  }
+  return count;
+}
+
+size_t terrain_layout::tile_index(const int32_t level, const int32_t x, const int32_t y) const {
+  size_t index = 0;
+  for (int32_t i = 0; i < level; ++i) index += static_cast<size_t>(nodes_per_side(i)) * nodes_per_side(i);
+  return index + static_cast<size_t>(y) * nodes_per_side(level) + x;
+}
+
+terrain_layout make_terrain_layout(const int32_t width, const int32_t height, const int32_t tile_quads) {
+  terrain_layout layout;
+  layout.tile_quads = tile_quads;
+  layout.size = tile_quads;
+  layout.level_count = 1;
+  while (layout.size < std::max(width, height) - 1) {
+    layout.size *= 2;
+    ++layout.level_count;
+  }
+  return layout;
+}
+
+const uint16_t *terrain_file::tile(const int32_t level, const int32_t x, const int32_t y) const {
+  return tiles + layout.tile_index(level, x, y) * layout.tile_samples() * layout.tile_samples();
+}
+
+uint16_t terrain_file::min_height(const int32_t level, const int32_t x, const int32_t y) const {
+  return bounds[layout.tile_index(level, x, y) * 2];
+}
+
+uint16_t terrain_file::max_height(const int32_t level, const int32_t x, const int32_t y) const {
+  return bounds[layout.tile_index(level, x, y) * 2 + 1];
+}
+
+bool write_terrain_tiles(const std::filesystem::path &path, const heightmap &source, const int32_t tile_quads,
+                         thread_pool &pool) {
+  if (source.empty() || tile_quads < 2 || (tile_quads & (tile_quads - 1)) != 0) return false;
+
+  return mfsys::write_file_atomically(path, [&](const std::filesystem::path &temporary) {
+    return write_tiles(temporary, source, tile_quads, pool);
+  });
+}
+
+terrain_file open_terrain_tiles(const std::filesystem::path &path) {
+  terrain_file result;
+
+  auto file = std::make_shared<mfsys::mapped_file>(path);
+  if (!file->is_open() || file->size() < sizeof(terrain_header)) return result;
+
+  terrain_header header{};
+  std::memcpy(&header, file->data(), sizeof(header));
+  if (std::memcmp(header.magic, terrain_magic, sizeof(terrain_magic)) != 0 || header.version != terrain_version) {
+    return result;
+  }
+  if (header.tile_quads < 2 || header.tile_quads > 1024 || header.level_count == 0 ||
+      header.level_count > static_cast<uint32_t>(max_level_count)) {
+    return result;
+  }
+
+  const terrain_layout layout = make_terrain_layout(static_cast<int32_t>(header.source_width),
+                                                    static_cast<int32_t>(header.source_height),
+                                                    static_cast<int32_t>(header.tile_quads));
+  if (layout.level_count != static_cast<int32_t>(header.level_count) ||
+      layout.size != static_cast<int32_t>(header.size)) {
+    return result;
+  }
+
+  const size_t bounds_bytes = layout.tile_count() * 2 * sizeof(uint16_t);
+  if (file->size() < sizeof(terrain_header) + bounds_bytes + layout.tile_count() * layout.tile_bytes()) return result;
+
+  result.layout = layout;
+  result.bounds = reinterpret_cast<const uint16_t *>(file->data() + sizeof(terrain_header));
+  result.tiles = reinterpret_cast<const uint16_t *>(file->data() + sizeof(terrain_header) + bounds_bytes);
+  result.file = std::move(file);
+  return result;
+}
+
+std::filesystem::path cook_terrain(const std::string &path, const std::filesystem::path &cache_directory,
+                                   const int32_t tile_quads, thread_pool &pool) {
+  const std::vector<uint8_t> bytes = read_file_bytes(path);
+  if (bytes.empty()) return {};
+
+  uint64_t key = fnv1a_64(bytes.data(), bytes.size());
+  const uint32_t parameters[2] = {cache_version, static_cast<uint32_t>(tile_quads)};
+  key = fnv1a_64(parameters, sizeof(parameters), key);
+
+  return cook(cache_directory / (hash_to_hex(key) + ".terrain"), path, tile_quads, pool, [&]() {
+    heightmap source;
+    (void) decode_heightmap(bytes.data(), bytes.size(), source);
+    return source;
+  });
+}
+
+std::filesystem::path cook_generated_terrain(const heightmap_generator_settings &settings,
+                                             const std::filesystem::path &cache_directory, const int32_t tile_quads,
+                                             thread_pool &pool) {
+  const uint32_t parameters[5] = {cache_version, static_cast<uint32_t>(tile_quads),
+                                  static_cast<uint32_t>(settings.size), settings.seed,
+                                  static_cast<uint32_t>(settings.octaves)};
+  const float shape[3] = {settings.feature_size, settings.flat_radius, settings.flat_height};
+  uint64_t key = fnv1a_64(parameters, sizeof(parameters), fnv1a_64("generated heightmap"));
+  key = fnv1a_64(shape, sizeof(shape), key);
+
+  return cook(cache_directory / (hash_to_hex(key) + ".terrain"), "generated heightmap", tile_quads, pool,
+              [&]() { return generate_heightmap(settings, pool); });
+}
@@ -0,0 +1,66 @@
+#ifndef TERRAIN_TILES_H
+#define TERRAIN_TILES_H
+
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <string>
+
+#include "heightmap.h"
+#include "../filesystem/mapped_file.h"
+
+class thread_pool;
+
+// Geometry of a tiled heightmap quadtree. Level 0 nodes span tile_quads x tile_quads samples; each
+// coarser level doubles the span and halves the sample density, so every node's tile holds the
+// same (tile_quads + 1)^2 vertex heights, point-sampled from the source so a vertex shared with
+// a finer level has exactly the same height. A one-sample border around every tile lets the
+// shader take normals across node edges. The top level is a single node; samples beyond the
+// source are clamped to its edges.
+struct terrain_layout {
+  int32_t size = 0;  // sample spacings per side covered by the quadtree, tile_quads * 2^(level_count - 1)
+  int32_t tile_quads = 64;
+  int32_t level_count = 0;
+
+  [[nodiscard]] int32_t nodes_per_side(int32_t level) const { return (size / tile_quads) >> level; }
+  [[nodiscard]] int32_t tile_samples() const { return tile_quads + 3; }
+  [[nodiscard]] size_t tile_bytes() const;  // R16
+  [[nodiscard]] size_t tile_count() const;  // over all levels
+  // Tiles are stored level by level, row-major.
+  [[nodiscard]] size_t tile_index(int32_t level, int32_t x, int32_t y) const;
+};
+
+// Picks the smallest quadtree covering a width x height heightmap.
+[[nodiscard]] terrain_layout make_terrain_layout(int32_t width, int32_t height, int32_t tile_quads = 64);
+
+// A mapped tile file. Alongside the tiles it stores the lowest and highest sample under every node,
+// so the whole quadtree can be culled and LOD-selected before any tile is loaded.
+struct terrain_file {
+  std::shared_ptr<mfsys::mapped_file> file;
+  terrain_layout layout;
+  const uint16_t *bounds = nullptr;  // min and max per tile, in tile_index() order
+  const uint16_t *tiles = nullptr;
+
+  [[nodiscard]] bool empty() const { return tiles == nullptr; }
+  [[nodiscard]] const uint16_t *tile(int32_t level, int32_t x, int32_t y) const;
+  [[nodiscard]] uint16_t min_height(int32_t level, int32_t x, int32_t y) const;
+  [[nodiscard]] uint16_t max_height(int32_t level, int32_t x, int32_t y) const;
+};
+
+[[nodiscard]] bool write_terrain_tiles(const std::filesystem::path &path, const heightmap &source,
+                                       int32_t tile_quads, thread_pool &pool);
+
+// Returns an empty file when `path` cannot be mapped or is not a terrain tile file.
+[[nodiscard]] terrain_file open_terrain_tiles(const std::filesystem::path &path);
+
+// Like cook_virtual_texture(): returns the tile file for the heightmap at `path` in
+// `cache_directory`, building it first when the source or settings changed.
+[[nodiscard]] std::filesystem::path cook_terrain(const std::string &path, const std::filesystem::path &cache_directory,
+                                                 int32_t tile_quads, thread_pool &pool);
+
+// The same for a generated heightmap, keyed by the generator settings.
+[[nodiscard]] std::filesystem::path cook_generated_terrain(const heightmap_generator_settings &settings,
+                                                           const std::filesystem::path &cache_directory,
+                                                           int32_t tile_quads, thread_pool &pool);
+
+#endif  // TERRAIN_TILES_H
@@ -0,0 +1,737 @@
+#include "bc_encoder.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+
+#include "../utility/simd.h"
+#include "../utility/thread_pool.h"
+
+namespace {
+
+struct alignas(32) block_texels {
+  float channel[4][16];  // r, g, b, a; texel i is (i % 4, i / 4) within the block
+};
+
+constexpr float bc1_weights[4] = {0.0f, 1.0f, 1.0f / 3.0f, 2.0f / 3.0f};
+constexpr int32_t bc7_weights[16] = {0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64};
+
+void fetch_block(const image &rgba, const int32_t block_x, const int32_t block_y, block_texels &out) {
+  for (int32_t y = 0; y < 4; ++y) {
+    const int32_t source_y = std::min(block_y * 4 + y, rgba.height - 1);
+    for (int32_t x = 0; x < 4; ++x) {
+      const int32_t source_x = std::min(block_x * 4 + x, rgba.width - 1);
+      const uint8_t *texel = &rgba.pixels[(static_cast<size_t>(source_y) * rgba.width + source_x) * 4];
+      for (int32_t c = 0; c < 4; ++c) out.channel[c][y * 4 + x] = texel[c];
+    }
+  }
+}
+
+// For every texel picks the nearest palette entry over `channel_count` channels and returns the
+// summed squared error. `channels` must point at 32-byte aligned arrays of 16 values.
+float select_indices(const float *const *channels, const int32_t channel_count, const float (*palette)[4],
+                     const int32_t palette_size, uint8_t indices[16]) {
+  float total = 0.0f;
+
+#if defined(ENGINE_SIMD_AVX2)
+  for (int32_t group = 0; group < 16; group += 8) {
+    __m256 texel[4];
+    for (int32_t c = 0; c < channel_count; ++c) texel[c] = _mm256_load_ps(channels[c] + group);
+
+    __m256 best_distance = _mm256_set1_ps(FLT_MAX);
+    __m256i best_index = _mm256_setzero_si256();
+    for (int32_t entry = 0; entry < palette_size; ++entry) {
+      __m256 distance = _mm256_setzero_ps();
+      for (int32_t c = 0; c < channel_count; ++c) {
+        const __m256 delta = _mm256_sub_ps(texel[c], _mm256_set1_ps(palette[entry][c]));
+        distance = _mm256_add_ps(distance, _mm256_mul_ps(delta, delta));
+      }
+
+      const __m256 closer = _mm256_cmp_ps(distance, best_distance, _CMP_LT_OQ);
+      best_distance = _mm256_min_ps(distance, best_distance);
+      best_index = _mm256_blendv_epi8(best_index, _mm256_set1_epi32(entry), _mm256_castps_si256(closer));
+    }
+
+    alignas(32) int32_t lanes[8];
+    alignas(32) float errors[8];
+    _mm256_store_si256(reinterpret_cast<__m256i *>(lanes), best_index);
+    _mm256_store_ps(errors, best_distance);
+    for (int32_t i = 0; i < 8; ++i) {
+      indices[group + i] = static_cast<uint8_t>(lanes[i]);
+      total += errors[i];
+    }
+  }
+#elif defined(ENGINE_SIMD_SSE2)
+  for (int32_t group = 0; group < 16; group += 4) {
+    __m128 texel[4];
+    for (int32_t c = 0; c < channel_count; ++c) texel[c] = _mm_load_ps(channels[c] + group);
+
+    __m128 best_distance = _mm_set1_ps(FLT_MAX);
+    __m128i best_index = _mm_setzero_si128();
+    for (int32_t entry = 0; entry < palette_size; ++entry) {
+      __m128 distance = _mm_setzero_ps();
+      for (int32_t c = 0; c < channel_count; ++c) {
+        const __m128 delta = _mm_sub_ps(texel[c], _mm_set1_ps(palette[entry][c]));
+        distance = _mm_add_ps(distance, _mm_mul_ps(delta, delta));
+      }
+
+      const __m128i closer = _mm_castps_si128(_mm_cmplt_ps(distance, best_distance));
+      best_distance = _mm_min_ps(distance, best_distance);
+      best_index = _mm_or_si128(_mm_and_si128(closer, _mm_set1_epi32(entry)), _mm_andnot_si128(closer, best_index));
+    }
+
+    alignas(16) int32_t lanes[4];
+    alignas(16) float errors[4];
+    _mm_store_si128(reinterpret_cast<__m128i *>(lanes), best_index);
+    _mm_store_ps(errors, best_distance);
+    for (int32_t i = 0; i < 4; ++i) {
+      indices[group + i] = static_cast<uint8_t>(lanes[i]);
+      total += errors[i];
+    }
+  }
+#else
+  for (int32_t i = 0; i < 16; ++i) {
+    float best_distance = FLT_MAX;
+    for (int32_t entry = 0; entry < palette_size; ++entry) {
+      float distance = 0.0f;
+      for (int32_t c = 0; c < channel_count; ++c) {
+        const float delta = channels[c][i] - palette[entry][c];
+        distance += delta * delta;
+      }
+      if (distance < best_distance) {
+        best_distance = distance;
+        indices[i] = static_cast<uint8_t>(entry);
+      }
+    }
+    total += best_distance;
+  }
+#endif
+
+  return total;
+}
+
+// Endpoints along the bounding-box diagonal, with channels that correlate negatively flipped and
+// the box inset slightly to account for the interpolated palette entries.
+void bounding_box_endpoints(const float *const *channels, const int32_t channel_count, float *e0, float *e1) {
+  float minimum[4], maximum[4], mean[4];
+  for (int32_t c = 0; c < channel_count; ++c) {
+    minimum[c] = *std::min_element(channels[c], channels[c] + 16);
+    maximum[c] = *std::max_element(channels[c], channels[c] + 16);
+    mean[c] = 0.0f;
+    for (int32_t i = 0; i < 16; ++i) mean[c] += channels[c][i];
+    mean[c] /= 16.0f;
+  }
+
+  int32_t dominant = 0;
+  for (int32_t c = 1; c < channel_count; ++c) {
+    if (maximum[c] - minimum[c] > maximum[dominant] - minimum[dominant]) dominant = c;
+  }
+
+  for (int32_t c = 0; c < channel_count; ++c) {
+    float covariance = 0.0f;
+    for (int32_t i = 0; i < 16; ++i) {
+      covariance += (channels[c][i] - mean[c]) * (channels[dominant][i] - mean[dominant]);
+    }
+
+    const float inset = (maximum[c] - minimum[c]) / 16.0f;
+    const float low = minimum[c] + inset;
+    const float high = maximum[c] - inset;
+    e0[c] = covariance < 0.0f ? low : high;
+    e1[c] = covariance < 0.0f ? high : low;
+  }
+}
+
+// Endpoints at the extremes of the texels projected on the principal axis of their covariance.
+void principal_axis_endpoints(const float *const *channels, const int32_t channel_count, float *e0, float *e1) {
+  float mean[4] = {};
+  for (int32_t c = 0; c < channel_count; ++c) {
+    for (int32_t i = 0; i < 16; ++i) mean[c] += channels[c][i];
+    mean[c] /= 16.0f;
+  }
+
+  float covariance[4][4] = {};
+  for (int32_t i = 0; i < 16; ++i) {
+    for (int32_t a = 0; a < channel_count; ++a) {
+      for (int32_t b = a; b < channel_count; ++b) {
+        covariance[a][b] += (channels[a][i] - mean[a]) * (channels[b][i] - mean[b]);
+      }
+    }
+  }
+  for (int32_t a = 0; a < channel_count; ++a) {
+    for (int32_t b = 0; b < a; ++b) covariance[a][b] = covariance[b][a];
+  }
+
+  // Power iteration converges quickly for the 3x3/4x4 case.
+  float axis[4] = {1.0f, 1.0f, 1.0f, 1.0f};
+  for (int32_t iteration = 0; iteration < 8; ++iteration) {
+    float next[4] = {};
+    float length = 0.0f;
+    for (int32_t a = 0; a < channel_count; ++a) {
+      for (int32_t b = 0; b < channel_count; ++b) next[a] += covariance[a][b] * axis[b];
+      length = std::max(length, std::fabs(next[a]));
+    }
+    if (length < FLT_EPSILON) break;
+    for (int32_t a = 0; a < channel_count; ++a) axis[a] = next[a] / length;
+  }
+
+  float axis_length = 0.0f;
+  for (int32_t c = 0; c < channel_count; ++c) axis_length += axis[c] * axis[c];
+  axis_length = std::sqrt(axis_length);
+  for (int32_t c = 0; c < channel_count; ++c) axis[c] /= axis_length;
+
+  float low = FLT_MAX, high = -FLT_MAX;
+  for (int32_t i = 0; i < 16; ++i) {
+    float t = 0.0f;
+    for (int32_t c = 0; c < channel_count; ++c) t += (channels[c][i] - mean[c]) * axis[c];
+    low = std::min(low, t);
+    high = std::max(high, t);
+  }
+
+  for (int32_t c = 0; c < channel_count; ++c) {
+    e0[c] = std::clamp(mean[c] + axis[c] * high, 0.0f, 255.0f);
+    e1[c] = std::clamp(mean[c] + axis[c] * low, 0.0f, 255.0f);
+  }
+}
+
+// Least-squares endpoints for fixed indices, where texel i is lerp(e0, e1, weights[indices[i]]).
+bool refine_endpoints(const float *const *channels, const int32_t channel_count, const uint8_t indices[16],
+                      const float *weights, float *e0, float *e1) {
+  float a = 0.0f, b = 0.0f, c = 0.0f;
+  float rhs0[4] = {}, rhs1[4] = {};
+  for (int32_t i = 0; i < 16; ++i) {
+    const float w = weights[indices[i]];
+    a += (1.0f - w) * (1.0f - w);
+    b += (1.0f - w) * w;
+    c += w * w;
+    for (int32_t ch = 0; ch < channel_count; ++ch) {
+      rhs0[ch] += (1.0f - w) * channels[ch][i];
+      rhs1[ch] += w * channels[ch][i];
+    }
+  }
+
+  const float determinant = a * c - b * b;
+  if (std::fabs(determinant) < 1e-6f) return false;
+
+  for (int32_t ch = 0; ch < channel_count; ++ch) {
+    e0[ch] = std::clamp((c * rhs0[ch] - b * rhs1[ch]) / determinant, 0.0f, 255.0f);
+    e1[ch] = std::clamp((a * rhs1[ch] - b * rhs0[ch]) / determinant, 0.0f, 255.0f);
+  }
+  return true;
+}
+
+// BC1 ---------------------------------------------------------------------------------------------
+
+uint16_t pack_565(const float *rgb) {
+  const auto r = static_cast<uint16_t>(std::lround(std::clamp(rgb[0], 0.0f, 255.0f) * 31.0f / 255.0f));
+  const auto g = static_cast<uint16_t>(std::lround(std::clamp(rgb[1], 0.0f, 255.0f) * 63.0f / 255.0f));
+  const auto b = static_cast<uint16_t>(std::lround(std::clamp(rgb[2], 0.0f, 255.0f) * 31.0f / 255.0f));
+  return static_cast<uint16_t>((r << 11) | (g << 5) | b);
+}
+
+void unpack_565(const uint16_t color, int32_t *rgb) {
+  const int32_t r = (color >> 11) & 31, g = (color >> 5) & 63, b = color & 31;
+  rgb[0] = (r << 3) | (r >> 2);
+  rgb[1] = (g << 2) | (g >> 4);
+  rgb[2] = (b << 3) | (b >> 2);
+}
+
+void bc1_palette(const uint16_t c0, const uint16_t c1, const bool four_color, int32_t (*palette)[4]) {
+  unpack_565(c0, palette[0]);
+  unpack_565(c1, palette[1]);
+  for (int32_t c = 0; c < 3; ++c) {
+    if (four_color) {
+      palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+      palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+    } else {
+      palette[2][c] = (palette[0][c] + palette[1][c]) / 2;
+      palette[3][c] = 0;
+    }
+  }
+  for (int32_t i = 0; i < 4; ++i) palette[i][3] = (!four_color && i == 3) ? 0 : 255;
+}
+
+// Orders the endpoints for four-color mode and selects indices. Returns the squared error.
+float bc1_select(const float *const *rgb, uint16_t &c0, uint16_t &c1, uint8_t indices[16]) {
+  if (c0 < c1) std::swap(c0, c1);
+
+  int32_t integer_palette[4][4];
+  bc1_palette(c0, c1, true, integer_palette);
+
+  float palette[4][4];
+  for (int32_t i = 0; i < 4; ++i) {
+    for (int32_t c = 0; c < 4; ++c) palette[i][c] = static_cast<float>(integer_palette[i][c]);
+  }
+
+  // Equal endpoints decode as a single color whatever the indices are.
+  return select_indices(rgb, 3, palette, c0 == c1 ? 1 : 4, indices);
+}
+
+void encode_bc1_block(const block_texels &block, const bc_quality quality, uint8_t *out) {
+  const float *rgb[3] = {block.channel[0], block.channel[1], block.channel[2]};
+
+  float e0[3], e1[3];
+  if (quality == bc_quality::fast) {
+    bounding_box_endpoints(rgb, 3, e0, e1);
+  } else {
+    principal_axis_endpoints(rgb, 3, e0, e1);
+  }
+
+  uint16_t c0 = pack_565(e0), c1 = pack_565(e1);
+  uint8_t indices[16];
+  float error = bc1_select(rgb, c0, c1, indices);
+
+  for (int32_t iteration = 0; quality == bc_quality::high && iteration < 2 && c0 != c1; ++iteration) {
+    if (!refine_endpoints(rgb, 3, indices, bc1_weights, e0, e1)) break;
+
+    uint16_t r0 = pack_565(e0), r1 = pack_565(e1);
+    uint8_t refined[16];
+    const float refined_error = bc1_select(rgb, r0, r1, refined);
+    if (refined_error >= error) break;
+
+    c0 = r0, c1 = r1, error = refined_error;
+    std::memcpy(indices, refined, 16);
+  }
+
+  uint32_t bits = 0;
+  for (int32_t i = 0; i < 16; ++i) bits |= static_cast<uint32_t>(indices[i]) << (2 * i);
+
+  out[0] = static_cast<uint8_t>(c0), out[1] = static_cast<uint8_t>(c0 >> 8);
+  out[2] = static_cast<uint8_t>(c1), out[3] = static_cast<uint8_t>(c1 >> 8);
+  for (int32_t i = 0; i < 4; ++i) out[4 + i] = static_cast<uint8_t>(bits >> (8 * i));
+}
+
+void decode_bc1_block(const uint8_t *in, const bool force_four_color, uint8_t texels[16][4]) {
+  const uint16_t c0 = static_cast<uint16_t>(in[0] | (in[1] << 8));
+  const uint16_t c1 = static_cast<uint16_t>(in[2] | (in[3] << 8));
+  const uint32_t bits = in[4] | (in[5] << 8) | (in[6] << 16) | (static_cast<uint32_t>(in[7]) << 24);
+
+  int32_t palette[4][4];
+  bc1_palette(c0, c1, force_four_color || c0 > c1, palette);
+
+  for (int32_t i = 0; i < 16; ++i) {
+    const uint32_t index = (bits >> (2 * i)) & 3;
+    for (int32_t c = 0; c < 4; ++c) texels[i][c] = static_cast<uint8_t>(palette[index][c]);
+  }
+}
+
+// BC4 ---------------------------------------------------------------------------------------------
+
+void bc4_palette(const int32_t r0, const int32_t r1, int32_t palette[8]) {
+  palette[0] = r0;
+  palette[1] = r1;
+  if (r0 > r1) {
+    for (int32_t i = 2; i < 8; ++i) palette[i] = ((8 - i) * r0 + (i - 1) * r1 + 3) / 7;
+  } else {
+    for (int32_t i = 2; i < 6; ++i) palette[i] = ((6 - i) * r0 + (i - 1) * r1 + 2) / 5;
+    palette[6] = 0;
+    palette[7] = 255;
+  }
+}
+
+float bc4_select(const float *values, const int32_t r0, const int32_t r1, uint8_t indices[16]) {
+  int32_t integer_palette[8];
+  bc4_palette(r0, r1, integer_palette);
+
+  float palette[8][4] = {};
+  for (int32_t i = 0; i < 8; ++i) palette[i][0] = static_cast<float>(integer_palette[i]);
+
+  return select_indices(&values, 1, palette, 8, indices);
+}
+
+void encode_bc4_block(const float *values, const bc_quality quality, uint8_t *out) {
+  const auto minimum = static_cast<int32_t>(*std::min_element(values, values + 16));
+  const auto maximum = static_cast<int32_t>(*std::max_element(values, values + 16));
+
+  int32_t best_r0 = maximum, best_r1 = minimum;
+  uint8_t best_indices[16];
+  float best_error = bc4_select(values, best_r0, best_r1, best_indices);
+
+  const auto consider = [&](const int32_t r0, const int32_t r1) {
+    uint8_t indices[16];
+    const float error = bc4_select(values, r0, r1, indices);
+    if (error < best_error) {
+      best_error = error, best_r0 = r0, best_r1 = r1;
+      std::memcpy(best_indices, indices, 16);
+    }
+  };
+
+  if (quality == bc_quality::high && maximum > minimum) {
+    // Pull the eight-value endpoints inwards a little; the extremes rarely sit on palette entries.
+    for (int32_t high = 0; high < 4; ++high) {
+      for (int32_t low = 0; low < 4; ++low) {
+        const int32_t r0 = maximum - high, r1 = minimum + low;
+        if (r0 > r1) consider(r0, r1);
+      }
+    }
+
+    // Six-value mode spends two entries on exact 0 and 255, good for blocks with hard extremes.
+    int32_t inner_minimum = 255, inner_maximum = 0;
+    for (int32_t i = 0; i < 16; ++i) {
+      const auto value = static_cast<int32_t>(values[i]);
+      if (value == 0 || value == 255) continue;
+      inner_minimum = std::min(inner_minimum, value);
+      inner_maximum = std::max(inner_maximum, value);
+    }
+    if (inner_minimum <= inner_maximum) consider(inner_minimum, inner_maximum);
+  }
+
+  uint64_t bits = 0;
+  for (int32_t i = 0; i < 16; ++i) bits |= static_cast<uint64_t>(best_indices[i]) << (3 * i);
+
+  out[0] = static_cast<uint8_t>(best_r0);
+  out[1] = static_cast<uint8_t>(best_r1);
+  for (int32_t i = 0; i < 6; ++i) out[2 + i] = static_cast<uint8_t>(bits >> (8 * i));
+}
+
+void decode_bc4_block(const uint8_t *in, uint8_t values[16]) {
+  int32_t palette[8];
+  bc4_palette(in[0], in[1], palette);
+
+  uint64_t bits = 0;
+  for (int32_t i = 0; i < 6; ++i) bits |= static_cast<uint64_t>(in[2 + i]) << (8 * i);
+
+  for (int32_t i = 0; i < 16; ++i) values[i] = static_cast<uint8_t>(palette[(bits >> (3 * i)) & 7]);
+}
+
+// BC7 (mode 6) ------------------------------------------------------------------------------------
+
+class bit_writer {
+ public:
+  explicit bit_writer(uint8_t *out) : out_(out) { std::memset(out_, 0, 16); }
+
+  void write(const uint32_t value, const int32_t bits) {
+    for (int32_t i = 0; i < bits; ++i, ++position_) {
+      out_[position_ >> 3] |= static_cast<uint8_t>(((value >> i) & 1) << (position_ & 7));
+    }
+  }
+
+ private:
+  uint8_t *out_;
+  int32_t position_ = 0;
+};
+
+class bit_reader {
+ public:
+  explicit bit_reader(const uint8_t *in) : in_(in) {}
+
+  uint32_t read(const int32_t bits) {
+    uint32_t value = 0;
+    for (int32_t i = 0; i < bits; ++i, ++position_) value |= ((in_[position_ >> 3] >> (position_ & 7)) & 1u) << i;
+    return value;
+  }
+
+ private:
+  const uint8_t *in_;
+  int32_t position_ = 0;
+};
+
+struct bc7_endpoints {
+  int32_t quantized[2][4];  // 7 bits per channel
+  int32_t p_bit[2];
+};
+
+void bc7_expand(const bc7_endpoints &endpoints, int32_t (*expanded)[4]) {
+  for (int32_t e = 0; e < 2; ++e) {
+    for (int32_t c = 0; c < 4; ++c) expanded[e][c] = (endpoints.quantized[e][c] << 1) | endpoints.p_bit[e];
+  }
+}
+
+void bc7_palette(const bc7_endpoints &endpoints, float (*palette)[4]) {
+  int32_t expanded[2][4];
+  bc7_expand(endpoints, expanded);
+
+  for (int32_t i = 0; i < 16; ++i) {
+    for (int32_t c = 0; c < 4; ++c) {
+      palette[i][c] = static_cast<float>(
+          ((64 - bc7_weights[i]) * expanded[0][c] + bc7_weights[i] * expanded[1][c] + 32) >> 6);
+    }
+  }
+}
+
+void bc7_quantize(const float *endpoint, const int32_t p_bit, int32_t *quantized) {
+  for (int32_t c = 0; c < 4; ++c) {
+    quantized[c] = std::clamp(static_cast<int32_t>(std::lround((endpoint[c] - static_cast<float>(p_bit)) / 2.0f)), 0, 127);
+  }
+}
+
+float bc7_quantization_error(const float *endpoint, const int32_t p_bit) {
+  int32_t quantized[4];
+  bc7_quantize(endpoint, p_bit, quantized);
+
+  float error = 0.0f;
+  for (int32_t c = 0; c < 4; ++c) {
+    const float delta = endpoint[c] - static_cast<float>((quantized[c] << 1) | p_bit);
+    error += delta * delta;
+  }
+  return error;
+}
+
+float bc7_select(const float *const *rgba, const float *e0, const float *e1, const bc_quality quality,
+                 bc7_endpoints &endpoints, uint8_t indices[16]) {
+  const auto evaluate = [&](const int32_t p0, const int32_t p1, bc7_endpoints &candidate, uint8_t *chosen) {
+    candidate.p_bit[0] = p0, candidate.p_bit[1] = p1;
+    bc7_quantize(e0, p0, candidate.quantized[0]);
+    bc7_quantize(e1, p1, candidate.quantized[1]);
+
+    float palette[16][4];
+    bc7_palette(candidate, palette);
+    return select_indices(rgba, 4, palette, 16, chosen);
+  };
+
+  if (quality == bc_quality::fast) {
+    const int32_t p0 = bc7_quantization_error(e0, 1) < bc7_quantization_error(e0, 0) ? 1 : 0;
+    const int32_t p1 = bc7_quantization_error(e1, 1) < bc7_quantization_error(e1, 0) ? 1 : 0;
+    return evaluate(p0, p1, endpoints, indices);
+  }
+
+  float best_error = FLT_MAX;
+  for (int32_t p = 0; p < 4; ++p) {
+    bc7_endpoints candidate{};
+    uint8_t chosen[16];
+    const float error = evaluate(p & 1, p >> 1, candidate, chosen);
+    if (error < best_error) {
+      best_error = error;
+      endpoints = candidate;
+      std::memcpy(indices, chosen, 16);
+    }
+  }
+  return best_error;
+}
+
+void encode_bc7_block(const block_texels &block, const bc_quality quality, uint8_t *out) {
+  const float *rgba[4] = {block.channel[0], block.channel[1], block.channel[2], block.channel[3]};
+
+  float e0[4], e1[4];
+  if (quality == bc_quality::fast) {
+    bounding_box_endpoints(rgba, 4, e0, e1);
+  } else {
+    principal_axis_endpoints(rgba, 4, e0, e1);
+  }
+
+  bc7_endpoints endpoints{};
+  uint8_t indices[16];
+  float error = bc7_select(rgba, e0, e1, quality, endpoints, indices);
+
+  if (quality == bc_quality::high) {
+    float weights[16];
+    for (int32_t i = 0; i < 16; ++i) weights[i] = static_cast<float>(bc7_weights[i]) / 64.0f;
+
+    for (int32_t iteration = 0; iteration < 2; ++iteration) {
+      if (!refine_endpoints(rgba, 4, indices, weights, e0, e1)) break;
+
+      bc7_endpoints refined{};
+      uint8_t refined_indices[16];
+      const float refined_error = bc7_select(rgba, e0, e1, quality, refined, refined_indices);
+      if (refined_error >= error) break;
+
+      error = refined_error;
+      endpoints = refined;
+      std::memcpy(indices, refined_indices, 16);
+    }
+  }
+
+  // The anchor texel's index has an implicit zero top bit; mirror the palette if it is set.
+  if (indices[0] & 8) {
+    std::swap(endpoints.quantized[0], endpoints.quantized[1]);
+    std::swap(endpoints.p_bit[0], endpoints.p_bit[1]);
+    for (auto &index : indices) index = static_cast<uint8_t>(15 - index);
+  }
+
+  bit_writer writer(out);
+  writer.write(1u << 6, 7);
+  for (int32_t c = 0; c < 4; ++c) {
+    writer.write(static_cast<uint32_t>(endpoints.quantized[0][c]), 7);
+    writer.write(static_cast<uint32_t>(endpoints.quantized[1][c]), 7);
+  }
+  writer.write(static_cast<uint32_t>(endpoints.p_bit[0]), 1);
+  writer.write(static_cast<uint32_t>(endpoints.p_bit[1]), 1);
+  for (int32_t i = 0; i < 16; ++i) writer.write(indices[i], i == 0 ? 3 : 4);
+}
+
+void decode_bc7_block(const uint8_t *in, uint8_t texels[16][4]) {
+  bit_reader reader(in);
+  if (reader.read(7) != (1u << 6)) {
+    // Only mode 6 is ever produced by this encoder.
+    for (int32_t i = 0; i < 16; ++i) texels[i][0] = 255, texels[i][1] = 0, texels[i][2] = 255, texels[i][3] = 255;
+    return;
+  }
+
+  bc7_endpoints endpoints{};
+  for (int32_t c = 0; c < 4; ++c) {
+    endpoints.quantized[0][c] = static_cast<int32_t>(reader.read(7));
+    endpoints.quantized[1][c] = static_cast<int32_t>(reader.read(7));
+  }
+  endpoints.p_bit[0] = static_cast<int32_t>(reader.read(1));
+  endpoints.p_bit[1] = static_cast<int32_t>(reader.read(1));
+
+  float palette[16][4];
+  bc7_palette(endpoints, palette);
+
+  for (int32_t i = 0; i < 16; ++i) {
+    const uint32_t index = reader.read(i == 0 ? 3 : 4);
+    for (int32_t c = 0; c < 4; ++c) texels[i][c] = static_cast<uint8_t>(palette[index][c]);
+  }
+}
+
+void encode_block(const block_texels &block, const bc_format format, const bc_quality quality, uint8_t *out) {
+  switch (format) {
+    case bc_format::bc1:
+      encode_bc1_block(block, quality, out);
+      break;
+    case bc_format::bc3:
+      encode_bc4_block(block.channel[3], quality, out);
+      encode_bc1_block(block, quality, out + 8);
+      break;
+    case bc_format::bc4:
+      encode_bc4_block(block.channel[0], quality, out);
+      break;
+    case bc_format::bc5:
+      encode_bc4_block(block.channel[0], quality, out);
+      encode_bc4_block(block.channel[1], quality, out + 8);
+      break;
+    case bc_format::bc7:
+      encode_bc7_block(block, quality, out);
+      break;
+  }
+}
+
+void decode_block(const bc_format format, const uint8_t *in, uint8_t texels[16][4]) {
+  uint8_t values[16];
+  switch (format) {
+    case bc_format::bc1:
+      decode_bc1_block(in, false, texels);
+      break;
+    case bc_format::bc3:
+      decode_bc1_block(in + 8, true, texels);
+      decode_bc4_block(in, values);
+      for (int32_t i = 0; i < 16; ++i) texels[i][3] = values[i];
+      break;
+    case bc_format::bc4:
+      decode_bc4_block(in, values);
+      for (int32_t i = 0; i < 16; ++i) texels[i][0] = values[i], texels[i][1] = 0, texels[i][2] = 0, texels[i][3] = 255;
+      break;
+    case bc_format::bc5:
+      decode_bc4_block(in, values);
+      for (int32_t i = 0; i < 16; ++i) texels[i][0] = values[i], texels[i][2] = 0, texels[i][3] = 255;
+      decode_bc4_block(in + 8, values);
+      for (int32_t i = 0; i < 16; ++i) texels[i][1] = values[i];
+      break;
+    case bc_format::bc7:
+      decode_bc7_block(in, texels);
+      break;
+  }
+}
+
+int32_t stored_channel_count(const bc_format format) {
+  switch (format) {
+    case bc_format::bc4: return 1;
+    case bc_format::bc5: return 2;
+    case bc_format::bc1: return 3;
+    default: return 4;
+  }
+}
+
+}  // namespace
+
+const char *bc_format_name(const bc_format format) {
+  switch (format) {
+    case bc_format::bc1: return "BC1";
+    case bc_format::bc3: return "BC3";
+    case bc_format::bc4: return "BC4";
+    case bc_format::bc5: return "BC5";
+    case bc_format::bc7: return "BC7";
+  }
+  return "unknown";
+}
+
+size_t bc_block_bytes(const bc_format format) {
+  return format == bc_format::bc1 || format == bc_format::bc4 ? 8 : 16;
+}
+
+size_t bc_level_bytes(const bc_format format, const int32_t width, const int32_t height) {
+  const size_t blocks_x = (std::max(1, width) + 3) / 4;
+  const size_t blocks_y = (std::max(1, height) + 3) / 4;
+  return blocks_x * blocks_y * bc_block_bytes(format);
+}
+
+std::vector<uint8_t> compress_level(const image &rgba, const bc_format format, const bc_quality quality,
+                                    thread_pool &pool) {
+  const int32_t blocks_x = (rgba.width + 3) / 4;
+  const int32_t blocks_y = (rgba.height + 3) / 4;
+  const size_t block_bytes = bc_block_bytes(format);
+
+  std::vector<uint8_t> blocks(static_cast<size_t>(blocks_x) * blocks_y * block_bytes);
+
+  pool.parallel_for(0, static_cast<size_t>(blocks_y), [&](const size_t block_y) {
+    block_texels texels;
+    for (int32_t block_x = 0; block_x < blocks_x; ++block_x) {
+      fetch_block(rgba, block_x, static_cast<int32_t>(block_y), texels);
+      encode_block(texels, format, quality, &blocks[(block_y * blocks_x + block_x) * block_bytes]);
+    }
+  });
+
+  return blocks;
+}
+
+compressed_texture compress_texture(const image &source, const bc_format format, const bc_quality quality,
+                                    thread_pool &pool, const mip_settings &mips) {
+  compressed_texture result;
+  if (source.empty()) return result;
+
+  result.format = format;
+  result.width = source.width;
+  result.height = source.height;
+
+  const std::vector<image> chain = generate_mip_chain(convert_channels(source, 4), mips, pool);
+  for (const image &level : chain) result.levels.push_back(compress_level(level, format, quality, pool));
+
+  const image &base = chain.front();
+  result.psnr = compute_psnr(base, decompress_level(format, result.levels[0].data(), base.width, base.height), format);
+  return result;
+}
+
+image decompress_level(const bc_format format, const uint8_t *blocks, const int32_t width, const int32_t height) {
+  image result;
+  result.width = width;
+  result.height = height;
+  result.channels = 4;
+  result.pixels.resize(static_cast<size_t>(width) * height * 4);
+
+  const int32_t blocks_x = (width + 3) / 4;
+  const int32_t blocks_y = (height + 3) / 4;
+  const size_t block_bytes = bc_block_bytes(format);
+
+  uint8_t texels[16][4];
+  for (int32_t block_y = 0; block_y < blocks_y; ++block_y) {
+    for (int32_t block_x = 0; block_x < blocks_x; ++block_x) {
+      decode_block(format, blocks + (static_cast<size_t>(block_y) * blocks_x + block_x) * block_bytes, texels);
+
+      for (int32_t i = 0; i < 16; ++i) {
+        const int32_t x = block_x * 4 + i % 4, y = block_y * 4 + i / 4;
+        if (x >= width || y >= height) continue;
+        std::memcpy(&result.pixels[(static_cast<size_t>(y) * width + x) * 4], texels[i], 4);
+      }
+    }
+  }
+
+  return result;
+}
+
+double compute_psnr(const image &reference, const image &decoded, const bc_format format) {
+  const int32_t channels = stored_channel_count(format);
+  const size_t pixel_count = static_cast<size_t>(reference.width) * reference.height;
+  if (pixel_count == 0 || reference.pixels.size() != decoded.pixels.size()) return 0.0;
+
+  double squared_error = 0.0;
+  for (size_t i = 0; i < pixel_count; ++i) {
+    for (int32_t c = 0; c < channels; ++c) {
+      const double delta = static_cast<double>(reference.pixels[i * 4 + c]) - decoded.pixels[i * 4 + c];
+      squared_error += delta * delta;
+    }
+  }
+
+  const double mse = squared_error / static_cast<double>(pixel_count * channels);
+  if (mse <= 0.0) return 99.0;
+  return 10.0 * std::log10(255.0 * 255.0 / mse);
+}
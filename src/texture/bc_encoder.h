@@ -0,0 +1,56 @@
+#ifndef BC_ENCODER_H
+#define BC_ENCODER_H
+
+#include <cstdint>
+#include <vector>
+
+#include "image.h"
+#include "mip_generator.h"
+
+class thread_pool;
+
+enum class bc_format : uint8_t {
+  bc1,  // RGB, 4 bits per texel
+  bc3,  // RGBA with interpolated alpha, 8 bits per texel
+  bc4,  // single channel, 4 bits per texel
+  bc5,  // two channels (normal maps), 8 bits per texel
+  bc7,  // RGBA, 8 bits per texel; only mode 6 is produced
+};
+
+enum class bc_quality : uint8_t {
+  fast,  // bounding-box endpoints, one index pass
+  high,  // principal-axis endpoints refined by least squares
+};
+
+struct compressed_texture {
+  bc_format format = bc_format::bc1;
+  int32_t width = 0;
+  int32_t height = 0;
+  // Mip chain, finest level first. Each level is a row-major array of 4x4 blocks.
+  std::vector<std::vector<uint8_t>> levels;
+  // Peak signal-to-noise ratio of level 0 against the source, in dB.
+  double psnr = 0.0;
+
+  [[nodiscard]] bool empty() const { return levels.empty(); }
+};
+
+[[nodiscard]] const char *bc_format_name(bc_format format);
+[[nodiscard]] size_t bc_block_bytes(bc_format format);
+[[nodiscard]] size_t bc_level_bytes(bc_format format, int32_t width, int32_t height);
+
+// Encodes the full mip chain of `source`, one block row per pool task. The mip levels are
+// filtered on the CPU with `mips` before encoding.
+[[nodiscard]] compressed_texture compress_texture(const image &source, bc_format format, bc_quality quality,
+                                                  thread_pool &pool, const mip_settings &mips = {});
+
+// Encodes one mip level. Returns the block data.
+[[nodiscard]] std::vector<uint8_t> compress_level(const image &rgba, bc_format format, bc_quality quality,
+                                                  thread_pool &pool);
+
+// Decodes one level back to RGBA8, used for error reporting.
+[[nodiscard]] image decompress_level(bc_format format, const uint8_t *blocks, int32_t width, int32_t height);
+
+// PSNR over the channels the format stores. Both images must be RGBA of the same size.
+[[nodiscard]] double compute_psnr(const image &reference, const image &decoded, bc_format format);
+
+#endif  // BC_ENCODER_H
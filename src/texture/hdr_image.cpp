@@ -0,0 +1,373 @@
+#include "hdr_image.h"
+
+#include "stb_image.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include "image.h"
+#include "../utility/simd.h"
+
+namespace {
+
+// Pixels are expanded to RGBA in blocks of this many so the bulk conversions see long runs.
+constexpr size_t expand_block = 1024;
+
+uint32_t float_bits(const float value) {
+  uint32_t bits;
+  std::memcpy(&bits, &value, sizeof(bits));
+  return bits;
+}
+
+float bits_float(const uint32_t bits) {
+  float value;
+  std::memcpy(&value, &bits, sizeof(value));
+  return value;
+}
+
+float non_negative(const float value) { return value > 0.0f ? value : 0.0f; }  // also maps NaN to 0
+
+// Rounds the magnitude bits of a half to the 6-bit (11-bit float) or 5-bit (10-bit float) mantissa,
+// nearest even, clamped to the largest finite value. Both formats share the half's exponent bias.
+uint32_t half_to_uf11(const uint32_t half) { return std::min((half + 0x7u + ((half >> 4) & 1u)) >> 4, 0x7BFu); }
+uint32_t half_to_uf10(const uint32_t half) { return std::min((half + 0xFu + ((half >> 5) & 1u)) >> 5, 0x3DFu); }
+
+void rgba_at(const hdr_image &source, const size_t pixel, float rgba[4]) {
+  const float *in = &source.pixels[pixel * source.channels];
+  rgba[0] = rgba[1] = rgba[2] = in[0];
+  rgba[3] = 1.0f;
+  if (source.channels == 2) rgba[3] = in[1];
+  if (source.channels >= 3) rgba[1] = in[1], rgba[2] = in[2];
+  if (source.channels == 4) rgba[3] = in[3];
+}
+
+void expand_rgba(const hdr_image &source, const size_t first, const size_t count, float *out) {
+  if (source.channels == 4) {
+    std::memcpy(out, &source.pixels[first * 4], count * 4 * sizeof(float));
+    return;
+  }
+  for (size_t i = 0; i < count; ++i) rgba_at(source, first + i, out + i * 4);
+}
+
+void encode_rgbe(const float rgba[4], uint8_t *out) {
+  const float r = non_negative(rgba[0]), g = non_negative(rgba[1]), b = non_negative(rgba[2]);
+  const float largest = std::max({r, g, b});
+  if (largest < 1.0e-32f) {
+    std::memset(out, 0, 4);
+    return;
+  }
+
+  int32_t exponent;
+  const float scale = std::frexp(largest, &exponent) * 256.0f / largest;
+  out[0] = static_cast<uint8_t>(std::min(r * scale, 255.0f));
+  out[1] = static_cast<uint8_t>(std::min(g * scale, 255.0f));
+  out[2] = static_cast<uint8_t>(std::min(b * scale, 255.0f));
+  out[3] = static_cast<uint8_t>(exponent + 128);
+}
+
+void decode_rgbe(const uint8_t *in, float rgba[4]) {
+  rgba[3] = 1.0f;
+  if (in[3] == 0) {
+    rgba[0] = rgba[1] = rgba[2] = 0.0f;
+    return;
+  }
+
+  const float scale = std::ldexp(1.0f, static_cast<int32_t>(in[3]) - (128 + 8));
+  for (int32_t c = 0; c < 3; ++c) rgba[c] = (static_cast<float>(in[c]) + 0.5f) * scale;
+}
+
+void encode_rgbm(const float rgba[4], uint8_t *out) {
+  const float r = non_negative(rgba[0]), g = non_negative(rgba[1]), b = non_negative(rgba[2]);
+  float multiplier = std::min(std::max({r, g, b, 1.0e-6f}) / hdr_rgbm_range, 1.0f);
+  multiplier = std::ceil(multiplier * 255.0f) / 255.0f;
+
+  const float scale = 255.0f / (multiplier * hdr_rgbm_range);
+  out[0] = static_cast<uint8_t>(std::min(r * scale + 0.5f, 255.0f));
+  out[1] = static_cast<uint8_t>(std::min(g * scale + 0.5f, 255.0f));
+  out[2] = static_cast<uint8_t>(std::min(b * scale + 0.5f, 255.0f));
+  out[3] = static_cast<uint8_t>(multiplier * 255.0f + 0.5f);
+}
+
+void decode_rgbm(const uint8_t *in, float rgba[4]) {
+  const float scale = static_cast<float>(in[3]) / 255.0f * hdr_rgbm_range / 255.0f;
+  for (int32_t c = 0; c < 3; ++c) rgba[c] = static_cast<float>(in[c]) * scale;
+  rgba[3] = 1.0f;
+}
+
+void unpack_r11g11b10f(const uint32_t packed, float rgba[4]) {
+  // Widen each channel back to a half: same exponent bias, shorter mantissa.
+  rgba[0] = half_to_float(static_cast<uint16_t>((packed & 0x7FFu) << 4));
+  rgba[1] = half_to_float(static_cast<uint16_t>(((packed >> 11) & 0x7FFu) << 4));
+  rgba[2] = half_to_float(static_cast<uint16_t>(((packed >> 22) & 0x3FFu) << 5));
+  rgba[3] = 1.0f;
+}
+
+}  // namespace
+
+const char *hdr_format_name(const hdr_format format) {
+  switch (format) {
+    case hdr_format::rgba32f: return "RGBA32F";
+    case hdr_format::rgba16f: return "RGBA16F";
+    case hdr_format::r11g11b10f: return "R11G11B10F";
+    case hdr_format::rgbe: return "RGBE";
+    case hdr_format::rgbm: return "RGBM";
+  }
+  return "unknown";
+}
+
+size_t hdr_format_texel_bytes(const hdr_format format) {
+  switch (format) {
+    case hdr_format::rgba32f: return 16;
+    case hdr_format::rgba16f: return 8;
+    case hdr_format::r11g11b10f:
+    case hdr_format::rgbe:
+    case hdr_format::rgbm: return 4;
+  }
+  return 0;
+}
+
+bool is_hdr_image(const uint8_t *bytes, const size_t size) {
+  return stbi_is_hdr_from_memory(bytes, static_cast<int>(size)) != 0;
+}
+
+bool decode_hdr_image(const uint8_t *bytes, const size_t size, hdr_image &out, const int32_t desired_channels) {
+  out = hdr_image();
+
+  int32_t width, height, nr_components;
+  float *data = stbi_loadf_from_memory(bytes, static_cast<int>(size), &width, &height, &nr_components,
+                                       desired_channels);
+  if (data == nullptr) return false;
+
+  out.width = width;
+  out.height = height;
+  out.channels = desired_channels != 0 ? desired_channels : nr_components;
+  out.pixels.assign(data, data + static_cast<size_t>(width) * height * out.channels);
+
+  stbi_image_free(data);
+  return true;
+}
+
+hdr_image load_hdr_image(const std::string &path, const int32_t desired_channels) {
+  hdr_image result;
+
+  const std::vector<uint8_t> bytes = read_file_bytes(path);
+  if (!bytes.empty()) (void) decode_hdr_image(bytes.data(), bytes.size(), result, desired_channels);
+
+  return result;
+}
+
+hdr_image downsample_hdr_image(const hdr_image &source) {
+  hdr_image result;
+  result.width = std::max(1, source.width / 2);
+  result.height = std::max(1, source.height / 2);
+  result.channels = source.channels;
+  result.pixels.resize(static_cast<size_t>(result.width) * result.height * result.channels);
+
+  const auto at = [&](const int32_t x, const int32_t y, const int32_t c) {
+    return source.pixels[(static_cast<size_t>(std::min(y, source.height - 1)) * source.width +
+                          std::min(x, source.width - 1)) *
+                             source.channels +
+                         c];
+  };
+
+  for (int32_t y = 0; y < result.height; ++y) {
+    for (int32_t x = 0; x < result.width; ++x) {
+      for (int32_t c = 0; c < source.channels; ++c) {
+        const float sum = at(2 * x, 2 * y, c) + at(2 * x + 1, 2 * y, c) + at(2 * x, 2 * y + 1, c) +
+                          at(2 * x + 1, 2 * y + 1, c);
+        result.pixels[(static_cast<size_t>(y) * result.width + x) * result.channels + c] = sum * 0.25f;
+      }
+    }
+  }
+
+  return result;
+}
+
+uint16_t float_to_half(const float value) {
+  constexpr uint32_t half_overflow = (127 + 16) << 23;  // 65536.0f and above become infinity
+  constexpr uint32_t half_normal_min = 113 << 23;       // 2^-14
+  // Adding this aligns the 10 subnormal mantissa bits at the bottom, rounded by the FPU.
+  constexpr uint32_t denormal_magic = ((127 - 15) + (23 - 10) + 1) << 23;
+
+  uint32_t bits = float_bits(value);
+  const uint32_t sign = bits & 0x80000000u;
+  bits ^= sign;
+
+  uint32_t half;
+  if (bits >= half_overflow) {
+    half = bits > 0x7F800000u ? 0x7E00u : 0x7C00u;
+  } else if (bits < half_normal_min) {
+    half = float_bits(bits_float(bits) + bits_float(denormal_magic)) - denormal_magic;
+  } else {
+    const uint32_t mantissa_odd = (bits >> 13) & 1u;
+    bits += ((15u - 127u) << 23) + 0xFFFu + mantissa_odd;
+    half = bits >> 13;
+  }
+
+  return static_cast<uint16_t>(half | (sign >> 16));
+}
+
+float half_to_float(const uint16_t value) {
+  const uint32_t sign = static_cast<uint32_t>(value & 0x8000u) << 16;
+  uint32_t exponent = (value >> 10) & 0x1Fu;
+  uint32_t mantissa = value & 0x3FFu;
+
+  if (exponent == 0x1F) return bits_float(sign | 0x7F800000u | mantissa << 13);
+  if (exponent == 0) {
+    if (mantissa == 0) return bits_float(sign);
+
+    // Subnormal: renormalise into a float exponent.
+    exponent = 127 - 14;
+    while ((mantissa & 0x400u) == 0) {
+      mantissa <<= 1;
+      --exponent;
+    }
+    return bits_float(sign | exponent << 23 | (mantissa & 0x3FFu) << 13);
+  }
+
+  return bits_float(sign | (exponent + 127 - 15) << 23 | mantissa << 13);
+}
+
+void convert_float_to_half(const float *in, uint16_t *out, const size_t count) {
+  size_t i = 0;
+#if defined(ENGINE_SIMD_F16C)
+  for (; i + 8 <= count; i += 8) {
+    const __m128i halves = _mm256_cvtps_ph(_mm256_loadu_ps(in + i), _MM_FROUND_TO_NEAREST_INT);
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(out + i), halves);
+  }
+#endif
+  for (; i < count; ++i) out[i] = float_to_half(in[i]);
+}
+
+void convert_half_to_float(const uint16_t *in, float *out, const size_t count) {
+  size_t i = 0;
+#if defined(ENGINE_SIMD_F16C)
+  for (; i + 8 <= count; i += 8) {
+    _mm256_storeu_ps(out + i, _mm256_cvtph_ps(_mm_loadu_si128(reinterpret_cast<const __m128i *>(in + i))));
+  }
+#endif
+  for (; i < count; ++i) out[i] = half_to_float(in[i]);
+}
+
+uint32_t pack_r11g11b10f(const float r, const float g, const float b) {
+  return half_to_uf11(float_to_half(non_negative(r))) | half_to_uf11(float_to_half(non_negative(g))) << 11 |
+         half_to_uf10(float_to_half(non_negative(b))) << 22;
+}
+
+void convert_to_r11g11b10f(const float *in, const int32_t channels, uint32_t *out, const size_t count) {
+  size_t i = 0;
+#if defined(ENGINE_SIMD_AVX2) && defined(ENGINE_SIMD_F16C)
+  if (channels >= 3) {
+    const __m256i offsets =
+        _mm256_mullo_epi32(_mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7), _mm256_set1_epi32(channels));
+    const __m256 zero = _mm256_setzero_ps();
+    const __m256i one = _mm256_set1_epi32(1);
+
+    // max(x, 0) returns the second operand for NaN, so NaNs become 0 as in the scalar path.
+    const auto halves = [&](const float *base) {
+      const __m256 values = _mm256_max_ps(_mm256_i32gather_ps(base, offsets, 4), zero);
+      return _mm256_cvtepu16_epi32(_mm256_cvtps_ph(values, _MM_FROUND_TO_NEAREST_INT));
+    };
+    const auto round_to = [&](const __m256i half, const int32_t drop, const int32_t largest) {
+      const __m256i shift = _mm256_set1_epi32(drop);
+      const __m256i odd = _mm256_and_si256(_mm256_srlv_epi32(half, shift), one);
+      const __m256i bias = _mm256_add_epi32(_mm256_set1_epi32((1 << (drop - 1)) - 1), odd);
+      const __m256i rounded = _mm256_srlv_epi32(_mm256_add_epi32(half, bias), shift);
+      return _mm256_min_epu32(rounded, _mm256_set1_epi32(largest));
+    };
+
+    for (; i + 8 <= count; i += 8) {
+      const float *base = in + i * channels;
+      const __m256i r = round_to(halves(base), 4, 0x7BF);
+      const __m256i g = round_to(halves(base + 1), 4, 0x7BF);
+      const __m256i b = round_to(halves(base + 2), 5, 0x3DF);
+      const __m256i packed = _mm256_or_si256(r, _mm256_or_si256(_mm256_slli_epi32(g, 11), _mm256_slli_epi32(b, 22)));
+      _mm256_storeu_si256(reinterpret_cast<__m256i *>(out + i), packed);
+    }
+  }
+#endif
+  for (; i < count; ++i) {
+    const float *pixel = in + i * channels;
+    out[i] = channels >= 3 ? pack_r11g11b10f(pixel[0], pixel[1], pixel[2])
+                           : pack_r11g11b10f(pixel[0], pixel[0], pixel[0]);
+  }
+}
+
+std::vector<uint8_t> encode_hdr_image(const hdr_image &source, const hdr_format format) {
+  const size_t pixel_count = static_cast<size_t>(source.width) * source.height;
+  std::vector<uint8_t> result(pixel_count * hdr_format_texel_bytes(format));
+  if (source.empty()) return result;
+
+  if (format == hdr_format::r11g11b10f) {
+    convert_to_r11g11b10f(source.pixels.data(), source.channels, reinterpret_cast<uint32_t *>(result.data()),
+                          pixel_count);
+    return result;
+  }
+
+  std::vector<float> rgba(expand_block * 4);
+  for (size_t first = 0; first < pixel_count; first += expand_block) {
+    const size_t count = std::min(expand_block, pixel_count - first);
+    expand_rgba(source, first, count, rgba.data());
+
+    uint8_t *out = result.data() + first * hdr_format_texel_bytes(format);
+    switch (format) {
+      case hdr_format::rgba32f:
+        std::memcpy(out, rgba.data(), count * 4 * sizeof(float));
+        break;
+      case hdr_format::rgba16f:
+        convert_float_to_half(rgba.data(), reinterpret_cast<uint16_t *>(out), count * 4);
+        break;
+      case hdr_format::rgbe:
+        for (size_t i = 0; i < count; ++i) encode_rgbe(&rgba[i * 4], out + i * 4);
+        break;
+      case hdr_format::rgbm:
+        for (size_t i = 0; i < count; ++i) encode_rgbm(&rgba[i * 4], out + i * 4);
+        break;
+      case hdr_format::r11g11b10f:
+        break;
+    }
+  }
+
+  return result;
+}
+
+hdr_image decode_hdr_texels(const uint8_t *texels, const int32_t width, const int32_t height,
+                            const hdr_format format) {
+  hdr_image result;
+  result.width = width;
+  result.height = height;
+  result.channels = 4;
+
+  const size_t pixel_count = static_cast<size_t>(width) * height;
+  result.pixels.resize(pixel_count * 4);
+  float *out = result.pixels.data();
+
+  switch (format) {
+    case hdr_format::rgba32f:
+      std::memcpy(out, texels, pixel_count * 4 * sizeof(float));
+      break;
+    case hdr_format::rgba16f: {
+      // The texels may come straight from a mapping with no alignment guarantee.
+      std::vector<uint16_t> halves(pixel_count * 4);
+      std::memcpy(halves.data(), texels, halves.size() * sizeof(uint16_t));
+      convert_half_to_float(halves.data(), out, halves.size());
+      break;
+    }
+    case hdr_format::r11g11b10f:
+      for (size_t i = 0; i < pixel_count; ++i) {
+        uint32_t packed;
+        std::memcpy(&packed, texels + i * 4, sizeof(packed));
+        unpack_r11g11b10f(packed, out + i * 4);
+      }
+      break;
+    case hdr_format::rgbe:
+      for (size_t i = 0; i < pixel_count; ++i) decode_rgbe(texels + i * 4, out + i * 4);
+      break;
+    case hdr_format::rgbm:
+      for (size_t i = 0; i < pixel_count; ++i) decode_rgbm(texels + i * 4, out + i * 4);
+      break;
+  }
+
+  return result;
+}
@@ -0,0 +1,66 @@
+#ifndef HDR_IMAGE_H
+#define HDR_IMAGE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// A linear floating-point image, as decoded from Radiance .hdr files.
+struct hdr_image {
+  int32_t width = 0;
+  int32_t height = 0;
+  int32_t channels = 0;
+  std::vector<float> pixels;
+
+  [[nodiscard]] bool empty() const { return pixels.empty(); }
+  [[nodiscard]] size_t size_in_bytes() const { return pixels.size() * sizeof(float); }
+};
+
+// Texel encodings for HDR data. The first three are GPU formats; RGBE and RGBM are 8-bit storage
+// encodings for cooked files and are decoded before upload.
+enum class hdr_format : uint8_t {
+  rgba32f,     // GL_RGBA32F, the uncompressed reference
+  rgba16f,     // GL_RGBA16F
+  r11g11b10f,  // GL_R11F_G11F_B10F: unsigned, no alpha
+  rgbe,        // shared 8-bit exponent (Radiance)
+  rgbm,        // RGB scaled by an 8-bit multiplier up to hdr_rgbm_range
+};
+
+constexpr float hdr_rgbm_range = 8.0f;
+
+[[nodiscard]] const char *hdr_format_name(hdr_format format);
+[[nodiscard]] size_t hdr_format_texel_bytes(hdr_format format);
+
+// True when the encoded buffer is a format stb_image decodes to floats (.hdr).
+[[nodiscard]] bool is_hdr_image(const uint8_t *bytes, size_t size);
+
+// Decodes with stbi_loadf. LDR files decode too, converted from sRGB to linear by stb_image.
+[[nodiscard]] bool decode_hdr_image(const uint8_t *bytes, size_t size, hdr_image &out, int32_t desired_channels = 0);
+[[nodiscard]] hdr_image load_hdr_image(const std::string &path, int32_t desired_channels = 0);
+
+// Halves `source` with a 2x2 box filter, as in a mip chain. Odd edges are clamped.
+[[nodiscard]] hdr_image downsample_hdr_image(const hdr_image &source);
+
+// IEEE binary16 conversion with round-to-nearest-even; infinities and NaNs are kept.
+[[nodiscard]] uint16_t float_to_half(float value);
+[[nodiscard]] float half_to_float(uint16_t value);
+
+// Bulk conversions, 8 values at a time with F16C when the build enables it. Bit-identical to the
+// scalar functions above for every non-NaN input.
+void convert_float_to_half(const float *in, uint16_t *out, size_t count);
+void convert_half_to_float(const uint16_t *in, float *out, size_t count);
+
+// Packs to GL_UNSIGNED_INT_10F_11F_11F_REV. Negative values and NaNs become 0, values beyond the
+// largest finite 11/10-bit float are clamped to it.
+[[nodiscard]] uint32_t pack_r11g11b10f(float r, float g, float b);
+void convert_to_r11g11b10f(const float *in, int32_t channels, uint32_t *out, size_t count);
+
+// Encodes every pixel in `format`, hdr_format_texel_bytes() bytes each, row-major without padding.
+// Alpha is kept by the rgba formats and dropped by the others.
+[[nodiscard]] std::vector<uint8_t> encode_hdr_image(const hdr_image &source, hdr_format format);
+
+// The inverse of encode_hdr_image(), to RGBA floats.
+[[nodiscard]] hdr_image decode_hdr_texels(const uint8_t *texels, int32_t width, int32_t height, hdr_format format);
+
+#endif  // HDR_IMAGE_H
@@ -0,0 +1,91 @@
+#include "image.h"
+
+#define STB_IMAGE_IMPLEMENTATION
+#include "stb_image.h"
+
+#include <fstream>
+#include <future>
+
+#include "../utility/thread_pool.h"
+
+std::vector<uint8_t> read_file_bytes(const std::string &path) {
+  std::ifstream file(path, std::ios::binary | std::ios::ate);
+  if (!file) return {};
+
+  const std::streamsize size = file.tellg();
+  if (size <= 0) return {};
+
+  std::vector<uint8_t> bytes(static_cast<size_t>(size));
+  file.seekg(0, std::ios::beg);
+  if (!file.read(reinterpret_cast<char *>(bytes.data()), size)) return {};
+
+  return bytes;
+}
+
+bool decode_image(const uint8_t *bytes, const size_t size, image &out, const int32_t desired_channels) {
+  out = image();
+
+  int32_t width, height, nr_components;
+  unsigned char *data = stbi_load_from_memory(bytes, static_cast<int>(size), &width, &height, &nr_components,
+                                              desired_channels);
+  if (data == nullptr) return false;
+
+  out.width = width;
+  out.height = height;
+  out.channels = desired_channels != 0 ? desired_channels : nr_components;
+  out.pixels.assign(data, data + static_cast<size_t>(width) * height * out.channels);
+
+  stbi_image_free(data);
+  return true;
+}
+
+image load_image(const std::string &path, const int32_t desired_channels) {
+  image result;
+
+  const std::vector<uint8_t> bytes = read_file_bytes(path);
+  if (!bytes.empty()) (void) decode_image(bytes.data(), bytes.size(), result, desired_channels);
+
+  return result;
+}
+
+image convert_channels(const image &source, const int32_t channels) {
+  if (source.channels == channels || source.empty()) return source;
+
+  image result;
+  result.width = source.width;
+  result.height = source.height;
+  result.channels = channels;
+
+  const size_t pixel_count = static_cast<size_t>(source.width) * source.height;
+  result.pixels.resize(pixel_count * channels);
+
+  for (size_t i = 0; i < pixel_count; ++i) {
+    const uint8_t *in = &source.pixels[i * source.channels];
+    uint8_t *out = &result.pixels[i * channels];
+
+    uint8_t rgba[4] = {in[0], in[0], in[0], 255};
+    if (source.channels == 2) rgba[3] = in[1];
+    if (source.channels >= 3) rgba[1] = in[1], rgba[2] = in[2];
+    if (source.channels == 4) rgba[3] = in[3];
+
+    for (int32_t c = 0; c < channels; ++c) out[c] = rgba[c];
+  }
+
+  return result;
+}
+
+std::vector<image> load_images(const std::vector<std::string> &paths, thread_pool &pool,
+                               const int32_t desired_channels) {
+  std::vector<std::future<image>> pending;
+  pending.reserve(paths.size());
+
+  for (const auto &path : paths) {
+    pending.push_back(pool.submit([path, desired_channels]() { return load_image(path, desired_channels); }));
+  }
+
+  std::vector<image> result;
+  result.reserve(paths.size());
+  for (auto &future : pending) result.push_back(future.get());
+
+  return result;
+}
@@ -0,0 +1,36 @@
+#ifndef IMAGE_H
+#define IMAGE_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+class thread_pool;
+
+struct image {
+  int32_t width = 0;
+  int32_t height = 0;
+  int32_t channels = 0;
+  std::vector<uint8_t> pixels;
+
+  [[nodiscard]] bool empty() const { return pixels.empty(); }
+  [[nodiscard]] size_t size_in_bytes() const { return pixels.size(); }
+};
+
+[[nodiscard]] std::vector<uint8_t> read_file_bytes(const std::string &path);
+
+// Decodes an encoded PNG/JPG/... buffer. Leaves `out` empty and returns false on failure.
+[[nodiscard]] bool decode_image(const uint8_t *bytes, size_t size, image &out, int32_t desired_channels = 0);
+
+// Returns an empty image when the file cannot be read or decoded.
+[[nodiscard]] image load_image(const std::string &path, int32_t desired_channels = 0);
+
+// Repacks the pixels to `channels` components. Grey expands to RGB, missing alpha is opaque.
+[[nodiscard]] image convert_channels(const image &source, int32_t channels);
+
+// Reads and decodes every path on the pool's workers. The result keeps the order of `paths`;
+// entries that failed to load are empty.
+[[nodiscard]] std::vector<image> load_images(const std::vector<std::string> &paths, thread_pool &pool,
+                                             int32_t desired_channels = 0);
+
+#endif  // IMAGE_H
@@ -0,0 +1,357 @@
+#include "ktx2.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <numeric>
+
+#include "../filesystem/atomic_file.h"
+
+namespace {
+
+constexpr uint8_t ktx2_identifier[12] = {0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n'};
+
+struct ktx2_header {
+  uint8_t identifier[12];
+  uint32_t vk_format;
+  uint32_t type_size;
+  uint32_t pixel_width;
+  uint32_t pixel_height;
+  uint32_t pixel_depth;
+  uint32_t layer_count;
+  uint32_t face_count;
+  uint32_t level_count;
+  uint32_t supercompression_scheme;
+  uint32_t dfd_byte_offset;
+  uint32_t dfd_byte_length;
+  uint32_t kvd_byte_offset;
+  uint32_t kvd_byte_length;
+  uint64_t sgd_byte_offset;
+  uint64_t sgd_byte_length;
+};
+static_assert(sizeof(ktx2_header) == 80, "KTX2 header must be packed");
+
+struct ktx2_level_index {
+  uint64_t byte_offset;
+  uint64_t byte_length;
+  uint64_t uncompressed_byte_length;
+};
+
+// Khronos data format descriptor constants.
+constexpr uint32_t dfd_model_rgbsda = 1;
+constexpr uint32_t dfd_model_bc1a = 128;
+constexpr uint32_t dfd_model_bc3 = 130;
+constexpr uint32_t dfd_model_bc4 = 131;
+constexpr uint32_t dfd_model_bc5 = 132;
+constexpr uint32_t dfd_model_bc7 = 134;
+constexpr uint32_t dfd_primaries_bt709 = 1;
+constexpr uint32_t dfd_transfer_linear = 1;
+constexpr uint32_t dfd_channel_alpha = 15;
+constexpr uint32_t dfd_qualifier_float = 0x80;
+constexpr uint32_t dfd_qualifier_signed = 0x40;
+constexpr uint32_t float_one_bits = 0x3F800000;
+constexpr uint32_t float_minus_one_bits = 0xBF800000;
+
+struct dfd_sample {
+  uint32_t bit_offset;
+  uint32_t bit_length;
+  uint32_t channel;  // channel id, ORed with the qualifier bits
+  uint32_t upper;
+  uint32_t lower = 0;
+};
+
+size_t align_up(const size_t value, const size_t alignment) { return (value + alignment - 1) / alignment * alignment; }
+
+void append_u32(std::vector<uint8_t> &out, const uint32_t value) {
+  for (int32_t i = 0; i < 4; ++i) out.push_back(static_cast<uint8_t>(value >> (8 * i)));
+}
+
+std::vector<uint8_t> build_data_format_descriptor(const vk_format format) {
+  uint32_t model = dfd_model_rgbsda;
+  uint32_t block_dimension = 0;  // each dimension is stored minus one
+  // Filled one by one: assigning a braced list makes GCC 12 warn about a null memmove at -O2.
+  std::vector<dfd_sample> samples;
+  samples.reserve(4);
+
+  switch (format) {
+    case vk_format::bc1_rgb_unorm:
+      model = dfd_model_bc1a;
+      samples.push_back({0, 64, 0, 0xFFFFFFFF});
+      break;
+    case vk_format::bc3_unorm:
+      model = dfd_model_bc3;
+      samples.push_back({0, 64, dfd_channel_alpha, 0xFFFFFFFF});
+      samples.push_back({64, 64, 0, 0xFFFFFFFF});
+      break;
+    case vk_format::bc4_unorm:
+      model = dfd_model_bc4;
+      samples.push_back({0, 64, 0, 0xFFFFFFFF});
+      break;
+    case vk_format::bc5_unorm:
+      model = dfd_model_bc5;
+      samples.push_back({0, 64, 0, 0xFFFFFFFF});
+      samples.push_back({64, 64, 1, 0xFFFFFFFF});
+      break;
+    case vk_format::bc7_unorm:
+      model = dfd_model_bc7;
+      samples.push_back({0, 128, 0, 0xFFFFFFFF});
+      break;
+    case vk_format::r8_unorm:
+      samples.push_back({0, 8, 0, 255});
+      break;
+    case vk_format::r8g8_unorm:
+      samples.push_back({0, 8, 0, 255});
+      samples.push_back({8, 8, 1, 255});
+      break;
+    case vk_format::r8g8b8_unorm:
+      samples.push_back({0, 8, 0, 255});
+      samples.push_back({8, 8, 1, 255});
+      samples.push_back({16, 8, 2, 255});
+      break;
+    case vk_format::r8g8b8a8_unorm:
+      samples.push_back({0, 8, 0, 255});
+      samples.push_back({8, 8, 1, 255});
+      samples.push_back({16, 8, 2, 255});
+      samples.push_back({24, 8, dfd_channel_alpha, 255});
+      break;
+    case vk_format::r16g16b16a16_sfloat: {
+      constexpr uint32_t qualifiers = dfd_qualifier_float | dfd_qualifier_signed;
+      samples.push_back({0, 16, 0 | qualifiers, float_one_bits, float_minus_one_bits});
+      samples.push_back({16, 16, 1 | qualifiers, float_one_bits, float_minus_one_bits});
+      samples.push_back({32, 16, 2 | qualifiers, float_one_bits, float_minus_one_bits});
+      samples.push_back({48, 16, dfd_channel_alpha | qualifiers, float_one_bits, float_minus_one_bits});
+      break;
+    }
+    case vk_format::b10g11r11_ufloat_pack32:
+      samples.push_back({0, 11, 0 | dfd_qualifier_float, float_one_bits});
+      samples.push_back({11, 11, 1 | dfd_qualifier_float, float_one_bits});
+      samples.push_back({22, 10, 2 | dfd_qualifier_float, float_one_bits});
+      break;
+    case vk_format::undefined:
+      break;
+  }
+
+  if (is_block_compressed(format)) block_dimension = 3 | (3 << 8);
+
+  const auto block_size = static_cast<uint32_t>(24 + 16 * samples.size());
+  std::vector<uint8_t> out;
+  append_u32(out, 4 + block_size);  // dfdTotalSize
+  append_u32(out, 0);                // vendorId = Khronos, descriptorType = basic
+  append_u32(out, 2u | (block_size << 16));  // versionNumber 1.3
+  append_u32(out, model | (dfd_primaries_bt709 << 8) | (dfd_transfer_linear << 16));
+  append_u32(out, block_dimension);
+  append_u32(out, static_cast<uint32_t>(vk_format_block_bytes(format)));  // bytesPlane0
+  append_u32(out, 0);
+
+  for (const auto &sample : samples) {
+    append_u32(out, sample.bit_offset | ((sample.bit_length - 1) << 16) | (sample.channel << 24));
+    append_u32(out, 0);  // sample position
+    append_u32(out, sample.lower);
+    append_u32(out, sample.upper);
+  }
+
+  return out;
+}
+
+}  // namespace
+
+size_t ktx2_texture::size_in_bytes() const {
+  return std::accumulate(levels.begin(), levels.end(), size_t{0},
+                         [](const size_t sum, const ktx2_level &level) { return sum + level.size; });
+}
+
+std::string ktx2_texture::find_metadata(const std::string &key) const {
+  for (const auto &[name, value] : metadata) {
+    if (name == key) return value;
+  }
+  return {};
+}
+
+bool is_block_compressed(const vk_format format) {
+  switch (format) {
+    case vk_format::bc1_rgb_unorm:
+    case vk_format::bc3_unorm:
+    case vk_format::bc4_unorm:
+    case vk_format::bc5_unorm:
+    case vk_format::bc7_unorm:
+      return true;
+    default:
+      return false;
+  }
+}
+
+bool is_float_format(const vk_format format) {
+  return format == vk_format::r16g16b16a16_sfloat || format == vk_format::b10g11r11_ufloat_pack32;
+}
+
+size_t vk_format_block_bytes(const vk_format format) {
+  switch (format) {
+    case vk_format::r8_unorm: return 1;
+    case vk_format::r8g8_unorm: return 2;
+    case vk_format::r8g8b8_unorm: return 3;
+    case vk_format::r8g8b8a8_unorm: return 4;
+    case vk_format::r16g16b16a16_sfloat: return 8;
+    case vk_format::b10g11r11_ufloat_pack32: return 4;
+    case vk_format::bc1_rgb_unorm:
+    case vk_format::bc4_unorm: return 8;
+    case vk_format::bc3_unorm:
+    case vk_format::bc5_unorm:
+    case vk_format::bc7_unorm: return 16;
+    case vk_format::undefined: return 0;
+  }
+  return 0;
+}
+
+size_t vk_format_level_bytes(const vk_format format, const int32_t width, const int32_t height) {
+  const auto w = static_cast<size_t>(std::max(1, width)), h = static_cast<size_t>(std::max(1, height));
+  if (is_block_compressed(format)) return ((w + 3) / 4) * ((h + 3) / 4) * vk_format_block_bytes(format);
+  return w * h * vk_format_block_bytes(format);
+}
+
+vk_format vk_format_for(const bc_format format) {
+  switch (format) {
+    case bc_format::bc1: return vk_format::bc1_rgb_unorm;
+    case bc_format::bc3: return vk_format::bc3_unorm;
+    case bc_format::bc4: return vk_format::bc4_unorm;
+    case bc_format::bc5: return vk_format::bc5_unorm;
+    case bc_format::bc7: return vk_format::bc7_unorm;
+  }
+  return vk_format::undefined;
+}
+
+vk_format vk_format_for_channels(const int32_t channels) {
+  switch (channels) {
+    case 1: return vk_format::r8_unorm;
+    case 2: return vk_format::r8g8_unorm;
+    case 3: return vk_format::r8g8b8_unorm;
+    case 4: return vk_format::r8g8b8a8_unorm;
+    default: return vk_format::undefined;
+  }
+}
+
+bool parse_ktx2(const uint8_t *bytes, const size_t size, ktx2_texture &out) {
+  out = ktx2_texture();
+  if (bytes == nullptr || size < sizeof(ktx2_header)) return false;
+
+  ktx2_header header{};
+  std::memcpy(&header, bytes, sizeof(header));
+
+  if (std::memcmp(header.identifier, ktx2_identifier, sizeof(ktx2_identifier)) != 0) return false;
+  if (header.supercompression_scheme != 0 || header.pixel_depth != 0 || header.layer_count > 1 ||
+      header.face_count != 1 || header.pixel_width == 0 || header.pixel_height == 0 ||
+      header.pixel_width > INT32_MAX || header.pixel_height > INT32_MAX) {
+    return false;
+  }
+
+  const auto format = static_cast<vk_format>(header.vk_format);
+  if (vk_format_block_bytes(format) == 0) return false;
+
+  // No more levels than the full chain down to 1x1, which also keeps every shift below 32.
+  uint32_t full_chain = 1;
+  while ((std::max(header.pixel_width, header.pixel_height) >> full_chain) > 0) ++full_chain;
+  const uint32_t level_count = std::max(1u, header.level_count);
+  if (level_count > full_chain || sizeof(ktx2_header) + level_count * sizeof(ktx2_level_index) > size) return false;
+
+  ktx2_texture result;
+  result.format = format;
+  result.width = static_cast<int32_t>(header.pixel_width);
+  result.height = static_cast<int32_t>(header.pixel_height);
+
+  for (uint32_t level = 0; level < level_count; ++level) {
+    ktx2_level_index index{};
+    std::memcpy(&index, bytes + sizeof(ktx2_header) + level * sizeof(ktx2_level_index), sizeof(index));
+
+    const size_t expected = vk_format_level_bytes(format, result.width >> level, result.height >> level);
+    if (index.byte_offset > size || index.byte_length > size - index.byte_offset || index.byte_length < expected) {
+      return false;
+    }
+
+    result.levels.push_back({bytes + index.byte_offset, expected});
+  }
+
+  if (header.kvd_byte_length > 0) {
+    if (static_cast<uint64_t>(header.kvd_byte_offset) + header.kvd_byte_length > size) return false;
+
+    const uint8_t *cursor = bytes + header.kvd_byte_offset;
+    const uint8_t *end = cursor + header.kvd_byte_length;
+    while (end - cursor >= 4) {
+      uint32_t length;
+      std::memcpy(&length, cursor, 4);
+      cursor += 4;
+      if (length == 0 || length > static_cast<size_t>(end - cursor)) break;
+
+      const auto *entry = reinterpret_cast<const char *>(cursor);
+      const auto *terminator = static_cast<const char *>(std::memchr(entry, '\0', length));
+      if (terminator != nullptr) {
+        const auto key_length = static_cast<size_t>(terminator - entry);
+        std::string value(entry + key_length + 1, length - key_length - 1);
+        if (!value.empty() && value.back() == '\0') value.pop_back();
+        result.metadata.emplace_back(std::string(entry, key_length), std::move(value));
+      }
+
+      cursor += std::min(align_up(length, 4), static_cast<size_t>(end - cursor));
+    }
+  }
+
+  out = std::move(result);
+  return true;
+}
+
+bool write_ktx2(const std::filesystem::path &path, const vk_format format, const int32_t width, const int32_t height,
+                const std::vector<std::vector<uint8_t>> &levels,
+                std::vector<std::pair<std::string, std::string>> metadata) {
+  if (levels.empty() || vk_format_block_bytes(format) == 0) return false;
+
+  metadata.emplace_back("KTXwriter", "3D-Engine");
+  std::sort(metadata.begin(), metadata.end());
+
+  const std::vector<uint8_t> dfd = build_data_format_descriptor(format);
+
+  std::vector<uint8_t> kvd;
+  for (const auto &[key, value] : metadata) {
+    append_u32(kvd, static_cast<uint32_t>(key.size() + 1 + value.size() + 1));
+    kvd.insert(kvd.end(), key.begin(), key.end());
+    kvd.push_back(0);
+    kvd.insert(kvd.end(), value.begin(), value.end());
+    kvd.push_back(0);
+    kvd.resize(align_up(kvd.size(), 4), 0);
+  }
+
+  ktx2_header header{};
+  std::memcpy(header.identifier, ktx2_identifier, sizeof(ktx2_identifier));
+  header.vk_format = static_cast<uint32_t>(format);
+  header.type_size = format == vk_format::r16g16b16a16_sfloat       ? 2
+                     : format == vk_format::b10g11r11_ufloat_pack32 ? 4
+                                                                    : 1;
+  header.pixel_width = static_cast<uint32_t>(width);
+  header.pixel_height = static_cast<uint32_t>(height);
+  header.face_count = 1;
+  header.level_count = static_cast<uint32_t>(levels.size());
+  header.dfd_byte_offset = static_cast<uint32_t>(sizeof(ktx2_header) + levels.size() * sizeof(ktx2_level_index));
+  header.dfd_byte_length = static_cast<uint32_t>(dfd.size());
+  header.kvd_byte_offset = kvd.empty() ? 0 : header.dfd_byte_offset + header.dfd_byte_length;
+  header.kvd_byte_length = static_cast<uint32_t>(kvd.size());
+
+  // Level data goes smallest level first, each aligned to lcm(texel block size, 4).
+  const size_t block_bytes = vk_format_block_bytes(format);
+  const size_t alignment = std::lcm(block_bytes, size_t{4});
+
+  std::vector<ktx2_level_index> index(levels.size());
+  size_t offset = header.dfd_byte_offset + dfd.size() + kvd.size();
+  for (size_t level = levels.size(); level-- > 0;) {
+    offset = align_up(offset, alignment);
+    index[level] = {offset, levels[level].size(), levels[level].size()};
+    offset += levels[level].size();
+  }
+
+  std::vector<uint8_t> file_bytes(offset, 0);
+  std::memcpy(file_bytes.data(), &header, sizeof(header));
+  std::memcpy(file_bytes.data() + sizeof(header), index.data(), index.size() * sizeof(ktx2_level_index));
+  std::memcpy(file_bytes.data() + header.dfd_byte_offset, dfd.data(), dfd.size());
+  if (!kvd.empty()) std::memcpy(file_bytes.data() + header.kvd_byte_offset, kvd.data(), kvd.size());
+  for (size_t level = 0; level < levels.size(); ++level) {
+    std::memcpy(file_bytes.data() + index[level].byte_offset, levels[level].data(), levels[level].size());
+  }
+
+  return mfsys::write_file_atomically(path, file_bytes.data(), file_bytes.size());
+}
@@ -0,0 +1,64 @@
+#ifndef KTX2_H
+#define KTX2_H
+
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "bc_encoder.h"
+
+// Vulkan format numbers, which is how KTX2 names its pixel formats.
+enum class vk_format : uint32_t {
+  undefined = 0,
+  r8_unorm = 9,
+  r8g8_unorm = 16,
+  r8g8b8_unorm = 23,
+  r8g8b8a8_unorm = 37,
+  r16g16b16a16_sfloat = 97,
+  b10g11r11_ufloat_pack32 = 122,
+  bc1_rgb_unorm = 131,
+  bc3_unorm = 137,
+  bc4_unorm = 139,
+  bc5_unorm = 141,
+  bc7_unorm = 145,
+};
+
+struct ktx2_level {
+  const uint8_t *data = nullptr;
+  size_t size = 0;
+};
+
+// A parsed KTX2 file. Levels point into the buffer that was parsed, finest level first.
+struct ktx2_texture {
+  vk_format format = vk_format::undefined;
+  int32_t width = 0;
+  int32_t height = 0;
+  std::vector<ktx2_level> levels;
+  std::vector<std::pair<std::string, std::string>> metadata;
+
+  [[nodiscard]] bool empty() const { return levels.empty(); }
+  [[nodiscard]] size_t size_in_bytes() const;
+  [[nodiscard]] std::string find_metadata(const std::string &key) const;
+};
+
+[[nodiscard]] bool is_block_compressed(vk_format format);
+[[nodiscard]] bool is_float_format(vk_format format);
+// Bytes per 4x4 block for compressed formats, per texel otherwise.
+[[nodiscard]] size_t vk_format_block_bytes(vk_format format);
+[[nodiscard]] size_t vk_format_level_bytes(vk_format format, int32_t width, int32_t height);
+
+[[nodiscard]] vk_format vk_format_for(bc_format format);
+[[nodiscard]] vk_format vk_format_for_channels(int32_t channels);
+
+// Validates a single-layer, single-face 2D texture without supercompression.
+[[nodiscard]] bool parse_ktx2(const uint8_t *bytes, size_t size, ktx2_texture &out);
+
+// Writes `levels` (finest first) with a basic data format descriptor and the given key/value
+// metadata. The file is written next to `path` and renamed into place.
+[[nodiscard]] bool write_ktx2(const std::filesystem::path &path, vk_format format, int32_t width, int32_t height,
+                              const std::vector<std::vector<uint8_t>> &levels,
+                              std::vector<std::pair<std::string, std::string>> metadata = {});
+
+#endif  // KTX2_H
@@ -0,0 +1,418 @@
+#include "mip_generator.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cmath>
+
+#include "../utility/simd.h"
+#include "../utility/thread_pool.h"
+
+namespace {
+
+constexpr float pi = 3.14159265358979f;
+constexpr float kaiser_alpha = 4.0f;
+constexpr int32_t alpha_histogram_bins = 4096;
+// Rows handed to a worker at once are sized to cover roughly this many source texels.
+constexpr size_t texels_per_task = 16384;
+// Runs of at least this many output rows go to one worker so its decoded source rows get reused.
+constexpr size_t rows_per_task = 8;
+
+// Source texels and normalised weights for every destination texel along one axis. Each
+// destination texel owns `taps` consecutive entries; taps outside the kernel have zero weight.
+struct filter_table {
+  int32_t taps = 0;
+  std::vector<int32_t> indices;
+  std::vector<float> weights;
+};
+
+float filter_radius(const mip_filter filter) { return filter == mip_filter::box ? 0.5f : 3.0f; }
+
+float sinc(float x) {
+  if (std::abs(x) < 1.0e-6f) return 1.0f;
+  x *= pi;
+  return std::sin(x) / x;
+}
+
+// Modified Bessel function of the first kind, order zero.
+float bessel_i0(const float x) {
+  const float quarter_square = x * x * 0.25f;
+  float sum = 1.0f, term = 1.0f;
+  for (int32_t k = 1; k < 32; ++k) {
+    term *= quarter_square / static_cast<float>(k * k);
+    sum += term;
+    if (term < sum * 1.0e-8f) break;
+  }
+  return sum;
+}
+
+// `x` is in destination texels.
+float filter_weight(const mip_filter filter, float x) {
+  x = std::abs(x);
+
+  switch (filter) {
+    case mip_filter::box:
+      return x <= 0.5f ? 1.0f : 0.0f;
+    case mip_filter::kaiser: {
+      if (x >= 3.0f) return 0.0f;
+      const float t = x / 3.0f;
+      return sinc(x) * bessel_i0(kaiser_alpha * std::sqrt(1.0f - t * t)) / bessel_i0(kaiser_alpha);
+    }
+    case mip_filter::lanczos:
+      return x >= 3.0f ? 0.0f : sinc(x) * sinc(x / 3.0f);
+  }
+
+  return 0.0f;
+}
+
+filter_table build_filter_table(const mip_filter filter, const int32_t source_size, const int32_t size,
+                                const bool wrap) {
+  const float scale = static_cast<float>(source_size) / static_cast<float>(size);
+  const float support = filter_radius(filter) * scale;
+
+  filter_table table;
+  table.taps = static_cast<int32_t>(std::ceil(2.0f * support)) + 1;
+  table.indices.resize(static_cast<size_t>(size) * table.taps);
+  table.weights.resize(static_cast<size_t>(size) * table.taps);
+
+  for (int32_t i = 0; i < size; ++i) {
+    const float center = (static_cast<float>(i) + 0.5f) * scale;
+    const int32_t first = static_cast<int32_t>(std::floor(center - support - 0.5f));
+    int32_t *indices = &table.indices[static_cast<size_t>(i) * table.taps];
+    float *weights = &table.weights[static_cast<size_t>(i) * table.taps];
+
+    float sum = 0.0f;
+    for (int32_t t = 0; t < table.taps; ++t) {
+      const int32_t source = first + t;
+      indices[t] = wrap ? ((source % source_size) + source_size) % source_size
+                        : std::clamp(source, 0, source_size - 1);
+      weights[t] = filter_weight(filter, (static_cast<float>(source) + 0.5f - center) / scale);
+      sum += weights[t];
+    }
+    for (int32_t t = 0; t < table.taps; ++t) weights[t] /= sum;
+  }
+
+  return table;
+}
+
+float srgb_to_linear(const float value) {
+  return value <= 0.04045f ? value / 12.92f : std::pow((value + 0.055f) / 1.055f, 2.4f);
+}
+
+// Maps 8-bit texels into filtering space: entries [0, 256) for the colour channels, [256, 512)
+// for alpha.
+std::array<float, 512> build_decode_table(const mip_settings &settings) {
+  std::array<float, 512> table{};
+  for (int32_t i = 0; i < 256; ++i) {
+    const float value = static_cast<float>(i) / 255.0f;
+    table[i] = settings.normal_map ? value * 2.0f - 1.0f : settings.srgb ? srgb_to_linear(value) : value;
+    table[256 + i] = value;
+  }
+  return table;
+}
+
+uint8_t linear_to_srgb8(float value) {
+  struct encode_table {
+    // Linear values halfway between consecutive 8-bit codes, so the result rounds exactly.
+    std::array<float, 255> thresholds{};
+    // Code of i / 4096, the starting point of the search for values in that bucket. The sRGB curve
+    // is never steeper than about one code per bucket, so at most a couple of steps follow.
+    std::array<uint8_t, 4097> start{};
+  };
+
+  static const encode_table table = []() {
+    encode_table result;
+    for (int32_t i = 0; i < 255; ++i) result.thresholds[i] = srgb_to_linear((static_cast<float>(i) + 0.5f) / 255.0f);
+    for (int32_t i = 0; i <= 4096; ++i) {
+      const float bucket = static_cast<float>(i) / 4096.0f;
+      result.start[i] = static_cast<uint8_t>(
+          std::upper_bound(result.thresholds.begin(), result.thresholds.end(), bucket) - result.thresholds.begin());
+    }
+    return result;
+  }();
+
+  value = std::clamp(value, 0.0f, 1.0f);
+  int32_t code = table.start[static_cast<int32_t>(value * 4096.0f)];
+  while (code < 255 && value >= table.thresholds[code]) ++code;
+  return static_cast<uint8_t>(code);
+}
+
+#if !defined(ENGINE_SIMD_SSE2)
+uint8_t unorm8(const float value) {
+  return static_cast<uint8_t>(std::clamp(value, 0.0f, 1.0f) * 255.0f + 0.5f);
+}
+#endif
+
+// accumulator[i] += weight * row[i] over `count` floats.
+void accumulate_row(float *accumulator, const float *row, const float weight, const size_t count) {
+  size_t i = 0;
+
+#if defined(ENGINE_SIMD_AVX2)
+  const __m256 weight8 = _mm256_set1_ps(weight);
+  for (; i + 8 <= count; i += 8) {
+    const __m256 weighted = _mm256_mul_ps(weight8, _mm256_loadu_ps(row + i));
+    _mm256_storeu_ps(accumulator + i, _mm256_add_ps(_mm256_loadu_ps(accumulator + i), weighted));
+  }
+#endif
+#if defined(ENGINE_SIMD_SSE2)
+  const __m128 weight4 = _mm_set1_ps(weight);
+  for (; i + 4 <= count; i += 4) {
+    const __m128 weighted = _mm_mul_ps(weight4, _mm_loadu_ps(row + i));
+    _mm_storeu_ps(accumulator + i, _mm_add_ps(_mm_loadu_ps(accumulator + i), weighted));
+  }
+#endif
+
+  for (; i < count; ++i) accumulator[i] += weight * row[i];
+}
+
+// Decodes `count` bytes of an RGBA8 row through `table` (see build_decode_table).
+void decode_row(const uint8_t *row, const float *table, const size_t count, float *out) {
+  size_t i = 0;
+
+#if defined(ENGINE_SIMD_AVX2)
+  const __m256i alpha_offset = _mm256_setr_epi32(0, 0, 0, 256, 0, 0, 0, 256);
+  for (; i + 8 <= count; i += 8) {
+    const __m128i bytes = _mm_loadl_epi64(reinterpret_cast<const __m128i *>(row + i));
+    const __m256i index = _mm256_add_epi32(_mm256_cvtepu8_epi32(bytes), alpha_offset);
+    _mm256_storeu_ps(out + i, _mm256_i32gather_ps(table, index, 4));
+  }
+#endif
+
+  for (; i < count; ++i) out[i] = table[row[i] + ((i & 3) == 3 ? 256 : 0)];
+}
+
+// Source rows decoded by the current thread. Neighbouring output rows share most of their kernel
+// window, so with rows handed out in runs every 8-bit row is decoded about once per level instead
+// of once per tap. Rows live in slot (row % slots); `pass` tells one level's rows from another's.
+struct decoded_rows {
+  uint64_t pass = 0;
+  std::vector<int32_t> tags;
+  std::vector<float> storage;
+};
+
+std::atomic<uint64_t> next_pass{1};
+
+const float *decoded_source_row(const uint64_t pass, const image &rgba, const int32_t row, const float *table,
+                                const int32_t slots) {
+  thread_local decoded_rows cache;
+
+  const size_t row_floats = static_cast<size_t>(rgba.width) * 4;
+  if (cache.pass != pass) {
+    cache.pass = pass;
+    cache.tags.assign(slots, -1);
+    cache.storage.resize(row_floats * slots);
+  }
+
+  const int32_t slot = row % slots;
+  float *decoded = &cache.storage[slot * row_floats];
+  if (cache.tags[slot] != row) {
+    decode_row(&rgba.pixels[row * row_floats], table, row_floats, decoded);
+    cache.tags[slot] = row;
+  }
+
+  return decoded;
+}
+
+// Applies the horizontal filter to one vertically filtered RGBA row and writes `width` texels.
+// Colour and alpha are clamped to [0, 1]; normals are renormalised instead.
+void filter_row(const float *accumulator, const filter_table &columns, const int32_t width, const bool normal_map,
+                float *out) {
+  for (int32_t x = 0; x < width; ++x) {
+    const int32_t *indices = &columns.indices[static_cast<size_t>(x) * columns.taps];
+    const float *weights = &columns.weights[static_cast<size_t>(x) * columns.taps];
+    float *texel = out + static_cast<size_t>(x) * 4;
+
+#if defined(ENGINE_SIMD_SSE2)
+    __m128 sum = _mm_setzero_ps();
+    for (int32_t t = 0; t < columns.taps; ++t) {
+      sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(weights[t]), _mm_loadu_ps(accumulator + indices[t] * 4)));
+    }
+    if (!normal_map) sum = _mm_min_ps(_mm_max_ps(sum, _mm_setzero_ps()), _mm_set1_ps(1.0f));
+    _mm_storeu_ps(texel, sum);
+#else
+    float sum[4] = {};
+    for (int32_t t = 0; t < columns.taps; ++t) {
+      for (int32_t c = 0; c < 4; ++c) sum[c] += weights[t] * accumulator[indices[t] * 4 + c];
+    }
+    for (int32_t c = 0; c < 4; ++c) texel[c] = normal_map ? sum[c] : std::clamp(sum[c], 0.0f, 1.0f);
+#endif
+
+    if (normal_map) {
+      const float length = std::sqrt(texel[0] * texel[0] + texel[1] * texel[1] + texel[2] * texel[2]);
+      if (length > 1.0e-6f) {
+        for (int32_t c = 0; c < 3; ++c) texel[c] /= length;
+      } else {
+        texel[0] = 0.0f, texel[1] = 0.0f, texel[2] = 1.0f;
+      }
+      texel[3] = std::clamp(texel[3], 0.0f, 1.0f);
+    }
+  }
+}
+
+void quantize_row(const float *texels, const int32_t width, const mip_settings &settings, const float alpha_scale,
+                  const int32_t channels, uint8_t *out) {
+  const bool srgb = settings.srgb && !settings.normal_map;
+
+#if defined(ENGINE_SIMD_SSE2)
+  // Normals map [-1, 1] to [0, 1]; everything is then scaled to [0, 255] and rounded.
+  const __m128 bias = settings.normal_map ? _mm_setr_ps(0.5f, 0.5f, 0.5f, 0.0f) : _mm_setzero_ps();
+  const __m128 scale = settings.normal_map ? _mm_setr_ps(0.5f, 0.5f, 0.5f, alpha_scale)
+                                           : _mm_setr_ps(1.0f, 1.0f, 1.0f, alpha_scale);
+#endif
+
+  for (int32_t x = 0; x < width; ++x) {
+    const float *texel = texels + static_cast<size_t>(x) * 4;
+
+    uint8_t rgba[4];
+#if defined(ENGINE_SIMD_SSE2)
+    __m128 value = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(texel), scale), bias);
+    value = _mm_min_ps(_mm_max_ps(value, _mm_setzero_ps()), _mm_set1_ps(1.0f));
+    const __m128i rounded = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(value, _mm_set1_ps(255.0f)), _mm_set1_ps(0.5f)));
+    const __m128i words = _mm_packs_epi32(rounded, rounded);
+    const auto packed = static_cast<uint32_t>(_mm_cvtsi128_si32(_mm_packus_epi16(words, words)));
+    for (int32_t c = 0; c < 4; ++c) rgba[c] = static_cast<uint8_t>(packed >> (8 * c));
+#else
+    for (int32_t c = 0; c < 3; ++c) rgba[c] = unorm8(settings.normal_map ? texel[c] * 0.5f + 0.5f : texel[c]);
+    rgba[3] = unorm8(texel[3] * alpha_scale);
+#endif
+    if (srgb) {
+      for (int32_t c = 0; c < 3; ++c) rgba[c] = linear_to_srgb8(texel[c]);
+    }
+
+    uint8_t *pixel = out + static_cast<size_t>(x) * channels;
+    switch (channels) {
+      case 1:
+        pixel[0] = rgba[0];
+        break;
+      case 2:
+        pixel[0] = rgba[0], pixel[1] = rgba[3];
+        break;
+      default:
+        for (int32_t c = 0; c < channels; ++c) pixel[c] = rgba[c];
+        break;
+    }
+  }
+}
+
+float alpha_coverage(const image &rgba, const float cutoff) {
+  size_t passing = 0;
+  for (size_t i = 3; i < rgba.pixels.size(); i += 4) passing += static_cast<float>(rgba.pixels[i]) / 255.0f > cutoff;
+  return static_cast<float>(passing) / static_cast<float>(rgba.pixels.size() / 4);
+}
+
+// Returns the scale that makes `coverage` of the level's alpha values pass `cutoff`.
+float coverage_alpha_scale(const std::vector<float> &texels, const float coverage, const float cutoff) {
+  std::vector<size_t> histogram(alpha_histogram_bins, 0);
+  for (size_t i = 3; i < texels.size(); i += 4) {
+    ++histogram[std::min(static_cast<int32_t>(texels[i] * alpha_histogram_bins), alpha_histogram_bins - 1)];
+  }
+
+  const double wanted = static_cast<double>(coverage) * static_cast<double>(texels.size() / 4);
+  size_t above = 0;
+  int32_t bin = alpha_histogram_bins - 1;
+  for (; bin > 0; --bin) {
+    above += histogram[bin];
+    if (static_cast<double>(above) >= wanted) break;
+  }
+
+  const float threshold = static_cast<float>(std::max(bin, 1)) / alpha_histogram_bins;
+  return cutoff / threshold;
+}
+
+}  // namespace
+
+const char *mip_filter_name(const mip_filter filter) {
+  switch (filter) {
+    case mip_filter::box:
+      return "box";
+    case mip_filter::kaiser:
+      return "kaiser";
+    case mip_filter::lanczos:
+      return "lanczos";
+  }
+  return "unknown";
+}
+
+std::vector<image> generate_mip_chain(const image &source, const mip_settings &settings, thread_pool &pool) {
+  std::vector<image> chain;
+  if (source.empty()) return chain;
+
+  chain.push_back(source);
+
+  const image converted = source.channels == 4 ? image{} : convert_channels(source, 4);
+  const image &rgba = source.channels == 4 ? source : converted;
+  const std::array<float, 512> decode = build_decode_table(settings);
+  const bool has_alpha = source.channels == 2 || source.channels == 4;
+  const float coverage = settings.alpha_cutoff > 0.0f && has_alpha ? alpha_coverage(rgba, settings.alpha_cutoff) : 0.0f;
+
+  // Filtering-space RGBA of the previous level; empty while that level is the 8-bit source.
+  std::vector<float> previous;
+  int32_t width = source.width, height = source.height;
+
+  while (width > 1 || height > 1) {
+    const int32_t next_width = std::max(1, width / 2);
+    const int32_t next_height = std::max(1, height / 2);
+    const filter_table columns = build_filter_table(settings.filter, width, next_width, settings.wrap);
+    const filter_table rows = build_filter_table(settings.filter, height, next_height, settings.wrap);
+    const size_t row_floats = static_cast<size_t>(width) * 4;
+
+    const uint64_t pass = next_pass++;
+    const int32_t cache_slots = rows.taps + 2;
+
+    std::vector<float> texels(static_cast<size_t>(next_width) * next_height * 4);
+    pool.parallel_for(
+        0, static_cast<size_t>(next_height),
+        [&](const size_t y) {
+          // Vertical pass into a full-width row, then the horizontal pass out of it, so no
+          // intermediate image is ever allocated.
+          thread_local std::vector<float> accumulator;
+          accumulator.assign(row_floats, 0.0f);
+
+          for (int32_t t = 0; t < rows.taps; ++t) {
+            const float weight = rows.weights[y * rows.taps + t];
+            if (weight == 0.0f) continue;
+
+            const int32_t source_row = rows.indices[y * rows.taps + t];
+            const float *row = previous.empty()
+                                   ? decoded_source_row(pass, rgba, source_row, decode.data(), cache_slots)
+                                   : &previous[static_cast<size_t>(source_row) * row_floats];
+            accumulate_row(accumulator.data(), row, weight, row_floats);
+          }
+
+          filter_row(accumulator.data(), columns, next_width, settings.normal_map,
+                     &texels[y * next_width * 4]);
+        },
+        std::max<size_t>(rows_per_task, texels_per_task / row_floats));
+
+    const float alpha_scale = coverage > 0.0f ? coverage_alpha_scale(texels, coverage, settings.alpha_cutoff) : 1.0f;
+
+    image level;
+    level.width = next_width;
+    level.height = next_height;
+    level.channels = source.channels;
+    level.pixels.resize(static_cast<size_t>(next_width) * next_height * source.channels);
+
+    pool.parallel_for(
+        0, static_cast<size_t>(next_height),
+        [&](const size_t y) {
+          quantize_row(&texels[y * next_width * 4], next_width, settings, alpha_scale, source.channels,
+                       &level.pixels[y * next_width * source.channels]);
+        },
+        std::max<size_t>(1, texels_per_task / next_width));
+
+    chain.push_back(std::move(level));
+    previous = std::move(texels);
+    width = next_width;
+    height = next_height;
+  }
+
+  return chain;
+}
+
+std::vector<std::vector<image>> generate_mip_chains(const std::vector<image> &sources, const mip_settings &settings,
+                                                    thread_pool &pool) {
+  std::vector<std::vector<image>> chains(sources.size());
+  pool.parallel_for(0, sources.size(),
+                    [&](const size_t i) { chains[i] = generate_mip_chain(sources[i], settings, pool); });
+  return chains;
+}
@@ -0,0 +1,44 @@
+#ifndef MIP_GENERATOR_H
+#define MIP_GENERATOR_H
+
+#include <cstdint>
+#include <vector>
+
+#include "image.h"
+
+class thread_pool;
+
+enum class mip_filter : uint8_t {
+  box,      // 2x2 average, the same result as glGenerateMipmap
+  kaiser,   // Kaiser-windowed sinc, radius 3 destination texels
+  lanczos,  // Lanczos-3; sharpest, with some ringing on hard edges
+};
+
+struct mip_settings {
+  mip_filter filter = mip_filter::kaiser;
+  // Colour channels hold sRGB-encoded values and are filtered in linear light. Alpha is always
+  // treated as linear.
+  bool srgb = false;
+  // RGB holds a unit vector packed as 0.5 * n + 0.5; every filtered texel is renormalised.
+  // Takes precedence over srgb.
+  bool normal_map = false;
+  // For alpha-tested textures: when above zero, the alpha of every level is scaled so the fraction
+  // of texels passing this cutoff matches level 0, which keeps foliage from thinning out.
+  float alpha_cutoff = 0.0f;
+  // Filter across the edges as GL_REPEAT samples them; clamps to the edge texels otherwise.
+  bool wrap = true;
+};
+
+[[nodiscard]] const char *mip_filter_name(mip_filter filter);
+
+// Returns the full mip chain of `source` down to 1x1, finest level (a copy of `source`) first.
+// Every level keeps the channel count of `source`. Each level is built from the unquantised
+// previous level, with output rows spread over the pool.
+[[nodiscard]] std::vector<image> generate_mip_chain(const image &source, const mip_settings &settings,
+                                                    thread_pool &pool);
+
+// Builds the chains of several images at once; images and rows share the pool's workers.
+[[nodiscard]] std::vector<std::vector<image>> generate_mip_chains(const std::vector<image> &sources,
+                                                                  const mip_settings &settings, thread_pool &pool);
+
+#endif  // MIP_GENERATOR_H
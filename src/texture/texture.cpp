@@ -0,0 +1,329 @@
+#include "texture.h"
+
+#include "image.h"
+
+#include <algorithm>
+#include <utility>
+
+namespace {
+
+// EXT_texture_compression_s3tc is not part of the core profile headers.
+constexpr GLenum compressed_rgb_s3tc_dxt1 = 0x83F0;
+constexpr GLenum compressed_rgba_s3tc_dxt5 = 0x83F3;
+
+}  // namespace
+
+GLenum texture_format_for_channels(const int32_t channels) {
+  switch (channels) {
+    case 1: return GL_RED;
+    case 2: return GL_RG;
+    case 3: return GL_RGB;
+    case 4: return GL_RGBA;
+    default: return 0;
+  }
+}
+
+GLenum texture_internal_format_for_channels(const int32_t channels) {
+  switch (channels) {
+    case 1: return GL_R8;
+    case 2: return GL_RG8;
+    case 3: return GL_RGB8;
+    case 4: return GL_RGBA8;
+    default: return 0;
+  }
+}
+
+int32_t mip_level_count(const int32_t width, const int32_t height) {
+  int32_t levels = 1;
+  for (int32_t size = std::max(width, height); size > 1; size >>= 1) ++levels;
+  return levels;
+}
+
+uint32_t allocate_texture(const int32_t width, const int32_t height, const int32_t channels) {
+  uint32_t texture_id;
+  glGenTextures(1, &texture_id);
+  glBindTexture(GL_TEXTURE_2D, texture_id);
+
+  const int32_t levels = mip_level_count(width, height);
+  const GLenum internal_format = texture_internal_format_for_channels(channels);
+
+  if (GLAD_GL_VERSION_4_2) {
+    glTexStorage2D(GL_TEXTURE_2D, levels, internal_format, width, height);
+  } else {
+    const GLenum format = texture_format_for_channels(channels);
+    for (int32_t level = 0; level < levels; ++level) {
+      glTexImage2D(GL_TEXTURE_2D, level, static_cast<GLint>(internal_format), std::max(1, width >> level),
+                   std::max(1, height >> level), 0, format, GL_UNSIGNED_BYTE, nullptr);
+    }
+  }
+
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+  return texture_id;
+}
+
+uint32_t create_texture(const image &source) {
+  uint32_t texture_id;
+  glGenTextures(1, &texture_id);
+
+  if (source.empty()) return texture_id;
+
+  const GLenum format = texture_format_for_channels(source.channels);
+
+  // Rows of 1 and 3 channel images are tightly packed and not 4-byte aligned.
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+  glBindTexture(GL_TEXTURE_2D, texture_id);
+  glTexImage2D(GL_TEXTURE_2D, 0, static_cast<GLint>(format), source.width, source.height, 0, format,
+               GL_UNSIGNED_BYTE, source.pixels.data());
+  glGenerateMipmap(GL_TEXTURE_2D);
+
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+  return texture_id;
+}
+
+uint32_t create_hdr_texture(const hdr_image &source, hdr_format format) {
+  uint32_t texture_id;
+  glGenTextures(1, &texture_id);
+  if (source.empty()) return texture_id;
+
+  if (format == hdr_format::rgbe || format == hdr_format::rgbm) format = hdr_format::rgba16f;
+  const std::vector<uint8_t> texels = encode_hdr_image(source, format);
+
+  glBindTexture(GL_TEXTURE_2D, texture_id);
+  switch (format) {
+    case hdr_format::rgba32f:
+      glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA32F, source.width, source.height, 0, GL_RGBA, GL_FLOAT, texels.data());
+      break;
+    case hdr_format::r11g11b10f:
+      glTexImage2D(GL_TEXTURE_2D, 0, GL_R11F_G11F_B10F, source.width, source.height, 0, GL_RGB,
+                   GL_UNSIGNED_INT_10F_11F_11F_REV, texels.data());
+      break;
+    default:
+      glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, source.width, source.height, 0, GL_RGBA, GL_HALF_FLOAT,
+                   texels.data());
+      break;
+  }
+  glGenerateMipmap(GL_TEXTURE_2D);
+
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+  return texture_id;
+}
+
+GLenum compressed_internal_format(const bc_format format) {
+  switch (format) {
+    case bc_format::bc1: return compressed_rgb_s3tc_dxt1;
+    case bc_format::bc3: return compressed_rgba_s3tc_dxt5;
+    case bc_format::bc4: return GL_COMPRESSED_RED_RGTC1;
+    case bc_format::bc5: return GL_COMPRESSED_RG_RGTC2;
+    case bc_format::bc7: return GL_COMPRESSED_RGBA_BPTC_UNORM;
+  }
+  return 0;
+}
+
+uint32_t allocate_compressed_texture(const int32_t level_count) {
+  uint32_t texture_id;
+  glGenTextures(1, &texture_id);
+  glBindTexture(GL_TEXTURE_2D, texture_id);
+
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, level_count - 1);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+  return texture_id;
+}
+
+uint32_t create_compressed_texture(const compressed_texture &source) {
+  if (source.empty()) {
+    uint32_t texture_id;
+    glGenTextures(1, &texture_id);
+    return texture_id;
+  }
+
+  const uint32_t texture_id = allocate_compressed_texture(static_cast<int32_t>(source.levels.size()));
+  const GLenum internal_format = compressed_internal_format(source.format);
+
+  for (size_t level = 0; level < source.levels.size(); ++level) {
+    const int32_t width = std::max(1, source.width >> level), height = std::max(1, source.height >> level);
+    glCompressedTexImage2D(GL_TEXTURE_2D, static_cast<GLint>(level), internal_format, width, height, 0,
+                           static_cast<GLsizei>(source.levels[level].size()), source.levels[level].data());
+  }
+
+  return texture_id;
+}
+
+namespace {
+
+// Internal format and, for uncompressed data, the pixel format and type of a KTX2 texture.
+struct gl_formats {
+  GLenum internal_format;
+  GLenum format;
+  GLenum type;
+};
+
+gl_formats ktx2_gl_formats(const vk_format format) {
+  switch (format) {
+    case vk_format::bc1_rgb_unorm: return {compressed_internal_format(bc_format::bc1), 0, 0};
+    case vk_format::bc3_unorm: return {compressed_internal_format(bc_format::bc3), 0, 0};
+    case vk_format::bc4_unorm: return {compressed_internal_format(bc_format::bc4), 0, 0};
+    case vk_format::bc5_unorm: return {compressed_internal_format(bc_format::bc5), 0, 0};
+    case vk_format::bc7_unorm: return {compressed_internal_format(bc_format::bc7), 0, 0};
+    case vk_format::r16g16b16a16_sfloat: return {GL_RGBA16F, GL_RGBA, GL_HALF_FLOAT};
+    case vk_format::b10g11r11_ufloat_pack32: return {GL_R11F_G11F_B10F, GL_RGB, GL_UNSIGNED_INT_10F_11F_11F_REV};
+    default: {
+      const auto channels = static_cast<int32_t>(vk_format_block_bytes(format));
+      return {texture_internal_format_for_channels(channels), texture_format_for_channels(channels), GL_UNSIGNED_BYTE};
+    }
+  }
+}
+
+}  // namespace
+
+void upload_ktx2_level(const ktx2_texture &source, const int32_t level, const void *pixels) {
+  const auto [internal_format, format, type] = ktx2_gl_formats(source.format);
+  const int32_t width = std::max(1, source.width >> level), height = std::max(1, source.height >> level);
+
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+  if (is_block_compressed(source.format)) {
+    glCompressedTexImage2D(GL_TEXTURE_2D, level, internal_format, width, height, 0,
+                           static_cast<GLsizei>(source.levels[level].size), pixels);
+  } else {
+    glTexImage2D(GL_TEXTURE_2D, level, static_cast<GLint>(internal_format), width, height, 0, format,
+                 type, pixels);
+  }
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+}
+
+uint32_t allocate_ktx2_texture(const ktx2_texture &like) {
+  const auto level_count = std::max(1, static_cast<int32_t>(like.levels.size()));
+  const uint32_t texture_id = allocate_compressed_texture(level_count);
+  const auto [internal_format, format, type] = ktx2_gl_formats(like.format);
+
+  if (GLAD_GL_VERSION_4_2) {
+    glTexStorage2D(GL_TEXTURE_2D, level_count, internal_format, like.width, like.height);
+    return texture_id;
+  }
+  for (int32_t level = 0; level < level_count; ++level) {
+    const int32_t width = std::max(1, like.width >> level), height = std::max(1, like.height >> level);
+    if (is_block_compressed(like.format)) {
+      glCompressedTexImage2D(GL_TEXTURE_2D, level, internal_format, width, height, 0,
+                             static_cast<GLsizei>(vk_format_level_bytes(like.format, width, height)), nullptr);
+    } else {
+      glTexImage2D(GL_TEXTURE_2D, level, static_cast<GLint>(internal_format), width, height, 0, format, type,
+                   nullptr);
+    }
+  }
+  return texture_id;
+}
+
+void upload_ktx2_rows(const ktx2_texture &source, const int32_t level, const int32_t first_row,
+                      const int32_t row_count, const void *pixels) {
+  const auto [internal_format, format, type] = ktx2_gl_formats(source.format);
+  const int32_t width = std::max(1, source.width >> level), height = std::max(1, source.height >> level);
+
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+  if (is_block_compressed(source.format)) {
+    // The last block row may hang over the level's edge.
+    const int32_t y = first_row * 4;
+    const int32_t rows_high = std::min(row_count * 4, height - y);
+    const size_t bytes = vk_format_level_bytes(source.format, width, row_count * 4);
+    glCompressedTexSubImage2D(GL_TEXTURE_2D, level, 0, y, width, rows_high, internal_format,
+                              static_cast<GLsizei>(bytes), pixels);
+  } else {
+    glTexSubImage2D(GL_TEXTURE_2D, level, 0, first_row, width, row_count, format, type, pixels);
+  }
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+}
+
+void upload_ktx2_layer_rows(const ktx2_texture &source, const int32_t level, const int32_t layer,
+                            const int32_t first_row, const int32_t row_count, const void *pixels) {
+  const auto [internal_format, format, type] = ktx2_gl_formats(source.format);
+  const int32_t width = std::max(1, source.width >> level), height = std::max(1, source.height >> level);
+
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+  if (is_block_compressed(source.format)) {
+    const int32_t y = first_row * 4;
+    const int32_t rows_high = std::min(row_count * 4, height - y);
+    const size_t bytes = vk_format_level_bytes(source.format, width, row_count * 4);
+    glCompressedTexSubImage3D(GL_TEXTURE_2D_ARRAY, level, 0, y, layer, width, rows_high, 1, internal_format,
+                              static_cast<GLsizei>(bytes), pixels);
+  } else {
+    glTexSubImage3D(GL_TEXTURE_2D_ARRAY, level, 0, first_row, layer, width, row_count, 1, format, type, pixels);
+  }
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+}
+
+void release_ktx2_level(const ktx2_texture &source, const int32_t level) {
+  const auto [internal_format, format, type] = ktx2_gl_formats(source.format);
+
+  if (is_block_compressed(source.format)) {
+    glCompressedTexImage2D(GL_TEXTURE_2D, level, internal_format, 0, 0, 0, 0, nullptr);
+  } else {
+    glTexImage2D(GL_TEXTURE_2D, level, static_cast<GLint>(internal_format), 0, 0, 0, format, type,
+                 nullptr);
+  }
+}
+
+uint32_t create_ktx2_texture(const ktx2_texture &source, const bool from_unpack_buffer) {
+  const auto level_count = static_cast<int32_t>(source.levels.size());
+  const uint32_t texture_id = allocate_compressed_texture(std::max(1, level_count));
+  if (source.empty()) return texture_id;
+
+  size_t offset = 0;
+  for (int32_t level = 0; level < level_count; ++level) {
+    const ktx2_level &data = source.levels[level];
+    upload_ktx2_level(source, level, from_unpack_buffer ? reinterpret_cast<const void *>(offset) : data.data);
+    offset += data.size;
+  }
+
+  return texture_id;
+}
+
+uint32_t allocate_ktx2_texture_array(const ktx2_texture &like, const int32_t layers) {
+  uint32_t texture_id;
+  glGenTextures(1, &texture_id);
+  glBindTexture(GL_TEXTURE_2D_ARRAY, texture_id);
+
+  const auto level_count = std::max(1, static_cast<int32_t>(like.levels.size()));
+  const auto [internal_format, format, type] = ktx2_gl_formats(like.format);
+
+  if (GLAD_GL_VERSION_4_2) {
+    glTexStorage3D(GL_TEXTURE_2D_ARRAY, level_count, internal_format, like.width, like.height, layers);
+  } else {
+    for (int32_t level = 0; level < level_count; ++level) {
+      const int32_t width = std::max(1, like.width >> level), height = std::max(1, like.height >> level);
+      if (is_block_compressed(like.format)) {
+        const size_t bytes = vk_format_level_bytes(like.format, width, height) * layers;
+        glCompressedTexImage3D(GL_TEXTURE_2D_ARRAY, level, internal_format, width, height, layers, 0,
+                               static_cast<GLsizei>(bytes), nullptr);
+      } else {
+        glTexImage3D(GL_TEXTURE_2D_ARRAY, level, static_cast<GLint>(internal_format), width, height, layers, 0,
+                     format, type, nullptr);
+      }
+    }
+  }
+
+  glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_LEVEL, level_count - 1);
+  glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_REPEAT);
+  glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_REPEAT);
+  glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+  return texture_id;
+}
+
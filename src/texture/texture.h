@@ -0,0 +1,71 @@
+#ifndef TEXTURE_H
+#define TEXTURE_H
+
+#include <glad/glad.h>
+
+#include <cstdint>
+
+#include "bc_encoder.h"
+#include "hdr_image.h"
+#include "ktx2.h"
+
+struct image;
+
+[[nodiscard]] GLenum texture_format_for_channels(int32_t channels);
+[[nodiscard]] GLenum texture_internal_format_for_channels(int32_t channels);
+
+[[nodiscard]] int32_t mip_level_count(int32_t width, int32_t height);
+
+// Creates a repeating, trilinear 2D texture with storage for the whole mip chain but no contents.
+// The texture is left bound to GL_TEXTURE_2D.
+[[nodiscard]] uint32_t allocate_texture(int32_t width, int32_t height, int32_t channels);
+
+// Uploads a float image in `format` and builds its mip chain on the GPU. RGBE and RGBM are storage
+// encodings and upload as RGBA16F.
+[[nodiscard]] uint32_t create_hdr_texture(const hdr_image &source, hdr_format format);
+
+[[nodiscard]] GLenum compressed_internal_format(bc_format format);
+
+// Creates a repeating, trilinear 2D texture for a pre-built compressed mip chain of `level_count`
+// levels, without contents. The texture is left bound to GL_TEXTURE_2D.
+[[nodiscard]] uint32_t allocate_compressed_texture(int32_t level_count);
+
+// Uploads a decoded image as a mipmapped, repeating 2D texture. Must run on the thread that owns
+// the GL context.
+[[nodiscard]] uint32_t create_texture(const image &source);
+
+// Uploads every level of a block-compressed texture with glCompressedTexImage2D.
+[[nodiscard]] uint32_t create_compressed_texture(const compressed_texture &source);
+
+// Uploads the stored mip chain of a KTX2 texture level by level; nothing is decoded or generated.
+// With `from_unpack_buffer` the levels are read from the bound GL_PIXEL_UNPACK_BUFFER, packed back
+// to back from offset 0 in the order of `source.levels`.
+[[nodiscard]] uint32_t create_ktx2_texture(const ktx2_texture &source, bool from_unpack_buffer = false);
+
+// Specifies `level` of the texture bound to GL_TEXTURE_2D from the matching KTX2 level. `pixels`
+// may be an offset into the bound GL_PIXEL_UNPACK_BUFFER.
+void upload_ktx2_level(const ktx2_texture &source, int32_t level, const void *pixels);
+
+// Creates a repeating, trilinear 2D texture with the format, size and mip count of `like`, without
+// contents. The texture is left bound to GL_TEXTURE_2D.
+[[nodiscard]] uint32_t allocate_ktx2_texture(const ktx2_texture &like);
+
+// Replaces `row_count` rows of `level` of the texture bound to GL_TEXTURE_2D from `first_row` on,
+// counted in 4-texel block rows when compressed. `pixels` may be an offset into the bound
+// GL_PIXEL_UNPACK_BUFFER.
+void upload_ktx2_rows(const ktx2_texture &source, int32_t level, int32_t first_row, int32_t row_count,
+                      const void *pixels);
+
+// The same for `layer` of the array bound to GL_TEXTURE_2D_ARRAY.
+void upload_ktx2_layer_rows(const ktx2_texture &source, int32_t level, int32_t layer, int32_t first_row,
+                            int32_t row_count, const void *pixels);
+
+// Creates a repeating, trilinear GL_TEXTURE_2D_ARRAY of `layers` layers with the format, size and
+// mip count of `like`, without contents. The array is left bound to GL_TEXTURE_2D_ARRAY.
+[[nodiscard]] uint32_t allocate_ktx2_texture_array(const ktx2_texture &like, int32_t layers);
+
+// Re-specifies `level` of the bound texture as 0x0 so the driver can release its memory. The level
+// must lie outside [GL_TEXTURE_BASE_LEVEL, GL_TEXTURE_MAX_LEVEL] or the texture becomes incomplete.
+void release_ktx2_level(const ktx2_texture &source, int32_t level);
+
+#endif  // TEXTURE_H
@@ -0,0 +1,62 @@
+#include "texture_array.h"
+
+#include <glad/glad.h>
+
+#include <iomanip>
+#include <iostream>
+
+#include "texture.h"
+
+texture_array_set::~texture_array_set() {
+  for (const auto &array : arrays_) glDeleteTextures(1, &array.texture);
+}
+
+std::vector<texture_array_slot> texture_array_set::allocate(const std::vector<const ktx2_texture *> &sources) {
+  std::vector<texture_array_slot> slots(sources.size());
+  const size_t first_array = arrays_.size();
+
+  // Sources are few, so a linear search for the matching shape is fine.
+  for (size_t i = 0; i < sources.size(); ++i) {
+    const ktx2_texture *source = sources[i];
+    if (source == nullptr || source->empty()) continue;
+
+    const auto level_count = static_cast<int32_t>(source->levels.size());
+    size_t index = first_array;
+    while (index < arrays_.size() &&
+           (arrays_[index].format != source->format || arrays_[index].width != source->width ||
+            arrays_[index].height != source->height || arrays_[index].level_count != level_count)) {
+      ++index;
+    }
+
+    if (index == arrays_.size()) {
+      texture_array &array = arrays_.emplace_back();
+      array.format = source->format;
+      array.width = source->width;
+      array.height = source->height;
+      array.level_count = level_count;
+    }
+
+    texture_array &array = arrays_[index];
+    slots[i] = {static_cast<int32_t>(index), array.layers++};
+    array.bytes += source->size_in_bytes();
+  }
+
+  for (size_t index = first_array; index < arrays_.size(); ++index) {
+    texture_array &array = arrays_[index];
+    size_t i = 0;
+    while (slots[i].array != static_cast<int32_t>(index)) ++i;
+    array.texture = allocate_ktx2_texture_array(*sources[i], array.layers);
+  }
+  glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+
+  return slots;
+}
+
+void texture_array_set::print_layout(std::ostream &out) const {
+  for (size_t index = 0; index < arrays_.size(); ++index) {
+    const texture_array &array = arrays_[index];
+    out << "texture array " << index << ": " << array.width << "x" << array.height << ", " << array.level_count
+        << " levels, format " << static_cast<uint32_t>(array.format) << ", " << array.layers << " layers, "
+        << std::fixed << std::setprecision(1) << static_cast<double>(array.bytes) / 1024.0 << " KiB" << std::endl;
+  }
+}
@@ -0,0 +1,53 @@
+#ifndef TEXTURE_ARRAY_H
+#define TEXTURE_ARRAY_H
+
+#include <cstdint>
+#include <iosfwd>
+#include <vector>
+
+#include "ktx2.h"
+
+// Where a texture ended up after packing: layer `layer` of array `array`, or nowhere (-1).
+struct texture_array_slot {
+  int32_t array = -1;
+  int32_t layer = -1;
+
+  [[nodiscard]] bool valid() const { return array >= 0; }
+};
+
+// Packs KTX2 textures that share a format, size and mip count into one GL_TEXTURE_2D_ARRAY per
+// shape, so anything sampling them only needs the array bound, not the individual texture.
+class texture_array_set {
+ public:
+  texture_array_set() = default;
+  texture_array_set(const texture_array_set &) = delete;
+  texture_array_set &operator=(const texture_array_set &) = delete;
+
+  ~texture_array_set();
+
+  // Groups `sources` by shape and creates one array per group, without contents; each source's
+  // levels then go into its layer, see texture_uploader::request_levels(). Returns the slot of each
+  // source, in order; empty sources get an invalid slot. Must run on the thread that owns the GL
+  // context.
+  [[nodiscard]] std::vector<texture_array_slot> allocate(const std::vector<const ktx2_texture *> &sources);
+
+  [[nodiscard]] uint32_t texture(int32_t array) const { return arrays_[array].texture; }
+  [[nodiscard]] size_t size() const { return arrays_.size(); }
+
+  void print_layout(std::ostream &out) const;
+
+ private:
+  struct texture_array {
+    uint32_t texture = 0;
+    vk_format format = vk_format::undefined;
+    int32_t width = 0;
+    int32_t height = 0;
+    int32_t level_count = 0;
+    int32_t layers = 0;
+    size_t bytes = 0;
+  };
+
+  std::vector<texture_array> arrays_;
+};
+
+#endif  // TEXTURE_ARRAY_H
@@ -0,0 +1,102 @@
+#include "texture_cache.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <string>
+
+#include "ktx2.h"
+#include "../utility/hash.h"
+
+namespace {
+
+// Bump whenever the encoder output changes so stale cache entries are rebuilt.
+constexpr uint32_t cache_version = 3;
+
+}  // namespace
+
+bool write_compressed_texture(const std::vector<uint8_t> &bytes, const std::string &name,
+                              const texture_compression &compression, const std::filesystem::path &output,
+                              thread_pool &pool) {
+  image source;
+  if (!decode_image(bytes.data(), bytes.size(), source)) return false;
+
+  const auto start = std::chrono::steady_clock::now();
+  const compressed_texture result =
+      compress_texture(source, compression.format, compression.quality, pool, compression.mips);
+  const std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+
+  std::cout << "Compressed " << name << " to " << bc_format_name(result.format) << " in " << elapsed.count()
+            << " ms, PSNR " << result.psnr << " dB" << std::endl;
+
+  return write_ktx2(output, vk_format_for(result.format), result.width, result.height, result.levels,
+                    {{"engine.psnr", std::to_string(result.psnr)}});
+}
+
+bool write_hdr_texture(const std::vector<uint8_t> &bytes, const std::string &name, const hdr_format format,
+                       const std::filesystem::path &output) {
+  if (format == hdr_format::rgba32f) return false;
+
+  hdr_image source;
+  if (!decode_hdr_image(bytes.data(), bytes.size(), source)) return false;
+
+  const auto start = std::chrono::steady_clock::now();
+  const bool gpu_format = format == hdr_format::rgba16f || format == hdr_format::r11g11b10f;
+
+  std::vector<std::vector<uint8_t>> levels;
+  size_t encoded_bytes = 0, reference_bytes = 0;
+  for (hdr_image level = source;; level = downsample_hdr_image(level)) {
+    levels.push_back(encode_hdr_image(level, format));
+    encoded_bytes += levels.back().size();
+    reference_bytes += static_cast<size_t>(level.width) * level.height * hdr_format_texel_bytes(hdr_format::rgba32f);
+    if (!gpu_format || (level.width == 1 && level.height == 1)) break;
+  }
+  const std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+
+  std::cout << "Encoded " << name << " to " << hdr_format_name(format) << " in " << elapsed.count() << " ms, "
+            << encoded_bytes / 1024 << " KiB (" << 100 * encoded_bytes / std::max<size_t>(reference_bytes, 1)
+            << "% of RGBA32F)" << std::endl;
+
+  switch (format) {
+    case hdr_format::rgba16f:
+      return write_ktx2(output, vk_format::r16g16b16a16_sfloat, source.width, source.height, levels);
+    case hdr_format::r11g11b10f:
+      return write_ktx2(output, vk_format::b10g11r11_ufloat_pack32, source.width, source.height, levels);
+    default:
+      return write_ktx2(output, vk_format::r8g8b8a8_unorm, source.width, source.height, levels,
+                        {{"engine.hdr_encoding", hdr_format_name(format)}});
+  }
+}
+
+std::filesystem::path cook_compressed_texture(const std::string &path, const texture_compression &compression,
+                                              thread_pool &pool) {
+  if (std::filesystem::path(path).extension() == ".ktx2") return path;
+
+  const std::vector<uint8_t> bytes = read_file_bytes(path);
+  if (bytes.empty()) return {};
+
+  uint64_t key = fnv1a_64(bytes.data(), bytes.size());
+  const mip_settings &mips = compression.mips;
+  uint32_t alpha_cutoff_bits = 0;
+  std::memcpy(&alpha_cutoff_bits, &mips.alpha_cutoff, sizeof(alpha_cutoff_bits));
+  const uint32_t parameters[8] = {cache_version,
+                                  static_cast<uint32_t>(compression.format),
+                                  static_cast<uint32_t>(compression.quality),
+                                  static_cast<uint32_t>(mips.filter),
+                                  mips.srgb,
+                                  mips.normal_map,
+                                  alpha_cutoff_bits,
+                                  mips.wrap};
+  key = fnv1a_64(parameters, sizeof(parameters), key);
+
+  const std::filesystem::path cached = compression.cache_directory / (hash_to_hex(key) + ".ktx2");
+  if (std::filesystem::exists(cached)) return cached;
+
+  if (!write_compressed_texture(bytes, path, compression, cached, pool)) {
+    std::cout << "Failed to write texture cache: " << cached << std::endl;
+    return {};
+  }
+
+  return cached;
+}
@@ -0,0 +1,39 @@
+#ifndef TEXTURE_CACHE_H
+#define TEXTURE_CACHE_H
+
+#include <filesystem>
+#include <string>
+#include <vector>
+
+#include "bc_encoder.h"
+#include "hdr_image.h"
+
+class thread_pool;
+
+struct texture_compression {
+  bc_format format = bc_format::bc7;
+  bc_quality quality = bc_quality::high;
+  mip_settings mips;
+  std::filesystem::path cache_directory;
+};
+
+// Decodes the encoded image in `bytes`, block-compresses its mip chain and writes it to `output` as
+// KTX2 with the encode PSNR in the "engine.psnr" metadata. `name` is only used for logging.
+[[nodiscard]] bool write_compressed_texture(const std::vector<uint8_t> &bytes, const std::string &name,
+                                            const texture_compression &compression,
+                                            const std::filesystem::path &output, thread_pool &pool);
+
+// Decodes the .hdr image in `bytes` and writes it to `output` as KTX2. The GPU formats (RGBA16F,
+// R11G11B10F) keep a full box-filtered mip chain; RGBE and RGBM store level 0 as RGBA8 with the
+// encoding in the "engine.hdr_encoding" metadata. RGBA32F is not a storage format.
+[[nodiscard]] bool write_hdr_texture(const std::vector<uint8_t> &bytes, const std::string &name, hdr_format format,
+                                     const std::filesystem::path &output);
+
+// Returns the path of a KTX2 file holding the block-compressed mip chain of the image at `path`,
+// encoding it first if the cache has no entry for the current source contents and settings.
+// Returns an empty path when the source cannot be read. A `path` that already names a KTX2 file,
+// such as an asset cooker output, is returned unchanged.
+[[nodiscard]] std::filesystem::path cook_compressed_texture(const std::string &path,
+                                                            const texture_compression &compression, thread_pool &pool);
+
+#endif  // TEXTURE_CACHE_H
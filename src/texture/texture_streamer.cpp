@@ -0,0 +1,304 @@
+#include "texture_streamer.h"
+
+#include <glad/glad.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+
+#include "texture.h"
+#include "texture_uploader.h"
+#include "../utility/thread_pool.h"
+
+namespace {
+
+template <typename T>
+bool is_finished(const std::future<T> &future) {
+  return future.valid() && future.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+}
+
+double to_kib(const size_t bytes) { return static_cast<double>(bytes) / 1024.0; }
+
+}  // namespace
+
+float required_mip_level(const int32_t texture_size, const float distance, const float world_units_per_uv,
+                         const float viewport_height, const float fov_y) {
+  const float pixels_per_world_unit = viewport_height / (2.0f * std::max(distance, 1.0e-3f) * std::tan(fov_y * 0.5f));
+  const float texels_per_world_unit = static_cast<float>(texture_size) / world_units_per_uv;
+  return std::max(0.0f, std::log2(texels_per_world_unit / pixels_per_world_unit));
+}
+
+size_t texture_streamer::streamed_texture::bytes_from(const int32_t level) const {
+  size_t bytes = 0;
+  for (int32_t i = std::max(level, 0); i < level_count(); ++i) bytes += data.container.levels[i].size;
+  return bytes;
+}
+
+texture_streamer::source texture_streamer::map_source(const std::filesystem::path &path, const int32_t tail_size) {
+  source result;
+  if (path.empty()) return result;
+
+  result.file = std::make_shared<mfsys::mapped_file>(path);
+  if (!parse_ktx2(result.file->data(), result.file->size(), result.container)) {
+    result.file.reset();
+    return result;
+  }
+
+  const ktx2_texture &container = result.container;
+  const auto level_count = static_cast<int32_t>(container.levels.size());
+  while (result.tail_level < level_count - 1 &&
+         std::max(container.width, container.height) >> result.tail_level > tail_size) {
+    ++result.tail_level;
+  }
+
+  return result;
+}
+
+texture_streamer::texture_streamer(thread_pool &pool, texture_uploader &uploader, const texture_streaming_settings &config)
+    : pool_(pool), uploader_(uploader), config_(config) {
+  // Neutral grey so unfinished materials do not flash while streaming in.
+  constexpr uint8_t grey[4] = {128, 128, 128, 255};
+  placeholder_ = allocate_texture(1, 1, 4);
+  glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, 1, 1, GL_RGBA, GL_UNSIGNED_BYTE, grey);
+}
+
+texture_streamer::~texture_streamer() {
+  // Workers may still be mapping sources; the uploader keeps the mappings it reads alive itself.
+  for (auto &entry : textures_) {
+    if (entry.pending.valid()) entry.pending.wait();
+    if (entry.texture_id != 0) glDeleteTextures(1, &entry.texture_id);
+  }
+
+  glDeleteTextures(1, &placeholder_);
+}
+
+uint32_t texture_streamer::request(const std::filesystem::path &path) {
+  const auto handle = static_cast<uint32_t>(textures_.size());
+
+  streamed_texture &entry = textures_.emplace_back();
+  entry.name = path.filename().string();
+  entry.pending = pool_.submit([path, tail_size = config_.tail_size]() { return map_source(path, tail_size); });
+
+  return handle;
+}
+
+uint32_t texture_streamer::request_compressed(const std::string &path, const texture_compression &compression) {
+  const auto handle = static_cast<uint32_t>(textures_.size());
+
+  streamed_texture &entry = textures_.emplace_back();
+  entry.name = std::filesystem::path(path).filename().string();
+  entry.pending = pool_.submit([path, compression, tail_size = config_.tail_size, &pool = pool_]() {
+    return map_source(cook_compressed_texture(path, compression, pool), tail_size);
+  });
+
+  return handle;
+}
+
+void texture_streamer::begin_frame(const float viewport_height, const float fov_y) {
+  ++frame_;
+  viewport_height_ = viewport_height;
+  fov_y_ = fov_y;
+
+  for (auto &entry : textures_) entry.frame_level = std::numeric_limits<float>::max();
+}
+
+void texture_streamer::note_usage(const uint32_t handle, const float distance, const float world_units_per_uv) {
+  streamed_texture &entry = textures_[handle];
+  if (!entry.is_live()) return;
+
+  const ktx2_texture &container = entry.data.container;
+  const float level = required_mip_level(std::max(container.width, container.height), distance, world_units_per_uv,
+                                         viewport_height_, fov_y_);
+  entry.frame_level = std::min(entry.frame_level, level);
+  entry.last_used_frame = frame_;
+}
+
+void texture_streamer::create_texture(streamed_texture &entry) {
+  const ktx2_texture &container = entry.data.container;
+  const int32_t tail_level = entry.data.tail_level;
+
+  // Storage for the tail alone; finer levels are specified as they stream in.
+  entry.texture_id = allocate_compressed_texture(entry.level_count());
+  for (int32_t level = tail_level; level < entry.level_count(); ++level) upload_ktx2_level(container, level, nullptr);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, tail_level);
+  glBindTexture(GL_TEXTURE_2D, 0);
+
+  entry.loading_level = tail_level;
+  entry.upload =
+      uploader_.request_levels(entry.name, entry.data.file, container, entry.texture_id, tail_level, entry.level_count());
+}
+
+void texture_streamer::update() {
+  for (auto &entry : textures_) {
+    if (!is_finished(entry.pending)) continue;
+
+    entry.data = entry.pending.get();
+    if (entry.data.container.empty()) {
+      std::cout << "Texture failed to load at path: " << entry.name << std::endl;
+      continue;
+    }
+    create_texture(entry);
+  }
+
+  for (auto &entry : textures_) {
+    if (!entry.is_live()) continue;
+
+    if (entry.last_used_frame == frame_) {
+      const auto level = static_cast<int32_t>(std::floor(entry.frame_level));
+      entry.wanted_level = std::clamp(level, 0, entry.data.tail_level);
+    } else if (frame_ - entry.last_used_frame > config_.idle_frames) {
+      entry.wanted_level = entry.data.tail_level;
+    }
+  }
+
+  apply_budget();
+
+  for (auto &entry : textures_) {
+    if (entry.is_live() && entry.resident_level < entry.target_level) release_levels(entry, entry.target_level);
+  }
+
+  stream_levels();
+}
+
+void texture_streamer::apply_budget() {
+  size_t total = 0;
+  for (auto &entry : textures_) {
+    if (!entry.is_live()) continue;
+    entry.target_level = entry.wanted_level;
+    total += entry.bytes_from(entry.target_level);
+  }
+
+  // Drop the finest level of whichever texture it saves the most on, least recently used first
+  // among equals, until everything fits. Tails are never dropped.
+  while (total > config_.budget_bytes) {
+    streamed_texture *largest = nullptr;
+    size_t largest_bytes = 0;
+
+    for (auto &entry : textures_) {
+      if (!entry.is_live() || entry.target_level >= entry.data.tail_level) continue;
+
+      const size_t bytes = entry.data.container.levels[entry.target_level].size;
+      if (bytes > largest_bytes ||
+          (bytes == largest_bytes && largest != nullptr && entry.last_used_frame < largest->last_used_frame)) {
+        largest = &entry;
+        largest_bytes = bytes;
+      }
+    }
+
+    if (largest == nullptr) break;
+    ++largest->target_level;
+    total -= largest_bytes;
+  }
+}
+
+void texture_streamer::release_levels(streamed_texture &entry, const int32_t level) {
+  glBindTexture(GL_TEXTURE_2D, entry.texture_id);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, level);
+  for (int32_t i = entry.resident_level; i < level; ++i) release_ktx2_level(entry.data.container, i);
+
+  entry.resident_level = level;
+}
+
+void texture_streamer::finish_upload(streamed_texture &entry) {
+  const bool uploaded = uploader_.is_ready(entry.upload);
+  uploader_.release(entry.upload);
+  const int32_t level = entry.loading_level;
+  entry.loading_level = -1;
+
+  if (!entry.live) {
+    // The tail. The uploader has said why it failed.
+    if (!uploaded) {
+      glDeleteTextures(1, &entry.texture_id);
+      entry.texture_id = 0;
+      return;
+    }
+    entry.live = true;
+    entry.resident_level = level;
+    entry.wanted_level = level;
+    entry.target_level = level;
+    return;
+  }
+
+  glBindTexture(GL_TEXTURE_2D, entry.texture_id);
+  if (uploaded && level >= entry.target_level && level == entry.resident_level - 1) {
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, level);
+    entry.resident_level = level;
+  } else {
+    // Failed, no longer wanted, or the budget shrank while it was in flight.
+    release_ktx2_level(entry.data.container, level);
+    entry.upload_failed = !uploaded;
+  }
+  glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+void texture_streamer::stream_levels() {
+  for (auto &entry : textures_) {
+    if (entry.loading_level >= 0) {
+      if (uploader_.is_ready(entry.upload) || uploader_.has_failed(entry.upload)) finish_upload(entry);
+      continue;
+    }
+    if (!entry.is_live() || entry.upload_failed || entry.resident_level <= entry.target_level) continue;
+
+    // Stream one level at a time, coarse to fine, so detail sharpens progressively.
+    entry.loading_level = entry.resident_level - 1;
+    glBindTexture(GL_TEXTURE_2D, entry.texture_id);
+    upload_ktx2_level(entry.data.container, entry.loading_level, nullptr);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    entry.upload = uploader_.request_levels(entry.name, entry.data.file, entry.data.container, entry.texture_id,
+                                            entry.loading_level, entry.loading_level + 1);
+  }
+}
+
+uint32_t texture_streamer::texture(const uint32_t handle) const {
+  const streamed_texture &entry = textures_[handle];
+  return entry.is_live() ? entry.texture_id : placeholder_;
+}
+
+std::vector<texture_residency> texture_streamer::residency() const {
+  std::vector<texture_residency> result;
+  result.reserve(textures_.size());
+
+  for (const auto &entry : textures_) {
+    texture_residency &stats = result.emplace_back();
+    stats.name = entry.name;
+    if (!entry.is_live()) continue;
+
+    stats.level_count = entry.level_count();
+    stats.resident_level = entry.resident_level;
+    stats.wanted_level = entry.wanted_level;
+    stats.target_level = entry.target_level;
+    stats.resident_bytes = entry.bytes_from(entry.resident_level);
+    stats.full_bytes = entry.bytes_from(0);
+  }
+
+  return result;
+}
+
+size_t texture_streamer::resident_bytes() const {
+  size_t total = 0;
+  for (const auto &entry : textures_) {
+    if (entry.is_live()) total += entry.bytes_from(entry.resident_level);
+  }
+  return total;
+}
+
+void texture_streamer::print_residency(std::ostream &out) const {
+  out << std::left << std::setw(28) << "texture" << std::right << std::setw(8) << "levels" << std::setw(10)
+      << "resident" << std::setw(8) << "wanted" << std::setw(8) << "target" << std::setw(14) << "KiB" << std::setw(14)
+      << "full KiB" << std::endl;
+
+  size_t full = 0;
+  for (const texture_residency &stats : residency()) {
+    out << std::left << std::setw(28) << stats.name << std::right << std::setw(8) << stats.level_count
+        << std::setw(10) << stats.resident_level << std::setw(8) << stats.wanted_level << std::setw(8)
+        << stats.target_level << std::fixed << std::setprecision(1) << std::setw(14) << to_kib(stats.resident_bytes)
+        << std::setw(14) << to_kib(stats.full_bytes) << std::endl;
+    full += stats.full_bytes;
+  }
+
+  out << "resident " << to_kib(resident_bytes()) << " KiB of " << to_kib(full) << " KiB, budget "
+      << to_kib(config_.budget_bytes) << " KiB" << std::endl;
+}
@@ -0,0 +1,137 @@
+#ifndef TEXTURE_STREAMER_H
+#define TEXTURE_STREAMER_H
+
+#include <cstdint>
+#include <filesystem>
+#include <future>
+#include <iosfwd>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "ktx2.h"
+#include "texture_cache.h"
+#include "../filesystem/mapped_file.h"
+
+class texture_uploader;
+class thread_pool;
+
+// The finest mip level a surface needs: `texture_size` is the larger dimension of level 0, the
+// surface is `distance` away from the eye and one UV unit spans `world_units_per_uv` on it.
+// Anisotropy is ignored, so surfaces seen at grazing angles ask for slightly too much detail.
+[[nodiscard]] float required_mip_level(int32_t texture_size, float distance, float world_units_per_uv,
+                                       float viewport_height, float fov_y);
+
+struct texture_residency {
+  std::string name;
+  int32_t level_count = 0;
+  int32_t resident_level = 0;  // finest level in GPU memory
+  int32_t wanted_level = 0;    // finest level the last frames asked for
+  int32_t target_level = 0;    // wanted_level after the budget was applied
+  size_t resident_bytes = 0;
+  size_t full_bytes = 0;  // with every level resident
+};
+
+struct texture_streaming_settings {
+  size_t budget_bytes = 64 * 1024 * 1024;
+  int32_t tail_size = 64;
+  // Textures nobody reported for this many frames fall back to their tail.
+  uint32_t idle_frames = 120;
+};
+
+// Keeps only the mip levels that are visible resident, under one byte budget for all textures.
+//
+// Sources are KTX2 files, mapped for the lifetime of the streamer. A texture starts with its tail
+// (levels no larger than `tail_size`) resident; each frame the usage reported through
+// note_usage() picks the level it wants, the budget trims the wanted levels of the largest
+// textures, finer levels stream in one at a time through the uploader's staging ring (its workers
+// read them from the mapping, and it paces the bytes per frame) and levels that are no longer
+// wanted are released at once.
+//
+// Without sparse textures in core GL, residency uses mutable storage: GL_TEXTURE_BASE_LEVEL is
+// the finest resident level and the levels above it are re-specified as 0x0.
+//
+// All member functions must be called on the thread that owns the GL context.
+class texture_streamer {
+ public:
+  texture_streamer(thread_pool &pool, texture_uploader &uploader, const texture_streaming_settings &config = {});
+  texture_streamer(const texture_streamer &) = delete;
+  texture_streamer &operator=(const texture_streamer &) = delete;
+
+  ~texture_streamer();
+
+  // Streams the KTX2 file at `path`, which must already be resolved.
+  [[nodiscard]] uint32_t request(const std::filesystem::path &path);
+
+  // Encodes the image at `path` into the compressed texture cache on a worker first.
+  [[nodiscard]] uint32_t request_compressed(const std::string &path, const texture_compression &compression);
+
+  // Starts a frame's usage reports; `fov_y` is in radians.
+  void begin_frame(float viewport_height, float fov_y);
+
+  // Reports that a surface using `handle` is drawn this frame, see required_mip_level().
+  void note_usage(uint32_t handle, float distance, float world_units_per_uv);
+
+  // Applies the budget, releases levels and advances streaming. Call once per frame after the
+  // usage has been reported, next to the uploader's update().
+  void update();
+
+  // Returns a grey placeholder until the tail is resident.
+  [[nodiscard]] uint32_t texture(uint32_t handle) const;
+
+  [[nodiscard]] std::vector<texture_residency> residency() const;
+  [[nodiscard]] size_t resident_bytes() const;
+  [[nodiscard]] size_t budget_bytes() const { return config_.budget_bytes; }
+
+  void print_residency(std::ostream &out) const;
+
+ private:
+  // The mapped file a worker prepares before the texture is created.
+  struct source {
+    std::shared_ptr<mfsys::mapped_file> file;
+    ktx2_texture container;  // points into `file`
+    int32_t tail_level = 0;  // finest level no larger than tail_size
+  };
+
+  struct streamed_texture {
+    std::string name;
+    std::future<source> pending;
+    source data;
+
+    uint32_t texture_id = 0;
+    int32_t resident_level = 0;
+    int32_t wanted_level = 0;
+    int32_t target_level = 0;
+    float frame_level = 0.0f;  // finest level reported this frame
+    uint64_t last_used_frame = 0;
+
+    bool live = false;  // once the tail is resident
+    // The level the uploader is streaming in (the tail's coarsest at first), or -1.
+    int32_t loading_level = -1;
+    uint32_t upload = 0;
+    bool upload_failed = false;
+
+    [[nodiscard]] bool is_live() const { return live; }
+    [[nodiscard]] int32_t level_count() const { return static_cast<int32_t>(data.container.levels.size()); }
+    [[nodiscard]] size_t bytes_from(int32_t level) const;
+  };
+
+  [[nodiscard]] static source map_source(const std::filesystem::path &path, int32_t tail_size);
+
+  void create_texture(streamed_texture &entry);
+  void apply_budget();
+  static void release_levels(streamed_texture &entry, int32_t level);
+  void finish_upload(streamed_texture &entry);
+  void stream_levels();
+
+  thread_pool &pool_;
+  texture_uploader &uploader_;
+  texture_streaming_settings config_;
+  std::vector<streamed_texture> textures_;
+  uint64_t frame_ = 0;
+  float viewport_height_ = 1.0f;
+  float fov_y_ = 1.0f;
+  uint32_t placeholder_ = 0;
+};
+
+#endif  // TEXTURE_STREAMER_H
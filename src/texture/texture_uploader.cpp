@@ -0,0 +1,410 @@
+#include "texture_uploader.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+
+#include "texture.h"
+#include "../utility/thread_pool.h"
+
+namespace {
+
+template <typename T>
+bool is_finished(const std::future<T> &future) {
+  return future.valid() && future.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+}
+
+}  // namespace
+
+size_t texture_uploader::texture_payload::size_in_bytes() const {
+  size_t bytes = 0;
+  for (size_t level = 0; level < level_count(); ++level) bytes += level_size(level);
+  return bytes;
+}
+
+size_t texture_uploader::texture_payload::level_count() const {
+  if (!pixels.empty()) return 1;
+  const auto last = last_level < 0 ? static_cast<int32_t>(container.levels.size()) : last_level;
+  return static_cast<size_t>(last - first_level);
+}
+
+const uint8_t *texture_uploader::texture_payload::level_data(const size_t level) const {
+  return pixels.empty() ? container.levels[first_level + level].data : pixels.pixels.data();
+}
+
+size_t texture_uploader::texture_payload::level_size(const size_t level) const {
+  return pixels.empty() ? container.levels[first_level + level].size : pixels.size_in_bytes();
+}
+
+size_t texture_uploader::texture_payload::level_rows(const size_t level) const {
+  if (!pixels.empty()) return static_cast<size_t>(pixels.height);
+  const auto height = static_cast<size_t>(std::max(1, container.height >> (first_level + level)));
+  return is_block_compressed(container.format) ? (height + 3) / 4 : height;
+}
+
+texture_uploader::texture_payload texture_uploader::map_ktx2(const std::filesystem::path &path) {
+  texture_payload payload;
+  if (path.empty()) return payload;
+
+  payload.file = std::make_shared<mfsys::mapped_file>(path);
+  if (!parse_ktx2(payload.file->data(), payload.file->size(), payload.container)) payload.file.reset();
+
+#ifdef DEBUG
+  const std::string psnr = payload.container.find_metadata("engine.psnr");
+  if (!psnr.empty()) std::cout << "Texture " << path << " PSNR " << psnr << " dB" << std::endl;
+#endif
+
+  return payload;
+}
+
+texture_uploader::texture_uploader(thread_pool &pool, const size_t staging_buffer_count,
+                                   const size_t staging_buffer_bytes, const size_t upload_bytes_per_frame)
+    : pool_(pool),
+      staging_(staging_buffer_count),
+      staging_buffer_bytes_(staging_buffer_bytes),
+      upload_bytes_per_frame_(upload_bytes_per_frame),
+      persistent_mapping_(GLAD_GL_VERSION_4_4 != 0) {
+  for (auto &staging : staging_) {
+    glGenBuffers(1, &staging.buffer);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, staging.buffer);
+
+    if (persistent_mapping_) {
+      constexpr GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+      glBufferStorage(GL_PIXEL_UNPACK_BUFFER, static_cast<GLsizeiptr>(staging_buffer_bytes_), nullptr, flags);
+      staging.mapped = static_cast<uint8_t *>(
+          glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, static_cast<GLsizeiptr>(staging_buffer_bytes_), flags));
+    } else {
+      glBufferData(GL_PIXEL_UNPACK_BUFFER, static_cast<GLsizeiptr>(staging_buffer_bytes_), nullptr, GL_STREAM_DRAW);
+    }
+  }
+  glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+  // Neutral grey so unfinished materials do not flash while streaming in.
+  constexpr uint8_t grey[4] = {128, 128, 128, 255};
+  placeholder_ = allocate_texture(1, 1, 4);
+  glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, 1, 1, GL_RGBA, GL_UNSIGNED_BYTE, grey);
+}
+
+texture_uploader::~texture_uploader() {
+  // Workers may still be writing into mapped staging memory.
+  for (auto &upload : uploads_) {
+    if (upload.decoded.valid()) upload.decoded.wait();
+    if (upload.owns_texture && upload.texture_id != 0) glDeleteTextures(1, &upload.texture_id);
+  }
+
+  for (auto &staging : staging_) {
+    if (staging.copied.valid()) staging.copied.wait();
+    if (staging.fence != nullptr) glDeleteSync(staging.fence);
+    if (staging.mapped != nullptr) {
+      glBindBuffer(GL_PIXEL_UNPACK_BUFFER, staging.buffer);
+      glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+    }
+    glDeleteBuffers(1, &staging.buffer);
+  }
+  glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+  glDeleteTextures(1, &placeholder_);
+}
+
+uint32_t texture_uploader::request(const std::string &path) {
+  const uint32_t handle = add_upload();
+
+  upload &entry = uploads_[handle];
+  entry.path = path;
+  entry.decoded = pool_.submit([path]() {
+    texture_payload payload;
+    payload.pixels = load_image(path);
+    return payload;
+  });
+
+  return handle;
+}
+
+uint32_t texture_uploader::request_compressed(const std::string &path, const texture_compression &compression) {
+  const uint32_t handle = add_upload();
+
+  upload &entry = uploads_[handle];
+  entry.path = path;
+  entry.decoded = pool_.submit(
+      [path, compression, &pool = pool_]() { return map_ktx2(cook_compressed_texture(path, compression, pool)); });
+
+  return handle;
+}
+
+uint32_t texture_uploader::request_ktx2(const std::string &path) {
+  const uint32_t handle = add_upload();
+
+  upload &entry = uploads_[handle];
+  entry.path = path;
+  entry.decoded = pool_.submit([path]() { return map_ktx2(path); });
+
+  return handle;
+}
+
+uint32_t texture_uploader::request_levels(const std::string &name, std::shared_ptr<mfsys::mapped_file> file,
+                                          const ktx2_texture &container, const uint32_t texture_id,
+                                          const int32_t first_level, const int32_t last_level, const int32_t layer) {
+  const uint32_t handle = add_upload();
+
+  upload &entry = uploads_[handle];
+  entry.path = name;
+  entry.texture_id = texture_id;
+  entry.owns_texture = false;
+  entry.layer = layer;
+  entry.payload = std::make_unique<texture_payload>();
+  entry.payload->file = std::move(file);
+  entry.payload->container = container;
+  entry.payload->first_level = first_level;
+  entry.payload->last_level = last_level;
+  begin_streaming(handle);
+
+  return handle;
+}
+
+void texture_uploader::release(const uint32_t handle) {
+  upload &entry = uploads_[handle];
+  if (entry.owns_texture && entry.texture_id != 0) glDeleteTextures(1, &entry.texture_id);
+
+  entry = upload();
+  entry.state = upload_state::released;
+  free_handles_.push_back(handle);
+}
+
+void texture_uploader::update() {
+  for (uint32_t handle = 0; handle < uploads_.size(); ++handle) {
+    upload &entry = uploads_[handle];
+
+    if (entry.state == upload_state::decoding) {
+      if (!is_finished(entry.decoded)) continue;
+
+      entry.payload = std::make_unique<texture_payload>(entry.decoded.get());
+      if (entry.payload->empty()) {
+        std::cout << "Texture failed to load at path: " << entry.path << std::endl;
+        entry.payload.reset();
+        entry.state = upload_state::failed;
+        continue;
+      }
+      begin_streaming(handle);
+    }
+    if (entry.state != upload_state::streaming) continue;
+
+    // Earlier uploads take the free staging buffers first, so textures finish one after another.
+    while (entry.next_byte < entry.payload->size_in_bytes()) {
+      const int32_t staging_index = acquire_staging_buffer();
+      if (staging_index < 0) break;
+      begin_copy(handle, staging_index);
+    }
+  }
+
+  // Always let one band through so the budget cannot stall a band larger than it.
+  size_t budget = upload_bytes_per_frame_;
+  bool uploaded_this_frame = false;
+
+  for (int32_t i = 0; i < static_cast<int32_t>(staging_.size()); ++i) {
+    staging_buffer &staging = staging_[i];
+    if (staging.upload_index < 0) continue;
+
+    if (staging.fence == nullptr) {
+      if (!is_finished(staging.copied)) continue;
+
+      const size_t bytes = staging.last_byte - staging.first_byte;
+      if (uploaded_this_frame && bytes > budget) continue;
+
+      staging.copied.get();
+      submit_band(i);
+      budget = bytes > budget ? 0 : budget - bytes;
+      uploaded_this_frame = true;
+      continue;
+    }
+
+    const GLenum status = glClientWaitSync(staging.fence, 0, 0);
+    if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED) continue;
+
+    const auto handle = static_cast<uint32_t>(staging.upload_index);
+    retire_staging_buffer(i);
+    upload &entry = uploads_[handle];
+    if (--entry.bands_in_flight == 0 && entry.next_byte == entry.payload->size_in_bytes()) finish_upload(handle);
+  }
+}
+
+uint32_t texture_uploader::texture(const uint32_t handle) const {
+  return is_ready(handle) ? uploads_[handle].texture_id : placeholder_;
+}
+
+bool texture_uploader::is_ready(const uint32_t handle) const {
+  return handle < uploads_.size() && uploads_[handle].state == upload_state::ready;
+}
+
+bool texture_uploader::has_failed(const uint32_t handle) const {
+  return handle < uploads_.size() && uploads_[handle].state == upload_state::failed;
+}
+
+size_t texture_uploader::pending_count() const {
+  size_t count = 0;
+  for (const auto &upload : uploads_) {
+    if (upload.state == upload_state::decoding || upload.state == upload_state::streaming) ++count;
+  }
+  return count;
+}
+
+uint32_t texture_uploader::get_placeholder() const { return placeholder_; }
+
+uint32_t texture_uploader::add_upload() {
+  if (free_handles_.empty()) {
+    uploads_.emplace_back();
+    return static_cast<uint32_t>(uploads_.size() - 1);
+  }
+
+  const uint32_t handle = free_handles_.back();
+  free_handles_.pop_back();
+  uploads_[handle] = upload();
+  return handle;
+}
+
+void texture_uploader::begin_streaming(const uint32_t handle) {
+  upload &entry = uploads_[handle];
+  const texture_payload &payload = *entry.payload;
+
+  for (size_t level = 0; level < payload.level_count(); ++level) {
+    if (payload.level_size(level) / payload.level_rows(level) <= staging_buffer_bytes_) continue;
+    std::cout << "Texture rows do not fit a staging buffer: " << entry.path << std::endl;
+    entry.payload.reset();
+    entry.state = upload_state::failed;
+    return;
+  }
+
+  if (entry.texture_id != 0) {
+    // Given by the caller with storage in place.
+  } else if (payload.pixels.empty()) {
+    entry.texture_id = allocate_ktx2_texture(payload.container);
+    glBindTexture(GL_TEXTURE_2D, 0);
+  } else {
+    entry.texture_id = allocate_texture(payload.pixels.width, payload.pixels.height, payload.pixels.channels);
+    glBindTexture(GL_TEXTURE_2D, 0);
+  }
+  entry.state = upload_state::streaming;
+}
+
+size_t texture_uploader::band_end(const texture_payload &payload, const size_t first_byte) const {
+  const size_t limit = first_byte + staging_buffer_bytes_;
+  size_t level_start = 0;
+  for (size_t level = 0; level < payload.level_count(); ++level) {
+    const size_t level_end = level_start + payload.level_size(level);
+    if (level_end > limit) {
+      // Bands start on row boundaries, so whole rows from the later of the two starts line up.
+      const size_t start = std::max(level_start, first_byte);
+      const size_t row_bytes = payload.level_size(level) / payload.level_rows(level);
+      return start + (limit - start) / row_bytes * row_bytes;
+    }
+    level_start = level_end;
+  }
+  return level_start;
+}
+
+int32_t texture_uploader::acquire_staging_buffer() {
+  for (int32_t i = 0; i < static_cast<int32_t>(staging_.size()); ++i) {
+    staging_buffer &staging = staging_[i];
+    if (staging.upload_index >= 0) continue;
+
+    if (!persistent_mapping_) {
+      glBindBuffer(GL_PIXEL_UNPACK_BUFFER, staging.buffer);
+      staging.mapped = static_cast<uint8_t *>(
+          glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, static_cast<GLsizeiptr>(staging_buffer_bytes_),
+                           GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT));
+      glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+      if (staging.mapped == nullptr) return -1;
+    }
+
+    return i;
+  }
+
+  return -1;
+}
+
+void texture_uploader::begin_copy(const uint32_t handle, const int32_t staging_index) {
+  upload &entry = uploads_[handle];
+  staging_buffer &staging = staging_[staging_index];
+  staging.upload_index = static_cast<int32_t>(handle);
+  staging.first_byte = entry.next_byte;
+  staging.last_byte = band_end(*entry.payload, entry.next_byte);
+  entry.next_byte = staging.last_byte;
+  ++entry.bands_in_flight;
+
+  // The render thread leaves the payload alone until the upload has finished. Reading a mapped
+  // KTX2 file here is what pulls it in from disk.
+  staging.copied = pool_.submit([payload = entry.payload.get(), destination = staging.mapped,
+                                 first = staging.first_byte, last = staging.last_byte]() {
+    size_t level_start = 0;
+    for (size_t level = 0; level < payload->level_count() && level_start < last; ++level) {
+      const size_t level_end = level_start + payload->level_size(level);
+      const size_t begin = std::max(level_start, first), end = std::min(level_end, last);
+      if (begin < end) {
+        std::memcpy(destination + (begin - first), payload->level_data(level) + (begin - level_start), end - begin);
+      }
+      level_start = level_end;
+    }
+  });
+}
+
+void texture_uploader::submit_band(const int32_t staging_index) {
+  staging_buffer &staging = staging_[staging_index];
+  const upload &entry = uploads_[staging.upload_index];
+  const texture_payload &payload = *entry.payload;
+
+  glBindBuffer(GL_PIXEL_UNPACK_BUFFER, staging.buffer);
+  if (!persistent_mapping_) {
+    glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+    staging.mapped = nullptr;
+  }
+  const GLenum target = entry.layer < 0 ? GL_TEXTURE_2D : GL_TEXTURE_2D_ARRAY;
+  glBindTexture(target, entry.texture_id);
+
+  size_t level_start = 0;
+  for (size_t level = 0; level < payload.level_count() && level_start < staging.last_byte; ++level) {
+    const size_t level_end = level_start + payload.level_size(level);
+    const size_t begin = std::max(level_start, staging.first_byte), end = std::min(level_end, staging.last_byte);
+    if (begin < end) {
+      const size_t row_bytes = payload.level_size(level) / payload.level_rows(level);
+      const auto first_row = static_cast<int32_t>((begin - level_start) / row_bytes);
+      const auto row_count = static_cast<int32_t>((end - begin) / row_bytes);
+      const void *offset = reinterpret_cast<const void *>(begin - staging.first_byte);
+      const auto container_level = payload.first_level + static_cast<int32_t>(level);
+      if (!payload.pixels.empty()) {
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, first_row, payload.pixels.width, row_count,
+                        texture_format_for_channels(payload.pixels.channels), GL_UNSIGNED_BYTE, offset);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+      } else if (entry.layer < 0) {
+        upload_ktx2_rows(payload.container, container_level, first_row, row_count, offset);
+      } else {
+        upload_ktx2_layer_rows(payload.container, container_level, entry.layer, first_row, row_count, offset);
+      }
+    }
+    level_start = level_end;
+  }
+
+  glBindTexture(target, 0);
+  glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+  staging.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+
+void texture_uploader::retire_staging_buffer(const int32_t staging_index) {
+  staging_buffer &staging = staging_[staging_index];
+
+  glDeleteSync(staging.fence);
+  staging.fence = nullptr;
+  staging.upload_index = -1;
+}
+
+void texture_uploader::finish_upload(const uint32_t handle) {
+  upload &entry = uploads_[handle];
+
+  if (!entry.payload->pixels.empty()) {
+    glBindTexture(GL_TEXTURE_2D, entry.texture_id);
+    glGenerateMipmap(GL_TEXTURE_2D);
+    glBindTexture(GL_TEXTURE_2D, 0);
+  }
+  entry.payload.reset();
+  entry.state = upload_state::ready;
+}
@@ -0,0 +1,147 @@
+#ifndef TEXTURE_UPLOADER_H
+#define TEXTURE_UPLOADER_H
+
+#include <glad/glad.h>
+
+#include <cstdint>
+#include <future>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "image.h"
+#include "ktx2.h"
+#include "texture_cache.h"
+#include "../filesystem/mapped_file.h"
+
+class thread_pool;
+
+// Streams textures in without stalling the render thread. Files are decoded on the pool, copied
+// into a ring of pixel buffer objects by the workers and uploaded from there; a fence per staging
+// buffer tells when the GPU has consumed it. Until then texture() returns a placeholder.
+//
+// A payload is its levels packed back to back and goes up in bands of whole rows (block rows when
+// compressed) that each fit a staging buffer, so an image larger than one streams through the ring
+// over several frames like any other, several bands in flight at once.
+//
+// Owners of their own textures, such as the mip streamer and texture arrays, hand levels they
+// have mapped to request_levels() and release() the handle once it is done.
+//
+// All member functions must be called on the thread that owns the GL context.
+class texture_uploader {
+ public:
+  explicit texture_uploader(thread_pool &pool, size_t staging_buffer_count = 4,
+                            size_t staging_buffer_bytes = 8 * 1024 * 1024,
+                            size_t upload_bytes_per_frame = 8 * 1024 * 1024);
+  texture_uploader(const texture_uploader &) = delete;
+  texture_uploader &operator=(const texture_uploader &) = delete;
+
+  ~texture_uploader();
+
+  // Queues the file for decoding and returns a handle for texture(). `path` must already be resolved.
+  [[nodiscard]] uint32_t request(const std::string &path);
+
+  // Same as request(), but the worker encodes the image into a block-compressed KTX2 cache entry
+  // (or finds an existing one) and the stored mip chain is uploaded as is.
+  [[nodiscard]] uint32_t request_compressed(const std::string &path, const texture_compression &compression);
+
+  // Streams a KTX2 file: the worker maps it and copies the levels into a staging buffer, so there
+  // is no decode and no runtime mip generation. `path` must already be resolved.
+  [[nodiscard]] uint32_t request_ktx2(const std::string &path);
+
+  // Streams levels [first_level, last_level) of `container`, which points into `file`, into the
+  // existing `texture_id`: a GL_TEXTURE_2D, or layer `layer` of a GL_TEXTURE_2D_ARRAY when `layer`
+  // is not negative. Storage for the levels must already exist; the texture stays the caller's.
+  // `name` is only for messages.
+  [[nodiscard]] uint32_t request_levels(const std::string &name, std::shared_ptr<mfsys::mapped_file> file,
+                                        const ktx2_texture &container, uint32_t texture_id, int32_t first_level,
+                                        int32_t last_level, int32_t layer = -1);
+
+  // Forgets a ready or failed upload so its handle can be reused, deleting the texture if the
+  // uploader created it.
+  void release(uint32_t handle);
+
+  // Starts copies into free staging buffers, uploads the bands copied within the per-frame budget
+  // and retires the ones the GPU has consumed. Call once per frame.
+  void update();
+
+  [[nodiscard]] uint32_t texture(uint32_t handle) const;
+  [[nodiscard]] bool is_ready(uint32_t handle) const;
+  [[nodiscard]] bool has_failed(uint32_t handle) const;
+  [[nodiscard]] size_t pending_count() const;
+
+  [[nodiscard]] uint32_t get_placeholder() const;
+
+ private:
+  enum class upload_state { decoding, streaming, ready, failed, released };
+
+  // Either decoded pixels or levels [first_level, last_level) of a mapped KTX2 file with its
+  // pre-built mip chain.
+  struct texture_payload {
+    image pixels;
+    std::shared_ptr<mfsys::mapped_file> file;
+    ktx2_texture container;  // points into `file`
+    int32_t first_level = 0;
+    int32_t last_level = -1;  // every level
+
+    [[nodiscard]] bool empty() const { return pixels.empty() && container.empty(); }
+    [[nodiscard]] size_t size_in_bytes() const;
+
+    // Counted from first_level. The decoded pixels are level 0 alone; their mips are generated once
+    // it is up.
+    [[nodiscard]] size_t level_count() const;
+    [[nodiscard]] const uint8_t *level_data(size_t level) const;
+    [[nodiscard]] size_t level_size(size_t level) const;
+    [[nodiscard]] size_t level_rows(size_t level) const;
+  };
+
+  [[nodiscard]] static texture_payload map_ktx2(const std::filesystem::path &path);
+
+  struct upload {
+    std::string path;
+    upload_state state = upload_state::decoding;
+    std::future<texture_payload> decoded;
+    // Heap allocated so workers can keep reading it while uploads_ grows.
+    std::unique_ptr<texture_payload> payload;
+    uint32_t texture_id = 0;
+    bool owns_texture = true;
+    int32_t layer = -1;
+    size_t next_byte = 0;  // where the next band starts
+    uint32_t bands_in_flight = 0;
+  };
+
+  // Holds the band [first_byte, last_byte) of an upload's payload while it is copied in (copied),
+  // uploaded from (fence) and until the GPU is done with it.
+  struct staging_buffer {
+    uint32_t buffer = 0;
+    uint8_t *mapped = nullptr;
+    GLsync fence = nullptr;
+    int32_t upload_index = -1;
+    size_t first_byte = 0;
+    size_t last_byte = 0;
+    std::future<void> copied;
+  };
+
+  [[nodiscard]] uint32_t add_upload();
+  // Creates the texture's storage without contents unless it was given one, or fails the upload
+  // when a row cannot fit a staging buffer.
+  void begin_streaming(uint32_t handle);
+  // The end of the largest band of whole rows from `first_byte` that fits a staging buffer.
+  [[nodiscard]] size_t band_end(const texture_payload &payload, size_t first_byte) const;
+  [[nodiscard]] int32_t acquire_staging_buffer();
+  void begin_copy(uint32_t handle, int32_t staging_index);
+  void submit_band(int32_t staging_index);
+  void retire_staging_buffer(int32_t staging_index);
+  void finish_upload(uint32_t handle);
+
+  thread_pool &pool_;
+  std::vector<upload> uploads_;
+  std::vector<uint32_t> free_handles_;
+  std::vector<staging_buffer> staging_;
+  size_t staging_buffer_bytes_;
+  size_t upload_bytes_per_frame_;
+  bool persistent_mapping_ = false;
+  uint32_t placeholder_ = 0;
+};
+
+#endif  // TEXTURE_UPLOADER_H
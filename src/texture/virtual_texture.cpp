@@ -0,0 +1,193 @@
+#include "virtual_texture.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <vector>
+
+#include "../filesystem/atomic_file.h"
+#include "../utility/hash.h"
+#include "../utility/thread_pool.h"
+
+namespace {
+
+constexpr char vtex_magic[8] = {'E', 'N', 'G', 'V', 'T', 'E', 'X', '\0'};
+constexpr uint32_t vtex_version = 1;
+
+// Bump whenever the tile layout or filtering changes so stale cache entries are rebuilt.
+constexpr uint32_t cache_version = 1;
+
+struct vtex_header {
+  char magic[8];
+  uint32_t version;
+  uint32_t width;
+  uint32_t height;
+  uint32_t page_size;
+  uint32_t border;
+  uint32_t level_count;
+};
+static_assert(sizeof(vtex_header) == 32, "tile file header must be packed");
+
+int32_t wrap(const int32_t value, const int32_t size) { return ((value % size) + size) % size; }
+
+}  // namespace
+
+int32_t virtual_texture_layout::level_width(const int32_t level) const { return std::max(1, width >> level); }
+
+int32_t virtual_texture_layout::level_height(const int32_t level) const { return std::max(1, height >> level); }
+
+int32_t virtual_texture_layout::pages_x(const int32_t level) const {
+  return (level_width(level) + page_size - 1) / page_size;
+}
+
+int32_t virtual_texture_layout::pages_y(const int32_t level) const {
+  return (level_height(level) + page_size - 1) / page_size;
+}
+
+size_t virtual_texture_layout::tile_bytes() const {
+  return static_cast<size_t>(tile_size()) * tile_size() * 4;
+}
+
+size_t virtual_texture_layout::page_count() const {
+  size_t count = 0;
+  for (int32_t level = 0; level < level_count; ++level) count += static_cast<size_t>(pages_x(level)) * pages_y(level);
+  return count;
+}
+
+size_t virtual_texture_layout::tile_offset(const int32_t level, const int32_t page_x, const int32_t page_y) const {
+  size_t index = 0;
+  for (int32_t i = 0; i < level; ++i) index += static_cast<size_t>(pages_x(i)) * pages_y(i);
+  index += static_cast<size_t>(page_y) * pages_x(level) + page_x;
+  return index * tile_bytes();
+}
+
+virtual_texture_layout make_virtual_texture_layout(const int32_t width, const int32_t height,
+                                                   const int32_t page_size, const int32_t border) {
+  virtual_texture_layout layout;
+  layout.width = width;
+  layout.height = height;
+  layout.page_size = page_size;
+  layout.border = border;
+
+  layout.level_count = 1;
+  while (layout.level_width(layout.level_count - 1) > page_size ||
+         layout.level_height(layout.level_count - 1) > page_size) {
+    ++layout.level_count;
+  }
+
+  return layout;
+}
+
+const uint8_t *virtual_texture_file::tile(const int32_t level, const int32_t page_x, const int32_t page_y) const {
+  return tiles + layout.tile_offset(level, page_x, page_y);
+}
+
+bool write_virtual_texture(const std::filesystem::path &path, const image &source, const mip_settings &mips,
+                           thread_pool &pool) {
+  if (source.empty()) return false;
+
+  const virtual_texture_layout layout = make_virtual_texture_layout(source.width, source.height);
+  const std::vector<image> chain = generate_mip_chain(convert_channels(source, 4), mips, pool);
+
+  return mfsys::write_file_atomically(path, [&](const std::filesystem::path &temporary) {
+    std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+    if (!file) return false;
+
+    vtex_header header{};
+    std::memcpy(header.magic, vtex_magic, sizeof(vtex_magic));
+    header.version = vtex_version;
+    header.width = static_cast<uint32_t>(layout.width);
+    header.height = static_cast<uint32_t>(layout.height);
+    header.page_size = static_cast<uint32_t>(layout.page_size);
+    header.border = static_cast<uint32_t>(layout.border);
+    header.level_count = static_cast<uint32_t>(layout.level_count);
+    file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+
+    // One row of pages at a time keeps memory bounded for very large sources.
+    std::vector<uint8_t> row;
+    for (int32_t level = 0; level < layout.level_count; ++level) {
+      const image &pixels = chain[level];
+      const int32_t pages_x = layout.pages_x(level);
+      row.resize(layout.tile_bytes() * pages_x);
+
+      for (int32_t page_y = 0; page_y < layout.pages_y(level); ++page_y) {
+        pool.parallel_for(0, static_cast<size_t>(pages_x), [&](const size_t page_x) {
+          uint8_t *tile = &row[page_x * layout.tile_bytes()];
+          const int32_t origin_x = static_cast<int32_t>(page_x) * layout.page_size - layout.border;
+          const int32_t origin_y = page_y * layout.page_size - layout.border;
+
+          for (int32_t y = 0; y < layout.tile_size(); ++y) {
+            const int32_t source_y = wrap(origin_y + y, pixels.height);
+            for (int32_t x = 0; x < layout.tile_size(); ++x) {
+              const int32_t source_x = wrap(origin_x + x, pixels.width);
+              std::memcpy(tile + (static_cast<size_t>(y) * layout.tile_size() + x) * 4,
+                          &pixels.pixels[(static_cast<size_t>(source_y) * pixels.width + source_x) * 4], 4);
+            }
+          }
+        });
+
+        file.write(reinterpret_cast<const char *>(row.data()), static_cast<std::streamsize>(row.size()));
+      }
+    }
+
+    return static_cast<bool>(file);
+  });
+}
+
+virtual_texture_file open_virtual_texture(const std::filesystem::path &path) {
+  virtual_texture_file result;
+
+  auto file = std::make_shared<mfsys::mapped_file>(path);
+  if (!file->is_open() || file->size() < sizeof(vtex_header)) return result;
+
+  vtex_header header{};
+  std::memcpy(&header, file->data(), sizeof(header));
+  if (std::memcmp(header.magic, vtex_magic, sizeof(vtex_magic)) != 0 || header.version != vtex_version) return result;
+  if (header.width == 0 || header.height == 0 || header.page_size == 0 || header.page_size > 4096) return result;
+  // Everything below sizes the tiles from these, the check against the file's size included, so a corrupt
+  // border or size must not get that far.
+  if (header.border > header.page_size / 2 || header.width > INT32_MAX || header.height > INT32_MAX) return result;
+
+  const virtual_texture_layout layout =
+      make_virtual_texture_layout(static_cast<int32_t>(header.width), static_cast<int32_t>(header.height),
+                                  static_cast<int32_t>(header.page_size), static_cast<int32_t>(header.border));
+  if (layout.level_count != static_cast<int32_t>(header.level_count)) return result;
+  if (file->size() < sizeof(vtex_header) + layout.page_count() * layout.tile_bytes()) return result;
+
+  result.layout = layout;
+  result.tiles = file->data() + sizeof(vtex_header);
+  result.file = std::move(file);
+  return result;
+}
+
+std::filesystem::path cook_virtual_texture(const std::string &path, const std::filesystem::path &cache_directory,
+                                           const mip_settings &mips, thread_pool &pool) {
+  const std::vector<uint8_t> bytes = read_file_bytes(path);
+  if (bytes.empty()) return {};
+
+  uint64_t key = fnv1a_64(bytes.data(), bytes.size());
+  uint32_t alpha_cutoff_bits = 0;
+  std::memcpy(&alpha_cutoff_bits, &mips.alpha_cutoff, sizeof(alpha_cutoff_bits));
+  const uint32_t parameters[6] = {cache_version, static_cast<uint32_t>(mips.filter), mips.srgb, mips.normal_map,
+                                  alpha_cutoff_bits, mips.wrap};
+  key = fnv1a_64(parameters, sizeof(parameters), key);
+
+  const std::filesystem::path cached = cache_directory / (hash_to_hex(key) + ".vtex");
+  if (std::filesystem::exists(cached)) return cached;
+
+  image source;
+  if (!decode_image(bytes.data(), bytes.size(), source)) return {};
+
+  const auto start = std::chrono::steady_clock::now();
+  if (!write_virtual_texture(cached, source, mips, pool)) {
+    std::cout << "Failed to write virtual texture: " << cached << std::endl;
+    return {};
+  }
+  const std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+
+  std::cout << "Tiled " << path << " into " << cached.filename() << " in " << elapsed.count() << " ms" << std::endl;
+  return cached;
+}
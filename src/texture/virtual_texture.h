@@ -0,0 +1,63 @@
+#ifndef VIRTUAL_TEXTURE_H
+#define VIRTUAL_TEXTURE_H
+
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <string>
+
+#include "image.h"
+#include "mip_generator.h"
+#include "../filesystem/mapped_file.h"
+
+class thread_pool;
+
+// Geometry of a tiled virtual texture. Every mip level is cut into page_size x page_size pages;
+// each stored tile adds `border` texels on every side (wrapped, as GL_REPEAT samples) so the
+// physical cache can be filtered bilinearly without bleeding between tiles. Levels stop at the
+// first one that fits into a single page.
+struct virtual_texture_layout {
+  int32_t width = 0;
+  int32_t height = 0;
+  int32_t page_size = 128;
+  int32_t border = 4;
+  int32_t level_count = 0;
+
+  [[nodiscard]] int32_t level_width(int32_t level) const;
+  [[nodiscard]] int32_t level_height(int32_t level) const;
+  [[nodiscard]] int32_t pages_x(int32_t level) const;
+  [[nodiscard]] int32_t pages_y(int32_t level) const;
+  [[nodiscard]] int32_t tile_size() const { return page_size + 2 * border; }
+  [[nodiscard]] size_t tile_bytes() const;  // RGBA8
+  [[nodiscard]] size_t page_count() const;  // over all levels
+  // Byte offset of a tile relative to the first one. Tiles are stored level by level, row-major.
+  [[nodiscard]] size_t tile_offset(int32_t level, int32_t page_x, int32_t page_y) const;
+};
+
+[[nodiscard]] virtual_texture_layout make_virtual_texture_layout(int32_t width, int32_t height,
+                                                                 int32_t page_size = 128, int32_t border = 4);
+
+// A mapped tile file. Tiles are read straight out of the mapping.
+struct virtual_texture_file {
+  std::shared_ptr<mfsys::mapped_file> file;
+  virtual_texture_layout layout;
+  const uint8_t *tiles = nullptr;
+
+  [[nodiscard]] bool empty() const { return tiles == nullptr; }
+  [[nodiscard]] const uint8_t *tile(int32_t level, int32_t page_x, int32_t page_y) const;
+};
+
+// Cuts the mip chain of `source` (built with `mips`) into bordered tiles and writes them to `path`.
+[[nodiscard]] bool write_virtual_texture(const std::filesystem::path &path, const image &source,
+                                         const mip_settings &mips, thread_pool &pool);
+
+// Returns an empty file when `path` cannot be mapped or is not a tile file.
+[[nodiscard]] virtual_texture_file open_virtual_texture(const std::filesystem::path &path);
+
+// Like cook_compressed_texture(): returns the tile file for the image at `path` in
+// `cache_directory`, building it first when the source or settings changed.
+[[nodiscard]] std::filesystem::path cook_virtual_texture(const std::string &path,
+                                                         const std::filesystem::path &cache_directory,
+                                                         const mip_settings &mips, thread_pool &pool);
+
+#endif  // VIRTUAL_TEXTURE_H
@@ -0,0 +1,475 @@
+#include "virtual_texture_system.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+
+#include "../shader/shader.h"
+#include "../utility/thread_pool.h"
+
+namespace {
+
+constexpr uint32_t max_virtual_textures = 15;  // texture id 15 would collide with the clear value
+constexpr int32_t max_pages_per_side = 4096;
+constexpr size_t readback_count = 2;
+
+template <typename T>
+bool is_finished(const std::future<T> &future) {
+  return future.valid() && future.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+}
+
+int32_t key_texture(const uint32_t key) { return static_cast<int32_t>(key >> 28); }
+int32_t key_level(const uint32_t key) { return static_cast<int32_t>((key >> 24) & 0xF); }
+int32_t key_x(const uint32_t key) { return static_cast<int32_t>(key & 0xFFF); }
+int32_t key_y(const uint32_t key) { return static_cast<int32_t>((key >> 12) & 0xFFF); }
+
+double to_mib(const size_t bytes) { return static_cast<double>(bytes) / (1024.0 * 1024.0); }
+
+}  // namespace
+
+uint32_t virtual_texture_system::page_key(const uint32_t texture, const int32_t level, const int32_t x,
+                                          const int32_t y) {
+  return static_cast<uint32_t>(x) | static_cast<uint32_t>(y) << 12 | static_cast<uint32_t>(level) << 24 |
+         texture << 28;
+}
+
+uint32_t virtual_texture_system::parent_key(const uint32_t key) const {
+  const virtual_texture_layout &layout = textures_[key_texture(key)].file.layout;
+  const int32_t level = key_level(key) + 1;
+  return page_key(key_texture(key), level, std::min(key_x(key) >> 1, layout.pages_x(level) - 1),
+                  std::min(key_y(key) >> 1, layout.pages_y(level) - 1));
+}
+
+virtual_texture_system::virtual_texture_system(thread_pool &pool, const virtual_texture_settings &config)
+    : pool_(pool), config_(config), slots_(static_cast<size_t>(config.slots_per_side) * config.slots_per_side) {
+  tile_size_ = make_virtual_texture_layout(1, 1).tile_size();
+  const int32_t cache_size = config_.slots_per_side * tile_size_;
+
+  glGenTextures(1, &cache_texture_);
+  glBindTexture(GL_TEXTURE_2D, cache_texture_);
+  glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, cache_size, cache_size, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+  readbacks_.resize(readback_count);
+  for (auto &readback : readbacks_) glGenBuffers(1, &readback.buffer);
+}
+
+virtual_texture_system::~virtual_texture_system() {
+  // Workers may still be reading the mappings.
+  for (auto &texture : textures_) {
+    if (texture.pending.valid()) texture.pending.wait();
+    if (texture.page_table != 0) glDeleteTextures(1, &texture.page_table);
+  }
+  if (analysis_.valid()) analysis_.wait();
+  if (loads_.valid()) loads_.wait();
+
+  for (auto &readback : readbacks_) {
+    if (readback.fence != nullptr) glDeleteSync(readback.fence);
+    glDeleteBuffers(1, &readback.buffer);
+  }
+
+  glDeleteTextures(1, &cache_texture_);
+  if (feedback_framebuffer_ != 0) {
+    glDeleteFramebuffers(1, &feedback_framebuffer_);
+    glDeleteTextures(1, &feedback_color_);
+    glDeleteRenderbuffers(1, &feedback_depth_);
+  }
+}
+
+uint32_t virtual_texture_system::request(const std::string &path, const std::filesystem::path &cache_directory,
+                                         const mip_settings &mips) {
+  const auto id = static_cast<uint32_t>(textures_.size());
+
+  virtual_texture &texture = textures_.emplace_back();
+  texture.name = std::filesystem::path(path).filename().string();
+  if (id >= max_virtual_textures) {
+    std::cout << "Too many virtual textures, ignoring " << path << std::endl;
+    return id;
+  }
+
+  texture.pending = pool_.submit([path, cache_directory, mips, &pool = pool_]() {
+    return open_virtual_texture(cook_virtual_texture(path, cache_directory, mips, pool));
+  });
+
+  return id;
+}
+
+bool virtual_texture_system::is_ready(const uint32_t id) const { return textures_[id].page_table != 0; }
+
+void virtual_texture_system::resize_feedback(const int32_t width, const int32_t height) {
+  if (width == feedback_width_ && height == feedback_height_) return;
+
+  feedback_width_ = width;
+  feedback_height_ = height;
+
+  if (feedback_framebuffer_ == 0) {
+    glGenFramebuffers(1, &feedback_framebuffer_);
+    glGenTextures(1, &feedback_color_);
+    glGenRenderbuffers(1, &feedback_depth_);
+  }
+
+  glBindTexture(GL_TEXTURE_2D, feedback_color_);
+  glTexImage2D(GL_TEXTURE_2D, 0, GL_R32UI, width, height, 0, GL_RED_INTEGER, GL_UNSIGNED_INT, nullptr);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+  glBindRenderbuffer(GL_RENDERBUFFER, feedback_depth_);
+  glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+
+  glBindFramebuffer(GL_FRAMEBUFFER, feedback_framebuffer_);
+  glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, feedback_color_, 0);
+  glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, feedback_depth_);
+#ifdef DEBUG
+  if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+    std::cout << "Virtual texture feedback framebuffer is incomplete" << std::endl;
+  }
+#endif
+
+  // Readbacks still in flight have the old size; drop them.
+  const auto bytes = static_cast<GLsizeiptr>(static_cast<size_t>(width) * height * sizeof(uint32_t));
+  for (auto &readback : readbacks_) {
+    if (readback.fence != nullptr) glDeleteSync(readback.fence);
+    readback.fence = nullptr;
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, readback.buffer);
+    glBufferData(GL_PIXEL_PACK_BUFFER, bytes, nullptr, GL_STREAM_READ);
+  }
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+}
+
+void virtual_texture_system::begin_feedback(const int32_t viewport_width, const int32_t viewport_height) {
+  glGetIntegerv(GL_VIEWPORT, saved_viewport_);
+  glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &saved_framebuffer_);
+
+  const int32_t divisor = std::max(1, config_.feedback_divisor);
+  resize_feedback(std::max(1, (viewport_width + divisor - 1) / divisor),
+                  std::max(1, (viewport_height + divisor - 1) / divisor));
+
+  glBindFramebuffer(GL_FRAMEBUFFER, feedback_framebuffer_);
+  glViewport(0, 0, feedback_width_, feedback_height_);
+
+  const GLuint clear_request[4] = {no_request, 0, 0, 0};
+  const GLfloat clear_depth = 1.0f;
+  glClearBufferuiv(GL_COLOR, 0, clear_request);
+  glClearBufferfv(GL_DEPTH, 0, &clear_depth);
+}
+
+void virtual_texture_system::end_feedback() {
+  // Skip the readback while the buffer from two frames ago has not been collected yet.
+  readback_buffer &readback = readbacks_[next_readback_];
+  if (readback.fence == nullptr) {
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, readback.buffer);
+    glReadBuffer(GL_COLOR_ATTACHMENT0);
+    glReadPixels(0, 0, feedback_width_, feedback_height_, GL_RED_INTEGER, GL_UNSIGNED_INT, nullptr);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    readback.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    next_readback_ = (next_readback_ + 1) % readbacks_.size();
+  }
+
+  glBindFramebuffer(GL_FRAMEBUFFER, static_cast<GLuint>(saved_framebuffer_));
+  glViewport(saved_viewport_[0], saved_viewport_[1], saved_viewport_[2], saved_viewport_[3]);
+}
+
+void virtual_texture_system::bind_feedback(const shader &program, const uint32_t id) const {
+  const virtual_texture_layout &layout = textures_[id].file.layout;
+  program.setVec2("virtualTexture.size", static_cast<float>(layout.width), static_cast<float>(layout.height));
+  program.setInt("virtualTexture.levels", layout.level_count);
+  program.setFloat("virtualTexture.pageSize", static_cast<float>(layout.page_size));
+  program.setInt("virtualTextureId", static_cast<int32_t>(id));
+  program.setFloat("feedbackBias", std::log2(static_cast<float>(std::max(1, config_.feedback_divisor))));
+}
+
+void virtual_texture_system::bind(const shader &program, const uint32_t id, const std::string &name,
+                                  const std::string &use_name, const int32_t page_table_unit,
+                                  const int32_t cache_unit) const {
+  const virtual_texture &texture = textures_[id];
+  program.setBool(use_name, texture.page_table != 0);
+  if (texture.page_table == 0) return;
+
+  glActiveTexture(GL_TEXTURE0 + page_table_unit);
+  glBindTexture(GL_TEXTURE_2D, texture.page_table);
+  glActiveTexture(GL_TEXTURE0 + cache_unit);
+  glBindTexture(GL_TEXTURE_2D, cache_texture_);
+
+  const virtual_texture_layout &layout = texture.file.layout;
+  const auto cache_size = static_cast<float>(config_.slots_per_side * tile_size_);
+  program.setInt(name + ".pageTable", page_table_unit);
+  program.setInt(name + ".physicalCache", cache_unit);
+  program.setVec2(name + ".size", static_cast<float>(layout.width), static_cast<float>(layout.height));
+  program.setInt(name + ".levels", layout.level_count);
+  program.setFloat(name + ".pageSize", static_cast<float>(layout.page_size));
+  program.setFloat(name + ".pageBorder", static_cast<float>(layout.border));
+  program.setVec2(name + ".physicalSize", cache_size, cache_size);
+  for (int32_t level = 0; level < layout.level_count; ++level) {
+    program.setInt(name + ".pageTableRows[" + std::to_string(level) + "]", texture.page_table_rows[level]);
+  }
+}
+
+void virtual_texture_system::create_page_table(const uint32_t id) {
+  virtual_texture &texture = textures_[id];
+  const virtual_texture_layout &layout = texture.file.layout;
+
+  int32_t rows = 0;
+  texture.page_table_rows.clear();
+  for (int32_t level = 0; level < layout.level_count; ++level) {
+    texture.page_table_rows.push_back(rows);
+    rows += layout.pages_y(level);
+  }
+  texture.page_table_data.assign(static_cast<size_t>(layout.pages_x(0)) * rows * 4, 0);
+
+  glGenTextures(1, &texture.page_table);
+  glBindTexture(GL_TEXTURE_2D, texture.page_table);
+  glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, layout.pages_x(0), rows, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+  // The single page of the coarsest level backs every lookup, so it is loaded now and never evicted.
+  loaded_tile tile;
+  tile.key = page_key(id, layout.level_count - 1, 0, 0);
+  const uint8_t *texels = texture.file.tile(layout.level_count - 1, 0, 0);
+  tile.texels.assign(texels, texels + layout.tile_bytes());
+  store_tile(tile);
+
+  const auto found = resident_.find(tile.key);
+  if (found != resident_.end()) slots_[found->second].pinned = true;
+}
+
+void virtual_texture_system::rebuild_page_table(const uint32_t id) {
+  virtual_texture &texture = textures_[id];
+  const virtual_texture_layout &layout = texture.file.layout;
+  const int32_t width = layout.pages_x(0);
+
+  // Coarse to fine, so a missing page can copy the entry of its parent.
+  for (int32_t level = layout.level_count - 1; level >= 0; --level) {
+    for (int32_t y = 0; y < layout.pages_y(level); ++y) {
+      for (int32_t x = 0; x < layout.pages_x(level); ++x) {
+        uint8_t *entry = &texture.page_table_data[(static_cast<size_t>(texture.page_table_rows[level] + y) * width + x) * 4];
+
+        const auto found = resident_.find(page_key(id, level, x, y));
+        if (found != resident_.end()) {
+          entry[0] = static_cast<uint8_t>(found->second % config_.slots_per_side);
+          entry[1] = static_cast<uint8_t>(found->second / config_.slots_per_side);
+          entry[2] = static_cast<uint8_t>(level);
+          entry[3] = 255;
+        } else if (level + 1 < layout.level_count) {
+          const int32_t parent_x = std::min(x >> 1, layout.pages_x(level + 1) - 1);
+          const int32_t parent_y = std::min(y >> 1, layout.pages_y(level + 1) - 1);
+          std::memcpy(entry,
+                      &texture.page_table_data[(static_cast<size_t>(texture.page_table_rows[level + 1] + parent_y) * width +
+                                                parent_x) *
+                                               4],
+                      4);
+        }
+      }
+    }
+  }
+
+  const int32_t rows = texture.page_table_rows.back() + layout.pages_y(layout.level_count - 1);
+  glBindTexture(GL_TEXTURE_2D, texture.page_table);
+  glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, width, rows, GL_RGBA, GL_UNSIGNED_BYTE, texture.page_table_data.data());
+  texture.page_table_dirty = false;
+}
+
+int32_t virtual_texture_system::acquire_slot() {
+  int32_t oldest = -1;
+  for (size_t i = 0; i < slots_.size(); ++i) {
+    const cache_slot &slot = slots_[i];
+    if (slot.key == no_request) return static_cast<int32_t>(i);
+    // Pages requested by the latest feedback stay, even if that means the cache is thrashing.
+    if (slot.pinned || slot.last_used >= frame_) continue;
+    if (oldest < 0 || slot.last_used < slots_[oldest].last_used) oldest = static_cast<int32_t>(i);
+  }
+  return oldest;
+}
+
+void virtual_texture_system::store_tile(const loaded_tile &tile) {
+  loading_.erase(tile.key);
+
+  const int32_t index = acquire_slot();
+  if (index < 0) return;
+
+  cache_slot &slot = slots_[index];
+  if (slot.key != no_request) {
+    resident_.erase(slot.key);
+    textures_[key_texture(slot.key)].page_table_dirty = true;
+  }
+
+  glBindTexture(GL_TEXTURE_2D, cache_texture_);
+  glTexSubImage2D(GL_TEXTURE_2D, 0, (index % config_.slots_per_side) * tile_size_,
+                  (index / config_.slots_per_side) * tile_size_, tile_size_, tile_size_, GL_RGBA, GL_UNSIGNED_BYTE,
+                  tile.texels.data());
+
+  slot.key = tile.key;
+  slot.last_used = frame_;
+  resident_[tile.key] = index;
+  textures_[key_texture(tile.key)].page_table_dirty = true;
+  ++stats_.tiles_uploaded;
+}
+
+void virtual_texture_system::collect_feedback() {
+  if (analysis_.valid()) return;
+
+  for (auto &readback : readbacks_) {
+    if (readback.fence == nullptr) continue;
+
+    const GLenum status = glClientWaitSync(readback.fence, 0, 0);
+    if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED) continue;
+
+    glDeleteSync(readback.fence);
+    readback.fence = nullptr;
+
+    const size_t count = static_cast<size_t>(feedback_width_) * feedback_height_;
+    std::vector<uint32_t> requests(count);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, readback.buffer);
+    const void *mapped =
+        glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, static_cast<GLsizeiptr>(count * sizeof(uint32_t)), GL_MAP_READ_BIT);
+    if (mapped != nullptr) {
+      std::memcpy(requests.data(), mapped, count * sizeof(uint32_t));
+      glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    if (mapped == nullptr) continue;
+
+    analysis_ = pool_.submit([requests = std::move(requests)]() mutable {
+      std::sort(requests.begin(), requests.end());
+      requests.erase(std::unique(requests.begin(), requests.end()), requests.end());
+      if (!requests.empty() && requests.back() == no_request) requests.pop_back();
+      return std::move(requests);
+    });
+    return;
+  }
+}
+
+void virtual_texture_system::process_requests(const std::vector<uint32_t> &requests) {
+  std::vector<uint32_t> missing;
+  size_t requested = 0, hits = 0;
+
+  for (const uint32_t key : requests) {
+    const auto texture = static_cast<size_t>(key_texture(key));
+    if (texture >= textures_.size() || textures_[texture].page_table == 0) continue;
+
+    const virtual_texture_layout &layout = textures_[texture].file.layout;
+    if (key_level(key) >= layout.level_count || key_x(key) >= layout.pages_x(key_level(key)) ||
+        key_y(key) >= layout.pages_y(key_level(key))) {
+      continue;
+    }
+
+    ++requested;
+    if (resident_.count(key) != 0) ++hits;
+
+    // Keep the whole ancestry warm: it is what the page table falls back to.
+    for (uint32_t page = key;; page = parent_key(page)) {
+      const auto found = resident_.find(page);
+      if (found != resident_.end()) {
+        slots_[found->second].last_used = frame_;
+      } else if (loading_.count(page) == 0) {
+        missing.push_back(page);
+      }
+      if (key_level(page) == layout.level_count - 1) break;
+    }
+  }
+
+  stats_.requested_pages = requested;
+  stats_.resident_hits = hits;
+  stats_.total_requests += requested;
+  stats_.total_hits += hits;
+
+  if (missing.empty() || loads_.valid()) return;
+
+  // Coarse levels first: they cover the most screen while the rest streams in.
+  std::sort(missing.begin(), missing.end());
+  missing.erase(std::unique(missing.begin(), missing.end()), missing.end());
+  std::stable_sort(missing.begin(), missing.end(),
+                   [](const uint32_t a, const uint32_t b) { return key_level(a) > key_level(b); });
+  missing.resize(std::min(missing.size(), static_cast<size_t>(std::max(1, config_.uploads_per_frame))));
+
+  struct tile_source {
+    uint32_t key;
+    const uint8_t *texels;
+    size_t size;
+  };
+
+  std::vector<tile_source> sources;
+  std::vector<std::shared_ptr<mfsys::mapped_file>> files;
+  for (const uint32_t key : missing) {
+    const virtual_texture_file &file = textures_[key_texture(key)].file;
+    sources.push_back({key, file.tile(key_level(key), key_x(key), key_y(key)), file.layout.tile_bytes()});
+    files.push_back(file.file);
+    loading_.insert(key);
+  }
+
+  loads_ = pool_.submit([sources = std::move(sources), files = std::move(files)]() {
+    std::vector<loaded_tile> tiles(sources.size());
+    for (size_t i = 0; i < sources.size(); ++i) {
+      tiles[i].key = sources[i].key;
+      tiles[i].texels.assign(sources[i].texels, sources[i].texels + sources[i].size);
+    }
+    return tiles;
+  });
+}
+
+void virtual_texture_system::update() {
+  ++frame_;
+  stats_.tiles_uploaded = 0;
+
+  for (uint32_t id = 0; id < textures_.size(); ++id) {
+    virtual_texture &texture = textures_[id];
+    if (!is_finished(texture.pending)) continue;
+
+    texture.file = texture.pending.get();
+    const virtual_texture_layout &layout = texture.file.layout;
+    if (texture.file.empty() || layout.tile_size() != tile_size_ || layout.level_count > max_levels ||
+        layout.pages_x(0) > max_pages_per_side || layout.pages_y(0) > max_pages_per_side) {
+      std::cout << "Virtual texture failed to load: " << texture.name << std::endl;
+      texture.file = {};
+      continue;
+    }
+
+    create_page_table(id);
+    texture.page_table_dirty = true;
+  }
+
+  collect_feedback();
+  if (is_finished(analysis_)) process_requests(analysis_.get());
+  if (is_finished(loads_)) {
+    for (const loaded_tile &tile : loads_.get()) store_tile(tile);
+  }
+
+  for (uint32_t id = 0; id < textures_.size(); ++id) {
+    if (textures_[id].page_table_dirty) rebuild_page_table(id);
+  }
+
+  stats_.cache_bytes = slots_.size() * static_cast<size_t>(tile_size_) * tile_size_ * 4;
+  stats_.fully_resident_bytes = 0;
+  for (const auto &texture : textures_) {
+    if (texture.page_table == 0) continue;
+
+    const virtual_texture_layout &layout = texture.file.layout;
+    stats_.cache_bytes += texture.page_table_data.size();
+    for (int32_t level = 0; level < layout.level_count; ++level) {
+      stats_.fully_resident_bytes += static_cast<size_t>(layout.level_width(level)) * layout.level_height(level) * 4;
+    }
+  }
+}
+
+void virtual_texture_system::print_stats(std::ostream &out) const {
+  const double lifetime_hit_rate =
+      stats_.total_requests == 0 ? 1.0
+                                 : static_cast<double>(stats_.total_hits) / static_cast<double>(stats_.total_requests);
+
+  out << std::fixed << std::setprecision(1) << "virtual textures: " << stats_.requested_pages
+      << " pages requested, hit rate " << stats_.hit_rate() * 100.0 << "% (" << lifetime_hit_rate * 100.0
+      << "% overall), " << stats_.tiles_uploaded << " tiles uploaded this frame, " << resident_.size() << "/"
+      << slots_.size() << " slots used, " << to_mib(stats_.cache_bytes) << " MiB vs "
+      << to_mib(stats_.fully_resident_bytes) << " MiB fully resident" << std::endl;
+}
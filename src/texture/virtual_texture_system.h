@@ -0,0 +1,158 @@
+#ifndef VIRTUAL_TEXTURE_SYSTEM_H
+#define VIRTUAL_TEXTURE_SYSTEM_H
+
+#include <glad/glad.h>
+
+#include <cstdint>
+#include <filesystem>
+#include <future>
+#include <iosfwd>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "virtual_texture.h"
+
+class shader;
+class thread_pool;
+
+struct virtual_texture_settings {
+  // The physical cache holds slots_per_side^2 tiles.
+  int32_t slots_per_side = 16;
+  // The feedback pass renders at 1/feedback_divisor of the viewport in each direction.
+  int32_t feedback_divisor = 8;
+  int32_t uploads_per_frame = 16;
+};
+
+struct virtual_texture_stats {
+  size_t requested_pages = 0;  // distinct pages in the last analysed feedback
+  size_t resident_hits = 0;    // of those, already in the cache
+  size_t tiles_uploaded = 0;   // in the last update()
+  size_t total_requests = 0;
+  size_t total_hits = 0;
+  size_t cache_bytes = 0;           // physical cache plus page tables
+  size_t fully_resident_bytes = 0;  // every level of every virtual texture as plain RGBA8
+
+  [[nodiscard]] double hit_rate() const {
+    return requested_pages == 0 ? 1.0 : static_cast<double>(resident_hits) / static_cast<double>(requested_pages);
+  }
+};
+
+// Virtual texturing with a feedback-driven tile cache.
+//
+// Each frame the scene is drawn once more at low resolution with the feedback shader, which
+// writes the (texture, level, page) it would sample as one R32UI value per pixel. The result is
+// read back through a PBO a frame or two later; a worker deduplicates the requests and then reads
+// the missing tiles out of the mapped tile files, coarse levels first. Tiles are copied into one
+// physical cache texture, replacing the least recently requested slots. A page table per texture
+// (all levels packed into one RGBA8 atlas) maps every page to the slot holding it, or to the
+// nearest resident ancestor while it streams in; the coarsest page stays pinned.
+//
+// All member functions must be called on the thread that owns the GL context.
+class virtual_texture_system {
+ public:
+  explicit virtual_texture_system(thread_pool &pool, const virtual_texture_settings &config = {});
+  virtual_texture_system(const virtual_texture_system &) = delete;
+  virtual_texture_system &operator=(const virtual_texture_system &) = delete;
+
+  ~virtual_texture_system();
+
+  // Tiles the image at `path` into `cache_directory` on a worker (see cook_virtual_texture) and
+  // returns an id for bind(). At most 15 virtual textures are supported.
+  [[nodiscard]] uint32_t request(const std::string &path, const std::filesystem::path &cache_directory,
+                                 const mip_settings &mips = {});
+
+  [[nodiscard]] bool is_ready(uint32_t id) const;
+
+  // Redirects drawing into the feedback target. Draw every virtual-textured surface with the
+  // feedback shader between these two calls, after bind_feedback(). The viewport and framebuffer
+  // bound before are restored afterwards.
+  void begin_feedback(int32_t viewport_width, int32_t viewport_height);
+  void end_feedback();
+
+  // Sets the uniforms the feedback shader needs for `id`.
+  void bind_feedback(const shader &program, uint32_t id) const;
+
+  // Binds the page table and cache of `id` to the given texture units and sets the uniforms of the
+  // VirtualTexture struct `name`, plus `use_name` to whether the texture is ready.
+  void bind(const shader &program, uint32_t id, const std::string &name, const std::string &use_name,
+            int32_t page_table_unit, int32_t cache_unit) const;
+
+  // Collects feedback, uploads finished tiles, starts new loads. Call once per frame.
+  void update();
+
+  [[nodiscard]] const virtual_texture_stats &stats() const { return stats_; }
+  void print_stats(std::ostream &out) const;
+
+ private:
+  // Page keys use the feedback encoding: x | y << 12 | level << 24 | texture << 28.
+  static constexpr uint32_t no_request = 0xFFFFFFFFu;
+  static constexpr int32_t max_levels = 16;
+
+  struct virtual_texture {
+    std::string name;
+    std::future<virtual_texture_file> pending;
+    virtual_texture_file file;
+    uint32_t page_table = 0;
+    std::vector<int32_t> page_table_rows;  // first atlas row of every level
+    std::vector<uint8_t> page_table_data;
+    bool page_table_dirty = false;
+  };
+
+  struct cache_slot {
+    uint32_t key = no_request;
+    uint64_t last_used = 0;
+    bool pinned = false;
+  };
+
+  struct loaded_tile {
+    uint32_t key = no_request;
+    std::vector<uint8_t> texels;
+  };
+
+  struct readback_buffer {
+    uint32_t buffer = 0;
+    GLsync fence = nullptr;
+  };
+
+  [[nodiscard]] static uint32_t page_key(uint32_t texture, int32_t level, int32_t x, int32_t y);
+  // The parent page one level coarser, clamped to that level's page grid.
+  [[nodiscard]] uint32_t parent_key(uint32_t key) const;
+
+  void create_page_table(uint32_t id);
+  void rebuild_page_table(uint32_t id);
+  void resize_feedback(int32_t width, int32_t height);
+  void collect_feedback();
+  void process_requests(const std::vector<uint32_t> &requests);
+  void store_tile(const loaded_tile &tile);
+  [[nodiscard]] int32_t acquire_slot();
+
+  thread_pool &pool_;
+  virtual_texture_settings config_;
+  std::vector<virtual_texture> textures_;
+
+  uint32_t cache_texture_ = 0;
+  int32_t tile_size_ = 0;
+  std::vector<cache_slot> slots_;
+  std::unordered_map<uint32_t, int32_t> resident_;
+  std::unordered_set<uint32_t> loading_;
+
+  uint32_t feedback_framebuffer_ = 0;
+  uint32_t feedback_color_ = 0;
+  uint32_t feedback_depth_ = 0;
+  int32_t feedback_width_ = 0;
+  int32_t feedback_height_ = 0;
+  GLint saved_viewport_[4] = {};
+  GLint saved_framebuffer_ = 0;
+  std::vector<readback_buffer> readbacks_;
+  uint32_t next_readback_ = 0;
+
+  std::future<std::vector<uint32_t>> analysis_;
+  std::future<std::vector<loaded_tile>> loads_;
+
+  uint64_t frame_ = 0;
+  virtual_texture_stats stats_;
+};
+
+#endif  // VIRTUAL_TEXTURE_SYSTEM_H
@@ -0,0 +1,32 @@
+#ifndef HASH_H
+#define HASH_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+constexpr uint64_t fnv1a_64_offset = 0xcbf29ce484222325ull;
+constexpr uint64_t fnv1a_64_prime = 0x100000001b3ull;
+
+inline uint64_t fnv1a_64(const void *data, const size_t size, uint64_t hash = fnv1a_64_offset) {
+  const auto *bytes = static_cast<const uint8_t *>(data);
+  for (size_t i = 0; i < size; ++i) {
+    hash ^= bytes[i];
+    hash *= fnv1a_64_prime;
+  }
+  return hash;
+}
+
+inline uint64_t fnv1a_64(const std::string_view text, const uint64_t hash = fnv1a_64_offset) {
+  return fnv1a_64(text.data(), text.size(), hash);
+}
+
+inline std::string hash_to_hex(const uint64_t hash) {
+  constexpr char digits[] = "0123456789abcdef";
+  std::string result(16, '0');
+  for (int32_t i = 15, shift = 0; i >= 0; --i, shift += 4) result[i] = digits[(hash >> shift) & 0xf];
+  return result;
+}
+
+#endif  // HASH_H
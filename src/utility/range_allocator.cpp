@@ -0,0 +1,52 @@
+#include "range_allocator.h"
+
+#include <iterator>
+
+range_allocator::range_allocator(const size_t capacity) { grow(capacity); }
+
+size_t range_allocator::allocate(const size_t size) {
+  if (size == 0) return no_range;
+
+  for (auto range = free_.begin(); range != free_.end(); ++range) {
+    if (range->second < size) continue;
+
+    const size_t offset = range->first;
+    const size_t remaining = range->second - size;
+    free_.erase(range);
+    if (remaining != 0) free_.emplace(offset + size, remaining);
+    used_ += size;
+    return offset;
+  }
+  return no_range;
+}
+
+void range_allocator::free(size_t offset, size_t size) {
+  if (size == 0) return;
+  used_ -= size;
+
+  const auto next = free_.lower_bound(offset);
+  if (next != free_.end() && offset + size == next->first) {
+    size += next->second;
+    free_.erase(next);
+  }
+
+  const auto following = free_.lower_bound(offset);
+  if (following != free_.begin()) {
+    const auto previous = std::prev(following);
+    if (previous->first + previous->second == offset) {
+      previous->second += size;
+      return;
+    }
+  }
+  free_.emplace(offset, size);
+}
+
+void range_allocator::grow(const size_t new_capacity) {
+  if (new_capacity <= capacity_) return;
+
+  const size_t added = new_capacity - capacity_;
+  const size_t offset = capacity_;
+  capacity_ = new_capacity;
+  used_ += added;  // free() takes it back off
+  free(offset, added);
+}
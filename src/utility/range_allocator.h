@@ -0,0 +1,30 @@
+#ifndef RANGE_ALLOCATOR_H
+#define RANGE_ALLOCATOR_H
+
+#include <cstddef>
+#include <map>
+
+// Hands out ranges of [0, capacity), e.g. of a GPU buffer, first fit. Freed ranges merge with
+// free neighbours so the space does not splinter into unusable slivers over time.
+class range_allocator {
+ public:
+  static constexpr size_t no_range = ~size_t{0};
+
+  explicit range_allocator(size_t capacity = 0);
+
+  // Returns the start of the range, or no_range when no free range is large enough.
+  [[nodiscard]] size_t allocate(size_t size);
+  void free(size_t offset, size_t size);
+  // Adds [capacity, new_capacity) to the free space.
+  void grow(size_t new_capacity);
+
+  [[nodiscard]] size_t capacity() const { return capacity_; }
+  [[nodiscard]] size_t used() const { return used_; }
+
+ private:
+  std::map<size_t, size_t> free_;  // offset -> size
+  size_t capacity_ = 0;
+  size_t used_ = 0;
+};
+
+#endif  // RANGE_ALLOCATOR_H
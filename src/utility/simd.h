@@ -0,0 +1,36 @@
+#ifndef SIMD_H
+#define SIMD_H
+
+// Compile-time SIMD selection. SSE2 is the x86-64 baseline; the AVX2 (and F16C/FMA) paths are only
+// compiled when the build enables them, see ENGINE_ENABLE_AVX2 in CMakeLists.txt. Every SIMD path
+// keeps a scalar fallback for other architectures.
+
+#if defined(__AVX2__)
+#define ENGINE_SIMD_AVX2 1
+#endif
+
+#if defined(__F16C__)
+#define ENGINE_SIMD_F16C 1
+#endif
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define ENGINE_SIMD_SSE2 1
+#endif
+
+#if defined(ENGINE_SIMD_AVX2) || defined(ENGINE_SIMD_F16C)
+#include <immintrin.h>
+#elif defined(ENGINE_SIMD_SSE2)
+#include <emmintrin.h>
+#endif
+
+inline const char *simd_instruction_set_name() {
+#if defined(ENGINE_SIMD_AVX2)
+  return "AVX2";
+#elif defined(ENGINE_SIMD_SSE2)
+  return "SSE2";
+#else
+  return "scalar";
+#endif
+}
+
+#endif  // SIMD_H
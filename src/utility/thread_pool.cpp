@@ -0,0 +1,48 @@
+#include "thread_pool.h"
+
+thread_pool::thread_pool(const uint32_t thread_count) {
+  const uint32_t count = thread_count == 0 ? 1 : thread_count;
+  workers_.reserve(count);
+  for (uint32_t i = 0; i < count; ++i) workers_.emplace_back([this]() { worker_loop(); });
+}
+
+thread_pool::~thread_pool() {
+  {
+    std::lock_guard lock(mutex_);
+    stopping_ = true;
+  }
+  condition_.notify_all();
+
+  for (auto& worker : workers_) worker.join();
+}
+
+uint32_t thread_pool::default_thread_count() {
+  const uint32_t hardware = std::thread::hardware_concurrency();
+  return hardware > 1 ? hardware - 1 : 1;
+}
+
+uint32_t thread_pool::size() const { return static_cast<uint32_t>(workers_.size()); }
+
+void thread_pool::enqueue(std::function<void()> task) {
+  {
+    std::lock_guard lock(mutex_);
+    tasks_.push_back(std::move(task));
+  }
+  condition_.notify_one();
+}
+
+void thread_pool::worker_loop() {
+  while (true) {
+    std::function<void()> task;
+    {
+      std::unique_lock lock(mutex_);
+      condition_.wait(lock, [this]() { return stopping_ || !tasks_.empty(); });
+      if (stopping_ && tasks_.empty()) return;
+
+      task = std::move(tasks_.front());
+      tasks_.pop_front();
+    }
+
+    task();
+  }
+}
@@ -0,0 +1,96 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+class thread_pool {
+ public:
+  explicit thread_pool(uint32_t thread_count = default_thread_count());
+  thread_pool(const thread_pool&) = delete;
+  thread_pool& operator=(const thread_pool&) = delete;
+
+  ~thread_pool();
+
+  [[nodiscard]] static uint32_t default_thread_count();
+
+  [[nodiscard]] uint32_t size() const;
+
+  template <typename F>
+  auto submit(F&& task) -> std::future<std::invoke_result_t<std::decay_t<F>>> {
+    using result_t = std::invoke_result_t<std::decay_t<F>>;
+
+    auto packaged = std::make_shared<std::packaged_task<result_t()>>(std::forward<F>(task));
+    std::future<result_t> result = packaged->get_future();
+    enqueue([packaged]() { (*packaged)(); });
+
+    return result;
+  }
+
+  // Runs body(i) for every i in [begin, end). The calling thread takes part in the work, so it is
+  // safe to call this from inside another pool task.
+  template <typename F>
+  void parallel_for(size_t begin, size_t end, F&& body, size_t grain = 1) {
+    if (begin >= end) return;
+    grain = grain == 0 ? 1 : grain;
+
+    struct state {
+      std::atomic<size_t> next;
+      size_t end = 0;
+      size_t done = 0;
+      std::mutex mutex;
+      std::condition_variable finished;
+    };
+
+    auto shared = std::make_shared<state>();
+    shared->next = begin;
+    shared->end = end;
+
+    const size_t total = end - begin;
+    auto run = [shared, grain, &body, total]() {
+      while (true) {
+        const size_t first = shared->next.fetch_add(grain);
+        if (first >= shared->end) return;
+
+        const size_t last = std::min(first + grain, shared->end);
+        for (size_t i = first; i < last; ++i) body(i);
+
+        std::lock_guard lock(shared->mutex);
+        shared->done += last - first;
+        if (shared->done == total) shared->finished.notify_all();
+      }
+    };
+
+    const size_t chunks = (total + grain - 1) / grain;
+    const size_t helpers = std::min<size_t>(workers_.size(), chunks > 0 ? chunks - 1 : 0);
+    for (size_t i = 0; i < helpers; ++i) enqueue(run);
+
+    run();
+
+    // Helpers that have not started yet find no work left and return without touching body.
+    std::unique_lock lock(shared->mutex);
+    shared->finished.wait(lock, [&]() { return shared->done == total; });
+  }
+
+ private:
+  void enqueue(std::function<void()> task);
+  void worker_loop();
+
+  std::vector<std::thread> workers_;
+  std::deque<std::function<void()>> tasks_;
+  std::mutex mutex_;
+  std::condition_variable condition_;
+  bool stopping_ = false;
+};
+
+#endif  // THREAD_POOL_H
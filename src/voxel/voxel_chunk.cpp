@@ -0,0 +1,126 @@
+#include "voxel_chunk.h"
+
+#include <algorithm>
+
+namespace {
+
+// Power-of-two widths only, so an index never straddles two words.
+uint32_t bits_for(const size_t entries) {
+  if (entries <= 1) return 0;
+  if (entries <= 2) return 1;
+  if (entries <= 4) return 2;
+  if (entries <= 16) return 4;
+  if (entries <= 256) return 8;
+  return 16;
+}
+
+size_t word_count(const uint32_t bits) { return static_cast<size_t>(voxel_chunk_volume) * bits / 64; }
+
+}  // namespace
+
+voxel_chunk::voxel_chunk(const voxel fill) : palette_{fill}, counts_{static_cast<uint32_t>(voxel_chunk_volume)} {}
+
+voxel_chunk voxel_chunk::from_voxels(const voxel *voxels) {
+  voxel_chunk chunk;
+  chunk.palette_.assign(voxels, voxels + voxel_chunk_volume);
+  std::sort(chunk.palette_.begin(), chunk.palette_.end());
+  chunk.palette_.erase(std::unique(chunk.palette_.begin(), chunk.palette_.end()), chunk.palette_.end());
+  chunk.counts_.assign(chunk.palette_.size(), 0);
+
+  chunk.bits_ = bits_for(chunk.palette_.size());
+  chunk.words_.assign(word_count(chunk.bits_), 0);
+
+  voxel last = chunk.palette_[0];
+  uint32_t entry = 0;
+  for (int32_t i = 0; i < voxel_chunk_volume; ++i) {
+    if (voxels[i] != last) {
+      last = voxels[i];
+      entry = static_cast<uint32_t>(std::lower_bound(chunk.palette_.begin(), chunk.palette_.end(), last) -
+                                    chunk.palette_.begin());
+    }
+    ++chunk.counts_[entry];
+    if (chunk.bits_ != 0) chunk.store_index(i, entry);
+  }
+  return chunk;
+}
+
+uint32_t voxel_chunk::index_at(const int32_t index) const {
+  if (bits_ == 0) return 0;
+  const size_t bit = static_cast<size_t>(index) * bits_;
+  return static_cast<uint32_t>(words_[bit >> 6] >> (bit & 63)) & ((1u << bits_) - 1u);
+}
+
+void voxel_chunk::store_index(const int32_t index, const uint32_t entry) {
+  const size_t bit = static_cast<size_t>(index) * bits_;
+  const uint64_t mask = ((uint64_t{1} << bits_) - 1u) << (bit & 63);
+  uint64_t &word = words_[bit >> 6];
+  word = (word & ~mask) | (static_cast<uint64_t>(entry) << (bit & 63));
+}
+
+void voxel_chunk::repack(const uint32_t bits) {
+  std::vector<uint16_t> entries(voxel_chunk_volume);
+  for (int32_t i = 0; i < voxel_chunk_volume; ++i) entries[i] = static_cast<uint16_t>(index_at(i));
+
+  bits_ = bits;
+  words_.assign(word_count(bits_), 0);
+  if (bits_ == 0) return;
+  for (int32_t i = 0; i < voxel_chunk_volume; ++i) store_index(i, entries[i]);
+}
+
+voxel voxel_chunk::get(const int32_t index) const { return palette_[index_at(index)]; }
+
+bool voxel_chunk::set(const int32_t index, const voxel value) {
+  const uint32_t previous = index_at(index);
+  if (palette_[previous] == value) return false;
+
+  // An entry that already holds the material, else a free one, else a new one.
+  uint32_t entry = static_cast<uint32_t>(palette_.size());
+  for (uint32_t i = 0; i < palette_.size(); ++i) {
+    if (counts_[i] != 0 && palette_[i] == value) {
+      entry = i;
+      break;
+    }
+    if (counts_[i] == 0 && entry == palette_.size()) entry = i;
+  }
+  if (entry == palette_.size()) {
+    palette_.push_back(value);
+    counts_.push_back(0);
+    if (palette_.size() > (size_t{1} << bits_)) repack(bits_for(palette_.size()));
+  }
+  palette_[entry] = value;
+
+  --counts_[previous];
+  ++counts_[entry];
+  store_index(index, entry);
+
+  if (counts_[previous] == 0 && counts_[entry] == static_cast<uint32_t>(voxel_chunk_volume)) {
+    palette_ = {value};
+    counts_ = {static_cast<uint32_t>(voxel_chunk_volume)};
+    words_.clear();
+    words_.shrink_to_fit();
+    bits_ = 0;
+  }
+  return true;
+}
+
+void voxel_chunk::decode(voxel *out) const {
+  if (bits_ == 0) {
+    std::fill(out, out + voxel_chunk_volume, palette_[0]);
+    return;
+  }
+
+  const uint32_t per_word = 64 / bits_;
+  const uint64_t mask = (uint64_t{1} << bits_) - 1u;
+  for (const uint64_t word : words_) {
+    for (uint32_t i = 0; i < per_word; ++i) *out++ = palette_[(word >> (i * bits_)) & mask];
+  }
+}
+
+size_t voxel_chunk::palette_size() const {
+  return static_cast<size_t>(std::count_if(counts_.begin(), counts_.end(), [](const uint32_t n) { return n != 0; }));
+}
+
+size_t voxel_chunk::size_in_bytes() const {
+  return sizeof(*this) + palette_.capacity() * sizeof(voxel) + counts_.capacity() * sizeof(uint32_t) +
+         words_.capacity() * sizeof(uint64_t);
+}
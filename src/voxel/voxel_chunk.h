@@ -0,0 +1,63 @@
+#ifndef VOXEL_CHUNK_H
+#define VOXEL_CHUNK_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// A material id; 0 is empty space, everything else is solid.
+using voxel = uint16_t;
+
+constexpr voxel empty_voxel = 0;
+constexpr int32_t voxel_chunk_size = 32;
+constexpr int32_t voxel_chunk_volume = voxel_chunk_size * voxel_chunk_size * voxel_chunk_size;
+
+// Voxels inside a chunk are addressed x first, then y, then z.
+[[nodiscard]] constexpr int32_t voxel_index(const int32_t x, const int32_t y, const int32_t z) {
+  return x + y * voxel_chunk_size + z * voxel_chunk_size * voxel_chunk_size;
+}
+
+// 32^3 voxels, palette compressed: every distinct material in the chunk gets a palette entry and
+// voxels store their entry's index in 0, 1, 2, 4, 8 or 16 bits. A chunk of a single material
+// therefore costs its palette alone, a surface chunk with a handful of materials 2 or 4 bits per
+// voxel. Indices never straddle a 64-bit word, so reads are one shift and mask.
+//
+// Palette entries are reference counted; entries whose voxels are all gone are reused before the
+// palette grows, and a chunk that is back to one material drops its indices.
+class voxel_chunk {
+ public:
+  explicit voxel_chunk(voxel fill = empty_voxel);
+
+  // Builds a chunk from voxel_chunk_volume voxels in voxel_index() order.
+  [[nodiscard]] static voxel_chunk from_voxels(const voxel *voxels);
+
+  [[nodiscard]] voxel get(int32_t index) const;
+  [[nodiscard]] voxel get(int32_t x, int32_t y, int32_t z) const { return get(voxel_index(x, y, z)); }
+  // Returns whether the voxel changed.
+  bool set(int32_t index, voxel value);
+
+  // Writes all voxels in voxel_index() order.
+  void decode(voxel *out) const;
+
+  [[nodiscard]] bool is_uniform() const { return bits_ == 0; }
+  // The material of a uniform chunk.
+  [[nodiscard]] voxel uniform_value() const { return palette_[0]; }
+  [[nodiscard]] bool is_empty() const { return is_uniform() && palette_[0] == empty_voxel; }
+
+  [[nodiscard]] uint32_t bits_per_voxel() const { return bits_; }
+  [[nodiscard]] size_t palette_size() const;  // entries in use
+  [[nodiscard]] size_t size_in_bytes() const;
+
+ private:
+  [[nodiscard]] uint32_t index_at(int32_t index) const;
+  void store_index(int32_t index, uint32_t entry);
+  // Re-encodes the indices with `bits` per voxel.
+  void repack(uint32_t bits);
+
+  std::vector<voxel> palette_;
+  std::vector<uint32_t> counts_;  // voxels per palette entry; 0 marks a free entry
+  std::vector<uint64_t> words_;
+  uint32_t bits_ = 0;
+};
+
+#endif  // VOXEL_CHUNK_H
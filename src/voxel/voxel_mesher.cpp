@@ -0,0 +1,162 @@
+#include "voxel_mesher.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iterator>
+#include <memory>
+
+namespace {
+
+constexpr int32_t padded_size = voxel_chunk_size + 2;
+constexpr int32_t padded_strides[3] = {1, padded_size, padded_size * padded_size};
+
+int32_t padded_index(const int32_t x, const int32_t y, const int32_t z) {
+  return (x + 1) * padded_strides[0] + (y + 1) * padded_strides[1] + (z + 1) * padded_strides[2];
+}
+
+bool is_solid_block(const std::shared_ptr<const voxel_chunk> &chunk) {
+  return chunk != nullptr && chunk->is_uniform() && chunk->uniform_value() != empty_voxel;
+}
+
+// The chunk plus a one-voxel border of its face neighbours, in a 34^3 grid. Edges and corners of
+// the border are never read.
+void gather(const voxel_neighbourhood &neighbourhood, voxel *padded) {
+  thread_local std::vector<voxel> voxels(voxel_chunk_volume);
+  neighbourhood.centre->decode(voxels.data());
+  for (int32_t z = 0; z < voxel_chunk_size; ++z) {
+    for (int32_t y = 0; y < voxel_chunk_size; ++y) {
+      std::memcpy(&padded[padded_index(0, y, z)], &voxels[voxel_index(0, y, z)], voxel_chunk_size * sizeof(voxel));
+    }
+  }
+
+  for (int32_t side = 0; side < 6; ++side) {
+    const int32_t axis = side / 2;
+    const int32_t u = (axis + 1) % 3, v = (axis + 2) % 3;
+    const std::shared_ptr<const voxel_chunk> &chunk = neighbourhood.sides[side];
+
+    // The neighbour's layer touching this chunk, written just outside it.
+    int32_t source[3], target[3];
+    source[axis] = side % 2 == 0 ? voxel_chunk_size - 1 : 0;
+    target[axis] = side % 2 == 0 ? -1 : voxel_chunk_size;
+    for (int32_t j = 0; j < voxel_chunk_size; ++j) {
+      for (int32_t i = 0; i < voxel_chunk_size; ++i) {
+        source[u] = target[u] = i;
+        source[v] = target[v] = j;
+        padded[padded_index(target[0], target[1], target[2])] =
+            chunk == nullptr ? empty_voxel : chunk->get(source[0], source[1], source[2]);
+      }
+    }
+  }
+}
+
+void emit_quad(const int32_t axis, const bool positive, const voxel material, const int32_t (&corner)[3],
+               const int32_t width, const int32_t height, std::vector<voxel_vertex> &out) {
+  const int32_t u = (axis + 1) % 3, v = (axis + 2) % 3;
+  const auto attributes = static_cast<uint16_t>((axis * 2 + (positive ? 1 : 0)) |
+                                                (material & (voxel_max_materials - 1)) << 3);
+
+  const auto vertex = [&](const int32_t du, const int32_t dv) {
+    int32_t position[3] = {corner[0], corner[1], corner[2]};
+    position[u] += du;
+    position[v] += dv;
+    out.push_back({static_cast<int16_t>(position[0]), static_cast<int16_t>(position[1]),
+                   static_cast<int16_t>(position[2]), attributes});
+  };
+
+  // u x v points along +axis, so this order is counter-clockwise seen from the positive side.
+  if (positive) {
+    vertex(0, 0);
+    vertex(width, 0);
+    vertex(width, height);
+    vertex(0, height);
+  } else {
+    vertex(0, 0);
+    vertex(0, height);
+    vertex(width, height);
+    vertex(width, 0);
+  }
+}
+
+}  // namespace
+
+size_t mesh_voxel_chunk(const voxel_neighbourhood &neighbourhood, std::vector<voxel_vertex> &out) {
+  if (neighbourhood.centre == nullptr || neighbourhood.centre->is_empty()) return 0;
+
+  // Solid all the way through and buried on every side: nothing can be seen.
+  if (is_solid_block(neighbourhood.centre) &&
+      std::all_of(std::begin(neighbourhood.sides), std::end(neighbourhood.sides), is_solid_block)) {
+    return 0;
+  }
+
+  thread_local std::vector<voxel> padded(static_cast<size_t>(padded_size) * padded_size * padded_size);
+  gather(neighbourhood, padded.data());
+
+  const glm::ivec3 origin = neighbourhood.chunk * voxel_chunk_size;
+  size_t quads = 0;
+
+  // Positive entries are faces looking along +axis with that material, negative ones along -axis.
+  int32_t mask[voxel_chunk_size * voxel_chunk_size];
+
+  for (int32_t axis = 0; axis < 3; ++axis) {
+    const int32_t u = (axis + 1) % 3, v = (axis + 2) % 3;
+
+    // Slice s is the plane between voxels s - 1 and s along the axis. The chunk owns the faces of
+    // its own voxels only: on the first plane the ones looking back, on the last the ones looking out.
+    for (int32_t slice = 0; slice <= voxel_chunk_size; ++slice) {
+      bool any = false;
+      for (int32_t j = 0; j < voxel_chunk_size; ++j) {
+        for (int32_t i = 0; i < voxel_chunk_size; ++i) {
+          int32_t behind[3];
+          behind[axis] = slice - 1;
+          behind[u] = i;
+          behind[v] = j;
+          const int32_t index = padded_index(behind[0], behind[1], behind[2]);
+          const voxel back = padded[index], front = padded[index + padded_strides[axis]];
+
+          int32_t face = 0;
+          if (slice > 0 && back != empty_voxel && front == empty_voxel) {
+            face = back;
+          } else if (slice < voxel_chunk_size && front != empty_voxel && back == empty_voxel) {
+            face = -static_cast<int32_t>(front);
+          }
+          mask[j * voxel_chunk_size + i] = face;
+          any = any || face != 0;
+        }
+      }
+      if (!any) continue;
+
+      for (int32_t j = 0; j < voxel_chunk_size; ++j) {
+        for (int32_t i = 0; i < voxel_chunk_size;) {
+          const int32_t face = mask[j * voxel_chunk_size + i];
+          if (face == 0) {
+            ++i;
+            continue;
+          }
+
+          int32_t width = 1;
+          while (i + width < voxel_chunk_size && mask[j * voxel_chunk_size + i + width] == face) ++width;
+
+          int32_t height = 1;
+          for (; j + height < voxel_chunk_size; ++height) {
+            const int32_t *row = &mask[(j + height) * voxel_chunk_size + i];
+            if (!std::all_of(row, row + width, [face](const int32_t other) { return other == face; })) break;
+          }
+
+          for (int32_t k = 0; k < height; ++k) {
+            std::fill_n(&mask[(j + k) * voxel_chunk_size + i], width, 0);
+          }
+
+          int32_t corner[3];
+          corner[axis] = origin[axis] + slice;
+          corner[u] = origin[u] + i;
+          corner[v] = origin[v] + j;
+          emit_quad(axis, face > 0, static_cast<voxel>(face > 0 ? face : -face), corner, width, height, out);
+          ++quads;
+          i += width;
+        }
+      }
+    }
+  }
+
+  return quads;
+}
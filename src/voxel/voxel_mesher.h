@@ -0,0 +1,27 @@
+#ifndef VOXEL_MESHER_H
+#define VOXEL_MESHER_H
+
+#include <cstdint>
+#include <vector>
+
+#include "voxel_volume.h"
+
+// One corner of a quad, 8 bytes. Positions are in voxels from the volume origin, so volumes are
+// limited to +-32767 voxels per axis.
+struct voxel_vertex {
+  int16_t x, y, z;
+  uint16_t face_and_material;  // face (0-5 for -x, +x, -y, +y, -z, +z) | material << 3
+};
+static_assert(sizeof(voxel_vertex) == 8, "voxel vertex must be packed");
+
+// Materials beyond this wrap around in the vertex format.
+constexpr int32_t voxel_max_materials = 1 << 13;
+
+// Appends the greedy mesh of one chunk to `out`: the visible faces of each slice are merged into
+// maximal rectangles of the same material and facing. Faces on the chunk border are kept or culled
+// against the neighbours, so adjacent chunks mesh independently without gaps or hidden faces.
+// Each quad is four vertices, drawn as triangles (0, 1, 2) and (0, 2, 3). Returns the number of
+// quads added.
+size_t mesh_voxel_chunk(const voxel_neighbourhood &neighbourhood, std::vector<voxel_vertex> &out);
+
+#endif  // VOXEL_MESHER_H
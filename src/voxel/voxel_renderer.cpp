@@ -0,0 +1,272 @@
+#include "voxel_renderer.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+
+#include "../render/frustum.h"
+#include "../shader/shader.h"
+#include "../utility/thread_pool.h"
+
+namespace {
+
+constexpr GLuint position_location = 0;
+constexpr GLuint attributes_location = 1;
+
+template <typename T>
+bool is_finished(const std::future<T> &future) {
+  return future.valid() && future.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+}
+
+double to_mib(const size_t bytes) { return static_cast<double>(bytes) / (1024.0 * 1024.0); }
+
+}  // namespace
+
+voxel_renderer::voxel_renderer(thread_pool &pool, const voxel_render_settings &config)
+    : pool_(pool), config_(config), vertices_(config.initial_vertex_capacity), staging_(config.staging_bytes) {
+  glGenVertexArrays(1, &vao_);
+  glGenBuffers(1, &vertex_buffer_);
+  glGenBuffers(1, &index_buffer_);
+
+  glBindBuffer(GL_ARRAY_BUFFER, vertex_buffer_);
+  glBufferData(GL_ARRAY_BUFFER, static_cast<GLsizeiptr>(vertices_.capacity() * sizeof(voxel_vertex)), nullptr,
+               GL_DYNAMIC_DRAW);
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+  point_vertex_attributes();
+  reserve_quad_indices(16384);
+}
+
+voxel_renderer::~voxel_renderer() {
+  // Workers may still be reading chunk snapshots; they own them, but not the results.
+  for (const uint64_t key : in_flight_) meshes_[key].job.wait();
+
+  glDeleteVertexArrays(1, &vao_);
+  glDeleteBuffers(1, &vertex_buffer_);
+  glDeleteBuffers(1, &index_buffer_);
+}
+
+void voxel_renderer::point_vertex_attributes() const {
+  glBindVertexArray(vao_);
+  glBindBuffer(GL_ARRAY_BUFFER, vertex_buffer_);
+  glVertexAttribIPointer(position_location, 3, GL_SHORT, sizeof(voxel_vertex),
+                         reinterpret_cast<void *>(offsetof(voxel_vertex, x)));
+  glEnableVertexAttribArray(position_location);
+  glVertexAttribIPointer(attributes_location, 1, GL_UNSIGNED_SHORT, sizeof(voxel_vertex),
+                         reinterpret_cast<void *>(offsetof(voxel_vertex, face_and_material)));
+  glEnableVertexAttribArray(attributes_location);
+  glBindVertexArray(0);
+}
+
+void voxel_renderer::reserve_quad_indices(const size_t quad_count) {
+  if (quad_count <= index_quads_) return;
+  index_quads_ = std::max(quad_count, index_quads_ * 2);
+
+  std::vector<uint32_t> indices;
+  indices.reserve(index_quads_ * 6);
+  for (uint32_t quad = 0; quad < index_quads_; ++quad) {
+    const uint32_t first = quad * 4;
+    indices.insert(indices.end(), {first, first + 1, first + 2, first, first + 2, first + 3});
+  }
+
+  glBindVertexArray(vao_);
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, index_buffer_);
+  glBufferData(GL_ELEMENT_ARRAY_BUFFER, static_cast<GLsizeiptr>(indices.size() * sizeof(uint32_t)), indices.data(),
+               GL_STATIC_DRAW);
+  glBindVertexArray(0);
+}
+
+void voxel_renderer::grow_vertex_buffer(const size_t vertex_count) {
+  const size_t capacity = std::max(vertices_.capacity() * 2, vertices_.capacity() + vertex_count);
+
+  uint32_t grown = 0;
+  glGenBuffers(1, &grown);
+  glBindBuffer(GL_COPY_WRITE_BUFFER, grown);
+  glBufferData(GL_COPY_WRITE_BUFFER, static_cast<GLsizeiptr>(capacity * sizeof(voxel_vertex)), nullptr,
+               GL_DYNAMIC_DRAW);
+  glBindBuffer(GL_COPY_READ_BUFFER, vertex_buffer_);
+  glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0,
+                      static_cast<GLsizeiptr>(vertices_.capacity() * sizeof(voxel_vertex)));
+  glBindBuffer(GL_COPY_READ_BUFFER, 0);
+  glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+  glDeleteBuffers(1, &vertex_buffer_);
+  vertex_buffer_ = grown;
+  vertices_.grow(capacity);
+  point_vertex_attributes();
+}
+
+glm::vec3 voxel_renderer::to_volume(const glm::vec3 &world) const {
+  return (world - config_.origin) / config_.voxel_size;
+}
+
+void voxel_renderer::start_job(const uint64_t key, chunk_mesh &mesh, const voxel_volume &volume) {
+  mesh.job_version = mesh.version;
+  mesh.job = pool_.submit([neighbourhood = volume.neighbourhood(mesh.chunk)]() {
+    std::vector<voxel_vertex> vertices;
+    (void) mesh_voxel_chunk(neighbourhood, vertices);
+    return vertices;
+  });
+  in_flight_.push_back(key);
+}
+
+bool voxel_renderer::upload(const uint64_t key, chunk_mesh &mesh) {
+  const size_t count = mesh.finished.size();
+
+  streaming_allocation staging;
+  if (count != 0) {
+    staging = staging_.allocate(count * sizeof(voxel_vertex));
+    if (staging.empty()) return false;
+    std::memcpy(staging.data, mesh.finished.data(), staging.size);
+    staging_.commit(staging);
+  }
+
+  // Draws already issued from the old range are ordered before the copy that overwrites it.
+  if (mesh.vertex_count != 0) vertices_.free(mesh.first_vertex, mesh.vertex_count);
+  mesh.first_vertex = range_allocator::no_range;
+  mesh.vertex_count = 0;
+
+  if (count != 0) {
+    size_t first = vertices_.allocate(count);
+    if (first == range_allocator::no_range) {
+      grow_vertex_buffer(count);
+      first = vertices_.allocate(count);
+    }
+
+    glBindBuffer(GL_COPY_READ_BUFFER, staging_.buffer());
+    glBindBuffer(GL_COPY_WRITE_BUFFER, vertex_buffer_);
+    glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, static_cast<GLintptr>(staging.offset),
+                        static_cast<GLintptr>(first * sizeof(voxel_vertex)), static_cast<GLsizeiptr>(staging.size));
+    glBindBuffer(GL_COPY_READ_BUFFER, 0);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+    mesh.first_vertex = first;
+    mesh.vertex_count = count;
+    reserve_quad_indices(count / 4);
+  }
+
+  std::vector<voxel_vertex>().swap(mesh.finished);
+  mesh.has_finished = false;
+  ++stats_.chunks_uploaded;
+
+  const bool up_to_date = !mesh.queued && !mesh.job.valid();
+  if (up_to_date) {
+    const std::chrono::duration<double, std::milli> latency = clock::now() - mesh.dirty_since;
+    stats_.last_remesh_ms = latency.count();
+    if (count == 0) meshes_.erase(key);
+  }
+  return true;
+}
+
+void voxel_renderer::update(voxel_volume &volume) {
+  stats_.chunks_uploaded = 0;
+
+  for (const glm::ivec3 &chunk : volume.take_dirty_chunks()) {
+    const uint64_t key = voxel_chunk_key(chunk);
+    chunk_mesh &mesh = meshes_[key];
+    if (!mesh.queued && !mesh.job.valid() && !mesh.has_finished) mesh.dirty_since = clock::now();
+    mesh.chunk = chunk;
+    ++mesh.version;
+
+    // A chunk already being meshed is started again when that job comes back.
+    if (!mesh.queued && !mesh.job.valid()) {
+      mesh.queued = true;
+      queued_.push_back(key);
+    }
+  }
+
+  std::vector<uint64_t> running;
+  for (const uint64_t key : in_flight_) {
+    chunk_mesh &mesh = meshes_[key];
+    if (!is_finished(mesh.job)) {
+      running.push_back(key);
+      continue;
+    }
+
+    std::vector<voxel_vertex> vertices = mesh.job.get();
+    if (mesh.version != mesh.job_version) {
+      mesh.queued = true;
+      queued_.push_back(key);
+      continue;
+    }
+
+    if (!mesh.has_finished) finished_.push_back(key);
+    mesh.finished = std::move(vertices);
+    mesh.has_finished = true;
+  }
+  in_flight_ = std::move(running);
+
+  while (!queued_.empty() && in_flight_.size() < static_cast<size_t>(std::max(config_.max_jobs_in_flight, 1))) {
+    const uint64_t key = queued_.front();
+    queued_.pop_front();
+    chunk_mesh &mesh = meshes_[key];
+    mesh.queued = false;
+    start_job(key, mesh, volume);
+  }
+
+  // Always let one mesh through so a mesh larger than the budget still makes progress.
+  size_t budget = config_.upload_bytes_per_frame;
+  size_t uploaded = 0;
+  for (; uploaded < finished_.size(); ++uploaded) {
+    const uint64_t key = finished_[uploaded];
+    chunk_mesh &mesh = meshes_[key];
+    const size_t bytes = mesh.finished.size() * sizeof(voxel_vertex);
+    if (uploaded != 0 && bytes > budget) break;
+    if (!upload(key, mesh)) break;
+    budget = bytes > budget ? 0 : budget - bytes;
+  }
+  finished_.erase(finished_.begin(), finished_.begin() + static_cast<std::ptrdiff_t>(uploaded));
+  staging_.end_frame();
+
+  stats_.meshed_chunks = static_cast<size_t>(std::count_if(
+      meshes_.begin(), meshes_.end(), [](const auto &entry) { return entry.second.vertex_count != 0; }));
+  stats_.pending_chunks = queued_.size() + in_flight_.size() + finished_.size();
+  stats_.vertex_bytes = vertices_.used() * sizeof(voxel_vertex);
+  stats_.vertex_capacity_bytes = vertices_.capacity() * sizeof(voxel_vertex);
+}
+
+void voxel_renderer::draw(const shader &program, const glm::mat4 &view_projection) {
+  stats_.visible_chunks = 0;
+  stats_.draw_calls = 0;
+  stats_.quads = 0;
+
+  draw_counts_.clear();
+  draw_offsets_.clear();
+  draw_base_vertices_.clear();
+
+  const frustum planes = extract_frustum(view_projection);
+  const float chunk_extent = static_cast<float>(voxel_chunk_size) * config_.voxel_size;
+  for (const auto &[key, mesh] : meshes_) {
+    if (mesh.vertex_count == 0) continue;
+
+    const glm::vec3 min = config_.origin + glm::vec3(mesh.chunk) * chunk_extent;
+    if (test_aabb(planes, min, min + chunk_extent) == frustum_test::outside) continue;
+
+    draw_counts_.push_back(static_cast<GLsizei>(mesh.vertex_count / 4 * 6));
+    draw_offsets_.push_back(nullptr);
+    draw_base_vertices_.push_back(static_cast<GLint>(mesh.first_vertex));
+    stats_.quads += mesh.vertex_count / 4;
+  }
+  if (draw_counts_.empty()) return;
+
+  program.setVec3("volumeOrigin", config_.origin);
+  program.setFloat("voxelSize", config_.voxel_size);
+
+  glBindVertexArray(vao_);
+  glMultiDrawElementsBaseVertex(GL_TRIANGLES, draw_counts_.data(), GL_UNSIGNED_INT, draw_offsets_.data(),
+                                static_cast<GLsizei>(draw_counts_.size()), draw_base_vertices_.data());
+  glBindVertexArray(0);
+
+  stats_.visible_chunks = draw_counts_.size();
+  stats_.draw_calls = 1;
+}
+
+void voxel_renderer::print_stats(std::ostream &out) const {
+  out << std::fixed << std::setprecision(2) << "voxels: " << stats_.meshed_chunks << " chunks meshed, "
+      << stats_.pending_chunks << " pending, " << stats_.visible_chunks << " visible in " << stats_.draw_calls
+      << " draw calls, " << stats_.quads << " quads, " << to_mib(stats_.vertex_bytes) << "/"
+      << to_mib(stats_.vertex_capacity_bytes) << " MiB of vertices, last remesh " << stats_.last_remesh_ms << " ms"
+      << std::endl;
+}
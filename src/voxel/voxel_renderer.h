@@ -0,0 +1,119 @@
+#ifndef VOXEL_RENDERER_H
+#define VOXEL_RENDERER_H
+
+#include <glm/glm.hpp>
+
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <future>
+#include <iosfwd>
+#include <unordered_map>
+#include <vector>
+
+#include "voxel_mesher.h"
+#include "voxel_volume.h"
+#include "../render/streaming_buffer.h"
+#include "../utility/range_allocator.h"
+
+class shader;
+class thread_pool;
+
+struct voxel_render_settings {
+  glm::vec3 origin = glm::vec3(0.0f);  // world position of the volume's origin
+  float voxel_size = 0.25f;            // metres
+  size_t initial_vertex_capacity = 1 << 20;  // grows as needed
+  size_t staging_bytes = 8 * 1024 * 1024;
+  size_t upload_bytes_per_frame = 4 * 1024 * 1024;
+  int32_t max_jobs_in_flight = 64;
+};
+
+struct voxel_render_stats {
+  size_t meshed_chunks = 0;   // with a mesh on the GPU
+  size_t pending_chunks = 0;  // queued, meshing or waiting for upload
+  size_t chunks_uploaded = 0;  // in the last update()
+  size_t visible_chunks = 0;   // in the last draw()
+  size_t draw_calls = 0;
+  size_t quads = 0;  // drawn
+  size_t vertex_bytes = 0;
+  size_t vertex_capacity_bytes = 0;
+  double last_remesh_ms = 0.0;  // from an edit reaching update() to its new mesh being uploaded
+};
+
+// Draws a voxel_volume as greedy meshes, one per chunk, rebuilt on the pool as chunks change.
+//
+// Each update() takes the chunks the volume marked dirty and meshes them on workers from
+// copy-on-write snapshots of their neighbourhoods, so editing carries on while they run; a chunk
+// edited again before its mesh lands is simply meshed again. Finished meshes go through a
+// streaming_buffer into one vertex buffer shared by all chunks, sub-allocated with a
+// range_allocator, under a per-frame byte budget. draw() culls chunk boxes against the frustum and
+// issues every visible chunk in one glMultiDrawElementsBaseVertex over a shared quad index buffer.
+//
+// All member functions must be called on the thread that owns the GL context.
+class voxel_renderer {
+ public:
+  explicit voxel_renderer(thread_pool &pool, const voxel_render_settings &config = {});
+  voxel_renderer(const voxel_renderer &) = delete;
+  voxel_renderer &operator=(const voxel_renderer &) = delete;
+
+  ~voxel_renderer();
+
+  // Starts meshing the chunks edited since the last call and uploads finished meshes.
+  void update(voxel_volume &volume);
+
+  // Draws with `program`, which must be in use and have its view and projection set.
+  void draw(const shader &program, const glm::mat4 &view_projection);
+
+  // World space to the volume's voxel coordinates, e.g. for voxel_volume::raycast().
+  [[nodiscard]] glm::vec3 to_volume(const glm::vec3 &world) const;
+
+  [[nodiscard]] const voxel_render_stats &stats() const { return stats_; }
+  void print_stats(std::ostream &out) const;
+
+ private:
+  using clock = std::chrono::steady_clock;
+
+  struct chunk_mesh {
+    glm::ivec3 chunk = glm::ivec3(0);
+    uint32_t version = 0;      // bumped whenever the chunk is edited
+    uint32_t job_version = 0;  // of the mesh being built or waiting for upload
+    bool queued = false;
+    std::future<std::vector<voxel_vertex>> job;
+    std::vector<voxel_vertex> finished;
+    bool has_finished = false;
+    size_t first_vertex = range_allocator::no_range;
+    size_t vertex_count = 0;
+    clock::time_point dirty_since;
+  };
+
+  void start_job(uint64_t key, chunk_mesh &mesh, const voxel_volume &volume);
+  // Returns false when the staging ring is full for this frame.
+  bool upload(uint64_t key, chunk_mesh &mesh);
+  // Reallocates the vertex buffer with room for at least `vertex_count` more vertices.
+  void grow_vertex_buffer(size_t vertex_count);
+  void reserve_quad_indices(size_t quad_count);
+  void point_vertex_attributes() const;
+
+  thread_pool &pool_;
+  voxel_render_settings config_;
+
+  std::unordered_map<uint64_t, chunk_mesh> meshes_;
+  std::deque<uint64_t> queued_;
+  std::vector<uint64_t> in_flight_;
+  std::vector<uint64_t> finished_;
+
+  uint32_t vao_ = 0;
+  uint32_t vertex_buffer_ = 0;
+  uint32_t index_buffer_ = 0;
+  size_t index_quads_ = 0;
+  range_allocator vertices_;
+  streaming_buffer staging_;
+
+  std::vector<GLsizei> draw_counts_;
+  std::vector<const void *> draw_offsets_;
+  std::vector<GLint> draw_base_vertices_;
+
+  voxel_render_stats stats_;
+};
+
+#endif  // VOXEL_RENDERER_H
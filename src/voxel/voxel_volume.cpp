@@ -0,0 +1,314 @@
+#include "voxel_volume.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include "../terrain/heightmap.h"
+#include "../utility/thread_pool.h"
+
+namespace {
+
+constexpr int32_t key_bias = 1 << 20;
+constexpr uint64_t key_mask = (uint64_t{1} << 21) - 1u;
+
+const glm::ivec3 side_offsets[6] = {{-1, 0, 0}, {1, 0, 0}, {0, -1, 0}, {0, 1, 0}, {0, 0, -1}, {0, 0, 1}};
+
+}  // namespace
+
+uint64_t voxel_chunk_key(const glm::ivec3 &chunk) {
+  return (static_cast<uint64_t>(chunk.x + key_bias) & key_mask) |
+         (static_cast<uint64_t>(chunk.y + key_bias) & key_mask) << 21 |
+         (static_cast<uint64_t>(chunk.z + key_bias) & key_mask) << 42;
+}
+
+glm::ivec3 voxel_chunk_coordinate(const uint64_t key) {
+  return {static_cast<int32_t>(key & key_mask) - key_bias, static_cast<int32_t>((key >> 21) & key_mask) - key_bias,
+          static_cast<int32_t>((key >> 42) & key_mask) - key_bias};
+}
+
+glm::ivec3 voxel_chunk_of(const glm::ivec3 &position) {
+  // Arithmetic shifts round towards negative infinity, unlike division.
+  return {position.x >> 5, position.y >> 5, position.z >> 5};
+}
+
+glm::ivec3 voxel_local_position(const glm::ivec3 &position) {
+  return {position.x & (voxel_chunk_size - 1), position.y & (voxel_chunk_size - 1),
+          position.z & (voxel_chunk_size - 1)};
+}
+
+voxel voxel_volume::get(const glm::ivec3 &position) const {
+  const auto found = chunks_.find(voxel_chunk_key(voxel_chunk_of(position)));
+  if (found == chunks_.end()) return empty_voxel;
+
+  const glm::ivec3 local = voxel_local_position(position);
+  return found->second->get(local.x, local.y, local.z);
+}
+
+voxel_chunk &voxel_volume::writable_chunk(const uint64_t key) {
+  std::shared_ptr<voxel_chunk> &chunk = chunks_[key];
+  if (chunk == nullptr) {
+    chunk = std::make_shared<voxel_chunk>();
+  } else if (chunk.use_count() > 1) {
+    // Only this thread hands out references, so a count of one cannot go up behind our back;
+    // a stale higher count just costs an unneeded copy.
+    chunk = std::make_shared<voxel_chunk>(*chunk);
+  }
+  return *chunk;
+}
+
+void voxel_volume::mark_dirty(const glm::ivec3 &chunk, const glm::ivec3 &local) {
+  dirty_.insert(voxel_chunk_key(chunk));
+
+  // A voxel on the border can expose or hide a face of the neighbour across it. Missing
+  // neighbours are empty and have no faces to change.
+  for (int32_t axis = 0; axis < 3; ++axis) {
+    if (local[axis] != 0 && local[axis] != voxel_chunk_size - 1) continue;
+
+    glm::ivec3 neighbour = chunk;
+    neighbour[axis] += local[axis] == 0 ? -1 : 1;
+    const uint64_t key = voxel_chunk_key(neighbour);
+    if (chunks_.count(key) != 0) dirty_.insert(key);
+  }
+}
+
+void voxel_volume::set(const glm::ivec3 &position, const voxel value) {
+  const glm::ivec3 chunk = voxel_chunk_of(position);
+  const uint64_t key = voxel_chunk_key(chunk);
+  if (value == empty_voxel && chunks_.count(key) == 0) return;
+
+  const glm::ivec3 local = voxel_local_position(position);
+  voxel_chunk &contents = writable_chunk(key);
+  if (contents.set(voxel_index(local.x, local.y, local.z), value)) mark_dirty(chunk, local);
+  if (contents.is_empty()) chunks_.erase(key);
+}
+
+void voxel_volume::fill_sphere(const glm::vec3 &centre, const float radius, const voxel value) {
+  const glm::ivec3 min(glm::floor(centre - radius));
+  const glm::ivec3 max(glm::ceil(centre + radius));
+  const float radius_squared = radius * radius;
+
+  // Chunk by chunk, so each one is looked up (and copied, if shared) once.
+  const glm::ivec3 first_chunk = voxel_chunk_of(min), last_chunk = voxel_chunk_of(max);
+  for (int32_t cz = first_chunk.z; cz <= last_chunk.z; ++cz) {
+    for (int32_t cy = first_chunk.y; cy <= last_chunk.y; ++cy) {
+      for (int32_t cx = first_chunk.x; cx <= last_chunk.x; ++cx) {
+        const glm::ivec3 chunk(cx, cy, cz);
+        const uint64_t key = voxel_chunk_key(chunk);
+        if (value == empty_voxel && chunks_.count(key) == 0) continue;
+
+        const glm::ivec3 origin = chunk * voxel_chunk_size;
+        const glm::ivec3 low = glm::max(min, origin) - origin;
+        const glm::ivec3 high = glm::min(max, origin + voxel_chunk_size - 1) - origin;
+        voxel_chunk *contents = nullptr;
+
+        for (int32_t z = low.z; z <= high.z; ++z) {
+          for (int32_t y = low.y; y <= high.y; ++y) {
+            for (int32_t x = low.x; x <= high.x; ++x) {
+              const glm::vec3 offset = glm::vec3(origin + glm::ivec3(x, y, z)) + 0.5f - centre;
+              if (glm::dot(offset, offset) > radius_squared) continue;
+
+              if (contents == nullptr) contents = &writable_chunk(key);
+              if (contents->set(voxel_index(x, y, z), value)) mark_dirty(chunk, glm::ivec3(x, y, z));
+            }
+          }
+        }
+        if (contents != nullptr && contents->is_empty()) chunks_.erase(key);
+      }
+    }
+  }
+}
+
+void voxel_volume::fill_box(const glm::ivec3 &min, const glm::ivec3 &max, const voxel value) {
+  const glm::ivec3 first_chunk = voxel_chunk_of(min), last_chunk = voxel_chunk_of(max);
+  for (int32_t cz = first_chunk.z; cz <= last_chunk.z; ++cz) {
+    for (int32_t cy = first_chunk.y; cy <= last_chunk.y; ++cy) {
+      for (int32_t cx = first_chunk.x; cx <= last_chunk.x; ++cx) {
+        const glm::ivec3 chunk(cx, cy, cz);
+        const uint64_t key = voxel_chunk_key(chunk);
+        if (value == empty_voxel && chunks_.count(key) == 0) continue;
+
+        const glm::ivec3 origin = chunk * voxel_chunk_size;
+        const glm::ivec3 low = glm::max(min, origin) - origin;
+        const glm::ivec3 high = glm::min(max, origin + voxel_chunk_size - 1) - origin;
+
+        if (low == glm::ivec3(0) && high == glm::ivec3(voxel_chunk_size - 1)) {
+          set_chunk(chunk, voxel_chunk(value));
+          continue;
+        }
+
+        voxel_chunk &contents = writable_chunk(key);
+        for (int32_t z = low.z; z <= high.z; ++z) {
+          for (int32_t y = low.y; y <= high.y; ++y) {
+            for (int32_t x = low.x; x <= high.x; ++x) {
+              if (contents.set(voxel_index(x, y, z), value)) mark_dirty(chunk, glm::ivec3(x, y, z));
+            }
+          }
+        }
+        if (contents.is_empty()) chunks_.erase(key);
+      }
+    }
+  }
+}
+
+void voxel_volume::set_chunk(const glm::ivec3 &chunk, voxel_chunk contents) {
+  const uint64_t key = voxel_chunk_key(chunk);
+  if (contents.is_empty()) {
+    if (chunks_.erase(key) == 0) return;
+  } else {
+    chunks_[key] = std::make_shared<voxel_chunk>(std::move(contents));
+  }
+
+  dirty_.insert(key);
+  for (const glm::ivec3 &offset : side_offsets) {
+    const uint64_t neighbour = voxel_chunk_key(chunk + offset);
+    if (chunks_.count(neighbour) != 0) dirty_.insert(neighbour);
+  }
+}
+
+voxel_neighbourhood voxel_volume::neighbourhood(const glm::ivec3 &chunk) const {
+  const auto find = [this](const glm::ivec3 &coordinate) -> std::shared_ptr<const voxel_chunk> {
+    const auto found = chunks_.find(voxel_chunk_key(coordinate));
+    return found == chunks_.end() ? nullptr : found->second;
+  };
+
+  voxel_neighbourhood result;
+  result.chunk = chunk;
+  result.centre = find(chunk);
+  for (int32_t side = 0; side < 6; ++side) result.sides[side] = find(chunk + side_offsets[side]);
+  return result;
+}
+
+std::vector<glm::ivec3> voxel_volume::take_dirty_chunks() {
+  std::vector<glm::ivec3> result;
+  result.reserve(dirty_.size());
+  for (const uint64_t key : dirty_) result.push_back(voxel_chunk_coordinate(key));
+  dirty_.clear();
+  return result;
+}
+
+void voxel_volume::mark_all_dirty() {
+  for (const auto &[key, chunk] : chunks_) dirty_.insert(key);
+}
+
+bool voxel_volume::raycast(const glm::vec3 &origin, const glm::vec3 &direction, const float max_distance,
+                           voxel_hit &hit) const {
+  const glm::vec3 unit = glm::normalize(direction);
+  glm::ivec3 position(glm::floor(origin));
+  glm::ivec3 step(0);
+  glm::vec3 next(std::numeric_limits<float>::infinity());   // ray distance to the next boundary per axis
+  glm::vec3 delta(std::numeric_limits<float>::infinity());  // ray distance across one voxel per axis
+
+  for (int32_t axis = 0; axis < 3; ++axis) {
+    if (unit[axis] == 0.0f) continue;
+    step[axis] = unit[axis] > 0.0f ? 1 : -1;
+    delta[axis] = std::abs(1.0f / unit[axis]);
+    const float boundary = static_cast<float>(position[axis]) + (step[axis] > 0 ? 1.0f : 0.0f);
+    next[axis] = (boundary - origin[axis]) / unit[axis];
+  }
+
+  glm::ivec3 normal(0);
+  float distance = 0.0f;
+  while (distance <= max_distance) {
+    if (get(position) != empty_voxel) {
+      hit.position = position;
+      hit.normal = normal;
+      hit.distance = distance;
+      return true;
+    }
+
+    int32_t axis = 0;
+    if (next.y < next[axis]) axis = 1;
+    if (next.z < next[axis]) axis = 2;
+
+    distance = next[axis];
+    next[axis] += delta[axis];
+    position[axis] += step[axis];
+    normal = glm::ivec3(0);
+    normal[axis] = -step[axis];
+  }
+  return false;
+}
+
+size_t voxel_volume::size_in_bytes() const {
+  size_t bytes = 0;
+  for (const auto &[key, chunk] : chunks_) bytes += chunk->size_in_bytes();
+  return bytes;
+}
+
+void generate_voxel_terrain(voxel_volume &volume, const voxel_terrain_settings &settings, thread_pool &pool) {
+  const glm::ivec3 size = settings.size;
+
+  heightmap_generator_settings shape;
+  shape.size = std::max(size.x, size.z);
+  shape.seed = settings.seed;
+  shape.octaves = 6;
+  shape.feature_size = static_cast<float>(shape.size) * 0.5f;
+  shape.flat_radius = static_cast<float>(shape.size) / 16.0f;
+  shape.flat_height = 0.3f;
+  const heightmap surface = generate_heightmap(shape, pool);
+
+  const float low = settings.min_height * static_cast<float>(size.y);
+  const float range = (settings.max_height - settings.min_height) * static_cast<float>(size.y);
+  const auto snow_line = static_cast<int32_t>(settings.snow_height * static_cast<float>(size.y));
+  const auto height_at = [&](const int32_t x, const int32_t z) {
+    return std::clamp(static_cast<int32_t>(low + range * static_cast<float>(surface.at(x, z)) / 65535.0f), 1, size.y);
+  };
+
+  // Grass (or snow) on top, three voxels of dirt, stone below.
+  const auto material_at = [&](const int32_t y, const int32_t top) -> voxel {
+    if (y >= top) return empty_voxel;
+    if (top > snow_line && y >= top - 2) return voxel_snow;
+    if (y == top - 1) return voxel_grass;
+    return y >= top - 4 ? voxel_dirt : voxel_stone;
+  };
+
+  const glm::ivec3 chunks = (size + voxel_chunk_size - 1) / voxel_chunk_size;
+  std::vector<std::vector<std::pair<glm::ivec3, voxel_chunk>>> columns(static_cast<size_t>(chunks.x) * chunks.z);
+
+  pool.parallel_for(0, columns.size(), [&](const size_t column) {
+    const auto cx = static_cast<int32_t>(column % chunks.x), cz = static_cast<int32_t>(column / chunks.x);
+    const int32_t x0 = cx * voxel_chunk_size, z0 = cz * voxel_chunk_size;
+
+    std::vector<int32_t> tops(voxel_chunk_size * voxel_chunk_size, 0);
+    int32_t lowest = size.y, highest = 0;
+    for (int32_t z = 0; z < voxel_chunk_size; ++z) {
+      for (int32_t x = 0; x < voxel_chunk_size; ++x) {
+        if (x0 + x >= size.x || z0 + z >= size.z) {
+          lowest = 0;  // outside the volume counts as empty
+          continue;
+        }
+        const int32_t top = height_at(x0 + x, z0 + z);
+        tops[z * voxel_chunk_size + x] = top;
+        lowest = std::min(lowest, top);
+        highest = std::max(highest, top);
+      }
+    }
+
+    std::vector<voxel> voxels(voxel_chunk_volume);
+    for (int32_t cy = 0; cy < chunks.y; ++cy) {
+      const int32_t y0 = cy * voxel_chunk_size;
+      if (y0 >= highest) break;
+
+      if (y0 + voxel_chunk_size <= lowest - 4 && y0 + voxel_chunk_size <= size.y) {
+        columns[column].emplace_back(glm::ivec3(cx, cy, cz), voxel_chunk(voxel_stone));
+        continue;
+      }
+
+      for (int32_t z = 0; z < voxel_chunk_size; ++z) {
+        for (int32_t y = 0; y < voxel_chunk_size; ++y) {
+          const int32_t world_y = y0 + y;
+          for (int32_t x = 0; x < voxel_chunk_size; ++x) {
+            const int32_t top = world_y < size.y ? tops[z * voxel_chunk_size + x] : 0;
+            voxels[voxel_index(x, y, z)] = material_at(world_y, top);
+          }
+        }
+      }
+      columns[column].emplace_back(glm::ivec3(cx, cy, cz), voxel_chunk::from_voxels(voxels.data()));
+    }
+  });
+
+  for (auto &column : columns) {
+    for (auto &[chunk, contents] : column) volume.set_chunk(chunk, std::move(contents));
+  }
+}
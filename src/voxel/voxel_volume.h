@@ -0,0 +1,103 @@
+#ifndef VOXEL_VOLUME_H
+#define VOXEL_VOLUME_H
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <memory>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "voxel_chunk.h"
+
+class thread_pool;
+
+// Materials written by generate_voxel_terrain(); the voxel shader's palette is in the same order.
+constexpr voxel voxel_grass = 1;
+constexpr voxel voxel_dirt = 2;
+constexpr voxel voxel_stone = 3;
+constexpr voxel voxel_snow = 4;
+constexpr voxel voxel_brick = 5;
+
+// Chunk keys pack the three chunk coordinates into 21 bits each, so a volume spans up to 2^20
+// chunks either side of the origin.
+[[nodiscard]] uint64_t voxel_chunk_key(const glm::ivec3 &chunk);
+[[nodiscard]] glm::ivec3 voxel_chunk_coordinate(uint64_t key);
+// The chunk holding a voxel, and the voxel's position inside it.
+[[nodiscard]] glm::ivec3 voxel_chunk_of(const glm::ivec3 &position);
+[[nodiscard]] glm::ivec3 voxel_local_position(const glm::ivec3 &position);
+
+// A chunk and its six face neighbours (-x, +x, -y, +y, -z, +z), enough to find every visible face
+// of the chunk. Null pointers are empty space.
+struct voxel_neighbourhood {
+  glm::ivec3 chunk = glm::ivec3(0);
+  std::shared_ptr<const voxel_chunk> centre;
+  std::shared_ptr<const voxel_chunk> sides[6];
+};
+
+struct voxel_hit {
+  glm::ivec3 position = glm::ivec3(0);  // the solid voxel
+  glm::ivec3 normal = glm::ivec3(0);    // of the face the ray entered through
+  float distance = 0.0f;
+};
+
+// Sparse voxel storage in hashed 32^3 chunks; chunks that are entirely empty are not stored.
+//
+// Edits record which chunks need new meshes: the chunk itself and, for voxels on its border, the
+// neighbours sharing that face. Chunks are copy-on-write: neighbourhood() hands out shared
+// references that meshing workers read while the owning thread keeps editing, and a chunk still
+// referenced by a worker is copied before its first change.
+//
+// Not thread safe; one thread owns the volume.
+class voxel_volume {
+ public:
+  [[nodiscard]] voxel get(const glm::ivec3 &position) const;
+  void set(const glm::ivec3 &position, voxel value);
+
+  // Sets every voxel whose centre lies within `radius` of `centre`.
+  void fill_sphere(const glm::vec3 &centre, float radius, voxel value);
+  // Inclusive bounds.
+  void fill_box(const glm::ivec3 &min, const glm::ivec3 &max, voxel value);
+
+  // Replaces a whole chunk, for generators; an empty chunk removes it.
+  void set_chunk(const glm::ivec3 &chunk, voxel_chunk contents);
+
+  [[nodiscard]] voxel_neighbourhood neighbourhood(const glm::ivec3 &chunk) const;
+
+  // Chunks edited since the last call.
+  [[nodiscard]] std::vector<glm::ivec3> take_dirty_chunks();
+  // Marks every stored chunk for a new mesh.
+  void mark_all_dirty();
+
+  // Walks the voxels along the ray (Amanatides and Woo) and reports the first solid one.
+  [[nodiscard]] bool raycast(const glm::vec3 &origin, const glm::vec3 &direction, float max_distance,
+                             voxel_hit &hit) const;
+
+  [[nodiscard]] size_t chunk_count() const { return chunks_.size(); }
+  [[nodiscard]] size_t size_in_bytes() const;
+
+ private:
+  // The chunk for editing, created empty if absent and copied if a worker still shares it.
+  voxel_chunk &writable_chunk(uint64_t key);
+  void mark_dirty(const glm::ivec3 &chunk, const glm::ivec3 &local);
+
+  std::unordered_map<uint64_t, std::shared_ptr<voxel_chunk>> chunks_;
+  std::unordered_set<uint64_t> dirty_;
+};
+
+struct voxel_terrain_settings {
+  glm::ivec3 size = glm::ivec3(256, 96, 256);  // voxels, with the volume's corner at the origin
+  uint32_t seed = 7;
+  // Surface heights as fractions of size.y.
+  float min_height = 0.2f;
+  float max_height = 0.8f;
+  float snow_height = 0.7f;
+};
+
+// Fills the volume with a heightfield landscape (grass over dirt over stone, snow on the peaks)
+// made by generate_heightmap(). Chunk columns are built in parallel; chunks entirely below the
+// surface are stored uniform.
+void generate_voxel_terrain(voxel_volume &volume, const voxel_terrain_settings &settings, thread_pool &pool);
+
+#endif  // VOXEL_VOLUME_H
@@ -0,0 +1,374 @@
+// Cooks the assets directory into the runtime's asset directory and writes the manifest the
+// engine reads at startup. Every output is keyed by a hash of its input together with the
+// processing parameters, and only outputs whose key changed are rebuilt; sources whose size,
+// modification time and parameters match the previous manifest are not even read.
+//
+//   shaders (.vert .frag .geom .comp .glsl)  includes resolved, comments stripped
+//   textures (.png .jpg .jpeg .tga .bmp)     copied, plus block-compressed KTX2s next to them: one
+//                                            mipped in linear light as sRGB colour (.ktx2) and one
+//                                            mipped as data (.data.ktx2), since the same image may be
+//                                            used as either; *_normal maps get a normal map (.ktx2)
+//                                            alone. The manifest tells them apart by kind
+//   HDR images (.hdr)                        copied, plus a KTX2 in the --hdr-format encoding
+//   everything else                          copied
+//
+// usage: Asset_Cooker <assets directory> <output directory> [--texture-format bc1|bc3|bc7]
+//                     [--quality fast|high] [--hdr-format rgba16f|r11g11b10f|rgbe|rgbm] [--force]
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <filesystem>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "filesystem/asset_manifest.h"
+#include "filesystem/atomic_file.h"
+#include "texture/hdr_image.h"
+#include "texture/image.h"
+#include "texture/texture_cache.h"
+#include "utility/hash.h"
+#include "utility/thread_pool.h"
+
+namespace {
+
+using mfsys::asset_entry;
+using mfsys::asset_kind;
+using mfsys::asset_manifest;
+
+// Bump whenever any processing step changes its output so everything is rebuilt.
+constexpr uint32_t cooker_version = 2;
+
+struct cook_options {
+  texture_compression compression;
+  hdr_format hdr_encoding = hdr_format::r11g11b10f;
+  bool force = false;
+};
+
+struct cook_job {
+  asset_kind kind;
+  std::filesystem::path source;
+  std::string relative;
+  std::string output;
+};
+
+enum class cook_result { up_to_date, cooked, failed };
+
+std::string to_lower(std::string text) {
+  std::transform(text.begin(), text.end(), text.begin(),
+                 [](const unsigned char c) { return static_cast<char>(std::tolower(c)); });
+  return text;
+}
+
+bool has_extension(const std::filesystem::path &path, const std::initializer_list<const char *> extensions) {
+  const std::string extension = to_lower(path.extension().string());
+  return std::any_of(extensions.begin(), extensions.end(),
+                     [&](const char *candidate) { return extension == candidate; });
+}
+
+bool ends_with(const std::string &text, const std::string &suffix) {
+  return text.size() >= suffix.size() && text.compare(text.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+bool is_texture(const asset_kind kind) {
+  return kind == asset_kind::texture || kind == asset_kind::data_texture || kind == asset_kind::normal_map;
+}
+
+texture_compression texture_settings(const asset_kind kind, const cook_options &options) {
+  texture_compression compression = options.compression;
+  compression.mips.srgb = kind == asset_kind::texture;
+  compression.mips.normal_map = kind == asset_kind::normal_map;
+  return compression;
+}
+
+// Inlines `#include "file"` (relative to the including file) and strips comments, each into a space as the
+// C preprocessor does. Every input line stays one output line and `#line` directives mark where an included
+// file starts and where its includer resumes, so compile logs point at the right line. Files are numbered as
+// the GLSL source string of those directives in the order they are first read, 0 for the one cooked.
+bool preprocess_shader(const std::filesystem::path &path, std::vector<std::filesystem::path> &stack,
+                       uint32_t &files, std::string &out) {
+  const std::vector<uint8_t> bytes = read_file_bytes(path.string());
+  if (bytes.empty()) {
+    std::cout << "Cannot read shader " << path << std::endl;
+    return false;
+  }
+
+  const std::filesystem::path canonical = std::filesystem::weakly_canonical(path);
+  if (std::find(stack.begin(), stack.end(), canonical) != stack.end()) {
+    std::cout << "Shader include cycle through " << path << std::endl;
+    return false;
+  }
+  stack.push_back(canonical);
+  const uint32_t file = files++;
+
+  std::istringstream lines(std::string(bytes.begin(), bytes.end()));
+  std::string line;
+  uint32_t line_number = 0;
+  bool in_block_comment = false;
+  while (std::getline(lines, line)) {
+    ++line_number;
+    std::string code;
+    for (size_t i = 0; i < line.size(); ++i) {
+      if (in_block_comment) {
+        if (line.compare(i, 2, "*/") == 0) {
+          in_block_comment = false;
+          code += ' ';
+          ++i;
+        }
+      } else if (line.compare(i, 2, "//") == 0) {
+        break;
+      } else if (line.compare(i, 2, "/*") == 0) {
+        in_block_comment = true;
+        ++i;
+      } else {
+        code += line[i];
+      }
+    }
+
+    while (!code.empty() && std::isspace(static_cast<unsigned char>(code.back()))) code.pop_back();
+
+    const size_t directive = code.find_first_not_of(" \t");
+    if (directive != std::string::npos && code.compare(directive, 8, "#include") == 0) {
+      const size_t open = code.find('"', directive);
+      const size_t close = open == std::string::npos ? open : code.find('"', open + 1);
+      if (close == std::string::npos) {
+        std::cout << "Malformed include in " << path << ": " << code << std::endl;
+        return false;
+      }
+      out += "#line 1 " + std::to_string(files) + '\n';
+      if (!preprocess_shader(path.parent_path() / code.substr(open + 1, close - open - 1), stack, files, out)) {
+        return false;
+      }
+      out += "#line " + std::to_string(line_number + 1) + ' ' + std::to_string(file) + '\n';
+      continue;
+    }
+
+    out += code;
+    out += '\n';
+  }
+
+  stack.pop_back();
+  return true;
+}
+
+uint64_t parameter_hash(const cook_job &job, const cook_options &options) {
+  uint32_t parameters[6] = {cooker_version, static_cast<uint32_t>(job.kind), 0, 0, 0, 0};
+  if (is_texture(job.kind)) {
+    const texture_compression compression = texture_settings(job.kind, options);
+    parameters[2] = static_cast<uint32_t>(compression.format);
+    parameters[3] = static_cast<uint32_t>(compression.quality);
+    parameters[4] = compression.mips.srgb;
+    parameters[5] = compression.mips.normal_map;
+    if (has_extension(job.source, {".hdr"})) parameters[2] = 0x100u | static_cast<uint32_t>(options.hdr_encoding);
+  }
+  return fnv1a_64(parameters, sizeof(parameters));
+}
+
+cook_result cook(const cook_job &job, const asset_entry *previous, const std::filesystem::path &output_directory,
+                 const cook_options &options, thread_pool &pool, asset_entry &entry) {
+  const std::filesystem::path output = output_directory / job.output;
+
+  std::error_code error;
+  entry.kind = job.kind;
+  entry.source = job.relative;
+  entry.output = job.output;
+  entry.source_size = std::filesystem::file_size(job.source, error);
+  entry.source_time = std::filesystem::last_write_time(job.source, error).time_since_epoch().count();
+  entry.parameters = parameter_hash(job, options);
+
+  const bool output_exists = std::filesystem::exists(output);
+  const bool reusable = !options.force && previous != nullptr && previous->output == job.output && output_exists;
+
+  // Shaders pull in other files, so their key always comes from the preprocessed text.
+  if (reusable && job.kind != asset_kind::shader && previous->parameters == entry.parameters &&
+      previous->source_size == entry.source_size && previous->source_time == entry.source_time) {
+    entry.hash = previous->hash;
+    return cook_result::up_to_date;
+  }
+
+  std::vector<uint8_t> bytes;
+  if (job.kind == asset_kind::shader) {
+    std::vector<std::filesystem::path> stack;
+    uint32_t files = 0;
+    std::string text;
+    if (!preprocess_shader(job.source, stack, files, text)) return cook_result::failed;
+    bytes.assign(text.begin(), text.end());
+  } else {
+    bytes = read_file_bytes(job.source.string());
+    if (bytes.empty() && entry.source_size != 0) {
+      std::cout << "Cannot read " << job.source << std::endl;
+      return cook_result::failed;
+    }
+  }
+
+  entry.hash = fnv1a_64(bytes.data(), bytes.size(), entry.parameters);
+  if (reusable && previous->hash == entry.hash) return cook_result::up_to_date;
+
+  bool written;
+  if (is_texture(job.kind)) {
+    std::filesystem::create_directories(output.parent_path(), error);
+    written = has_extension(job.source, {".hdr"})
+                  ? write_hdr_texture(bytes, job.relative, options.hdr_encoding, output)
+                  : write_compressed_texture(bytes, job.relative, texture_settings(job.kind, options), output, pool);
+  } else {
+    written = mfsys::write_file_atomically(output, bytes.data(), bytes.size());
+  }
+
+  if (!written) {
+    std::cout << "Failed to cook " << job.relative << std::endl;
+    return cook_result::failed;
+  }
+  return cook_result::cooked;
+}
+
+std::vector<cook_job> collect_jobs(const std::filesystem::path &assets_directory) {
+  std::vector<cook_job> jobs;
+
+  for (const auto &file : std::filesystem::recursive_directory_iterator(assets_directory)) {
+    if (!file.is_regular_file()) continue;
+
+    const std::filesystem::path &path = file.path();
+    const std::string relative = std::filesystem::relative(path, assets_directory).generic_string();
+
+    if (has_extension(path, {".vert", ".frag", ".geom", ".comp", ".glsl"})) {
+      jobs.push_back({asset_kind::shader, path, relative, relative});
+      continue;
+    }
+
+    jobs.push_back({asset_kind::copy, path, relative, relative});
+    if (has_extension(path, {".hdr"})) {
+      jobs.push_back({asset_kind::texture, path, relative, relative + ".ktx2"});
+    } else if (has_extension(path, {".png", ".jpg", ".jpeg", ".tga", ".bmp"})) {
+      if (ends_with(path.stem().string(), "_normal")) {
+        jobs.push_back({asset_kind::normal_map, path, relative, relative + ".ktx2"});
+      } else {
+        jobs.push_back({asset_kind::texture, path, relative, relative + ".ktx2"});
+        jobs.push_back({asset_kind::data_texture, path, relative, relative + ".data.ktx2"});
+      }
+    }
+  }
+
+  // Textures first: they take longest, so the cheap jobs fill in around them.
+  std::stable_sort(jobs.begin(), jobs.end(),
+                   [](const cook_job &a, const cook_job &b) { return is_texture(a.kind) > is_texture(b.kind); });
+  return jobs;
+}
+
+bool parse_format(const std::string &name, bc_format &format) {
+  for (const bc_format candidate : {bc_format::bc1, bc_format::bc3, bc_format::bc4, bc_format::bc5, bc_format::bc7}) {
+    if (to_lower(name) == to_lower(bc_format_name(candidate))) {
+      format = candidate;
+      return true;
+    }
+  }
+  return false;
+}
+
+bool parse_hdr_format(const std::string &name, hdr_format &format) {
+  for (const hdr_format candidate : {hdr_format::rgba16f, hdr_format::r11g11b10f, hdr_format::rgbe, hdr_format::rgbm}) {
+    if (to_lower(name) == to_lower(hdr_format_name(candidate))) {
+      format = candidate;
+      return true;
+    }
+  }
+  return false;
+}
+
+int usage() {
+  std::cout << "usage: Asset_Cooker <assets directory> <output directory> [--texture-format bc1|bc3|bc7] "
+               "[--quality fast|high] [--hdr-format rgba16f|r11g11b10f|rgbe|rgbm] [--force]"
+            << std::endl;
+  return 2;
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  if (argc < 3) return usage();
+
+  const std::filesystem::path assets_directory = argv[1];
+  const std::filesystem::path output_directory = argv[2];
+
+  cook_options options;
+  for (int i = 3; i < argc; ++i) {
+    const std::string argument = argv[i];
+    if (argument == "--force") {
+      options.force = true;
+    } else if (argument == "--texture-format" && i + 1 < argc) {
+      if (!parse_format(argv[++i], options.compression.format)) return usage();
+    } else if (argument == "--quality" && i + 1 < argc) {
+      const std::string quality = argv[++i];
+      if (quality != "fast" && quality != "high") return usage();
+      options.compression.quality = quality == "fast" ? bc_quality::fast : bc_quality::high;
+    } else if (argument == "--hdr-format" && i + 1 < argc) {
+      if (!parse_hdr_format(argv[++i], options.hdr_encoding)) return usage();
+    } else {
+      return usage();
+    }
+  }
+
+  if (!std::filesystem::is_directory(assets_directory)) {
+    std::cout << "Assets directory does not exist: " << assets_directory << std::endl;
+    return 1;
+  }
+
+  const auto start = std::chrono::steady_clock::now();
+  const std::filesystem::path manifest_path = output_directory / asset_manifest::file_name;
+  const asset_manifest previous = asset_manifest::load(manifest_path);
+
+  std::unordered_map<std::string, const asset_entry *> previous_entries;
+  for (const asset_entry &entry : previous.entries()) {
+    previous_entries[std::string(mfsys::asset_kind_name(entry.kind)) + '\t' + entry.source] = &entry;
+  }
+  const auto find_previous = [&](const cook_job &job) -> const asset_entry * {
+    const auto found = previous_entries.find(std::string(mfsys::asset_kind_name(job.kind)) + '\t' + job.relative);
+    return found == previous_entries.end() ? nullptr : found->second;
+  };
+
+  const std::vector<cook_job> jobs = collect_jobs(assets_directory);
+  std::vector<asset_entry> entries(jobs.size());
+  std::vector<cook_result> results(jobs.size());
+
+  thread_pool pool;
+  pool.parallel_for(0, jobs.size(), [&](const size_t i) {
+    results[i] = cook(jobs[i], find_previous(jobs[i]), output_directory, options, pool, entries[i]);
+  });
+
+  // Outputs whose source is gone.
+  size_t removed = 0;
+  for (const asset_entry &entry : previous.entries()) {
+    const bool still_cooked = std::any_of(jobs.begin(), jobs.end(), [&](const cook_job &job) {
+      return job.output == entry.output;
+    });
+    if (still_cooked) continue;
+
+    std::error_code error;
+    if (std::filesystem::remove(output_directory / entry.output, error)) ++removed;
+  }
+
+  asset_manifest manifest;
+  size_t cooked = 0, failed = 0;
+  for (size_t i = 0; i < jobs.size(); ++i) {
+    if (results[i] == cook_result::failed) {
+      ++failed;
+      continue;
+    }
+    if (results[i] == cook_result::cooked) ++cooked;
+    manifest.add(entries[i]);
+  }
+
+  if (!manifest.save(manifest_path)) {
+    std::cout << "Failed to write " << manifest_path << std::endl;
+    return 1;
+  }
+
+  const std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+  std::cout << "Cooked " << cooked << " of " << jobs.size() << " assets (" << jobs.size() - cooked - failed
+            << " up to date, " << removed << " removed, " << failed << " failed) in " << elapsed.count() << " ms"
+            << std::endl;
+
+  return failed == 0 ? 0 : 1;
+}
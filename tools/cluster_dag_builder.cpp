@@ -0,0 +1,88 @@
+// Builds the cluster DAG file the runtime streams dense meshes from (see cluster_dag.h) out of a
+// PLY mesh, or out of the generated boulder when the input is "generated". The runtime builds the
+// same file on demand into its cache; this is for meshes too large to build at startup.
+//
+// usage: Cluster_Dag_Builder <input.ply | generated> <output.cdag> [--cluster-triangles N]
+//                            [--group-clusters N] [--generated-resolution N]
+
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <iostream>
+#include <string>
+
+#include "cluster_lod/cluster_dag.h"
+#include "utility/thread_pool.h"
+
+namespace {
+
+int usage() {
+  std::cout << "usage: Cluster_Dag_Builder <input.ply | generated> <output.cdag> [--cluster-triangles N] "
+               "[--group-clusters N] [--generated-resolution N]"
+            << std::endl;
+  return 2;
+}
+
+bool parse_count(const char *text, uint64_t &value) {
+  char *end = nullptr;
+  const unsigned long long parsed = std::strtoull(text, &end, 10);
+  if (end == text || *end != '\0' || parsed == 0) return false;
+  value = parsed;
+  return true;
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  if (argc < 3) return usage();
+
+  const std::string input = argv[1];
+  const std::filesystem::path output = argv[2];
+
+  cluster_dag_build_settings settings;
+  boulder_settings generator;
+  for (int i = 3; i < argc; ++i) {
+    const std::string argument = argv[i];
+    uint64_t value = 0;
+    if (i + 1 >= argc || !parse_count(argv[i + 1], value)) return usage();
+    ++i;
+
+    if (argument == "--cluster-triangles" && value >= 8 && value <= 255) {
+      settings.cluster_triangles = static_cast<uint32_t>(value);
+    } else if (argument == "--group-clusters" && value >= 2 && value <= 64) {
+      settings.group_clusters = static_cast<uint32_t>(value);
+    } else if (argument == "--generated-resolution" && value <= 8192) {
+      generator.resolution = static_cast<int32_t>(value);
+    } else {
+      return usage();
+    }
+  }
+
+  thread_pool pool;
+  auto start = std::chrono::steady_clock::now();
+  const dense_mesh mesh = input == "generated" ? generate_boulder(generator, pool) : load_ply(input);
+  if (mesh.empty()) return 1;
+  std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+  std::cout << "Read " << mesh.triangle_count() << " triangles, " << mesh.positions.size() << " vertices in "
+            << elapsed.count() << " ms" << std::endl;
+
+  start = std::chrono::steady_clock::now();
+  if (!write_cluster_dag(output, mesh, settings, pool)) {
+    std::cout << "Failed to write cluster DAG: " << output << std::endl;
+    return 1;
+  }
+  elapsed = std::chrono::steady_clock::now() - start;
+
+  const cluster_dag_file file = open_cluster_dag(output);
+  if (file.empty()) {
+    std::cout << "Written cluster DAG does not open: " << output << std::endl;
+    return 1;
+  }
+
+  size_t clusters = 0;
+  for (uint32_t g = 0; g < file.group_count; ++g) clusters += file.groups[g].cluster_count;
+  std::cout << "Wrote " << clusters << " clusters in " << file.group_count << " groups over " << file.level_count
+            << " levels, " << static_cast<double>(file.file->size()) / (1024.0 * 1024.0) << " MiB, in "
+            << elapsed.count() << " ms" << std::endl;
+  return 0;
+}
@@ -0,0 +1,88 @@
+// Builds the octree file the runtime streams point clouds from (see point_cloud_octree.h) out of a
+// LAS scan, or out of the generated test scene when the input is "generated". The runtime builds
+// the same file on demand into its cache; this is for scans too large to build at startup.
+//
+// usage: Point_Cloud_Builder <input.las | generated> <output.pcloud> [--leaf-points N] [--grid-size N]
+//                            [--generated-points N]
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <iostream>
+#include <string>
+
+#include "point_cloud/point_cloud_octree.h"
+#include "utility/thread_pool.h"
+
+namespace {
+
+int usage() {
+  std::cout << "usage: Point_Cloud_Builder <input.las | generated> <output.pcloud> [--leaf-points N] "
+               "[--grid-size N] [--generated-points N]"
+            << std::endl;
+  return 2;
+}
+
+bool parse_count(const char *text, uint64_t &value) {
+  char *end = nullptr;
+  const unsigned long long parsed = std::strtoull(text, &end, 10);
+  if (end == text || *end != '\0' || parsed == 0) return false;
+  value = parsed;
+  return true;
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  if (argc < 3) return usage();
+
+  const std::string input = argv[1];
+  const std::filesystem::path output = argv[2];
+
+  point_cloud_build_settings settings;
+  point_cloud_generator_settings generator;
+  for (int i = 3; i < argc; ++i) {
+    const std::string argument = argv[i];
+    uint64_t value = 0;
+    if (i + 1 >= argc || !parse_count(argv[i + 1], value)) return usage();
+    ++i;
+
+    if (argument == "--leaf-points") {
+      settings.leaf_points = static_cast<uint32_t>(value);
+    } else if (argument == "--grid-size" && value <= 1024) {
+      settings.grid_size = static_cast<uint32_t>(value);
+    } else if (argument == "--generated-points") {
+      generator.point_count = static_cast<size_t>(value);
+    } else {
+      return usage();
+    }
+  }
+
+  thread_pool pool;
+  auto start = std::chrono::steady_clock::now();
+  point_set points = input == "generated" ? generate_point_cloud(generator, pool) : load_las(input, pool);
+  if (points.empty()) return 1;
+  std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+  std::cout << "Read " << points.points.size() << " points in " << elapsed.count() << " ms" << std::endl;
+
+  start = std::chrono::steady_clock::now();
+  if (!write_point_cloud_octree(output, points, settings, pool)) {
+    std::cout << "Failed to write point cloud octree: " << output << std::endl;
+    return 1;
+  }
+  elapsed = std::chrono::steady_clock::now() - start;
+
+  const point_cloud_file file = open_point_cloud_octree(output);
+  if (file.empty()) {
+    std::cout << "Written octree does not open: " << output << std::endl;
+    return 1;
+  }
+
+  uint32_t depth = 0;
+  for (uint32_t i = 0; i < file.node_count; ++i) depth = std::max<uint32_t>(depth, file.nodes[i].level + 1u);
+  std::cout << "Wrote " << file.node_count << " nodes over " << depth << " levels, "
+            << static_cast<double>(file.file->size()) / (1024.0 * 1024.0) << " MiB, in " << elapsed.count() << " ms"
+            << std::endl;
+  return 0;
+}